@@ -0,0 +1,20 @@
+#pragma once
+#include "byte_swap.h"
+#include <cstddef>
+#include <cstdint>
+
+// Vectorised versions of byte_swap for arrays, the widest instruction set
+// supported by the host CPU is picked at runtime and the remainder is
+// swapped with the scalar byte_swap.
+
+// Swaps endian of count 16 bit values from src into dst, src may equal dst
+void
+byte_swap_array(const uint16_t *src,
+                uint16_t *dst,
+                size_t count);
+
+// Swaps endian of count 32 bit values from src into dst, src may equal dst
+void
+byte_swap_array(const uint32_t *src,
+                uint32_t *dst,
+                size_t count);
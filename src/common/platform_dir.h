@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 
 namespace platform
 {
@@ -19,6 +20,11 @@ isFile(const std::string &path);
 bool
 isDirectory(const std::string &path);
 
+//! Get the names of every entry in a directory, excluding . and ..
+bool
+listDirectory(const std::string &path,
+              std::vector<std::string> &entries);
+
 std::string
 getConfigDirectory();
 
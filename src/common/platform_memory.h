@@ -1,5 +1,6 @@
 #pragma once
 #include <cstddef>
+#include <string>
 
 namespace platform
 {
@@ -28,4 +29,10 @@ uncommitMemory(size_t address, size_t size);
 bool
 protectMemory(size_t address, size_t size, ProtectFlags flags);
 
+const void *
+mapFileReadOnly(const std::string &path, size_t *size);
+
+bool
+unmapFile(const void *view, size_t size);
+
 }
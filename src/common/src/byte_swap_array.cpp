@@ -0,0 +1,241 @@
+#include "byte_swap_array.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define DECAF_BYTE_SWAP_X86
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// The SSSE3 and AVX2 kernels are compiled for their instruction set with a
+// function attribute, so they exist without the whole build targeting it.
+// MSVC allows the intrinsics in any function.
+#if defined(__GNUC__) || defined(__clang__)
+#define BYTE_SWAP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BYTE_SWAP_TARGET(isa)
+#endif
+
+namespace
+{
+
+using ByteSwap16Fn = size_t (*)(const uint16_t *, uint16_t *, size_t);
+using ByteSwap32Fn = size_t (*)(const uint32_t *, uint32_t *, size_t);
+
+// Each kernel swaps as many whole vectors as fit in count and returns the
+// number of values it swapped.
+size_t
+swapNone16(const uint16_t *src,
+           uint16_t *dst,
+           size_t count)
+{
+   return 0;
+}
+
+size_t
+swapNone32(const uint32_t *src,
+           uint32_t *dst,
+           size_t count)
+{
+   return 0;
+}
+
+#ifdef DECAF_BYTE_SWAP_X86
+
+size_t
+swapSse2_16(const uint16_t *src,
+            uint16_t *dst,
+            size_t count)
+{
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), value);
+   }
+
+   return i;
+}
+
+size_t
+swapSse2_32(const uint32_t *src,
+            uint32_t *dst,
+            size_t count)
+{
+   auto i = size_t { 0 };
+
+   for (; i + 4 <= count; i += 4) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+
+      // Swap the bytes of each half, then swap the halves
+      value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+      value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+      value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), value);
+   }
+
+   return i;
+}
+
+BYTE_SWAP_TARGET("ssse3") size_t
+swapSsse3_16(const uint16_t *src,
+             uint16_t *dst,
+             size_t count)
+{
+   const auto mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(value, mask));
+   }
+
+   return i;
+}
+
+BYTE_SWAP_TARGET("ssse3") size_t
+swapSsse3_32(const uint32_t *src,
+             uint32_t *dst,
+             size_t count)
+{
+   const auto mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+   auto i = size_t { 0 };
+
+   for (; i + 4 <= count; i += 4) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_shuffle_epi8(value, mask));
+   }
+
+   return i;
+}
+
+BYTE_SWAP_TARGET("avx2") size_t
+swapAvx2_16(const uint16_t *src,
+            uint16_t *dst,
+            size_t count)
+{
+   const auto mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+   auto i = size_t { 0 };
+
+   for (; i + 16 <= count; i += 16) {
+      auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(value, mask));
+   }
+
+   return i + swapSsse3_16(src + i, dst + i, count - i);
+}
+
+BYTE_SWAP_TARGET("avx2") size_t
+swapAvx2_32(const uint32_t *src,
+            uint32_t *dst,
+            size_t count)
+{
+   const auto mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+   auto i = size_t { 0 };
+
+   for (; i + 8 <= count; i += 8) {
+      auto value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(value, mask));
+   }
+
+   return i + swapSsse3_32(src + i, dst + i, count - i);
+}
+
+bool
+hostHasSsse3()
+{
+#ifdef _MSC_VER
+   int cpuInfo[4];
+   __cpuid(cpuInfo, 1);
+   return (cpuInfo[2] & (1 << 9)) != 0;
+#else
+   return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+bool
+hostHasAvx2()
+{
+#ifdef _MSC_VER
+   int cpuInfo[4];
+   __cpuid(cpuInfo, 0);
+
+   if (cpuInfo[0] < 7) {
+      return false;
+   }
+
+   // The OS must also save the YMM registers
+   __cpuid(cpuInfo, 1);
+
+   if (!(cpuInfo[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6) {
+      return false;
+   }
+
+   __cpuidex(cpuInfo, 7, 0);
+   return (cpuInfo[1] & (1 << 5)) != 0;
+#else
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // ifdef DECAF_BYTE_SWAP_X86
+
+struct ByteSwapKernels
+{
+   ByteSwapKernels()
+   {
+#ifdef DECAF_BYTE_SWAP_X86
+      if (hostHasAvx2()) {
+         swap16 = &swapAvx2_16;
+         swap32 = &swapAvx2_32;
+      } else if (hostHasSsse3()) {
+         swap16 = &swapSsse3_16;
+         swap32 = &swapSsse3_32;
+      } else {
+         swap16 = &swapSse2_16;
+         swap32 = &swapSse2_32;
+      }
+#endif
+   }
+
+   ByteSwap16Fn swap16 = &swapNone16;
+   ByteSwap32Fn swap32 = &swapNone32;
+};
+
+const ByteSwapKernels &
+getKernels()
+{
+   static const ByteSwapKernels kernels;
+   return kernels;
+}
+
+} // namespace
+
+void
+byte_swap_array(const uint16_t *src,
+                uint16_t *dst,
+                size_t count)
+{
+   auto i = getKernels().swap16(src, dst, count);
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+void
+byte_swap_array(const uint32_t *src,
+                uint32_t *dst,
+                size_t count)
+{
+   auto i = getKernels().swap32(src, dst, count);
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
@@ -35,18 +35,17 @@ static void
 dispatchException(Exception *exception,
                   void *context,
                   int signum,
-                  const struct sigaction *ourHandler,
                   const struct sigaction *sysHandler)
 {
-   // Reset to the original signal handler in case an exception handler
-   //  generates a signal of its own
-   sigaction(signum, sysHandler, nullptr);
-
-   static bool sInSignal = false;
+   static thread_local bool sInSignal = false;
 
    // Avoid recursive signal handling (in case an exception handler looking
-   //  at a SIGILL causes a SIGSEGV, for example)
+   //  at a SIGILL causes a SIGSEGV, for example), resetting to the original
+   //  signal handler so that re-running the instruction terminates.  This is
+   //  tracked per thread as other threads may legitimately fault at the same
+   //  time, e.g. when touching protected guest memory.
    if (sInSignal) {
+      sigaction(signum, sysHandler, nullptr);
       return;
    }
 
@@ -62,9 +61,6 @@ dispatchException(Exception *exception,
 
       sInSignal = false;
 
-      // Reinstall our signal handler
-      sigaction(signum, ourHandler, nullptr);
-
       if (func == HandledException) {
          // Exception handled, resume execution
          return;
@@ -76,8 +72,10 @@ dispatchException(Exception *exception,
       }
    }
 
-   // No exception handlers, found, so re-run the failing instruction to
-   //  call the original signal handler
+   // No exception handlers, found, so reset to the original signal handler
+   //  and re-run the failing instruction to call it
+   sInSignal = false;
+   sigaction(signum, sysHandler, nullptr);
    return;
 }
 
@@ -85,14 +83,14 @@ static void
 segvHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = AccessViolationException { reinterpret_cast<uint64_t>(info->si_addr) };
-   dispatchException(&exception, context, signum, &sSegvHandler, &sSystemSegvHandler);
+   dispatchException(&exception, context, signum, &sSystemSegvHandler);
 }
 
 static void
 illHandler(int signum, siginfo_t *info, void *context)
 {
    auto exception = InvalidInstructionException { };
-   dispatchException(&exception, context, signum, &sIllHandler, &sSystemIllHandler);
+   dispatchException(&exception, context, signum, &sSystemIllHandler);
 }
 
 bool
@@ -103,9 +101,9 @@ installExceptionHandler(ExceptionHandler handler)
    if (!addedHandlers) {
       sigemptyset(&sSegvHandler.sa_mask);
 
-      // Set SA_RESETHAND so that a SEGV in the handler will terminate the
-      // program rather than going into an infinite loop.
-      sSegvHandler.sa_flags = SA_SIGINFO | SA_RESETHAND;
+      // SA_NODEFER lets a SEGV inside an exception handler reach us so that
+      //  we can reset to the original handler and terminate the program.
+      sSegvHandler.sa_flags = SA_SIGINFO | SA_NODEFER;
 
       sSegvHandler.sa_sigaction = segvHandler;
       if (sigaction(SIGSEGV, &sSegvHandler, &sSystemSegvHandler) != 0) {
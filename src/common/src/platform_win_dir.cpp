@@ -82,6 +82,30 @@ isDirectory(const std::string &path)
    return !!(info.st_mode & _S_IFDIR);
 }
 
+bool
+listDirectory(const std::string &path,
+              std::vector<std::string> &entries)
+{
+   auto winPath = platform::toWinApiString(path + "\\*");
+   WIN32_FIND_DATAW data;
+   auto handle = FindFirstFileW(winPath.c_str(), &data);
+
+   if (handle == INVALID_HANDLE_VALUE) {
+      return false;
+   }
+
+   do {
+      auto name = platform::fromWinApiString(data.cFileName);
+
+      if (name != "." && name != "..") {
+         entries.push_back(name);
+      }
+   } while (FindNextFileW(handle, &data));
+
+   FindClose(handle);
+   return true;
+}
+
 std::string
 getConfigDirectory()
 {
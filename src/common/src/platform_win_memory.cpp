@@ -1,5 +1,6 @@
 #include "platform.h"
 #include "platform_memory.h"
+#include "platform_winapi_string.h"
 
 #ifdef PLATFORM_WINDOWS
 #include <Windows.h>
@@ -71,6 +72,53 @@ protectMemory(size_t address, size_t size, ProtectFlags flags)
    return (result != 0);
 }
 
+const void *
+mapFileReadOnly(const std::string &path, size_t *size)
+{
+   auto file = CreateFileW(toWinApiString(path).c_str(),
+                           GENERIC_READ,
+                           FILE_SHARE_READ,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL,
+                           NULL);
+
+   if (file == INVALID_HANDLE_VALUE) {
+      return nullptr;
+   }
+
+   LARGE_INTEGER fileSize;
+
+   if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+      CloseHandle(file);
+      return nullptr;
+   }
+
+   auto mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   CloseHandle(file);
+
+   if (!mapping) {
+      return nullptr;
+   }
+
+   // The view keeps its own reference to the mapping, so we can close it
+   auto result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   CloseHandle(mapping);
+
+   if (!result) {
+      return nullptr;
+   }
+
+   *size = static_cast<size_t>(fileSize.QuadPart);
+   return result;
+}
+
+bool
+unmapFile(const void *view, size_t size)
+{
+   return !!UnmapViewOfFile(view);
+}
+
 } // namespace platform
 
 #endif
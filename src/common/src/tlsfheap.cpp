@@ -0,0 +1,311 @@
+#include "align.h"
+#include "bitutils.h"
+#include "decaf_assert.h"
+#include "tlsfheap.h"
+
+#include <algorithm>
+
+static unsigned
+highestBit(uint64_t bits)
+{
+   return 63 - clz64(bits);
+}
+
+static unsigned
+lowestBit(uint64_t bits)
+{
+   return highestBit(bits & (~bits + 1));
+}
+
+TlsfHeap::TlsfHeap(void *buffer, size_t size) :
+   mBuffer(static_cast<uint8_t *>(buffer)),
+   mSize(size),
+   mFreeSize(size)
+{
+   mSecondLevelMap.fill(0);
+
+   for (auto &lists : mFreeLists) {
+      lists.fill(nullptr);
+   }
+
+   mFirstBlock = newBlock();
+   mFirstBlock->start = mBuffer;
+   mFirstBlock->size = mSize;
+   mFirstBlock->prevPhysical = nullptr;
+   mFirstBlock->nextPhysical = nullptr;
+   insertFreeBlock(mFirstBlock);
+}
+
+TlsfHeap::~TlsfHeap()
+{
+   for (auto block = mFirstBlock; block; ) {
+      auto next = block->nextPhysical;
+      delete block;
+      block = next;
+   }
+
+   for (auto block = mUnusedBlocks; block; ) {
+      auto next = block->nextFree;
+      delete block;
+      block = next;
+   }
+}
+
+size_t
+TlsfHeap::getLargestFreeSize()
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+
+   if (!mFirstLevelMap) {
+      return 0;
+   }
+
+   // The largest block is somewhere in the highest non-empty size class
+   auto fl = highestBit(mFirstLevelMap);
+   auto sl = highestBit(mSecondLevelMap[fl]);
+   auto largest = size_t { 0 };
+
+   for (auto block = mFreeLists[fl][sl]; block; block = block->nextFree) {
+      largest = std::max(largest, block->size);
+   }
+
+   return largest;
+}
+
+size_t
+TlsfHeap::getTotalFreeSize()
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+   return mFreeSize;
+}
+
+void *
+TlsfHeap::alloc(size_t size, size_t alignment)
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+
+   // Every allocation needs a unique address for free to find it by
+   size = std::max<size_t>(size, 1);
+   alignment = std::max<size_t>(alignment, 1);
+
+   auto block = findFreeBlock(size, alignment);
+
+   if (!block) {
+      return nullptr;
+   }
+
+   removeFreeBlock(block);
+
+   // Return any space skipped for alignment to the free lists, the block
+   //  before us cannot be free as it would have been merged with this one.
+   auto alignedStart = align_up(block->start, alignment);
+
+   if (alignedStart != block->start) {
+      auto aligned = splitBlock(block, alignedStart - block->start);
+      insertFreeBlock(block);
+      block = aligned;
+   }
+
+   if (block->size > size) {
+      insertFreeBlock(splitBlock(block, size));
+   }
+
+   block->free = false;
+   mFreeSize -= block->size;
+   mAllocatedBlocks.emplace(block->start, block);
+   return block->start;
+}
+
+void
+TlsfHeap::free(void *ptr)
+{
+   std::unique_lock<std::mutex> lock(mMutex);
+   auto itr = mAllocatedBlocks.find(static_cast<uint8_t *>(ptr));
+   decaf_check(itr != mAllocatedBlocks.end());
+
+   auto block = itr->second;
+   mAllocatedBlocks.erase(itr);
+   mFreeSize += block->size;
+   block->free = true;
+
+   if (block->prevPhysical && block->prevPhysical->free) {
+      auto prev = block->prevPhysical;
+      removeFreeBlock(prev);
+      mergeBlocks(prev, block);
+      block = prev;
+   }
+
+   if (block->nextPhysical && block->nextPhysical->free) {
+      auto next = block->nextPhysical;
+      removeFreeBlock(next);
+      mergeBlocks(block, next);
+   }
+
+   insertFreeBlock(block);
+}
+
+void
+TlsfHeap::mapping(size_t size, unsigned &fl, unsigned &sl)
+{
+   if (size < SmallBlockSize) {
+      fl = 0;
+      sl = static_cast<unsigned>(size);
+   } else {
+      auto log2 = highestBit(size);
+      fl = log2 - SecondLevelShift + 1;
+      sl = static_cast<unsigned>(size >> (log2 - SecondLevelShift)) ^ SecondLevelCount;
+   }
+}
+
+TlsfHeap::Block *
+TlsfHeap::findFreeBlock(size_t size, size_t alignment)
+{
+   unsigned fl, sl;
+
+   // Round the request up to the next size class so that any block in the
+   //  class we find is guaranteed to fit, whatever its alignment.
+   auto request = size + alignment - 1;
+   auto search = request;
+
+   if (search >= SmallBlockSize) {
+      search += (size_t { 1 } << (highestBit(search) - SecondLevelShift)) - 1;
+   }
+
+   mapping(search, fl, sl);
+
+   if (fl < FirstLevelCount) {
+      auto slMap = mSecondLevelMap[fl] & (~0u << sl);
+
+      if (!slMap && fl + 1 < FirstLevelCount) {
+         auto flMap = mFirstLevelMap & (~uint64_t { 0 } << (fl + 1));
+
+         if (flMap) {
+            fl = lowestBit(flMap);
+            slMap = mSecondLevelMap[fl];
+         }
+      }
+
+      if (slMap) {
+         return mFreeLists[fl][lowestBit(slMap)];
+      }
+   }
+
+   // Rounding up can skip over blocks in the request's own class which are
+   //  big enough, check those before giving up.
+   mapping(request, fl, sl);
+
+   for (auto block = mFreeLists[fl][sl]; block; block = block->nextFree) {
+      auto alignedStart = align_up(block->start, alignment);
+
+      if (alignedStart + size <= block->start + block->size) {
+         return block;
+      }
+   }
+
+   return nullptr;
+}
+
+void
+TlsfHeap::insertFreeBlock(Block *block)
+{
+   unsigned fl, sl;
+   mapping(block->size, fl, sl);
+
+   auto &head = mFreeLists[fl][sl];
+   block->free = true;
+   block->prevFree = nullptr;
+   block->nextFree = head;
+
+   if (head) {
+      head->prevFree = block;
+   }
+
+   head = block;
+   mFirstLevelMap |= uint64_t { 1 } << fl;
+   mSecondLevelMap[fl] |= 1u << sl;
+}
+
+void
+TlsfHeap::removeFreeBlock(Block *block)
+{
+   unsigned fl, sl;
+   mapping(block->size, fl, sl);
+
+   if (block->prevFree) {
+      block->prevFree->nextFree = block->nextFree;
+   } else {
+      mFreeLists[fl][sl] = block->nextFree;
+   }
+
+   if (block->nextFree) {
+      block->nextFree->prevFree = block->prevFree;
+   }
+
+   if (!mFreeLists[fl][sl]) {
+      mSecondLevelMap[fl] &= ~(1u << sl);
+
+      if (!mSecondLevelMap[fl]) {
+         mFirstLevelMap &= ~(uint64_t { 1 } << fl);
+      }
+   }
+
+   block->prevFree = nullptr;
+   block->nextFree = nullptr;
+}
+
+//! Shrink block to size and return a new block for the remainder
+TlsfHeap::Block *
+TlsfHeap::splitBlock(Block *block, size_t size)
+{
+   auto remainder = newBlock();
+   remainder->start = block->start + size;
+   remainder->size = block->size - size;
+   remainder->free = block->free;
+   remainder->prevPhysical = block;
+   remainder->nextPhysical = block->nextPhysical;
+
+   if (block->nextPhysical) {
+      block->nextPhysical->prevPhysical = remainder;
+   }
+
+   block->nextPhysical = remainder;
+   block->size = size;
+   return remainder;
+}
+
+//! Merge next into block, next must directly follow block in memory
+void
+TlsfHeap::mergeBlocks(Block *block, Block *next)
+{
+   decaf_check(block->nextPhysical == next);
+   block->size += next->size;
+   block->nextPhysical = next->nextPhysical;
+
+   if (next->nextPhysical) {
+      next->nextPhysical->prevPhysical = block;
+   }
+
+   releaseBlock(next);
+}
+
+TlsfHeap::Block *
+TlsfHeap::newBlock()
+{
+   auto block = mUnusedBlocks;
+
+   if (block) {
+      mUnusedBlocks = block->nextFree;
+   } else {
+      block = new Block;
+   }
+
+   *block = Block { };
+   return block;
+}
+
+void
+TlsfHeap::releaseBlock(Block *block)
+{
+   block->nextFree = mUnusedBlocks;
+   mUnusedBlocks = block;
+}
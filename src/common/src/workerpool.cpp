@@ -0,0 +1,106 @@
+#include "workerpool.h"
+#include "platform_thread.h"
+
+#include <algorithm>
+#include <spdlog/fmt/fmt.h>
+
+WorkerPool::WorkerPool(uint32_t numWorkers,
+                       const char *name)
+{
+   if (numWorkers == 0) {
+      numWorkers = std::max(1u, std::thread::hardware_concurrency());
+   }
+
+   for (auto i = 1u; i < numWorkers; ++i) {
+      mThreads.emplace_back(&WorkerPool::workerEntry, this, i);
+      platform::setThreadName(&mThreads.back(), fmt::format("{} {}", name, i));
+   }
+}
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mQuit = true;
+   }
+
+   mStartCV.notify_all();
+
+   for (auto &thread : mThreads) {
+      thread.join();
+   }
+}
+
+void
+WorkerPool::run(uint32_t count,
+                const Task &task)
+{
+   if (count == 0) {
+      return;
+   }
+
+   if (mThreads.empty() || count == 1) {
+      for (auto i = 0u; i < count; ++i) {
+         task(i, 0);
+      }
+
+      return;
+   }
+
+   {
+      std::unique_lock<std::mutex> lock { mMutex };
+      mTask = &task;
+      mCount = count;
+      mNextIndex = 0;
+      mActiveWorkers = static_cast<uint32_t>(mThreads.size());
+      ++mGeneration;
+   }
+
+   mStartCV.notify_all();
+   execute(0);
+
+   std::unique_lock<std::mutex> lock { mMutex };
+   mDoneCV.wait(lock, [&]() { return mActiveWorkers == 0; });
+   mTask = nullptr;
+}
+
+void
+WorkerPool::workerEntry(uint32_t worker)
+{
+   auto generation = uint64_t { 0 };
+
+   while (true) {
+      {
+         std::unique_lock<std::mutex> lock { mMutex };
+         mStartCV.wait(lock, [&]() { return mQuit || mGeneration != generation; });
+
+         if (mQuit) {
+            return;
+         }
+
+         generation = mGeneration;
+      }
+
+      execute(worker);
+
+      std::unique_lock<std::mutex> lock { mMutex };
+
+      if (--mActiveWorkers == 0) {
+         mDoneCV.notify_all();
+      }
+   }
+}
+
+void
+WorkerPool::execute(uint32_t worker)
+{
+   while (true) {
+      auto index = mNextIndex.fetch_add(1);
+
+      if (index >= mCount) {
+         break;
+      }
+
+      (*mTask)(index, worker);
+   }
+}
@@ -55,8 +55,8 @@ public:
       auto block = mFreeBlocks.begin();
 
       for (block = mFreeBlocks.begin(); block != mFreeBlocks.end(); ++block) {
-         auto alignedDiff = align_up(block->start, alignment) - block->start;
-         if (block->size - alignedDiff >= adjSize) {
+         auto alignedDiff = static_cast<size_t>(align_up(block->start, alignment) - block->start);
+         if (alignedDiff <= block->size && block->size - alignedDiff >= adjSize) {
             adjSize += alignedDiff;
             break;
          }
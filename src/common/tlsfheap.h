@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * Two Level Segregated Fit heap.
+ *
+ * Free blocks are kept in size classes indexed by a pair of bitmaps, so both
+ * alloc and free are O(1) in the number of blocks. Every block knows its
+ * physical neighbours, which lets free coalesce with both sides at once.
+ *
+ * The block records are kept outside of the managed memory. The heaps this
+ * is used for are guest memory which the guest can see, and which may not
+ * even be mapped until it has been allocated.
+ */
+class TlsfHeap
+{
+private:
+   struct Block
+   {
+      uint8_t *start;
+      size_t size;
+      bool free;
+
+      //! Blocks either side of this one in memory
+      Block *prevPhysical;
+      Block *nextPhysical;
+
+      //! Links in the free list for our size class
+      Block *prevFree;
+      Block *nextFree;
+   };
+
+   //! Each first level size class is divided into 2^SecondLevelShift
+   //  linear second level classes.
+   static const unsigned SecondLevelShift = 4;
+   static const unsigned SecondLevelCount = 1 << SecondLevelShift;
+
+   //! Sizes below this all live in first level 0, one class per byte
+   static const size_t SmallBlockSize = SecondLevelCount;
+
+   static const unsigned FirstLevelCount = 64 - SecondLevelShift + 1;
+
+public:
+   TlsfHeap(void *buffer, size_t size);
+   ~TlsfHeap();
+
+   TlsfHeap(const TlsfHeap &) = delete;
+   TlsfHeap &operator=(const TlsfHeap &) = delete;
+
+   size_t
+   getLargestFreeSize();
+
+   size_t
+   getTotalFreeSize();
+
+   void *
+   alloc(size_t size, size_t alignment = 4);
+
+   void
+   free(void *ptr);
+
+private:
+   static void
+   mapping(size_t size, unsigned &fl, unsigned &sl);
+
+   Block *
+   findFreeBlock(size_t size, size_t alignment);
+
+   void
+   insertFreeBlock(Block *block);
+
+   void
+   removeFreeBlock(Block *block);
+
+   Block *
+   splitBlock(Block *block, size_t size);
+
+   void
+   mergeBlocks(Block *block, Block *next);
+
+   Block *
+   newBlock();
+
+   void
+   releaseBlock(Block *block);
+
+private:
+   uint8_t *mBuffer;
+   size_t mSize;
+   size_t mFreeSize;
+   Block *mFirstBlock;
+
+   //! Unused block records, linked through nextFree
+   Block *mUnusedBlocks = nullptr;
+
+   uint64_t mFirstLevelMap = 0;
+   std::array<uint32_t, FirstLevelCount> mSecondLevelMap;
+   std::array<std::array<Block *, SecondLevelCount>, FirstLevelCount> mFreeLists;
+   std::unordered_map<uint8_t *, Block *> mAllocatedBlocks;
+   std::mutex mMutex;
+};
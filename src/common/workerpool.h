@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! A fixed set of threads which run the iterations of a parallel loop, the
+//  thread calling run is used as worker 0.
+class WorkerPool
+{
+public:
+   using Task = std::function<void(uint32_t index, uint32_t worker)>;
+
+   //! numWorkers includes the calling thread, 0 uses one per hardware thread
+   WorkerPool(uint32_t numWorkers,
+              const char *name);
+   ~WorkerPool();
+
+   uint32_t
+   getNumWorkers() const
+   {
+      return static_cast<uint32_t>(mThreads.size()) + 1;
+   }
+
+   //! Run task for every index in [0, count), returns once all are done.
+   void
+   run(uint32_t count,
+       const Task &task);
+
+private:
+   void
+   workerEntry(uint32_t worker);
+
+   void
+   execute(uint32_t worker);
+
+private:
+   std::vector<std::thread> mThreads;
+
+   std::mutex mMutex;
+   std::condition_variable mStartCV;
+   std::condition_variable mDoneCV;
+   bool mQuit = false;
+
+   //! Incremented for every call to run so sleeping workers can tell
+   //  a new task has been posted.
+   uint64_t mGeneration = 0;
+   uint32_t mActiveWorkers = 0;
+
+   const Task *mTask = nullptr;
+   uint32_t mCount = 0;
+   std::atomic<uint32_t> mNextIndex { 0 };
+};
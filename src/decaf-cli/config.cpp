@@ -7,6 +7,16 @@
 namespace config
 {
 
+namespace gpu
+{
+
+bool packet_stats = false;
+std::string renderer = "null";
+uint32_t threads = 0;
+std::string dump_path = "";
+
+} // namespace gpu
+
 namespace log
 {
 
@@ -46,10 +56,25 @@ struct CerealLog
          CEREAL_NVP(to_file),
          CEREAL_NVP(to_stdout),
          CEREAL_NVP(kernel_trace),
+         CEREAL_NVP(kernel_trace_log),
+         CEREAL_NVP(kernel_trace_dump),
          CEREAL_NVP(level));
    }
 };
 
+struct CerealGpu
+{
+   template <class Archive>
+   void serialize(Archive &ar)
+   {
+      using namespace config::gpu;
+      ar(CEREAL_NVP(packet_stats),
+         CEREAL_NVP(renderer),
+         CEREAL_NVP(threads),
+         CEREAL_NVP(dump_path));
+   }
+};
+
 struct CerealJit
 {
    template <class Archive>
@@ -57,7 +82,9 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(replace_libc_routines),
+         CEREAL_NVP(verify_libc_routines));
    }
 };
 
@@ -81,6 +108,7 @@ struct CerealSystem
       ar(CEREAL_NVP(region),
          CEREAL_NVP(mlc_path),
          CEREAL_NVP(sdcard_path),
+         CEREAL_NVP(module_cache),
          CEREAL_NVP(timeout_ms));
    }
 };
@@ -97,7 +125,8 @@ bool load(const std::string &path)
 
    try {
       cereal::JSONOptionalInputArchive input(file);
-      input(cereal::make_nvp("jit", CerealJit {}),
+      input(cereal::make_nvp("gpu", CerealGpu {}),
+            cereal::make_nvp("jit", CerealJit {}),
             cereal::make_nvp("log", CerealLog {}),
             cereal::make_nvp("sound", CerealSound {}),
             cereal::make_nvp("system", CerealSystem {}));
@@ -114,7 +143,8 @@ void save(const std::string &path)
 {
    std::ofstream file(path, std::ios::binary);
    cereal::JSONOutputArchive output(file);
-   output(cereal::make_nvp("jit", CerealJit {}),
+   output(cereal::make_nvp("gpu", CerealGpu {}),
+          cereal::make_nvp("jit", CerealJit {}),
           cereal::make_nvp("log", CerealLog {}),
           cereal::make_nvp("sound", CerealSound {}),
           cereal::make_nvp("system", CerealSystem {}));
@@ -11,6 +11,16 @@ extern uint32_t timeout_ms;
 
 } // namespace system
 
+namespace gpu
+{
+
+extern bool packet_stats;
+extern std::string renderer;
+extern uint32_t threads;
+extern std::string dump_path;
+
+} // namespace gpu
+
 namespace log
 {
 
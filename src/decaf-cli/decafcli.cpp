@@ -2,6 +2,7 @@
 #include "config.h"
 #include "libdecaf/decaf_nullgraphicsdriver.h"
 #include "libdecaf/decaf_nullinputdriver.h"
+#include "libdecaf/decaf_softwaregraphicsdriver.h"
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
@@ -13,7 +14,21 @@ DecafCLI::run(const std::string &gamePath)
    int result = 0;
 
    // Setup drivers
-   decaf::setGraphicsDriver(new decaf::NullGraphicsDriver());
+   decaf::GraphicsDriver *graphicsDriver = nullptr;
+
+   if (config::gpu::renderer == "software") {
+      auto options = decaf::SoftwareGraphicsDriverOptions { };
+      options.numThreads = config::gpu::threads;
+      options.dumpPath = config::gpu::dump_path;
+      options.packetStats = config::gpu::packet_stats;
+      graphicsDriver = decaf::createSoftwareGraphicsDriver(options);
+   } else {
+      auto nullDriver = decaf::createNullGraphicsDriver();
+      nullDriver->setPacketStatsEnabled(config::gpu::packet_stats);
+      graphicsDriver = nullDriver;
+   }
+
+   decaf::setGraphicsDriver(graphicsDriver);
    decaf::setInputDriver(new decaf::NullInputDriver());
 
    // Initialise emulator
@@ -39,6 +39,22 @@ getCommandLineParser()
       .add_option("jit-verify",
                   description { "Verify JIT implementation against interpreter." });
 
+   auto gpu_options = parser.add_option_group("GPU Options")
+      .add_option("gpu-packet-stats",
+                  description { "Log the count and processing time of each PM4 packet type on exit." })
+      .add_option("gpu-renderer",
+                  description { "Graphics driver, software renders on the CPU without a GPU." },
+                  default_value<std::string> { "null" },
+                  allowed<std::string> { {
+                     "null", "software"
+                  } })
+      .add_option("gpu-threads",
+                  description { "Number of threads used by the software renderer, 0 uses every hardware thread." },
+                  value<uint32_t> {})
+      .add_option("gpu-dump-path",
+                  description { "Directory to write every frame rendered by the software renderer to." },
+                  value<std::string> {});
+
    auto log_options = parser.add_option_group("Log Options")
       .add_option("log-file",
                   description { "Redirect log output to file." })
@@ -75,6 +91,7 @@ getCommandLineParser()
                   value<uint32_t> {});
 
    parser.add_command("play")
+      .add_option_group(gpu_options)
       .add_option_group(jit_options)
       .add_option_group(log_options)
       .add_option_group(sys_options)
@@ -138,6 +155,22 @@ start(excmd::parser &parser,
       decaf::config::jit::verify = true;
    }
 
+   if (options.has("gpu-packet-stats")) {
+      config::gpu::packet_stats = true;
+   }
+
+   if (options.has("gpu-renderer")) {
+      config::gpu::renderer = options.get<std::string>("gpu-renderer");
+   }
+
+   if (options.has("gpu-threads")) {
+      config::gpu::threads = options.get<uint32_t>("gpu-threads");
+   }
+
+   if (options.has("gpu-dump-path")) {
+      config::gpu::dump_path = options.get<std::string>("gpu-dump-path");
+   }
+
    if (options.has("jit")) {
       decaf::config::jit::enabled = true;
    }
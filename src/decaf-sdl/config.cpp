@@ -112,7 +112,10 @@ struct CerealGPU
       using namespace decaf::config::gpu;
       ar(CEREAL_NVP(debug),
          CEREAL_NVP(debug_filters),
-         CEREAL_NVP(force_sync));
+         CEREAL_NVP(force_sync),
+         CEREAL_NVP(shader_cache),
+         CEREAL_NVP(async_shaders),
+         CEREAL_NVP(skip_pending_shader_draws));
    }
 };
 
@@ -172,7 +175,9 @@ struct CerealLog
          CEREAL_NVP(to_file),
          CEREAL_NVP(to_stdout),
          CEREAL_NVP(kernel_trace),
+         CEREAL_NVP(kernel_trace_log),
          CEREAL_NVP(kernel_trace_res),
+         CEREAL_NVP(kernel_trace_dump),
          CEREAL_NVP(kernel_trace_filters),
          CEREAL_NVP(branch_trace),
          CEREAL_NVP(level));
@@ -186,7 +191,9 @@ struct CerealJit
    {
       using namespace decaf::config::jit;
       ar(CEREAL_NVP(enabled),
-         CEREAL_NVP(verify));
+         CEREAL_NVP(verify),
+         CEREAL_NVP(replace_libc_routines),
+         CEREAL_NVP(verify_libc_routines));
    }
 };
 
@@ -210,7 +217,8 @@ struct CerealSystem
       using namespace decaf::config::system;
       ar(CEREAL_NVP(region),
          CEREAL_NVP(mlc_path),
-         CEREAL_NVP(sdcard_path));
+         CEREAL_NVP(sdcard_path),
+         CEREAL_NVP(module_cache));
    }
 };
 
@@ -529,6 +529,13 @@ DecafSDLOpenGL::initialise(int width, int height)
       return false;
    }
 
+   // Shared with the GPU context so shaders can be linked off the GPU thread
+   mShaderCompilerContext = SDL_GL_CreateContext(mWindow);
+
+   if (!mShaderCompilerContext) {
+      gCliLog->warn("Failed to create shader compiler OpenGL context: {}", SDL_GetError());
+   }
+
    SDL_GL_MakeCurrent(mWindow, mContext);
 
    // Setup decaf driver
@@ -536,6 +543,12 @@ DecafSDLOpenGL::initialise(int width, int height)
    decaf_check(glDriver);
    mDecafDriver = reinterpret_cast<decaf::OpenGLDriver*>(glDriver);
 
+   if (mShaderCompilerContext) {
+      mDecafDriver->setShaderCompilerContext([this]() {
+         SDL_GL_MakeCurrent(mWindow, mShaderCompilerContext);
+      });
+   }
+
    // Setup rendering
    initialiseContext();
    initialiseDraw();
@@ -50,6 +50,7 @@ protected:
 
    SDL_GLContext mContext = nullptr;
    SDL_GLContext mThreadContext = nullptr;
+   SDL_GLContext mShaderCompilerContext = nullptr;
 
    gl::GLuint mVertexProgram;
    gl::GLuint mPixelProgram;
@@ -19,6 +19,8 @@ const uint32_t DBGBREAK_INTERRUPT = 1 << 3;
 const uint32_t GPU_RETIRE_INTERRUPT = 1 << 4;
 const uint32_t GPU_FLIP_INTERRUPT = 1 << 5;
 const uint32_t IPC_INTERRUPT = 1 << 6;
+const uint32_t NETWORK_INTERRUPT = 1 << 7;
+const uint32_t DMAE_INTERRUPT = 1 << 8;
 const uint32_t INTERRUPT_MASK = 0xFFFFFFFF;
 const uint32_t NONMASKABLE_INTERRUPTS = SRESET_INTERRUPT;
 
@@ -38,14 +40,49 @@ static const uint32_t CALLBACK_ADDR = 0xFBADCDE0;
 using EntrypointHandler = std::function<void()>;
 using InterruptHandler = void (*)(uint32_t interrupt_flags);
 using SegfaultHandler = void(*)(uint32_t address);
+using AccessFaultHandler = bool(*)(uint32_t address);
 using IllInstHandler = void(*)();
 using BranchTraceHandler = void(*)(uint32_t target);
 using KernelCallFunction = void(*)(Core *state, void *userData);
 
+// How a value is passed between the guest registers and a host function
+//  called directly from the JIT, see KernelCallDirect
+enum class KernelCallValue
+{
+   None,       // void, only valid as a result
+   Word,       // 32 bit integer or enum
+   Bool,       // bool, any non-zero register value is true
+   Pointer,    // guest address, 0 is translated to nullptr and back
+   DoubleWord, // 64 bit integer in gpr[n] (high) and gpr[n + 1] (low)
+};
+
+// Description of a host function the JIT may call directly from a kc
+//  instruction with the guest argument registers marshalled into host
+//  argument registers, skipping func and the kernel call handler.
+struct KernelCallDirect
+{
+   static constexpr auto MaxArgs = 4u;
+
+   //! Host function to call, nullptr if the kernel call has no direct path
+   void *func = nullptr;
+
+   uint32_t numArgs = 0;
+   KernelCallValue args[MaxArgs] = { };
+   KernelCallValue result = KernelCallValue::None;
+
+   //! Whether func can reschedule the current thread, in which case the
+   //!  core state is looked up again after the call
+   bool canReschedule = true;
+
+   //! When this is non-zero at runtime the kernel call goes through func
+   const bool *disabled = nullptr;
+};
+
 struct KernelCallEntry
 {
    KernelCallFunction func;
    void *user_data;
+   KernelCallDirect direct = { };
 };
 
 void
@@ -66,6 +103,12 @@ setSegfaultHandler(SegfaultHandler handler);
 void
 setIllInstHandler(IllInstHandler handler);
 
+// Called for access violations inside guest memory from any thread before
+//  they are treated as a segfault, returning true means the fault has been
+//  resolved (e.g. by changing page protection) and the access is retried.
+void
+setAccessFaultHandler(AccessFaultHandler handler);
+
 void
 setBranchTraceHandler(BranchTraceHandler handler);
 
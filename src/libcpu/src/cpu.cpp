@@ -32,6 +32,9 @@ gSegfaultHandler;
 IllInstHandler
 gIllInstHandler;
 
+AccessFaultHandler
+gAccessFaultHandler;
+
 BranchTraceHandler
 gBranchTraceHandler;
 
@@ -90,11 +93,6 @@ exceptionHandler(platform::Exception *exception)
       return platform::UnhandledException;
    }
 
-   // Only handle exceptions from the CPU cores
-   if (this_core::id() >= 0xFF) {
-      return platform::UnhandledException;
-   }
-
    // Retreive the exception information
    auto info = reinterpret_cast<platform::AccessViolationException *>(exception);
    auto address = info->address;
@@ -105,6 +103,19 @@ exceptionHandler(platform::Exception *exception)
       return platform::UnhandledException;
    }
 
+   // Give the access fault handler a chance to make the memory accessible,
+   //  this can happen on any thread which touches guest memory.
+   if (address != 0 && gAccessFaultHandler) {
+      if (gAccessFaultHandler(static_cast<uint32_t>(address - memBase))) {
+         return platform::HandledException;
+      }
+   }
+
+   // Only handle exceptions from the CPU cores
+   if (this_core::id() >= 0xFF) {
+      return platform::UnhandledException;
+   }
+
    sSegfaultAddr = static_cast<uint32_t>(address - memBase);
    return coreSegfaultEntry;
 }
@@ -194,6 +205,12 @@ setIllInstHandler(IllInstHandler handler)
    gIllInstHandler = handler;
 }
 
+void
+setAccessFaultHandler(AccessFaultHandler handler)
+{
+   gAccessFaultHandler = handler;
+}
+
 void
 setBranchTraceHandler(BranchTraceHandler handler)
 {
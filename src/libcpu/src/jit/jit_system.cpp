@@ -211,14 +211,143 @@ mtspr(PPCEmuAssembler& a, Instruction instr)
 }
 
 static Core *
-kc_stub(cpu::KernelCallFunction func, void *userData)
+kc_stub(Core *core, cpu::KernelCallFunction func, void *userData)
 {
-   auto core = cpu::this_core::state();
    func(core, userData);
    // We grab new core since it may have changed while executing!
    return cpu::this_core::state();
 }
 
+static Core *
+kc_direct_state()
+{
+   return cpu::this_core::state();
+}
+
+// Load the guest argument register for a direct kernel call into the host
+//  argument register, rax is used as a scratch register.
+static void
+kcDirectArgument(PPCEmuAssembler& a,
+                 const asmjit::X86GpReg &dst,
+                 const asmjit::X86Mem &src,
+                 KernelCallValue type)
+{
+   auto tmp = asmjit::x86::rax;
+
+   switch (type) {
+   case KernelCallValue::Word:
+      a.mov(dst.r32(), src);
+      break;
+   case KernelCallValue::Bool:
+      a.mov(tmp.r32(), src);
+      a.xor_(dst.r32(), dst.r32());
+      a.test(tmp.r32(), tmp.r32());
+      a.setnz(dst.r8());
+      break;
+   case KernelCallValue::Pointer:
+      // 0 stays nullptr, anything else is offset into guest memory
+      a.mov(tmp.r32(), src);
+      a.lea(dst, asmjit::X86Mem(a.membaseReg, tmp, 0, 0));
+      a.test(tmp.r32(), tmp.r32());
+      a.cmovz(dst, tmp);
+      break;
+   default:
+      decaf_abort(fmt::format("Unsupported direct kernel call argument type {}", static_cast<int>(type)));
+   }
+}
+
+// Store the host return value of a direct kernel call from rax into the
+//  guest result registers, rcx is used as a scratch register.
+static void
+kcDirectResult(PPCEmuAssembler& a,
+               KernelCallValue type)
+{
+   auto result = asmjit::x86::rax;
+   auto tmp = asmjit::x86::rcx;
+   auto gpr3 = asmjit::X86Mem(a.stateReg, a.gpr[3].offset, 4);
+   auto gpr4 = asmjit::X86Mem(a.stateReg, a.gpr[4].offset, 4);
+
+   switch (type) {
+   case KernelCallValue::None:
+      break;
+   case KernelCallValue::Word:
+      a.mov(gpr3, result.r32());
+      break;
+   case KernelCallValue::Bool:
+      a.xor_(tmp.r32(), tmp.r32());
+      a.test(result.r8(), result.r8());
+      a.setnz(tmp.r8());
+      a.mov(gpr3, tmp.r32());
+      break;
+   case KernelCallValue::Pointer:
+      // nullptr stays 0, anything else is made relative to guest memory
+      a.mov(tmp, result);
+      a.sub(tmp, a.membaseReg);
+      a.test(result, result);
+      a.cmovz(tmp, result);
+      a.mov(gpr3, tmp.r32());
+      break;
+   case KernelCallValue::DoubleWord:
+      a.mov(gpr4, result.r32());
+      a.shr(result, 32);
+      a.mov(gpr3, result.r32());
+      break;
+   default:
+      decaf_abort(fmt::format("Unsupported direct kernel call result type {}", static_cast<int>(type)));
+   }
+}
+
+// Call the host function of a kernel call directly, jumps to slowLbl when
+//  the direct path is disabled at runtime.
+static void
+kcDirect(PPCEmuAssembler& a,
+         const KernelCallDirect &direct,
+         const asmjit::Label &slowLbl)
+{
+   auto gpr1 = asmjit::X86Mem(a.stateReg, a.gpr[1].offset, 4);
+
+   decaf_check(direct.numArgs <= KernelCallDirect::MaxArgs);
+
+   if (direct.disabled) {
+      a.mov(asmjit::x86::rax, asmjit::Ptr(direct.disabled));
+      a.cmp(asmjit::X86Mem(asmjit::x86::rax, 0, 1), 0);
+      a.jne(slowLbl);
+   }
+
+   if (direct.canReschedule) {
+      // The thread may be switched out, so NIA and the callee backchain
+      //  must be in place like they are for a regular kernel call
+      a.mov(a.niaMem, a.genCia + 4);
+
+      a.mov(asmjit::x86::eax, gpr1);
+      a.lea(asmjit::x86::ecx, asmjit::X86Mem(asmjit::x86::rax, -8));
+      a.mov(gpr1, asmjit::x86::ecx);
+      a.bswap(asmjit::x86::eax);
+      a.mov(asmjit::X86Mem(a.membaseReg, asmjit::x86::rcx, 0, 0, 4), asmjit::x86::eax);
+   }
+
+   for (auto i = 0u; i < direct.numArgs; ++i) {
+      auto src = asmjit::X86Mem(a.stateReg, a.gpr[3 + i].offset, 4);
+      kcDirectArgument(a, a.sysArgReg[i], src, direct.args[i]);
+   }
+
+   a.call(asmjit::Ptr(direct.func));
+
+   if (direct.canReschedule) {
+      // We may have resumed on another core, r12 is callee preserved and
+      //  holds nothing after evictAll so it can keep the result
+      a.mov(asmjit::x86::r12, asmjit::x86::rax);
+      a.call(asmjit::Ptr(&kc_direct_state));
+      a.mov(a.stateReg, asmjit::x86::rax);
+      a.mov(asmjit::x86::rax, asmjit::x86::r12);
+
+      // Release callee backchain
+      a.add(gpr1, 8);
+   }
+
+   kcDirectResult(a, direct.result);
+}
+
 // Kernel call
 static bool
 kc(PPCEmuAssembler& a, Instruction instr)
@@ -230,20 +359,39 @@ kc(PPCEmuAssembler& a, Instruction instr)
    // Evict all stored register as a KC might read or modify them.
    a.evictAll();
 
+   auto niaUnchangedLbl = a.newLabel();
+   auto niaCheckLbl = a.newLabel();
+
+   if (kc->direct.func) {
+      auto slowLbl = a.newLabel();
+      kcDirect(a, kc->direct, slowLbl);
+
+      // A leaf call can not adjust nia, a rescheduling one goes through the
+      //  same check as a regular kernel call
+      if (kc->direct.canReschedule) {
+         a.jmp(niaCheckLbl);
+      } else {
+         a.jmp(niaUnchangedLbl);
+      }
+
+      a.bind(slowLbl);
+   }
+
    // Save NIA back to memory in case KC reads/writes it
    a.mov(a.niaMem, a.genCia + 4);
 
-   // Call the KC
-   a.mov(a.sysArgReg[0], asmjit::Ptr(kc->func));
-   a.mov(a.sysArgReg[1], asmjit::Ptr(kc->user_data));
+   // Call the KC, the current core is already in stateReg so the stub does
+   //  not need to look it up before the call
+   a.mov(a.sysArgReg[0], a.stateReg);
+   a.mov(a.sysArgReg[1], asmjit::Ptr(kc->func));
+   a.mov(a.sysArgReg[2], asmjit::Ptr(kc->user_data));
    a.call(asmjit::Ptr(&kc_stub));
    a.mov(a.stateReg, asmjit::x86::rax);
 
    // Check if the KC adjusted nia.  If it has, we need to return
    //  to the dispatcher.  Note that we assume the cache was already
    //  cleared before this instruction since KC requires that anyways.
-   auto niaUnchangedLbl = a.newLabel();
-
+   a.bind(niaCheckLbl);
    a.cmp(a.niaMem, a.genCia + 4);
    a.je(niaUnchangedLbl);
 
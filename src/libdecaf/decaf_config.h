@@ -30,6 +30,15 @@ extern bool debug;
 // TODO: should really be a std::set, but cereal doesn't support those...
 extern std::vector<unsigned> debug_filters;
 
+//! Keep translated shaders on disk between runs of a title
+extern bool shader_cache;
+
+//! Translate and compile shaders on a separate thread
+extern bool async_shaders;
+
+//! Skip draws whose shaders are still compiling instead of waiting for them
+extern bool skip_pending_shader_draws;
+
 } // namespace gpu
 
 namespace gx2
@@ -52,6 +61,12 @@ extern bool enabled;
 //! Use JIT in verification mode where it compares execution to interpreter
 extern bool verify;
 
+//! Replace statically linked guest libc routines with host implementations
+extern bool replace_libc_routines;
+
+//! Run the original guest routine after each replaced call and compare results
+extern bool verify_libc_routines;
+
 } // namespace jit
 
 namespace log
@@ -60,12 +75,18 @@ namespace log
 //! Enable asynchronous logging
 extern bool async;
 
-//! Enable logging for all HLE function calls
+//! Enable recording of all HLE function calls in the kernel trace ring
 extern bool kernel_trace;
 
-//! Enable logging for all HLE function call results
+//! Enable logging for all traced HLE function calls
+extern bool kernel_trace_log;
+
+//! Enable logging for all traced HLE function call results
 extern bool kernel_trace_res;
 
+//! Write the kernel trace ring to a file when the guest crashes
+extern bool kernel_trace_dump;
+
 //! Enable logging of every branch which targets a known symbol
 extern bool branch_trace;
 
@@ -100,6 +121,9 @@ extern std::string content_path;
 //! Time scale factor for emulated clock
 extern double time_scale;
 
+//! Keep loaded and relocated RPL images on disk between runs of a title
+extern bool module_cache;
+
 } // namespace system
 
 namespace ui
@@ -4,19 +4,26 @@
 namespace decaf
 {
 
+/**
+ * A graphics driver which executes PM4 command buffers without rendering.
+ *
+ * Register state, memory writes, fences, timestamps, occlusion queries and
+ * stream out counters are all processed so GPU synchronised game logic
+ * still works when running headless.
+ */
 class NullGraphicsDriver : public GraphicsDriver
 {
 public:
-   virtual ~NullGraphicsDriver();
+   virtual ~NullGraphicsDriver()
+   {
+   }
 
-   virtual void run() override;
-   virtual void stop() override;
-   virtual float getAverageFPS() override;
-   virtual void notifyCpuFlush(void *ptr, uint32_t size) override;
-   virtual void notifyGpuFlush(void *ptr, uint32_t size) override;
-
-private:
-   bool mRunning = false;
+   // Count and time every PM4 packet, the results are logged when the
+   //  driver is stopped.
+   virtual void setPacketStatsEnabled(bool enabled) = 0;
 };
 
+NullGraphicsDriver *
+createNullGraphicsDriver();
+
 } // namespace decaf
@@ -7,10 +7,55 @@ namespace decaf
 
 #include "decaf_graphics.h"
 
+struct OpenGLShaderStats
+{
+   //! Number of shaders translated since the driver started
+   uint64_t compiled = 0;
+
+   //! Number of draws skipped because their shaders were still compiling
+   uint64_t skippedDraws = 0;
+
+   //! Time from a shader being queued for translation to it being usable
+   double averageLatencyMs = 0.0;
+   double maxLatencyMs = 0.0;
+};
+
+struct OpenGLSurfaceStats
+{
+   //! Lookups which found an existing host surface of the right size
+   uint64_t hits = 0;
+
+   //! Lookups which had to create a host surface
+   uint64_t misses = 0;
+
+   //! Host surfaces filled from guest memory
+   uint64_t uploads = 0;
+
+   //! Surfaces shared with a render target of another format by a view
+   uint64_t views = 0;
+
+   //! Copies between host surfaces on the GPU
+   uint64_t copies = 0;
+};
+
+struct OpenGLDrawStats
+{
+   //! Draws submitted by the title in the last frame
+   uint64_t draws = 0;
+
+   //! OpenGL draw calls made for them, consecutive draws with the same
+   //  state are batched into a single call
+   uint64_t glDraws = 0;
+
+   //! Draws which did not have to check any state since the previous draw
+   uint64_t cleanDraws = 0;
+};
+
 class OpenGLDriver : public GraphicsDriver
 {
 public:
    using SwapFunction = std::function<void(unsigned int, unsigned int)>;
+   using MakeCurrentFunction = std::function<void()>;
 
    virtual ~OpenGLDriver()
    {
@@ -19,6 +64,18 @@ public:
    virtual void getSwapBuffers(unsigned int *tv, unsigned int *drc) = 0;
    virtual void syncPoll(const SwapFunction &swapFunc) = 0;
 
+   // Called on the shader compiler thread to make current a context which
+   //  shares objects with the driver's context. Must be set before run(),
+   //  without it shaders are still translated off thread but linked on the
+   //  GPU thread.
+   virtual void setShaderCompilerContext(const MakeCurrentFunction &makeCurrent) = 0;
+
+   virtual OpenGLShaderStats getShaderStats() = 0;
+
+   virtual OpenGLSurfaceStats getSurfaceStats() = 0;
+
+   virtual OpenGLDrawStats getDrawStats() = 0;
+
 };
 
 } // namespace decaf
@@ -8,11 +8,46 @@ namespace decaf
 namespace pm4
 {
 
+// Original capture format, a raw stream of capture packets
 static const std::array<char, 4> CaptureMagic =
 {
    'D', 'P', 'M', '4'
 };
 
+// Indexed capture format, see CaptureFileHeader
+static const std::array<char, 4> CaptureIndexedMagic =
+{
+   'D', 'P', 'M', 'I'
+};
+
+static const std::array<char, 4> CaptureIndexMagic =
+{
+   'D', 'I', 'D', 'X'
+};
+
+static const uint32_t CaptureVersion = 1;
+
+// Packets in an indexed capture are padded so command buffers stay aligned
+static const uint32_t CapturePacketAlign = 4;
+
+/**
+ * An indexed capture is laid out as:
+ *
+ *    CaptureFileHeader
+ *    Capture packets, each padded to CapturePacketAlign
+ *    Keyframe packet offsets, uint64_t[]
+ *    CaptureFrameIndex[numFrames]
+ *    CaptureIndexFooter
+ *
+ * The index is only written when a capture is finished, a capture with no
+ * footer can still be replayed linearly.
+ */
+struct CaptureFileHeader
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+};
+
 struct CapturePacket
 {
    enum Type : uint32_t
@@ -22,6 +57,8 @@ struct CapturePacket
       MemoryLoad,
       RegisterSnapshot,
       SetBuffer,
+      MemoryData,
+      MemoryLoadRef,
    };
 
    Type type;
@@ -51,6 +88,47 @@ struct CaptureMemoryLoad
    uint32_t address;
 };
 
+// Location of a MemoryData payload in the file, which is zlib compressed
+// when compressedSize is not equal to size.
+struct CaptureDataRef
+{
+   uint64_t offset;
+   uint32_t size;
+   uint32_t compressedSize;
+};
+
+// Loads the contents of a previously written MemoryData packet into memory,
+// identical payloads are only ever written to the capture once.
+struct CaptureMemoryLoadRef
+{
+   CaptureMemoryLoad::MemoryType type;
+   uint32_t address;
+   CaptureDataRef data;
+};
+
+struct CaptureFrameIndex
+{
+   // Range of packets which make up this frame
+   uint64_t offset;
+   uint64_t size;
+
+   // Register state at the start of this frame, empty for the first frame
+   CaptureDataRef registers;
+
+   // Offsets of the SetBuffer and MemoryLoadRef packets which rebuild the
+   // memory state at the start of this frame
+   uint64_t keyframeOffset;
+   uint32_t keyframeCount;
+   uint32_t unused;
+};
+
+struct CaptureIndexFooter
+{
+   uint64_t indexOffset;
+   uint32_t numFrames;
+   std::array<char, 4> magic;
+};
+
 struct CaptureSetBuffer
 {
    enum Type : uint32_t
@@ -0,0 +1,32 @@
+#pragma once
+#include "decaf_graphics.h"
+
+#include <string>
+
+namespace decaf
+{
+
+struct SoftwareGraphicsDriverOptions
+{
+   //! Number of rasteriser threads including the GPU thread, 0 uses one
+   //  per hardware thread.
+   unsigned numThreads = 0;
+
+   //! Directory to write every presented frame to as a PPM image, frames
+   //  are not written when this is empty.
+   std::string dumpPath;
+
+   //! Count and time every PM4 packet, the results are logged when the
+   //  driver is stopped.
+   bool packetStats = false;
+};
+
+/**
+ * A graphics driver which renders on the CPU by interpreting shader
+ * microcode, it needs no GPU and so can be used to inspect the output of
+ * games on headless machines.
+ */
+GraphicsDriver *
+createSoftwareGraphicsDriver(const SoftwareGraphicsDriverOptions &options);
+
+} // namespace decaf
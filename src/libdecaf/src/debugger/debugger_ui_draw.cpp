@@ -4,8 +4,10 @@
 #include "debugger_ui_internal.h"
 #include "decaf_config.h"
 #include "gpu/pm4_capture.h"
+#include "kernel/kernel_hletrace.h"
 #include "kernel/kernel_loader.h"
 #include "modules/coreinit/coreinit_scheduler.h"
+#include <common/platform_dir.h>
 #include <imgui.h>
 #include <map>
 
@@ -257,6 +259,11 @@ draw()
             decaf::config::log::kernel_trace = !decaf::config::log::kernel_trace;
          }
 
+         if (ImGui::MenuItem("Kernel Trace Dump", nullptr, false, decaf::config::log::kernel_trace)) {
+            platform::createDirectory("dump");
+            kernel::dumpHleTrace("dump/kernel_trace.txt");
+         }
+
          auto pm4Enable = false;
          auto pm4Status = false;
 
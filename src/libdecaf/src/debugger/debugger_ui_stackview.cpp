@@ -275,9 +275,9 @@ draw()
 
       // Check if this is a symbol?
       auto data = mem::read<uint32_t>(addr);
-      auto sec = kernel::loader::findSectionForAddress(data);
-      if (sec && sec->type == kernel::loader::LoadedSectionType::Code) {
-         auto symInfo = kernel::loader::findNearestSymbolNameForAddress(data);
+      auto info = kernel::loader::lookupAddress(data);
+      if (info.section && info.section->type == kernel::loader::LoadedSectionType::Code) {
+         auto symInfo = kernel::loader::formatAddressInfo(info);
          ImGui::SetCursorPos(linePos);
          ImGui::Text("<%s>", symInfo.c_str());
       }
@@ -1,7 +1,10 @@
 #include "debugger_ui_internal.h"
+#include "decaf_graphics.h"
+#include "decaf_opengl.h"
 #include "libcpu/cpu.h"
 #include "libcpu/espresso/espresso_instructionid.h"
 #include "libcpu/espresso/espresso_instructionset.h"
+#include "modules/gx2/gx2_aperture.h"
 #include <algorithm>
 #include <chrono>
 #include <cinttypes>
@@ -118,6 +121,76 @@ draw()
       ImGui::TreePop();
    }
 
+   if (ImGui::TreeNode("GX2 Tiling Apertures"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto stats = gx2::internal::getApertureStats();
+      auto drawStat = [](const char *name, uint64_t value) {
+         ImGui::Text("%s", name);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64, value);
+         ImGui::NextColumn();
+         ImGui::NextColumn();
+      };
+
+      drawStat("Allocations", stats.allocations);
+      drawStat("Bytes mapped", stats.bytesMapped);
+      drawStat("Bytes touched", stats.bytesTouched);
+      drawStat("Bytes converted", stats.bytesConverted);
+      ImGui::TreePop();
+   }
+
+#ifndef DECAF_NOGL
+   auto glDriver = dynamic_cast<decaf::OpenGLDriver *>(decaf::getGraphicsDriver());
+
+   if (glDriver && ImGui::TreeNode("GPU Surface Cache"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto stats = glDriver->getSurfaceStats();
+      auto drawStat = [](const char *name, uint64_t value) {
+         ImGui::Text("%s", name);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64, value);
+         ImGui::NextColumn();
+         ImGui::NextColumn();
+      };
+
+      drawStat("Hits", stats.hits);
+      drawStat("Misses", stats.misses);
+      drawStat("Uploads", stats.uploads);
+      drawStat("Views", stats.views);
+      drawStat("Copies", stats.copies);
+      ImGui::TreePop();
+   }
+
+   if (glDriver && ImGui::TreeNode("GPU Draws"))
+   {
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+      ImGui::NextColumn();
+
+      auto stats = glDriver->getDrawStats();
+      auto drawStat = [](const char *name, uint64_t value) {
+         ImGui::Text("%s", name);
+         ImGui::NextColumn();
+         ImGui::Text("%" PRIu64, value);
+         ImGui::NextColumn();
+         ImGui::NextColumn();
+      };
+
+      drawStat("Draws per frame", stats.draws);
+      drawStat("GL draws per frame", stats.glDraws);
+      drawStat("Clean draws per frame", stats.cleanDraws);
+      ImGui::TreePop();
+   }
+#endif
+
    ImGui::Columns(1);
    ImGui::End();
 }
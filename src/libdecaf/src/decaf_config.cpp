@@ -20,6 +20,9 @@ namespace gpu
 
 bool debug = false;
 std::vector<unsigned> debug_filters = {};
+bool shader_cache = true;
+bool async_shaders = true;
+bool skip_pending_shader_draws = false;
 
 } // namespace gpu
 
@@ -36,6 +39,8 @@ namespace jit
 
 bool enabled = true;
 bool verify = false;
+bool replace_libc_routines = false;
+bool verify_libc_routines = false;
 
 } // namespace jit
 
@@ -44,7 +49,9 @@ namespace log
 
 bool async = false;
 bool kernel_trace = false;
+bool kernel_trace_log = false;
 bool kernel_trace_res = false;
+bool kernel_trace_dump = true;
 bool branch_trace = false;
 
 std::vector<std::string> kernel_trace_filters =
@@ -77,6 +84,7 @@ std::string mlc_path = "mlc";
 std::string sdcard_path = "sdcard";
 std::string content_path = {};
 double time_scale = 1.0;
+bool module_cache = false;
 
 } // namespace system
 
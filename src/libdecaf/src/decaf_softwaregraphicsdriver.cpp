@@ -0,0 +1,13 @@
+#include "decaf_softwaregraphicsdriver.h"
+#include "gpu/sw/sw_driver.h"
+
+namespace decaf
+{
+
+GraphicsDriver *
+createSoftwareGraphicsDriver(const SoftwareGraphicsDriverOptions &options)
+{
+   return new gpu::sw::Driver(options);
+}
+
+} // namespace decaf
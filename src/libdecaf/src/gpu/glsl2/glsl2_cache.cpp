@@ -0,0 +1,408 @@
+#include "glsl2_cache.h"
+
+#include <common/log.h>
+#include <common/murmur3.h>
+#include <common/platform_dir.h>
+#include <cstring>
+
+namespace glsl2
+{
+
+static const std::array<char, 4> ShaderCacheMagic =
+{
+   'D', 'S', 'H', 'C'
+};
+
+struct ShaderCacheHeader
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+};
+
+enum class RecordType : uint32_t
+{
+   Shader,
+   Translation,
+};
+
+ShaderCacheKeyBuilder &
+ShaderCacheKeyBuilder::add(gsl::span<const uint8_t> data)
+{
+   mData.insert(mData.end(), data.begin(), data.end());
+   return *this;
+}
+
+ShaderCacheKeyBuilder &
+ShaderCacheKeyBuilder::add(uint32_t value)
+{
+   auto bytes = reinterpret_cast<const uint8_t *>(&value);
+   mData.insert(mData.end(), bytes, bytes + sizeof(value));
+   return *this;
+}
+
+ShaderCacheKey
+ShaderCacheKeyBuilder::finish() const
+{
+   auto key = ShaderCacheKey { };
+   MurmurHash3_x64_128(mData.data(), static_cast<int>(mData.size()), 0, key.data());
+   return key;
+}
+
+class RecordWriter
+{
+public:
+   template<typename Type>
+   void
+   write(const Type &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Only trivial types can be written directly");
+      auto bytes = reinterpret_cast<const uint8_t *>(&value);
+      data.insert(data.end(), bytes, bytes + sizeof(Type));
+   }
+
+   void
+   write(const std::string &value)
+   {
+      write(static_cast<uint32_t>(value.size()));
+      data.insert(data.end(), value.begin(), value.end());
+   }
+
+   template<typename Type>
+   void
+   write(const std::vector<Type> &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Only vectors of trivial types can be written directly");
+      auto bytes = reinterpret_cast<const uint8_t *>(value.data());
+      write(static_cast<uint32_t>(value.size()));
+      data.insert(data.end(), bytes, bytes + value.size() * sizeof(Type));
+   }
+
+   std::vector<uint8_t> data;
+};
+
+class RecordReader
+{
+public:
+   RecordReader(const std::vector<uint8_t> &data) :
+      mData(data)
+   {
+   }
+
+   template<typename Type>
+   bool
+   read(Type &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Only trivial types can be read directly");
+
+      if (mOffset + sizeof(Type) > mData.size()) {
+         return false;
+      }
+
+      std::memcpy(&value, mData.data() + mOffset, sizeof(Type));
+      mOffset += sizeof(Type);
+      return true;
+   }
+
+   bool
+   read(std::string &value)
+   {
+      auto size = uint32_t { 0 };
+
+      if (!read(size) || mOffset + size > mData.size()) {
+         return false;
+      }
+
+      value.assign(reinterpret_cast<const char *>(mData.data() + mOffset), size);
+      mOffset += size;
+      return true;
+   }
+
+   template<typename Type>
+   bool
+   read(std::vector<Type> &value)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Only vectors of trivial types can be read directly");
+      auto count = uint32_t { 0 };
+
+      if (!read(count) || mOffset + count * sizeof(Type) > mData.size()) {
+         return false;
+      }
+
+      value.resize(count);
+      std::memcpy(value.data(), mData.data() + mOffset, count * sizeof(Type));
+      mOffset += count * sizeof(Type);
+      return true;
+   }
+
+private:
+   const std::vector<uint8_t> &mData;
+   size_t mOffset = 0;
+};
+
+static std::vector<uint8_t>
+serialiseShader(const ShaderCacheKey &key,
+                const CachedShader &shader)
+{
+   auto writer = RecordWriter { };
+   writer.write(RecordType::Shader);
+   writer.write(key);
+   writer.write(shader.type);
+   writer.write(shader.code);
+   writer.write(shader.disassembly);
+   writer.write(shader.samplerUsage);
+   writer.write(shader.usedUniformBlocks);
+   writer.write(shader.isScreenSpace);
+   writer.write(shader.outputMap);
+   writer.write(shader.usedFeedbackBuffers);
+   writer.write(shader.binaryFormat);
+   writer.write(shader.binary);
+   return std::move(writer.data);
+}
+
+static bool
+deserialiseShader(RecordReader &reader,
+                  ShaderCacheKey &key,
+                  CachedShader &shader)
+{
+   return reader.read(key)
+       && reader.read(shader.type)
+       && reader.read(shader.code)
+       && reader.read(shader.disassembly)
+       && reader.read(shader.samplerUsage)
+       && reader.read(shader.usedUniformBlocks)
+       && reader.read(shader.isScreenSpace)
+       && reader.read(shader.outputMap)
+       && reader.read(shader.usedFeedbackBuffers)
+       && reader.read(shader.binaryFormat)
+       && reader.read(shader.binary);
+}
+
+static std::vector<uint8_t>
+serialiseTranslation(const ShaderCacheKey &key,
+                     const Shader &shader)
+{
+   auto writer = RecordWriter { };
+   writer.write(RecordType::Translation);
+   writer.write(key);
+   writer.write(shader.type);
+   writer.write(shader.samplerDim);
+   writer.write(shader.fileHeader);
+   writer.write(shader.codeHeader);
+   writer.write(shader.codeBody);
+   writer.write(shader.exports);
+
+   for (auto &feedbacks : shader.feedbacks) {
+      writer.write(feedbacks);
+   }
+
+   writer.write(shader.samplerUsage);
+   writer.write(shader.usedUniformBlocks);
+   writer.write(shader.usesDiscard);
+   return std::move(writer.data);
+}
+
+static bool
+deserialiseTranslation(RecordReader &reader,
+                       ShaderCacheKey &key,
+                       Shader &shader)
+{
+   if (!reader.read(key)
+    || !reader.read(shader.type)
+    || !reader.read(shader.samplerDim)
+    || !reader.read(shader.fileHeader)
+    || !reader.read(shader.codeHeader)
+    || !reader.read(shader.codeBody)
+    || !reader.read(shader.exports)) {
+      return false;
+   }
+
+   for (auto &feedbacks : shader.feedbacks) {
+      if (!reader.read(feedbacks)) {
+         return false;
+      }
+   }
+
+   return reader.read(shader.samplerUsage)
+       && reader.read(shader.usedUniformBlocks)
+       && reader.read(shader.usesDiscard);
+}
+
+ShaderCacheKey
+getTranslationKey(const Shader &shader,
+                  gsl::span<const uint8_t> binary)
+{
+   auto key = ShaderCacheKeyBuilder { };
+   key.add(binary)
+      .add(static_cast<uint32_t>(shader.type))
+      .add(shader.uniformRegistersEnabled ? 1 : 0)
+      .add(shader.uniformBlocksEnabled ? 1 : 0)
+      .add(shader.embedDisassembly ? 1 : 0);
+   return key.finish();
+}
+
+ShaderCache::~ShaderCache()
+{
+   close();
+}
+
+bool
+ShaderCache::open(const std::string &path)
+{
+   close();
+
+   if (platform::fileExists(path)) {
+      auto in = std::ifstream { path, std::ifstream::in | std::ifstream::binary };
+      auto header = ShaderCacheHeader { };
+
+      if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))
+       || header.magic != ShaderCacheMagic
+       || header.version != ShaderCacheVersion) {
+         gLog->info("Discarding out of date shader cache {}", path);
+      } else {
+         auto record = std::vector<uint8_t> { };
+         auto size = uint32_t { 0 };
+
+         // A truncated record at the end means we were killed mid write, just
+         //  ignore it and everything after.
+         while (in.read(reinterpret_cast<char *>(&size), sizeof(size))) {
+            auto key = ShaderCacheKey { };
+            auto type = RecordType { };
+            auto valid = false;
+            record.resize(size);
+
+            if (in.read(reinterpret_cast<char *>(record.data()), size)) {
+               auto reader = RecordReader { record };
+
+               reader.read(type);
+
+               if (type == RecordType::Shader) {
+                  auto shader = CachedShader { };
+                  valid = deserialiseShader(reader, key, shader);
+
+                  if (valid) {
+                     mShaders[key] = std::move(shader);
+                  }
+               } else if (type == RecordType::Translation) {
+                  auto shader = Shader { };
+                  valid = deserialiseTranslation(reader, key, shader);
+
+                  if (valid) {
+                     mTranslations[key] = std::move(shader);
+                  }
+               }
+            }
+
+            if (!valid) {
+               gLog->warn("Ignoring corrupt record in shader cache {}", path);
+               break;
+            }
+         }
+
+         in.close();
+         mOut.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+      }
+   }
+
+   if (!mOut.is_open()) {
+      auto header = ShaderCacheHeader { ShaderCacheMagic, ShaderCacheVersion };
+      mOut.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+      if (!mOut.is_open()) {
+         gLog->error("Could not open shader cache {}", path);
+         return false;
+      }
+
+      mOut.write(reinterpret_cast<const char *>(&header), sizeof(header));
+   }
+
+   gLog->info("Loaded {} shaders and {} translations from shader cache {}", mShaders.size(), mTranslations.size(), path);
+   return true;
+}
+
+void
+ShaderCache::close()
+{
+   if (mOut.is_open()) {
+      mOut.close();
+   }
+
+   mShaders.clear();
+   mTranslations.clear();
+}
+
+const CachedShader *
+ShaderCache::find(const ShaderCacheKey &key) const
+{
+   auto itr = mShaders.find(key);
+
+   if (itr == mShaders.end()) {
+      return nullptr;
+   }
+
+   return &itr->second;
+}
+
+void
+ShaderCache::insert(const ShaderCacheKey &key,
+                    const CachedShader &shader)
+{
+   mShaders[key] = shader;
+   writeRecord(serialiseShader(key, shader));
+}
+
+void
+ShaderCache::erase(const ShaderCacheKey &key)
+{
+   mShaders.erase(key);
+}
+
+bool
+ShaderCache::findTranslation(const ShaderCacheKey &key,
+                             Shader &shader) const
+{
+   auto itr = mTranslations.find(key);
+
+   if (itr == mTranslations.end()) {
+      return false;
+   }
+
+   auto &cached = itr->second;
+
+   for (auto i = 0u; i < cached.samplerUsage.size(); ++i) {
+      if (cached.samplerUsage[i] != SamplerUsage::Invalid
+       && cached.samplerDim[i] != shader.samplerDim[i]) {
+         return false;
+      }
+   }
+
+   shader.fileHeader = cached.fileHeader;
+   shader.codeHeader = cached.codeHeader;
+   shader.codeBody = cached.codeBody;
+   shader.exports = cached.exports;
+   shader.feedbacks = cached.feedbacks;
+   shader.samplerUsage = cached.samplerUsage;
+   shader.usedUniformBlocks = cached.usedUniformBlocks;
+   shader.usesDiscard = cached.usesDiscard;
+   return true;
+}
+
+void
+ShaderCache::insertTranslation(const ShaderCacheKey &key,
+                               const Shader &shader)
+{
+   mTranslations[key] = shader;
+   writeRecord(serialiseTranslation(key, shader));
+}
+
+void
+ShaderCache::writeRecord(const std::vector<uint8_t> &record)
+{
+   if (mOut.is_open()) {
+      auto size = static_cast<uint32_t>(record.size());
+      mOut.write(reinterpret_cast<const char *>(&size), sizeof(size));
+      mOut.write(reinterpret_cast<const char *>(record.data()), record.size());
+      mOut.flush();
+   }
+}
+
+} // namespace glsl2
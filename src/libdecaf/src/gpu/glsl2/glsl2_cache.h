@@ -0,0 +1,139 @@
+#pragma once
+#include "glsl2_translate.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <gsl.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace glsl2
+{
+
+//! Bump whenever the generated GLSL changes so stale caches are discarded
+static const uint32_t ShaderCacheVersion = 5;
+
+//! Hash of a shader binary and every register which affects its translation
+using ShaderCacheKey = std::array<uint64_t, 2>;
+
+//! Builds a ShaderCacheKey from the shader binaries and register state.
+class ShaderCacheKeyBuilder
+{
+public:
+   ShaderCacheKeyBuilder &
+   add(gsl::span<const uint8_t> data);
+
+   ShaderCacheKeyBuilder &
+   add(uint32_t value);
+
+   ShaderCacheKey
+   finish() const;
+
+private:
+   std::vector<uint8_t> mData;
+};
+
+//! Everything a translated shader produces which the driver needs to use it
+//  without running the translator again.
+struct CachedShader
+{
+   Shader::Type type = Shader::Invalid;
+   std::string code;
+   std::string disassembly;
+   std::array<SamplerUsage, latte::MaxSamplers> samplerUsage = { };
+   std::array<bool, latte::MaxUniformBlocks> usedUniformBlocks = { };
+
+   // Vertex shader only
+   bool isScreenSpace = false;
+   std::array<uint8_t, 256> outputMap = { };
+   std::array<bool, latte::MaxStreamOutBuffers> usedFeedbackBuffers = { };
+
+   //! Driver specific program binary, empty if the driver did not give us
+   //  one. Format is the GLenum returned by glGetProgramBinary.
+   uint32_t binaryFormat = 0;
+   std::vector<uint8_t> binary;
+};
+
+//! Hash of a shader binary and the glsl2::translate inputs which do not
+//  depend on how the binary is used, see ShaderCache::findTranslation.
+ShaderCacheKey
+getTranslationKey(const Shader &shader,
+                  gsl::span<const uint8_t> binary);
+
+/**
+ * An on disk cache of translated shaders for one title.
+ *
+ * The file is a header followed by a list of records, new shaders are
+ * appended as they are translated so nothing is lost if the emulator does
+ * not exit cleanly. A record for a key replaces any earlier one.
+ *
+ * Besides the driver's fully translated shaders it can also hold raw
+ * glsl2::translate output, which gfd-tool produces offline from a title's
+ * .gsh files when the register state the driver keys on is not known.
+ */
+class ShaderCache
+{
+public:
+   ~ShaderCache();
+
+   //! Load every shader in the cache file and open it for appending, the
+   //  file is recreated if it is from a different cache version.
+   bool
+   open(const std::string &path);
+
+   void
+   close();
+
+   bool
+   isOpen() const
+   {
+      return mOut.is_open();
+   }
+
+   const CachedShader *
+   find(const ShaderCacheKey &key) const;
+
+   const std::map<ShaderCacheKey, CachedShader> &
+   getShaders() const
+   {
+      return mShaders;
+   }
+
+   void
+   insert(const ShaderCacheKey &key,
+          const CachedShader &shader);
+
+   //! Drop a shader, for example when its program binary is rejected by the
+   //  driver. The record is only removed from the file once it is replaced.
+   void
+   erase(const ShaderCacheKey &key);
+
+   //! Fill in the outputs of shader from a cached translation, only if the
+   //  samplers it uses were translated with the same dimensions.
+   bool
+   findTranslation(const ShaderCacheKey &key,
+                   Shader &shader) const;
+
+   const std::map<ShaderCacheKey, Shader> &
+   getTranslations() const
+   {
+      return mTranslations;
+   }
+
+   void
+   insertTranslation(const ShaderCacheKey &key,
+                     const Shader &shader);
+
+private:
+   void
+   writeRecord(const std::vector<uint8_t> &record);
+
+private:
+   std::map<ShaderCacheKey, CachedShader> mShaders;
+   std::map<ShaderCacheKey, Shader> mTranslations;
+   std::ofstream mOut;
+};
+
+} // namespace glsl2
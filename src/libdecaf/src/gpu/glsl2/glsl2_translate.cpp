@@ -7,7 +7,8 @@
 #include "gpu/microcode/latte_disassembler.h"
 #include "gpu/microcode/latte_instructions.h"
 #include "gpu/opengl/opengl_constants.h"
-#include <map>
+#include <array>
+#include <mutex>
 
 using namespace latte;
 
@@ -16,28 +17,30 @@ namespace glsl2
 
 static const auto IndentSize = 2u;
 
-static std::map<latte::SQ_CF_INST, TranslateFuncCF>
+// Dispatch tables indexed directly by the instruction id, sized to the width
+//  of the instruction field so any decoded id is in range.
+static std::array<TranslateFuncCF, 1 << 7>
 sInstructionMapCF;
 
-static std::map<latte::SQ_CF_EXP_INST, TranslateFuncEXP>
+static std::array<TranslateFuncEXP, 1 << 7>
 sInstructionMapEXP;
 
-static std::map<latte::SQ_OP2_INST, TranslateFuncALU>
+static std::array<TranslateFuncALU, 1 << 11>
 sInstructionMapOP2;
 
-static std::map<latte::SQ_OP3_INST, TranslateFuncALU>
+static std::array<TranslateFuncALU, 1 << 5>
 sInstructionMapOP3;
 
-static std::map<latte::SQ_OP2_INST, TranslateFuncALUReduction>
+static std::array<TranslateFuncALUReduction, 1 << 11>
 sInstructionMapOP2Reduction;
 
-static std::map<latte::SQ_OP3_INST, TranslateFuncALUReduction>
+static std::array<TranslateFuncALUReduction, 1 << 5>
 sInstructionMapOP3Reduction;
 
-static std::map<latte::SQ_TEX_INST, TranslateFuncTEX>
+static std::array<TranslateFuncTEX, 1 << 5>
 sInstructionMapTEX;
 
-static std::map<latte::SQ_VTX_INST, TranslateFuncVTX>
+static std::array<TranslateFuncVTX, 1 << 5>
 sInstructionMapVTX;
 
 static void
@@ -48,10 +51,12 @@ translateTEX(State &state, const ControlFlowInst &cf)
    auto clauseTex = reinterpret_cast<const TextureFetchInst *>(state.binary.data() + 8 * addr);
    auto clauseVtx = reinterpret_cast<const VertexFetchInst *>(state.binary.data() + 8 * addr);
 
-   insertLineStart(state);
-   state.out.write("// {:02} ", state.cfPC);
-   latte::disassembler::disassembleCF(state.out, cf);
-   insertLineEnd(state);
+   if (state.embedDisassembly) {
+      insertLineStart(state);
+      state.out.write("// {:02} ", state.cfPC);
+      latte::disassembler::disassembleCF(state.out, cf);
+      insertLineEnd(state);
+   }
 
    condStart(state, cf.word1.COND());
 
@@ -62,25 +67,27 @@ translateTEX(State &state, const ControlFlowInst &cf)
       auto name = getInstructionName(id);
 
       // Print disassembly
-      insertLineStart(state);
-      state.out.write("// {:02} ", state.groupPC);
-      latte::disassembler::disassembleTexInstruction(state.out, cf, tex);
-      insertLineEnd(state);
+      if (state.embedDisassembly) {
+         insertLineStart(state);
+         state.out.write("// {:02} ", state.groupPC);
+         latte::disassembler::disassembleTexInstruction(state.out, cf, tex);
+         insertLineEnd(state);
+      }
 
       // Translate instruction
       if (id == SQ_TEX_INST_VTX_FETCH || id == SQ_TEX_INST_VTX_SEMANTIC) {
-         auto itr = sInstructionMapVTX.find(vtx.word0.VTX_INST());
+         auto func = sInstructionMapVTX[vtx.word0.VTX_INST()];
 
-         if (itr != sInstructionMapVTX.end()) {
-            itr->second(state, cf, vtx);
+         if (func) {
+            func(state, cf, vtx);
          } else {
             throw translate_exception(fmt::format("Unimplemented VTX instruction {} {}", id, name));
          }
       } else {
-         auto itr = sInstructionMapTEX.find(id);
+         auto func = sInstructionMapTEX[id];
 
-         if (itr != sInstructionMapTEX.end()) {
-            itr->second(state, cf, tex);
+         if (func) {
+            func(state, cf, tex);
          } else {
             throw translate_exception(fmt::format("Unimplemented TEX instruction {} {}", id, name));
          }
@@ -117,15 +124,17 @@ translateNormal(State &state, const ControlFlowInst &cf)
    } else if (id == SQ_CF_INST_VTX || id == SQ_CF_INST_VTX_TC) {
       translateVTX(state, cf);
    } else {
-      auto itr = sInstructionMapCF.find(id);
+      auto func = sInstructionMapCF[id];
 
-      insertLineStart(state);
-      state.out.write("// {:02} ", state.cfPC);
-      latte::disassembler::disassembleCF(state.out, cf);
-      insertLineEnd(state);
+      if (state.embedDisassembly) {
+         insertLineStart(state);
+         state.out.write("// {:02} ", state.cfPC);
+         latte::disassembler::disassembleCF(state.out, cf);
+         insertLineEnd(state);
+      }
 
-      if (itr != sInstructionMapCF.end()) {
-         itr->second(state, cf);
+      if (func) {
+         func(state, cf);
       } else {
          throw translate_exception(fmt::format("Unimplemented CF instruction {} {}", id, name));
       }
@@ -185,36 +194,34 @@ translateALUReduction(State &state, const ControlFlowInst &cf, AluGroup &group)
 
    if (reduction[0].word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
       auto id = reduction[0].op2.ALU_INST();
-      auto itr = sInstructionMapOP2Reduction.find(id);
-      auto name = getInstructionName(id);
+      func = sInstructionMapOP2Reduction[id];
 
-      if (itr != sInstructionMapOP2Reduction.end()) {
-         func = itr->second;
-      } else {
+      if (!func) {
+         auto name = getInstructionName(id);
          throw translate_exception(fmt::format("Unimplemented ALU OP2 Reduction instruction {} {}", id, name));
       }
    } else {
       auto id = reduction[0].op3.ALU_INST();
-      auto itr = sInstructionMapOP3Reduction.find(id);
-      auto name = getInstructionName(id);
+      func = sInstructionMapOP3Reduction[id];
 
-      if (itr != sInstructionMapOP3Reduction.end()) {
-         func = itr->second;
-      } else {
+      if (!func) {
+         auto name = getInstructionName(id);
          throw translate_exception(fmt::format("Unimplemented ALU OP3 Reduction instruction {} {}", id, name));
       }
    }
 
    // Print disassembly
-   insertLineStart(state);
-   state.out.write("// {:02} Reduction", state.groupPC);
-   insertLineEnd(state);
-
-   for (auto i = 0u; i < reduction.size(); ++i) {
+   if (state.embedDisassembly) {
       insertLineStart(state);
-      state.out.write("// ");
-      latte::disassembler::disassembleAluInstruction(state.out, cf, reduction[i], state.groupPC, static_cast<SQ_CHAN>(i), state.literals);
+      state.out.write("// {:02} Reduction", state.groupPC);
       insertLineEnd(state);
+
+      for (auto i = 0u; i < reduction.size(); ++i) {
+         insertLineStart(state);
+         state.out.write("// ");
+         latte::disassembler::disassembleAluInstruction(state.out, cf, reduction[i], state.groupPC, static_cast<SQ_CHAN>(i), state.literals);
+         insertLineEnd(state);
+      }
    }
 
    // Translate the instruction!
@@ -250,10 +257,12 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
    auto clause = reinterpret_cast<const AluInst *>(state.binary.data() + 8 * addr);
    auto didPushBefore = false;
 
-   insertLineStart(state);
-   state.out.write("// {:02} ", state.cfPC);
-   latte::disassembler::disassembleCfALUInstruction(state.out, cf);
-   insertLineEnd(state);
+   if (state.embedDisassembly) {
+      insertLineStart(state);
+      state.out.write("// {:02} ", state.cfPC);
+      latte::disassembler::disassembleCfALUInstruction(state.out, cf);
+      insertLineEnd(state);
+   }
 
    switch (id) {
    case SQ_CF_INST_ALU_PUSH_BEFORE:
@@ -292,22 +301,18 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
 
          if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
             auto instId = inst.op2.ALU_INST();
-            auto itr = sInstructionMapOP2.find(instId);
+            func = sInstructionMapOP2[instId];
             flags = getInstructionFlags(instId);
 
-            if (itr != sInstructionMapOP2.end()) {
-               func = itr->second;
-            } else {
+            if (!func) {
                throw translate_exception(fmt::format("Unimplemented ALU OP2 instruction {} {}", instId, getInstructionName(instId)));
             }
          } else {
             auto instId = inst.op3.ALU_INST();
-            auto itr = sInstructionMapOP3.find(instId);
+            func = sInstructionMapOP3[instId];
             flags = getInstructionFlags(instId);
 
-            if (itr != sInstructionMapOP3.end()) {
-               func = itr->second;
-            } else {
+            if (!func) {
                throw translate_exception(fmt::format("Unimplemented ALU OP3 instruction {} {}", instId, getInstructionName(instId)));
             }
          }
@@ -318,19 +323,23 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
             updatePreviousScalar = true;
          }
 
-         insertLineStart(state);
-         state.out.write("// {:02} ", state.groupPC);
-         latte::disassembler::disassembleAluInstruction(state.out, cf, inst, state.groupPC, state.unit, state.literals);
-         insertLineEnd(state);
+         if (state.embedDisassembly) {
+            insertLineStart(state);
+            state.out.write("// {:02} ", state.groupPC);
+            latte::disassembler::disassembleAluInstruction(state.out, cf, inst, state.groupPC, state.unit, state.literals);
+            insertLineEnd(state);
+         }
 
          if (func) {
             func(state, cf, inst);
          }
       }
 
-      insertLineStart(state);
-      state.out.write("// {:02} --", state.groupPC);
-      insertLineEnd(state);
+      if (state.embedDisassembly) {
+         insertLineStart(state);
+         state.out.write("// {:02} --", state.groupPC);
+         insertLineEnd(state);
+      }
 
       for (auto &write : state.postGroupWrites) {
          insertLineStart(state);
@@ -405,56 +414,60 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
 static void
 initialise()
 {
-   static bool didRegister = false;
-
-   if (didRegister) {
-      return;
-   }
-
-   didRegister = true;
-   registerCfFunctions();
-   registerExpFunctions();
-   registerTexFunctions();
-   registerVtxFunctions();
-   registerOP2Functions();
-   registerOP3Functions();
-   registerOP2ReductionFunctions();
-   registerOP3ReductionFunctions();
+   // Shaders may be translated on the OpenGL driver's compiler thread
+   static std::once_flag didRegister;
+
+   std::call_once(didRegister, []() {
+      registerCfFunctions();
+      registerExpFunctions();
+      registerTexFunctions();
+      registerVtxFunctions();
+      registerOP2Functions();
+      registerOP3Functions();
+      registerOP2ReductionFunctions();
+      registerOP3ReductionFunctions();
+   });
 }
 
 void
 registerInstruction(SQ_CF_INST id, TranslateFuncCF func)
 {
+   decaf_check(id < sInstructionMapCF.size());
    sInstructionMapCF[id] = func;
 }
 
 void
 registerInstruction(SQ_CF_EXP_INST id, TranslateFuncCF func)
 {
+   decaf_check(id < sInstructionMapEXP.size());
    sInstructionMapEXP[id] = func;
 }
 
 void
 registerInstruction(SQ_TEX_INST id, TranslateFuncTEX func)
 {
+   decaf_check(id < sInstructionMapTEX.size());
    sInstructionMapTEX[id] = func;
 }
 
 void
 registerInstruction(SQ_VTX_INST id, TranslateFuncVTX func)
 {
+   decaf_check(id < sInstructionMapVTX.size());
    sInstructionMapVTX[id] = func;
 }
 
 void
 registerInstruction(SQ_OP2_INST id, TranslateFuncALU func)
 {
+   decaf_check(id < sInstructionMapOP2.size());
    sInstructionMapOP2[id] = func;
 }
 
 void
 registerInstruction(SQ_OP3_INST id, TranslateFuncALU func)
 {
+   decaf_check(id < sInstructionMapOP3.size());
    sInstructionMapOP3[id] = func;
 }
 
@@ -462,6 +475,7 @@ void
 registerInstruction(latte::SQ_OP2_INST id,
                     TranslateFuncALUReduction func)
 {
+   decaf_check(id < sInstructionMapOP2Reduction.size());
    sInstructionMapOP2Reduction[id] = func;
 }
 
@@ -469,6 +483,7 @@ void
 registerInstruction(latte::SQ_OP3_INST id,
                     TranslateFuncALUReduction func)
 {
+   decaf_check(id < sInstructionMapOP3Reduction.size());
    sInstructionMapOP3Reduction[id] = func;
 }
 
@@ -502,15 +517,17 @@ static void
 translateExport(State &state, const ControlFlowInst &cf)
 {
    auto id = cf.exp.word1.CF_INST();
-   auto itr = sInstructionMapEXP.find(id);
+   auto func = sInstructionMapEXP[id];
 
-   insertLineStart(state);
-   state.out.write("// {:02} ", state.cfPC);
-   latte::disassembler::disassembleExpInstruction(state.out, cf);
-   insertLineEnd(state);
+   if (state.embedDisassembly) {
+      insertLineStart(state);
+      state.out.write("// {:02} ", state.cfPC);
+      latte::disassembler::disassembleExpInstruction(state.out, cf);
+      insertLineEnd(state);
+   }
 
-   if (itr != sInstructionMapEXP.end()) {
-      itr->second(state, cf);
+   if (func) {
+      func(state, cf);
    } else {
       throw translate_exception(fmt::format("Unimplemented EXP instruction {} {}", id, getInstructionName(id)));
    }
@@ -543,13 +560,15 @@ insertFileHeader(State &state)
       return;
    }
 
+   // Uniform registers are bound after the 16 vertex and 16 pixel uniform
+   //  blocks, as a block so they can be uploaded with one buffer range.
    if (state.shader->uniformRegistersEnabled) {
       if (state.shader->type == Shader::PixelShader) {
-         out << "uniform vec4 PR[256];\n";
+         out << "layout (binding = 33) uniform PixelRegisters {\n   vec4 PR[256];\n};\n";
       } else if (state.shader->type == Shader::VertexShader) {
-         out << "uniform vec4 VR[256];\n";
+         out << "layout (binding = 32) uniform VertexRegisters {\n   vec4 VR[256];\n};\n";
       } else if (state.shader->type == Shader::GeometryShader) {
-         out << "uniform vec4 GR[256];\n";
+         out << "layout (binding = 34) uniform GeometryRegisters {\n   vec4 GR[256];\n};\n";
       }
    }
 
@@ -711,11 +730,31 @@ insertCodeHeader(State &state)
    }
 }
 
+static void
+resetState(State &state)
+{
+   state.shader = nullptr;
+   state.cfPC = 0;
+   state.groupPC = 0;
+   state.out.clear();
+   state.outFileHeader.clear();
+   state.outCodeHeader.clear();
+   state.indent.clear();
+   state.literals = { };
+   state.postGroupWrites.clear();
+   state.loopStack = { };
+}
+
 bool
 translate(Shader &shader, const gsl::span<const uint8_t> &binary)
 {
-   State state;
+   // Keep the output buffers between shaders so they only grow to fit the
+   //  largest shader once per thread, rather than for every shader.
+   static thread_local State state;
+   resetState(state);
+
    state.binary = binary;
+   state.embedDisassembly = shader.embedDisassembly;
    state.shader = &shader;
    state.shader->usedUniformBlocks.fill(false);
    state.shader->samplerUsage.fill(SamplerUsage::Invalid);
@@ -751,9 +790,8 @@ translate(Shader &shader, const gsl::span<const uint8_t> &binary)
          state.cfPC++;
       }
    } catch (translate_exception e) {
-      auto assembly = disassemble(binary);
-      gLog->critical("GLSL translate exception: {}\nDisassembly:\n{}", e.what(), assembly);
-      decaf_abort(fmt::format("GLSL translate exception: {}", e.what()));
+      gLog->error("GLSL translate exception: {}", e.what());
+      return false;
    }
 
    decaf_check(state.loopStack.size() == 0);
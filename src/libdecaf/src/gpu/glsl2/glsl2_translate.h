@@ -62,6 +62,10 @@ struct Shader
    bool uniformRegistersEnabled = false;
    bool uniformBlocksEnabled = false;
 
+   //! Write the disassembly of each instruction as a comment before its
+   //  translation, useful for debugging but slows translation down.
+   bool embedDisassembly = true;
+
    // Output (maybe)
    std::string fileHeader;
    std::string codeHeader;
@@ -93,6 +97,7 @@ struct State
    gsl::span<const uint32_t> literals;
    std::vector<std::string> postGroupWrites;
    std::stack<LoopState> loopStack;
+   bool embedDisassembly = true;
    bool printMyCode = false;
 };
 
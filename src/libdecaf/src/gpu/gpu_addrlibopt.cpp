@@ -717,6 +717,8 @@ copySurfacePixels6(uint8_t *dstBasePtr,
                    uint32_t srcWidth,
                    uint32_t srcHeight,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                   uint32_t firstRow,
+                   uint32_t numRows,
                    AddrFromCoordFunc dstCoordFunc,
                    AddrFromCoordFunc srcCoordFunc)
 {
@@ -729,7 +731,7 @@ copySurfacePixels6(uint8_t *dstBasePtr,
    srcAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
    dstAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
 
-   for (auto y = 0u; y < dstHeight; ++y) {
+   for (auto y = firstRow; y < firstRow + numRows; ++y) {
       for (auto x = 0u; x < dstWidth; ++x) {
          srcAddrInput.x = srcWidth * x / dstWidth;
          srcAddrInput.y = srcHeight * y / dstHeight;
@@ -759,6 +761,8 @@ copySurfacePixels5(uint8_t *dstBasePtr,
                    uint32_t srcWidth,
                    uint32_t srcHeight,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                   uint32_t firstRow,
+                   uint32_t numRows,
                    AddrFromCoordFunc dstCoordFunc)
 {
    AddrFromCoordFunc srcCoordFunc = nullptr;
@@ -817,7 +821,7 @@ copySurfacePixels5(uint8_t *dstBasePtr,
    }
 
    return copySurfacePixels6<NumSamples, IsDepth, Bpp>(
-      dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, dstCoordFunc, srcCoordFunc);
+      dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, dstCoordFunc, srcCoordFunc);
 }
 
 // Selects destination tile mode template
@@ -830,7 +834,9 @@ copySurfacePixels4(uint8_t *dstBasePtr,
                    uint8_t *srcBasePtr,
                    uint32_t srcWidth,
                    uint32_t srcHeight,
-                   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput)
+                   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                   uint32_t firstRow,
+                   uint32_t numRows)
 {
    AddrFromCoordFunc dstCoordFunc = nullptr;
 
@@ -888,7 +894,7 @@ copySurfacePixels4(uint8_t *dstBasePtr,
    }
 
    return copySurfacePixels5<NumSamples, IsDepth, Bpp>(
-      dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, dstCoordFunc);
+      dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, dstCoordFunc);
 }
 
 // Optimized for copying between linear buffers
@@ -901,7 +907,9 @@ copySurfacePixelsLinear(uint8_t *dstBasePtr,
                         uint8_t *srcBasePtr,
                         uint32_t srcWidth,
                         uint32_t srcHeight,
-                        ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput)
+                        ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                        uint32_t firstRow,
+                        uint32_t numRows)
 {
    auto srcBaseAddr = ComputeSurfaceAddrFromCoordLinear<Bpp>(
       0,
@@ -928,8 +936,10 @@ copySurfacePixelsLinear(uint8_t *dstBasePtr,
    auto srcXInc = (static_cast<uint64_t>(srcWidth) << 32) / dstWidth;
    auto srcYInc = (static_cast<uint64_t>(srcHeight) << 32) / dstHeight;
 
-   uint64_t srcYFrac = 0;
-   for (auto y = 0u; y < dstHeight; ++y, dst += dstPitch, srcYFrac += srcYInc) {
+   uint64_t srcYFrac = firstRow * srcYInc;
+   dst += firstRow * dstPitch;
+
+   for (auto y = firstRow; y < firstRow + numRows; ++y, dst += dstPitch, srcYFrac += srcYInc) {
       auto srcY = static_cast<uint32_t>(srcYFrac >> 32);
       auto srcRow = &src[srcY * srcPitch];
       uint64_t srcXFrac = 0;
@@ -955,6 +965,8 @@ copySurfacePixels3(uint8_t *dstBasePtr,
                    uint32_t srcWidth,
                    uint32_t srcHeight,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                   uint32_t firstRow,
+                   uint32_t numRows,
                    uint32_t bpp)
 {
    switch (bpp) {
@@ -962,55 +974,55 @@ copySurfacePixels3(uint8_t *dstBasePtr,
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<8>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 8>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       }
    case 16:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<16>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 16>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       }
    case 32:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<32>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 32>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       }
    case 64:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<64>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 64>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       }
    case 96:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<96>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 96>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       }
    case 128:
       if (TileModeTiling[dstAddrInput.tileMode] == TilingMode::Linear
        && TileModeTiling[srcAddrInput.tileMode] == TilingMode::Linear) {
          return copySurfacePixelsLinear<128>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       } else {
          return copySurfacePixels4<NumSamples, IsDepth, 128>(
-            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+            dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows);
       }
    default:
       decaf_abort("Unexpected bits-per-pixel value");
@@ -1028,15 +1040,17 @@ copySurfacePixels2(uint8_t *dstBasePtr,
                    uint32_t srcWidth,
                    uint32_t srcHeight,
                    ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                   uint32_t firstRow,
+                   uint32_t numRows,
                    uint32_t bpp,
                    bool isDepth)
 {
    if (isDepth) {
       return copySurfacePixels3<NumSamples, true>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp);
+         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, bpp);
    } else {
       return copySurfacePixels3<NumSamples, false>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp);
+         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, bpp);
    }
 }
 
@@ -1050,6 +1064,8 @@ copySurfacePixels(uint8_t *dstBasePtr,
                   uint32_t srcWidth,
                   uint32_t srcHeight,
                   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                  uint32_t firstRow,
+                  uint32_t numRows,
                   uint32_t bpp,
                   bool isDepth,
                   uint32_t numSamples)
@@ -1057,16 +1073,16 @@ copySurfacePixels(uint8_t *dstBasePtr,
    switch (numSamples) {
    case 1:
       return copySurfacePixels2<1>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, bpp, isDepth);
    case 2:
       return copySurfacePixels2<2>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, bpp, isDepth);
    case 4:
       return copySurfacePixels2<4>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, bpp, isDepth);
    case 8:
       return copySurfacePixels2<8>(
-         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, bpp, isDepth);
+         dstBasePtr, dstWidth, dstHeight, dstAddrInput, srcBasePtr, srcWidth, srcHeight, srcAddrInput, firstRow, numRows, bpp, isDepth);
    default:
       decaf_abort("Unexpected number of samples value");
    }
@@ -17,6 +17,8 @@ copySurfacePixels(uint8_t *dstBasePtr,
                   uint32_t srcWidth,
                   uint32_t srcHeight,
                   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                  uint32_t firstRow,
+                  uint32_t numRows,
                   uint32_t bpp,
                   bool isDepth,
                   uint32_t numSamples);
@@ -1,6 +1,7 @@
 #include <common/decaf_assert.h>
 #include "gpu_addrlibopt.h"
 #include "gpu_tiling.h"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -96,13 +97,21 @@ copySurfacePixels(uint8_t *dstBasePtr,
    uint8_t *srcBasePtr,
    uint32_t srcWidth,
    uint32_t srcHeight,
-   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput)
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+   uint32_t firstRow,
+   uint32_t numRows)
 {
    auto handle = getAddrLibHandle();
 
    decaf_check(srcAddrInput.bpp == dstAddrInput.bpp);
    auto bpp = dstAddrInput.bpp;
 
+   if (firstRow >= dstHeight) {
+      return true;
+   }
+
+   numRows = std::min(numRows, dstHeight - firstRow);
+
    if (USE_ADDRLIBOPT) {
       decaf_check(srcAddrInput.isDepth == dstAddrInput.isDepth);
       decaf_check(srcAddrInput.numSamples == dstAddrInput.numSamples);
@@ -112,7 +121,7 @@ copySurfacePixels(uint8_t *dstBasePtr,
       return gpu::addrlibopt::copySurfacePixels(
          dstBasePtr, dstWidth, dstHeight, dstAddrInput,
          srcBasePtr, srcWidth, srcHeight, srcAddrInput,
-         bpp, isDepth, numSamples);
+         firstRow, numRows, bpp, isDepth, numSamples);
    } else {
       ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT srcAddrOutput;
       ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT dstAddrOutput;
@@ -123,7 +132,7 @@ copySurfacePixels(uint8_t *dstBasePtr,
       srcAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
       dstAddrOutput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_OUTPUT);
 
-      for (auto y = 0u; y < dstHeight; ++y) {
+      for (auto y = firstRow; y < firstRow + numRows; ++y) {
          for (auto x = 0u; x < dstWidth; ++x) {
             srcAddrInput.x = srcWidth * x / dstWidth;
             srcAddrInput.y = srcHeight * y / dstHeight;
@@ -144,16 +153,18 @@ copySurfacePixels(uint8_t *dstBasePtr,
 }
 
 bool
-convertFromTiled(
+convertFromTiledSlice(
    uint8_t *output,
    uint32_t outputPitch,
    uint8_t *input,
    latte::SQ_TILE_MODE tileMode,
    uint32_t swizzle,
    uint32_t pitch,
+   uint32_t tiledHeight,
    uint32_t width,
    uint32_t height,
    uint32_t depth,
+   uint32_t slice,
    uint32_t aa,
    bool isDepth,
    uint32_t bpp)
@@ -163,7 +174,7 @@ convertFromTiled(
    srcAddrInput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
    srcAddrInput.bpp = bpp;
    srcAddrInput.pitch = pitch;
-   srcAddrInput.height = height;
+   srcAddrInput.height = tiledHeight;
    srcAddrInput.numSlices = depth;
    srcAddrInput.numSamples = 1 << aa;
    srcAddrInput.tileMode = static_cast<AddrTileMode>(tileMode);
@@ -196,7 +207,92 @@ convertFromTiled(
    srcAddrInput.sample = 0;
    dstAddrInput.sample = 0;
 
+   srcAddrInput.slice = slice;
+   dstAddrInput.slice = slice;
+
+   return copySurfacePixels(
+      output, width, height, dstAddrInput,
+      input, width, height, srcAddrInput);
+}
+
+bool
+convertFromTiled(
+   uint8_t *output,
+   uint32_t outputPitch,
+   uint8_t *input,
+   latte::SQ_TILE_MODE tileMode,
+   uint32_t swizzle,
+   uint32_t pitch,
+   uint32_t width,
+   uint32_t height,
+   uint32_t depth,
+   uint32_t aa,
+   bool isDepth,
+   uint32_t bpp)
+{
    // Untile all of the slices of this surface
+   for (uint32_t slice = 0; slice < depth; ++slice) {
+      convertFromTiledSlice(
+         output, outputPitch, input, tileMode, swizzle, pitch, height,
+         width, height, depth, slice, aa, isDepth, bpp);
+   }
+
+   return true;
+}
+
+bool
+convertToTiled(
+   uint8_t *output,
+   uint8_t *input,
+   uint32_t inputPitch,
+   latte::SQ_TILE_MODE tileMode,
+   uint32_t swizzle,
+   uint32_t pitch,
+   uint32_t width,
+   uint32_t height,
+   uint32_t depth,
+   uint32_t aa,
+   bool isDepth,
+   uint32_t bpp)
+{
+   // Setup src
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT srcAddrInput;
+   std::memset(&srcAddrInput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT));
+   srcAddrInput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
+   srcAddrInput.bpp = bpp;
+   srcAddrInput.pitch = inputPitch;
+   srcAddrInput.height = height;
+   srcAddrInput.numSlices = depth;
+   srcAddrInput.numSamples = 1;
+   srcAddrInput.tileMode = AddrTileMode::ADDR_TM_LINEAR_GENERAL;
+   srcAddrInput.isDepth = isDepth;
+   srcAddrInput.tileBase = 0;
+   srcAddrInput.compBits = 0;
+   srcAddrInput.numFrags = 0;
+   srcAddrInput.bankSwizzle = 0;
+   srcAddrInput.pipeSwizzle = 0;
+
+   ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT dstAddrInput;
+   std::memset(&dstAddrInput, 0, sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT));
+   dstAddrInput.size = sizeof(ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT);
+   dstAddrInput.bpp = bpp;
+   dstAddrInput.pitch = pitch;
+   dstAddrInput.height = height;
+   dstAddrInput.numSlices = depth;
+   dstAddrInput.numSamples = 1 << aa;
+   dstAddrInput.tileMode = static_cast<AddrTileMode>(tileMode);
+   dstAddrInput.isDepth = isDepth;
+   dstAddrInput.tileBase = 0;
+   dstAddrInput.compBits = 0;
+   dstAddrInput.numFrags = 0;
+   calcSurfaceBankPipeSwizzle(swizzle,
+      &dstAddrInput.bankSwizzle,
+      &dstAddrInput.pipeSwizzle);
+
+   // Tiling only ever writes sample 0, the other samples are left untouched
+   srcAddrInput.sample = 0;
+   dstAddrInput.sample = 0;
+
    for (uint32_t slice = 0; slice < depth; ++slice) {
       srcAddrInput.slice = slice;
       dstAddrInput.slice = slice;
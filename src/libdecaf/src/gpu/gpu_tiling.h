@@ -1,6 +1,7 @@
 #pragma once
 #include "gpu/latte_enum_sq.h"
 #include <addrlib/addrinterface.h>
+#include <cstdint>
 
 namespace gpu
 {
@@ -8,6 +9,8 @@ namespace gpu
 ADDR_HANDLE
 getAddrLibHandle();
 
+//! Copies rows [firstRow, firstRow + numRows) of the destination, the
+//  range is clamped to dstHeight.
 bool
 copySurfacePixels(uint8_t *dstBasePtr,
                   uint32_t dstWidth,
@@ -16,7 +19,9 @@ copySurfacePixels(uint8_t *dstBasePtr,
                   uint8_t *srcBasePtr,
                   uint32_t srcWidth,
                   uint32_t srcHeight,
-                  ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput);
+                  ADDR_COMPUTE_SURFACE_ADDRFROMCOORD_INPUT &srcAddrInput,
+                  uint32_t firstRow = 0,
+                  uint32_t numRows = UINT32_MAX);
 
 bool
 convertFromTiled(uint8_t *output,
@@ -32,4 +37,36 @@ convertFromTiled(uint8_t *output,
                  bool isDepth,
                  uint32_t bpp);
 
+//! Untiles a single slice of a surface, tiledHeight is the aligned height
+//  of the tiled surface which is needed to find the slice in it.
+bool
+convertFromTiledSlice(uint8_t *output,
+                      uint32_t outputPitch,
+                      uint8_t *input,
+                      latte::SQ_TILE_MODE tileMode,
+                      uint32_t swizzle,
+                      uint32_t pitch,
+                      uint32_t tiledHeight,
+                      uint32_t width,
+                      uint32_t height,
+                      uint32_t depth,
+                      uint32_t slice,
+                      uint32_t aa,
+                      bool isDepth,
+                      uint32_t bpp);
+
+bool
+convertToTiled(uint8_t *output,
+               uint8_t *input,
+               uint32_t inputPitch,
+               latte::SQ_TILE_MODE tileMode,
+               uint32_t swizzle,
+               uint32_t pitch,
+               uint32_t width,
+               uint32_t height,
+               uint32_t depth,
+               uint32_t aa,
+               bool isDepth,
+               uint32_t bpp);
+
 } // namespace gpu
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "null_driver.h"
+#include "gpu/gpu_commandqueue.h"
+#include "gpu/latte_registers.h"
+#include "gpu/pm4_capture.h"
+#include "modules/coreinit/coreinit_time.h"
+#include "modules/gx2/gx2_event.h"
+
+#include <algorithm>
+#include <common/byte_swap.h>
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <libcpu/mem.h>
+
+namespace gpu
+{
+
+namespace null
+{
+
+Driver::Driver()
+{
+   mRegisters.fill(0);
+}
+
+void
+Driver::run()
+{
+   mRunning = true;
+
+   while (mRunning) {
+      auto buffer = gpu::unqueueCommandBuffer();
+
+      if (mPacketStatsRequested != mPacketStatsEnabled) {
+         mPacketStatsEnabled = mPacketStatsRequested;
+         resetPacketStats();
+      }
+
+      if (!buffer) {
+         continue;
+      }
+
+      executeBuffer(buffer);
+   }
+
+   if (mPacketStatsEnabled) {
+      logPacketStats();
+   }
+}
+
+void
+Driver::stop()
+{
+   mRunning = false;
+
+   // Wake the GPU thread
+   gpu::awaken();
+}
+
+float
+Driver::getAverageFPS()
+{
+   static const auto second = std::chrono::duration_cast<duration_system_clock>(std::chrono::seconds { 1 }).count();
+   auto averageFrameTime = mAverageFrameTime.load();
+
+   if (!averageFrameTime) {
+      return 0.0f;
+   }
+
+   return static_cast<float>(second / averageFrameTime);
+}
+
+void
+Driver::notifyCpuFlush(void *ptr,
+                       uint32_t size)
+{
+}
+
+void
+Driver::notifyGpuFlush(void *ptr,
+                       uint32_t size)
+{
+}
+
+void
+Driver::setPacketStatsEnabled(bool enabled)
+{
+   // Picked up by the GPU thread before it executes the next buffer
+   mPacketStatsRequested = enabled;
+}
+
+void
+Driver::executeBuffer(pm4::Buffer *buffer)
+{
+   // There is no GPU to wait on, so every packet has completed by the time
+   //  runCommandBuffer returns and the buffer can be retired immediately.
+   runCommandBuffer(buffer->buffer, buffer->curSize);
+   gpu::retireCommandBuffer(buffer);
+}
+
+uint64_t
+Driver::getGpuClock()
+{
+   return coreinit::OSGetTime();
+}
+
+void
+Driver::writeEventData(uint32_t addr,
+                       latte::CB_ENDIAN endian,
+                       uint64_t value,
+                       bool is32Bit)
+{
+   auto ptr = mem::translate(addr);
+
+   switch (endian) {
+   case latte::CB_ENDIAN::NONE:
+      break;
+   case latte::CB_ENDIAN::SWAP_8IN64:
+      value = byte_swap(value);
+      break;
+   case latte::CB_ENDIAN::SWAP_8IN32:
+      if (is32Bit) {
+         value = byte_swap(static_cast<uint32_t>(value));
+      } else {
+         value = static_cast<uint64_t>(byte_swap(static_cast<uint32_t>(value)))
+            | (static_cast<uint64_t>(byte_swap(static_cast<uint32_t>(value >> 32))) << 32);
+      }
+      break;
+   case latte::CB_ENDIAN::SWAP_8IN16:
+      decaf_abort(fmt::format("Unexpected event write endian swap {}", endian));
+   }
+
+   if (is32Bit) {
+      *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
+   } else {
+      *reinterpret_cast<uint64_t *>(ptr) = value;
+   }
+}
+
+void
+Driver::decafSetBuffer(const pm4::DecafSetBuffer &data)
+{
+}
+
+void
+Driver::decafCopyColorToScan(const pm4::DecafCopyColorToScan &data)
+{
+}
+
+void
+Driver::decafSwapBuffers(const pm4::DecafSwapBuffers &data)
+{
+   static const auto weight = 0.9;
+
+   gx2::internal::onFlip();
+
+   auto now = std::chrono::system_clock::now();
+
+   if (mLastSwap.time_since_epoch().count()) {
+      auto frameTime = duration_system_clock { now - mLastSwap }.count();
+      mAverageFrameTime = weight * mAverageFrameTime.load() + (1.0 - weight) * frameTime;
+   }
+
+   mLastSwap = now;
+}
+
+void
+Driver::decafCapSyncRegisters(const pm4::DecafCapSyncRegisters &data)
+{
+   pm4::captureSyncGpuRegisters(mRegisters.data(), static_cast<uint32_t>(mRegisters.size()));
+}
+
+void
+Driver::decafClearColor(const pm4::DecafClearColor &data)
+{
+}
+
+void
+Driver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
+{
+}
+
+void
+Driver::decafDebugMarker(const pm4::DecafDebugMarker &data)
+{
+}
+
+void
+Driver::decafOSScreenFlip(const pm4::DecafOSScreenFlip &data)
+{
+   decafSwapBuffers(pm4::DecafSwapBuffers {});
+}
+
+void
+Driver::decafCopySurface(const pm4::DecafCopySurface &data)
+{
+}
+
+void
+Driver::decafSetSwapInterval(const pm4::DecafSetSwapInterval &data)
+{
+   decaf_assert(data.interval <= 10, fmt::format("Bizarre swap interval {}", data.interval));
+}
+
+void
+Driver::countStreamOutVertices(uint32_t count)
+{
+   auto vgt_strmout_en = getRegister<latte::VGT_STRMOUT_EN>(latte::Register::VGT_STRMOUT_EN);
+
+   if (!vgt_strmout_en.STREAMOUT()) {
+      return;
+   }
+
+   auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+   auto vgt_dma_num_instances = getRegister<latte::VGT_DMA_NUM_INSTANCES>(latte::Register::VGT_DMA_NUM_INSTANCES);
+   auto vgt_strmout_buffer_en = getRegister<latte::VGT_STRMOUT_BUFFER_EN>(latte::Register::VGT_STRMOUT_BUFFER_EN);
+   auto numInstances = std::max(1u, vgt_dma_num_instances.NUM_INSTANCES());
+   auto numPrimitives = 0u;
+   auto verticesPerPrimitive = 0u;
+
+   // Stream out always writes list primitives
+   switch (vgt_primitive_type.PRIM_TYPE()) {
+   case latte::VGT_DI_PRIMITIVE_TYPE::POINTLIST:
+      numPrimitives = count;
+      verticesPerPrimitive = 1;
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINELIST:
+      numPrimitives = count / 2;
+      verticesPerPrimitive = 2;
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINESTRIP:
+      numPrimitives = count > 1 ? count - 1 : 0;
+      verticesPerPrimitive = 2;
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINELOOP:
+      numPrimitives = count > 1 ? count : 0;
+      verticesPerPrimitive = 2;
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRILIST:
+      numPrimitives = count / 3;
+      verticesPerPrimitive = 3;
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRISTRIP:
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRIFAN:
+      numPrimitives = count > 2 ? count - 2 : 0;
+      verticesPerPrimitive = 3;
+      break;
+   default:
+      gLog->warn("Unexpected primitive type {} with stream out enabled", vgt_primitive_type.PRIM_TYPE());
+      return;
+   }
+
+   numPrimitives *= numInstances;
+   mStreamOutPrimitivesWritten += numPrimitives;
+
+   for (auto i = 0u; i < latte::MaxStreamOutBuffers; ++i) {
+      if (vgt_strmout_buffer_en.value & (1 << i)) {
+         auto vgt_strmout_vtx_stride = getRegister<uint32_t>(latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + 16 * i);
+         mStreamOutBuffers[i].currentOffset += numPrimitives * verticesPerPrimitive * vgt_strmout_vtx_stride * 4;
+      }
+   }
+}
+
+void
+Driver::drawIndexAuto(const pm4::DrawIndexAuto &data)
+{
+   countStreamOutVertices(data.count);
+}
+
+void
+Driver::drawIndex2(const pm4::DrawIndex2 &data)
+{
+   countStreamOutVertices(data.count);
+}
+
+void
+Driver::drawIndexImmd(const pm4::DrawIndexImmd &data)
+{
+   countStreamOutVertices(data.count);
+}
+
+void
+Driver::memWrite(const pm4::MemWrite &data)
+{
+   auto value = uint64_t { 0 };
+   auto addr = data.addrLo.ADDR_LO() << 2;
+
+   if (data.addrHi.CNTR_SEL() == pm4::MW_WRITE_CLOCK) {
+      value = getGpuClock();
+   } else {
+      value = static_cast<uint64_t>(data.dataLo) | static_cast<uint64_t>(data.dataHi) << 32;
+   }
+
+   writeEventData(addr, data.addrLo.ENDIAN_SWAP(), value, data.addrHi.DATA32());
+}
+
+void
+Driver::eventWrite(const pm4::EventWrite &data)
+{
+   auto type = data.eventInitiator.EVENT_TYPE();
+   auto addr = data.addrLo.ADDR_LO() << 2;
+   auto endian = data.addrLo.ENDIAN_SWAP();
+
+   decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+
+   switch (type) {
+   case latte::VGT_EVENT_TYPE::ZPASS_DONE:
+      writeEventData(addr, endian, mTotalSamplesPassed, false);
+      break;
+   case latte::VGT_EVENT_TYPE::SAMPLE_STREAMOUTSTATS:
+      // NumPrimitivesWritten followed by PrimitiveStorageNeeded, we never
+      //  overflow a buffer so both are the same.
+      writeEventData(addr, endian, mStreamOutPrimitivesWritten, false);
+      writeEventData(addr + 8, endian, mStreamOutPrimitivesWritten, false);
+      break;
+   default:
+      gLog->debug("Unhandled event type {}", type);
+   }
+}
+
+void
+Driver::eventWriteEOP(const pm4::EventWriteEOP &data)
+{
+   auto value = uint64_t { 0 };
+   auto addr = data.addrLo.ADDR_LO() << 2;
+
+   if (!data.eventInitiator.EVENT_TYPE()) {
+      return;
+   }
+
+   decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+
+   switch (data.addrHi.DATA_SEL()) {
+   case pm4::EWP_DATA_DISCARD:
+      break;
+   case pm4::EWP_DATA_32:
+      writeEventData(addr, data.addrLo.ENDIAN_SWAP(), data.dataLo, true);
+      break;
+   case pm4::EWP_DATA_64:
+      value = static_cast<uint64_t>(data.dataLo) | static_cast<uint64_t>(data.dataHi) << 32;
+      writeEventData(addr, data.addrLo.ENDIAN_SWAP(), value, false);
+      break;
+   case pm4::EWP_DATA_CLOCK:
+      writeEventData(addr, data.addrLo.ENDIAN_SWAP(), getGpuClock(), false);
+      break;
+   }
+}
+
+void
+Driver::pfpSyncMe(const pm4::PfpSyncMe &data)
+{
+}
+
+void
+Driver::streamOutBaseUpdate(const pm4::StreamOutBaseUpdate &data)
+{
+}
+
+void
+Driver::streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data)
+{
+   auto bufferIndex = data.control.SELECT_BUFFER();
+   auto &buffer = mStreamOutBuffers[bufferIndex];
+
+   if (data.control.STORE_BUFFER_FILLED_SIZE()) {
+      decaf_assert(data.dstHi == 0, fmt::format("Store target out of 32-bit range for feedback buffer {}", bufferIndex));
+
+      if (data.dstLo != 0) {
+         *mem::translate<uint32_t>(data.dstLo) = byte_swap(buffer.currentOffset >> 2);
+      }
+   }
+
+   switch (data.control.OFFSET_SOURCE()) {
+   case pm4::STRMOUT_OFFSET_FROM_PACKET:
+      decaf_assert(data.srcHi == 0, fmt::format("Offset out of 32-bit range for feedback buffer {}", bufferIndex));
+      buffer.currentOffset = data.srcLo << 2;
+      break;
+   case pm4::STRMOUT_OFFSET_FROM_VGT_FILLED_SIZE:
+      break;
+   case pm4::STRMOUT_OFFSET_FROM_MEM:
+      decaf_assert(data.srcHi == 0, fmt::format("Load target out of 32-bit range for feedback buffer {}", bufferIndex));
+      buffer.currentOffset = byte_swap(*mem::translate<uint32_t>(data.srcLo)) << 2;
+      break;
+   case pm4::STRMOUT_OFFSET_NONE:
+      break;
+   }
+}
+
+void
+Driver::surfaceSync(const pm4::SurfaceSync &data)
+{
+}
+
+void
+Driver::applyRegister(latte::Register reg)
+{
+}
+
+} // namespace null
+
+} // namespace gpu
@@ -0,0 +1,89 @@
+#pragma once
+#include "gpu/latte_constants.h"
+#include "gpu/pm4_buffer.h"
+#include "gpu/pm4_packets.h"
+#include "gpu/pm4_processor.h"
+#include "libdecaf/decaf_nullgraphicsdriver.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace gpu
+{
+
+namespace null
+{
+
+struct StreamOutBufferState
+{
+   //! Offset in bytes of the next vertex written to this buffer
+   uint32_t currentOffset = 0;
+};
+
+class Driver : public decaf::NullGraphicsDriver, public Pm4Processor
+{
+public:
+   Driver();
+   virtual ~Driver() = default;
+
+   void run() override;
+   void stop() override;
+   float getAverageFPS() override;
+
+   void notifyCpuFlush(void *ptr, uint32_t size) override;
+   void notifyGpuFlush(void *ptr, uint32_t size) override;
+
+   void setPacketStatsEnabled(bool enabled) override;
+
+protected:
+   void executeBuffer(pm4::Buffer *buffer);
+   uint64_t getGpuClock();
+   void writeEventData(uint32_t addr, latte::CB_ENDIAN endian, uint64_t value, bool is32Bit);
+   void countStreamOutVertices(uint32_t count);
+
+   void decafSetBuffer(const pm4::DecafSetBuffer &data) override;
+   void decafCopyColorToScan(const pm4::DecafCopyColorToScan &data) override;
+   void decafSwapBuffers(const pm4::DecafSwapBuffers &data) override;
+   void decafCapSyncRegisters(const pm4::DecafCapSyncRegisters &data) override;
+   void decafClearColor(const pm4::DecafClearColor &data) override;
+   void decafClearDepthStencil(const pm4::DecafClearDepthStencil &data) override;
+   void decafDebugMarker(const pm4::DecafDebugMarker &data) override;
+   void decafOSScreenFlip(const pm4::DecafOSScreenFlip &data) override;
+   void decafCopySurface(const pm4::DecafCopySurface &data) override;
+   void decafSetSwapInterval(const pm4::DecafSetSwapInterval &data) override;
+   void drawIndexAuto(const pm4::DrawIndexAuto &data) override;
+   void drawIndex2(const pm4::DrawIndex2 &data) override;
+   void drawIndexImmd(const pm4::DrawIndexImmd &data) override;
+   void memWrite(const pm4::MemWrite &data) override;
+   void eventWrite(const pm4::EventWrite &data) override;
+   void eventWriteEOP(const pm4::EventWriteEOP &data) override;
+   void pfpSyncMe(const pm4::PfpSyncMe &data) override;
+   void streamOutBaseUpdate(const pm4::StreamOutBaseUpdate &data) override;
+   void streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data) override;
+   void surfaceSync(const pm4::SurfaceSync &data) override;
+
+   void applyRegister(latte::Register reg) override;
+
+protected:
+   std::atomic_bool mRunning { false };
+   std::atomic_bool mPacketStatsRequested { false };
+
+   //! Samples passed reported to occlusion queries, we never rasterise so
+   //  this never increases.
+   uint64_t mTotalSamplesPassed = 0;
+
+   //! Number of primitives written to stream out buffers
+   uint64_t mStreamOutPrimitivesWritten = 0;
+   std::array<StreamOutBufferState, latte::MaxStreamOutBuffers> mStreamOutBuffers;
+
+   using duration_system_clock = std::chrono::duration<double, std::chrono::system_clock::period>;
+   std::chrono::time_point<std::chrono::system_clock> mLastSwap;
+
+   //! Average frame time in duration_system_clock ticks, read from other threads
+   std::atomic<double> mAverageFrameTime { 0.0 };
+};
+
+} // namespace null
+
+} // namespace gpu
@@ -50,6 +50,7 @@ bool GLDriver::checkActiveColorBuffer()
       }
 
       auto surfaceObject = surface ? surface->active->object : 0;
+      mColorBufferCache[i].surface = surface;
 
       if (surfaceObject != mColorBufferCache[i].object) {
          mColorBufferCache[i].object = surfaceObject;
@@ -139,10 +140,8 @@ GLDriver::getColorBuffer(latte::CB_COLORN_BASE cb_color_base,
    }
 
    auto tileMode = getArrayModeTileMode(cb_color_info.ARRAY_MODE());
-   auto buffer = getSurfaceBuffer(baseAddress, pitch, pitch, height, 1, 0, latte::SQ_TEX_DIM::DIM_2D, format, numFormat, formatComp, degamma, false, tileMode, true, discardData);
-   buffer->dirtyMemory = false;
-   buffer->needUpload = false;
-   buffer->state = SurfaceUseState::GpuWritten;
+   auto buffer = getSurfaceBuffer(baseAddress, 0, pitch, pitch, height, 1, 0, latte::SQ_TEX_DIM::DIM_2D, format, numFormat, formatComp, degamma, false, tileMode, 1, true, discardData);
+   markSurfaceGpuWritten(buffer);
    return buffer;
 }
 
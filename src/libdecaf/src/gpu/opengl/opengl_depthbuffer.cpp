@@ -38,6 +38,7 @@ bool GLDriver::checkActiveDepthBuffer()
    }
 
    auto surfaceObject = surface ? surface->active->object : 0;
+   mDepthBufferCache.surface = surface;
 
    if (format != latte::DB_FORMAT::DEPTH_8_24
     && format != latte::DB_FORMAT::DEPTH_8_24_FLOAT
@@ -144,11 +145,8 @@ GLDriver::getDepthBuffer(latte::DB_DEPTH_BASE db_depth_base,
 
    auto tileMode = getArrayModeTileMode(db_depth_info.ARRAY_MODE());
 
-   auto buffer = getSurfaceBuffer(baseAddress, pitch, pitch, height, 1, 0, latte::SQ_TEX_DIM::DIM_2D, format, numFormat, formatComp, degamma, true, tileMode, true, discardData);
-
-   buffer->dirtyMemory = false;
-   buffer->needUpload = false;
-   buffer->state = SurfaceUseState::GpuWritten;
+   auto buffer = getSurfaceBuffer(baseAddress, 0, pitch, pitch, height, 1, 0, latte::SQ_TEX_DIM::DIM_2D, format, numFormat, formatComp, degamma, true, tileMode, 1, true, discardData);
+   markSurfaceGpuWritten(buffer);
    return buffer;
 }
 
@@ -1,8 +1,11 @@
 #ifndef DECAF_NOGL
 
+#include <common/byte_swap_array.h>
 #include <common/decaf_assert.h>
+#include <common/murmur3.h>
 #include "decaf_config.h"
 #include "opengl_driver.h"
+#include <cstring>
 #include <glbinding/gl/gl.h>
 #include <glbinding/Meta.h>
 
@@ -12,55 +15,126 @@ namespace gpu
 namespace opengl
 {
 
+// Index data which changes more often than this is always streamed
+static const auto MAX_INDEX_BUFFER_CHANGES = 8u;
+
 bool GLDriver::checkReadyDraw()
 {
-   if (!checkActiveShader()) {
-      gLog->warn("Skipping draw with invalid shader.");
-      return false;
+   mDrawStats.draws++;
+
+   if (mCpuMemoryFlushed.load(std::memory_order_relaxed) && mCpuMemoryFlushed.exchange(false)) {
+      // Uniform blocks are copied from guest memory whenever it is flushed
+      mDirtyDrawState |= DrawState::Uniforms;
    }
 
-   if (!checkActiveAttribBuffers()) {
-      gLog->warn("Skipping draw with invalid attribs.");
-      return false;
+   if (mDirtyDrawState || mFramebufferChanged || mViewportDirty || mDepthRangeDirty || mScissorDirty) {
+      // Any queued draws must be issued before the state they use changes
+      flushDrawBatch();
+   } else {
+      mDrawStats.cleanDraws++;
    }
 
-   if (!checkActiveUniforms()) {
-      gLog->warn("Skipping draw with invalid uniforms.");
-      return false;
+   // Each group is cleared before it is checked so a check which marks its
+   //  own group dirty again, or fails, is run again for the next draw.
+   auto checkDirty = [this](uint32_t group) {
+      if (!(mDirtyDrawState & group)) {
+         return false;
+      }
+
+      mDirtyDrawState &= ~group;
+      return true;
+   };
+
+   if (checkDirty(DrawState::Shader)) {
+      auto previousShader = mActiveShader;
+
+      if (!checkActiveShader()) {
+         mDirtyDrawState |= DrawState::Shader;
+
+         if (!mActiveShaderPending) {
+            gLog->warn("Skipping draw with invalid shader.");
+         }
+
+         return false;
+      }
+
+      if (mActiveShader != previousShader) {
+         mDirtyDrawState |= DrawState::ShaderResources;
+         mViewportDirty = true;
+      }
    }
 
-   if (!checkActiveFeedbackBuffers()) {
-      gLog->warn("Skipping draw with invalid feedback buffers.");
-      return false;
+   if (checkDirty(DrawState::AttribBuffers)) {
+      if (!checkActiveAttribBuffers()) {
+         mDirtyDrawState |= DrawState::AttribBuffers;
+         gLog->warn("Skipping draw with invalid attribs.");
+         return false;
+      }
+
+      if (!checkAttribBuffersBound()) {
+         mDirtyDrawState |= DrawState::AttribBuffers;
+         static bool hasWarned = false;
+         if (!hasWarned) {
+            gLog->warn("The application is performing draws with unbound attribute buffers.");
+            hasWarned = true;
+         }
+         return false;
+      }
    }
 
-   if (!checkActiveTextures()) {
-      gLog->warn("Skipping draw with invalid textures.");
-      return false;
+   if (checkDirty(DrawState::Uniforms)) {
+      if (!checkActiveUniforms()) {
+         mDirtyDrawState |= DrawState::Uniforms;
+         gLog->warn("Skipping draw with invalid uniforms.");
+         return false;
+      }
    }
 
-   if (!checkActiveSamplers()) {
-      gLog->warn("Skipping draw with invalid samplers.");
+   if (!checkActiveFeedbackBuffers()) {
+      gLog->warn("Skipping draw with invalid feedback buffers.");
       return false;
    }
 
-   if (!checkActiveColorBuffer()) {
-      gLog->warn("Skipping draw with invalid color buffer.");
-      return false;
+   if (checkDirty(DrawState::Textures)) {
+      if (!checkActiveTextures()) {
+         mDirtyDrawState |= DrawState::Textures;
+         gLog->warn("Skipping draw with invalid textures.");
+         return false;
+      }
    }
 
-   if (!checkActiveDepthBuffer()) {
-      gLog->warn("Skipping draw with invalid depth buffer.");
-      return false;
+   if (checkDirty(DrawState::Samplers)) {
+      if (!checkActiveSamplers()) {
+         mDirtyDrawState |= DrawState::Samplers;
+         gLog->warn("Skipping draw with invalid samplers.");
+         return false;
+      }
    }
 
-   if (!checkAttribBuffersBound()) {
-      static bool hasWarned = false;
-      if (!hasWarned) {
-         gLog->warn("The application is performing draws with unbound attribute buffers.");
-         hasWarned = true;
+   if (checkDirty(DrawState::ColorBuffer)) {
+      if (!checkActiveColorBuffer()) {
+         mDirtyDrawState |= DrawState::ColorBuffer;
+         gLog->warn("Skipping draw with invalid color buffer.");
+         return false;
       }
-      return false;
+   } else {
+      // The same render targets are written again, so textures aliasing
+      //  them must see a new serial, see refreshSurfaceAlias.
+      for (auto &cache : mColorBufferCache) {
+         if (cache.surface) {
+            markSurfaceGpuWritten(cache.surface);
+         }
+      }
+   }
+
+   if (checkDirty(DrawState::DepthBuffer)) {
+      if (!checkActiveDepthBuffer()) {
+         mDirtyDrawState |= DrawState::DepthBuffer;
+         gLog->warn("Skipping draw with invalid depth buffer.");
+         return false;
+      }
+   } else if (mDepthBufferCache.surface) {
+      markSurfaceGpuWritten(mDepthBufferCache.surface);
    }
 
    if (mFramebufferChanged) {
@@ -107,30 +181,37 @@ getPrimitiveMode(latte::VGT_DI_PRIMITIVE_TYPE type)
    }
 }
 
-template<typename IndexType>
+// Primitives OpenGL can not draw are converted into triangle lists
+enum class IndexUnpack : uint32_t
+{
+   None,
+   Quads,
+   Rects,
+};
+
 static void
 drawPrimitives2(gl::GLenum mode,
                 uint32_t count,
-                const IndexType *indices,
+                gl::GLenum indexType,
+                uint32_t indexOffset,
                 uint32_t baseVertex,
                 uint32_t numInstances,
                 uint32_t baseInstance)
 {
+   // Indices are always read from the bound GL_ELEMENT_ARRAY_BUFFER
+   auto indices = reinterpret_cast<const void *>(static_cast<uintptr_t>(indexOffset));
+
    if (numInstances == 1) {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArrays(mode, baseVertex, count);
-      } else if (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_SHORT, indices, baseVertex);
-      } else if (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_INT, indices, baseVertex);
+      } else {
+         gl::glDrawElementsBaseVertex(mode, count, indexType, indices, baseVertex);
       }
    } else {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArraysInstancedBaseInstance(mode, 0, count, numInstances, baseInstance);
-      } else if (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_SHORT, indices, numInstances, baseInstance);
-      } else if (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_INT, indices, numInstances, baseInstance);
+      } else {
+         gl::glDrawElementsInstancedBaseInstance(mode, count, indexType, indices, numInstances, baseInstance);
       }
    }
 }
@@ -138,15 +219,9 @@ drawPrimitives2(gl::GLenum mode,
 template<bool IsRects, typename IndexType>
 static void
 unpackQuadRectList(uint32_t count,
-               const IndexType *src,
-               uint32_t baseVertex,
-               uint32_t numInstances,
-               uint32_t baseInstance)
+                   const IndexType *src,
+                   IndexType *dst)
 {
-   auto tris = (count / 4) * 6;
-   auto unpacked = std::vector<IndexType>(tris);
-   auto dst = &unpacked[0];
-
    // Unpack quad indices into triangle indices
    if (src) {
       for (auto i = 0u; i < count / 4; ++i) {
@@ -194,14 +269,89 @@ unpackQuadRectList(uint32_t count,
          }
       }
    }
+}
+
+template<typename IndexType>
+static void
+convertIndices(IndexUnpack unpack,
+               bool swap,
+               uint32_t count,
+               const IndexType *src,
+               IndexType *dst,
+               std::vector<uint8_t> &scratch)
+{
+   if (src && swap) {
+      if (unpack == IndexUnpack::None) {
+         byte_swap_array(src, dst, count);
+         return;
+      }
+
+      // Swap before unpacking so the unpack can use whole vectors
+      scratch.resize(count * sizeof(IndexType));
+      auto swapped = reinterpret_cast<IndexType *>(scratch.data());
+      byte_swap_array(src, swapped, count);
+      src = swapped;
+   }
+
+   if (unpack == IndexUnpack::Quads) {
+      unpackQuadRectList<false>(count, src, dst);
+   } else if (unpack == IndexUnpack::Rects) {
+      unpackQuadRectList<true>(count, src, dst);
+   } else {
+      std::memcpy(dst, src, count * sizeof(IndexType));
+   }
+}
+
+IndexBuffer *
+GLDriver::getIndexBuffer(uint32_t address,
+                         uint32_t count,
+                         uint32_t format,
+                         uint32_t size)
+{
+   auto &buffer = mIndexBuffers[IndexBufferKey { address, count, format }];
+
+   if (!buffer) {
+      buffer = new IndexBuffer;
+      buffer->cpuMemStart = address;
+      buffer->cpuMemEnd = address + size;
+
+      // Generated indices have no guest memory and never change
+      if (address) {
+         mResourceMap.addResource(buffer);
+      } else {
+         buffer->dirtyMemory = false;
+      }
+   }
+
+   if (buffer->dirtyMemory) {
+      buffer->dirtyMemory = false;
+
+      if (buffer->changes > MAX_INDEX_BUFFER_CHANGES) {
+         // Streamed every draw anyway, so there is nothing to compare against
+         buffer->valid = false;
+      } else {
+         uint64_t newHash[2] = { 0, 0 };
+         MurmurHash3_x64_128(mem::translate(address), size, 0, newHash);
+
+         if (newHash[0] != buffer->cpuMemHash[0] || newHash[1] != buffer->cpuMemHash[1]) {
+            buffer->cpuMemHash[0] = newHash[0];
+            buffer->cpuMemHash[1] = newHash[1];
+            buffer->valid = false;
+            buffer->changes++;
+         }
+      }
+   }
 
-   drawPrimitives2(gl::GL_TRIANGLES, tris, unpacked.data(), baseVertex, numInstances, baseInstance);
+   buffer->draws++;
+   return buffer;
 }
 
 void
 GLDriver::drawPrimitives(uint32_t count,
                          const void *indices,
-                         latte::VGT_INDEX_TYPE indexFmt)
+                         latte::VGT_INDEX_TYPE indexFmt,
+                         latte::VGT_DMA_SWAP swapMode,
+                         bool cacheable)
 {
    auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
    auto vgt_dma_num_instances = getRegister<latte::VGT_DMA_NUM_INSTANCES>(latte::Register::VGT_DMA_NUM_INSTANCES);
@@ -215,6 +365,20 @@ GLDriver::drawPrimitives(uint32_t count,
    auto baseInstance = sq_vtx_start_inst_loc.OFFSET();
 
    auto mode = getPrimitiveMode(primType);
+   auto unpack = IndexUnpack::None;
+
+   if (primType == latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST) {
+      unpack = IndexUnpack::Quads;
+   } else if (primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST) {
+      unpack = IndexUnpack::Rects;
+   }
+
+   auto isIndexed = (indices || unpack != IndexUnpack::None);
+   auto canBatch = isIndexed && numInstances == 1 && !vgt_strmout_en.STREAMOUT();
+
+   if (!canBatch) {
+      flushDrawBatch();
+   }
 
    if (vgt_strmout_en.STREAMOUT()) {
       auto baseMode = mode;
@@ -236,23 +400,84 @@ GLDriver::drawPrimitives(uint32_t count,
       }
    }
 
-   if (primType == latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST) {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
+   if (!isIndexed) {
+      drawPrimitives2(mode, count, gl::GL_NONE, 0, baseVertex, numInstances, baseInstance);
+      mDrawStats.glDraws++;
+   } else {
+      auto is16Bit = (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16);
+      auto indexBytes = is16Bit ? 2u : 4u;
+      auto drawCount = (unpack == IndexUnpack::None) ? count : (count / 4) * 6;
+      auto size = drawCount * indexBytes;
+      auto object = gl::GLuint { 0 };
+      auto offset = uint32_t { 0 };
+      IndexBuffer *buffer = nullptr;
+
+      if (cacheable) {
+         auto address = indices ? mem::untranslate(indices) : 0u;
+         auto format = static_cast<uint32_t>(indexFmt)
+                     | (static_cast<uint32_t>(swapMode) << 4)
+                     | (static_cast<uint32_t>(unpack) << 8);
+         buffer = getIndexBuffer(address, count, format, count * indexBytes);
       }
-   } else if (primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST) {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
+
+      if (buffer && buffer->valid) {
+         object = buffer->object;
+      } else {
+         auto swap = (swapMode != latte::VGT_DMA_SWAP::NONE);
+         auto dst = allocateStreamBuffer(size, indexBytes, offset);
+         object = mStreamBuffer.getObject();
+
+         if (!dst) {
+            // Too large for the stream buffer, convert into client memory
+            //  and give the indices a buffer of their own.
+            mLargeIndices.resize(size);
+            dst = mLargeIndices.data();
+            object = 0;
+            offset = 0;
+         }
+
+         if (is16Bit) {
+            convertIndices(unpack, swap, count, reinterpret_cast<const uint16_t *>(indices), reinterpret_cast<uint16_t *>(dst), mIndexScratch);
+         } else {
+            convertIndices(unpack, swap, count, reinterpret_cast<const uint32_t *>(indices), reinterpret_cast<uint32_t *>(dst), mIndexScratch);
+         }
+
+         if (!object) {
+            object = allocateTransientBuffer(dst, size);
+         }
+
+         // Keep a converted copy of indices which are drawn more than once
+         if (buffer && buffer->draws > 1 && buffer->changes <= MAX_INDEX_BUFFER_CHANGES) {
+            if (!buffer->object) {
+               gl::glCreateBuffers(1, &buffer->object);
+               gl::glNamedBufferStorage(buffer->object, size, nullptr, gl::BufferStorageMask::GL_NONE_BIT);
+
+               if (decaf::config::gpu::debug) {
+                  auto label = fmt::format("index buffer @ 0x{:08X}", buffer->cpuMemStart);
+                  gl::glObjectLabel(gl::GL_BUFFER, buffer->object, -1, label.c_str());
+               }
+            }
+
+            // Queued draws may still read the old indices
+            if (mDrawBatch.indexBuffer == buffer->object) {
+               flushDrawBatch();
+            }
+
+            gl::glCopyNamedBufferSubData(object, buffer->object, offset, 0, size);
+            buffer->valid = true;
+            object = buffer->object;
+            offset = 0;
+         }
       }
-   } else {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
+
+      auto indexType = is16Bit ? gl::GL_UNSIGNED_SHORT : gl::GL_UNSIGNED_INT;
+
+      if (canBatch) {
+         queueDraw(mode, drawCount, indexType, object, offset, baseVertex);
+      } else {
+         gl::glBindBuffer(gl::GL_ELEMENT_ARRAY_BUFFER, object);
+         drawPrimitives2(mode, drawCount, indexType, offset, baseVertex, numInstances, baseInstance);
+         mDrawStats.glDraws++;
       }
    }
 
@@ -261,56 +486,87 @@ GLDriver::drawPrimitives(uint32_t count,
    }
 }
 
+void
+GLDriver::queueDraw(gl::GLenum mode,
+                    uint32_t count,
+                    gl::GLenum indexType,
+                    gl::GLuint indexBuffer,
+                    uint32_t indexOffset,
+                    uint32_t baseVertex)
+{
+   auto &batch = mDrawBatch;
+
+   if (!batch.counts.empty()
+    && (batch.mode != mode || batch.indexType != indexType || batch.indexBuffer != indexBuffer)) {
+      flushDrawBatch();
+   }
+
+   batch.mode = mode;
+   batch.indexType = indexType;
+   batch.indexBuffer = indexBuffer;
+   batch.counts.push_back(static_cast<gl::GLsizei>(count));
+   batch.offsets.push_back(reinterpret_cast<const void *>(static_cast<uintptr_t>(indexOffset)));
+   batch.baseVertices.push_back(static_cast<gl::GLint>(baseVertex));
+}
+
+void
+GLDriver::flushDrawBatch()
+{
+   auto &batch = mDrawBatch;
+
+   if (batch.counts.empty()) {
+      return;
+   }
+
+   gl::glBindBuffer(gl::GL_ELEMENT_ARRAY_BUFFER, batch.indexBuffer);
+
+   if (batch.counts.size() == 1) {
+      gl::glDrawElementsBaseVertex(batch.mode, batch.counts[0], batch.indexType, batch.offsets[0], batch.baseVertices[0]);
+   } else {
+      gl::glMultiDrawElementsBaseVertex(batch.mode,
+                                        batch.counts.data(),
+                                        batch.indexType,
+                                        batch.offsets.data(),
+                                        static_cast<gl::GLsizei>(batch.counts.size()),
+                                        batch.baseVertices.data());
+   }
+
+   mDrawStats.glDraws++;
+   batch.indexBuffer = 0;
+   batch.counts.clear();
+   batch.offsets.clear();
+   batch.baseVertices.clear();
+}
+
 void
 GLDriver::drawPrimitivesIndexed(const void *buffer,
-                                uint32_t count)
+                                uint32_t count,
+                                bool cacheable)
 {
    if (!checkReadyDraw()) {
       return;
    }
 
    auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
+   auto swapMode = vgt_dma_index_type.SWAP_MODE();
+   auto indexType = vgt_dma_index_type.INDEX_TYPE();
 
    // Swap and indexBytes are separate because you can have 32-bit swap,
    //   but 16-bit indices in some cases...  This is also why we pre-swap
    //   the data before intercepting QUAD and POLYGON draws.
-   if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_16_BIT) {
-      auto *src = reinterpret_cast<const uint16_t *>(buffer);
-      auto indices = std::vector<uint16_t>(count);
-
-      if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_16) {
-         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", vgt_dma_index_type.INDEX_TYPE()));
-      }
-
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
+   if (swapMode == latte::VGT_DMA_SWAP::SWAP_16_BIT) {
+      if (indexType != latte::VGT_INDEX_TYPE::INDEX_16) {
+         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", indexType));
       }
-
-      drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
-      auto *src = reinterpret_cast<const uint32_t *>(buffer);
-      auto indices = std::vector<uint32_t>(count);
-
-      if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_32) {
-         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", vgt_dma_index_type.INDEX_TYPE()));
+   } else if (swapMode == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
+      if (indexType != latte::VGT_INDEX_TYPE::INDEX_32) {
+         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", indexType));
       }
-
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
-
-      drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::NONE) {
-      drawPrimitives(count,
-                     buffer,
-                     vgt_dma_index_type.INDEX_TYPE());
-   } else {
-      decaf_abort(fmt::format("Unimplemented vgt_dma_index_type.SWAP_MODE {}", vgt_dma_index_type.SWAP_MODE()));
+   } else if (swapMode != latte::VGT_DMA_SWAP::NONE) {
+      decaf_abort(fmt::format("Unimplemented vgt_dma_index_type.SWAP_MODE {}", swapMode));
    }
+
+   drawPrimitives(count, buffer, indexType, swapMode, cacheable);
 }
 
 void
@@ -322,19 +578,37 @@ GLDriver::drawIndexAuto(const pm4::DrawIndexAuto &data)
 
    drawPrimitives(data.count,
                   nullptr,
-                  latte::VGT_INDEX_TYPE::INDEX_32);
+                  latte::VGT_INDEX_TYPE::INDEX_32,
+                  latte::VGT_DMA_SWAP::NONE,
+                  true);
 }
 
 void
 GLDriver::drawIndex2(const pm4::DrawIndex2 &data)
 {
-   drawPrimitivesIndexed(data.addr, data.count);
+   drawPrimitivesIndexed(data.addr, data.count, true);
 }
 
 void
 GLDriver::drawIndexImmd(const pm4::DrawIndexImmd &data)
 {
-   drawPrimitivesIndexed(data.indices.data(), data.count);
+   // drawPrimitivesIndexed expects host ordered index words, a span read
+   //  from a command buffer points at the big endian words in guest memory
+   //  so those are copied out, swapping each word on access.
+   auto indices = data.indices.data();
+
+   if (data.indices.isBigEndian()) {
+      mImmediateIndices.resize(data.indices.size());
+
+      for (auto i = 0u; i < mImmediateIndices.size(); ++i) {
+         mImmediateIndices[i] = data.indices[i];
+      }
+
+      indices = mImmediateIndices.data();
+   }
+
+   // These are different every time, so stream them rather than caching
+   drawPrimitivesIndexed(indices, data.count, false);
 }
 
 void
@@ -347,6 +621,8 @@ GLDriver::decafClearColor(const pm4::DecafClearColor &data)
       data.alpha
    };
 
+   flushDrawBatch();
+
    // Find our colorbuffer to clear
    auto buffer = getColorBuffer(data.cb_color_base, data.cb_color_size, data.cb_color_info, true);
 
@@ -364,6 +640,7 @@ GLDriver::decafClearColor(const pm4::DecafClearColor &data)
    // Clear color buffer
    glColorMaski(0, gl::GL_TRUE, gl::GL_TRUE, gl::GL_TRUE, gl::GL_TRUE);
    mColorBufferCache[0].mask = 0xF; // Recheck mask on next color buffer update
+   mDirtyDrawState |= DrawState::ColorBuffer | DrawState::Textures;
    gl::glDisable(gl::GL_SCISSOR_TEST);
 
    gl::glClearNamedFramebufferfv(mColorClearFrameBuffer, gl::GL_COLOR, 0, colors);
@@ -381,6 +658,9 @@ GLDriver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
                    || dbFormat == latte::DB_FORMAT::DEPTH_8_24_FLOAT
                    || dbFormat == latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT);
 
+   flushDrawBatch();
+   mDirtyDrawState |= DrawState::Textures;
+
    // Find our depthbuffer to clear
    auto buffer = getDepthBuffer(data.db_depth_base, data.db_depth_size, data.db_depth_info, true);
 
@@ -423,6 +703,16 @@ GLDriver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
    }
 }
 
+decaf::OpenGLDrawStats
+GLDriver::getDrawStats()
+{
+   auto stats = decaf::OpenGLDrawStats { };
+   stats.draws = mDrawStats.lastFrameDraws;
+   stats.glDraws = mDrawStats.lastFrameGlDraws;
+   stats.cleanDraws = mDrawStats.lastFrameCleanDraws;
+   return stats;
+}
+
 } // namespace opengl
 
 } // namespace gpu
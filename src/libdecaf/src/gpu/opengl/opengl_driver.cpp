@@ -23,11 +23,27 @@ namespace gpu
 namespace opengl
 {
 
-GLDriver::GLDriver()
+// Size of the ring buffer used for transient draw data
+static const auto STREAM_BUFFER_SIZE = 32u * 1024 * 1024;
+
+// Size of the ring buffer textures are staged in, a chain bigger than half
+//  of this is uploaded from client memory instead
+static const auto UPLOAD_BUFFER_SIZE = 64u * 1024 * 1024;
+
+// Number of threads untiling textures, including the GL thread
+static const auto UNTILE_WORKERS = 4u;
+
+GLDriver::GLDriver() :
+   mUntilePool(UNTILE_WORKERS, "GPU Untile")
 {
    mRegisters.fill(0);
 }
 
+GLDriver::~GLDriver()
+{
+   stopShaderCompiler();
+}
+
 void
 GLDriver::initGL()
 {
@@ -76,6 +92,12 @@ GLDriver::initGL()
    gl::GLint value;
    gl::glGetIntegerv(gl::GL_MAX_UNIFORM_BLOCK_SIZE, &value);
    MaxUniformBlockSize = value;
+
+   gl::glGetIntegerv(gl::GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+   mUniformBufferAlignment = value;
+
+   mStreamBuffer.create(STREAM_BUFFER_SIZE, "stream buffer");
+   mUploadBuffer.create(UPLOAD_BUFFER_SIZE, "upload buffer");
 }
 
 void
@@ -133,6 +155,8 @@ enum
 void
 GLDriver::decafCopyColorToScan(const pm4::DecafCopyColorToScan &data)
 {
+   flushDrawBatch();
+
    auto buffer = getColorBuffer(data.cb_color_base, data.cb_color_size, data.cb_color_info, false);
    ScanBufferChain *target = nullptr;
 
@@ -161,6 +185,13 @@ GLDriver::decafSwapBuffers(const pm4::DecafSwapBuffers &data)
 {
    static const auto weight = 0.9;
 
+   mDrawStats.lastFrameDraws = mDrawStats.draws;
+   mDrawStats.lastFrameGlDraws = mDrawStats.glDraws;
+   mDrawStats.lastFrameCleanDraws = mDrawStats.cleanDraws;
+   mDrawStats.draws = 0;
+   mDrawStats.glDraws = 0;
+   mDrawStats.cleanDraws = 0;
+
    injectFence([=]() {
       // TODO: We should have a render chain of 2 buffers so that we don't render stuff
       //  until the game actually asked us to.
@@ -197,7 +228,13 @@ GLDriver::decafSetSwapInterval(const pm4::DecafSetSwapInterval &data)
 void
 GLDriver::decafDebugMarker(const pm4::DecafDebugMarker &data)
 {
-   gLog->trace("GPU Debug Marker: {} {}", data.key.data(), data.id);
+   auto key = std::string {};
+
+   for (auto i = 0u; i < data.key.size() && data.key[i]; ++i) {
+      key.push_back(data.key[i]);
+   }
+
+   gLog->trace("GPU Debug Marker: {} {}", key, data.id);
 }
 
 void
@@ -257,8 +294,12 @@ GLDriver::decafCopySurface(const pm4::DecafCopySurface &data)
    decaf_check(data.dstDepth == data.srcDepth);
    decaf_check(data.dstDim == data.srcDim);
 
+   flushDrawBatch();
+   mDirtyDrawState |= DrawState::Textures;
+
    auto dstBuffer = getSurfaceBuffer(
       data.dstImage,
+      data.dstMipmaps,
       data.dstPitch,
       data.dstWidth,
       data.dstHeight,
@@ -271,11 +312,13 @@ GLDriver::decafCopySurface(const pm4::DecafCopySurface &data)
       data.dstDegamma,
       false,
       data.dstTileMode,
+      1,
       true,
       true);
 
    auto srcBuffer = getSurfaceBuffer(
       data.srcImage,
+      data.srcMipmaps,
       data.srcPitch,
       data.srcWidth,
       data.srcHeight,
@@ -288,6 +331,7 @@ GLDriver::decafCopySurface(const pm4::DecafCopySurface &data)
       data.srcDegamma,
       false,
       data.srcTileMode,
+      1,
       false,
       false);
 
@@ -312,6 +356,8 @@ GLDriver::decafCopySurface(const pm4::DecafCopySurface &data)
       copyDepth);
 
    dstBuffer->needUpload = false;
+   dstBuffer->state = SurfaceUseState::GpuWritten;
+   dstBuffer->contentSerial = ++mSurfaceSerial;
 }
 
 void
@@ -356,16 +402,24 @@ GLDriver::surfaceSync(const pm4::SurfaceSync &data)
       case Resource::SURFACE:
          if (surfaces) {
             auto surface = reinterpret_cast<SurfaceBuffer *>(resource);
-            surface->needUpload |= surface->dirtyMemory;
-            surface->dirtyMemory = false;
+
+            if (surface->dirtyMemory) {
+               surface->needUpload = true;
+               surface->dirtyMemory = false;
+               mDirtyDrawState |= DrawState::Textures;
+            }
          }
          break;
 
       case Resource::SHADER:
          if (shaders) {
-            auto shader = reinterpret_cast<Shader *>(resource);
-            shader->needRebuild |= shader->dirtyMemory;
-            shader->dirtyMemory = false;
+            auto binary = reinterpret_cast<ShaderBinary *>(resource);
+
+            if (binary->dirtyMemory) {
+               binary->needRehash = true;
+               binary->dirtyMemory = false;
+               mDirtyDrawState |= DrawState::Shader;
+            }
          }
          break;
 
@@ -375,10 +429,20 @@ GLDriver::surfaceSync(const pm4::SurfaceSync &data)
             if (buffer->isInput && buffer->dirtyMemory) {
                auto offset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
                auto size = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - offset;
+
+               // Queued draws may still read the old contents
+               flushDrawBatch();
                uploadDataBuffer(buffer, offset, size);
                buffer->dirtyMemory = false;
+               mDirtyDrawState |= DrawState::AttribBuffers;
             }
          }
+         break;
+
+      case Resource::INDEX_BUFFER:
+      case Resource::STREAMED_DATA:
+         // These check dirtyMemory themselves when they are drawn
+         break;
       }
    }
 }
@@ -448,6 +512,7 @@ GLDriver::eventWrite(const pm4::EventWrite &data)
    auto ptr = mem::translate(addr);
 
    decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
+   flushDrawBatch();
 
    auto writeData = [=](uint64_t value) {
       switch (data.addrLo.ENDIAN_SWAP()) {
@@ -555,6 +620,9 @@ GLDriver::pfpSyncMe(const pm4::PfpSyncMe &data)
 void
 GLDriver::injectFence(std::function<void()> func)
 {
+   // The fence has to come after every draw which was already processed
+   flushDrawBatch();
+
    auto object = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, gl::GL_NONE_BIT);
 
    SyncWait wait;
@@ -602,6 +670,95 @@ GLDriver::checkSyncObjects()
    }
 }
 
+uint8_t *
+GLDriver::allocateStreamBuffer(uint32_t size,
+                               uint32_t alignment,
+                               uint32_t &offset)
+{
+   // Anything bigger could wrap onto data a draw is still being set up with,
+   //  see StreamBuffer::isRecent, the caller must use allocateTransientBuffer.
+   if (size > mStreamBuffer.getSize() / 8) {
+      return nullptr;
+   }
+
+   auto ptr = mStreamBuffer.allocate(size, alignment, offset);
+
+   if (!ptr) {
+      // The ring is full of data the GPU has not read yet, this should only
+      //  happen when a single command buffer streams a lot of data.  Queued
+      //  draws must be issued first, as the space they read is released.
+      flushDrawBatch();
+      fenceStreamBuffer();
+      gl::glFinish();
+      checkSyncObjects();
+
+      ptr = mStreamBuffer.allocate(size, alignment, offset);
+      decaf_check(ptr);
+   }
+
+   return ptr;
+}
+
+gl::GLuint
+GLDriver::allocateTransientBuffer(const void *data,
+                                  uint32_t size)
+{
+   auto object = gl::GLuint { 0 };
+   gl::glCreateBuffers(1, &object);
+   gl::glNamedBufferStorage(object, size, data, gl::BufferStorageMask::GL_NONE_BIT);
+
+   if (decaf::config::gpu::debug) {
+      gl::glObjectLabel(gl::GL_BUFFER, object, -1, "transient buffer");
+   }
+
+   mTransientBuffers.push_back(object);
+   return object;
+}
+
+void
+GLDriver::fenceStreamBuffer()
+{
+   auto position = mStreamBuffer.getHead();
+   auto uploadPosition = mUploadBuffer.getHead();
+   auto transientBuffers = std::move(mTransientBuffers);
+   mTransientBuffers.clear();
+
+   injectFence([=]() {
+      mStreamBuffer.release(position);
+      mUploadBuffer.release(uploadPosition);
+
+      if (!transientBuffers.empty()) {
+         gl::glDeleteBuffers(static_cast<gl::GLsizei>(transientBuffers.size()), transientBuffers.data());
+      }
+
+      // Uniforms in released space may be overwritten, see isRecent
+      mDirtyDrawState |= DrawState::Uniforms;
+   });
+}
+
+uint8_t *
+GLDriver::allocateUploadBuffer(uint32_t size,
+                               uint32_t &offset)
+{
+   if (size > mUploadBuffer.getSize() / 2) {
+      return nullptr;
+   }
+
+   // Texel data only needs to be aligned to the largest texel
+   auto ptr = mUploadBuffer.allocate(size, 16, offset);
+
+   if (!ptr) {
+      fenceStreamBuffer();
+      gl::glFinish();
+      checkSyncObjects();
+
+      ptr = mUploadBuffer.allocate(size, 16, offset);
+      decaf_check(ptr);
+   }
+
+   return ptr;
+}
+
 void
 GLDriver::executeBuffer(pm4::Buffer *buffer)
 {
@@ -611,7 +768,9 @@ GLDriver::executeBuffer(pm4::Buffer *buffer)
    // Execute command buffer
    runCommandBuffer(buffer->buffer, buffer->curSize);
 
-   // Release command buffer
+   // Release command buffer and any stream buffer space it used
+   fenceStreamBuffer();
+
    injectFence([=]() {
       gpu::retireCommandBuffer(buffer);
    });
@@ -653,10 +812,16 @@ GLDriver::notifyCpuFlush(void *ptr,
    std::unique_lock<std::mutex> lock(mResourceMap.getMutex());
 
    auto iter = mResourceMap.getIterator(mem::untranslate(ptr), size);
+   auto found = false;
 
    Resource *resource;
    while ((resource = iter.next()) != nullptr) {
       resource->dirtyMemory = true;
+      found = true;
+   }
+
+   if (found) {
+      mCpuMemoryFlushed = true;
    }
 }
 
@@ -738,6 +903,8 @@ GLDriver::run()
          checkSyncObjects();
       }
    }
+
+   stopShaderCompiler();
 }
 
 void
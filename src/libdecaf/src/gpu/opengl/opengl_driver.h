@@ -2,6 +2,7 @@
 
 #ifndef DECAF_NOGL
 
+#include "gpu/glsl2/glsl2_cache.h"
 #include "gpu/glsl2/glsl2_translate.h"
 #include "gpu/latte_constants.h"
 #include "gpu/latte_contextstate.h"
@@ -11,10 +12,14 @@
 #include "libdecaf/decaf_graphics.h"
 #include "libdecaf/decaf_opengl.h"
 #include "opengl_resource.h"
+#include "opengl_shadertranslate.h"
+#include "opengl_streambuffer.h"
 
+#include <atomic>
 #include <chrono>
 #include <common/log.h>
 #include <common/platform.h>
+#include <common/workerpool.h>
 #include <condition_variable>
 #include <exception>
 #include <glbinding/gl/gl.h>
@@ -22,6 +27,7 @@
 #include <libcpu/mem.h>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -47,33 +53,38 @@ struct AttribBufferCache
    uint32_t stride = 0;
 };
 
-struct Shader : public Resource
+enum class ShaderState : uint32_t
 {
-   //! True if the shader needs to be rebuilt due to dirtyMemory
-   bool needRebuild = false;
+   Ready,
+   Pending,
+   Failed,
+};
+
+//! Content hash of a shader binary in guest memory, kept in cpuMemHash and
+//  only recalculated after surfaceSync reports a write to its memory.
+struct ShaderBinary : public Resource
+{
+   //! True if the memory was written since it was last hashed
+   bool needRehash = true;
+
+   ShaderBinary() : Resource(Resource::SHADER) { }
+};
 
-   //! Number of references from ShaderPipelines (used for garbage collection)
-   unsigned refCount = 0;
+//! Shaders are identified by the hash of their binaries and translation
+//  state rather than by address, so one shader may be shared by any number
+//  of addresses and pipelines.
+struct Shader
+{
+   //! Pending while queued on the shader compiler thread
+   ShaderState state = ShaderState::Ready;
 
-   Shader() : Resource(Resource::SHADER) { }
+   //! The address the shader was first seen at, for dumps and debug labels
+   uint32_t address = 0;
 };
 
 struct FetchShader : public Shader
 {
-   struct Attrib
-   {
-      uint32_t buffer;
-      uint32_t offset;
-      uint32_t location;
-      uint32_t bytesPerElement;
-      latte::SQ_SEL srcSelX;
-      latte::SQ_VTX_FETCH_TYPE type;
-      latte::SQ_DATA_FORMAT format;
-      latte::SQ_SEL dstSel[4];
-      latte::SQ_NUM_FORMAT numFormat;
-      latte::SQ_ENDIAN endianSwap;
-      latte::SQ_FORMAT_COMP formatComp;
-   };
+   using Attrib = FetchShaderAttrib;
 
    gl::GLuint object = 0;
    std::vector<Attrib> attribs;
@@ -84,14 +95,13 @@ struct FetchShader : public Shader
 struct VertexShader : public Shader
 {
    gl::GLuint object = 0;
-   gl::GLuint uniformRegisters = 0;
+   glsl2::ShaderCacheKey cacheKey;
    gl::GLuint uniformViewport = 0;
    bool isScreenSpace = false;
    std::array<gl::GLuint, latte::MaxAttributes> attribLocations;
    std::array<uint8_t, 256> outputMap;
    std::array<bool, 16> usedUniformBlocks;
    std::array<bool, 4> usedFeedbackBuffers;
-   uint32_t lastUniformUpdate = 0;
    std::string code;
    std::string disassembly;
 };
@@ -99,17 +109,48 @@ struct VertexShader : public Shader
 struct PixelShader : public Shader
 {
    gl::GLuint object = 0;
-   gl::GLuint uniformRegisters = 0;
+   glsl2::ShaderCacheKey cacheKey;
    gl::GLuint uniformAlphaRef = 0;
    latte::SX_ALPHA_TEST_CONTROL sx_alpha_test_control;
    std::array<glsl2::SamplerUsage, latte::MaxSamplers> samplerUsage;
    std::array<bool, 16> usedUniformBlocks;
-   uint32_t lastUniformUpdate = 0;
    std::string code;
    std::string disassembly;
 };
 
-using ShaderPipelineKey = std::tuple<uint64_t, uint64_t, uint64_t>;
+using ShaderPipelineKey = std::tuple<FetchShader *, VertexShader *, PixelShader *>;
+
+struct ShaderCompileJob
+{
+   glsl2::Shader::Type type = glsl2::Shader::Invalid;
+   std::chrono::steady_clock::time_point queuedTime;
+
+   //! Only used on the GPU thread, which owns these and may update them
+   //  while the job is queued.
+   FetchShader *fetch = nullptr;
+   VertexShader *vertex = nullptr;
+   PixelShader *pixel = nullptr;
+
+   //! Copies of the state translation reads, the guest is free to change
+   //  both while the job is queued.
+   std::vector<uint8_t> binary;
+   std::unique_ptr<ShaderRegisters> registers;
+   bool isScreenSpace = false;
+
+   //! Vertex shader jobs translate with a copy of the fetch shader
+   std::vector<FetchShader::Attrib> fetchAttribs;
+   std::string fetchDisassembly;
+
+   //! Pixel shader jobs translate with a copy of the vertex shader outputs
+   std::array<uint8_t, 256> vertexOutputMap;
+
+   //! Link the program on the compiler thread's shared context
+   bool createProgram = false;
+
+   bool translated = false;
+   glsl2::CachedShader result;
+   gl::GLuint object = 0;
+};
 
 struct ShaderPipeline
 {
@@ -117,9 +158,6 @@ struct ShaderPipeline
    FetchShader *fetch = nullptr;
    VertexShader *vertex = nullptr;
    PixelShader *pixel = nullptr;  // Null if rasterization is disabled
-   uint64_t fetchKey;
-   uint64_t vertexKey;
-   uint64_t pixelKey;
 };
 
 struct HostSurface
@@ -128,8 +166,12 @@ struct HostSurface
    uint32_t width = 0;
    uint32_t height = 0;
    uint32_t depth = 0;
+   uint32_t levels = 1;
    uint32_t degamma = false;
    bool isDepthBuffer = false;
+   gl::GLenum storageFormat = gl::GL_NONE;
+   uint64_t serial = 0;  // Assigned once another surface views this one
+   uint64_t viewSourceSerial = 0;  // Set if this is a glTextureView of another surface
    gl::GLenum swizzleR;
    gl::GLenum swizzleG;
    gl::GLenum swizzleB;
@@ -143,17 +185,42 @@ struct SurfaceBuffer : public Resource
    HostSurface *master = nullptr;
    SurfaceUseState state = SurfaceUseState::None;
    bool needUpload = true;
+
+   //! Hash of the mip chain when levels past the first were last uploaded,
+   //  kept apart from cpuMemHash so either can be refreshed on its own.
+   uint64_t mipMemHash[2] = { 0, 0 };
+
+   //! Value of mSurfaceSerial when the contents last changed, either from
+   //  an upload, a GPU write or a copy from another surface.
+   uint64_t contentSerial = 0;
+
+   //! How the surface was first created, used to find other surfaces with
+   //  the same memory layout, see refreshSurfaceAlias
    struct {
       latte::SQ_TEX_DIM dim;
       latte::SQ_DATA_FORMAT format;
       latte::SQ_NUM_FORMAT numFormat;
       latte::SQ_FORMAT_COMP formatComp;
       uint32_t degamma;
-   } dbgInfo;
+      uint32_t pitch;
+      uint32_t swizzle;
+      uint32_t samples;
+      latte::SQ_TILE_MODE tileMode;
+   } info;
 
    SurfaceBuffer() : Resource(Resource::SURFACE) { }
 };
 
+//! Updated on the GPU thread and read by the debugger
+struct SurfaceCacheStats
+{
+   std::atomic<uint64_t> hits { 0 };
+   std::atomic<uint64_t> misses { 0 };
+   std::atomic<uint64_t> uploads { 0 };
+   std::atomic<uint64_t> views { 0 };
+   std::atomic<uint64_t> copies { 0 };
+};
+
 struct ScanBufferChain
 {
    gl::GLuint object = 0;
@@ -174,6 +241,31 @@ struct DataBuffer : public Resource
    DataBuffer() : Resource(Resource::DATA_BUFFER) { }
 };
 
+//! Index data converted to host endian and triangle lists, so repeated draws
+//  of the same indices do not convert them again.
+struct IndexBuffer : public Resource
+{
+   gl::GLuint object = 0;  // Created on the second draw which uses the data
+   bool valid = false;  // True if object matches cpuMemHash
+   uint32_t draws = 0;
+   uint32_t changes = 0;  // Times the guest data was found to have changed
+
+   IndexBuffer() : Resource(Resource::INDEX_BUFFER) { }
+};
+
+//! Guest address, index count and index format, see drawPrimitives
+using IndexBufferKey = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+//! Guest memory which is copied into the stream buffer when it is used after
+//  being changed, instead of being given a buffer object of its own.
+struct StreamedData : public Resource
+{
+   uint64_t position = 0;  // Stream buffer head after the last copy
+   uint32_t offset = 0;
+
+   StreamedData() : Resource(Resource::STREAMED_DATA) { }
+};
+
 struct Sampler
 {
    gl::GLuint object = 0;
@@ -207,6 +299,7 @@ struct ColorBufferCache
 {
    gl::GLuint object = 0;
    uint32_t mask = 0;
+   SurfaceBuffer *surface = nullptr;
 };
 
 struct DepthBufferCache
@@ -214,18 +307,79 @@ struct DepthBufferCache
    gl::GLuint object = 0;
    bool depthBound = false;
    bool stencilBound = false;
+   SurfaceBuffer *surface = nullptr;
+};
+
+//! Groups of state checked by checkReadyDraw, a check only runs again once
+//  a register write or memory change has marked its group dirty.
+namespace DrawState
+{
+enum Flags : uint32_t
+{
+   None              = 0,
+   Shader            = 1 << 0,
+   AttribBuffers     = 1 << 1,
+   Uniforms          = 1 << 2,
+   Textures          = 1 << 3,
+   Samplers          = 1 << 4,
+   ColorBuffer       = 1 << 5,
+   DepthBuffer       = 1 << 6,
+   All               = (1 << 7) - 1,
+
+   //! Everything which is looked up through the active shader
+   ShaderResources   = AttribBuffers | Uniforms | Textures | Samplers,
+};
+}
+
+//! Consecutive indexed draws with the same state, issued together by
+//  flushDrawBatch with one glMultiDrawElementsBaseVertex.
+struct DrawBatch
+{
+   gl::GLenum mode = gl::GL_NONE;
+   gl::GLenum indexType = gl::GL_NONE;
+   gl::GLuint indexBuffer = 0;
+   std::vector<gl::GLsizei> counts;
+   std::vector<const void *> offsets;
+   std::vector<gl::GLint> baseVertices;
+};
+
+//! Counted on the GPU thread, the totals for the last frame are read by
+//  the debugger.
+struct DrawStats
+{
+   uint64_t draws = 0;
+   uint64_t glDraws = 0;
+   uint64_t cleanDraws = 0;
+
+   std::atomic<uint64_t> lastFrameDraws { 0 };
+   std::atomic<uint64_t> lastFrameGlDraws { 0 };
+   std::atomic<uint64_t> lastFrameCleanDraws { 0 };
+};
+
+struct UniformBlockBinding
+{
+   gl::GLuint object = 0;
+   uint32_t offset = 0;
+   uint32_t size = 0;
 };
 
 struct UniformBlockCache
 {
-   gl::GLuint vsObject = 0;
-   gl::GLuint psObject = 0;
+   UniformBlockBinding vs;
+   UniformBlockBinding ps;
+};
+
+struct UniformRegisterCache
+{
+   uint32_t lastUniformUpdate = 0;
+   uint64_t position = 0;  // Stream buffer head after the last upload
 };
 
 struct TextureCache
 {
    gl::GLuint surfaceObject = 0;
    uint32_t word4 = 0;
+   uint32_t word5 = 0;
 };
 
 struct SamplerCache
@@ -293,7 +447,7 @@ class GLDriver : public decaf::OpenGLDriver, public Pm4Processor
 {
 public:
    GLDriver();
-   virtual ~GLDriver() = default;
+   virtual ~GLDriver();
 
    virtual void
    run() override;
@@ -319,6 +473,18 @@ public:
    virtual void
    syncPoll(const SwapFunction &swapFunc) override;
 
+   virtual void
+   setShaderCompilerContext(const MakeCurrentFunction &makeCurrent) override;
+
+   virtual decaf::OpenGLShaderStats
+   getShaderStats() override;
+
+   virtual decaf::OpenGLSurfaceStats
+   getSurfaceStats() override;
+
+   virtual decaf::OpenGLDrawStats
+   getDrawStats() override;
+
 private:
    void initGL();
    void executeBuffer(pm4::Buffer *buffer);
@@ -350,6 +516,7 @@ private:
    void
    uploadSurface(SurfaceBuffer *surface,
                  ppcaddr_t baseAddress,
+                 ppcaddr_t mipAddress,
                  uint32_t swizzle,
                  uint32_t pitch,
                  uint32_t width,
@@ -362,10 +529,12 @@ private:
                  latte::SQ_FORMAT_COMP formatComp,
                  uint32_t degamma,
                  bool isDepthBuffer,
-                 latte::SQ_TILE_MODE tileMode);
+                 latte::SQ_TILE_MODE tileMode,
+                 uint32_t levels);
 
    SurfaceBuffer *
    getSurfaceBuffer(ppcaddr_t baseAddress,
+                    ppcaddr_t mipAddress,
                     uint32_t pitch,
                     uint32_t width,
                     uint32_t height,
@@ -378,9 +547,19 @@ private:
                     uint32_t degamma,
                     bool isDepthBuffer,
                     latte::SQ_TILE_MODE tileMode,
+                    uint32_t levels,
                     bool forWrite,
                     bool discardData);
 
+   bool
+   refreshSurfaceAlias(SurfaceBuffer *buffer);
+
+   void
+   releaseHostSurface(HostSurface *surface);
+
+   void
+   markSurfaceGpuWritten(SurfaceBuffer *buffer);
+
    void
    setSurfaceSwizzle(SurfaceBuffer *surface,
                      gl::GLenum swizzleR,
@@ -436,23 +615,75 @@ private:
    countModifiedUniforms(latte::Register firstReg,
                          uint32_t lastUniformUpdate);
 
+   void
+   uploadUniformRegisters(UniformRegisterCache &cache,
+                          latte::Register firstReg,
+                          uint32_t binding);
+
+   void
+   bindUniformBlock(UniformBlockBinding &cache,
+                    uint32_t binding,
+                    uint32_t address,
+                    uint32_t size);
+
+   StreamedData *
+   getStreamedData(uint32_t address,
+                   uint32_t size,
+                   uint32_t alignment);
+
    bool
    parseFetchShader(FetchShader &shader,
                     void *buffer,
                     size_t size);
 
    bool
-   compileVertexShader(VertexShader &vertex,
-                       FetchShader &fetch,
-                       uint8_t *buffer,
-                       size_t size,
-                       bool isScreenSpace);
+   linkVertexShader(VertexShader &vertex,
+                    FetchShader &fetch,
+                    const glsl2::CachedShader &shader,
+                    gl::GLuint object);
+
+   bool
+   linkPixelShader(PixelShader &pixel,
+                   const glsl2::CachedShader &shader,
+                   gl::GLuint object);
 
    bool
-   compilePixelShader(PixelShader &pixel,
-                      VertexShader &vertex,
-                      uint8_t *buffer,
-                      size_t size);
+   checkPipelineShadersReady(ShaderPipeline &pipeline,
+                             bool canSkip);
+
+   void
+   submitShaderCompile(std::unique_ptr<ShaderCompileJob> job);
+
+   void
+   runShaderCompileJob(ShaderCompileJob &job,
+                       const ShaderRegisters &registers);
+
+   void
+   completeShaderCompile(ShaderCompileJob &job);
+
+   void
+   processCompletedShaderCompiles();
+
+   void
+   runShaderCompiler();
+
+   void
+   stopShaderCompiler();
+
+   ShaderBinary *
+   getShaderBinary(uint32_t address,
+                   uint32_t size);
+
+   glsl2::ShaderCacheKey
+   getFetchShaderKey(const ShaderBinary &fetch);
+
+   void
+   openShaderCache();
+
+   gl::GLuint
+   createCachedProgram(const glsl2::ShaderCacheKey &key,
+                       gl::GLenum type,
+                       const glsl2::CachedShader &shader);
 
    void
    injectFence(std::function<void()> func);
@@ -466,14 +697,50 @@ private:
    void
    runRemoteThreadTasks();
 
+   uint8_t *
+   allocateStreamBuffer(uint32_t size,
+                        uint32_t alignment,
+                        uint32_t &offset);
+
+   gl::GLuint
+   allocateTransientBuffer(const void *data,
+                           uint32_t size);
+
+   void
+   fenceStreamBuffer();
+
+   uint8_t *
+   allocateUploadBuffer(uint32_t size,
+                        uint32_t &offset);
+
+   IndexBuffer *
+   getIndexBuffer(uint32_t address,
+                  uint32_t count,
+                  uint32_t format,
+                  uint32_t size);
+
    void
    drawPrimitives(uint32_t count,
                   const void *indices,
-                  latte::VGT_INDEX_TYPE indexFmt);
+                  latte::VGT_INDEX_TYPE indexFmt,
+                  latte::VGT_DMA_SWAP swapMode,
+                  bool cacheable);
 
    void
    drawPrimitivesIndexed(const void *indices,
-                         uint32_t count);
+                         uint32_t count,
+                         bool cacheable);
+
+   void
+   queueDraw(gl::GLenum mode,
+             uint32_t count,
+             gl::GLenum indexType,
+             gl::GLuint indexBuffer,
+             uint32_t indexOffset,
+             uint32_t baseVertex);
+
+   void
+   flushDrawBatch();
 
 private:
    enum class RunState
@@ -492,12 +759,82 @@ private:
    bool mDepthRangeDirty = false;
    bool mScissorDirty = false;
 
-   std::unordered_map<uint64_t, FetchShader *> mFetchShaders;
-   std::unordered_map<uint64_t, VertexShader *> mVertexShaders;
-   std::unordered_map<uint64_t, PixelShader *> mPixelShaders;
+   //! DrawState groups checkReadyDraw has to validate before the next draw
+   uint32_t mDirtyDrawState = DrawState::All;
+
+   //! Set by notifyCpuFlush, which runs on the CPU thread, when it marked
+   //  any resource dirty.
+   std::atomic<bool> mCpuMemoryFlushed { false };
+
+   DrawBatch mDrawBatch;
+   DrawStats mDrawStats;
+
+   std::unordered_map<uint64_t, ShaderBinary *> mShaderBinaries;
+   std::map<glsl2::ShaderCacheKey, FetchShader *> mFetchShaders;
+   std::map<glsl2::ShaderCacheKey, VertexShader *> mVertexShaders;
+   std::map<glsl2::ShaderCacheKey, PixelShader *> mPixelShaders;
    std::map<ShaderPipelineKey, ShaderPipeline> mShaderPipelines;
+
+   //! Addresses and state mActiveShader was found with, a draw which changes
+   //  none of them and whose binaries are unchanged skips the lookup.
+   std::tuple<uint64_t, uint64_t, uint64_t> mActiveShaderAddressKey;
+   std::array<ShaderBinary *, 3> mActiveShaderBinaries;
+
+   //! Translated shaders from previous runs of the current title, along with
+   //  the programs created from their binaries when the cache was opened.
+   bool mShaderCacheOpened = false;
+   glsl2::ShaderCache mShaderCache;
+   std::map<glsl2::ShaderCacheKey, gl::GLuint> mPreloadedPrograms;
+
+   //! Shaders not found in the cache are translated on mShaderCompilerThread,
+   //  a single thread so a pixel shader job always runs after the job for
+   //  the vertex shader it reads outputs from.
+   std::thread mShaderCompilerThread;
+   bool mShaderCompilerRunning = false;
+   MakeCurrentFunction mShaderCompilerContext;
+   std::mutex mShaderCompileMutex;  // Protects the queues and mShaderStats
+   std::condition_variable mShaderCompileCV;
+   std::condition_variable mShaderCompletedCV;
+   std::queue<std::unique_ptr<ShaderCompileJob>> mShaderCompileQueue;
+   std::vector<std::unique_ptr<ShaderCompileJob>> mShaderCompileCompleted;
+   decaf::OpenGLShaderStats mShaderStats;
+   uint32_t mShaderCompilesPending = 0;
+   bool mActiveShaderPending = false;
+
+
    std::unordered_map<uint64_t, SurfaceBuffer> mSurfaces;
+
+   //! Every SurfaceBuffer by base address. Tiled surfaces can only share
+   //  data when their base address and layout match, so this finds the
+   //  surfaces one could alias in O(log n) whatever their format.
+   std::multimap<uint32_t, SurfaceBuffer *> mSurfaceRanges;
+   uint64_t mSurfaceSerial = 0;
+   uint64_t mHostSurfaceSerial = 0;
+   SurfaceCacheStats mSurfaceStats;
    std::unordered_map<uint32_t, DataBuffer> mDataBuffers;
+   std::map<IndexBufferKey, IndexBuffer *> mIndexBuffers;
+
+   //! Transient data such as uniforms or frequently changing indices, the
+   //  space is released once the command buffer which used it retires.
+   StreamBuffer mStreamBuffer;
+   uint32_t mUniformBufferAlignment = 256;
+   std::unordered_map<uint64_t, StreamedData *> mStreamedData;
+   std::vector<uint8_t> mIndexScratch;
+
+   //! Converted indices too large for mStreamBuffer, before their upload
+   std::vector<uint8_t> mLargeIndices;
+
+   //! Buffers for data too large for mStreamBuffer, deleted by the fence of
+   //  the command buffer which used them.
+   std::vector<gl::GLuint> mTransientBuffers;
+
+   //! Host ordered copy of the indices of the current DRAW_INDEX_IMMD
+   std::vector<uint32_t> mImmediateIndices;
+
+   //! Staging memory for texture uploads, kept apart from mStreamBuffer as
+   //  a whole mip chain is far larger than any other streamed data.
+   StreamBuffer mUploadBuffer;
+   WorkerPool mUntilePool;
 
    ResourceMemoryMap mResourceMap;
    ResourceMemoryMap mOutputBufferMap;
@@ -537,6 +874,8 @@ private:
    // Used to detect changes to uniform registers; see countModifiedUniforms()
    uint32_t mUniformUpdateGen = 0;
    std::array<uint32_t, (2 * latte::MaxUniformRegisters) / 16> mLastUniformUpdate;
+   UniformRegisterCache mVertexUniformRegisters;
+   UniformRegisterCache mPixelUniformRegisters;
 
    using duration_system_clock = std::chrono::duration<double, std::chrono::system_clock::period>;
    using duration_ms = std::chrono::duration<double, std::chrono::milliseconds::period>;
@@ -22,6 +22,124 @@ getBlendEquation(latte::CB_COMB_FUNC func);
 static gl::GLenum
 getStencilFunc(latte::DB_STENCIL_FUNC func);
 
+// Which checks in checkReadyDraw have to run again after reg changes,
+//  registers not listed here could be read by any of them.
+static uint32_t
+getRegisterDrawState(latte::Register reg)
+{
+   if (reg >= latte::Register::ResourceRegisterBase
+    && reg < latte::Register::ResourceRegisterEnd) {
+      auto resource = (reg - latte::Register::ResourceRegisterBase) / 4 / 7;
+
+      if (resource < latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0) {
+         return DrawState::Textures;
+      } else if (resource < latte::SQ_RES_OFFSET::GS_TEX_RESOURCE_0) {
+         return DrawState::AttribBuffers;
+      } else {
+         return DrawState::None;
+      }
+   }
+
+   if ((reg >= latte::Register::SamplerRegisterBase && reg < latte::Register::SamplerRegisterEnd)
+    || (reg >= latte::Register::TD_PS_SAMPLER_BORDER0_RED && reg <= latte::Register::TD_PS_SAMPLER_BORDER17_ALPHA)) {
+      return DrawState::Samplers;
+   }
+
+   if ((reg >= latte::Register::SQ_ALU_CONST_BUFFER_SIZE_PS_0 && reg <= latte::Register::SQ_ALU_CONST_BUFFER_SIZE_VS_15)
+    || (reg >= latte::Register::SQ_ALU_CONST_CACHE_PS_0 && reg <= latte::Register::SQ_ALU_CONST_CACHE_VS_15)) {
+      return DrawState::Uniforms;
+   }
+
+   // Render targets can be sampled once they are no longer bound, so any
+   //  texture aliasing them has to be refreshed.
+   if ((reg >= latte::Register::CB_COLOR0_BASE && reg <= latte::Register::CB_COLOR7_SIZE)
+    || (reg >= latte::Register::CB_COLOR0_INFO && reg <= latte::Register::CB_COLOR7_INFO)) {
+      return DrawState::ColorBuffer | DrawState::Textures;
+   }
+
+   switch (reg) {
+   case latte::Register::CB_TARGET_MASK:
+   case latte::Register::CB_SHADER_CONTROL:
+      return DrawState::ColorBuffer | DrawState::Textures;
+   case latte::Register::CB_COLOR_CONTROL:
+      return DrawState::ColorBuffer;
+   case latte::Register::CB_SHADER_MASK:
+      return DrawState::Shader | DrawState::ColorBuffer;
+   case latte::Register::DB_DEPTH_BASE:
+   case latte::Register::DB_DEPTH_SIZE:
+   case latte::Register::DB_DEPTH_INFO:
+      return DrawState::DepthBuffer | DrawState::Textures;
+   case latte::Register::DB_DEPTH_CONTROL:
+      return DrawState::DepthBuffer;
+   case latte::Register::SQ_CONFIG:
+      return DrawState::Uniforms;
+   case latte::Register::SQ_PGM_START_FS:
+   case latte::Register::SQ_PGM_START_VS:
+   case latte::Register::SQ_PGM_START_PS:
+   case latte::Register::SQ_PGM_SIZE_FS:
+   case latte::Register::SQ_PGM_SIZE_VS:
+   case latte::Register::SQ_PGM_SIZE_PS:
+   case latte::Register::DB_SHADER_CONTROL:
+   case latte::Register::SX_ALPHA_TEST_CONTROL:
+   case latte::Register::SX_ALPHA_REF:
+   case latte::Register::PA_CL_CLIP_CNTL:
+   case latte::Register::VGT_PRIMITIVE_TYPE:
+      return DrawState::Shader;
+
+   // Applied directly to OpenGL state by applyRegister
+   case latte::Register::CB_BLEND0_CONTROL:
+   case latte::Register::CB_BLEND1_CONTROL:
+   case latte::Register::CB_BLEND2_CONTROL:
+   case latte::Register::CB_BLEND3_CONTROL:
+   case latte::Register::CB_BLEND4_CONTROL:
+   case latte::Register::CB_BLEND5_CONTROL:
+   case latte::Register::CB_BLEND6_CONTROL:
+   case latte::Register::CB_BLEND7_CONTROL:
+   case latte::Register::CB_BLEND_RED:
+   case latte::Register::CB_BLEND_GREEN:
+   case latte::Register::CB_BLEND_BLUE:
+   case latte::Register::CB_BLEND_ALPHA:
+   case latte::Register::DB_STENCILREFMASK:
+   case latte::Register::DB_STENCILREFMASK_BF:
+   case latte::Register::PA_CL_VPORT_XSCALE_0:
+   case latte::Register::PA_CL_VPORT_XOFFSET_0:
+   case latte::Register::PA_CL_VPORT_YSCALE_0:
+   case latte::Register::PA_CL_VPORT_YOFFSET_0:
+   case latte::Register::PA_CL_VPORT_ZSCALE_0:
+   case latte::Register::PA_CL_VPORT_ZOFFSET_0:
+   case latte::Register::PA_SC_VPORT_ZMIN_0:
+   case latte::Register::PA_SC_VPORT_ZMAX_0:
+   case latte::Register::PA_SC_GENERIC_SCISSOR_TL:
+   case latte::Register::PA_SC_GENERIC_SCISSOR_BR:
+   case latte::Register::PA_SU_SC_MODE_CNTL:
+   case latte::Register::VGT_MULTI_PRIM_IB_RESET_EN:
+   case latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX:
+      return DrawState::None;
+   default:
+      return DrawState::All;
+   }
+}
+
+// Registers which are only read when a draw is issued, so changing them
+//  does not stop the draw from being batched with the previous one.
+static bool
+isDrawParameterRegister(latte::Register reg)
+{
+   switch (reg) {
+   case latte::Register::SQ_VTX_BASE_VTX_LOC:
+   case latte::Register::SQ_VTX_START_INST_LOC:
+   case latte::Register::VGT_DMA_BASE:
+   case latte::Register::VGT_DMA_BASE_HI:
+   case latte::Register::VGT_DMA_SIZE:
+   case latte::Register::VGT_DMA_MAX_SIZE:
+   case latte::Register::VGT_DMA_INDEX_TYPE:
+   case latte::Register::VGT_DMA_NUM_INSTANCES:
+      return true;
+   default:
+      return false;
+   }
+}
+
 void
 GLDriver::applyRegister(latte::Register reg)
 {
@@ -33,9 +151,18 @@ GLDriver::applyRegister(latte::Register reg)
    {
       auto offset = (reg - latte::Register::AluConstRegisterBase) / 4 / 4;
       mLastUniformUpdate[offset / 16] = mUniformUpdateGen;
+      mDirtyDrawState |= DrawState::Uniforms;
       return;
    }
 
+   if (isDrawParameterRegister(reg)) {
+      return;
+   }
+
+   // Batched draws have to be issued with the state they were queued with
+   flushDrawBatch();
+   mDirtyDrawState |= getRegisterDrawState(reg);
+
    // Handle setting OpenGL state for anything else
    switch (reg) {
    case latte::Register::CB_BLEND0_CONTROL:
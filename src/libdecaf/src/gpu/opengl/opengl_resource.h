@@ -29,6 +29,8 @@ struct Resource
    //! The type of resource (poor man's RTTI for surfaceSync())
    enum Type {
       DATA_BUFFER,
+      INDEX_BUFFER,
+      STREAMED_DATA,
       SHADER,
       SURFACE,
    } type;
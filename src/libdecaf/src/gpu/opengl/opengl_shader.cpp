@@ -5,6 +5,8 @@
 #include "gpu/gpu_utilities.h"
 #include "gpu/latte_registers.h"
 #include "gpu/microcode/latte_disassembler.h"
+#include "kernel/kernel.h"
+#include "libdecaf/decaf.h"
 #include "opengl_constants.h"
 #include "opengl_driver.h"
 
@@ -12,6 +14,7 @@
 #include <common/log.h>
 #include <common/murmur3.h>
 #include <common/platform_dir.h>
+#include <common/platform_thread.h>
 #include <common/strutils.h>
 #include <fstream>
 #include <glbinding/gl/gl.h>
@@ -33,12 +36,6 @@ static const auto USE_PERSISTENT_MAP = true;
 //  fetches past the edge of a buffer, but does not use it.
 static const auto BUFFER_PADDING = 16;
 
-// Enable workaround for NVIDIA GLSL compiler bug which incorrectly fails
-//  on "layout(xfb_buffer = A, xfb_stride = B)" syntax when some buffers
-//  have different strides than others.
-static const auto NVIDIA_GLSL_WORKAROUND = true;
-
-
 static void
 dumpRawShader(const std::string &type, ppcaddr_t data, uint32_t size, bool isSubroutine = false)
 {
@@ -105,64 +102,117 @@ getDataFormatGlType(latte::SQ_DATA_FORMAT format)
       decaf_abort(fmt::format("Unimplemented attribute bit count: {} for {}", bitCount, format));
    }
 }
+static gsl::span<const uint8_t>
+getHashBytes(const ShaderBinary &binary)
+{
+   return gsl::make_span(reinterpret_cast<const uint8_t *>(binary.cpuMemHash), sizeof(binary.cpuMemHash));
+}
 
-static void
-deleteShaderObject(FetchShader *shader)
+static std::string
+getShaderLog(gl::GLuint shader)
 {
-   gl::glDeleteVertexArrays(1, &shader->object);
+   gl::GLint logLength = 0;
+   std::string logMessage;
+   gl::glGetShaderiv(shader, gl::GL_INFO_LOG_LENGTH, &logLength);
+
+   logMessage.resize(logLength);
+   gl::glGetShaderInfoLog(shader, logLength, &logLength, &logMessage[0]);
+   return logMessage;
 }
 
-static void
-deleteShaderObject(VertexShader *shader)
+static std::string
+getProgramLog(gl::GLuint program)
 {
-   gl::glDeleteProgram(shader->object);
+   gl::GLint logLength = 0;
+   std::string logMessage;
+   gl::glGetProgramiv(program, gl::GL_INFO_LOG_LENGTH, &logLength);
+
+   logMessage.resize(logLength);
+   gl::glGetProgramInfoLog(program, logLength, &logLength, &logMessage[0]);
+   return logMessage;
 }
 
-static void
-deleteShaderObject(PixelShader *shader)
+static bool
+isProgramLinked(gl::GLuint program)
 {
-   gl::glDeleteProgram(shader->object);
+   gl::GLint isLinked = 0;
+   gl::glGetProgramiv(program, gl::GL_LINK_STATUS, &isLinked);
+   return !!isLinked;
 }
 
-template <typename ShaderPtrType> static bool
-invalidateShaderIfChanged(ShaderPtrType &shader,
-                          uint64_t shaderKey,
-                          std::unordered_map<uint64_t, ShaderPtrType> &shaders,
-                          ResourceMemoryMap &resourceMap)
+// Equivalent to glCreateShaderProgramv, except the program is created with
+//  GL_PROGRAM_BINARY_RETRIEVABLE_HINT so we can store its binary afterwards.
+static gl::GLuint
+createProgramFromSource(gl::GLenum type,
+                        const std::string &source)
 {
-   if (!shader || !shader->needRebuild) {
-      return false;
+   const gl::GLchar *code[] = { source.c_str() };
+   auto shader = gl::glCreateShader(type);
+   gl::glShaderSource(shader, 1, code, nullptr);
+   gl::glCompileShader(shader);
+
+   auto program = gl::glCreateProgram();
+   gl::glProgramParameteri(program, gl::GL_PROGRAM_SEPARABLE, static_cast<gl::GLint>(gl::GL_TRUE));
+   gl::glProgramParameteri(program, gl::GL_PROGRAM_BINARY_RETRIEVABLE_HINT, static_cast<gl::GLint>(gl::GL_TRUE));
+
+   gl::GLint isCompiled = 0;
+   gl::glGetShaderiv(shader, gl::GL_COMPILE_STATUS, &isCompiled);
+
+   if (isCompiled) {
+      gl::glAttachShader(program, shader);
+      gl::glLinkProgram(program);
+      gl::glDetachShader(program, shader);
+   } else {
+      // The program is left unlinked so the caller reports the failure
+      gLog->error("OpenGL failed to compile shader:\n{}", getShaderLog(shader));
    }
 
-   // Check whether the shader has actually changed; we want to avoid
-   //  recompiling shaders if possible, since that's very slow.
-   //  Note that we don't save this, which means we have to compute it
-   //  twice if we end up recreating the shader, but that cost is tiny
-   //  compared to the time it takes to actually create the shader.
-   uint64_t newHash[2] = { 0, 0 };
-   MurmurHash3_x64_128(mem::translate(shader->cpuMemStart), shader->cpuMemEnd - shader->cpuMemStart, 0, newHash);
-   if (newHash[0] == shader->cpuMemHash[0] && newHash[1] == shader->cpuMemHash[1]) {
-      shader->needRebuild = false;
-      return false;
-   }
+   gl::glDeleteShader(shader);
+   return program;
+}
 
-   // The shader contents have changed, so delete the existing object
-   deleteShaderObject(shader);
-   shader->object = 0;
+static gl::GLuint
+createProgramFromBinary(const glsl2::CachedShader &shader)
+{
+   if (shader.binary.empty()) {
+      return 0;
+   }
 
-   shader->refCount--;
-   if (shader->refCount == 0) {
-      resourceMap.removeResource(shader);
-      delete shader;
+   auto program = gl::glCreateProgram();
+   gl::glProgramParameteri(program, gl::GL_PROGRAM_SEPARABLE, static_cast<gl::GLint>(gl::GL_TRUE));
+   gl::glProgramBinary(program,
+                       static_cast<gl::GLenum>(shader.binaryFormat),
+                       shader.binary.data(),
+                       static_cast<gl::GLsizei>(shader.binary.size()));
+
+   // The driver rejects binaries from a different driver version, in which
+   //  case we fall back to compiling the GLSL again.
+   if (!isProgramLinked(program)) {
+      gl::glDeleteProgram(program);
+      return 0;
    }
-   shader = nullptr;
 
-   // Also clear out the table entry (but leave it allocated since we're
-   //  about to reuse it).  Do this last in case shader is referencing the
-   //  entry itself.
-   shaders[shaderKey] = nullptr;
+   return program;
+}
 
-   return true;
+static void
+getProgramBinary(gl::GLuint program,
+                 glsl2::CachedShader &shader)
+{
+   gl::GLint length = 0;
+   gl::glGetProgramiv(program, gl::GL_PROGRAM_BINARY_LENGTH, &length);
+   shader.binaryFormat = 0;
+   shader.binary.clear();
+
+   if (length <= 0) {
+      return;
+   }
+
+   auto format = gl::GLenum { };
+   shader.binary.resize(length);
+   gl::glGetProgramBinary(program, length, &length, &format, shader.binary.data());
+   shader.binary.resize(length);
+   shader.binaryFormat = static_cast<uint32_t>(format);
 }
 
 bool GLDriver::checkActiveShader()
@@ -218,6 +268,14 @@ bool GLDriver::checkActiveShader()
    decaf_check(getRegister<uint32_t>(latte::Register::SQ_PGM_CF_OFFSET_ES) == 0);
    decaf_check(getRegister<uint32_t>(latte::Register::SQ_PGM_CF_OFFSET_FS) == 0);
 
+   // The title is not known until the first draw, so open its cache here
+   if (!mShaderCacheOpened) {
+      openShaderCache();
+   }
+
+   mActiveShaderPending = false;
+   processCompletedShaderCompiles();
+
    // Make FS key
    auto fsShaderKey = static_cast<uint64_t>(fsPgmAddress) << 32;
 
@@ -247,247 +305,182 @@ bool GLDriver::checkActiveShader()
       psShaderKey |= cb_shader_mask.value & 0xFF;
    }
 
+   auto addressKey = std::make_tuple(fsShaderKey, vsShaderKey, psShaderKey);
+
    if (mActiveShader
-    && mActiveShader->fetch && !mActiveShader->fetch->needRebuild && mActiveShader->fetchKey == fsShaderKey
-    && mActiveShader->vertex && !mActiveShader->vertex->needRebuild && mActiveShader->vertexKey == vsShaderKey
-    && (!mActiveShader->pixel || !mActiveShader->pixel->needRebuild) && mActiveShader->pixelKey == psShaderKey) {
+    && mActiveShaderAddressKey == addressKey
+    && !mActiveShaderBinaries[0]->needRehash
+    && !mActiveShaderBinaries[1]->needRehash
+    && (!mActiveShaderBinaries[2] || !mActiveShaderBinaries[2]->needRehash)) {
       // We already have the current shader bound, nothing special to do.
       return true;
    }
 
-   auto shaderKey = ShaderPipelineKey { fsShaderKey, vsShaderKey, psShaderKey };
-   auto &pipeline = mShaderPipelines[shaderKey];
+   // Find the content hash of each binary, only rehashing memory the guest
+   //  has written to since we last looked.
+   auto fsBinary = getShaderBinary(fsPgmAddress, fsPgmSize);
+   auto vsBinary = getShaderBinary(vsPgmAddress, vsPgmSize);
+   auto psBinary = pa_cl_clip_cntl.RASTERISER_DISABLE() ? nullptr : getShaderBinary(psPgmAddress, psPgmSize);
 
-   // If the pipeline already exists, check whether any of its component
-   //  shaders need to be rebuilt
-   if (pipeline.object) {
-      if (invalidateShaderIfChanged(pipeline.fetch, fsShaderKey, mFetchShaders, mResourceMap)
-       || invalidateShaderIfChanged(pipeline.vertex, vsShaderKey, mVertexShaders, mResourceMap)
-       || invalidateShaderIfChanged(pipeline.pixel, psShaderKey, mPixelShaders, mResourceMap)) {
-         gl::glDeleteProgramPipelines(1, &pipeline.object);
-         pipeline.object = 0;
-      }
-   }
+   // Parse fetch shader if needed
+   auto &fetchShader = mFetchShaders[getFetchShaderKey(*fsBinary)];
 
-   auto getProgramLog = [](auto program) {
-      gl::GLint logLength = 0;
-      std::string logMessage;
-      gl::glGetProgramiv(program, gl::GL_INFO_LOG_LENGTH, &logLength);
+   if (!fetchShader) {
+      auto aluDivisor0 = getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_0);
+      auto aluDivisor1 = getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_1);
 
-      logMessage.resize(logLength);
-      gl::glGetProgramInfoLog(program, logLength, &logLength, &logMessage[0]);
-      return logMessage;
-   };
+      fetchShader = new FetchShader {};
+      fetchShader->address = fsPgmAddress;
 
-   // Generate shader if needed
-   if (!pipeline.object) {
-      // Parse fetch shader if needed
-      auto &fetchShader = mFetchShaders[fsShaderKey];
-      invalidateShaderIfChanged(fetchShader, fsShaderKey, mFetchShaders, mResourceMap);
-
-      if (!fetchShader) {
-         auto aluDivisor0 = getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_0);
-         auto aluDivisor1 = getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_1);
-
-         fetchShader = new FetchShader {};
-         fetchShader->cpuMemStart = fsPgmAddress;
-         fetchShader->cpuMemEnd = fsPgmAddress + fsPgmSize;
-         MurmurHash3_x64_128(mem::translate(fetchShader->cpuMemStart),
-                             fetchShader->cpuMemEnd - fetchShader->cpuMemStart,
-                             0, fetchShader->cpuMemHash);
-         fetchShader->dirtyMemory = false;
-         mResourceMap.addResource(fetchShader);
-
-         dumpRawShader("fetch", fsPgmAddress, fsPgmSize, true);
-         fetchShader->disassembly = latte::disassemble(gsl::make_span(mem::translate<uint8_t>(fsPgmAddress), fsPgmSize), true);
-
-         if (!parseFetchShader(*fetchShader, mem::translate(fsPgmAddress), fsPgmSize)) {
-            gLog->error("Failed to parse fetch shader");
-            return false;
-         }
-
-         // Setup attrib format
-         gl::glCreateVertexArrays(1, &fetchShader->object);
-         if (decaf::config::gpu::debug) {
-            std::string label = fmt::format("fetch shader @ 0x{:08X}", fsPgmAddress);
-            gl::glObjectLabel(gl::GL_VERTEX_ARRAY, fetchShader->object, -1, label.c_str());
-         }
-
-         auto bufferUsed = std::array<bool, latte::MaxAttributes> { false };
-         auto bufferDivisor = std::array<uint32_t, latte::MaxAttributes> { 0 };
-
-         for (auto &attrib : fetchShader->attribs) {
-            auto resourceId = attrib.buffer + latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0;
-
-            if (resourceId >= latte::SQ_RES_OFFSET::VS_ATTRIB_RESOURCE_0 && resourceId < latte::SQ_RES_OFFSET::VS_ATTRIB_RESOURCE_0 + 0x10) {
-               auto attribBufferId = resourceId - latte::SQ_RES_OFFSET::VS_ATTRIB_RESOURCE_0;
-               auto type = getDataFormatGlType(attrib.format);
-               auto components = getDataFormatComponents(attrib.format);
-               auto divisor = 0u;
-
-               gl::glEnableVertexArrayAttrib(fetchShader->object, attrib.location);
-               gl::glVertexArrayAttribIFormat(fetchShader->object, attrib.location, components, type, attrib.offset);
-               gl::glVertexArrayAttribBinding(fetchShader->object, attrib.location, attribBufferId);
-
-               if (attrib.type == latte::SQ_VTX_FETCH_TYPE::INSTANCE_DATA) {
-                  if (attrib.srcSelX == latte::SQ_SEL::SEL_W) {
-                     divisor = 1;
-                  } else if (attrib.srcSelX == latte::SQ_SEL::SEL_Y) {
-                     divisor = aluDivisor0;
-                  } else if (attrib.srcSelX == latte::SQ_SEL::SEL_Z) {
-                     divisor = aluDivisor1;
-                  } else {
-                     decaf_abort(fmt::format("Unexpected SRC_SEL_X {} for alu divisor", attrib.srcSelX));
-                  }
-               }
-
-               decaf_assert(!bufferUsed[attribBufferId] || bufferDivisor[attribBufferId] == divisor,
-                  "Multiple attributes conflict on buffer divisor mode");
-
-               bufferUsed[attribBufferId] = true;
-               bufferDivisor[attribBufferId] = divisor;
-            } else {
-               decaf_abort("We do not yet support binding of non-attribute buffers");
-            }
-         }
+      dumpRawShader("fetch", fsPgmAddress, fsPgmSize, true);
+      fetchShader->disassembly = latte::disassemble(gsl::make_span(mem::translate<uint8_t>(fsPgmAddress), fsPgmSize), true);
 
-         for (auto bufferId = 0; bufferId < latte::MaxAttributes; ++bufferId) {
-            if (bufferUsed[bufferId]) {
-               gl::glVertexArrayBindingDivisor(fetchShader->object, bufferId, bufferDivisor[bufferId]);
-            }
-         }
+      if (!parseFetchShader(*fetchShader, mem::translate(fsPgmAddress), fsPgmSize)) {
+         gLog->error("Failed to parse fetch shader");
+         delete fetchShader;
+         fetchShader = nullptr;
+         return false;
       }
 
-      pipeline.fetch = fetchShader;
-      pipeline.fetch->refCount++;
-      pipeline.fetchKey = fsShaderKey;
-
-      // Compile vertex shader if needed
-      auto &vertexShader = mVertexShaders[vsShaderKey];
-      invalidateShaderIfChanged(vertexShader, vsShaderKey, mVertexShaders, mResourceMap);
-
-      if (!vertexShader) {
-         vertexShader = new VertexShader;
-
-         vertexShader->cpuMemStart = vsPgmAddress;
-         vertexShader->cpuMemEnd = vsPgmAddress + vsPgmSize;
-         MurmurHash3_x64_128(mem::translate(vertexShader->cpuMemStart),
-                             vertexShader->cpuMemEnd - vertexShader->cpuMemStart,
-                             0, vertexShader->cpuMemHash);
-         vertexShader->dirtyMemory = false;
-         mResourceMap.addResource(vertexShader);
-
-         dumpRawShader("vertex", vsPgmAddress, vsPgmSize);
-
-         if (!compileVertexShader(*vertexShader, *fetchShader, mem::translate(vsPgmAddress), vsPgmSize, isScreenSpace)) {
-            gLog->error("Failed to recompile vertex shader");
-            return false;
-         }
+      // Setup attrib format
+      gl::glCreateVertexArrays(1, &fetchShader->object);
+      if (decaf::config::gpu::debug) {
+         std::string label = fmt::format("fetch shader @ 0x{:08X}", fsPgmAddress);
+         gl::glObjectLabel(gl::GL_VERTEX_ARRAY, fetchShader->object, -1, label.c_str());
+      }
 
-         dumpTranslatedShader("vertex", vsPgmAddress, vertexShader->code);
+      auto bufferUsed = std::array<bool, latte::MaxAttributes> { false };
+      auto bufferDivisor = std::array<uint32_t, latte::MaxAttributes> { 0 };
+
+      for (auto &attrib : fetchShader->attribs) {
+         auto resourceId = attrib.buffer + latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0;
+
+         if (resourceId >= latte::SQ_RES_OFFSET::VS_ATTRIB_RESOURCE_0 && resourceId < latte::SQ_RES_OFFSET::VS_ATTRIB_RESOURCE_0 + 0x10) {
+            auto attribBufferId = resourceId - latte::SQ_RES_OFFSET::VS_ATTRIB_RESOURCE_0;
+            auto type = getDataFormatGlType(attrib.format);
+            auto components = getDataFormatComponents(attrib.format);
+            auto divisor = 0u;
+
+            gl::glEnableVertexArrayAttrib(fetchShader->object, attrib.location);
+            gl::glVertexArrayAttribIFormat(fetchShader->object, attrib.location, components, type, attrib.offset);
+            gl::glVertexArrayAttribBinding(fetchShader->object, attrib.location, attribBufferId);
+
+            if (attrib.type == latte::SQ_VTX_FETCH_TYPE::INSTANCE_DATA) {
+               if (attrib.srcSelX == latte::SQ_SEL::SEL_W) {
+                  divisor = 1;
+               } else if (attrib.srcSelX == latte::SQ_SEL::SEL_Y) {
+                  divisor = aluDivisor0;
+               } else if (attrib.srcSelX == latte::SQ_SEL::SEL_Z) {
+                  divisor = aluDivisor1;
+               } else {
+                  decaf_abort(fmt::format("Unexpected SRC_SEL_X {} for alu divisor", attrib.srcSelX));
+               }
+            }
 
-         // Create OpenGL Shader
-         const gl::GLchar *code[] = { vertexShader->code.c_str() };
-         vertexShader->object = gl::glCreateShaderProgramv(gl::GL_VERTEX_SHADER, 1, code);
-         if (decaf::config::gpu::debug) {
-            std::string label = fmt::format("vertex shader @ 0x{:08X}", vsPgmAddress);
-            gl::glObjectLabel(gl::GL_PROGRAM, vertexShader->object, -1, label.c_str());
-         }
+            decaf_assert(!bufferUsed[attribBufferId] || bufferDivisor[attribBufferId] == divisor,
+               "Multiple attributes conflict on buffer divisor mode");
 
-         // Check if shader compiled & linked properly
-         gl::GLint isLinked = 0;
-         gl::glGetProgramiv(vertexShader->object, gl::GL_LINK_STATUS, &isLinked);
-
-         if (!isLinked) {
-            auto log = getProgramLog(vertexShader->object);
-            gLog->error("OpenGL failed to compile vertex shader:\n{}", log);
-            gLog->error("Fetch Disassembly:\n{}\n", fetchShader->disassembly);
-            gLog->error("Shader Disassembly:\n{}\n", vertexShader->disassembly);
-            gLog->error("Shader Code:\n{}\n", vertexShader->code);
-            return false;
+            bufferUsed[attribBufferId] = true;
+            bufferDivisor[attribBufferId] = divisor;
+         } else {
+            decaf_abort("We do not yet support binding of non-attribute buffers");
          }
+      }
 
-         // Get uniform locations
-         vertexShader->uniformRegisters = gl::glGetUniformLocation(vertexShader->object, "VR");
-         vertexShader->uniformViewport = gl::glGetUniformLocation(vertexShader->object, "uViewport");
-
-         // Get attribute locations
-         vertexShader->attribLocations.fill(0);
-
-         for (auto &attrib : fetchShader->attribs) {
-            auto name = fmt::format("fs_out_{}", attrib.location);
-            vertexShader->attribLocations[attrib.location] = gl::glGetAttribLocation(vertexShader->object, name.c_str());
+      for (auto bufferId = 0; bufferId < latte::MaxAttributes; ++bufferId) {
+         if (bufferUsed[bufferId]) {
+            gl::glVertexArrayBindingDivisor(fetchShader->object, bufferId, bufferDivisor[bufferId]);
          }
       }
+   }
 
-      pipeline.vertex = vertexShader;
-      pipeline.vertex->refCount++;
-      pipeline.vertexKey = vsShaderKey;
-
-      if (pa_cl_clip_cntl.RASTERISER_DISABLE()) {
-
-         // Rasterization disabled; no pixel shader used
-         pipeline.pixel = nullptr;
-
+   // Compile vertex shader if needed
+   auto vsCacheKey = getVertexShaderCacheKey(mRegisters, getHashBytes(*fsBinary), getHashBytes(*vsBinary), isScreenSpace);
+   auto &vertexShader = mVertexShaders[vsCacheKey];
+
+   if (!vertexShader) {
+      vertexShader = new VertexShader;
+      vertexShader->address = vsPgmAddress;
+      vertexShader->cacheKey = vsCacheKey;
+      vertexShader->outputMap.fill(0xff);
+
+      dumpRawShader("vertex", vsPgmAddress, vsPgmSize);
+
+      if (auto cached = mShaderCache.find(vertexShader->cacheKey)) {
+         vertexShader->isScreenSpace = cached->isScreenSpace;
+         vertexShader->outputMap = cached->outputMap;
+         vertexShader->usedUniformBlocks = cached->usedUniformBlocks;
+         vertexShader->usedFeedbackBuffers = cached->usedFeedbackBuffers;
+         vertexShader->disassembly = cached->disassembly;
+         vertexShader->code = cached->code;
+         linkVertexShader(*vertexShader, *fetchShader, *cached, 0);
       } else {
+         auto job = std::unique_ptr<ShaderCompileJob> { new ShaderCompileJob { } };
+         job->type = glsl2::Shader::VertexShader;
+         job->fetch = fetchShader;
+         job->vertex = vertexShader;
+         job->binary.assign(mem::translate<uint8_t>(vsPgmAddress), mem::translate<uint8_t>(vsPgmAddress) + vsPgmSize);
+         job->isScreenSpace = isScreenSpace;
+         job->fetchAttribs = fetchShader->attribs;
+         job->fetchDisassembly = fetchShader->disassembly;
+         submitShaderCompile(std::move(job));
+      }
+   }
 
-         // Transform feedback disabled; compile pixel shader if needed
-         auto &pixelShader = mPixelShaders[psShaderKey];
-         invalidateShaderIfChanged(pixelShader, psShaderKey, mPixelShaders, mResourceMap);
-
-         if (!pixelShader) {
-            pixelShader = new PixelShader;
-
-            pixelShader->cpuMemStart = psPgmAddress;
-            pixelShader->cpuMemEnd = psPgmAddress + psPgmSize;
-            MurmurHash3_x64_128(mem::translate(pixelShader->cpuMemStart),
-                                pixelShader->cpuMemEnd - pixelShader->cpuMemStart,
-                                0, pixelShader->cpuMemHash);
-            pixelShader->dirtyMemory = false;
-            mResourceMap.addResource(pixelShader);
-
-            dumpRawShader("pixel", psPgmAddress, psPgmSize);
+   // Compile pixel shader if needed, there is none when rasterization is
+   //  disabled for transform feedback.
+   PixelShader *pixelShader = nullptr;
 
-            if (!compilePixelShader(*pixelShader, *vertexShader, mem::translate(psPgmAddress), psPgmSize)) {
-               gLog->error("Failed to recompile pixel shader");
-               return false;
-            }
+   if (psBinary) {
+      auto psCacheKey = getPixelShaderCacheKey(mRegisters, vertexShader->cacheKey, getHashBytes(*psBinary));
+      auto &shader = mPixelShaders[psCacheKey];
 
-            dumpTranslatedShader("pixel", psPgmAddress, pixelShader->code);
+      if (!shader) {
+         shader = new PixelShader;
+         shader->address = psPgmAddress;
+         shader->cacheKey = psCacheKey;
+         shader->sx_alpha_test_control = sx_alpha_test_control;
 
-            // Create OpenGL Shader
-            const gl::GLchar *code[] = { pixelShader->code.c_str() };
-            pixelShader->object = gl::glCreateShaderProgramv(gl::GL_FRAGMENT_SHADER, 1, code);
+         dumpRawShader("pixel", psPgmAddress, psPgmSize);
 
-            if (decaf::config::gpu::debug) {
-               std::string label = fmt::format("pixel shader @ 0x{:08X}", psPgmAddress);
-               gl::glObjectLabel(gl::GL_PROGRAM, pixelShader->object, -1, label.c_str());
-            }
+         if (auto cached = mShaderCache.find(shader->cacheKey)) {
+            shader->samplerUsage = cached->samplerUsage;
+            shader->usedUniformBlocks = cached->usedUniformBlocks;
+            shader->disassembly = cached->disassembly;
+            shader->code = cached->code;
+            linkPixelShader(*shader, *cached, 0);
+         } else {
+            auto job = std::unique_ptr<ShaderCompileJob> { new ShaderCompileJob { } };
+            job->type = glsl2::Shader::PixelShader;
+            job->vertex = vertexShader;
+            job->pixel = shader;
+            job->binary.assign(mem::translate<uint8_t>(psPgmAddress), mem::translate<uint8_t>(psPgmAddress) + psPgmSize);
+
+            // The vertex shader may still be pending, but its output map only
+            //  depends on registers covered by its cache key, which is in ours.
+            job->vertexOutputMap = getVertexOutputMap(mRegisters);
+            submitShaderCompile(std::move(job));
+         }
+      }
 
-            // Check if shader compiled & linked properly
-            gl::GLint isLinked = 0;
-            gl::glGetProgramiv(pixelShader->object, gl::GL_LINK_STATUS, &isLinked);
+      pixelShader = shader;
+   }
 
-            if (!isLinked) {
-               auto log = getProgramLog(pixelShader->object);
-               gLog->error("OpenGL failed to compile pixel shader:\n{}", log);
-               gLog->error("Shader Disassembly:\n{}\n", pixelShader->disassembly);
-               gLog->error("Shader Code:\n{}\n", pixelShader->code);
-               return false;
-            }
+   auto &pipeline = mShaderPipelines[ShaderPipelineKey { fetchShader, vertexShader, pixelShader }];
 
-            // Get uniform locations
-            pixelShader->uniformRegisters = gl::glGetUniformLocation(pixelShader->object, "PR");
-            pixelShader->uniformAlphaRef = gl::glGetUniformLocation(pixelShader->object, "uAlphaRef");
-            pixelShader->sx_alpha_test_control = sx_alpha_test_control;
-         }
+   // Generate shader if needed
+   if (!pipeline.object) {
+      pipeline.fetch = fetchShader;
+      pipeline.vertex = vertexShader;
+      pipeline.pixel = pixelShader;
 
-         pipeline.pixel = pixelShader;
-         pipeline.pixel->refCount++;
+      // Transform feedback output may be read back by the guest, so never
+      //  skip those draws.
+      if (!checkPipelineShadersReady(pipeline, !vgt_strmout_en.STREAMOUT())) {
+         mActiveShader = nullptr;
+         return false;
       }
 
-      pipeline.pixelKey = psShaderKey;
-
       // Create pipeline
       gl::glCreateProgramPipelines(1, &pipeline.object);
       if (decaf::config::gpu::debug) {
@@ -508,6 +501,8 @@ bool GLDriver::checkActiveShader()
 
    // Set active shader
    mActiveShader = &pipeline;
+   mActiveShaderAddressKey = addressKey;
+   mActiveShaderBinaries = { fsBinary, vsBinary, psBinary };
 
    // Set alpha reference
    if (mActiveShader->pixel && alphaTestFunc != latte::REF_FUNC::ALWAYS && alphaTestFunc != latte::REF_FUNC::NEVER) {
@@ -560,25 +555,11 @@ bool GLDriver::checkActiveUniforms()
    if (sq_config.DX9_CONSTS()) {
       // Upload uniform registers
       if (mActiveShader->vertex && mActiveShader->vertex->object) {
-         auto uploadCount = countModifiedUniforms(latte::Register::SQ_ALU_CONSTANT0_256, mActiveShader->vertex->lastUniformUpdate);
-
-         if (uploadCount > 0) {
-            auto values = reinterpret_cast<float *>(&mRegisters[latte::Register::SQ_ALU_CONSTANT0_256 / 4]);
-            gl::glProgramUniform4fv(mActiveShader->vertex->object, mActiveShader->vertex->uniformRegisters, uploadCount, values);
-
-            mActiveShader->vertex->lastUniformUpdate = ++mUniformUpdateGen;
-         }
+         uploadUniformRegisters(mVertexUniformRegisters, latte::Register::SQ_ALU_CONSTANT0_256, 32);
       }
 
       if (mActiveShader->pixel && mActiveShader->pixel->object) {
-         auto uploadCount = countModifiedUniforms(latte::Register::SQ_ALU_CONSTANT0_0, mActiveShader->pixel->lastUniformUpdate);
-
-         if (uploadCount > 0) {
-            auto values = reinterpret_cast<float *>(&mRegisters[latte::Register::SQ_ALU_CONSTANT0_0 / 4]);
-            gl::glProgramUniform4fv(mActiveShader->pixel->object, mActiveShader->pixel->uniformRegisters, uploadCount, values);
-
-            mActiveShader->pixel->lastUniformUpdate = ++mUniformUpdateGen;
-         }
+         uploadUniformRegisters(mPixelUniformRegisters, latte::Register::SQ_ALU_CONSTANT0_0, 33);
       }
    } else {
       if (mActiveShader->vertex && mActiveShader->vertex->object) {
@@ -586,28 +567,16 @@ bool GLDriver::checkActiveUniforms()
             auto sq_alu_const_cache_vs = getRegister<uint32_t>(latte::Register::SQ_ALU_CONST_CACHE_VS_0 + 4 * i);
             auto sq_alu_const_buffer_size_vs = getRegister<uint32_t>(latte::Register::SQ_ALU_CONST_BUFFER_SIZE_VS_0 + 4 * i);
             auto used = mActiveShader->vertex->usedUniformBlocks[i];
-            auto bufferObject = gl::GLuint { 0 };
-
-            if (!used || !sq_alu_const_buffer_size_vs) {
-               bufferObject = 0;
-            } else {
-               auto addr = sq_alu_const_cache_vs << 8;
-               auto size = sq_alu_const_buffer_size_vs << 8;
+            auto addr = sq_alu_const_cache_vs << 8;
+            auto size = sq_alu_const_buffer_size_vs << 8;
 
+            if (used && size) {
                // Check that we can fit the uniform block into OpenGL buffers
                decaf_assert(size <= gpu::opengl::MaxUniformBlockSize,
                   fmt::format("Active uniform block with data size {} greater than what OpenGL supports {}", size, MaxUniformBlockSize));
-
-               auto buffer = getDataBuffer(addr, size, true, false);
-
-               bufferObject = buffer->object;
             }
 
-            // Bind (or unbind) block
-            if (mUniformBlockCache[i].vsObject != bufferObject) {
-               mUniformBlockCache[i].vsObject = bufferObject;
-               gl::glBindBufferBase(gl::GL_UNIFORM_BUFFER, i, bufferObject);
-            }
+            bindUniformBlock(mUniformBlockCache[i].vs, i, used ? addr : 0, size);
          }
       }
 
@@ -616,29 +585,105 @@ bool GLDriver::checkActiveUniforms()
             auto sq_alu_const_cache_ps = getRegister<uint32_t>(latte::Register::SQ_ALU_CONST_CACHE_PS_0 + 4 * i);
             auto sq_alu_const_buffer_size_ps = getRegister<uint32_t>(latte::Register::SQ_ALU_CONST_BUFFER_SIZE_PS_0 + 4 * i);
             auto used = mActiveShader->pixel->usedUniformBlocks[i];
-            auto bufferObject = gl::GLuint { 0 };
+            auto addr = sq_alu_const_cache_ps << 8;
+            auto size = sq_alu_const_buffer_size_ps << 8;
 
-            if (!used || !sq_alu_const_buffer_size_ps) {
-               bufferObject = 0;
-            } else {
-               auto addr = sq_alu_const_cache_ps << 8;
-               auto size = sq_alu_const_buffer_size_ps << 8;
+            bindUniformBlock(mUniformBlockCache[i].ps, 16 + i, used ? addr : 0, size);
+         }
+      }
+   }
 
-               auto buffer = getDataBuffer(addr, size, true, false);
+   return true;
+}
 
-               bufferObject = buffer->object;
-            }
+void
+GLDriver::uploadUniformRegisters(UniformRegisterCache &cache,
+                                 latte::Register firstReg,
+                                 uint32_t binding)
+{
+   if (cache.position
+    && mStreamBuffer.isRecent(cache.position)
+    && countModifiedUniforms(firstReg, cache.lastUniformUpdate) == 0) {
+      return;
+   }
 
-            // Bind (or unbind) block
-            if (mUniformBlockCache[i].psObject != bufferObject) {
-               mUniformBlockCache[i].psObject = bufferObject;
-               gl::glBindBufferBase(gl::GL_UNIFORM_BUFFER, 16 + i, bufferObject);
-            }
-         }
+   // The whole register file is copied, one 4KB copy is cheaper than the
+   //  many small uploads it would take to only copy the modified groups.
+   auto size = static_cast<uint32_t>(latte::MaxUniformRegisters * 4 * sizeof(float));
+   auto offset = uint32_t { 0 };
+   auto dst = allocateStreamBuffer(size, mUniformBufferAlignment, offset);
+   decaf_check(dst);
+   std::memcpy(dst, &mRegisters[firstReg / 4], size);
+
+   cache.position = mStreamBuffer.getHead();
+   cache.lastUniformUpdate = ++mUniformUpdateGen;
+   gl::glBindBufferRange(gl::GL_UNIFORM_BUFFER, binding, mStreamBuffer.getObject(), offset, size);
+}
+
+void
+GLDriver::bindUniformBlock(UniformBlockBinding &cache,
+                           uint32_t binding,
+                           uint32_t address,
+                           uint32_t size)
+{
+   auto object = gl::GLuint { 0 };
+   auto offset = uint32_t { 0 };
+
+   if (address && size) {
+      auto output = mDataBuffers.find(address);
+
+      if (output != mDataBuffers.end() && output->second.isOutput) {
+         // Written by transform feedback, so only the GPU copy is up to date
+         object = getDataBuffer(address, size, true, false)->object;
+      } else {
+         auto data = getStreamedData(address, size, mUniformBufferAlignment);
+         object = mStreamBuffer.getObject();
+         offset = data->offset;
       }
    }
 
-   return true;
+   if (cache.object == object && cache.offset == offset && cache.size == size) {
+      return;
+   }
+
+   cache.object = object;
+   cache.offset = offset;
+   cache.size = size;
+
+   if (!object) {
+      gl::glBindBufferBase(gl::GL_UNIFORM_BUFFER, binding, 0);
+   } else {
+      gl::glBindBufferRange(gl::GL_UNIFORM_BUFFER, binding, object, offset, size);
+   }
+}
+
+StreamedData *
+GLDriver::getStreamedData(uint32_t address,
+                          uint32_t size,
+                          uint32_t alignment)
+{
+   auto &data = mStreamedData[static_cast<uint64_t>(address) << 32 | size];
+
+   if (!data) {
+      data = new StreamedData;
+      data->cpuMemStart = address;
+      data->cpuMemEnd = address + size;
+      mResourceMap.addResource(data);
+   }
+
+   // Copy again if the guest changed the data or the stream buffer is close
+   //  to wrapping around onto our previous copy.
+   if (data->dirtyMemory || !data->position || !mStreamBuffer.isRecent(data->position)) {
+      data->dirtyMemory = false;
+
+      // Uniform blocks are far smaller than the stream buffer limit
+      auto dst = allocateStreamBuffer(size, alignment, data->offset);
+      decaf_check(dst);
+      std::memcpy(dst, mem::translate(address), size);
+      data->position = mStreamBuffer.getHead();
+   }
+
+   return data;
 }
 
 DataBuffer *
@@ -944,712 +989,415 @@ bool GLDriver::parseFetchShader(FetchShader &shader, void *buffer, size_t size)
    return false;
 }
 
-static const char *
-getGLSLDataInFormat(latte::SQ_DATA_FORMAT format, latte::SQ_NUM_FORMAT num, latte::SQ_FORMAT_COMP comp)
+ShaderBinary *
+GLDriver::getShaderBinary(uint32_t address,
+                          uint32_t size)
 {
-   switch (format) {
-   case latte::SQ_DATA_FORMAT::FMT_2_10_10_10:
-   case latte::SQ_DATA_FORMAT::FMT_10_10_10_2:
-      return "uint";
-   }
+   auto &binary = mShaderBinaries[static_cast<uint64_t>(address) << 32 | size];
 
-   auto channels = getDataFormatComponents(format);
+   if (!binary) {
+      binary = new ShaderBinary;
+      binary->cpuMemStart = address;
+      binary->cpuMemEnd = address + size;
+      mResourceMap.addResource(binary);
+   }
 
-   switch (channels) {
-   case 1:
-      return "uint";
-   case 2:
-      return "uvec2";
-   case 3:
-      return "uvec3";
-   case 4:
-      return "uvec4";
-   default:
-      decaf_abort(fmt::format("Unimplemented attribute channel count: {} for {}", channels, format));
+   if (binary->needRehash) {
+      MurmurHash3_x64_128(mem::translate(address), size, 0, binary->cpuMemHash);
+      binary->needRehash = false;
    }
+
+   return binary;
 }
 
-bool GLDriver::compileVertexShader(VertexShader &vertex, FetchShader &fetch, uint8_t *buffer, size_t size, bool isScreenSpace)
+glsl2::ShaderCacheKey
+GLDriver::getFetchShaderKey(const ShaderBinary &fetch)
 {
-   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
-   auto spi_vs_out_config = getRegister<latte::SPI_VS_OUT_CONFIG>(latte::Register::SPI_VS_OUT_CONFIG);
-   std::array<FetchShader::Attrib *, 32> semanticAttribs;
-   semanticAttribs.fill(nullptr);
+   // The instance step rates are baked into the vertex array's divisors
+   auto key = glsl2::ShaderCacheKeyBuilder { };
 
-   glsl2::Shader shader;
-   shader.type = glsl2::Shader::VertexShader;
+   key.add(getHashBytes(fetch))
+      .add(getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_0))
+      .add(getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_1));
 
-   for (auto i = 0; i < latte::MaxSamplers; ++i) {
-      auto resourceOffset = (latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + i) * 7;
-      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+   return key.finish();
+}
 
-      shader.samplerDim[i] = sq_tex_resource_word0.DIM();
-   }
+void
+GLDriver::openShaderCache()
+{
+   mShaderCacheOpened = true;
 
-   if (sq_config.DX9_CONSTS()) {
-      shader.uniformRegistersEnabled = true;
-   } else {
-      shader.uniformBlocksEnabled = true;
+   if (!decaf::config::gpu::shader_cache) {
+      return;
    }
 
-   vertex.disassembly = latte::disassemble(gsl::make_span(buffer, size));
+   auto titleId = kernel::getGameInfo().app.title_id;
+   auto path = decaf::makeConfigPath(fmt::format("shader_cache/{:016X}.bin", titleId));
+   platform::createParentDirectories(path);
 
-   if (!glsl2::translate(shader, gsl::make_span(buffer, size))) {
-      gLog->error("Failed to decode vertex shader\n{}", vertex.disassembly);
-      return false;
+   if (!mShaderCache.open(path)) {
+      return;
    }
 
-   vertex.usedUniformBlocks = shader.usedUniformBlocks;
+   gl::GLint numBinaryFormats = 0;
+   gl::glGetIntegerv(gl::GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
 
-   fmt::MemoryWriter out;
-   out << shader.fileHeader;
+   if (!numBinaryFormats) {
+      return;
+   }
 
-   out << "#define bswap16(v) (packUnorm4x8(unpackUnorm4x8(v).yxwz))\n";
-   out << "#define bswap32(v) (packUnorm4x8(unpackUnorm4x8(v).wzyx))\n";
-   out << "#define signext2(v) ((v ^ 0x2) - 0x2)\n";
-   out << "#define signext8(v) ((v ^ 0x80) - 0x80)\n";
-   out << "#define signext10(v) ((v ^ 0x200) - 0x200)\n";
-   out << "#define signext16(v) ((v ^ 0x8000) - 0x8000)\n";
+   // Create every program up front, so the title does not stall the first
+   //  time it draws with each shader.
+   for (auto &itr : mShaderCache.getShaders()) {
+      auto program = createProgramFromBinary(itr.second);
 
-   // Vertex Shader Inputs
-   for (auto &attrib : fetch.attribs) {
-      semanticAttribs[attrib.location] = &attrib;
-
-      out << "//";
-      out << " " << getDataFormatName(attrib.format);
-      if (attrib.formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
-         out << " SIGNED";
-      } else {
-         out << " UNSIGNED";
-      }
-      if (attrib.numFormat == latte::SQ_NUM_FORMAT::INT) {
-         out << " INT";
-      } else if (attrib.numFormat == latte::SQ_NUM_FORMAT::NORM) {
-         out << " NORM";
-      } else if (attrib.numFormat == latte::SQ_NUM_FORMAT::SCALED) {
-         out << " SCALED";
-      }
-      if (attrib.endianSwap == latte::SQ_ENDIAN::NONE) {
-         out << " SWAP_NONE";
-      } else if (attrib.endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
-         out << " SWAP_8IN32";
-      } else if (attrib.endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
-         out << " SWAP_8IN16";
-      } else if (attrib.endianSwap == latte::SQ_ENDIAN::AUTO) {
-         out << " SWAP_AUTO";
-      }
-      out << "\n";
-
-      out << "layout(location = " << attrib.location << ")";
-      out << " in "
-          << getGLSLDataInFormat(attrib.format, attrib.numFormat, attrib.formatComp)
-         << " fs_out_" << attrib.location << ";\n";
-   }
-   out << '\n';
-
-   // Vertex Shader Exports
-   decaf_check(!spi_vs_out_config.VS_PER_COMPONENT());
-   vertex.outputMap.fill(0xff);
-
-   for (auto i = 0u; i <= spi_vs_out_config.VS_EXPORT_COUNT(); i++) {
-      auto regId = i / 4;
-      auto spi_vs_out_id = getRegister<latte::SPI_VS_OUT_ID_N>(latte::Register::SPI_VS_OUT_ID_0 + 4 * regId);
-
-      auto semanticNum = i % 4;
-      uint8_t semanticId = 0xff;
-
-      if (semanticNum == 0) {
-         semanticId = spi_vs_out_id.SEMANTIC_0();
-      } else if (semanticNum == 1) {
-         semanticId = spi_vs_out_id.SEMANTIC_1();
-      } else if (semanticNum == 2) {
-         semanticId = spi_vs_out_id.SEMANTIC_2();
-      } else if (semanticNum == 3) {
-         semanticId = spi_vs_out_id.SEMANTIC_3();
+      if (program) {
+         mPreloadedPrograms[itr.first] = program;
       }
+   }
 
-      if (semanticId == 0xff) {
-         // Stop looping when we hit the end marker
-         break;
-      }
+   gLog->info("Preloaded {} of {} cached shader programs", mPreloadedPrograms.size(), mShaderCache.getShaders().size());
+}
 
-      decaf_check(vertex.outputMap[semanticId] == 0xff);
-      vertex.outputMap[semanticId] = i;
+gl::GLuint
+GLDriver::createCachedProgram(const glsl2::ShaderCacheKey &key,
+                              gl::GLenum type,
+                              const glsl2::CachedShader &shader)
+{
+   auto preloaded = mPreloadedPrograms.find(key);
 
-      out << "layout(location = " << i << ")";
-      out << " out vec4 vs_out_" << semanticId << ";\n";
+   if (preloaded != mPreloadedPrograms.end()) {
+      auto program = preloaded->second;
+      mPreloadedPrograms.erase(preloaded);
+      return program;
    }
-   out << '\n';
 
-   // Transform feedback outputs
-   for (auto i = 0u; i < latte::MaxStreamOutBuffers; ++i) {
-      vertex.usedFeedbackBuffers[i] = !shader.feedbacks[i].empty();
+   if (auto program = createProgramFromBinary(shader)) {
+      return program;
+   }
 
-      if (vertex.usedFeedbackBuffers[i]) {
-         auto vgt_strmout_vtx_stride = getRegister<uint32_t>(latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + 16 * i);
-         auto stride = vgt_strmout_vtx_stride * 4;
+   auto program = createProgramFromSource(type, shader.code);
 
-         if (NVIDIA_GLSL_WORKAROUND) {
-            out
-               << "layout(xfb_buffer = " << i << ") out;\n"
-               << "layout(xfb_stride = " << stride
-               << ") out feedback_block" << i << " {\n";
-         } else {
-            out
-               << "layout(xfb_buffer = " << i
-               << ", xfb_stride = " << stride
-               << ") out feedback_block" << i << " {\n";
-         }
+   // Store new shaders, or replace ones whose binary the driver rejected
+   if (mShaderCache.isOpen() && isProgramLinked(program)) {
+      auto entry = shader;
+      getProgramBinary(program, entry);
+      mShaderCache.insert(key, entry);
+   }
 
-         for (auto &xfb : shader.feedbacks[i]) {
-            out << "   layout(xfb_offset = " << xfb.offset << ") out ";
+   return program;
+}
 
-            if (xfb.size == 1) {
-               out << "float";
-            } else {
-               out << "vec" << xfb.size;
-            }
+bool
+GLDriver::linkVertexShader(VertexShader &vertex,
+                           FetchShader &fetch,
+                           const glsl2::CachedShader &shader,
+                           gl::GLuint object)
+{
+   dumpTranslatedShader("vertex", vertex.address, vertex.code);
 
-            out << " feedback_" << xfb.streamIndex << "_" << xfb.offset << ";\n";
-         }
+   // Create OpenGL Shader, unless the compiler thread already did
+   if (object) {
+      vertex.object = object;
 
-         out << "};\n";
+      if (mShaderCache.isOpen() && isProgramLinked(object)) {
+         mShaderCache.insert(vertex.cacheKey, shader);
       }
+   } else {
+      vertex.object = createCachedProgram(vertex.cacheKey, gl::GL_VERTEX_SHADER, shader);
    }
-   out << '\n';
 
-   if (isScreenSpace) {
-      vertex.isScreenSpace = true;
-      out << "uniform vec4 uViewport;\n";
+   if (decaf::config::gpu::debug) {
+      std::string label = fmt::format("vertex shader @ 0x{:08X}", vertex.address);
+      gl::glObjectLabel(gl::GL_PROGRAM, vertex.object, -1, label.c_str());
    }
 
-   out
-      << "void main()\n"
-      << "{\n"
-      << shader.codeHeader;
-
-   // Assign fetch shader output to our GPR
-   for (auto i = 0u; i < 32; ++i) {
-      auto sq_vtx_semantic = getRegister<latte::SQ_VTX_SEMANTIC_N>(latte::Register::SQ_VTX_SEMANTIC_0 + i * 4);
-      auto id = sq_vtx_semantic.SEMANTIC_ID();
-
-      if (id == 0xff) {
-         continue;
-      }
-
-      auto attrib = semanticAttribs[id];
-
-      if (!attrib) {
-         gLog->error("Invalid semantic mapping: {}", id);
-         continue;
-      }
-
-
-      fmt::MemoryWriter nameWriter;
-      nameWriter << "fs_out_" << attrib->location;
-      auto name = nameWriter.str();
-      auto channels = getDataFormatComponents(attrib->format);
-      auto isFloat = getDataFormatIsFloat(attrib->format);
-
-      std::string chanVal[4];
-      uint32_t chanBitCount[4];
-
-      if (attrib->format == latte::SQ_DATA_FORMAT::FMT_10_10_10_2 || attrib->format == latte::SQ_DATA_FORMAT::FMT_2_10_10_10) {
-         decaf_check(channels == 4);
-
-         auto val = name;
-
-         if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
-            val = "bswap32(" + val + ")";
-         } else if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
-            decaf_abort("Unexpected 8IN16 swap for 10_10_10_2");
-         } else if (attrib->endianSwap == latte::SQ_ENDIAN::NONE) {
-            // Nothing to do
-         } else {
-            decaf_abort("Unexpected endian swap mode");
-         }
-
-         if (attrib->format == latte::SQ_DATA_FORMAT::FMT_10_10_10_2) {
-            chanVal[0] = std::string("((") + val + std::string(" >> 22) & 0x3ff)");
-            chanVal[1] = std::string("((") + val + std::string(" >> 12) & 0x3ff)");
-            chanVal[2] = std::string("((") + val + std::string(" >> 2) & 0x3ff)");
-            chanVal[3] = std::string("((") + val + std::string(" >> 0) & 0x3)");
-         } else if (attrib->format == latte::SQ_DATA_FORMAT::FMT_2_10_10_10) {
-            chanVal[3] = std::string("((") + val + std::string(" >> 30) & 0x3)");
-            chanVal[2] = std::string("((") + val + std::string(" >> 20) & 0x3ff)");
-            chanVal[1] = std::string("((") + val + std::string(" >> 10) & 0x3ff)");
-            chanVal[0] = std::string("((") + val + std::string(" >> 0) & 0x3ff)");
-         } else {
-            decaf_abort("Unexpected format");
-         }
-
-         if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
-            chanVal[0] = "int(signext10(" + chanVal[0] + "))";
-            chanVal[1] = "int(signext10(" + chanVal[1] + "))";
-            chanVal[2] = "int(signext10(" + chanVal[2] + "))";
-            chanVal[3] = "int(" + chanVal[3] + ")";
-         } else {
-            // Good to go!
-         }
-
-         chanBitCount[0] = 10;
-         chanBitCount[1] = 10;
-         chanBitCount[2] = 10;
-         chanBitCount[3] = 2;
-      } else {
-         static const char * ChannelSelNorm[] = { "x" ,"y", "z", "w" };
-
-         auto compBits = getDataFormatComponentBits(attrib->format);
-
-         for (auto ch = 0u; ch < channels; ++ch) {
-            auto &val = chanVal[ch];
-            val = name;
-
-            if (attrib->endianSwap == latte::SQ_ENDIAN::NONE) {
-               // Nothing to do except select the appropriate component.
-
-               if (channels > 1) {
-                  val = val + "." + ChannelSelNorm[ch];
-               }
-            } else {
-               if (compBits == 32) {
-                  if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
-                     if (channels > 1) {
-                        val = val + "." + ChannelSelNorm[ch];
-                     }
-
-                     val = "bswap32(" + val + ")";
-                  } else {
-                     decaf_abort("Unexpected endian swap mode for 32-bit components");
-                  }
-               } else if (compBits == 16) {
-                  if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
-                     if (channels > 1) {
-                        val = val + "." + ChannelSelNorm[ch];
-                     }
-
-                     val = "bswap16(" + val + ")";
-                  } else {
-                     decaf_abort("Unexpected endian swap mode for 16-bit components");
-                  }
-               } else if (compBits == 8) {
-                  static const char * ChannelSel8In16[] = { "y", "x", "w", "z" };
-                  static const char * ChannelSel8In32[] = { "w", "z", "y", "x" };
-
-                  if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
-                     decaf_check(channels == 2 || channels == 4);
-                     val = val + "." + ChannelSel8In16[ch];
-                  } else if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
-                     decaf_check(channels == 4);
-                     val = val + "." + ChannelSel8In32[ch];
-                  } else {
-                     decaf_abort("Unexpected endian swap mode for 8-bit components");
-                  }
-               } else {
-                  decaf_abort("Unexpected component bit count with swapping");
-               }
-            }
+   // Check if shader compiled & linked properly
+   if (!isProgramLinked(vertex.object)) {
+      auto log = getProgramLog(vertex.object);
+      gLog->error("OpenGL failed to compile vertex shader:\n{}", log);
+      gLog->error("Fetch Disassembly:\n{}\n", fetch.disassembly);
+      gLog->error("Shader Disassembly:\n{}\n", vertex.disassembly);
+      gLog->error("Shader Code:\n{}\n", vertex.code);
+      vertex.state = ShaderState::Failed;
+      return false;
+   }
 
-            if (isFloat) {
-               if (compBits == 32) {
-                  val = "uintBitsToFloat(" + val + ")";
-               } else if (compBits == 16) {
-                  val = "unpackHalf2x16(" + val + ").x";
-               } else {
-                  decaf_abort("Unexpected float component bit count");
-               }
-            } else {
-               if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
-                  if (compBits == 8) {
-                     val = "int(signext8(" + val + "))";
-                  } else if (compBits == 16) {
-                     val = "int(signext16(" + val + "))";
-                  } else if (compBits == 32) {
-                     val = "int(" + val + ")";
-                  } else {
-                     decaf_abort("Unexpected signed component bit count");
-                  }
-               } else {
-                  // Already the right format!
-               }
-            }
+   // Get uniform locations
+   vertex.uniformViewport = gl::glGetUniformLocation(vertex.object, "uViewport");
 
-            chanBitCount[ch] = compBits;
-         }
-      }
+   // Get attribute locations
+   vertex.attribLocations.fill(0);
 
-      for (auto ch = 0u; ch < channels; ++ch) {
-         if (attrib->numFormat == latte::SQ_NUM_FORMAT::NORM) {
-            uint32_t valMax = (1ul << chanBitCount[ch]) - 1;
+   for (auto &attrib : fetch.attribs) {
+      auto name = fmt::format("fs_out_{}", attrib.location);
+      vertex.attribLocations[attrib.location] = gl::glGetAttribLocation(vertex.object, name.c_str());
+   }
 
-            if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
-               chanVal[ch] = fmt::format("clamp(float({}) / {}.0, -1.0, 1.0)", chanVal[ch], valMax / 2);
-            } else {
-               chanVal[ch] = fmt::format("float({}) / {}.0", chanVal[ch], valMax);
-            }
-         } else if (attrib->numFormat == latte::SQ_NUM_FORMAT::INT) {
-            if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
-               chanVal[ch] = "intBitsToFloat(int(" + chanVal[ch] + "))";
-            } else {
-               chanVal[ch] = "uintBitsToFloat(uint(" + chanVal[ch] + "))";
-            }
-         } else if (attrib->numFormat == latte::SQ_NUM_FORMAT::SCALED) {
-            chanVal[ch] = "float(" + chanVal[ch] + ")";
-         } else {
-            decaf_abort("Unexpected attribute number format");
-         }
-      }
+   vertex.state = ShaderState::Ready;
+   return true;
+}
 
-      if (channels == 1) {
-         out << "float _" << name << " = " << chanVal[0] << ";\n";
-      } else if (channels == 2) {
-         out << "vec2 _" << name << " = vec2(\n";
-         out << "   " << chanVal[0] << ",\n";
-         out << "   " << chanVal[1] << ");\n";
-      } else if (channels == 3) {
-         out << "vec3 _" << name << " = vec3(\n";
-         out << "   " << chanVal[0] << ",\n";
-         out << "   " << chanVal[1] << ",\n";
-         out << "   " << chanVal[2] << ");\n";
-      } else if (channels == 4) {
-         out << "vec4 _" << name << " = vec4(\n";
-         out << "   " << chanVal[0] << ",\n";
-         out << "   " << chanVal[1] << ",\n";
-         out << "   " << chanVal[2] << ",\n";
-         out << "   " << chanVal[3] << ");\n";
-      } else {
-         decaf_abort("Unexpected format channel count");
-      }
-      name = "_" + name;
+bool
+GLDriver::linkPixelShader(PixelShader &pixel,
+                          const glsl2::CachedShader &shader,
+                          gl::GLuint object)
+{
+   dumpTranslatedShader("pixel", pixel.address, pixel.code);
 
-      // Write the register assignment
-      out << "R[" << (i + 1) << "] = ";
+   // Create OpenGL Shader, unless the compiler thread already did
+   if (object) {
+      pixel.object = object;
 
-      switch (channels) {
-      case 1:
-         out << "vec4(" << name << ", 0.0, 0.0, 1.0);\n";
-         break;
-      case 2:
-         out << "vec4(" << name << ", 0.0, 1.0);\n";
-         break;
-      case 3:
-         out << "vec4(" << name << ", 1.0);\n";
-         break;
-      case 4:
-         out << name << ";\n";
-         break;
+      if (mShaderCache.isOpen() && isProgramLinked(object)) {
+         mShaderCache.insert(pixel.cacheKey, shader);
       }
+   } else {
+      pixel.object = createCachedProgram(pixel.cacheKey, gl::GL_FRAGMENT_SHADER, shader);
    }
 
-   out << '\n' << shader.codeBody << '\n';
-
-   for (auto &exp : shader.exports) {
-      switch (exp.type) {
-      case latte::SQ_EXPORT_TYPE::POS:
-         if (!isScreenSpace) {
-            out << "gl_Position = exp_position_" << exp.id << ";\n";
-         } else {
-            out << "gl_Position = (exp_position_" << exp.id << " - vec4(uViewport.xy, 0.0, 0.0)) * vec4(uViewport.zw, 1.0, 1.0);\n";
-         }
-         break;
-      case latte::SQ_EXPORT_TYPE::PARAM: {
-         decaf_check(!spi_vs_out_config.VS_PER_COMPONENT());
-
-         auto regId = exp.id / 4;
-         auto spi_vs_out_id = getRegister<latte::SPI_VS_OUT_ID_N>(latte::Register::SPI_VS_OUT_ID_0 + 4 * regId);
-
-         auto semanticNum = exp.id % 4;
-         uint8_t semanticId = 0xff;
-
-         if (semanticNum == 0) {
-            semanticId = spi_vs_out_id.SEMANTIC_0();
-         } else if (semanticNum == 1) {
-            semanticId = spi_vs_out_id.SEMANTIC_1();
-         } else if (semanticNum == 2) {
-            semanticId = spi_vs_out_id.SEMANTIC_2();
-         } else if (semanticNum == 3) {
-            semanticId = spi_vs_out_id.SEMANTIC_3();
-         }
+   if (decaf::config::gpu::debug) {
+      std::string label = fmt::format("pixel shader @ 0x{:08X}", pixel.address);
+      gl::glObjectLabel(gl::GL_PROGRAM, pixel.object, -1, label.c_str());
+   }
 
-         if (semanticId != 0xff) {
-            out << "vs_out_" << semanticId << " = exp_param_" << exp.id << ";\n";
-         } else {
-            // This just helps when debugging to understand why it is missing...
-            out << "// vs_out_none = exp_param_" << exp.id << ";\n";
-         }
-      } break;
-      case latte::SQ_EXPORT_TYPE::PIXEL:
-         decaf_abort("Unexpected pixel export in vertex shader.");
-      }
+   // Check if shader compiled & linked properly
+   if (!isProgramLinked(pixel.object)) {
+      auto log = getProgramLog(pixel.object);
+      gLog->error("OpenGL failed to compile pixel shader:\n{}", log);
+      gLog->error("Shader Disassembly:\n{}\n", pixel.disassembly);
+      gLog->error("Shader Code:\n{}\n", pixel.code);
+      pixel.state = ShaderState::Failed;
+      return false;
    }
 
-   out << "}\n";
-   out << "/* VERTEX SHADER DISASSEMBLY\n" << vertex.disassembly << "\n*/\n";
-   out << "/* FETCH SHADER DISASSEMBLY\n" << fetch.disassembly << "\n*/\n";
-   vertex.code = out.str();
+   // Get uniform locations
+   pixel.uniformAlphaRef = gl::glGetUniformLocation(pixel.object, "uAlphaRef");
+
+   pixel.state = ShaderState::Ready;
    return true;
 }
 
-bool GLDriver::compilePixelShader(PixelShader &pixel, VertexShader &vertex, uint8_t *buffer, size_t size)
+bool
+GLDriver::checkPipelineShadersReady(ShaderPipeline &pipeline,
+                                    bool canSkip)
 {
-   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
-   auto spi_ps_in_control_0 = getRegister<latte::SPI_PS_IN_CONTROL_0>(latte::Register::SPI_PS_IN_CONTROL_0);
-   auto spi_ps_in_control_1 = getRegister<latte::SPI_PS_IN_CONTROL_1>(latte::Register::SPI_PS_IN_CONTROL_1);
-   auto cb_shader_mask = getRegister<latte::CB_SHADER_MASK>(latte::Register::CB_SHADER_MASK);
-   auto db_shader_control = getRegister<latte::DB_SHADER_CONTROL>(latte::Register::DB_SHADER_CONTROL);
-   auto sx_alpha_test_control = getRegister<latte::SX_ALPHA_TEST_CONTROL>(latte::Register::SX_ALPHA_TEST_CONTROL);
-
-   decaf_assert(!db_shader_control.STENCIL_REF_EXPORT_ENABLE(), "Stencil exports not implemented");
-
-   glsl2::Shader shader;
-   shader.type = glsl2::Shader::PixelShader;
+   auto isPending = [&]() {
+      return pipeline.vertex->state == ShaderState::Pending
+          || (pipeline.pixel && pipeline.pixel->state == ShaderState::Pending);
+   };
 
-   // Gather Samplers
-   for (auto i = 0; i < latte::MaxSamplers; ++i) {
-      auto resourceOffset = (latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0 + i) * 7;
-      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+   processCompletedShaderCompiles();
 
-      shader.samplerDim[i] = sq_tex_resource_word0.DIM();
+   if (isPending() && canSkip && decaf::config::gpu::skip_pending_shader_draws) {
+      std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+      mShaderStats.skippedDraws++;
+      mActiveShaderPending = true;
+      return false;
    }
 
-   if (sq_config.DX9_CONSTS()) {
-      shader.uniformRegistersEnabled = true;
-   } else {
-      shader.uniformBlocksEnabled = true;
+   while (isPending()) {
+      {
+         std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+         mShaderCompletedCV.wait(lock, [this]() { return !mShaderCompileCompleted.empty(); });
+      }
+
+      processCompletedShaderCompiles();
    }
 
-   pixel.disassembly = latte::disassemble(gsl::make_span(buffer, size));
+   return pipeline.vertex->state == ShaderState::Ready
+       && (!pipeline.pixel || pipeline.pixel->state == ShaderState::Ready);
+}
 
-   if (!glsl2::translate(shader, gsl::make_span(buffer, size))) {
-      gLog->error("Failed to decode pixel shader\n{}", pixel.disassembly);
-      return false;
+void
+GLDriver::submitShaderCompile(std::unique_ptr<ShaderCompileJob> job)
+{
+   if (job->pixel) {
+      job->pixel->state = ShaderState::Pending;
+   } else {
+      job->vertex->state = ShaderState::Pending;
    }
 
-   pixel.samplerUsage = shader.samplerUsage;
-   pixel.usedUniformBlocks = shader.usedUniformBlocks;
+   job->queuedTime = std::chrono::steady_clock::now();
+   mShaderCompilesPending++;
 
-   fmt::MemoryWriter out;
-   out << shader.fileHeader;
-   out << "uniform float uAlphaRef;\n";
+   if (!decaf::config::gpu::async_shaders) {
+      // Still completed via the queue so there is only one path which links
+      //  the result.
+      runShaderCompileJob(*job, mRegisters);
 
-   auto z_order = db_shader_control.Z_ORDER();
-   auto early_z = (z_order == latte::DB_Z_ORDER::EARLY_Z_THEN_LATE_Z || z_order == latte::DB_Z_ORDER::EARLY_Z_THEN_RE_Z);
-   if (early_z) {
-      if (sx_alpha_test_control.ALPHA_TEST_ENABLE() && !sx_alpha_test_control.ALPHA_TEST_BYPASS()) {
-         gLog->debug("Ignoring early-Z because alpha test is enabled");
-         early_z = false;
-      } else if (db_shader_control.KILL_ENABLE()) {
-         gLog->debug("Ignoring early-Z because shader discard is enabled");
-         early_z = false;
-      } else {
-         decaf_assert(!shader.usesDiscard, "Shader uses discard but KILL_ENABLE is not set");
-         for (auto &exp : shader.exports) {
-            if (exp.type == latte::SQ_EXPORT_TYPE::PIXEL && exp.id == 61) {
-               gLog->debug("Ignoring early-Z because shader writes gl_FragDepth");
-               early_z = false;
-               break;
-            }
-         }
-      }
-      if (early_z) {
-         out << "layout(early_fragment_tests) in;\n";
-      }
+      std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+      mShaderCompileCompleted.push_back(std::move(job));
+      return;
    }
 
-   if (spi_ps_in_control_0.POSITION_ENA()) {
-      if (!spi_ps_in_control_0.POSITION_CENTROID()) {
-         out << "layout(pixel_center_integer) ";
-      }
-      out << "in vec4 gl_FragCoord;\n";
+   if (!mShaderCompilerRunning) {
+      mShaderCompilerRunning = true;
+      mShaderCompilerThread = std::thread { [this]() { runShaderCompiler(); } };
+      platform::setThreadName(&mShaderCompilerThread, "GL Shader Compiler");
    }
 
-   // Pixel Shader Inputs
-   std::array<bool, 256> semanticUsed = { false };
-   for (auto i = 0u; i < spi_ps_in_control_0.NUM_INTERP(); ++i) {
-      auto spi_ps_input_cntl = getRegister<latte::SPI_PS_INPUT_CNTL_N>(latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
-      auto semanticId = spi_ps_input_cntl.SEMANTIC();
-      decaf_check(semanticId != 0xff);
+   job->registers = std::unique_ptr<ShaderRegisters> { new ShaderRegisters(mRegisters) };
+   job->createProgram = !!mShaderCompilerContext;
 
-      auto vsOutputLoc = vertex.outputMap[semanticId];
-      if (semanticId == 0xff) {
-         // Missing semantic means we need to apply the default values instead...
-         continue;
-      }
+   std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+   mShaderCompileQueue.push(std::move(job));
+   mShaderCompileCV.notify_one();
+}
 
-      if (semanticUsed[semanticId]) {
-         continue;
-      } else {
-         semanticUsed[semanticId] = true;
-      }
+void
+GLDriver::runShaderCompileJob(ShaderCompileJob &job,
+                              const ShaderRegisters &registers)
+{
+   auto &result = job.result;
+   auto type = gl::GL_VERTEX_SHADER;
+   result.type = job.type;
+
+   // This may run on the compiler thread, so only the job's own copies of
+   //  the shader state are used here.
+   if (job.type == glsl2::Shader::VertexShader) {
+      job.translated = compileVertexShader(result, mShaderCache, job.fetchAttribs, job.fetchDisassembly, registers, gsl::make_span(job.binary), job.isScreenSpace);
+   } else {
+      job.translated = compilePixelShader(result, mShaderCache, job.vertexOutputMap, registers, gsl::make_span(job.binary));
+      type = gl::GL_FRAGMENT_SHADER;
+   }
 
-      out << "layout(location = " << vsOutputLoc << ")";
+   if (!job.translated || !job.createProgram) {
+      return;
+   }
 
-      if (spi_ps_input_cntl.FLAT_SHADE()) {
-         out << " flat";
-      }
+   job.object = createProgramFromSource(type, result.code);
 
-      out << " in vec4 vs_out_" << semanticId << ";\n";
+   if (decaf::config::gpu::shader_cache && isProgramLinked(job.object)) {
+      getProgramBinary(job.object, result);
    }
-   out << '\n';
 
-   // Pixel Shader Exports
-   auto maskBits = cb_shader_mask.value;
+   // The program must be complete before the GPU thread's context uses it
+   gl::glFinish();
+}
 
-   for (auto i = 0; i < 8; ++i) {
-      if (maskBits & 0xf) {
-         out << "out vec4 ps_out_" << i << ";\n";
-      }
+void
+GLDriver::completeShaderCompile(ShaderCompileJob &job)
+{
+   auto latency = duration_ms { std::chrono::steady_clock::now() - job.queuedTime }.count();
 
-      maskBits >>= 4;
+   {
+      std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+      mShaderStats.compiled++;
+      mShaderStats.averageLatencyMs += (latency - mShaderStats.averageLatencyMs) / mShaderStats.compiled;
+      mShaderStats.maxLatencyMs = std::max(mShaderStats.maxLatencyMs, latency);
    }
-   out << '\n';
-
-   out
-      << "void main()\n"
-      << "{\n"
-      << shader.codeHeader;
 
-   // Assign vertex shader output to our GPR
-   for (auto i = 0u; i < spi_ps_in_control_0.NUM_INTERP(); ++i) {
-      auto spi_ps_input_cntl = getRegister<latte::SPI_PS_INPUT_CNTL_N>(latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
-      uint8_t semanticId = spi_ps_input_cntl.SEMANTIC();
-      decaf_check(semanticId != 0xff);
+   if (job.type == glsl2::Shader::VertexShader) {
+      auto &vertex = *job.vertex;
 
-      auto vsOutputLoc = vertex.outputMap[semanticId];
-      out << "R[" << i << "] = ";
-
-      if (vsOutputLoc != 0xff) {
-          out << "vs_out_" << semanticId;
+      if (!job.translated) {
+         gLog->error("Failed to recompile vertex shader");
+         vertex.state = ShaderState::Failed;
       } else {
-         if (spi_ps_input_cntl.DEFAULT_VAL() == 0) {
-            out << "vec4(0, 0, 0, 0)";
-         } else if (spi_ps_input_cntl.DEFAULT_VAL() == 1) {
-            out << "vec4(0, 0, 0, 1)";
-         } else if (spi_ps_input_cntl.DEFAULT_VAL() == 2) {
-            out << "vec4(1, 1, 1, 0)";
-         } else if (spi_ps_input_cntl.DEFAULT_VAL() == 3) {
-            out << "vec4(1, 1, 1, 1)";
-         } else {
-            decaf_abort("Invalid PS input DEFAULT_VAL");
-         }
+         vertex.isScreenSpace = job.result.isScreenSpace;
+         vertex.outputMap = job.result.outputMap;
+         vertex.usedUniformBlocks = job.result.usedUniformBlocks;
+         vertex.usedFeedbackBuffers = job.result.usedFeedbackBuffers;
+         vertex.disassembly = job.result.disassembly;
+         vertex.code = job.result.code;
+         linkVertexShader(vertex, *job.fetch, job.result, job.object);
       }
+   } else {
+      auto &pixel = *job.pixel;
 
-      out << ";\n";
+      if (!job.translated) {
+         gLog->error("Failed to recompile pixel shader");
+         pixel.state = ShaderState::Failed;
+      } else {
+         pixel.samplerUsage = job.result.samplerUsage;
+         pixel.usedUniformBlocks = job.result.usedUniformBlocks;
+         pixel.disassembly = job.result.disassembly;
+         pixel.code = job.result.code;
+         linkPixelShader(pixel, job.result, job.object);
+      }
    }
+}
 
-   if (spi_ps_in_control_0.POSITION_ENA()) {
-      out << "R[" << spi_ps_in_control_0.POSITION_ADDR() << "] = gl_FragCoord;";
+void
+GLDriver::processCompletedShaderCompiles()
+{
+   if (!mShaderCompilesPending) {
+      return;
    }
 
-   decaf_assert(!spi_ps_in_control_0.PARAM_GEN(),
-                fmt::format("Unsupported spi_ps_in_control_0.PARAM_GEN {}, PARAM_GEN_ADDR {}",
-                            spi_ps_in_control_0.PARAM_GEN(),
-                            spi_ps_in_control_0.PARAM_GEN_ADDR()));
-   decaf_check(!spi_ps_in_control_1.GEN_INDEX_PIX());
-   decaf_check(!spi_ps_in_control_1.FIXED_PT_POSITION_ENA());
+   auto completed = std::vector<std::unique_ptr<ShaderCompileJob>> { };
 
-   out << '\n' << shader.codeBody << '\n';
+   {
+      std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+      completed.swap(mShaderCompileCompleted);
+   }
 
-   for (auto &exp : shader.exports) {
-      switch (exp.type) {
-      case latte::SQ_EXPORT_TYPE::PIXEL:
-         if (exp.id == 61) {
-            if (!db_shader_control.Z_EXPORT_ENABLE()) {
-               gLog->warn("Depth export is masked by db_shader_control");
-            } else {
-               out << "gl_FragDepth = exp_pixel_" << exp.id << ".x;\n";
-            }
-         } else {
-            auto mask = (cb_shader_mask.value >> (4 * exp.id)) & 0x0F;
+   for (auto &job : completed) {
+      completeShaderCompile(*job);
+      mShaderCompilesPending--;
+   }
+}
 
-            if (!mask) {
-               gLog->warn("Export is masked by cb_shader_mask");
-            } else {
-               std::string strMask;
+void
+GLDriver::runShaderCompiler()
+{
+   if (mShaderCompilerContext) {
+      mShaderCompilerContext();
+   }
 
-               if (mask & (1 << 0)) {
-                  strMask.push_back('x');
-               }
+   std::unique_lock<std::mutex> lock { mShaderCompileMutex };
 
-               if (mask & (1 << 1)) {
-                  strMask.push_back('y');
-               }
+   while (mShaderCompilerRunning) {
+      if (mShaderCompileQueue.empty()) {
+         mShaderCompileCV.wait(lock);
+         continue;
+      }
 
-               if (mask & (1 << 2)) {
-                  strMask.push_back('z');
-               }
+      auto job = std::move(mShaderCompileQueue.front());
+      mShaderCompileQueue.pop();
 
-               if (mask & (1 << 3)) {
-                  strMask.push_back('w');
-               }
+      lock.unlock();
+      runShaderCompileJob(*job, *job->registers);
+      lock.lock();
 
-               if (sx_alpha_test_control.ALPHA_TEST_ENABLE() && !sx_alpha_test_control.ALPHA_TEST_BYPASS()) {
-                  out << "// Alpha Test ";
-
-                  switch (sx_alpha_test_control.ALPHA_FUNC()) {
-                  case latte::REF_FUNC::NEVER:
-                     out << "REF_NEVER\n";
-                     out << "discard;\n";
-                     break;
-                  case latte::REF_FUNC::LESS:
-                     out << "REF_LESS\n";
-                     out << "if (!(exp_pixel_" << exp.id << ".w < uAlphaRef)) {\n";
-                     out << "   discard;\n}\n";
-                     break;
-                  case latte::REF_FUNC::EQUAL:
-                     out << "REF_EQUAL\n";
-                     out << "if (!(exp_pixel_" << exp.id << ".w == uAlphaRef)) {\n";
-                     out << "   discard;\n}\n";
-                     break;
-                  case latte::REF_FUNC::LESS_EQUAL:
-                     out << "REF_LESS_EQUAL\n";
-                     out << "if (!(exp_pixel_" << exp.id << ".w <= uAlphaRef)) {\n";
-                     out << "   discard;\n}\n";
-                     break;
-                  case latte::REF_FUNC::GREATER:
-                     out << "REF_GREATER\n";
-                     out << "if (!(exp_pixel_" << exp.id << ".w > uAlphaRef)) {\n";
-                     out << "   discard;\n}\n";
-                     break;
-                  case latte::REF_FUNC::NOT_EQUAL:
-                     out << "REF_NOT_EQUAL\n";
-                     out << "if (!(exp_pixel_" << exp.id << ".w != uAlphaRef)) {\n";
-                     out << "   discard;\n}\n";
-                     break;
-                  case latte::REF_FUNC::GREATER_EQUAL:
-                     out << "REF_GREATER_EQUAL\n";
-                     out << "if (!(exp_pixel_" << exp.id << ".w >= uAlphaRef)) {\n";
-                     out << "   discard;\n}\n";
-                     break;
-                  case latte::REF_FUNC::ALWAYS:
-                     out << "REF_ALWAYS\n";
-                     break;
-                  }
-               }
+      mShaderCompileCompleted.push_back(std::move(job));
+      mShaderCompletedCV.notify_all();
+   }
+}
 
-               out
-                  << "ps_out_" << exp.id << "." << strMask
-                  << " = exp_pixel_" << exp.id << "." << strMask;
+void
+GLDriver::stopShaderCompiler()
+{
+   if (!mShaderCompilerThread.joinable()) {
+      return;
+   }
 
-               out << ";\n";
-            }
-         }
-         break;
-      case latte::SQ_EXPORT_TYPE::POS:
-         decaf_abort("Unexpected position export in pixel shader.");
-         break;
-      case latte::SQ_EXPORT_TYPE::PARAM:
-         decaf_abort("Unexpected parameter export in pixel shader.");
-         break;
-      }
+   {
+      std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+      mShaderCompilerRunning = false;
+      mShaderCompileCV.notify_all();
    }
 
-   out << "}\n";
+   mShaderCompilerThread.join();
 
-   out << "/* PIXEL SHADER DISASSEMBLY\n" << pixel.disassembly << "\n*/\n";
+   auto stats = getShaderStats();
+   gLog->info("Compiled {} shaders, average latency {:.2f}ms, max {:.2f}ms, skipped {} draws",
+              stats.compiled, stats.averageLatencyMs, stats.maxLatencyMs, stats.skippedDraws);
+}
 
-   pixel.code = out.str();
-   return true;
+void
+GLDriver::setShaderCompilerContext(const MakeCurrentFunction &makeCurrent)
+{
+   mShaderCompilerContext = makeCurrent;
+}
+
+decaf::OpenGLShaderStats
+GLDriver::getShaderStats()
+{
+   std::unique_lock<std::mutex> lock { mShaderCompileMutex };
+   return mShaderStats;
 }
 
 } // namespace opengl
@@ -0,0 +1,872 @@
+#include "decaf_config.h"
+#include "gpu/glsl2/glsl2_translate.h"
+#include "gpu/gpu_utilities.h"
+#include "gpu/microcode/latte_disassembler.h"
+#include "opengl_shadertranslate.h"
+
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <spdlog/spdlog.h>
+
+// Nothing here may use GL, tools translate shaders with this too.
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+// Enable workaround for NVIDIA GLSL compiler bug which incorrectly fails
+//  on "layout(xfb_buffer = A, xfb_stride = B)" syntax when some buffers
+//  have different strides than others.
+static const auto NVIDIA_GLSL_WORKAROUND = true;
+
+//! Disassembly is only worth the translation time when someone will read it
+static bool
+shouldEmbedDisassembly()
+{
+   return decaf::config::gpu::debug || decaf::config::gx2::dump_shaders;
+}
+
+//! Use a translation from the shader cache if there is one, these are only
+//  written by gfd-tool's offline pre-translation.
+static bool
+translateShader(const glsl2::ShaderCache &cache,
+                glsl2::Shader &shader,
+                gsl::span<const uint8_t> binary)
+{
+   if (cache.findTranslation(glsl2::getTranslationKey(shader, binary), shader)) {
+      return true;
+   }
+
+   return glsl2::translate(shader, binary);
+}
+
+// Translation may run on the driver's compiler thread or in tools, so it
+//  reads registers from a snapshot rather than through getRegister.
+template<typename Type>
+static Type
+readRegister(const ShaderRegisters &registers,
+             uint32_t id)
+{
+   return *reinterpret_cast<const Type *>(&registers[id / 4]);
+}
+
+//! Semantic id of vertex shader parameter export id, 0xff if there is none
+static uint8_t
+getVertexExportSemantic(const ShaderRegisters &registers,
+                        uint32_t id)
+{
+   auto spi_vs_out_id = readRegister<latte::SPI_VS_OUT_ID_N>(registers, latte::Register::SPI_VS_OUT_ID_0 + 4 * (id / 4));
+
+   switch (id % 4) {
+   case 0:
+      return spi_vs_out_id.SEMANTIC_0();
+   case 1:
+      return spi_vs_out_id.SEMANTIC_1();
+   case 2:
+      return spi_vs_out_id.SEMANTIC_2();
+   default:
+      return spi_vs_out_id.SEMANTIC_3();
+   }
+}
+
+std::array<uint8_t, 256>
+getVertexOutputMap(const ShaderRegisters &registers)
+{
+   auto spi_vs_out_config = readRegister<latte::SPI_VS_OUT_CONFIG>(registers, latte::Register::SPI_VS_OUT_CONFIG);
+   auto outputMap = std::array<uint8_t, 256> { };
+   outputMap.fill(0xff);
+
+   decaf_check(!spi_vs_out_config.VS_PER_COMPONENT());
+
+   for (auto i = 0u; i <= spi_vs_out_config.VS_EXPORT_COUNT(); i++) {
+      auto semanticId = getVertexExportSemantic(registers, i);
+
+      if (semanticId == 0xff) {
+         // Stop looping when we hit the end marker
+         break;
+      }
+
+      decaf_check(outputMap[semanticId] == 0xff);
+      outputMap[semanticId] = static_cast<uint8_t>(i);
+   }
+
+   return outputMap;
+}
+
+glsl2::ShaderCacheKey
+getVertexShaderCacheKey(const ShaderRegisters &registers,
+                        gsl::span<const uint8_t> fetchHash,
+                        gsl::span<const uint8_t> vertexHash,
+                        bool isScreenSpace)
+{
+   // This must cover every register read by compileVertexShader
+   auto sq_config = readRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   auto spi_vs_out_config = readRegister<uint32_t>(registers, latte::Register::SPI_VS_OUT_CONFIG);
+   auto key = glsl2::ShaderCacheKeyBuilder { };
+
+   key.add(glsl2::Shader::VertexShader)
+      .add(fetchHash)
+      .add(vertexHash)
+      .add(isScreenSpace ? 1 : 0)
+      .add(sq_config.DX9_CONSTS() ? 1 : 0)
+      .add(spi_vs_out_config);
+
+   for (auto i = 0u; i < 10; ++i) {
+      key.add(readRegister<uint32_t>(registers, latte::Register::SPI_VS_OUT_ID_0 + 4 * i));
+   }
+
+   for (auto i = 0u; i < latte::MaxSamplers; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = readRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      key.add(static_cast<uint32_t>(sq_tex_resource_word0.DIM()));
+   }
+
+   for (auto i = 0u; i < latte::MaxStreamOutBuffers; ++i) {
+      key.add(readRegister<uint32_t>(registers, latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + 16 * i));
+   }
+
+   for (auto i = 0u; i < 32; ++i) {
+      key.add(readRegister<uint32_t>(registers, latte::Register::SQ_VTX_SEMANTIC_0 + 4 * i));
+   }
+
+   return key.finish();
+}
+
+glsl2::ShaderCacheKey
+getPixelShaderCacheKey(const ShaderRegisters &registers,
+                       const glsl2::ShaderCacheKey &vertexKey,
+                       gsl::span<const uint8_t> pixelHash)
+{
+   // This must cover every register read by compilePixelShader
+   auto sq_config = readRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   auto key = glsl2::ShaderCacheKeyBuilder { };
+
+   key.add(glsl2::Shader::PixelShader)
+      .add(pixelHash)
+      .add(gsl::make_span(reinterpret_cast<const uint8_t *>(vertexKey.data()), sizeof(vertexKey)))
+      .add(sq_config.DX9_CONSTS() ? 1 : 0)
+      .add(readRegister<uint32_t>(registers, latte::Register::SPI_PS_IN_CONTROL_0))
+      .add(readRegister<uint32_t>(registers, latte::Register::SPI_PS_IN_CONTROL_1))
+      .add(readRegister<uint32_t>(registers, latte::Register::CB_SHADER_MASK))
+      .add(readRegister<uint32_t>(registers, latte::Register::DB_SHADER_CONTROL))
+      .add(readRegister<uint32_t>(registers, latte::Register::SX_ALPHA_TEST_CONTROL));
+
+   for (auto i = 0u; i < 32; ++i) {
+      key.add(readRegister<uint32_t>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + 4 * i));
+   }
+
+   for (auto i = 0u; i < latte::MaxSamplers; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = readRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+      key.add(static_cast<uint32_t>(sq_tex_resource_word0.DIM()));
+   }
+
+   return key.finish();
+}
+
+static const char *
+getGLSLDataInFormat(latte::SQ_DATA_FORMAT format, latte::SQ_NUM_FORMAT num, latte::SQ_FORMAT_COMP comp)
+{
+   switch (format) {
+   case latte::SQ_DATA_FORMAT::FMT_2_10_10_10:
+   case latte::SQ_DATA_FORMAT::FMT_10_10_10_2:
+      return "uint";
+   }
+
+   auto channels = getDataFormatComponents(format);
+
+   switch (channels) {
+   case 1:
+      return "uint";
+   case 2:
+      return "uvec2";
+   case 3:
+      return "uvec3";
+   case 4:
+      return "uvec4";
+   default:
+      decaf_abort(fmt::format("Unimplemented attribute channel count: {} for {}", channels, format));
+   }
+}
+
+bool
+compileVertexShader(glsl2::CachedShader &vertex,
+                    const glsl2::ShaderCache &cache,
+                    const std::vector<FetchShaderAttrib> &attribs,
+                    const std::string &fetchDisassembly,
+                    const ShaderRegisters &registers,
+                    gsl::span<const uint8_t> binary,
+                    bool isScreenSpace)
+{
+   auto sq_config = readRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   auto spi_vs_out_config = readRegister<latte::SPI_VS_OUT_CONFIG>(registers, latte::Register::SPI_VS_OUT_CONFIG);
+   std::array<const FetchShaderAttrib *, 32> semanticAttribs;
+   semanticAttribs.fill(nullptr);
+
+   glsl2::Shader shader;
+   shader.type = glsl2::Shader::VertexShader;
+
+   for (auto i = 0; i < latte::MaxSamplers; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = readRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+
+      shader.samplerDim[i] = sq_tex_resource_word0.DIM();
+   }
+
+   if (sq_config.DX9_CONSTS()) {
+      shader.uniformRegistersEnabled = true;
+   } else {
+      shader.uniformBlocksEnabled = true;
+   }
+
+   shader.embedDisassembly = shouldEmbedDisassembly();
+
+   if (shader.embedDisassembly) {
+      vertex.disassembly = latte::disassemble(binary);
+   }
+
+   if (!translateShader(cache, shader, binary)) {
+      gLog->error("Failed to decode vertex shader\n{}", latte::disassemble(binary));
+      return false;
+   }
+
+   vertex.usedUniformBlocks = shader.usedUniformBlocks;
+
+   fmt::MemoryWriter out;
+   out << shader.fileHeader;
+
+   out << "#define bswap16(v) (packUnorm4x8(unpackUnorm4x8(v).yxwz))\n";
+   out << "#define bswap32(v) (packUnorm4x8(unpackUnorm4x8(v).wzyx))\n";
+   out << "#define signext2(v) ((v ^ 0x2) - 0x2)\n";
+   out << "#define signext8(v) ((v ^ 0x80) - 0x80)\n";
+   out << "#define signext10(v) ((v ^ 0x200) - 0x200)\n";
+   out << "#define signext16(v) ((v ^ 0x8000) - 0x8000)\n";
+
+   // Vertex Shader Inputs
+   for (auto &attrib : attribs) {
+      semanticAttribs[attrib.location] = &attrib;
+
+      out << "//";
+      out << " " << getDataFormatName(attrib.format);
+      if (attrib.formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
+         out << " SIGNED";
+      } else {
+         out << " UNSIGNED";
+      }
+      if (attrib.numFormat == latte::SQ_NUM_FORMAT::INT) {
+         out << " INT";
+      } else if (attrib.numFormat == latte::SQ_NUM_FORMAT::NORM) {
+         out << " NORM";
+      } else if (attrib.numFormat == latte::SQ_NUM_FORMAT::SCALED) {
+         out << " SCALED";
+      }
+      if (attrib.endianSwap == latte::SQ_ENDIAN::NONE) {
+         out << " SWAP_NONE";
+      } else if (attrib.endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
+         out << " SWAP_8IN32";
+      } else if (attrib.endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
+         out << " SWAP_8IN16";
+      } else if (attrib.endianSwap == latte::SQ_ENDIAN::AUTO) {
+         out << " SWAP_AUTO";
+      }
+      out << "\n";
+
+      out << "layout(location = " << attrib.location << ")";
+      out << " in "
+          << getGLSLDataInFormat(attrib.format, attrib.numFormat, attrib.formatComp)
+         << " fs_out_" << attrib.location << ";\n";
+   }
+   out << '\n';
+
+   // Vertex Shader Exports
+   vertex.outputMap = getVertexOutputMap(registers);
+
+   for (auto i = 0u; i <= spi_vs_out_config.VS_EXPORT_COUNT(); i++) {
+      auto semanticId = getVertexExportSemantic(registers, i);
+
+      if (semanticId == 0xff) {
+         break;
+      }
+
+      out << "layout(location = " << i << ")";
+      out << " out vec4 vs_out_" << semanticId << ";\n";
+   }
+   out << '\n';
+
+   // Transform feedback outputs
+   for (auto i = 0u; i < latte::MaxStreamOutBuffers; ++i) {
+      vertex.usedFeedbackBuffers[i] = !shader.feedbacks[i].empty();
+
+      if (vertex.usedFeedbackBuffers[i]) {
+         auto vgt_strmout_vtx_stride = readRegister<uint32_t>(registers, latte::Register::VGT_STRMOUT_VTX_STRIDE_0 + 16 * i);
+         auto stride = vgt_strmout_vtx_stride * 4;
+
+         if (NVIDIA_GLSL_WORKAROUND) {
+            out
+               << "layout(xfb_buffer = " << i << ") out;\n"
+               << "layout(xfb_stride = " << stride
+               << ") out feedback_block" << i << " {\n";
+         } else {
+            out
+               << "layout(xfb_buffer = " << i
+               << ", xfb_stride = " << stride
+               << ") out feedback_block" << i << " {\n";
+         }
+
+         for (auto &xfb : shader.feedbacks[i]) {
+            out << "   layout(xfb_offset = " << xfb.offset << ") out ";
+
+            if (xfb.size == 1) {
+               out << "float";
+            } else {
+               out << "vec" << xfb.size;
+            }
+
+            out << " feedback_" << xfb.streamIndex << "_" << xfb.offset << ";\n";
+         }
+
+         out << "};\n";
+      }
+   }
+   out << '\n';
+
+   vertex.isScreenSpace = isScreenSpace;
+
+   if (isScreenSpace) {
+      out << "uniform vec4 uViewport;\n";
+   }
+
+   out
+      << "void main()\n"
+      << "{\n"
+      << shader.codeHeader;
+
+   // Assign fetch shader output to our GPR
+   for (auto i = 0u; i < 32; ++i) {
+      auto sq_vtx_semantic = readRegister<latte::SQ_VTX_SEMANTIC_N>(registers, latte::Register::SQ_VTX_SEMANTIC_0 + i * 4);
+      auto id = sq_vtx_semantic.SEMANTIC_ID();
+
+      if (id == 0xff) {
+         continue;
+      }
+
+      auto attrib = semanticAttribs[id];
+
+      if (!attrib) {
+         gLog->error("Invalid semantic mapping: {}", id);
+         continue;
+      }
+
+
+      fmt::MemoryWriter nameWriter;
+      nameWriter << "fs_out_" << attrib->location;
+      auto name = nameWriter.str();
+      auto channels = getDataFormatComponents(attrib->format);
+      auto isFloat = getDataFormatIsFloat(attrib->format);
+
+      std::string chanVal[4];
+      uint32_t chanBitCount[4];
+
+      if (attrib->format == latte::SQ_DATA_FORMAT::FMT_10_10_10_2 || attrib->format == latte::SQ_DATA_FORMAT::FMT_2_10_10_10) {
+         decaf_check(channels == 4);
+
+         auto val = name;
+
+         if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
+            val = "bswap32(" + val + ")";
+         } else if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
+            decaf_abort("Unexpected 8IN16 swap for 10_10_10_2");
+         } else if (attrib->endianSwap == latte::SQ_ENDIAN::NONE) {
+            // Nothing to do
+         } else {
+            decaf_abort("Unexpected endian swap mode");
+         }
+
+         if (attrib->format == latte::SQ_DATA_FORMAT::FMT_10_10_10_2) {
+            chanVal[0] = std::string("((") + val + std::string(" >> 22) & 0x3ff)");
+            chanVal[1] = std::string("((") + val + std::string(" >> 12) & 0x3ff)");
+            chanVal[2] = std::string("((") + val + std::string(" >> 2) & 0x3ff)");
+            chanVal[3] = std::string("((") + val + std::string(" >> 0) & 0x3)");
+         } else if (attrib->format == latte::SQ_DATA_FORMAT::FMT_2_10_10_10) {
+            chanVal[3] = std::string("((") + val + std::string(" >> 30) & 0x3)");
+            chanVal[2] = std::string("((") + val + std::string(" >> 20) & 0x3ff)");
+            chanVal[1] = std::string("((") + val + std::string(" >> 10) & 0x3ff)");
+            chanVal[0] = std::string("((") + val + std::string(" >> 0) & 0x3ff)");
+         } else {
+            decaf_abort("Unexpected format");
+         }
+
+         if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
+            chanVal[0] = "int(signext10(" + chanVal[0] + "))";
+            chanVal[1] = "int(signext10(" + chanVal[1] + "))";
+            chanVal[2] = "int(signext10(" + chanVal[2] + "))";
+            chanVal[3] = "int(" + chanVal[3] + ")";
+         } else {
+            // Good to go!
+         }
+
+         chanBitCount[0] = 10;
+         chanBitCount[1] = 10;
+         chanBitCount[2] = 10;
+         chanBitCount[3] = 2;
+      } else {
+         static const char * ChannelSelNorm[] = { "x" ,"y", "z", "w" };
+
+         auto compBits = getDataFormatComponentBits(attrib->format);
+
+         for (auto ch = 0u; ch < channels; ++ch) {
+            auto &val = chanVal[ch];
+            val = name;
+
+            if (attrib->endianSwap == latte::SQ_ENDIAN::NONE) {
+               // Nothing to do except select the appropriate component.
+
+               if (channels > 1) {
+                  val = val + "." + ChannelSelNorm[ch];
+               }
+            } else {
+               if (compBits == 32) {
+                  if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
+                     if (channels > 1) {
+                        val = val + "." + ChannelSelNorm[ch];
+                     }
+
+                     val = "bswap32(" + val + ")";
+                  } else {
+                     decaf_abort("Unexpected endian swap mode for 32-bit components");
+                  }
+               } else if (compBits == 16) {
+                  if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
+                     if (channels > 1) {
+                        val = val + "." + ChannelSelNorm[ch];
+                     }
+
+                     val = "bswap16(" + val + ")";
+                  } else {
+                     decaf_abort("Unexpected endian swap mode for 16-bit components");
+                  }
+               } else if (compBits == 8) {
+                  static const char * ChannelSel8In16[] = { "y", "x", "w", "z" };
+                  static const char * ChannelSel8In32[] = { "w", "z", "y", "x" };
+
+                  if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN16) {
+                     decaf_check(channels == 2 || channels == 4);
+                     val = val + "." + ChannelSel8In16[ch];
+                  } else if (attrib->endianSwap == latte::SQ_ENDIAN::SWAP_8IN32) {
+                     decaf_check(channels == 4);
+                     val = val + "." + ChannelSel8In32[ch];
+                  } else {
+                     decaf_abort("Unexpected endian swap mode for 8-bit components");
+                  }
+               } else {
+                  decaf_abort("Unexpected component bit count with swapping");
+               }
+            }
+
+            if (isFloat) {
+               if (compBits == 32) {
+                  val = "uintBitsToFloat(" + val + ")";
+               } else if (compBits == 16) {
+                  val = "unpackHalf2x16(" + val + ").x";
+               } else {
+                  decaf_abort("Unexpected float component bit count");
+               }
+            } else {
+               if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
+                  if (compBits == 8) {
+                     val = "int(signext8(" + val + "))";
+                  } else if (compBits == 16) {
+                     val = "int(signext16(" + val + "))";
+                  } else if (compBits == 32) {
+                     val = "int(" + val + ")";
+                  } else {
+                     decaf_abort("Unexpected signed component bit count");
+                  }
+               } else {
+                  // Already the right format!
+               }
+            }
+
+            chanBitCount[ch] = compBits;
+         }
+      }
+
+      for (auto ch = 0u; ch < channels; ++ch) {
+         if (attrib->numFormat == latte::SQ_NUM_FORMAT::NORM) {
+            uint32_t valMax = (1ul << chanBitCount[ch]) - 1;
+
+            if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
+               chanVal[ch] = fmt::format("clamp(float({}) / {}.0, -1.0, 1.0)", chanVal[ch], valMax / 2);
+            } else {
+               chanVal[ch] = fmt::format("float({}) / {}.0", chanVal[ch], valMax);
+            }
+         } else if (attrib->numFormat == latte::SQ_NUM_FORMAT::INT) {
+            if (attrib->formatComp == latte::SQ_FORMAT_COMP::SIGNED) {
+               chanVal[ch] = "intBitsToFloat(int(" + chanVal[ch] + "))";
+            } else {
+               chanVal[ch] = "uintBitsToFloat(uint(" + chanVal[ch] + "))";
+            }
+         } else if (attrib->numFormat == latte::SQ_NUM_FORMAT::SCALED) {
+            chanVal[ch] = "float(" + chanVal[ch] + ")";
+         } else {
+            decaf_abort("Unexpected attribute number format");
+         }
+      }
+
+      if (channels == 1) {
+         out << "float _" << name << " = " << chanVal[0] << ";\n";
+      } else if (channels == 2) {
+         out << "vec2 _" << name << " = vec2(\n";
+         out << "   " << chanVal[0] << ",\n";
+         out << "   " << chanVal[1] << ");\n";
+      } else if (channels == 3) {
+         out << "vec3 _" << name << " = vec3(\n";
+         out << "   " << chanVal[0] << ",\n";
+         out << "   " << chanVal[1] << ",\n";
+         out << "   " << chanVal[2] << ");\n";
+      } else if (channels == 4) {
+         out << "vec4 _" << name << " = vec4(\n";
+         out << "   " << chanVal[0] << ",\n";
+         out << "   " << chanVal[1] << ",\n";
+         out << "   " << chanVal[2] << ",\n";
+         out << "   " << chanVal[3] << ");\n";
+      } else {
+         decaf_abort("Unexpected format channel count");
+      }
+      name = "_" + name;
+
+      // Write the register assignment
+      out << "R[" << (i + 1) << "] = ";
+
+      switch (channels) {
+      case 1:
+         out << "vec4(" << name << ", 0.0, 0.0, 1.0);\n";
+         break;
+      case 2:
+         out << "vec4(" << name << ", 0.0, 1.0);\n";
+         break;
+      case 3:
+         out << "vec4(" << name << ", 1.0);\n";
+         break;
+      case 4:
+         out << name << ";\n";
+         break;
+      }
+   }
+
+   out << '\n' << shader.codeBody << '\n';
+
+   for (auto &exp : shader.exports) {
+      switch (exp.type) {
+      case latte::SQ_EXPORT_TYPE::POS:
+         if (!isScreenSpace) {
+            out << "gl_Position = exp_position_" << exp.id << ";\n";
+         } else {
+            out << "gl_Position = (exp_position_" << exp.id << " - vec4(uViewport.xy, 0.0, 0.0)) * vec4(uViewport.zw, 1.0, 1.0);\n";
+         }
+         break;
+      case latte::SQ_EXPORT_TYPE::PARAM: {
+         decaf_check(!spi_vs_out_config.VS_PER_COMPONENT());
+         auto semanticId = getVertexExportSemantic(registers, exp.id);
+
+         if (semanticId != 0xff) {
+            out << "vs_out_" << semanticId << " = exp_param_" << exp.id << ";\n";
+         } else {
+            // This just helps when debugging to understand why it is missing...
+            out << "// vs_out_none = exp_param_" << exp.id << ";\n";
+         }
+      } break;
+      case latte::SQ_EXPORT_TYPE::PIXEL:
+         decaf_abort("Unexpected pixel export in vertex shader.");
+      }
+   }
+
+   out << "}\n";
+
+   if (shader.embedDisassembly) {
+      out << "/* VERTEX SHADER DISASSEMBLY\n" << vertex.disassembly << "\n*/\n";
+      out << "/* FETCH SHADER DISASSEMBLY\n" << fetchDisassembly << "\n*/\n";
+   }
+
+   vertex.code = out.str();
+   return true;
+}
+
+bool
+compilePixelShader(glsl2::CachedShader &pixel,
+                   const glsl2::ShaderCache &cache,
+                   const std::array<uint8_t, 256> &vertexOutputMap,
+                   const ShaderRegisters &registers,
+                   gsl::span<const uint8_t> binary)
+{
+   auto sq_config = readRegister<latte::SQ_CONFIG>(registers, latte::Register::SQ_CONFIG);
+   auto spi_ps_in_control_0 = readRegister<latte::SPI_PS_IN_CONTROL_0>(registers, latte::Register::SPI_PS_IN_CONTROL_0);
+   auto spi_ps_in_control_1 = readRegister<latte::SPI_PS_IN_CONTROL_1>(registers, latte::Register::SPI_PS_IN_CONTROL_1);
+   auto cb_shader_mask = readRegister<latte::CB_SHADER_MASK>(registers, latte::Register::CB_SHADER_MASK);
+   auto db_shader_control = readRegister<latte::DB_SHADER_CONTROL>(registers, latte::Register::DB_SHADER_CONTROL);
+   auto sx_alpha_test_control = readRegister<latte::SX_ALPHA_TEST_CONTROL>(registers, latte::Register::SX_ALPHA_TEST_CONTROL);
+
+   decaf_assert(!db_shader_control.STENCIL_REF_EXPORT_ENABLE(), "Stencil exports not implemented");
+
+   glsl2::Shader shader;
+   shader.type = glsl2::Shader::PixelShader;
+
+   // Gather Samplers
+   for (auto i = 0; i < latte::MaxSamplers; ++i) {
+      auto resourceOffset = (latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0 + i) * 7;
+      auto sq_tex_resource_word0 = readRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(registers, latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset);
+
+      shader.samplerDim[i] = sq_tex_resource_word0.DIM();
+   }
+
+   if (sq_config.DX9_CONSTS()) {
+      shader.uniformRegistersEnabled = true;
+   } else {
+      shader.uniformBlocksEnabled = true;
+   }
+
+   shader.embedDisassembly = shouldEmbedDisassembly();
+
+   if (shader.embedDisassembly) {
+      pixel.disassembly = latte::disassemble(binary);
+   }
+
+   if (!translateShader(cache, shader, binary)) {
+      gLog->error("Failed to decode pixel shader\n{}", latte::disassemble(binary));
+      return false;
+   }
+
+   pixel.samplerUsage = shader.samplerUsage;
+   pixel.usedUniformBlocks = shader.usedUniformBlocks;
+
+   fmt::MemoryWriter out;
+   out << shader.fileHeader;
+   out << "uniform float uAlphaRef;\n";
+
+   auto z_order = db_shader_control.Z_ORDER();
+   auto early_z = (z_order == latte::DB_Z_ORDER::EARLY_Z_THEN_LATE_Z || z_order == latte::DB_Z_ORDER::EARLY_Z_THEN_RE_Z);
+   if (early_z) {
+      if (sx_alpha_test_control.ALPHA_TEST_ENABLE() && !sx_alpha_test_control.ALPHA_TEST_BYPASS()) {
+         gLog->debug("Ignoring early-Z because alpha test is enabled");
+         early_z = false;
+      } else if (db_shader_control.KILL_ENABLE()) {
+         gLog->debug("Ignoring early-Z because shader discard is enabled");
+         early_z = false;
+      } else {
+         decaf_assert(!shader.usesDiscard, "Shader uses discard but KILL_ENABLE is not set");
+         for (auto &exp : shader.exports) {
+            if (exp.type == latte::SQ_EXPORT_TYPE::PIXEL && exp.id == 61) {
+               gLog->debug("Ignoring early-Z because shader writes gl_FragDepth");
+               early_z = false;
+               break;
+            }
+         }
+      }
+      if (early_z) {
+         out << "layout(early_fragment_tests) in;\n";
+      }
+   }
+
+   if (spi_ps_in_control_0.POSITION_ENA()) {
+      if (!spi_ps_in_control_0.POSITION_CENTROID()) {
+         out << "layout(pixel_center_integer) ";
+      }
+      out << "in vec4 gl_FragCoord;\n";
+   }
+
+   // Pixel Shader Inputs
+   std::array<bool, 256> semanticUsed = { false };
+   for (auto i = 0u; i < spi_ps_in_control_0.NUM_INTERP(); ++i) {
+      auto spi_ps_input_cntl = readRegister<latte::SPI_PS_INPUT_CNTL_N>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
+      auto semanticId = spi_ps_input_cntl.SEMANTIC();
+      decaf_check(semanticId != 0xff);
+
+      auto vsOutputLoc = vertexOutputMap[semanticId];
+      if (semanticId == 0xff) {
+         // Missing semantic means we need to apply the default values instead...
+         continue;
+      }
+
+      if (semanticUsed[semanticId]) {
+         continue;
+      } else {
+         semanticUsed[semanticId] = true;
+      }
+
+      out << "layout(location = " << vsOutputLoc << ")";
+
+      if (spi_ps_input_cntl.FLAT_SHADE()) {
+         out << " flat";
+      }
+
+      out << " in vec4 vs_out_" << semanticId << ";\n";
+   }
+   out << '\n';
+
+   // Pixel Shader Exports
+   auto maskBits = cb_shader_mask.value;
+
+   for (auto i = 0; i < 8; ++i) {
+      if (maskBits & 0xf) {
+         out << "out vec4 ps_out_" << i << ";\n";
+      }
+
+      maskBits >>= 4;
+   }
+   out << '\n';
+
+   out
+      << "void main()\n"
+      << "{\n"
+      << shader.codeHeader;
+
+   // Assign vertex shader output to our GPR
+   for (auto i = 0u; i < spi_ps_in_control_0.NUM_INTERP(); ++i) {
+      auto spi_ps_input_cntl = readRegister<latte::SPI_PS_INPUT_CNTL_N>(registers, latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
+      uint8_t semanticId = spi_ps_input_cntl.SEMANTIC();
+      decaf_check(semanticId != 0xff);
+
+      auto vsOutputLoc = vertexOutputMap[semanticId];
+      out << "R[" << i << "] = ";
+
+      if (vsOutputLoc != 0xff) {
+          out << "vs_out_" << semanticId;
+      } else {
+         if (spi_ps_input_cntl.DEFAULT_VAL() == 0) {
+            out << "vec4(0, 0, 0, 0)";
+         } else if (spi_ps_input_cntl.DEFAULT_VAL() == 1) {
+            out << "vec4(0, 0, 0, 1)";
+         } else if (spi_ps_input_cntl.DEFAULT_VAL() == 2) {
+            out << "vec4(1, 1, 1, 0)";
+         } else if (spi_ps_input_cntl.DEFAULT_VAL() == 3) {
+            out << "vec4(1, 1, 1, 1)";
+         } else {
+            decaf_abort("Invalid PS input DEFAULT_VAL");
+         }
+      }
+
+      out << ";\n";
+   }
+
+   if (spi_ps_in_control_0.POSITION_ENA()) {
+      out << "R[" << spi_ps_in_control_0.POSITION_ADDR() << "] = gl_FragCoord;";
+   }
+
+   decaf_assert(!spi_ps_in_control_0.PARAM_GEN(),
+                fmt::format("Unsupported spi_ps_in_control_0.PARAM_GEN {}, PARAM_GEN_ADDR {}",
+                            spi_ps_in_control_0.PARAM_GEN(),
+                            spi_ps_in_control_0.PARAM_GEN_ADDR()));
+   decaf_check(!spi_ps_in_control_1.GEN_INDEX_PIX());
+   decaf_check(!spi_ps_in_control_1.FIXED_PT_POSITION_ENA());
+
+   out << '\n' << shader.codeBody << '\n';
+
+   for (auto &exp : shader.exports) {
+      switch (exp.type) {
+      case latte::SQ_EXPORT_TYPE::PIXEL:
+         if (exp.id == 61) {
+            if (!db_shader_control.Z_EXPORT_ENABLE()) {
+               gLog->warn("Depth export is masked by db_shader_control");
+            } else {
+               out << "gl_FragDepth = exp_pixel_" << exp.id << ".x;\n";
+            }
+         } else {
+            auto mask = (cb_shader_mask.value >> (4 * exp.id)) & 0x0F;
+
+            if (!mask) {
+               gLog->warn("Export is masked by cb_shader_mask");
+            } else {
+               std::string strMask;
+
+               if (mask & (1 << 0)) {
+                  strMask.push_back('x');
+               }
+
+               if (mask & (1 << 1)) {
+                  strMask.push_back('y');
+               }
+
+               if (mask & (1 << 2)) {
+                  strMask.push_back('z');
+               }
+
+               if (mask & (1 << 3)) {
+                  strMask.push_back('w');
+               }
+
+               if (sx_alpha_test_control.ALPHA_TEST_ENABLE() && !sx_alpha_test_control.ALPHA_TEST_BYPASS()) {
+                  out << "// Alpha Test ";
+
+                  switch (sx_alpha_test_control.ALPHA_FUNC()) {
+                  case latte::REF_FUNC::NEVER:
+                     out << "REF_NEVER\n";
+                     out << "discard;\n";
+                     break;
+                  case latte::REF_FUNC::LESS:
+                     out << "REF_LESS\n";
+                     out << "if (!(exp_pixel_" << exp.id << ".w < uAlphaRef)) {\n";
+                     out << "   discard;\n}\n";
+                     break;
+                  case latte::REF_FUNC::EQUAL:
+                     out << "REF_EQUAL\n";
+                     out << "if (!(exp_pixel_" << exp.id << ".w == uAlphaRef)) {\n";
+                     out << "   discard;\n}\n";
+                     break;
+                  case latte::REF_FUNC::LESS_EQUAL:
+                     out << "REF_LESS_EQUAL\n";
+                     out << "if (!(exp_pixel_" << exp.id << ".w <= uAlphaRef)) {\n";
+                     out << "   discard;\n}\n";
+                     break;
+                  case latte::REF_FUNC::GREATER:
+                     out << "REF_GREATER\n";
+                     out << "if (!(exp_pixel_" << exp.id << ".w > uAlphaRef)) {\n";
+                     out << "   discard;\n}\n";
+                     break;
+                  case latte::REF_FUNC::NOT_EQUAL:
+                     out << "REF_NOT_EQUAL\n";
+                     out << "if (!(exp_pixel_" << exp.id << ".w != uAlphaRef)) {\n";
+                     out << "   discard;\n}\n";
+                     break;
+                  case latte::REF_FUNC::GREATER_EQUAL:
+                     out << "REF_GREATER_EQUAL\n";
+                     out << "if (!(exp_pixel_" << exp.id << ".w >= uAlphaRef)) {\n";
+                     out << "   discard;\n}\n";
+                     break;
+                  case latte::REF_FUNC::ALWAYS:
+                     out << "REF_ALWAYS\n";
+                     break;
+                  }
+               }
+
+               out
+                  << "ps_out_" << exp.id << "." << strMask
+                  << " = exp_pixel_" << exp.id << "." << strMask;
+
+               out << ";\n";
+            }
+         }
+         break;
+      case latte::SQ_EXPORT_TYPE::POS:
+         decaf_abort("Unexpected position export in pixel shader.");
+         break;
+      case latte::SQ_EXPORT_TYPE::PARAM:
+         decaf_abort("Unexpected parameter export in pixel shader.");
+         break;
+      }
+   }
+
+   out << "}\n";
+
+   if (shader.embedDisassembly) {
+      out << "/* PIXEL SHADER DISASSEMBLY\n" << pixel.disassembly << "\n*/\n";
+   }
+
+   pixel.code = out.str();
+   return true;
+}
+
+} // namespace opengl
+
+} // namespace gpu
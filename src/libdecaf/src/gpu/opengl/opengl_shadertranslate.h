@@ -0,0 +1,73 @@
+#pragma once
+#include "gpu/glsl2/glsl2_cache.h"
+#include "gpu/latte_registers.h"
+
+#include <array>
+#include <cstdint>
+#include <gsl.h>
+#include <string>
+#include <vector>
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+//! A snapshot of the register file, translation only reads registers from
+//  one of these so it needs neither the driver nor a GL context.
+using ShaderRegisters = std::array<uint32_t, 0x10000>;
+
+struct FetchShaderAttrib
+{
+   uint32_t buffer;
+   uint32_t offset;
+   uint32_t location;
+   uint32_t bytesPerElement;
+   latte::SQ_SEL srcSelX;
+   latte::SQ_VTX_FETCH_TYPE type;
+   latte::SQ_DATA_FORMAT format;
+   latte::SQ_SEL dstSel[4];
+   latte::SQ_NUM_FORMAT numFormat;
+   latte::SQ_ENDIAN endianSwap;
+   latte::SQ_FORMAT_COMP formatComp;
+};
+
+//! Vertex shader output location of each semantic, 0xff if it is not output
+std::array<uint8_t, 256>
+getVertexOutputMap(const ShaderRegisters &registers);
+
+//! Key for a vertex shader translated with compileVertexShader, fetchHash
+//  and vertexHash are hashes of the shader binaries.
+glsl2::ShaderCacheKey
+getVertexShaderCacheKey(const ShaderRegisters &registers,
+                        gsl::span<const uint8_t> fetchHash,
+                        gsl::span<const uint8_t> vertexHash,
+                        bool isScreenSpace);
+
+//! Key for a pixel shader translated with compilePixelShader, this covers
+//  the vertex shader output map through vertexKey.
+glsl2::ShaderCacheKey
+getPixelShaderCacheKey(const ShaderRegisters &registers,
+                       const glsl2::ShaderCacheKey &vertexKey,
+                       gsl::span<const uint8_t> pixelHash);
+
+bool
+compileVertexShader(glsl2::CachedShader &vertex,
+                    const glsl2::ShaderCache &cache,
+                    const std::vector<FetchShaderAttrib> &attribs,
+                    const std::string &fetchDisassembly,
+                    const ShaderRegisters &registers,
+                    gsl::span<const uint8_t> binary,
+                    bool isScreenSpace);
+
+bool
+compilePixelShader(glsl2::CachedShader &pixel,
+                   const glsl2::ShaderCache &cache,
+                   const std::array<uint8_t, 256> &vertexOutputMap,
+                   const ShaderRegisters &registers,
+                   gsl::span<const uint8_t> binary);
+
+} // namespace opengl
+
+} // namespace gpu
@@ -0,0 +1,92 @@
+#ifndef DECAF_NOGL
+
+#include "decaf_config.h"
+#include "opengl_streambuffer.h"
+
+#include <algorithm>
+#include <common/align.h>
+#include <common/decaf_assert.h>
+#include <glbinding/gl/gl.h>
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+void
+StreamBuffer::create(uint32_t size,
+                     const char *label)
+{
+   destroy();
+
+   auto usage = gl::BufferStorageMask::GL_NONE_BIT;
+   usage |= gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+
+   gl::glCreateBuffers(1, &mObject);
+   gl::glNamedBufferStorage(mObject, size, nullptr, usage);
+
+   if (decaf::config::gpu::debug) {
+      gl::glObjectLabel(gl::GL_BUFFER, mObject, -1, label);
+   }
+
+   auto access = gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+   mMappedBuffer = static_cast<uint8_t *>(gl::glMapNamedBufferRange(mObject, 0, size, access));
+   decaf_check(mMappedBuffer);
+
+   mSize = size;
+   mHead = 0;
+   mTail = 0;
+}
+
+void
+StreamBuffer::destroy()
+{
+   if (mObject) {
+      gl::glUnmapNamedBuffer(mObject);
+      gl::glDeleteBuffers(1, &mObject);
+   }
+
+   mObject = 0;
+   mMappedBuffer = nullptr;
+   mSize = 0;
+   mHead = 0;
+   mTail = 0;
+}
+
+uint8_t *
+StreamBuffer::allocate(uint32_t size,
+                       uint32_t alignment,
+                       uint32_t &offset)
+{
+   decaf_check(size <= mSize);
+
+   auto start = align_up(mHead, alignment);
+   auto wrapped = static_cast<uint32_t>(start % mSize);
+
+   // Allocations never straddle the end of the buffer, skip to the start
+   if (wrapped + size > mSize) {
+      start += mSize - wrapped;
+      wrapped = 0;
+   }
+
+   if (start + size - mTail > mSize) {
+      return nullptr;
+   }
+
+   mHead = start + size;
+   offset = wrapped;
+   return mMappedBuffer + wrapped;
+}
+
+void
+StreamBuffer::release(uint64_t position)
+{
+   mTail = std::max(mTail, position);
+}
+
+} // namespace opengl
+
+} // namespace gpu
+
+#endif // DECAF_NOGL
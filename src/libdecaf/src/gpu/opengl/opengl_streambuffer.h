@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef DECAF_NOGL
+
+#include <cstdint>
+#include <glbinding/gl/types.h>
+
+namespace gpu
+{
+
+namespace opengl
+{
+
+// A persistently mapped ring buffer for data which is written by the CPU
+//  once and read by the GPU shortly after, so it does not need a buffer
+//  object of its own.  Positions only ever increase, the offset into the
+//  buffer is position % size.  The owner is responsible for fencing the
+//  head and calling release() once the GPU is done with the data before it.
+class StreamBuffer
+{
+public:
+   void
+   create(uint32_t size,
+          const char *label);
+
+   void
+   destroy();
+
+   // Returns nullptr if there is not enough space which the GPU has
+   //  finished reading from, the caller must wait for a fence and retry.
+   uint8_t *
+   allocate(uint32_t size,
+            uint32_t alignment,
+            uint32_t &offset);
+
+   void
+   release(uint64_t position);
+
+   // True if data allocated before position is far enough behind the head
+   //  to be safe to keep using, as long as no single allocation is larger
+   //  than an eighth of the buffer.
+   bool
+   isRecent(uint64_t position) const
+   {
+      return mHead - position <= mSize / 2;
+   }
+
+   gl::GLuint
+   getObject() const
+   {
+      return mObject;
+   }
+
+   uint64_t
+   getHead() const
+   {
+      return mHead;
+   }
+
+   uint32_t
+   getSize() const
+   {
+      return mSize;
+   }
+
+private:
+   gl::GLuint mObject = 0;
+   uint8_t *mMappedBuffer = nullptr;
+   uint32_t mSize = 0;
+   uint64_t mHead = 0;
+   uint64_t mTail = 0;
+};
+
+} // namespace opengl
+
+} // namespace gpu
+
+#endif // DECAF_NOGL
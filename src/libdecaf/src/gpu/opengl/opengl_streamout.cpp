@@ -150,6 +150,11 @@ GLDriver::streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data)
 {
    auto bufferIndex = data.control.SELECT_BUFFER();
 
+   // The output buffer may be recreated, and with it any attribute or
+   //  uniform binding which reads from it.
+   flushDrawBatch();
+   mDirtyDrawState |= DrawState::AttribBuffers | DrawState::Uniforms;
+
    if (data.control.STORE_BUFFER_FILLED_SIZE()) {
       auto addr = data.dstLo;
       decaf_assert(data.dstHi == 0, fmt::format("Store target out of 32-bit range for feedback buffer {}", bufferIndex));
@@ -9,6 +9,8 @@
 #include "modules/gx2/gx2_surface.h"
 #include "opengl_driver.h"
 
+#include <common/align.h>
+#include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <common/murmur3.h>
 #include <libcpu/mem.h>
@@ -387,6 +389,94 @@ getGlTarget(latte::SQ_TEX_DIM dim)
    }
 }
 
+// Returns the texel size of the view compatibility class storageFormat is in,
+//  or 0 if it can not be used with glTextureView other than as itself.
+static uint32_t
+getViewClassBits(gl::GLenum storageFormat)
+{
+   switch (storageFormat) {
+   case gl::GL_RGBA32F:
+   case gl::GL_RGBA32UI:
+   case gl::GL_RGBA32I:
+      return 128;
+   case gl::GL_RGB32F:
+   case gl::GL_RGB32UI:
+   case gl::GL_RGB32I:
+      return 96;
+   case gl::GL_RGBA16F:
+   case gl::GL_RG32F:
+   case gl::GL_RGBA16UI:
+   case gl::GL_RG32UI:
+   case gl::GL_RGBA16I:
+   case gl::GL_RG32I:
+   case gl::GL_RGBA16:
+   case gl::GL_RGBA16_SNORM:
+      return 64;
+   case gl::GL_RGB16:
+   case gl::GL_RGB16_SNORM:
+   case gl::GL_RGB16F:
+   case gl::GL_RGB16UI:
+   case gl::GL_RGB16I:
+      return 48;
+   case gl::GL_RG16F:
+   case gl::GL_R11F_G11F_B10F:
+   case gl::GL_R32F:
+   case gl::GL_RGB10_A2UI:
+   case gl::GL_RGBA8UI:
+   case gl::GL_RG16UI:
+   case gl::GL_R32UI:
+   case gl::GL_RGBA8I:
+   case gl::GL_RG16I:
+   case gl::GL_R32I:
+   case gl::GL_RGB10_A2:
+   case gl::GL_RGBA8:
+   case gl::GL_RG16:
+   case gl::GL_RGBA8_SNORM:
+   case gl::GL_RG16_SNORM:
+   case gl::GL_SRGB8_ALPHA8:
+      return 32;
+   case gl::GL_RGB8:
+   case gl::GL_RGB8_SNORM:
+   case gl::GL_SRGB8:
+   case gl::GL_RGB8UI:
+   case gl::GL_RGB8I:
+      return 24;
+   case gl::GL_R16F:
+   case gl::GL_RG8UI:
+   case gl::GL_R16UI:
+   case gl::GL_RG8I:
+   case gl::GL_R16I:
+   case gl::GL_RG8:
+   case gl::GL_R16:
+   case gl::GL_RG8_SNORM:
+   case gl::GL_R16_SNORM:
+      return 16;
+   case gl::GL_R8UI:
+   case gl::GL_R8I:
+   case gl::GL_R8:
+   case gl::GL_R8_SNORM:
+      return 8;
+   default:
+      return 0;
+   }
+}
+
+// The number of levels in a full mip chain
+static uint32_t
+getMaxSurfaceLevels(uint32_t width,
+                    uint32_t height,
+                    uint32_t depth,
+                    latte::SQ_TEX_DIM dim)
+{
+   auto maxSize = std::max(width, height);
+
+   if (dim == latte::SQ_TEX_DIM::DIM_3D) {
+      maxSize = std::max(maxSize, depth);
+   }
+
+   return 32 - clz(maxSize);
+}
+
 static HostSurface*
 createHostSurface(ppcaddr_t baseAddress,
                   uint32_t pitch,
@@ -399,7 +489,8 @@ createHostSurface(ppcaddr_t baseAddress,
                   latte::SQ_NUM_FORMAT numFormat,
                   latte::SQ_FORMAT_COMP formatComp,
                   uint32_t degamma,
-                  bool isDepthBuffer)
+                  bool isDepthBuffer,
+                  uint32_t levels)
 {
    auto newSurface = new HostSurface();
 
@@ -409,6 +500,9 @@ createHostSurface(ppcaddr_t baseAddress,
       decaf_abort(fmt::format("Surface with unsupported format {} {} {} {}", format, numFormat, formatComp, degamma));
    }
 
+   // GL refuses storage with more levels than a full chain has
+   levels = std::min(std::max(levels, 1u), getMaxSurfaceLevels(width, height, depth, dim));
+
    auto target = getGlTarget(dim);
    gl::glCreateTextures(target, 1, &newSurface->object);
 
@@ -419,26 +513,27 @@ createHostSurface(ppcaddr_t baseAddress,
 
    switch (dim) {
    case latte::SQ_TEX_DIM::DIM_1D:
-      gl::glTextureStorage1D(newSurface->object, 1, storageFormat, width);
+      gl::glTextureStorage1D(newSurface->object, levels, storageFormat, width);
       break;
    case latte::SQ_TEX_DIM::DIM_2D:
-      gl::glTextureStorage2D(newSurface->object, 1, storageFormat, width, height);
+      gl::glTextureStorage2D(newSurface->object, levels, storageFormat, width, height);
       break;
    case latte::SQ_TEX_DIM::DIM_2D_MSAA:
       // TODO: Figure out if last parameter should be GL_TRUE or GL_FALSE
       gl::glTextureStorage2DMultisample(newSurface->object, samples, storageFormat, width, height, gl::GL_FALSE);
+      levels = 1;
       break;
    case latte::SQ_TEX_DIM::DIM_2D_ARRAY:
-      gl::glTextureStorage3D(newSurface->object, 1, storageFormat, width, height, depth);
+      gl::glTextureStorage3D(newSurface->object, levels, storageFormat, width, height, depth);
       break;
    case latte::SQ_TEX_DIM::DIM_CUBEMAP:
-      gl::glTextureStorage2D(newSurface->object, 1, storageFormat, width, height);
+      gl::glTextureStorage2D(newSurface->object, levels, storageFormat, width, height);
       break;
    case latte::SQ_TEX_DIM::DIM_3D:
-      gl::glTextureStorage3D(newSurface->object, 1, storageFormat, width, height, depth);
+      gl::glTextureStorage3D(newSurface->object, levels, storageFormat, width, height, depth);
       break;
    case latte::SQ_TEX_DIM::DIM_1D_ARRAY:
-      gl::glTextureStorage2D(newSurface->object, 1, storageFormat, width, height);
+      gl::glTextureStorage2D(newSurface->object, levels, storageFormat, width, height);
       break;
    default:
       decaf_abort(fmt::format("Unsupported texture dim: {}", dim));
@@ -447,8 +542,10 @@ createHostSurface(ppcaddr_t baseAddress,
    newSurface->width = width;
    newSurface->height = height;
    newSurface->depth = depth;
+   newSurface->levels = levels;
    newSurface->degamma = degamma;
    newSurface->isDepthBuffer = isDepthBuffer;
+   newSurface->storageFormat = storageFormat;
    newSurface->swizzleR = gl::GL_RED;
    newSurface->swizzleG = gl::GL_GREEN;
    newSurface->swizzleB = gl::GL_BLUE;
@@ -517,9 +614,202 @@ getSurfaceBytes(uint32_t pitch,
    return numPixels * bitsPerPixel / 8;
 }
 
+// The number of bytes of guest memory uploadSurface reads
+static uint32_t
+getUploadImageSize(uint32_t pitch,
+                   uint32_t height,
+                   uint32_t depth,
+                   latte::SQ_TEX_DIM dim,
+                   latte::SQ_DATA_FORMAT format)
+{
+   auto bpp = getDataFormatBitsPerElement(format);
+
+   if (format >= latte::SQ_DATA_FORMAT::FMT_BC1 && format <= latte::SQ_DATA_FORMAT::FMT_BC5) {
+      height = (height + 3) / 4;
+      pitch = pitch / 4;
+   }
+
+   if (dim == latte::SQ_TEX_DIM::DIM_CUBEMAP) {
+      depth *= 6;
+   }
+
+   return pitch * height * depth * bpp / 8;
+}
+
+// Where a mip level past the first is in the mip chain and how it is tiled
+struct MipLevelLayout
+{
+   uint32_t offset;
+   latte::SQ_TILE_MODE tileMode;
+   uint32_t pitch;
+   uint32_t height;
+};
+
+// Lays out the mip chain the same way GX2CalcSurfaceSizeAndAlignment does,
+//  returns the size of the chain with layouts[0] describing level 1.
+static uint32_t
+getMipLevelLayouts(uint32_t width,
+                   uint32_t height,
+                   uint32_t depth,
+                   latte::SQ_TEX_DIM dim,
+                   latte::SQ_DATA_FORMAT format,
+                   bool isDepthBuffer,
+                   latte::SQ_TILE_MODE tileMode,
+                   uint32_t swizzle,
+                   uint32_t levels,
+                   std::vector<MipLevelLayout> &layouts)
+{
+   gx2::GX2Surface surface;
+   surface.dim = static_cast<gx2::GX2SurfaceDim>(dim);
+   surface.width = width;
+   surface.height = height;
+   surface.depth = (dim == latte::SQ_TEX_DIM::DIM_CUBEMAP) ? depth * 6 : depth;
+   surface.mipLevels = levels;
+   surface.format = static_cast<gx2::GX2SurfaceFormat>(format);
+   surface.aa = gx2::GX2AAMode::Mode1X;
+   surface.use = isDepthBuffer ? gx2::GX2SurfaceUse::DepthBuffer : gx2::GX2SurfaceUse::Texture;
+   surface.swizzle = swizzle;
+
+   // The hardware has no LinearSpecial, GX2 writes it as LINEAR_GENERAL
+   if (tileMode == latte::SQ_TILE_MODE::LINEAR_GENERAL) {
+      surface.tileMode = gx2::GX2TileMode::LinearSpecial;
+   } else {
+      surface.tileMode = static_cast<gx2::GX2TileMode>(tileMode);
+   }
+
+   gx2::GX2CalcSurfaceSizeAndAlignment(&surface);
+   layouts.clear();
+
+   for (auto level = 1u; level < surface.mipLevels; ++level) {
+      ADDR_COMPUTE_SURFACE_INFO_OUTPUT output;
+      gx2::internal::getSurfaceInfo(&surface, level, &output);
+
+      auto layout = MipLevelLayout { };
+      layout.offset = (level == 1) ? 0 : surface.mipLevelOffset[level - 1].value();
+      layout.tileMode = static_cast<latte::SQ_TILE_MODE>(output.tileMode);
+      layout.pitch = output.pitch;
+      layout.height = output.height;
+      layouts.push_back(layout);
+   }
+
+   return surface.mipmapSize;
+}
+
+// A mip chain is only tracked along with its image when it follows it, as it
+//  does when both are in one allocation, so that writes to unrelated memory
+//  between the two do not keep invalidating the surface.
+static const auto MAX_MIP_CHAIN_GAP = 0x10000u;
+
+static uint32_t
+getSurfaceMemEnd(ppcaddr_t baseAddress,
+                 ppcaddr_t mipAddress,
+                 uint32_t pitch,
+                 uint32_t width,
+                 uint32_t height,
+                 uint32_t depth,
+                 uint32_t samples,
+                 latte::SQ_TEX_DIM dim,
+                 latte::SQ_DATA_FORMAT format,
+                 bool isDepthBuffer,
+                 latte::SQ_TILE_MODE tileMode,
+                 uint32_t swizzle,
+                 uint32_t levels)
+{
+   auto memEnd = baseAddress + getSurfaceBytes(pitch, height, depth, samples, dim, format);
+
+   if (levels > 1 && mipAddress >= baseAddress && mipAddress <= memEnd + MAX_MIP_CHAIN_GAP) {
+      std::vector<MipLevelLayout> layouts;
+      auto mipChainSize = getMipLevelLayouts(width, height, depth, dim, format, isDepthBuffer, tileMode, swizzle, levels, layouts);
+      memEnd = std::max(memEnd, mipAddress + mipChainSize);
+   }
+
+   return memEnd;
+}
+
+static void
+uploadSurfaceLevel(gl::GLuint object,
+                   latte::SQ_TEX_DIM dim,
+                   uint32_t level,
+                   uint32_t width,
+                   uint32_t height,
+                   uint32_t depth,
+                   bool compressed,
+                   gl::GLenum textureFormat,
+                   gl::GLenum textureDataType,
+                   uint32_t size,
+                   const void *data)
+{
+   switch (dim) {
+   case latte::SQ_TEX_DIM::DIM_1D:
+      if (compressed) {
+         gl::glCompressedTextureSubImage1D(object,
+            level,
+            0, /* xoffset */
+            width,
+            textureDataType,
+            gsl::narrow_cast<gl::GLsizei>(size),
+            data);
+      } else {
+         gl::glTextureSubImage1D(object,
+            level,
+            0, /* xoffset */
+            width,
+            textureFormat,
+            textureDataType,
+            data);
+      }
+      break;
+   case latte::SQ_TEX_DIM::DIM_2D:
+      if (compressed) {
+         gl::glCompressedTextureSubImage2D(object,
+            level,
+            0, 0, /* xoffset, yoffset */
+            width,
+            height,
+            textureDataType,
+            gsl::narrow_cast<gl::GLsizei>(size),
+            data);
+      } else {
+         gl::glTextureSubImage2D(object,
+            level,
+            0, 0, /* xoffset, yoffset */
+            width, height,
+            textureFormat,
+            textureDataType,
+            data);
+      }
+      break;
+   case latte::SQ_TEX_DIM::DIM_CUBEMAP:
+      decaf_check(depth == 6);
+   case latte::SQ_TEX_DIM::DIM_3D:
+   case latte::SQ_TEX_DIM::DIM_2D_ARRAY:
+      if (compressed) {
+         gl::glCompressedTextureSubImage3D(object,
+            level,
+            0, 0, 0, /* xoffset, yoffset, zoffset */
+            width, height, depth,
+            textureDataType,
+            gsl::narrow_cast<gl::GLsizei>(size),
+            data);
+      } else {
+         gl::glTextureSubImage3D(object,
+            level,
+            0, 0, 0, /* xoffset, yoffset, zoffset */
+            width, height, depth,
+            textureFormat,
+            textureDataType,
+            data);
+      }
+      break;
+   default:
+      decaf_abort(fmt::format("Unsupported texture dim: {}", dim));
+   }
+}
+
 void
 GLDriver::uploadSurface(SurfaceBuffer *buffer,
                         ppcaddr_t baseAddress,
+                        ppcaddr_t mipAddress,
                         uint32_t swizzle,
                         uint32_t pitch,
                         uint32_t width,
@@ -532,33 +822,30 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                         latte::SQ_FORMAT_COMP formatComp,
                         uint32_t degamma,
                         bool isDepthBuffer,
-                        latte::SQ_TILE_MODE tileMode)
+                        latte::SQ_TILE_MODE tileMode,
+                        uint32_t levels)
 {
    auto imagePtr = mem::translate(baseAddress);
    auto bpp = getDataFormatBitsPerElement(format);
-   auto srcWidth = width;
-   auto srcHeight = height;
+   auto compressed = getDataFormatIsCompressed(format);
    auto srcPitch = pitch;
-   auto uploadWidth = width;
-   auto uploadHeight = height;
-   auto uploadPitch = width;
    auto uploadDepth = depth;
 
    if (format >= latte::SQ_DATA_FORMAT::FMT_BC1 && format <= latte::SQ_DATA_FORMAT::FMT_BC5) {
-      srcWidth = (srcWidth + 3) / 4;
-      srcHeight = (srcHeight + 3) / 4;
       srcPitch = srcPitch / 4;
-      uploadWidth = srcWidth * 4;
-      uploadHeight = srcHeight * 4;
-      uploadPitch = uploadWidth / 4;
    }
 
    if (dim == latte::SQ_TEX_DIM::DIM_CUBEMAP) {
       uploadDepth *= 6;
    }
 
-   auto srcImageSize = srcPitch * srcHeight * uploadDepth * bpp / 8;
-   auto dstImageSize = srcWidth * srcHeight * uploadDepth * bpp / 8;
+   levels = std::min(levels, buffer->active->levels);
+
+   if (!mipAddress) {
+      levels = 1;
+   }
+
+   auto srcImageSize = getUploadImageSize(pitch, height, depth, dim, format);
 
    // Calculate a new memory CRC
    uint64_t newHash[2] = { 0 };
@@ -568,134 +855,183 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
    //  also means that if the application temporarily uses one of its buffers as
    //  a color buffer, we are able to accurately handle this.  Providing they are
    //  not updating the memory at the same time.
-   if (newHash[0] != buffer->cpuMemHash[0] || newHash[1] != buffer->cpuMemHash[1]) {
-      buffer->cpuMemHash[0] = newHash[0];
-      buffer->cpuMemHash[1] = newHash[1];
-
-      std::vector<uint8_t> untiledImage, untiledMipmap;
-      untiledImage.resize(dstImageSize);
-
-      // Untile
-      gpu::convertFromTiled(
-         untiledImage.data(),
-         uploadPitch,
-         imagePtr,
-         tileMode,
+   auto uploadImage = newHash[0] != buffer->cpuMemHash[0] || newHash[1] != buffer->cpuMemHash[1];
+   auto uploadMips = false;
+
+   std::vector<MipLevelLayout> mipLayouts;
+   auto mipPtr = mem::translate(mipAddress);
+
+   if (levels > 1) {
+      auto mipChainSize = getMipLevelLayouts(width, height, depth, dim, format, isDepthBuffer, tileMode, swizzle, levels, mipLayouts);
+      levels = static_cast<uint32_t>(mipLayouts.size()) + 1;
+
+      // The level count is the seed so asking for more levels uploads them
+      uint64_t newMipHash[2] = { 0 };
+      MurmurHash3_x64_128(mipPtr, mipChainSize, levels, newMipHash);
+
+      if (newMipHash[0] != buffer->mipMemHash[0] || newMipHash[1] != buffer->mipMemHash[1]) {
+         buffer->mipMemHash[0] = newMipHash[0];
+         buffer->mipMemHash[1] = newMipHash[1];
+         uploadMips = true;
+      }
+   }
+
+   if (!uploadImage && !uploadMips) {
+      return;
+   }
+
+   buffer->cpuMemHash[0] = newHash[0];
+   buffer->cpuMemHash[1] = newHash[1];
+   buffer->contentSerial = ++mSurfaceSerial;
+   mSurfaceStats.uploads++;
+
+   // Work out where every level goes in the staging memory
+   struct LevelUpload
+   {
+      uint32_t level;
+      uint8_t *src;
+      latte::SQ_TILE_MODE tileMode;
+      uint32_t srcPitch;
+      uint32_t srcHeight;
+      uint32_t width;
+      uint32_t height;
+      uint32_t depth;
+      uint32_t offset;
+      uint32_t size;
+   };
+
+   std::vector<LevelUpload> uploads;
+   auto stagingSize = 0u;
+
+   for (auto level = uploadImage ? 0u : 1u; level < (uploadMips ? levels : 1u); ++level) {
+      auto upload = LevelUpload { };
+      upload.level = level;
+      upload.width = std::max(1u, width >> level);
+      upload.height = std::max(1u, height >> level);
+      upload.depth = uploadDepth;
+
+      if (dim == latte::SQ_TEX_DIM::DIM_3D) {
+         upload.depth = std::max(1u, depth >> level);
+      }
+
+      if (format >= latte::SQ_DATA_FORMAT::FMT_BC1 && format <= latte::SQ_DATA_FORMAT::FMT_BC5) {
+         upload.width = (upload.width + 3) / 4;
+         upload.height = (upload.height + 3) / 4;
+      }
+
+      if (level == 0) {
+         upload.src = imagePtr;
+         upload.tileMode = tileMode;
+         upload.srcPitch = srcPitch;
+         upload.srcHeight = upload.height;
+      } else {
+         auto &layout = mipLayouts[level - 1];
+         upload.src = mipPtr + layout.offset;
+         upload.tileMode = layout.tileMode;
+         upload.srcPitch = layout.pitch;
+         upload.srcHeight = layout.height;
+      }
+
+      upload.offset = stagingSize;
+      upload.size = upload.width * upload.height * upload.depth * bpp / 8;
+      stagingSize += align_up(upload.size, 16);
+      uploads.push_back(upload);
+   }
+
+   // Large chains which do not fit in the upload buffer go through client memory
+   auto stagingOffset = 0u;
+   auto staging = allocateUploadBuffer(stagingSize, stagingOffset);
+   std::vector<uint8_t> clientStaging;
+
+   if (!staging) {
+      clientStaging.resize(stagingSize);
+      staging = clientStaging.data();
+   }
+
+   // Untile every slice of every level in parallel, addrlib is set up
+   //  here first as the workers would otherwise race to do it.
+   gpu::getAddrLibHandle();
+
+   std::vector<std::pair<uint32_t, uint32_t>> tasks;
+
+   for (auto i = 0u; i < uploads.size(); ++i) {
+      for (auto slice = 0u; slice < uploads[i].depth; ++slice) {
+         tasks.emplace_back(i, slice);
+      }
+   }
+
+   mUntilePool.run(static_cast<uint32_t>(tasks.size()), [&](uint32_t index, uint32_t worker) {
+      auto &upload = uploads[tasks[index].first];
+
+      gpu::convertFromTiledSlice(
+         staging + upload.offset,
+         upload.width,
+         upload.src,
+         upload.tileMode,
          swizzle,
-         srcPitch,
-         srcWidth,
-         srcHeight,
-         uploadDepth,
+         upload.srcPitch,
+         upload.srcHeight,
+         upload.width,
+         upload.height,
+         upload.depth,
+         tasks[index].second,
          0,
          isDepthBuffer,
          bpp
       );
+   });
 
-      // Create texture
-      auto compressed = getDataFormatIsCompressed(format);
-      auto target = getGlTarget(dim);
-      auto textureDataType = gl::GL_INVALID_ENUM;
-      auto textureFormat = getGlFormat(format);
-      auto size = untiledImage.size();
+   // Upload the whole batch
+   auto textureDataType = gl::GL_INVALID_ENUM;
+   auto textureFormat = getGlFormat(format);
 
-      if (compressed) {
-         textureDataType = getGlCompressedDataType(format, formatComp, degamma);
-      } else {
-         textureDataType = getGlDataType(format, formatComp, degamma);
-      }
+   if (compressed) {
+      textureDataType = getGlCompressedDataType(format, formatComp, degamma);
+   } else {
+      textureDataType = getGlDataType(format, formatComp, degamma);
+   }
 
-      if (textureDataType == gl::GL_INVALID_ENUM || textureFormat == gl::GL_INVALID_ENUM) {
-         decaf_abort(fmt::format("Texture with unsupported format {}", format));
-      }
+   if (textureDataType == gl::GL_INVALID_ENUM || textureFormat == gl::GL_INVALID_ENUM) {
+      decaf_abort(fmt::format("Texture with unsupported format {}", format));
+   }
 
-      switch (dim) {
-      case latte::SQ_TEX_DIM::DIM_1D:
-         if (compressed) {
-            gl::glCompressedTextureSubImage1D(buffer->active->object,
-               0, /* level */
-               0, /* xoffset */
-               width,
-               textureDataType,
-               gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
-         } else {
-            gl::glTextureSubImage1D(buffer->active->object,
-               0, /* level */
-               0, /* xoffset */
-               width,
-               textureFormat,
-               textureDataType,
-               untiledImage.data());
-         }
-         break;
-      case latte::SQ_TEX_DIM::DIM_2D:
-         if (compressed) {
-            gl::glCompressedTextureSubImage2D(buffer->active->object,
-               0, /* level */
-               0, 0, /* xoffset, yoffset */
-               width,
-               height,
-               textureDataType,
-               gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
-         } else {
-            gl::glTextureSubImage2D(buffer->active->object,
-               0, /* level */
-               0, 0, /* xoffset, yoffset */
-               width, height,
-               textureFormat,
-               textureDataType,
-               untiledImage.data());
-         }
-         break;
-      case latte::SQ_TEX_DIM::DIM_3D:
-         if (compressed) {
-            gl::glCompressedTextureSubImage3D(buffer->active->object,
-               0, /* level */
-               0, 0, 0, /* xoffset, yoffset, zoffset */
-               width, height, depth,
-               textureDataType,
-               gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
-         } else {
-            gl::glTextureSubImage3D(buffer->active->object,
-               0, /* level */
-               0, 0, 0, /* xoffset, yoffset, zoffset */
-               width, height, depth,
-               textureFormat,
-               textureDataType,
-               untiledImage.data());
-         }
-         break;
-      case latte::SQ_TEX_DIM::DIM_CUBEMAP:
-         decaf_check(uploadDepth == 6);
-      case latte::SQ_TEX_DIM::DIM_2D_ARRAY:
-         if (compressed) {
-            gl::glCompressedTextureSubImage3D(buffer->active->object,
-               0, /* level */
-               0, 0, 0, /* xoffset, yoffset, zoffset */
-               width, height, uploadDepth,
-               textureDataType,
-               gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
-         } else {
-            gl::glTextureSubImage3D(buffer->active->object,
-               0, /* level */
-               0, 0, 0, /* xoffset, yoffset, zoffset */
-               width, height, uploadDepth,
-               textureFormat,
-               textureDataType,
-               untiledImage.data());
-         }
-         break;
-      default:
-         decaf_abort(fmt::format("Unsupported texture dim: {}", dim));
+   if (clientStaging.empty()) {
+      gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, mUploadBuffer.getObject());
+   }
+
+   // Rows of the smaller levels are not 4 byte aligned
+   gl::glPixelStorei(gl::GL_UNPACK_ALIGNMENT, 1);
+
+   for (auto &upload : uploads) {
+      const void *data = staging + upload.offset;
+
+      if (clientStaging.empty()) {
+         data = reinterpret_cast<const void *>(static_cast<uintptr_t>(stagingOffset + upload.offset));
       }
+
+      uploadSurfaceLevel(buffer->active->object,
+                         dim,
+                         upload.level,
+                         std::max(1u, width >> upload.level),
+                         std::max(1u, height >> upload.level),
+                         upload.depth,
+                         compressed,
+                         textureFormat,
+                         textureDataType,
+                         upload.size,
+                         data);
+   }
+
+   gl::glPixelStorei(gl::GL_UNPACK_ALIGNMENT, 4);
+
+   if (clientStaging.empty()) {
+      gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
    }
 }
 
 SurfaceBuffer *
 GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
+                           ppcaddr_t mipAddress,
                            uint32_t pitch,
                            uint32_t width,
                            uint32_t height,
@@ -708,6 +1044,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
                            uint32_t degamma,
                            bool isDepthBuffer,
                            latte::SQ_TILE_MODE tileMode,
+                           uint32_t levels,
                            bool forWrite,
                            bool discardData)
 {
@@ -725,10 +1062,19 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
    // Align the base address according to the GPU logic
    if (tileMode >= latte::SQ_TILE_MODE::TILED_2D_THIN1) {
       baseAddress &= ~(0x800 - 1);
+      mipAddress &= ~(0x800 - 1);
    } else {
       baseAddress &= ~(0x100 - 1);
+      mipAddress &= ~(0x100 - 1);
+   }
+
+   // Multisampled surfaces use the level count for the sample count
+   if (samples || !mipAddress) {
+      levels = 1;
    }
 
+   levels = std::min(levels, getMaxSurfaceLevels(width, height, depth, dim));
+
    // The size key is selected based on which level the dims
    //  are compatible across.  Note that at some point, we may
    //  need to make format not be part of the key as well...
@@ -759,40 +1105,60 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
       buffer.active->width == width &&
       buffer.active->height == height &&
       buffer.active->depth == depth &&
+      buffer.active->levels >= levels &&
       buffer.active->degamma == degamma &&
       buffer.active->isDepthBuffer == isDepthBuffer)
    {
-      if (!forWrite && buffer.needUpload) {
-         uploadSurface(&buffer, baseAddress, swizzle, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode);
-         buffer.needUpload = false;
+      mSurfaceStats.hits++;
+
+      if (!forWrite) {
+         if (buffer.needUpload) {
+            uploadSurface(&buffer, baseAddress, mipAddress, swizzle, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode, levels);
+            buffer.needUpload = false;
+         }
+
+         refreshSurfaceAlias(&buffer);
       }
 
       return &buffer;
    }
 
+   mSurfaceStats.misses++;
+
    if (!buffer.master) {
       // We are the first user of this surface, lets quickly set it up and
       //  allocate a host surface to use
 
       // Let's track some other useful information
-      buffer.dbgInfo.dim = dim;
-      buffer.dbgInfo.format = format;
-      buffer.dbgInfo.numFormat = numFormat;
-      buffer.dbgInfo.formatComp = formatComp;
-      buffer.dbgInfo.degamma = degamma;
+      buffer.info.dim = dim;
+      buffer.info.format = format;
+      buffer.info.numFormat = numFormat;
+      buffer.info.formatComp = formatComp;
+      buffer.info.degamma = degamma;
+      buffer.info.pitch = pitch;
+      buffer.info.swizzle = swizzle;
+      buffer.info.samples = samples;
+      buffer.info.tileMode = tileMode;
 
       // The memory bounds
       buffer.cpuMemStart = baseAddress;
-      buffer.cpuMemEnd = baseAddress + getSurfaceBytes(pitch, height, depth, samples, dim, format);
+      buffer.cpuMemEnd = getSurfaceMemEnd(baseAddress, mipAddress, pitch, width, height, depth, samples, dim, format, isDepthBuffer, tileMode, swizzle, levels);
 
       mResourceMap.addResource(&buffer);
+      mSurfaceRanges.emplace(baseAddress, &buffer);
 
-      auto newSurf = createHostSurface(baseAddress, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer);
+      auto newSurf = createHostSurface(baseAddress, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, levels);
       buffer.active = newSurf;
       buffer.master = newSurf;
 
       if (!forWrite) {
-         uploadSurface(&buffer, baseAddress, swizzle, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode);
+         // A render target in the same memory saves us from uploading data
+         //  which is probably out of date anyway, the rest of a mip chain
+         //  still comes from memory.
+         if (!refreshSurfaceAlias(&buffer) || levels > 1) {
+            uploadSurface(&buffer, baseAddress, mipAddress, swizzle, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode, levels);
+         }
+
          buffer.needUpload = false;
       }
 
@@ -803,12 +1169,17 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
    HostSurface *newMaster = nullptr;
    HostSurface *newSurface = nullptr;
 
+   // The active host surface is about to change, anything bound to the old
+   //  one has to be looked up again.
+   mDirtyDrawState |= DrawState::Textures | DrawState::ColorBuffer | DrawState::DepthBuffer;
+
    if (!foundSurface) {
       // First lets check to see if we already have a surface created
       for (auto surf = buffer.master; surf != nullptr; surf = surf->next) {
          if (surf->width == width &&
             surf->height == height &&
             surf->depth == depth &&
+            surf->levels >= levels &&
             surf->degamma == degamma &&
             surf->isDepthBuffer == isDepthBuffer) {
             foundSurface = surf;
@@ -822,18 +1193,20 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
       auto masterWidth = width;
       auto masterHeight = height;
       auto masterDepth = depth;
+      auto masterLevels = levels;
 
       if (buffer.master) {
          masterWidth = std::max(masterWidth, buffer.master->width);
          masterHeight = std::max(masterHeight, buffer.master->height);
          masterDepth = std::max(masterDepth, buffer.master->depth);
+         masterLevels = std::max(masterLevels, buffer.master->levels);
       }
 
-      if (!buffer.master || buffer.master->width < masterWidth || buffer.master->height < masterHeight || buffer.master->depth < masterDepth) {
-         newMaster = createHostSurface(baseAddress, pitch, masterWidth, masterHeight, masterDepth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer);
+      if (!buffer.master || buffer.master->width < masterWidth || buffer.master->height < masterHeight || buffer.master->depth < masterDepth || buffer.master->levels < masterLevels) {
+         newMaster = createHostSurface(baseAddress, pitch, masterWidth, masterHeight, masterDepth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, masterLevels);
 
          // Check if the new master we just made matches our size perfectly.
-         if (width == masterWidth && height == masterHeight && depth == masterDepth) {
+         if (width == masterWidth && height == masterHeight && depth == masterDepth && newMaster->levels >= levels) {
             foundSurface = newMaster;
          }
       }
@@ -841,7 +1214,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
 
    if (!foundSurface) {
       // Lets finally just build our perfect surface...
-      foundSurface = createHostSurface(baseAddress, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer);
+      foundSurface = createHostSurface(baseAddress, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, levels);
       newSurface = foundSurface;
    }
 
@@ -850,6 +1223,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
    if (buffer.active != buffer.master) {
       if (!discardData) {
          copyHostSurface(buffer.master, buffer.active, dim);
+         mSurfaceStats.copies++;
       }
 
       buffer.active = buffer.master;
@@ -861,6 +1235,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
    if (newMaster) {
       if (!discardData) {
          copyHostSurface(newMaster, buffer.active, dim);
+         mSurfaceStats.copies++;
       }
 
       buffer.active = newMaster;
@@ -871,6 +1246,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
    if (buffer.active != foundSurface) {
       if (!discardData) {
          copyHostSurface(foundSurface, buffer.active, dim);
+         mSurfaceStats.copies++;
       }
 
       buffer.active = foundSurface;
@@ -890,7 +1266,7 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
    }
 
    // Update the memory bounds to reflect this usage of the texture data
-   auto newMemEnd = buffer.cpuMemStart + getSurfaceBytes(pitch, height, depth, samples, dim, format);
+   auto newMemEnd = getSurfaceMemEnd(baseAddress, mipAddress, pitch, width, height, depth, samples, dim, format, isDepthBuffer, tileMode, swizzle, levels);
 
    if (newMemEnd > buffer.cpuMemEnd) {
       mResourceMap.removeResource(&buffer);
@@ -898,14 +1274,186 @@ GLDriver::getSurfaceBuffer(ppcaddr_t baseAddress,
       mResourceMap.addResource(&buffer);
    }
 
+   // Only the first level is copied between host surfaces, so the rest of
+   //  the chain has to come from memory again
+   if (!forWrite && levels > 1) {
+      buffer.mipMemHash[0] = 0;
+      buffer.mipMemHash[1] = 0;
+      buffer.needUpload = true;
+   }
+
    if (!forWrite && buffer.needUpload) {
-      uploadSurface(&buffer, baseAddress, swizzle, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode);
+      uploadSurface(&buffer, baseAddress, mipAddress, swizzle, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode, levels);
       buffer.needUpload = false;
    }
 
    return &buffer;
 }
 
+bool
+GLDriver::refreshSurfaceAlias(SurfaceBuffer *buffer)
+{
+   // Render targets are always their own newest data, and surfaces with
+   //  several host surfaces are left to the copies in getSurfaceBuffer.
+   if (buffer->state == SurfaceUseState::GpuWritten
+    || buffer->active != buffer->master
+    || buffer->master->next) {
+      return false;
+   }
+
+   // Find the most recently written render target with the same layout
+   auto range = mSurfaceRanges.equal_range(buffer->cpuMemStart);
+   SurfaceBuffer *source = nullptr;
+
+   for (auto itr = range.first; itr != range.second; ++itr) {
+      auto other = itr->second;
+
+      if (other == buffer
+       || other->state != SurfaceUseState::GpuWritten
+       || other->needUpload
+       || other->contentSerial <= buffer->contentSerial
+       || other->info.pitch != buffer->info.pitch
+       || other->info.swizzle != buffer->info.swizzle
+       || other->info.tileMode != buffer->info.tileMode
+       || other->info.samples != buffer->info.samples
+       || other->info.dim != latte::SQ_TEX_DIM::DIM_2D
+       || buffer->info.dim != latte::SQ_TEX_DIM::DIM_2D) {
+         continue;
+      }
+
+      if (!source || other->contentSerial > source->contentSerial) {
+         source = other;
+      }
+   }
+
+   if (!source) {
+      return false;
+   }
+
+   auto src = source->active;
+   auto dst = buffer->active;
+
+   if (dst->viewSourceSerial && dst->viewSourceSerial == src->serial) {
+      // Already sharing the render target's texture
+      buffer->contentSerial = source->contentSerial;
+      return true;
+   }
+
+   if (src->isDepthBuffer || dst->isDepthBuffer) {
+      return false;
+   }
+
+   auto viewBits = getViewClassBits(dst->storageFormat);
+   auto canView = viewBits != 0
+               && viewBits == getViewClassBits(src->storageFormat)
+               && src->width == dst->width
+               && src->height == dst->height
+               && src->depth == dst->depth;
+
+   auto canCopy = !getDataFormatIsCompressed(buffer->info.format)
+               && !getDataFormatIsCompressed(source->info.format)
+               && getDataFormatBitsPerElement(buffer->info.format) == getDataFormatBitsPerElement(source->info.format);
+
+   if (!canView && !canCopy) {
+      return false;
+   }
+
+   if (canView || dst->viewSourceSerial) {
+      // Replace our host surface, either with a view of the render target,
+      //  or because copying into a view would write to the one it views.
+      auto newSurface = new HostSurface(*dst);
+      newSurface->swizzleR = gl::GL_RED;
+      newSurface->swizzleG = gl::GL_GREEN;
+      newSurface->swizzleB = gl::GL_BLUE;
+      newSurface->swizzleA = gl::GL_ALPHA;
+      newSurface->serial = 0;
+      newSurface->viewSourceSerial = 0;
+      newSurface->next = nullptr;
+
+      if (canView) {
+         gl::glGenTextures(1, &newSurface->object);
+         gl::glTextureView(newSurface->object, gl::GL_TEXTURE_2D, src->object, dst->storageFormat, 0, 1, 0, 1);
+         if (!src->serial) {
+            src->serial = ++mHostSurfaceSerial;
+         }
+
+         newSurface->viewSourceSerial = src->serial;
+         newSurface->levels = 1;
+      } else {
+         gl::glCreateTextures(gl::GL_TEXTURE_2D, 1, &newSurface->object);
+         gl::glTextureStorage2D(newSurface->object, dst->levels, dst->storageFormat, dst->width, dst->height);
+      }
+
+      if (decaf::config::gpu::debug) {
+         auto label = fmt::format("surface @ 0x{:08X}", buffer->cpuMemStart);
+         gl::glObjectLabel(gl::GL_TEXTURE, newSurface->object, -1, label.c_str());
+      }
+
+      releaseHostSurface(dst);
+      buffer->active = newSurface;
+      buffer->master = newSurface;
+      dst = newSurface;
+      mDirtyDrawState |= DrawState::ColorBuffer | DrawState::DepthBuffer;
+   }
+
+   if (canView) {
+      mSurfaceStats.views++;
+   } else {
+      gl::glCopyImageSubData(
+         src->object, gl::GL_TEXTURE_2D, 0, 0, 0, 0,
+         dst->object, gl::GL_TEXTURE_2D, 0, 0, 0, 0,
+         std::min(src->width, dst->width), std::min(src->height, dst->height), 1);
+      mSurfaceStats.copies++;
+   }
+
+   // Remember what guest memory held, so a flush which did not change it
+   //  does not replace the render target's data with stale memory.
+   if (!buffer->cpuMemHash[0] && !buffer->cpuMemHash[1]) {
+      auto size = getUploadImageSize(buffer->info.pitch, dst->height, dst->depth, buffer->info.dim, buffer->info.format);
+      MurmurHash3_x64_128(mem::translate(buffer->cpuMemStart), size, 0, buffer->cpuMemHash);
+   }
+
+   buffer->contentSerial = source->contentSerial;
+   return true;
+}
+
+void
+GLDriver::releaseHostSurface(HostSurface *surface)
+{
+   // Forget any bindings of the texture, as the name may be reused.  Views
+   //  know their source by serial, so nothing else refers to the surface.
+   for (auto &cache : mPixelTextureCache) {
+      if (cache.surfaceObject == surface->object) {
+         cache.surfaceObject = 0;
+      }
+   }
+
+   gl::glDeleteTextures(1, &surface->object);
+   delete surface;
+   mDirtyDrawState |= DrawState::Textures;
+}
+
+void
+GLDriver::markSurfaceGpuWritten(SurfaceBuffer *buffer)
+{
+   buffer->dirtyMemory = false;
+   buffer->needUpload = false;
+   buffer->state = SurfaceUseState::GpuWritten;
+   buffer->contentSerial = ++mSurfaceSerial;
+}
+
+decaf::OpenGLSurfaceStats
+GLDriver::getSurfaceStats()
+{
+   auto stats = decaf::OpenGLSurfaceStats { };
+   stats.hits = mSurfaceStats.hits;
+   stats.misses = mSurfaceStats.misses;
+   stats.uploads = mSurfaceStats.uploads;
+   stats.views = mSurfaceStats.views;
+   stats.copies = mSurfaceStats.copies;
+   return stats;
+}
+
 void
 GLDriver::setSurfaceSwizzle(SurfaceBuffer *surface,
                             gl::GLenum swizzleR,
@@ -62,6 +62,7 @@ bool GLDriver::checkActiveTextures()
       auto sq_tex_resource_word5 = getRegister<latte::SQ_TEX_RESOURCE_WORD5_N>(latte::Register::SQ_TEX_RESOURCE_WORD5_0 + 4 * resourceOffset);
       auto sq_tex_resource_word6 = getRegister<latte::SQ_TEX_RESOURCE_WORD6_N>(latte::Register::SQ_TEX_RESOURCE_WORD6_0 + 4 * resourceOffset);
       auto baseAddress = sq_tex_resource_word2.BASE_ADDRESS() << 8;
+      auto mipAddress = sq_tex_resource_word3.MIP_ADDRESS() << 8;
 
       if (!baseAddress) {
          if (mPixelTextureCache[i].surfaceObject != 0) {
@@ -86,9 +87,11 @@ bool GLDriver::checkActiveTextures()
       auto swizzle = sq_tex_resource_word2.SWIZZLE() << 8;
       auto isDepthBuffer = !!sq_tex_resource_word0.TILE_TYPE();
       auto samples = 0u;
+      auto levels = sq_tex_resource_word5.LAST_LEVEL() + 1;
 
       if (dim == latte::SQ_TEX_DIM::DIM_2D_MSAA || dim == latte::SQ_TEX_DIM::DIM_2D_ARRAY_MSAA) {
          samples = 1 << sq_tex_resource_word5.LAST_LEVEL();
+         levels = 1;
       }
 
       // Check to make sure the incoming swizzle makes sense...  If this assertion ever
@@ -99,12 +102,14 @@ bool GLDriver::checkActiveTextures()
       decaf_check((baseAddress & 0x7FF) == swizzle);
 
       // Get the surface
-      auto buffer = getSurfaceBuffer(baseAddress, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode, false, false);
+      auto buffer = getSurfaceBuffer(baseAddress, mipAddress, pitch, width, height, depth, samples, dim, format, numFormat, formatComp, degamma, isDepthBuffer, tileMode, levels, false, false);
 
       if (buffer->active->object != mPixelTextureCache[i].surfaceObject
-       || sq_tex_resource_word4.value != mPixelTextureCache[i].word4) {
+       || sq_tex_resource_word4.value != mPixelTextureCache[i].word4
+       || sq_tex_resource_word5.value != mPixelTextureCache[i].word5) {
          mPixelTextureCache[i].surfaceObject = buffer->active->object;
          mPixelTextureCache[i].word4 = sq_tex_resource_word4.value;
+         mPixelTextureCache[i].word5 = sq_tex_resource_word5.value;
 
          // Setup texture swizzle
          auto dst_sel_x = getTextureSwizzle(sq_tex_resource_word4.DST_SEL_X());
@@ -114,6 +119,13 @@ bool GLDriver::checkActiveTextures()
 
          setSurfaceSwizzle(buffer, dst_sel_x, dst_sel_y, dst_sel_z, dst_sel_w);
 
+         // Restrict sampling to the levels of the view, GL clamps these to
+         //  the levels the host surface actually has.
+         if (!samples) {
+            gl::glTextureParameteri(buffer->active->object, gl::GL_TEXTURE_BASE_LEVEL, static_cast<gl::GLint>(sq_tex_resource_word4.BASE_LEVEL()));
+            gl::glTextureParameteri(buffer->active->object, gl::GL_TEXTURE_MAX_LEVEL, static_cast<gl::GLint>(sq_tex_resource_word5.LAST_LEVEL()));
+         }
+
          // In debug mode, first unbind the unit to remove any textures of
          //  different types (again, to reduce clutter in apitrace etc.)
          if (decaf::config::gpu::debug) {
@@ -163,6 +175,24 @@ getTextureXYFilter(latte::SQ_TEX_XY_FILTER filter)
    }
 }
 
+static gl::GLenum
+getTextureMinFilter(latte::SQ_TEX_XY_FILTER filter,
+                    latte::SQ_TEX_Z_FILTER mipFilter)
+{
+   auto linear = (filter == latte::SQ_TEX_XY_FILTER::BILINEAR);
+
+   switch (mipFilter) {
+   case latte::SQ_TEX_Z_FILTER::NONE:
+      return getTextureXYFilter(filter);
+   case latte::SQ_TEX_Z_FILTER::POINT:
+      return linear ? gl::GL_LINEAR_MIPMAP_NEAREST : gl::GL_NEAREST_MIPMAP_NEAREST;
+   case latte::SQ_TEX_Z_FILTER::LINEAR:
+      return linear ? gl::GL_LINEAR_MIPMAP_LINEAR : gl::GL_NEAREST_MIPMAP_LINEAR;
+   default:
+      decaf_abort(fmt::format("Unimplemented texture mip filter {}", mipFilter));
+   }
+}
+
 static gl::GLenum
 getTextureCompareFunction(latte::REF_FUNC func)
 {
@@ -248,7 +278,7 @@ bool GLDriver::checkActiveSamplers()
       }
 
       // Texture filter
-      auto xy_min_filter = getTextureXYFilter(sq_tex_sampler_word0.XY_MIN_FILTER());
+      auto xy_min_filter = getTextureMinFilter(sq_tex_sampler_word0.XY_MIN_FILTER(), sq_tex_sampler_word0.MIP_FILTER());
       auto xy_mag_filter = getTextureXYFilter(sq_tex_sampler_word0.XY_MAG_FILTER());
 
       if (mPixelSamplerCache[i].minFilter != xy_min_filter) {
@@ -9,14 +9,23 @@
 #include "pm4_packets.h"
 #include "pm4_reader.h"
 #include "pm4_writer.h"
+#include <algorithm>
 #include <array>
+#include <common/align.h>
 #include <common/byte_swap.h>
 #include <common/log.h>
 #include <common/platform_dir.h>
+#include <common/platform_thread.h>
 #include <common/murmur3.h>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <gsl.h>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
+#include <zlib.h>
 
 /**
  * THIS IS AN UNFINISHED EXPERIMENTAL FEATURE
@@ -34,17 +43,22 @@
  *   combined with the previous issue means we really need a custom handler for shadow
  *   state memory, rather than using the flush based tracking everything else uses.
  *
- * - We should probably use some cheap compression algorithm such as snappy to save
- *   even more space.
- *
  * - There seems to be a big with surface size calculations and this can lead to properly
  *   fucking up the memory tracking and playback with missing ends of textures.
  */
 
-using decaf::pm4::CaptureMagic;
-using decaf::pm4::CapturePacket;
+using decaf::pm4::CaptureDataRef;
+using decaf::pm4::CaptureFileHeader;
+using decaf::pm4::CaptureFrameIndex;
+using decaf::pm4::CaptureIndexedMagic;
+using decaf::pm4::CaptureIndexFooter;
+using decaf::pm4::CaptureIndexMagic;
 using decaf::pm4::CaptureMemoryLoad;
+using decaf::pm4::CaptureMemoryLoadRef;
+using decaf::pm4::CapturePacket;
+using decaf::pm4::CapturePacketAlign;
 using decaf::pm4::CaptureSetBuffer;
+using decaf::pm4::CaptureVersion;
 
 static const auto
 HashAllMemory = false;
@@ -52,9 +66,298 @@ HashAllMemory = false;
 static const auto
 HashShadowState = true;
 
+// Maximum amount of packet data waiting for the writer thread before we
+// start blocking the thread which is recording.
+static const auto
+MaxQueuedBytes = size_t { 64 * 1024 * 1024 };
+
+// Memory loads smaller than this are not worth compressing
+static const auto
+MinCompressSize = size_t { 256 };
+
 namespace pm4
 {
 
+/**
+ * Serialises capture packets on a background thread.
+ *
+ * Packets are queued by the recording thread and then written to an indexed
+ * capture file by the writer thread. Memory contents are written once as a
+ * zlib compressed MemoryData packet, identified by their hash, and every
+ * load of those contents is then a small MemoryLoadRef packet.
+ *
+ * The writer also remembers the most recent load of every address so it
+ * can write a keyframe for each frame, which lets the replay tool seek
+ * directly to any frame.
+ */
+class CaptureWriter
+{
+public:
+   struct Packet
+   {
+      CapturePacket::Type type;
+      CaptureMemoryLoad load;
+      std::vector<uint8_t> data;
+
+      // When set, data holds the register state at the start of the next frame
+      bool endFrame = false;
+   };
+
+   ~CaptureWriter()
+   {
+      close();
+   }
+
+   bool
+   open(const std::string &path)
+   {
+      mOut.open(path, std::fstream::binary);
+
+      if (!mOut.is_open()) {
+         return false;
+      }
+
+      CaptureFileHeader header;
+      header.magic = CaptureIndexedMagic;
+      header.version = CaptureVersion;
+      mOffset = 0;
+      writeRaw(&header, sizeof(CaptureFileHeader));
+
+      mFrames.clear();
+      mFrames.push_back(CaptureFrameIndex {});
+      mFrames.back().offset = mOffset;
+      mKeyframes.clear();
+      mLatestLoads.clear();
+      mLatestSetBuffers.clear();
+      mWrittenData.clear();
+
+      mQueuedBytes = 0;
+      mRunning = true;
+      mThread = std::thread { &CaptureWriter::run, this };
+      platform::setThreadName(&mThread, "PM4 Capture Writer");
+      return true;
+   }
+
+   void
+   close()
+   {
+      std::unique_lock<std::mutex> lock { mQueueMutex };
+
+      if (!mRunning) {
+         return;
+      }
+
+      mRunning = false;
+      lock.unlock();
+
+      mQueueCond.notify_all();
+      mThread.join();
+   }
+
+   void
+   queue(Packet &&packet)
+   {
+      std::unique_lock<std::mutex> lock { mQueueMutex };
+      auto size = packet.data.size();
+
+      // Only block the recording thread when the writer falls too far behind
+      while (!mQueue.empty() && mQueuedBytes + size > MaxQueuedBytes) {
+         mSpaceCond.wait(lock);
+      }
+
+      mQueuedBytes += size;
+      mQueue.emplace_back(std::move(packet));
+      lock.unlock();
+
+      mQueueCond.notify_one();
+   }
+
+private:
+   void
+   run()
+   {
+      while (true) {
+         std::unique_lock<std::mutex> lock { mQueueMutex };
+         mQueueCond.wait(lock, [&]() { return !mQueue.empty() || !mRunning; });
+
+         if (mQueue.empty()) {
+            // Only exit once everything queued has been written
+            break;
+         }
+
+         auto packet = std::move(mQueue.front());
+         mQueue.pop_front();
+         mQueuedBytes -= packet.data.size();
+         lock.unlock();
+
+         mSpaceCond.notify_all();
+
+         if (packet.endFrame) {
+            endFrame(packet.data);
+         } else {
+            writePacket(packet);
+         }
+      }
+
+      writeIndex();
+      mOut.close();
+   }
+
+   void
+   writePacket(const Packet &packet)
+   {
+      if (packet.type == CapturePacket::MemoryLoad) {
+         CaptureMemoryLoadRef ref;
+         ref.type = packet.load.type;
+         ref.address = packet.load.address;
+         ref.data = writeData(packet.data);
+
+         mLatestLoads[ref.address] = mOffset;
+         writePacket(CapturePacket::MemoryLoadRef, &ref, sizeof(CaptureMemoryLoadRef));
+         return;
+      }
+
+      if (packet.type == CapturePacket::SetBuffer) {
+         auto setBuffer = reinterpret_cast<const CaptureSetBuffer *>(packet.data.data());
+         mLatestSetBuffers[setBuffer->type] = mOffset;
+      }
+
+      writePacket(packet.type, packet.data.data(), packet.data.size());
+   }
+
+   void
+   writePacket(CapturePacket::Type type,
+               const void *data,
+               size_t size)
+   {
+      static const uint8_t padding[CapturePacketAlign] = { 0 };
+      auto header = CapturePacket {};
+      header.type = type;
+      header.size = static_cast<uint32_t>(size);
+
+      writeRaw(&header, sizeof(CapturePacket));
+      writeRaw(data, size);
+      writeRaw(padding, align_up(size, CapturePacketAlign) - size);
+   }
+
+   // Write data as a MemoryData packet if we have not already written it
+   CaptureDataRef
+   writeData(const std::vector<uint8_t> &data)
+   {
+      uint64_t hash[2];
+      MurmurHash3_x64_128(data.data(), static_cast<int>(data.size()), 0, hash);
+
+      auto itr = mWrittenData.find({ hash[0], hash[1] });
+
+      if (itr != mWrittenData.end()) {
+         return itr->second;
+      }
+
+      CaptureDataRef ref;
+      ref.offset = mOffset + sizeof(CapturePacket);
+      ref.size = static_cast<uint32_t>(data.size());
+      ref.compressedSize = ref.size;
+
+      auto compressedSize = static_cast<uLongf>(compressBound(static_cast<uLong>(data.size())));
+      mCompressBuffer.resize(compressedSize);
+
+      if (data.size() >= MinCompressSize
+       && compress2(mCompressBuffer.data(), &compressedSize, data.data(), static_cast<uLong>(data.size()), Z_BEST_SPEED) == Z_OK
+       && compressedSize < data.size()) {
+         ref.compressedSize = static_cast<uint32_t>(compressedSize);
+         writePacket(CapturePacket::MemoryData, mCompressBuffer.data(), compressedSize);
+      } else {
+         writePacket(CapturePacket::MemoryData, data.data(), data.size());
+      }
+
+      mWrittenData.emplace(std::make_pair(hash[0], hash[1]), ref);
+      return ref;
+   }
+
+   void
+   endFrame(const std::vector<uint8_t> &registers)
+   {
+      auto &frame = mFrames.back();
+      frame.size = mOffset - frame.offset;
+
+      // Start the next frame with its keyframe
+      auto next = CaptureFrameIndex {};
+      next.offset = mOffset;
+      next.registers = writeData(registers);
+      next.keyframeOffset = mKeyframes.size();
+
+      for (auto &itr : mLatestSetBuffers) {
+         mKeyframes.push_back(itr.second);
+      }
+
+      auto loadsStart = mKeyframes.size();
+
+      for (auto &itr : mLatestLoads) {
+         mKeyframes.push_back(itr.second);
+      }
+
+      // Loads must be replayed in the order they were captured
+      std::sort(mKeyframes.begin() + loadsStart, mKeyframes.end());
+      next.keyframeCount = static_cast<uint32_t>(mKeyframes.size() - next.keyframeOffset);
+      mFrames.push_back(next);
+   }
+
+   void
+   writeIndex()
+   {
+      auto &frame = mFrames.back();
+      frame.size = mOffset - frame.offset;
+
+      if (frame.size == 0) {
+         // Drop the final frame if nothing was captured in it
+         mFrames.pop_back();
+      }
+
+      // Keyframe offsets were stored relative to the start of mKeyframes
+      auto keyframesOffset = mOffset;
+      writeRaw(mKeyframes.data(), mKeyframes.size() * sizeof(uint64_t));
+
+      for (auto &frame : mFrames) {
+         frame.keyframeOffset = keyframesOffset + frame.keyframeOffset * sizeof(uint64_t);
+      }
+
+      CaptureIndexFooter footer;
+      footer.indexOffset = mOffset;
+      footer.numFrames = static_cast<uint32_t>(mFrames.size());
+      footer.magic = CaptureIndexMagic;
+
+      writeRaw(mFrames.data(), mFrames.size() * sizeof(CaptureFrameIndex));
+      writeRaw(&footer, sizeof(CaptureIndexFooter));
+   }
+
+   void
+   writeRaw(const void *data,
+            size_t size)
+   {
+      mOut.write(reinterpret_cast<const char *>(data), size);
+      mOffset += size;
+   }
+
+private:
+   std::thread mThread;
+   std::mutex mQueueMutex;
+   std::condition_variable mQueueCond;
+   std::condition_variable mSpaceCond;
+   std::deque<Packet> mQueue;
+   size_t mQueuedBytes = 0;
+   bool mRunning = false;
+
+   // Only accessed by the writer thread
+   std::ofstream mOut;
+   uint64_t mOffset = 0;
+   std::vector<uint8_t> mCompressBuffer;
+   std::map<std::pair<uint64_t, uint64_t>, CaptureDataRef> mWrittenData;
+   std::map<uint32_t, uint64_t> mLatestLoads;
+   std::map<uint32_t, uint64_t> mLatestSetBuffers;
+   std::vector<CaptureFrameIndex> mFrames;
+   std::vector<uint64_t> mKeyframes;
+};
+
 class Recorder
 {
    struct RecordedMemory
@@ -75,15 +378,11 @@ public:
    {
       decaf_check(mState == CaptureState::Disabled);
       std::unique_lock<std::mutex> lock { mMutex };
-      mOut.open(path, std::fstream::binary);
 
-      if (!mOut.is_open()) {
+      if (!mWriter.open(path)) {
          return false;
       }
 
-      // Write magic header
-      mOut.write(CaptureMagic.data(), CaptureMagic.size());
-
       // Set intial state
       mRecordedMemory.clear();
       mState = CaptureState::WaitStartNextFrame;
@@ -136,14 +435,13 @@ public:
    {
       decaf_check(mState == CaptureState::Enabled || mState == CaptureState::WaitEndNextFrame);
       std::unique_lock<std::mutex> lock { mMutex };
-      auto size = buffer->curSize * 4;
+      mFoundSwap = false;
       scanCommandBuffer(buffer->buffer, buffer->curSize);
+      writePacket(CapturePacket::CommandBuffer, buffer->buffer, buffer->curSize * 4);
 
-      CapturePacket packet;
-      packet.type = CapturePacket::CommandBuffer;
-      packet.size = size;
-      writePacket(packet);
-      writeData(buffer->buffer, packet.size);
+      if (mFoundSwap) {
+         writeEndFrame();
+      }
    }
 
    void
@@ -187,18 +485,16 @@ private:
    stop()
    {
       decaf_check(mState == CaptureState::Enabled || mState == CaptureState::WaitEndNextFrame);
-      mOut.close();
+      mWriter.close();
       mState = CaptureState::Disabled;
    }
 
    void
    writeRegisterSnapshot()
    {
-      CapturePacket packet;
-      packet.type = CapturePacket::RegisterSnapshot;
-      packet.size = static_cast<uint32_t>(mRegisters.size() * sizeof(uint32_t));
-      writePacket(packet);
-      writeData(mRegisters.data(), packet.size);
+      writePacket(CapturePacket::RegisterSnapshot,
+                  mRegisters.data(),
+                  static_cast<uint32_t>(mRegisters.size() * sizeof(uint32_t)));
    }
 
    void
@@ -207,11 +503,6 @@ private:
       auto tvInfo = gx2::internal::getTvBufferInfo();
 
       if (tvInfo->buffer) {
-         CapturePacket packet;
-         packet.type = CapturePacket::SetBuffer;
-         packet.size = sizeof(CaptureSetBuffer);
-         writePacket(packet);
-
          CaptureSetBuffer setBuffer;
          setBuffer.type = CaptureSetBuffer::TvBuffer;
          setBuffer.address = mem::untranslate(tvInfo->buffer);
@@ -221,17 +512,12 @@ private:
          setBuffer.bufferingMode = tvInfo->bufferingMode;
          setBuffer.width = tvInfo->width;
          setBuffer.height = tvInfo->height;
-         writeData(&setBuffer, packet.size);
+         writePacket(CapturePacket::SetBuffer, &setBuffer, sizeof(CaptureSetBuffer));
       }
 
       auto drcInfo = gx2::internal::getDrcBufferInfo();
 
       if (drcInfo->buffer) {
-         CapturePacket packet;
-         packet.type = CapturePacket::SetBuffer;
-         packet.size = sizeof(CaptureSetBuffer);
-         writePacket(packet);
-
          CaptureSetBuffer setBuffer;
          setBuffer.type = CaptureSetBuffer::DrcBuffer;
          setBuffer.address = mem::untranslate(drcInfo->buffer);
@@ -241,20 +527,30 @@ private:
          setBuffer.bufferingMode = drcInfo->bufferingMode;
          setBuffer.width = drcInfo->width;
          setBuffer.height = drcInfo->height;
-         writeData(&setBuffer, packet.size);
+         writePacket(CapturePacket::SetBuffer, &setBuffer, sizeof(CaptureSetBuffer));
       }
    }
 
    void
-   writePacket(CapturePacket &packet)
+   writePacket(CapturePacket::Type type,
+               const void *data,
+               uint32_t size)
    {
-      mOut.write(reinterpret_cast<const char *>(&packet), sizeof(CapturePacket));
+      auto bytes = reinterpret_cast<const uint8_t *>(data);
+      CaptureWriter::Packet packet;
+      packet.type = type;
+      packet.data.assign(bytes, bytes + size);
+      mWriter.queue(std::move(packet));
    }
 
    void
-   writeData(void *data, uint32_t size)
+   writeEndFrame()
    {
-      mOut.write(reinterpret_cast<const char *>(data), size);
+      auto bytes = reinterpret_cast<const uint8_t *>(mRegisters.data());
+      CaptureWriter::Packet packet;
+      packet.endFrame = true;
+      packet.data.assign(bytes, bytes + mRegisters.size() * sizeof(uint32_t));
+      mWriter.queue(std::move(packet));
    }
 
    void
@@ -262,30 +558,20 @@ private:
                    void *buffer,
                    uint32_t size)
    {
-      CaptureMemoryLoad load;
-      load.type = type;
-      load.address = mem::untranslate(buffer);
-
-      CapturePacket packet;
+      auto bytes = reinterpret_cast<const uint8_t *>(buffer);
+      CaptureWriter::Packet packet;
       packet.type = CapturePacket::MemoryLoad;
-      packet.size = size + sizeof(CaptureMemoryLoad);
-      writePacket(packet);
-      writeData(&load, sizeof(CaptureMemoryLoad));
-      writeData(buffer, size);
+      packet.load.type = type;
+      packet.load.address = mem::untranslate(buffer);
+      packet.data.assign(bytes, bytes + size);
+      mWriter.queue(std::move(packet));
    }
 
    void
    scanCommandBuffer(uint32_t *words, uint32_t numWords)
    {
-      std::vector<uint32_t> swapped;
-      swapped.resize(numWords);
-
-      for (auto i = 0u; i < swapped.size(); ++i) {
-         swapped[i] = byte_swap(words[i]);
-      }
-
-      auto buffer = swapped.data();
-      auto bufferSize = swapped.size();
+      auto buffer = reinterpret_cast<be_val<uint32_t> *>(words);
+      auto bufferSize = size_t { numWords };
 
       for (auto pos = size_t { 0u }; pos < bufferSize; ) {
          auto header = pm4::Header::get(buffer[pos]);
@@ -328,7 +614,7 @@ private:
 
    void
    scanType0(pm4::type0::Header header,
-             const gsl::span<uint32_t> &data)
+             const gsl::span<be_val<uint32_t>> &data)
    {
    }
 
@@ -554,9 +840,10 @@ private:
    void
    scanLoadRegisters(latte::Register base,
                      be_val<uint32_t> *src,
-                     const gsl::span<std::pair<uint32_t, uint32_t>> &registers)
+                     const pm4::PacketSpan<std::pair<uint32_t, uint32_t>> &registers)
    {
-      for (auto &range : registers) {
+      for (auto i = 0u; i < registers.size(); ++i) {
+         auto range = registers[i];
          auto start = range.first;
          auto count = range.second;
 
@@ -575,7 +862,7 @@ private:
 
    void
    scanType3(pm4::type3::Header header,
-             const gsl::span<uint32_t> &rawData)
+             const gsl::span<be_val<uint32_t>> &rawData)
    {
       pm4::PacketReader reader { rawData };
 
@@ -587,7 +874,8 @@ private:
          break;
       }
       case pm4::type3::DECAF_SWAP_BUFFERS:
-         // Nothing to track!
+         // Nothing to track, but this marks the end of a frame
+         mFoundSwap = true;
          break;
       case pm4::type3::DECAF_CLEAR_COLOR:
       {
@@ -869,9 +1157,10 @@ private:
 private:
    CaptureState mState = CaptureState::Disabled;
    std::mutex mMutex;
-   std::ofstream mOut;
+   CaptureWriter mWriter;
    std::vector<RecordedMemory> mRecordedMemory;
    std::array<uint32_t, 0x10000> mRegisters;
+   bool mFoundSwap = false;
    size_t mCapturedFrames = 0;
    size_t mCaptureNumFrames = 0;
 };
@@ -1,5 +1,6 @@
 #pragma once
 #include "pm4_format.h"
+#include "pm4_span.h"
 #include "latte_registers.h"
 
 #include <common/bitfield.h>
@@ -158,7 +159,7 @@ struct DecafDebugMarker
    static const auto Opcode = type3::DECAF_DEBUGMARKER;
 
    uint32_t id;
-   gsl::span<char> key;
+   PacketSpan<char> key;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -299,7 +300,7 @@ struct DrawIndexImmd
 
    uint32_t count;                           // VGT_DMA_SIZE
    latte::VGT_DRAW_INITIATOR drawInitiator;  // VGT_DRAW_INITIATOR
-   gsl::span<uint32_t> indices;
+   PacketSpan<uint32_t> indices;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -371,7 +372,7 @@ struct SetAluConsts
    static const auto Opcode = type3::SET_ALU_CONST;
 
    latte::Register id;
-   gsl::span<uint32_t> values;
+   PacketSpan<uint32_t> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -401,7 +402,7 @@ struct SetConfigRegs
    static const auto Opcode = type3::SET_CONFIG_REG;
 
    latte::Register id;
-   gsl::span<uint32_t> values;
+   PacketSpan<uint32_t> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -431,7 +432,7 @@ struct SetContextRegs
    static const auto Opcode = type3::SET_CONTEXT_REG;
 
    latte::Register id;
-   gsl::span<uint32_t> values;
+   PacketSpan<uint32_t> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -476,7 +477,7 @@ struct SetControlConstants
    static const auto Opcode = type3::SET_CTL_CONST;
 
    latte::Register id;
-   gsl::span<uint32_t> values;
+   PacketSpan<uint32_t> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -506,7 +507,7 @@ struct SetLoopConsts
    static const auto Opcode = type3::SET_LOOP_CONST;
 
    latte::Register id;
-   gsl::span<uint32_t> values;
+   PacketSpan<uint32_t> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -540,7 +541,7 @@ struct SetSamplers
    static const auto Opcode = type3::SET_SAMPLER;
 
    latte::Register id;
-   gsl::span<uint32_t> values;
+   PacketSpan<uint32_t> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -610,7 +611,7 @@ struct SetResources
    static const auto Opcode = type3::SET_RESOURCE;
 
    uint32_t id;
-   gsl::span<uint32_t> values;
+   PacketSpan<uint32_t> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -641,7 +642,7 @@ struct LoadConfigReg
 {
    static const auto Opcode = type3::LOAD_CONFIG_REG;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -658,7 +659,7 @@ struct LoadContextReg
 {
    static const auto Opcode = type3::LOAD_CONTEXT_REG;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -675,7 +676,7 @@ struct LoadAluConst
 {
    static const auto Opcode = type3::LOAD_ALU_CONST;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -692,7 +693,7 @@ struct LoadBoolConst
 {
    static const auto Opcode = type3::LOAD_BOOL_CONST;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -709,7 +710,7 @@ struct LoadLoopConst
 {
    static const auto Opcode = type3::LOAD_LOOP_CONST;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -726,7 +727,7 @@ struct LoadResource
 {
    static const auto Opcode = type3::LOAD_RESOURCE;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -743,7 +744,7 @@ struct LoadSampler
 {
    static const auto Opcode = type3::LOAD_SAMPLER;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -760,7 +761,7 @@ struct LoadControlConst
 {
    static const auto Opcode = type3::LOAD_CTL_CONST;
    be_val<uint32_t> *addr;
-   gsl::span<std::pair<uint32_t, uint32_t>> values;
+   PacketSpan<std::pair<uint32_t, uint32_t>> values;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
@@ -940,7 +941,7 @@ struct Nop
    static const auto Opcode = type3::NOP;
 
    uint32_t unk;
-   gsl::span<uint32_t> strWords;
+   PacketSpan<uint32_t> strWords;
 
    template<typename Serialiser>
    void serialise(Serialiser &se)
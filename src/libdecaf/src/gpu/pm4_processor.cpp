@@ -1,6 +1,8 @@
 #include <common/log.h>
 #include "pm4_processor.h"
 #include "pm4_reader.h"
+#include <algorithm>
+#include <vector>
 
 namespace gpu
 {
@@ -13,22 +15,17 @@ Pm4Processor::indirectBufferCall(const pm4::IndirectBufferCall &data)
 }
 
 void
-Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
+Pm4Processor::runCommandBuffer(uint32_t *words, uint32_t buffer_size)
 {
-   std::vector<uint32_t> swapped;
-   swapped.resize(buffer_size);
-
-   for (auto i = 0u; i < buffer_size; ++i) {
-      swapped[i] = byte_swap(buffer[i]);
-   }
-
-   buffer = swapped.data();
+   // The command buffer is big endian, we read it in place and let
+   // PacketReader swap each word as it is used.
+   auto buffer = reinterpret_cast<be_val<uint32_t> *>(words);
 
    for (auto pos = 0u; pos < buffer_size; ) {
-      auto header = *reinterpret_cast<pm4::Header *>(&buffer[pos]);
+      auto header = pm4::Header::get(buffer[pos]);
       auto size = 0u;
 
-      if (buffer[pos] == 0) {
+      if (header.value == 0) {
          break;
       }
 
@@ -39,7 +36,17 @@ Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
          size = header3.size() + 1;
 
          decaf_check(pos + size <= buffer_size);
-         handlePacketType3(header3, gsl::make_span(&buffer[pos + 1], size));
+
+         if (mPacketStatsEnabled) {
+            auto start = std::chrono::high_resolution_clock::now();
+            handlePacketType3(header3, gsl::make_span(&buffer[pos + 1], size));
+
+            auto &stats = mType3Stats[header3.opcode()];
+            stats.count++;
+            stats.time += std::chrono::high_resolution_clock::now() - start;
+         } else {
+            handlePacketType3(header3, gsl::make_span(&buffer[pos + 1], size));
+         }
          break;
       }
       case pm4::Header::Type0:
@@ -48,7 +55,16 @@ Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
          size = header0.count() + 1;
 
          decaf_check(pos + size <= buffer_size);
-         handlePacketType0(header0, gsl::make_span(&buffer[pos + 1], size));
+
+         if (mPacketStatsEnabled) {
+            auto start = std::chrono::high_resolution_clock::now();
+            handlePacketType0(header0, gsl::make_span(&buffer[pos + 1], size));
+
+            mType0Stats.count++;
+            mType0Stats.time += std::chrono::high_resolution_clock::now() - start;
+         } else {
+            handlePacketType0(header0, gsl::make_span(&buffer[pos + 1], size));
+         }
          break;
       }
       case pm4::Header::Type2:
@@ -68,19 +84,27 @@ Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
 }
 
 void
-Pm4Processor::handlePacketType0(pm4::type0::Header header, const gsl::span<uint32_t> &data)
+Pm4Processor::handlePacketType0(pm4::type0::Header header, const gsl::span<be_val<uint32_t>> &data)
 {
    auto base = header.baseIndex();
 
+   if (base + data.size() > mRegisters.size()) {
+      gLog->error("Type0 packet writes past register file, base = 0x{:X}, count = {}", base, data.size());
+   }
+
    for (auto i = 0; i < data.size(); ++i) {
       auto index = base + i;
-      // Set mRegisters[base + i];
-      gLog->info("Type0 set register 0x{:08X} = 0x{:08X}", index, data[i]);
+
+      if (index >= mRegisters.size()) {
+         break;
+      }
+
+      setRegister(static_cast<latte::Register>(index * 4), data[i]);
    }
 }
 
 void
-Pm4Processor::handlePacketType3(pm4::type3::Header header, const gsl::span<uint32_t> &data)
+Pm4Processor::handlePacketType3(pm4::type3::Header header, const gsl::span<be_val<uint32_t>> &data)
 {
    pm4::PacketReader reader{ data };
 
@@ -214,7 +238,7 @@ void Pm4Processor::nopPacket(const pm4::Nop &data)
 {
    auto str = std::string{};
 
-   if (data.strWords.size()) {
+   if (!data.strWords.empty()) {
       for (auto i = 0u; i < data.strWords.size(); ++i) {
          auto word = data.strWords[i];
 
@@ -381,9 +405,10 @@ void Pm4Processor::setResources(const pm4::SetResources &data)
 
 void Pm4Processor::loadRegisters(latte::Register base,
    be_val<uint32_t> *src,
-   const gsl::span<std::pair<uint32_t, uint32_t>> &registers)
+   const pm4::PacketSpan<std::pair<uint32_t, uint32_t>> &registers)
 {
-   for (auto &range : registers) {
+   for (auto i = 0u; i < registers.size(); ++i) {
+      auto range = registers[i];
       auto start = range.first;
       auto count = range.second;
 
@@ -462,6 +487,12 @@ Pm4Processor::setRegister(latte::Register reg,
                           uint32_t value)
 {
    decaf_check((reg % 4) == 0);
+
+   if (reg / 4 >= mRegisters.size()) {
+      gLog->error("Ignoring write to out of range register 0x{:X}", reg);
+      return;
+   }
+
    auto isChanged = (value != mRegisters[reg / 4]);
 
    // Save to local registers
@@ -482,4 +513,47 @@ Pm4Processor::setRegister(latte::Register reg,
    }
 }
 
+void
+Pm4Processor::resetPacketStats()
+{
+   mType0Stats = PacketStats { };
+   mType3Stats.fill(PacketStats { });
+}
+
+void
+Pm4Processor::logPacketStats()
+{
+   using std::chrono::duration_cast;
+   using std::chrono::microseconds;
+   auto opcodes = std::vector<uint32_t> { };
+
+   for (auto i = 0u; i < mType3Stats.size(); ++i) {
+      if (mType3Stats[i].count) {
+         opcodes.push_back(i);
+      }
+   }
+
+   // Most expensive packets first
+   std::sort(opcodes.begin(), opcodes.end(), [&](uint32_t lhs, uint32_t rhs) {
+      return mType3Stats[lhs].time > mType3Stats[rhs].time;
+   });
+
+   // Note that the time for INDIRECT_BUFFER_PRIV includes the packets inside it
+   gLog->info("PM4 packet statistics:");
+
+   if (mType0Stats.count) {
+      gLog->info("  type0      count {:>10} time {:>10}us",
+                 mType0Stats.count,
+                 duration_cast<microseconds>(mType0Stats.time).count());
+   }
+
+   for (auto opcode : opcodes) {
+      auto &stats = mType3Stats[opcode];
+      gLog->info("  type3 0x{:02X} count {:>10} time {:>10}us",
+                 opcode,
+                 stats.count,
+                 duration_cast<microseconds>(stats.time).count());
+   }
+}
+
 } // namespace gpu
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "gpu/pm4_packets.h"
+#include <array>
+#include <chrono>
 
 namespace gpu
 {
@@ -8,6 +10,11 @@ namespace gpu
 class Pm4Processor
 {
 public:
+   struct PacketStats
+   {
+      uint64_t count = 0;
+      std::chrono::nanoseconds time { 0 };
+   };
 
 protected:
    virtual void decafSetBuffer(const pm4::DecafSetBuffer &data) = 0;
@@ -31,8 +38,8 @@ protected:
    virtual void streamOutBufferUpdate(const pm4::StreamOutBufferUpdate &data) = 0;
    virtual void surfaceSync(const pm4::SurfaceSync &data) = 0;
 
-   void handlePacketType0(pm4::type0::Header header, const gsl::span<uint32_t> &data);
-   void handlePacketType3(pm4::type3::Header header, const gsl::span<uint32_t> &data);
+   void handlePacketType0(pm4::type0::Header header, const gsl::span<be_val<uint32_t>> &data);
+   void handlePacketType3(pm4::type3::Header header, const gsl::span<be_val<uint32_t>> &data);
    void nopPacket(const pm4::Nop &data);
    void indirectBufferCall(const pm4::IndirectBufferCall &data);
    void indexType(const pm4::IndexType &data);
@@ -60,7 +67,7 @@ protected:
    void loadResources(const pm4::LoadResource &data);
    void loadRegisters(latte::Register base,
       be_val<uint32_t> *src,
-      const gsl::span<std::pair<uint32_t, uint32_t>> &registers);
+      const pm4::PacketSpan<std::pair<uint32_t, uint32_t>> &registers);
 
    void
    setRegister(latte::Register reg, uint32_t value);
@@ -69,6 +76,12 @@ protected:
    runCommandBuffer(uint32_t *buffer,
                     uint32_t size);
 
+   void
+   resetPacketStats();
+
+   void
+   logPacketStats();
+
    template<typename Type>
    Type getRegister(uint32_t id)
    {
@@ -80,6 +93,11 @@ protected:
    latte::ShadowState mShadowState;
    std::array<uint32_t, 0x10000> mRegisters;
 
+   //! Count and time every packet processed by runCommandBuffer
+   bool mPacketStatsEnabled = false;
+   PacketStats mType0Stats;
+   std::array<PacketStats, 0x100> mType3Stats;
+
 };
 
 } // namespace gpu
\ No newline at end of file
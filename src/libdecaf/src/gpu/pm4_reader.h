@@ -1,7 +1,9 @@
 #pragma once
 #include "pm4_buffer.h"
 #include "pm4_format.h"
+#include "pm4_span.h"
 
+#include <common/be_val.h>
 #include <common/decaf_assert.h>
 #include <libcpu/mem.h>
 #include <gsl.h>
@@ -10,15 +12,17 @@ namespace pm4
 {
 
 /**
- * Note: packet reader assumes the buffer has already been byte swapped to
- * little endian before reading. This is because it returns pointers to the
- * buffer, and we have to be able to return swapped memory. We cannot do an
- * in place swap because that could modify the game's memory.
+ * Reads packets directly from a big endian command buffer.
+ *
+ * Words are byte swapped as they are read, and variable length data is
+ * returned as a PacketSpan which points into the original buffer and swaps
+ * on access. This means we never need to allocate or copy a command buffer
+ * to parse it, and we never modify the game's memory.
  */
 class PacketReader
 {
 public:
-   PacketReader(gsl::span<uint32_t> data) :
+   PacketReader(gsl::span<be_val<uint32_t>> data) :
       mBuffer(data)
    {
    }
@@ -35,7 +39,7 @@ public:
    PacketReader &operator()(float &value)
    {
       checkSize(1);
-      value = bit_cast<float>(mBuffer[mPosition++]);
+      value = bit_cast<float>(mBuffer[mPosition++].value());
       return *this;
    }
 
@@ -45,7 +49,7 @@ public:
    {
       static_assert(sizeof(Type) == sizeof(uint32_t), "Invalid type size");
       checkSize(1);
-      value = bit_cast<Type>(mBuffer[mPosition++]);
+      value = bit_cast<Type>(mBuffer[mPosition++].value());
       return *this;
    }
 
@@ -60,11 +64,10 @@ public:
 
    // Read the rest of the entire packet
    template<typename Type>
-   PacketReader &operator()(gsl::span<Type> &values)
+   PacketReader &operator()(PacketSpan<Type> &values)
    {
-      values = gsl::make_span(reinterpret_cast<Type*>(&mBuffer[mPosition]),
-                            ((mBuffer.size() - mPosition) * sizeof(uint32_t)) / sizeof(Type));
-
+      auto size = ((mBuffer.size() - mPosition) * sizeof(uint32_t)) / sizeof(Type);
+      values = PacketSpan<Type>::bigEndian(mBuffer.data() + mPosition, size);
       mPosition = mBuffer.size();
       return *this;
    }
@@ -104,7 +107,7 @@ private:
 
 private:
    size_t mPosition = 0;
-   gsl::span<uint32_t> mBuffer;
+   gsl::span<be_val<uint32_t>> mBuffer;
 };
 
 template<typename Type>
@@ -0,0 +1,129 @@
+#pragma once
+#include <common/be_val.h>
+#include <common/byte_swap.h>
+#include <cstdint>
+#include <cstring>
+#include <gsl.h>
+#include <type_traits>
+
+namespace pm4
+{
+
+/**
+ * A view of the variable length data at the end of a packet.
+ *
+ * When a packet is built for writing the span refers to host ordered data,
+ * exactly like a gsl::span. When a packet is read by the PacketReader the
+ * span points directly into the big endian command buffer in guest memory
+ * and each element is byte swapped on access, this means we never have to
+ * make a swapped copy of a command buffer to parse it.
+ *
+ * Swapping is always done per 32 bit word, to match the PacketWriter.
+ */
+template<typename Type>
+class PacketSpan
+{
+   static_assert(sizeof(Type) % 4 == 0 || 4 % sizeof(Type) == 0,
+                 "PacketSpan type must pack evenly into 32 bit words");
+
+public:
+   PacketSpan() = default;
+
+   PacketSpan(const gsl::span<Type> &values) :
+      mData(values.data()),
+      mSize(static_cast<size_t>(values.size()))
+   {
+   }
+
+   static PacketSpan
+   bigEndian(const be_val<uint32_t> *words,
+             size_t size)
+   {
+      PacketSpan result;
+      result.mData = words;
+      result.mSize = size;
+      result.mBigEndian = true;
+      return result;
+   }
+
+   Type
+   operator[](size_t index) const
+   {
+      if (mBigEndian) {
+         return readSwapped<Type>(index);
+      } else {
+         return reinterpret_cast<const Type *>(mData)[index];
+      }
+   }
+
+   size_t
+   size() const
+   {
+      return mSize;
+   }
+
+   bool
+   empty() const
+   {
+      return mSize == 0;
+   }
+
+   // Number of 32 bit words covered by this span
+   size_t
+   words() const
+   {
+      return ((mSize * sizeof(Type)) + 3) / 4;
+   }
+
+   // Raw pointer to the data, which is big endian if isBigEndian() is true
+   const void *
+   data() const
+   {
+      return mData;
+   }
+
+   bool
+   isBigEndian() const
+   {
+      return mBigEndian;
+   }
+
+private:
+   // Type is made up of one or more whole words
+   template<typename ValueType>
+   std::enable_if_t<sizeof(ValueType) % 4 == 0, ValueType>
+   readSwapped(size_t index) const
+   {
+      const auto numWords = sizeof(ValueType) / 4;
+      auto src = reinterpret_cast<const uint32_t *>(mData) + index * numWords;
+      uint32_t words[numWords];
+      ValueType value;
+
+      for (auto i = 0u; i < numWords; ++i) {
+         words[i] = byte_swap(src[i]);
+      }
+
+      std::memcpy(&value, words, sizeof(ValueType));
+      return value;
+   }
+
+   // Type is smaller than a word, so extract it from the swapped word
+   template<typename ValueType>
+   std::enable_if_t<sizeof(ValueType) < 4, ValueType>
+   readSwapped(size_t index) const
+   {
+      auto offset = index * sizeof(ValueType);
+      auto word = byte_swap(reinterpret_cast<const uint32_t *>(mData)[offset / 4]);
+      ValueType value;
+
+      std::memcpy(&value, reinterpret_cast<const uint8_t *>(&word) + (offset % 4), sizeof(ValueType));
+      return value;
+   }
+
+private:
+   const void *mData = nullptr;
+   size_t mSize = 0;
+   bool mBigEndian = false;
+};
+
+} // namespace pm4
@@ -2,6 +2,7 @@
 #include "pm4_buffer.h"
 #include "pm4_format.h"
 #include "pm4_packets.h"
+#include "pm4_span.h"
 #include "latte_registers.h"
 
 #include <common/decaf_assert.h>
@@ -39,10 +40,9 @@ public:
 
    // Write a list of words
    template<typename Type>
-   PacketSizer &operator()(const gsl::span<Type> &values)
+   PacketSizer &operator()(const PacketSpan<Type> &values)
    {
-      auto dataSize = gsl::narrow_cast<uint32_t>(((values.size() * sizeof(Type)) + 3) / 4);
-      mPayloadSize += dataSize;
+      mPayloadSize += gsl::narrow_cast<uint32_t>(values.words());
       return *this;
    }
 
@@ -133,14 +133,17 @@ public:
 
    // Write a list of words
    template<typename Type>
-   PacketWriter &operator()(const gsl::span<Type> &values)
+   PacketWriter &operator()(const PacketSpan<Type> &values)
    {
-      auto dataSize = gsl::narrow_cast<uint32_t>(((values.size() * sizeof(Type)) + 3) / 4);
+      auto dataSize = gsl::narrow_cast<uint32_t>(values.words());
       std::memcpy(&mBuffer->buffer[mBuffer->curSize], values.data(), dataSize * sizeof(uint32_t));
 
-      // We do the byte_swap here separately as Type may not be uint32_t sized
-      for (auto i = 0u; i < dataSize; ++i) {
-         mBuffer->buffer[mBuffer->curSize + i] = byte_swap(mBuffer->buffer[mBuffer->curSize + i]);
+      // Data read from another command buffer is already big endian, otherwise
+      // we do the byte_swap here separately as Type may not be uint32_t sized
+      if (!values.isBigEndian()) {
+         for (auto i = 0u; i < dataSize; ++i) {
+            mBuffer->buffer[mBuffer->curSize + i] = byte_swap(mBuffer->buffer[mBuffer->curSize + i]);
+         }
       }
 
       mBuffer->curSize += dataSize;
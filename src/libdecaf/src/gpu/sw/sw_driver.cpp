@@ -0,0 +1,674 @@
+#include "sw_driver.h"
+#include "sw_shader.h"
+#include "gpu/gpu_tiling.h"
+#include "gpu/gpu_utilities.h"
+#include "gpu/latte_registers.h"
+
+#include <algorithm>
+#include <common/bit_cast.h>
+#include <common/byte_swap.h>
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <common/platform_dir.h>
+#include <cstring>
+#include <fstream>
+#include <libcpu/mem.h>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+enum
+{
+   SCANTARGET_TV = 1,
+   SCANTARGET_DRC = 4,
+};
+
+//! Sampler registers for vertex shaders follow the pixel and geometry ones
+static const uint32_t VertexSamplerOffset = 18;
+
+Driver::Driver(const decaf::SoftwareGraphicsDriverOptions &options) :
+   mRasteriser(options.numThreads),
+   mDumpPath(options.dumpPath)
+{
+   setPacketStatsEnabled(options.packetStats);
+}
+
+void
+Driver::notifyCpuFlush(void *ptr,
+                       uint32_t size)
+{
+   std::unique_lock<std::mutex> lock { mFlushMutex };
+   mFlushedRanges.emplace_back(mem::untranslate(ptr), size);
+}
+
+void
+Driver::warnOnce(const std::string &message)
+{
+   if (mWarnings.insert(message).second) {
+      gLog->warn("{}", message);
+   }
+}
+
+static bool
+isSameSurface(const Surface &a,
+              const Surface &b)
+{
+   return a.baseAddress == b.baseAddress
+       && a.pitch == b.pitch
+       && a.height == b.height
+       && a.tileMode == b.tileMode
+       && a.isDepth == b.isDepth
+       && a.format.format == b.format.format
+       && a.format.numFormat == b.format.numFormat
+       && a.format.formatComp == b.format.formatComp
+       && a.format.degamma == b.format.degamma
+       && a.depthFormat == b.depthFormat;
+}
+
+Surface *
+Driver::getSurface(const Surface &key,
+                   bool discardData)
+{
+   auto keyEnd = key.baseAddress + key.memorySize;
+   Surface *result = nullptr;
+
+   // Any other view of the same memory must be written back and dropped so
+   //  the new view sees its contents.
+   for (auto itr = mSurfaces.begin(); itr != mSurfaces.end(); ) {
+      auto &surface = **itr;
+
+      if (isSameSurface(surface, key)) {
+         result = &surface;
+         ++itr;
+         continue;
+      }
+
+      if (surface.baseAddress < keyEnd && key.baseAddress < surface.baseAddress + surface.memorySize) {
+         if (surface.dirty) {
+            storeSurface(surface);
+         }
+
+         itr = mSurfaces.erase(itr);
+      } else {
+         ++itr;
+      }
+   }
+
+   if (!result) {
+      mSurfaces.emplace_back(new Surface(key));
+      result = mSurfaces.back().get();
+      result->valid = false;
+      result->dirty = false;
+   }
+
+   if (!result->valid) {
+      if (discardData) {
+         result->data.resize(result->memorySize);
+         result->valid = true;
+      } else {
+         loadSurface(*result);
+      }
+   }
+
+   return result;
+}
+
+Surface *
+Driver::getColorSurface(latte::CB_COLORN_BASE cb_color_base,
+                        latte::CB_COLORN_SIZE cb_color_size,
+                        latte::CB_COLORN_INFO cb_color_info,
+                        bool discardData)
+{
+   auto key = Surface { };
+
+   if (!initColorSurface(key, cb_color_base, cb_color_size, cb_color_info)) {
+      warnOnce(fmt::format("Software renderer does not support colour buffer format {} number type {}",
+                           cb_color_info.FORMAT(), cb_color_info.NUMBER_TYPE()));
+      return nullptr;
+   }
+
+   return getSurface(key, discardData);
+}
+
+Surface *
+Driver::getDepthSurface(latte::DB_DEPTH_BASE db_depth_base,
+                        latte::DB_DEPTH_SIZE db_depth_size,
+                        latte::DB_DEPTH_INFO db_depth_info,
+                        bool discardData)
+{
+   auto key = Surface { };
+
+   if (!initDepthSurface(key, db_depth_base, db_depth_size, db_depth_info)) {
+      warnOnce(fmt::format("Software renderer does not support depth buffer format {}", db_depth_info.FORMAT()));
+      return nullptr;
+   }
+
+   return getSurface(key, discardData);
+}
+
+void
+Driver::storeSurfaces(uint32_t start,
+                      uint32_t end)
+{
+   for (auto &surface : mSurfaces) {
+      if (surface->dirty && surface->baseAddress < end && start < surface->baseAddress + surface->memorySize) {
+         storeSurface(*surface);
+      }
+   }
+}
+
+void
+Driver::storeAllSurfaces()
+{
+   storeSurfaces(0, 0xFFFFFFFF);
+}
+
+void
+Driver::invalidateFlushedSurfaces()
+{
+   std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+   {
+      std::unique_lock<std::mutex> lock { mFlushMutex };
+      ranges.swap(mFlushedRanges);
+   }
+
+   // Memory written by the CPU takes priority over anything we rendered
+   for (auto &range : ranges) {
+      auto start = range.first;
+      auto end = range.first + range.second;
+
+      for (auto &surface : mSurfaces) {
+         if (surface->baseAddress < end && start < surface->baseAddress + surface->memorySize) {
+            surface->valid = false;
+            surface->dirty = false;
+         }
+      }
+   }
+}
+
+void
+Driver::setupShader(ShaderResources &resources,
+                    ShaderType type,
+                    uint32_t programAddress,
+                    uint32_t programSize)
+{
+   auto sq_config = getRegister<latte::SQ_CONFIG>(latte::Register::SQ_CONFIG);
+   auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(latte::Register::SQ_PGM_START_FS);
+   auto pgm_size_fs = getRegister<latte::SQ_PGM_SIZE_FS>(latte::Register::SQ_PGM_SIZE_FS);
+   auto isVertex = (type == ShaderType::Vertex);
+
+   resources.type = type;
+   resources.program = gsl::make_span(mem::translate<const uint8_t>(programAddress), programSize);
+   resources.registers = mRegisters.data();
+   resources.uniformRegisters = nullptr;
+   resources.uniformBlocks.fill(nullptr);
+   resources.uniformBlockSizes.fill(0);
+
+   if (isVertex) {
+      resources.fetchProgram = gsl::make_span(mem::translate<const uint8_t>(pgm_start_fs.PGM_START() << 8),
+                                              pgm_size_fs.PGM_SIZE() << 3);
+   }
+
+   if (sq_config.DX9_CONSTS()) {
+      auto base = isVertex ? latte::Register::SQ_ALU_CONSTANT0_256 : latte::Register::SQ_ALU_CONSTANT0_0;
+      resources.uniformRegisters = &mRegisters[base / 4];
+   } else {
+      auto cacheBase = isVertex ? latte::Register::SQ_ALU_CONST_CACHE_VS_0 : latte::Register::SQ_ALU_CONST_CACHE_PS_0;
+      auto sizeBase = isVertex ? latte::Register::SQ_ALU_CONST_BUFFER_SIZE_VS_0 : latte::Register::SQ_ALU_CONST_BUFFER_SIZE_PS_0;
+
+      for (auto i = 0u; i < latte::MaxUniformBlocks; ++i) {
+         auto sq_alu_const_cache = getRegister<uint32_t>(cacheBase + 4 * i);
+         auto sq_alu_const_buffer_size = getRegister<uint32_t>(sizeBase + 4 * i);
+
+         if (sq_alu_const_cache && sq_alu_const_buffer_size) {
+            resources.uniformBlocks[i] = mem::translate<const uint32_t>(sq_alu_const_cache << 8);
+            resources.uniformBlockSizes[i] = (sq_alu_const_buffer_size << 8) / 4;
+         }
+      }
+   }
+
+   if (isVertex) {
+      setupTextures(resources, mVertexTextures, latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0, VertexSamplerOffset);
+   } else {
+      setupTextures(resources, mPixelTextures, latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0, 0);
+   }
+}
+
+void
+Driver::setupTextures(ShaderResources &resources,
+                      std::array<Texture, latte::MaxTextures> &textures,
+                      uint32_t resourceOffset,
+                      uint32_t samplerOffset)
+{
+   auto usedTextures = getTextureUsageMask(resources.program);
+   resources.textures.fill(nullptr);
+
+   for (auto i = 0u; i < latte::MaxSamplers; ++i) {
+      auto sq_tex_sampler_word0 = getRegister<latte::SQ_TEX_SAMPLER_WORD0_N>(latte::Register::SQ_TEX_SAMPLER_WORD0_0 + 4 * ((samplerOffset + i) * 3));
+      resources.samplers[i] = decodeSampler(sq_tex_sampler_word0);
+   }
+
+   for (auto i = 0u; i < latte::MaxTextures; ++i) {
+      if (!(usedTextures & (1 << i))) {
+         continue;
+      }
+
+      auto offset = (resourceOffset + i) * 7;
+      auto sq_tex_resource_word0 = getRegister<latte::SQ_TEX_RESOURCE_WORD0_N>(latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * offset);
+      auto sq_tex_resource_word1 = getRegister<latte::SQ_TEX_RESOURCE_WORD1_N>(latte::Register::SQ_TEX_RESOURCE_WORD1_0 + 4 * offset);
+      auto sq_tex_resource_word2 = getRegister<latte::SQ_TEX_RESOURCE_WORD2_N>(latte::Register::SQ_TEX_RESOURCE_WORD2_0 + 4 * offset);
+      auto sq_tex_resource_word4 = getRegister<latte::SQ_TEX_RESOURCE_WORD4_N>(latte::Register::SQ_TEX_RESOURCE_WORD4_0 + 4 * offset);
+      auto baseAddress = sq_tex_resource_word2.BASE_ADDRESS() << 8;
+
+      if (!baseAddress) {
+         continue;
+      }
+
+      // Sampling something we rendered to, make sure memory is up to date
+      storeSurfaces(baseAddress, baseAddress + 1);
+
+      if (!decodeTexture(textures[i], sq_tex_resource_word0, sq_tex_resource_word1, sq_tex_resource_word2, sq_tex_resource_word4)) {
+         warnOnce(fmt::format("Software renderer does not support texture format {} dim {}",
+                              sq_tex_resource_word1.DATA_FORMAT(), sq_tex_resource_word0.DIM()));
+         continue;
+      }
+
+      resources.textures[i] = &textures[i];
+   }
+}
+
+void
+Driver::drawPrimitives(uint32_t count,
+                       const uint32_t *indices)
+{
+   auto pgm_start_fs = getRegister<latte::SQ_PGM_START_FS>(latte::Register::SQ_PGM_START_FS);
+   auto pgm_start_vs = getRegister<latte::SQ_PGM_START_VS>(latte::Register::SQ_PGM_START_VS);
+   auto pgm_start_ps = getRegister<latte::SQ_PGM_START_PS>(latte::Register::SQ_PGM_START_PS);
+   auto pgm_size_vs = getRegister<latte::SQ_PGM_SIZE_VS>(latte::Register::SQ_PGM_SIZE_VS);
+   auto pgm_size_ps = getRegister<latte::SQ_PGM_SIZE_PS>(latte::Register::SQ_PGM_SIZE_PS);
+   auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(latte::Register::PA_CL_CLIP_CNTL);
+   auto cb_shader_control = getRegister<latte::CB_SHADER_CONTROL>(latte::Register::CB_SHADER_CONTROL);
+   auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
+   auto db_depth_base = getRegister<latte::DB_DEPTH_BASE>(latte::Register::DB_DEPTH_BASE);
+
+   // Stream out is only counted, so there is nothing to do without pixels
+   if (!pgm_start_fs.PGM_START() || !pgm_start_vs.PGM_START() || !pgm_start_ps.PGM_START()
+    || pa_cl_clip_cntl.RASTERISER_DISABLE()) {
+      return;
+   }
+
+   invalidateFlushedSurfaces();
+
+   auto vertexShader = ShaderResources { };
+   auto pixelShader = ShaderResources { };
+   setupShader(vertexShader, ShaderType::Vertex, pgm_start_vs.PGM_START() << 8, pgm_size_vs.PGM_SIZE() << 3);
+   setupShader(pixelShader, ShaderType::Pixel, pgm_start_ps.PGM_START() << 8, pgm_size_ps.PGM_SIZE() << 3);
+
+   auto command = DrawCommand { };
+   command.registers = mRegisters.data();
+   command.vertexShader = &vertexShader;
+   command.pixelShader = &pixelShader;
+   command.indices = indices;
+   command.count = count;
+   command.colorTargets.fill(nullptr);
+
+   for (auto i = 0u; i < latte::MaxRenderTargets; ++i) {
+      auto cb_color_base = getRegister<latte::CB_COLORN_BASE>(latte::Register::CB_COLOR0_BASE + i * 4);
+      auto cb_color_size = getRegister<latte::CB_COLORN_SIZE>(latte::Register::CB_COLOR0_SIZE + i * 4);
+      auto cb_color_info = getRegister<latte::CB_COLORN_INFO>(latte::Register::CB_COLOR0_INFO + i * 4);
+
+      if ((cb_shader_control.value & (1 << i)) && cb_color_base.BASE_256B()) {
+         command.colorTargets[i] = getColorSurface(cb_color_base, cb_color_size, cb_color_info, false);
+      }
+   }
+
+   // Like the OpenGL driver only bind depth when it is used, so its size
+   //  does not clip colour only draws.
+   if (db_depth_base.BASE_256B() && (db_depth_control.Z_ENABLE() || db_depth_control.STENCIL_ENABLE())) {
+      auto db_depth_size = getRegister<latte::DB_DEPTH_SIZE>(latte::Register::DB_DEPTH_SIZE);
+      auto db_depth_info = getRegister<latte::DB_DEPTH_INFO>(latte::Register::DB_DEPTH_INFO);
+      command.depthTarget = getDepthSurface(db_depth_base, db_depth_size, db_depth_info, false);
+   }
+
+   mTotalSamplesPassed += mRasteriser.draw(command);
+}
+
+void
+Driver::drawPrimitivesIndexed(const void *buffer,
+                              uint32_t count)
+{
+   auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
+   auto indices = std::vector<uint32_t>(count);
+
+   // Same swap rules as the OpenGL driver
+   if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_16_BIT) {
+      auto src = reinterpret_cast<const uint16_t *>(buffer);
+
+      if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_16) {
+         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", vgt_dma_index_type.INDEX_TYPE()));
+      }
+
+      for (auto i = 0u; i < count; ++i) {
+         indices[i] = byte_swap(src[i]);
+      }
+   } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
+      auto src = reinterpret_cast<const uint32_t *>(buffer);
+
+      if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_32) {
+         decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", vgt_dma_index_type.INDEX_TYPE()));
+      }
+
+      for (auto i = 0u; i < count; ++i) {
+         indices[i] = byte_swap(src[i]);
+      }
+   } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::NONE) {
+      if (vgt_dma_index_type.INDEX_TYPE() == latte::VGT_INDEX_TYPE::INDEX_16) {
+         auto src = reinterpret_cast<const uint16_t *>(buffer);
+         std::copy(src, src + count, indices.begin());
+      } else {
+         auto src = reinterpret_cast<const uint32_t *>(buffer);
+         std::copy(src, src + count, indices.begin());
+      }
+   } else {
+      decaf_abort(fmt::format("Unimplemented vgt_dma_index_type.SWAP_MODE {}", vgt_dma_index_type.SWAP_MODE()));
+   }
+
+   drawPrimitives(count, indices.data());
+}
+
+void
+Driver::drawIndexAuto(const pm4::DrawIndexAuto &data)
+{
+   null::Driver::drawIndexAuto(data);
+   drawPrimitives(data.count, nullptr);
+}
+
+void
+Driver::drawIndex2(const pm4::DrawIndex2 &data)
+{
+   null::Driver::drawIndex2(data);
+   drawPrimitivesIndexed(data.addr, data.count);
+}
+
+void
+Driver::drawIndexImmd(const pm4::DrawIndexImmd &data)
+{
+   null::Driver::drawIndexImmd(data);
+
+   // The immediate indices live in the command buffer, swap them back into
+   //  the guest memory layout that drawPrimitivesIndexed expects.
+   auto indices = std::vector<uint32_t>(data.indices.size());
+
+   for (auto i = 0u; i < indices.size(); ++i) {
+      indices[i] = data.indices[i];
+   }
+
+   drawPrimitivesIndexed(indices.data(), data.count);
+}
+
+void
+Driver::decafClearColor(const pm4::DecafClearColor &data)
+{
+   invalidateFlushedSurfaces();
+
+   auto surface = getColorSurface(data.cb_color_base, data.cb_color_size, data.cb_color_info, true);
+
+   if (!surface) {
+      return;
+   }
+
+   auto value = Vec4 {
+      bit_cast<uint32_t>(data.red),
+      bit_cast<uint32_t>(data.green),
+      bit_cast<uint32_t>(data.blue),
+      bit_cast<uint32_t>(data.alpha),
+   };
+
+   if (surface->format.numFormat == latte::SQ_NUM_FORMAT::INT) {
+      for (auto &channel : value) {
+         channel = static_cast<uint32_t>(static_cast<int32_t>(bit_cast<float>(channel)));
+      }
+   }
+
+   // Pack one element and replicate it over the whole surface
+   packElement(surface->data.data(), surface->format, value);
+
+   for (auto offset = surface->elementBytes; offset < surface->data.size(); offset += surface->elementBytes) {
+      std::memcpy(surface->data.data() + offset, surface->data.data(), surface->elementBytes);
+   }
+
+   surface->dirty = true;
+}
+
+void
+Driver::decafClearDepthStencil(const pm4::DecafClearDepthStencil &data)
+{
+   auto db_depth_clear = getRegister<latte::DB_DEPTH_CLEAR>(latte::Register::DB_DEPTH_CLEAR);
+   auto db_stencil_clear = getRegister<latte::DB_STENCIL_CLEAR>(latte::Register::DB_STENCIL_CLEAR);
+
+   invalidateFlushedSurfaces();
+
+   // As with the OpenGL driver depth and stencil are always cleared together
+   auto surface = getDepthSurface(data.db_depth_base, data.db_depth_size, data.db_depth_info, true);
+
+   if (!surface) {
+      return;
+   }
+
+   writeDepth(*surface, 0, 0, quantiseDepth(*surface, db_depth_clear.DEPTH_CLEAR()));
+   writeStencil(*surface, 0, 0, static_cast<uint8_t>(db_stencil_clear.CLEAR()));
+
+   for (auto offset = surface->elementBytes; offset < surface->data.size(); offset += surface->elementBytes) {
+      std::memcpy(surface->data.data() + offset, surface->data.data(), surface->elementBytes);
+   }
+
+   surface->dirty = true;
+}
+
+void
+Driver::decafSetBuffer(const pm4::DecafSetBuffer &data)
+{
+   auto &buffer = data.isTv ? mTvScanBuffer : mDrcScanBuffer;
+   buffer.width = data.width;
+   buffer.height = data.height;
+   buffer.pixels.clear();
+   buffer.pixels.resize(data.width * data.height, 0xFF000000);
+}
+
+static uint8_t
+toUnorm8(uint32_t value,
+         bool isInteger)
+{
+   if (isInteger) {
+      return static_cast<uint8_t>(std::min(value, 255u));
+   }
+
+   auto f = std::min(std::max(bit_cast<float>(value), 0.0f), 1.0f);
+   return static_cast<uint8_t>(f * 255.0f + 0.5f);
+}
+
+void
+Driver::decafCopyColorToScan(const pm4::DecafCopyColorToScan &data)
+{
+   ScanBuffer *target = nullptr;
+
+   if (data.scanTarget == SCANTARGET_TV) {
+      target = &mTvScanBuffer;
+   } else if (data.scanTarget == SCANTARGET_DRC) {
+      target = &mDrcScanBuffer;
+   } else {
+      gLog->error("decafCopyColorToScan called for unknown scanTarget.");
+      return;
+   }
+
+   invalidateFlushedSurfaces();
+
+   auto surface = getColorSurface(data.cb_color_base, data.cb_color_size, data.cb_color_info, false);
+
+   if (!surface || !target->width || !target->height) {
+      return;
+   }
+
+   auto isInteger = (surface->format.numFormat == latte::SQ_NUM_FORMAT::INT);
+   auto srcWidth = std::min(data.width, surface->pitch);
+   auto srcHeight = std::min(data.height, surface->height);
+
+   // Nearest neighbour scale to the scan buffer size
+   for (auto y = 0u; y < target->height; ++y) {
+      auto srcY = static_cast<uint32_t>(static_cast<uint64_t>(y) * srcHeight / target->height);
+
+      for (auto x = 0u; x < target->width; ++x) {
+         auto srcX = static_cast<uint32_t>(static_cast<uint64_t>(x) * srcWidth / target->width);
+         auto value = unpackElement(getSurfaceElement(*surface, srcX, srcY), surface->format);
+
+         target->pixels[y * target->width + x] =
+            static_cast<uint32_t>(toUnorm8(value[0], isInteger))
+            | (static_cast<uint32_t>(toUnorm8(value[1], isInteger)) << 8)
+            | (static_cast<uint32_t>(toUnorm8(value[2], isInteger)) << 16)
+            | 0xFF000000;
+      }
+   }
+}
+
+void
+Driver::decafOSScreenFlip(const pm4::DecafOSScreenFlip &data)
+{
+   auto &target = (data.screen == 0) ? mTvScanBuffer : mDrcScanBuffer;
+   std::memcpy(target.pixels.data(), data.buffer, target.pixels.size() * sizeof(uint32_t));
+   decafSwapBuffers(pm4::DecafSwapBuffers {});
+}
+
+void
+Driver::writeFrameDump(const ScanBuffer &buffer,
+                       const char *name)
+{
+   if (!buffer.width || !buffer.height) {
+      return;
+   }
+
+   auto path = fmt::format("{}/{}_{:06}.ppm", mDumpPath, name, mFrameNumber);
+   auto file = std::ofstream { path, std::ofstream::out | std::ofstream::binary };
+
+   if (!file.is_open()) {
+      warnOnce(fmt::format("Could not open {} to dump frame", path));
+      return;
+   }
+
+   auto rgb = std::vector<uint8_t>(buffer.width * buffer.height * 3);
+
+   for (auto i = 0u; i < buffer.width * buffer.height; ++i) {
+      rgb[i * 3 + 0] = static_cast<uint8_t>(buffer.pixels[i]);
+      rgb[i * 3 + 1] = static_cast<uint8_t>(buffer.pixels[i] >> 8);
+      rgb[i * 3 + 2] = static_cast<uint8_t>(buffer.pixels[i] >> 16);
+   }
+
+   file << fmt::format("P6\n{} {}\n255\n", buffer.width, buffer.height);
+   file.write(reinterpret_cast<const char *>(rgb.data()), rgb.size());
+}
+
+void
+Driver::decafSwapBuffers(const pm4::DecafSwapBuffers &data)
+{
+   storeAllSurfaces();
+
+   if (!mDumpPath.empty()) {
+      if (mFrameNumber == 0) {
+         platform::createDirectory(mDumpPath);
+      }
+
+      writeFrameDump(mTvScanBuffer, "tv");
+      writeFrameDump(mDrcScanBuffer, "drc");
+   }
+
+   ++mFrameNumber;
+   null::Driver::decafSwapBuffers(data);
+}
+
+void
+Driver::decafCopySurface(const pm4::DecafCopySurface &data)
+{
+   auto bpp = getDataFormatBitsPerElement(data.srcFormat);
+   auto depth = data.srcDepth;
+
+   if (data.srcDim == latte::SQ_TEX_DIM::DIM_CUBEMAP) {
+      depth *= 6;
+   }
+
+   if (data.srcLevel || data.dstLevel || data.srcSlice || data.dstSlice
+    || data.srcSamples > 1 || data.dstSamples > 1
+    || getDataFormatIsCompressed(data.srcFormat)
+    || bpp != getDataFormatBitsPerElement(data.dstFormat)) {
+      warnOnce(fmt::format("Software renderer only copies level 0 of uncompressed surfaces, skipped format {}", data.srcFormat));
+      return;
+   }
+
+   auto srcSize = data.srcPitch * data.srcHeight * depth * (bpp / 8);
+   auto dstSize = data.dstPitch * data.dstHeight * depth * (bpp / 8);
+   auto untiled = std::vector<uint8_t>(srcSize);
+
+   invalidateFlushedSurfaces();
+   storeSurfaces(data.srcImage, data.srcImage + srcSize);
+
+   convertFromTiled(untiled.data(),
+                    data.srcPitch,
+                    mem::translate<uint8_t>(data.srcImage),
+                    data.srcTileMode,
+                    data.srcImage & 0xFFF,
+                    data.srcPitch,
+                    data.srcWidth,
+                    data.srcHeight,
+                    depth,
+                    0,
+                    false,
+                    bpp);
+
+   storeSurfaces(data.dstImage, data.dstImage + dstSize);
+
+   convertToTiled(mem::translate<uint8_t>(data.dstImage),
+                  untiled.data(),
+                  data.srcPitch,
+                  data.dstTileMode,
+                  data.dstImage & 0xFFF,
+                  data.dstPitch,
+                  data.dstWidth,
+                  data.dstHeight,
+                  depth,
+                  0,
+                  false,
+                  bpp);
+
+   for (auto &surface : mSurfaces) {
+      if (surface->baseAddress < data.dstImage + dstSize && data.dstImage < surface->baseAddress + surface->memorySize) {
+         surface->valid = false;
+      }
+   }
+}
+
+void
+Driver::eventWriteEOP(const pm4::EventWriteEOP &data)
+{
+   // Games wait on end of pipe events before reading rendered memory
+   storeAllSurfaces();
+   null::Driver::eventWriteEOP(data);
+}
+
+void
+Driver::surfaceSync(const pm4::SurfaceSync &data)
+{
+   auto memStart = data.addr << 8;
+   auto memEnd = memStart + (data.size << 8);
+
+   if (data.cp_coher_cntl.FULL_CACHE_ENA()) {
+      storeAllSurfaces();
+   } else {
+      storeSurfaces(memStart, memEnd);
+   }
+}
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,94 @@
+#pragma once
+#include "sw_rasteriser.h"
+#include "sw_surface.h"
+#include "sw_texture.h"
+#include "gpu/null/null_driver.h"
+#include "libdecaf/decaf_softwaregraphicsdriver.h"
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+struct ScanBuffer
+{
+   uint32_t width = 0;
+   uint32_t height = 0;
+
+   //! RGBA8 pixels, top row first
+   std::vector<uint32_t> pixels;
+};
+
+//! Extends the null driver, which already handles every packet which does
+//  not touch pixels, with a CPU rasteriser.
+class Driver : public null::Driver
+{
+public:
+   Driver(const decaf::SoftwareGraphicsDriverOptions &options);
+   virtual ~Driver() = default;
+
+   void notifyCpuFlush(void *ptr, uint32_t size) override;
+
+private:
+   Surface *getSurface(const Surface &key, bool discardData);
+   Surface *getColorSurface(latte::CB_COLORN_BASE cb_color_base, latte::CB_COLORN_SIZE cb_color_size, latte::CB_COLORN_INFO cb_color_info, bool discardData);
+   Surface *getDepthSurface(latte::DB_DEPTH_BASE db_depth_base, latte::DB_DEPTH_SIZE db_depth_size, latte::DB_DEPTH_INFO db_depth_info, bool discardData);
+   void storeSurfaces(uint32_t start, uint32_t end);
+   void storeAllSurfaces();
+   void invalidateFlushedSurfaces();
+
+   void setupShader(ShaderResources &resources, ShaderType type, uint32_t programAddress, uint32_t programSize);
+   void setupTextures(ShaderResources &resources, std::array<Texture, latte::MaxTextures> &textures, uint32_t resourceOffset, uint32_t samplerOffset);
+   void drawPrimitives(uint32_t count, const uint32_t *indices);
+   void drawPrimitivesIndexed(const void *buffer, uint32_t count);
+
+   void writeFrameDump(const ScanBuffer &buffer, const char *name);
+   void warnOnce(const std::string &message);
+
+   void decafSetBuffer(const pm4::DecafSetBuffer &data) override;
+   void decafCopyColorToScan(const pm4::DecafCopyColorToScan &data) override;
+   void decafSwapBuffers(const pm4::DecafSwapBuffers &data) override;
+   void decafClearColor(const pm4::DecafClearColor &data) override;
+   void decafClearDepthStencil(const pm4::DecafClearDepthStencil &data) override;
+   void decafOSScreenFlip(const pm4::DecafOSScreenFlip &data) override;
+   void decafCopySurface(const pm4::DecafCopySurface &data) override;
+   void drawIndexAuto(const pm4::DrawIndexAuto &data) override;
+   void drawIndex2(const pm4::DrawIndex2 &data) override;
+   void drawIndexImmd(const pm4::DrawIndexImmd &data) override;
+   void eventWriteEOP(const pm4::EventWriteEOP &data) override;
+   void surfaceSync(const pm4::SurfaceSync &data) override;
+
+private:
+   Rasteriser mRasteriser;
+   std::string mDumpPath;
+   uint32_t mFrameNumber = 0;
+
+   //! Render targets kept untiled between draws
+   std::vector<std::unique_ptr<Surface>> mSurfaces;
+
+   //! Ranges flushed by the CPU since the last draw, notifyCpuFlush may be
+   //  called from any core so these are only applied on the GPU thread.
+   std::mutex mFlushMutex;
+   std::vector<std::pair<uint32_t, uint32_t>> mFlushedRanges;
+
+   std::array<Texture, latte::MaxTextures> mPixelTextures;
+   std::array<Texture, latte::MaxTextures> mVertexTextures;
+
+   ScanBuffer mTvScanBuffer;
+   ScanBuffer mDrcScanBuffer;
+
+   std::set<std::string> mWarnings;
+};
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,460 @@
+#include "sw_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <common/bit_cast.h>
+#include <cstring>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+struct FormatLayout
+{
+   //! Number of bytes in one element
+   uint32_t elementBytes;
+
+   //! Number of channels stored in the element
+   uint32_t numChannels;
+
+   //! Packed formats store every channel in one little endian word at the
+   //  given bit offsets, other formats store each channel in its own
+   //  consecutive little endian word of bits[ch] bits.
+   bool packed;
+
+   //! Whether the channels hold half or single precision floats
+   bool isFloat;
+
+   uint8_t shift[4];
+   uint8_t bits[4];
+};
+
+static bool
+getFormatLayout(latte::SQ_DATA_FORMAT format,
+                FormatLayout &layout)
+{
+   switch (format) {
+   case latte::SQ_DATA_FORMAT::FMT_8:
+      layout = { 1, 1, false, false, { 0 }, { 8 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16:
+      layout = { 2, 1, false, false, { 0 }, { 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_FLOAT:
+      layout = { 2, 1, false, true, { 0 }, { 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_8:
+      layout = { 2, 2, false, false, { 0 }, { 8, 8 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_5_6_5:
+      layout = { 2, 3, true, false, { 11, 5, 0 }, { 5, 6, 5 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_1_5_5_5:
+      layout = { 2, 4, true, false, { 0, 5, 10, 15 }, { 5, 5, 5, 1 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_4_4_4_4:
+      layout = { 2, 4, true, false, { 12, 8, 4, 0 }, { 4, 4, 4, 4 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_5_5_5_1:
+      layout = { 2, 4, true, false, { 11, 6, 1, 0 }, { 5, 5, 5, 1 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32:
+      layout = { 4, 1, false, false, { 0 }, { 32 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_FLOAT:
+      layout = { 4, 1, false, true, { 0 }, { 32 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16:
+      layout = { 4, 2, false, false, { 0 }, { 16, 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16_FLOAT:
+      layout = { 4, 2, false, true, { 0 }, { 16, 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_24:
+      layout = { 4, 2, true, false, { 0, 24 }, { 24, 8 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_2_10_10_10:
+      layout = { 4, 4, true, false, { 0, 10, 20, 30 }, { 10, 10, 10, 2 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_10_10_10_2:
+      layout = { 4, 4, true, false, { 22, 12, 2, 0 }, { 10, 10, 10, 2 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_8_8_8:
+      layout = { 4, 4, false, false, { 0 }, { 8, 8, 8, 8 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32:
+      layout = { 8, 2, false, false, { 0 }, { 32, 32 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32_FLOAT:
+      layout = { 8, 2, false, true, { 0 }, { 32, 32 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16_16:
+      layout = { 8, 4, false, false, { 0 }, { 16, 16, 16, 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16_16_FLOAT:
+      layout = { 8, 4, false, true, { 0 }, { 16, 16, 16, 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32_32:
+      layout = { 16, 4, false, false, { 0 }, { 32, 32, 32, 32 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32_32_FLOAT:
+      layout = { 16, 4, false, true, { 0 }, { 32, 32, 32, 32 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_8_8_8:
+      layout = { 3, 3, false, false, { 0 }, { 8, 8, 8 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16:
+      layout = { 6, 3, false, false, { 0 }, { 16, 16, 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_16_16_16_FLOAT:
+      layout = { 6, 3, false, true, { 0 }, { 16, 16, 16 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32:
+      layout = { 12, 3, false, false, { 0 }, { 32, 32, 32 } };
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_32_32_32_FLOAT:
+      layout = { 12, 3, false, true, { 0 }, { 32, 32, 32 } };
+      break;
+   default:
+      return false;
+   }
+
+   return true;
+}
+
+uint32_t
+getElementBytes(latte::SQ_DATA_FORMAT format)
+{
+   FormatLayout layout;
+
+   if (!getFormatLayout(format, layout)) {
+      return 0;
+   }
+
+   return layout.elementBytes;
+}
+
+float
+halfToFloat(uint16_t half)
+{
+   auto sign = static_cast<uint32_t>(half & 0x8000) << 16;
+   auto exponent = static_cast<uint32_t>((half >> 10) & 0x1F);
+   auto mantissa = static_cast<uint32_t>(half & 0x3FF);
+
+   if (exponent == 0x1F) {
+      // Inf or NaN
+      return bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+   }
+
+   if (exponent == 0) {
+      // Zero or denormal
+      auto value = std::ldexp(static_cast<float>(mantissa), -24);
+      return sign ? -value : value;
+   }
+
+   return bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint16_t
+floatToHalf(float value)
+{
+   auto bits = bit_cast<uint32_t>(value);
+   auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+   auto exponent = static_cast<int32_t>((bits >> 23) & 0xFF);
+   auto mantissa = bits & 0x7FFFFF;
+
+   if (exponent == 0xFF) {
+      return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+   }
+
+   exponent -= 112;
+
+   if (exponent >= 0x1F) {
+      return sign | 0x7C00;
+   }
+
+   if (exponent <= 0) {
+      if (exponent < -10) {
+         return sign;
+      }
+
+      // Denormal, round to nearest
+      mantissa |= 0x800000;
+      auto shift = static_cast<uint32_t>(14 - exponent);
+      auto half = mantissa >> shift;
+
+      if ((mantissa >> (shift - 1)) & 1) {
+         half += 1;
+      }
+
+      return sign | static_cast<uint16_t>(half);
+   }
+
+   auto half = static_cast<uint32_t>(sign) | (exponent << 10) | (mantissa >> 13);
+
+   if (mantissa & 0x1000) {
+      // Round to nearest, may carry in to the exponent which is correct
+      half += 1;
+   }
+
+   return static_cast<uint16_t>(half);
+}
+
+static inline float
+srgbToLinear(float value)
+{
+   if (value <= 0.04045f) {
+      return value / 12.92f;
+   }
+
+   return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static inline float
+linearToSrgb(float value)
+{
+   if (value <= 0.0031308f) {
+      return value * 12.92f;
+   }
+
+   return 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static inline uint32_t
+signExtend(uint32_t value,
+           uint32_t bits)
+{
+   if (bits < 32 && (value & (1u << (bits - 1)))) {
+      value |= ~((1u << bits) - 1);
+   }
+
+   return value;
+}
+
+static inline uint32_t
+unpackChannel(uint32_t raw,
+              uint32_t bits,
+              bool isFloat,
+              const DataFormat &format)
+{
+   if (isFloat) {
+      if (bits == 16) {
+         return bit_cast<uint32_t>(halfToFloat(static_cast<uint16_t>(raw)));
+      }
+
+      return raw;
+   }
+
+   auto isSigned = (format.formatComp == latte::SQ_FORMAT_COMP::SIGNED);
+
+   switch (format.numFormat) {
+   case latte::SQ_NUM_FORMAT::INT:
+      return isSigned ? signExtend(raw, bits) : raw;
+   case latte::SQ_NUM_FORMAT::SCALED:
+      if (isSigned) {
+         return bit_cast<uint32_t>(static_cast<float>(static_cast<int32_t>(signExtend(raw, bits))));
+      } else {
+         return bit_cast<uint32_t>(static_cast<float>(raw));
+      }
+   case latte::SQ_NUM_FORMAT::NORM:
+   default:
+      if (isSigned) {
+         auto max = static_cast<float>((1u << (bits - 1)) - 1);
+         auto value = static_cast<float>(static_cast<int32_t>(signExtend(raw, bits))) / max;
+         return bit_cast<uint32_t>(std::max(value, -1.0f));
+      } else {
+         auto max = static_cast<float>(bits == 32 ? 0xFFFFFFFFu : ((1u << bits) - 1));
+         return bit_cast<uint32_t>(static_cast<float>(raw) / max);
+      }
+   }
+}
+
+static inline uint32_t
+packChannel(uint32_t value,
+            uint32_t bits,
+            bool isFloat,
+            const DataFormat &format)
+{
+   auto mask = bits == 32 ? 0xFFFFFFFFu : ((1u << bits) - 1);
+
+   if (isFloat) {
+      if (bits == 16) {
+         return floatToHalf(bit_cast<float>(value));
+      }
+
+      return value;
+   }
+
+   auto isSigned = (format.formatComp == latte::SQ_FORMAT_COMP::SIGNED);
+   auto fvalue = bit_cast<float>(value);
+
+   switch (format.numFormat) {
+   case latte::SQ_NUM_FORMAT::INT:
+      return value & mask;
+   case latte::SQ_NUM_FORMAT::SCALED:
+      if (isSigned) {
+         return static_cast<uint32_t>(static_cast<int32_t>(fvalue)) & mask;
+      } else {
+         return static_cast<uint32_t>(std::max(fvalue, 0.0f)) & mask;
+      }
+   case latte::SQ_NUM_FORMAT::NORM:
+   default:
+      if (fvalue != fvalue) {
+         return 0;
+      }
+
+      if (isSigned) {
+         auto max = static_cast<float>((1u << (bits - 1)) - 1);
+         fvalue = std::min(std::max(fvalue, -1.0f), 1.0f);
+         return static_cast<uint32_t>(static_cast<int32_t>(std::round(fvalue * max))) & mask;
+      } else {
+         fvalue = std::min(std::max(fvalue, 0.0f), 1.0f);
+         return static_cast<uint32_t>(fvalue * static_cast<float>(mask) + 0.5f);
+      }
+   }
+}
+
+static inline uint32_t
+readBits(const uint8_t *src,
+         uint32_t bytes)
+{
+   auto value = uint32_t { 0 };
+
+   for (auto i = 0u; i < bytes; ++i) {
+      value |= static_cast<uint32_t>(src[i]) << (i * 8);
+   }
+
+   return value;
+}
+
+static inline void
+writeBits(uint8_t *dst,
+          uint32_t bytes,
+          uint32_t value)
+{
+   for (auto i = 0u; i < bytes; ++i) {
+      dst[i] = static_cast<uint8_t>(value >> (i * 8));
+   }
+}
+
+Vec4
+unpackElement(const uint8_t *src,
+              const DataFormat &format)
+{
+   auto result = Vec4 { 0, 0, 0, 0 };
+   FormatLayout layout;
+
+   if (format.numFormat == latte::SQ_NUM_FORMAT::INT) {
+      result[3] = 1;
+   } else {
+      result[3] = bit_cast<uint32_t>(1.0f);
+   }
+
+   if (!getFormatLayout(format.format, layout)) {
+      return result;
+   }
+
+   if (layout.packed) {
+      auto word = readBits(src, layout.elementBytes);
+
+      for (auto ch = 0u; ch < layout.numChannels; ++ch) {
+         auto raw = (word >> layout.shift[ch]) & ((1u << layout.bits[ch]) - 1);
+         result[ch] = unpackChannel(raw, layout.bits[ch], layout.isFloat, format);
+      }
+   } else {
+      auto offset = 0u;
+
+      for (auto ch = 0u; ch < layout.numChannels; ++ch) {
+         auto bytes = layout.bits[ch] / 8u;
+         result[ch] = unpackChannel(readBits(src + offset, bytes), layout.bits[ch], layout.isFloat, format);
+         offset += bytes;
+      }
+   }
+
+   if (format.degamma) {
+      for (auto ch = 0u; ch < 3; ++ch) {
+         result[ch] = bit_cast<uint32_t>(srgbToLinear(bit_cast<float>(result[ch])));
+      }
+   }
+
+   return result;
+}
+
+void
+packElement(uint8_t *dst,
+            const DataFormat &format,
+            const Vec4 &value)
+{
+   auto input = value;
+   FormatLayout layout;
+
+   if (!getFormatLayout(format.format, layout)) {
+      return;
+   }
+
+   if (format.degamma) {
+      for (auto ch = 0u; ch < 3; ++ch) {
+         auto linear = std::min(std::max(bit_cast<float>(input[ch]), 0.0f), 1.0f);
+         input[ch] = bit_cast<uint32_t>(linearToSrgb(linear));
+      }
+   }
+
+   if (layout.packed) {
+      auto word = uint32_t { 0 };
+
+      for (auto ch = 0u; ch < layout.numChannels; ++ch) {
+         word |= packChannel(input[ch], layout.bits[ch], layout.isFloat, format) << layout.shift[ch];
+      }
+
+      writeBits(dst, layout.elementBytes, word);
+   } else {
+      auto offset = 0u;
+
+      for (auto ch = 0u; ch < layout.numChannels; ++ch) {
+         auto bytes = layout.bits[ch] / 8u;
+         writeBits(dst + offset, bytes, packChannel(input[ch], layout.bits[ch], layout.isFloat, format));
+         offset += bytes;
+      }
+   }
+}
+
+void
+swapElement(uint8_t *data,
+            latte::SQ_DATA_FORMAT format,
+            latte::SQ_ENDIAN endian)
+{
+   FormatLayout layout;
+
+   if (!getFormatLayout(format, layout)) {
+      return;
+   }
+
+   auto swapSize = 0u;
+
+   switch (endian) {
+   case latte::SQ_ENDIAN::NONE:
+      return;
+   case latte::SQ_ENDIAN::SWAP_8IN16:
+      swapSize = 2;
+      break;
+   case latte::SQ_ENDIAN::SWAP_8IN32:
+      swapSize = 4;
+      break;
+   case latte::SQ_ENDIAN::AUTO:
+      swapSize = layout.packed ? layout.elementBytes : layout.bits[0] / 8u;
+      break;
+   }
+
+   // Never swap across the end of a smaller element
+   swapSize = std::min(swapSize, layout.elementBytes);
+
+   for (auto i = 0u; i + swapSize <= layout.elementBytes; i += swapSize) {
+      std::reverse(data + i, data + i + swapSize);
+   }
+}
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,57 @@
+#pragma once
+#include "gpu/latte_enum_sq.h"
+
+#include <array>
+#include <cstdint>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+//! Four channels of raw 32 bit register values, float channels hold float
+//  bits and integer channels hold integer bits exactly like a Latte GPR.
+using Vec4 = std::array<uint32_t, 4>;
+
+struct DataFormat
+{
+   latte::SQ_DATA_FORMAT format = latte::SQ_DATA_FORMAT::FMT_INVALID;
+   latte::SQ_NUM_FORMAT numFormat = latte::SQ_NUM_FORMAT::NORM;
+   latte::SQ_FORMAT_COMP formatComp = latte::SQ_FORMAT_COMP::UNSIGNED;
+   bool degamma = false;
+};
+
+//! Size of one element in bytes, or 0 if we cannot pack or unpack this
+//  format in software.
+uint32_t
+getElementBytes(latte::SQ_DATA_FORMAT format);
+
+//! Unpack a single little endian element, missing channels are filled
+//  with (0, 0, 0, 1).
+Vec4
+unpackElement(const uint8_t *src,
+              const DataFormat &format);
+
+//! Pack a single element, the inverse of unpackElement.
+void
+packElement(uint8_t *dst,
+            const DataFormat &format,
+            const Vec4 &value);
+
+//! Swap an element read from a big endian vertex buffer in place,
+//  AUTO swaps each component of the format.
+void
+swapElement(uint8_t *data,
+            latte::SQ_DATA_FORMAT format,
+            latte::SQ_ENDIAN endian);
+
+float
+halfToFloat(uint16_t half);
+
+uint16_t
+floatToHalf(float value);
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,1534 @@
+#include "sw_rasteriser.h"
+#include "gpu/latte_registers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <common/bit_cast.h>
+#include <common/log.h>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+//! Width and height of the screen tiles primitives are binned into
+static const uint32_t TileSize = 64;
+
+//! Number of vertices or primitives handed to a worker at once
+static const uint32_t VertexBatchSize = 64;
+static const uint32_t PrimitiveBatchSize = 256;
+
+//! Primitives are only clipped in x and y once they leave this many
+//  viewports, inside of it the scissor is enough.
+static const float GuardBand = 32.0f;
+
+//! Smallest w we allow after clipping to avoid dividing by zero
+static const float MinClipW = 1.0e-6f;
+
+enum class PrimitiveKind
+{
+   Point,
+   Line,
+   Triangle,
+};
+
+struct Primitive
+{
+   PrimitiveKind kind;
+
+   //! Vertex slots, only the first one or two are used for points and lines
+   std::array<uint32_t, 3> vertices;
+
+   //! Vertex whose attributes are used for flat shading
+   uint32_t provoking;
+};
+
+struct ClipVertex
+{
+   std::array<float, 4> position;
+
+   //! Weights of the primitive's original vertices
+   std::array<float, 3> weights;
+};
+
+struct WindowVertex
+{
+   float x;
+   float y;
+   float z;
+   float invW;
+   std::array<float, 3> weights;
+};
+
+struct Triangle
+{
+   std::array<float, 3> x;
+   std::array<float, 3> y;
+   std::array<float, 3> z;
+   std::array<float, 3> invW;
+   float area;
+
+   //! Inclusive pixel bounds already clipped to the scissor
+   int32_t minX;
+   int32_t minY;
+   int32_t maxX;
+   int32_t maxY;
+
+   bool frontFacing;
+
+   //! Pixel shader inputs for each of the three vertices, flat and default
+   //  inputs hold the same value on every vertex.
+   uint32_t paramOffset;
+   const Vec4 *params;
+};
+
+struct PrimitiveBatch
+{
+   std::vector<Triangle> triangles;
+   std::vector<Vec4> params;
+};
+
+struct PixelInput
+{
+   //! Vertex shader parameter which feeds this input, -1 for the default
+   int32_t param;
+   Vec4 defaultValue;
+   bool flat;
+   bool linear;
+};
+
+struct DepthStencilFace
+{
+   latte::REF_FUNC func;
+   latte::DB_STENCIL_FUNC fail;
+   latte::DB_STENCIL_FUNC zpass;
+   latte::DB_STENCIL_FUNC zfail;
+   uint8_t ref;
+   uint8_t mask;
+   uint8_t writeMask;
+};
+
+struct DrawContext
+{
+   DrawContext(const DrawCommand &command) :
+      command(command)
+   {
+   }
+
+   template<typename Type>
+   Type
+   getRegister(uint32_t id) const
+   {
+      static_assert(sizeof(Type) == 4, "Register storage must be a uint32_t");
+      return *reinterpret_cast<const Type *>(&command.registers[id / 4]);
+   }
+
+   const DrawCommand &command;
+   std::atomic_bool failed { false };
+   std::atomic<uint64_t> samplesPassed { 0 };
+
+   // Vertex state
+   uint32_t numInstances = 1;
+   uint32_t numParams = 0;
+   uint32_t stepRate0 = 1;
+   uint32_t stepRate1 = 1;
+
+   //! Unique vertex ids referenced by the draw, shaded once per instance
+   std::vector<uint32_t> vertexIds;
+
+   //! For each element of the index list its position in vertexIds, or
+   //  RestartSlot for a primitive restart.
+   std::vector<uint32_t> elementSlots;
+
+   //! Outputs for vertexIds.size() * numInstances vertices
+   std::vector<std::array<float, 4>> positions;
+   std::vector<Vec4> vertexParams;
+
+   // Primitive state
+   latte::VGT_DI_PRIMITIVE_TYPE primType;
+   std::vector<Primitive> primitives;
+   bool screenSpace = false;
+   latte::PA_CL_CLIP_CNTL pa_cl_clip_cntl;
+   latte::PA_CL_VTE_CNTL pa_cl_vte_cntl;
+   latte::PA_SU_SC_MODE_CNTL pa_su_sc_mode_cntl;
+   std::array<float, 3> viewportScale;
+   std::array<float, 3> viewportOffset;
+   float zMin = 0.0f;
+   float zMax = 1.0f;
+   float pointHalfWidth = 0.5f;
+   float pointHalfHeight = 0.5f;
+
+   //! Scissor rectangle, max is exclusive
+   int32_t scissorMinX = 0;
+   int32_t scissorMinY = 0;
+   int32_t scissorMaxX = 0;
+   int32_t scissorMaxY = 0;
+
+   uint32_t numInputs = 0;
+   std::array<PixelInput, MaxParams> inputs;
+   std::vector<PrimitiveBatch> batches;
+
+   // Binning
+   uint32_t tilesX = 0;
+   uint32_t tilesY = 0;
+   std::vector<std::vector<const Triangle *>> bins;
+
+   // Pixel state
+   bool positionEnable = false;
+   uint32_t positionAddr = 0;
+   bool frontFaceEnable = false;
+   uint32_t frontFaceAddr = 0;
+   uint32_t frontFaceChan = 0;
+   bool frontFaceAllBits = false;
+
+   bool shadePixels = true;
+   bool earlyDepth = false;
+   bool exportsDepth = false;
+   bool dualSource = false;
+
+   bool alphaTest = false;
+   latte::REF_FUNC alphaFunc = latte::REF_FUNC::ALWAYS;
+   float alphaRef = 0.0f;
+
+   uint32_t colorMask = 0;
+   uint32_t blendEnable = 0;
+   std::array<latte::CB_BLENDN_CONTROL, latte::MaxRenderTargets> blendControl;
+   std::array<float, 4> blendConstant;
+
+   Surface *depthSurface = nullptr;
+   bool depthEnable = false;
+   bool depthWrite = false;
+   latte::REF_FUNC depthFunc = latte::REF_FUNC::ALWAYS;
+   bool stencilEnable = false;
+   DepthStencilFace stencilFront;
+   DepthStencilFace stencilBack;
+};
+
+static const uint32_t RestartSlot = 0xFFFFFFFF;
+
+static inline float
+asFloat(uint32_t value)
+{
+   return bit_cast<float>(value);
+}
+
+static inline uint32_t
+asUint(float value)
+{
+   return bit_cast<uint32_t>(value);
+}
+
+static Vec4
+getDefaultValue(uint32_t defaultVal)
+{
+   auto zero = asUint(0.0f);
+   auto one = asUint(1.0f);
+
+   switch (defaultVal) {
+   case 0:
+      return { zero, zero, zero, zero };
+   case 1:
+      return { zero, zero, zero, one };
+   case 2:
+      return { one, one, one, zero };
+   case 3:
+   default:
+      return { one, one, one, one };
+   }
+}
+
+static bool
+setupDrawState(DrawContext &ctx)
+{
+   auto &command = ctx.command;
+   auto vgt_primitive_type = ctx.getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
+   auto vgt_dma_num_instances = ctx.getRegister<latte::VGT_DMA_NUM_INSTANCES>(latte::Register::VGT_DMA_NUM_INSTANCES);
+   auto spi_vs_out_config = ctx.getRegister<latte::SPI_VS_OUT_CONFIG>(latte::Register::SPI_VS_OUT_CONFIG);
+
+   ctx.primType = vgt_primitive_type.PRIM_TYPE();
+   ctx.screenSpace = (ctx.primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST);
+   ctx.numInstances = std::max(1u, vgt_dma_num_instances.NUM_INSTANCES());
+   ctx.numParams = std::min(spi_vs_out_config.VS_EXPORT_COUNT() + 1, MaxParams);
+   ctx.stepRate0 = std::max(1u, ctx.getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_0));
+   ctx.stepRate1 = std::max(1u, ctx.getRegister<uint32_t>(latte::Register::VGT_INSTANCE_STEP_RATE_1));
+
+   // Primitive setup
+   ctx.pa_cl_clip_cntl = ctx.getRegister<latte::PA_CL_CLIP_CNTL>(latte::Register::PA_CL_CLIP_CNTL);
+   ctx.pa_cl_vte_cntl = ctx.getRegister<latte::PA_CL_VTE_CNTL>(latte::Register::PA_CL_VTE_CNTL);
+   ctx.pa_su_sc_mode_cntl = ctx.getRegister<latte::PA_SU_SC_MODE_CNTL>(latte::Register::PA_SU_SC_MODE_CNTL);
+
+   auto vte = ctx.pa_cl_vte_cntl;
+   ctx.viewportScale[0] = vte.VPORT_X_SCALE_ENA() ? ctx.getRegister<latte::PA_CL_VPORT_XSCALE_N>(latte::Register::PA_CL_VPORT_XSCALE_0).VPORT_XSCALE() : 1.0f;
+   ctx.viewportScale[1] = vte.VPORT_Y_SCALE_ENA() ? ctx.getRegister<latte::PA_CL_VPORT_YSCALE_N>(latte::Register::PA_CL_VPORT_YSCALE_0).VPORT_YSCALE() : 1.0f;
+   ctx.viewportScale[2] = vte.VPORT_Z_SCALE_ENA() ? ctx.getRegister<latte::PA_CL_VPORT_ZSCALE_N>(latte::Register::PA_CL_VPORT_ZSCALE_0).VPORT_ZSCALE() : 1.0f;
+   ctx.viewportOffset[0] = vte.VPORT_X_OFFSET_ENA() ? ctx.getRegister<latte::PA_CL_VPORT_XOFFSET_N>(latte::Register::PA_CL_VPORT_XOFFSET_0).VPORT_XOFFSET() : 0.0f;
+   ctx.viewportOffset[1] = vte.VPORT_Y_OFFSET_ENA() ? ctx.getRegister<latte::PA_CL_VPORT_YOFFSET_N>(latte::Register::PA_CL_VPORT_YOFFSET_0).VPORT_YOFFSET() : 0.0f;
+   ctx.viewportOffset[2] = vte.VPORT_Z_OFFSET_ENA() ? ctx.getRegister<latte::PA_CL_VPORT_ZOFFSET_N>(latte::Register::PA_CL_VPORT_ZOFFSET_0).VPORT_ZOFFSET() : 0.0f;
+
+   auto zMin = ctx.getRegister<latte::PA_SC_VPORT_ZMIN_N>(latte::Register::PA_SC_VPORT_ZMIN_0).VPORT_ZMIN();
+   auto zMax = ctx.getRegister<latte::PA_SC_VPORT_ZMAX_N>(latte::Register::PA_SC_VPORT_ZMAX_0).VPORT_ZMAX();
+   ctx.zMin = std::min(zMin, zMax);
+   ctx.zMax = std::max(zMin, zMax);
+
+   auto pa_su_point_size = ctx.getRegister<latte::PA_SU_POINT_SIZE>(latte::Register::PA_SU_POINT_SIZE);
+
+   if (pa_su_point_size.WIDTH() && pa_su_point_size.HEIGHT()) {
+      ctx.pointHalfWidth = static_cast<float>(pa_su_point_size.WIDTH()) / 16.0f;
+      ctx.pointHalfHeight = static_cast<float>(pa_su_point_size.HEIGHT()) / 16.0f;
+   }
+
+   // The render area is the intersection of every bound surface
+   auto width = 0xFFFFFFFFu;
+   auto height = 0xFFFFFFFFu;
+   auto hasTarget = false;
+
+   for (auto surface : command.colorTargets) {
+      if (surface) {
+         width = std::min(width, surface->pitch);
+         height = std::min(height, surface->height);
+         hasTarget = true;
+      }
+   }
+
+   if (command.depthTarget) {
+      width = std::min(width, command.depthTarget->pitch);
+      height = std::min(height, command.depthTarget->height);
+      hasTarget = true;
+   }
+
+   if (!hasTarget) {
+      width = 0;
+      height = 0;
+   }
+
+   auto pa_sc_generic_scissor_tl = ctx.getRegister<latte::PA_SC_GENERIC_SCISSOR_TL>(latte::Register::PA_SC_GENERIC_SCISSOR_TL);
+   auto pa_sc_generic_scissor_br = ctx.getRegister<latte::PA_SC_GENERIC_SCISSOR_BR>(latte::Register::PA_SC_GENERIC_SCISSOR_BR);
+   auto pa_sc_screen_scissor_tl = ctx.getRegister<latte::PA_SC_SCREEN_SCISSOR_TL>(latte::Register::PA_SC_SCREEN_SCISSOR_TL);
+   auto pa_sc_screen_scissor_br = ctx.getRegister<latte::PA_SC_SCREEN_SCISSOR_BR>(latte::Register::PA_SC_SCREEN_SCISSOR_BR);
+
+   ctx.scissorMinX = static_cast<int32_t>(std::max(pa_sc_generic_scissor_tl.TL_X(), pa_sc_screen_scissor_tl.TL_X()));
+   ctx.scissorMinY = static_cast<int32_t>(std::max(pa_sc_generic_scissor_tl.TL_Y(), pa_sc_screen_scissor_tl.TL_Y()));
+   ctx.scissorMaxX = static_cast<int32_t>(std::min({ pa_sc_generic_scissor_br.BR_X(), pa_sc_screen_scissor_br.BR_X(), width }));
+   ctx.scissorMaxY = static_cast<int32_t>(std::min({ pa_sc_generic_scissor_br.BR_Y(), pa_sc_screen_scissor_br.BR_Y(), height }));
+
+   ctx.tilesX = (width + TileSize - 1) / TileSize;
+   ctx.tilesY = (height + TileSize - 1) / TileSize;
+
+   // Match pixel shader inputs to vertex shader exports by semantic
+   auto spi_ps_in_control_0 = ctx.getRegister<latte::SPI_PS_IN_CONTROL_0>(latte::Register::SPI_PS_IN_CONTROL_0);
+   auto spi_ps_in_control_1 = ctx.getRegister<latte::SPI_PS_IN_CONTROL_1>(latte::Register::SPI_PS_IN_CONTROL_1);
+   std::array<uint8_t, MaxParams> vsSemantics;
+   vsSemantics.fill(0xFF);
+
+   for (auto i = 0u; i < ctx.numParams; ++i) {
+      auto spi_vs_out_id = ctx.getRegister<latte::SPI_VS_OUT_ID_N>(latte::Register::SPI_VS_OUT_ID_0 + 4 * (i / 4));
+
+      switch (i % 4) {
+      case 0:
+         vsSemantics[i] = spi_vs_out_id.SEMANTIC_0();
+         break;
+      case 1:
+         vsSemantics[i] = spi_vs_out_id.SEMANTIC_1();
+         break;
+      case 2:
+         vsSemantics[i] = spi_vs_out_id.SEMANTIC_2();
+         break;
+      case 3:
+         vsSemantics[i] = spi_vs_out_id.SEMANTIC_3();
+         break;
+      }
+   }
+
+   ctx.numInputs = std::min(spi_ps_in_control_0.NUM_INTERP(), MaxParams);
+
+   for (auto i = 0u; i < ctx.numInputs; ++i) {
+      auto spi_ps_input_cntl = ctx.getRegister<latte::SPI_PS_INPUT_CNTL_N>(latte::Register::SPI_PS_INPUT_CNTL_0 + i * 4);
+      auto &input = ctx.inputs[i];
+      input.param = -1;
+      input.defaultValue = getDefaultValue(spi_ps_input_cntl.DEFAULT_VAL());
+      input.flat = spi_ps_input_cntl.FLAT_SHADE();
+      input.linear = spi_ps_input_cntl.SEL_LINEAR() || ctx.pa_su_sc_mode_cntl.PERSP_CORR_DIS();
+
+      for (auto j = 0u; j < ctx.numParams; ++j) {
+         if (vsSemantics[j] != 0xFF && vsSemantics[j] == spi_ps_input_cntl.SEMANTIC()) {
+            input.param = static_cast<int32_t>(j);
+            break;
+         }
+      }
+   }
+
+   ctx.positionEnable = spi_ps_in_control_0.POSITION_ENA();
+   ctx.positionAddr = spi_ps_in_control_0.POSITION_ADDR();
+   ctx.frontFaceEnable = spi_ps_in_control_1.FRONT_FACE_ENA();
+   ctx.frontFaceAddr = spi_ps_in_control_1.FRONT_FACE_ADDR();
+   ctx.frontFaceChan = spi_ps_in_control_1.FRONT_FACE_CHAN();
+   ctx.frontFaceAllBits = spi_ps_in_control_1.FRONT_FACE_ALL_BITS();
+
+   // Colour output
+   auto cb_target_mask = ctx.getRegister<latte::CB_TARGET_MASK>(latte::Register::CB_TARGET_MASK);
+   auto cb_shader_mask = ctx.getRegister<latte::CB_SHADER_MASK>(latte::Register::CB_SHADER_MASK);
+   auto cb_color_control = ctx.getRegister<latte::CB_COLOR_CONTROL>(latte::Register::CB_COLOR_CONTROL);
+
+   switch (cb_color_control.SPECIAL_OP()) {
+   case latte::CB_SPECIAL_OP::NORMAL:
+      ctx.colorMask = cb_target_mask.value & cb_shader_mask.value;
+      break;
+   case latte::CB_SPECIAL_OP::DISABLE:
+      ctx.colorMask = 0;
+      break;
+   default:
+      gLog->warn("Software rasteriser skipping draw with unsupported CB_SPECIAL_OP {}", cb_color_control.SPECIAL_OP());
+      return false;
+   }
+
+   for (auto i = 0u; i < latte::MaxRenderTargets; ++i) {
+      if (!command.colorTargets[i]) {
+         ctx.colorMask &= ~(0xF << (i * 4));
+      }
+
+      ctx.blendControl[i] = ctx.getRegister<latte::CB_BLENDN_CONTROL>(latte::Register::CB_BLEND0_CONTROL + i * 4);
+   }
+
+   ctx.blendEnable = cb_color_control.TARGET_BLEND_ENABLE();
+   ctx.blendConstant[0] = ctx.getRegister<latte::CB_BLEND_RED>(latte::Register::CB_BLEND_RED).BLEND_RED();
+   ctx.blendConstant[1] = ctx.getRegister<latte::CB_BLEND_GREEN>(latte::Register::CB_BLEND_GREEN).BLEND_GREEN();
+   ctx.blendConstant[2] = ctx.getRegister<latte::CB_BLEND_BLUE>(latte::Register::CB_BLEND_BLUE).BLEND_BLUE();
+   ctx.blendConstant[3] = ctx.getRegister<latte::CB_BLEND_ALPHA>(latte::Register::CB_BLEND_ALPHA).BLEND_ALPHA();
+
+   auto sx_alpha_test_control = ctx.getRegister<latte::SX_ALPHA_TEST_CONTROL>(latte::Register::SX_ALPHA_TEST_CONTROL);
+   ctx.alphaTest = sx_alpha_test_control.ALPHA_TEST_ENABLE() && !sx_alpha_test_control.ALPHA_TEST_BYPASS();
+   ctx.alphaFunc = sx_alpha_test_control.ALPHA_FUNC();
+   ctx.alphaRef = ctx.getRegister<latte::SX_ALPHA_REF>(latte::Register::SX_ALPHA_REF).ALPHA_REF();
+
+   // Depth and stencil
+   auto db_depth_control = ctx.getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
+   auto db_shader_control = ctx.getRegister<latte::DB_SHADER_CONTROL>(latte::Register::DB_SHADER_CONTROL);
+   auto db_stencilrefmask = ctx.getRegister<latte::DB_STENCILREFMASK>(latte::Register::DB_STENCILREFMASK);
+   auto db_stencilrefmask_bf = ctx.getRegister<latte::DB_STENCILREFMASK>(latte::Register::DB_STENCILREFMASK_BF);
+
+   ctx.depthSurface = command.depthTarget;
+   ctx.depthEnable = ctx.depthSurface && db_depth_control.Z_ENABLE();
+   ctx.depthWrite = ctx.depthEnable && db_depth_control.Z_WRITE_ENABLE();
+   ctx.depthFunc = db_depth_control.ZFUNC();
+   ctx.stencilEnable = ctx.depthSurface && db_depth_control.STENCIL_ENABLE() && hasStencil(ctx.depthSurface->depthFormat);
+
+   ctx.stencilFront.func = db_depth_control.STENCILFUNC();
+   ctx.stencilFront.fail = db_depth_control.STENCILFAIL();
+   ctx.stencilFront.zpass = db_depth_control.STENCILZPASS();
+   ctx.stencilFront.zfail = db_depth_control.STENCILZFAIL();
+   ctx.stencilFront.ref = static_cast<uint8_t>(db_stencilrefmask.STENCILREF());
+   ctx.stencilFront.mask = static_cast<uint8_t>(db_stencilrefmask.STENCILMASK());
+   ctx.stencilFront.writeMask = static_cast<uint8_t>(db_stencilrefmask.STENCILWRITEMASK());
+
+   if (db_depth_control.BACKFACE_ENABLE()) {
+      ctx.stencilBack.func = db_depth_control.STENCILFUNC_BF();
+      ctx.stencilBack.fail = db_depth_control.STENCILFAIL_BF();
+      ctx.stencilBack.zpass = db_depth_control.STENCILZPASS_BF();
+      ctx.stencilBack.zfail = db_depth_control.STENCILZFAIL_BF();
+      ctx.stencilBack.ref = static_cast<uint8_t>(db_stencilrefmask_bf.STENCILREF());
+      ctx.stencilBack.mask = static_cast<uint8_t>(db_stencilrefmask_bf.STENCILMASK());
+      ctx.stencilBack.writeMask = static_cast<uint8_t>(db_stencilrefmask_bf.STENCILWRITEMASK());
+   } else {
+      ctx.stencilBack = ctx.stencilFront;
+   }
+
+   ctx.exportsDepth = db_shader_control.Z_EXPORT_ENABLE();
+   ctx.dualSource = db_shader_control.DUAL_EXPORT_ENABLE();
+
+   // Without kill, alpha test or depth export the pixel shader cannot
+   //  change the depth test result so we can test before shading.
+   ctx.earlyDepth = !ctx.exportsDepth && !db_shader_control.KILL_ENABLE() && !ctx.alphaTest;
+   ctx.shadePixels = ctx.colorMask || !ctx.earlyDepth;
+   return true;
+}
+
+static void
+assembleStrip(DrawContext &ctx,
+              uint32_t first,
+              uint32_t count)
+{
+   auto &slots = ctx.elementSlots;
+   auto provokingLast = ctx.pa_su_sc_mode_cntl.PROVOKING_VTX_LAST();
+
+   auto addPoint = [&](uint32_t a) {
+      ctx.primitives.push_back({ PrimitiveKind::Point, { slots[a], slots[a], slots[a] }, slots[a] });
+   };
+
+   auto addLine = [&](uint32_t a, uint32_t b) {
+      ctx.primitives.push_back({ PrimitiveKind::Line, { slots[a], slots[b], slots[b] }, provokingLast ? slots[b] : slots[a] });
+   };
+
+   auto addTriangle = [&](uint32_t a, uint32_t b, uint32_t c) {
+      ctx.primitives.push_back({ PrimitiveKind::Triangle, { slots[a], slots[b], slots[c] }, provokingLast ? slots[c] : slots[a] });
+   };
+
+   switch (ctx.primType) {
+   case latte::VGT_DI_PRIMITIVE_TYPE::POINTLIST:
+      for (auto i = 0u; i < count; ++i) {
+         addPoint(first + i);
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINELIST:
+      for (auto i = 0u; i + 1 < count; i += 2) {
+         addLine(first + i, first + i + 1);
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINESTRIP:
+      for (auto i = 0u; i + 1 < count; ++i) {
+         addLine(first + i, first + i + 1);
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINELOOP:
+      for (auto i = 0u; i + 1 < count; ++i) {
+         addLine(first + i, first + i + 1);
+      }
+
+      if (count > 2) {
+         addLine(first + count - 1, first);
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRILIST:
+      for (auto i = 0u; i + 2 < count; i += 3) {
+         addTriangle(first + i, first + i + 1, first + i + 2);
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRISTRIP:
+      for (auto i = 0u; i + 2 < count; ++i) {
+         if (i & 1) {
+            addTriangle(first + i + 1, first + i, first + i + 2);
+         } else {
+            addTriangle(first + i, first + i + 1, first + i + 2);
+         }
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRIFAN:
+      for (auto i = 1u; i + 1 < count; ++i) {
+         addTriangle(first, first + i, first + i + 1);
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST:
+      for (auto i = 0u; i + 3 < count; i += 4) {
+         addTriangle(first + i, first + i + 1, first + i + 2);
+         addTriangle(first + i, first + i + 2, first + i + 3);
+      }
+      break;
+   case latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST:
+      // Same winding as the OpenGL driver uses for rectangles
+      for (auto i = 0u; i + 3 < count; i += 4) {
+         addTriangle(first + i, first + i + 1, first + i + 2);
+         addTriangle(first + i + 2, first + i + 1, first + i + 3);
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+static bool
+assemblePrimitives(DrawContext &ctx)
+{
+   switch (ctx.primType) {
+   case latte::VGT_DI_PRIMITIVE_TYPE::POINTLIST:
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINELIST:
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINESTRIP:
+   case latte::VGT_DI_PRIMITIVE_TYPE::LINELOOP:
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRILIST:
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRISTRIP:
+   case latte::VGT_DI_PRIMITIVE_TYPE::TRIFAN:
+   case latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST:
+   case latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST:
+      break;
+   default:
+      gLog->warn("Software rasteriser skipping draw with unsupported primitive type {}", ctx.primType);
+      return false;
+   }
+
+   // Assemble the first instance and then offset the vertex slots for
+   //  the remaining instances.
+   auto count = static_cast<uint32_t>(ctx.elementSlots.size());
+   auto first = 0u;
+
+   for (auto i = 0u; i <= count; ++i) {
+      if (i == count || ctx.elementSlots[i] == RestartSlot) {
+         if (i > first) {
+            assembleStrip(ctx, first, i - first);
+         }
+
+         first = i + 1;
+      }
+   }
+
+   auto numPrimitives = ctx.primitives.size();
+   auto numVertices = static_cast<uint32_t>(ctx.vertexIds.size());
+
+   for (auto instance = 1u; instance < ctx.numInstances; ++instance) {
+      for (auto i = 0u; i < numPrimitives; ++i) {
+         auto primitive = ctx.primitives[i];
+
+         for (auto &vertex : primitive.vertices) {
+            vertex += instance * numVertices;
+         }
+
+         primitive.provoking += instance * numVertices;
+         ctx.primitives.push_back(primitive);
+      }
+   }
+
+   return true;
+}
+
+Rasteriser::Rasteriser(uint32_t numThreads) :
+   mPool(numThreads, "SW Rasteriser")
+{
+   for (auto i = 0u; i < mPool.getNumWorkers(); ++i) {
+      mShaderStates.emplace_back(new ShaderState { });
+   }
+}
+
+Rasteriser::~Rasteriser()
+{
+}
+
+void
+Rasteriser::reportError(const std::string &error)
+{
+   std::unique_lock<std::mutex> lock { mErrorMutex };
+
+   if (mReportedErrors.insert(error).second) {
+      gLog->error("Software rasteriser: {}", error);
+   }
+}
+
+uint64_t
+Rasteriser::draw(const DrawCommand &command)
+{
+   DrawContext ctx { command };
+
+   if (!command.vertexShader || !command.count) {
+      return 0;
+   }
+
+   if (!setupDrawState(ctx)) {
+      return 0;
+   }
+
+   // Collect the unique vertices used by this draw so each is only shaded
+   //  once per instance.
+   auto vgt_multi_prim_ib_reset_en = ctx.getRegister<latte::VGT_MULTI_PRIM_IB_RESET_EN>(latte::Register::VGT_MULTI_PRIM_IB_RESET_EN);
+   auto vgt_multi_prim_ib_reset_indx = ctx.getRegister<latte::VGT_MULTI_PRIM_IB_RESET_INDX>(latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX);
+   auto restartEnable = command.indices && vgt_multi_prim_ib_reset_en.RESET_EN();
+   auto restartIndex = vgt_multi_prim_ib_reset_indx.RESET_INDX();
+
+   ctx.elementSlots.resize(command.count);
+
+   if (command.indices) {
+      ctx.vertexIds.reserve(command.count);
+
+      for (auto i = 0u; i < command.count; ++i) {
+         if (!restartEnable || command.indices[i] != restartIndex) {
+            ctx.vertexIds.push_back(command.indices[i]);
+         }
+      }
+
+      std::sort(ctx.vertexIds.begin(), ctx.vertexIds.end());
+      ctx.vertexIds.erase(std::unique(ctx.vertexIds.begin(), ctx.vertexIds.end()), ctx.vertexIds.end());
+
+      for (auto i = 0u; i < command.count; ++i) {
+         if (restartEnable && command.indices[i] == restartIndex) {
+            ctx.elementSlots[i] = RestartSlot;
+         } else {
+            auto itr = std::lower_bound(ctx.vertexIds.begin(), ctx.vertexIds.end(), command.indices[i]);
+            ctx.elementSlots[i] = static_cast<uint32_t>(itr - ctx.vertexIds.begin());
+         }
+      }
+   } else {
+      ctx.vertexIds.resize(command.count);
+
+      for (auto i = 0u; i < command.count; ++i) {
+         ctx.vertexIds[i] = i;
+         ctx.elementSlots[i] = i;
+      }
+   }
+
+   shadeVertices(ctx);
+
+   if (ctx.failed) {
+      return 0;
+   }
+
+   if (!command.pixelShader
+    || ctx.pa_cl_clip_cntl.RASTERISER_DISABLE()
+    || !ctx.tilesX || !ctx.tilesY
+    || ctx.scissorMinX >= ctx.scissorMaxX
+    || ctx.scissorMinY >= ctx.scissorMaxY) {
+      return 0;
+   }
+
+   if (!assemblePrimitives(ctx)) {
+      return 0;
+   }
+
+   setupPrimitives(ctx);
+   binPrimitives(ctx);
+
+   // Mark everything we may write as needing to be stored back to memory
+   for (auto i = 0u; i < latte::MaxRenderTargets; ++i) {
+      if (command.colorTargets[i] && (ctx.colorMask & (0xF << (i * 4)))) {
+         command.colorTargets[i]->dirty = true;
+      }
+   }
+
+   if (ctx.depthSurface && (ctx.depthWrite || ctx.stencilEnable)) {
+      ctx.depthSurface->dirty = true;
+   }
+
+   mPool.run(ctx.tilesX * ctx.tilesY, [&](uint32_t tile, uint32_t worker) {
+      rasteriseTile(ctx, tile, worker);
+   });
+
+   return ctx.samplesPassed;
+}
+
+void
+Rasteriser::shadeVertices(DrawContext &ctx)
+{
+   auto numVertices = static_cast<uint32_t>(ctx.vertexIds.size());
+   auto numSlots = numVertices * ctx.numInstances;
+   auto numBatches = (numSlots + VertexBatchSize - 1) / VertexBatchSize;
+
+   ctx.positions.resize(numSlots);
+   ctx.vertexParams.resize(static_cast<size_t>(numSlots) * ctx.numParams);
+
+   mPool.run(numBatches, [&](uint32_t batch, uint32_t worker) {
+      auto &state = *mShaderStates[worker];
+      auto error = std::string { };
+      auto end = std::min(numSlots, (batch + 1) * VertexBatchSize);
+
+      for (auto slot = batch * VertexBatchSize; slot < end; ++slot) {
+         if (ctx.failed) {
+            return;
+         }
+
+         auto instance = slot / numVertices;
+         auto vertexId = ctx.vertexIds[slot % numVertices];
+
+         state.vertexId = vertexId;
+         state.instanceId = instance;
+         state.gpr[0] = { vertexId, instance / ctx.stepRate0, instance / ctx.stepRate1, instance };
+         state.position[0] = { 0, 0, 0, asUint(1.0f) };
+
+         if (!runShader(*ctx.command.vertexShader, state, error)) {
+            reportError(error);
+            ctx.failed = true;
+            return;
+         }
+
+         auto &position = ctx.positions[slot];
+
+         for (auto c = 0u; c < 4; ++c) {
+            position[c] = asFloat(state.position[0][c]);
+         }
+
+         std::copy(state.params.begin(), state.params.begin() + ctx.numParams,
+                   ctx.vertexParams.begin() + static_cast<size_t>(slot) * ctx.numParams);
+      }
+   });
+}
+
+//! Clip a convex polygon against the plane dot(plane, position) >= 0.
+static uint32_t
+clipPolygon(const ClipVertex *input,
+            uint32_t count,
+            ClipVertex *output,
+            const std::array<float, 4> &plane)
+{
+   auto distance = [&](const ClipVertex &v) {
+      return plane[0] * v.position[0] + plane[1] * v.position[1] + plane[2] * v.position[2] + plane[3] * v.position[3];
+   };
+
+   auto numOutput = 0u;
+
+   for (auto i = 0u; i < count; ++i) {
+      auto &a = input[i];
+      auto &b = input[(i + 1) % count];
+      auto da = distance(a);
+      auto db = distance(b);
+
+      if (da >= 0.0f) {
+         output[numOutput++] = a;
+      }
+
+      if ((da >= 0.0f) != (db >= 0.0f)) {
+         auto t = da / (da - db);
+         auto &v = output[numOutput++];
+
+         for (auto c = 0u; c < 4; ++c) {
+            v.position[c] = a.position[c] + t * (b.position[c] - a.position[c]);
+         }
+
+         for (auto c = 0u; c < 3; ++c) {
+            v.weights[c] = a.weights[c] + t * (b.weights[c] - a.weights[c]);
+         }
+      }
+   }
+
+   return numOutput;
+}
+
+static void
+getClipPlanes(const DrawContext &ctx,
+              std::vector<std::array<float, 4>> &planes)
+{
+   planes.clear();
+
+   // Always keep w positive so the perspective divide is safe
+   planes.push_back({ 0.0f, 0.0f, 0.0f, 1.0f });
+
+   if (ctx.screenSpace || ctx.pa_cl_clip_cntl.CLIP_DISABLE()) {
+      return;
+   }
+
+   if (!ctx.pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE()) {
+      if (ctx.pa_cl_clip_cntl.DX_CLIP_SPACE_DEF()) {
+         planes.push_back({ 0.0f, 0.0f, 1.0f, 0.0f });
+      } else {
+         planes.push_back({ 0.0f, 0.0f, 1.0f, 1.0f });
+      }
+   }
+
+   if (!ctx.pa_cl_clip_cntl.ZCLIP_FAR_DISABLE()) {
+      planes.push_back({ 0.0f, 0.0f, -1.0f, 1.0f });
+   }
+
+   planes.push_back({ 1.0f, 0.0f, 0.0f, GuardBand });
+   planes.push_back({ -1.0f, 0.0f, 0.0f, GuardBand });
+   planes.push_back({ 0.0f, 1.0f, 0.0f, GuardBand });
+   planes.push_back({ 0.0f, -1.0f, 0.0f, GuardBand });
+}
+
+static WindowVertex
+toWindow(const DrawContext &ctx,
+         const ClipVertex &v)
+{
+   auto result = WindowVertex { };
+   auto w = std::max(v.position[3], MinClipW);
+   auto invW = 1.0f / w;
+   auto x = v.position[0];
+   auto y = v.position[1];
+   auto z = v.position[2];
+
+   if (ctx.screenSpace) {
+      // Rectangles are given in window coordinates
+      result.x = x * invW;
+      result.y = y * invW;
+      result.z = z * invW * ctx.viewportScale[2] + ctx.viewportOffset[2];
+   } else {
+      if (!ctx.pa_cl_vte_cntl.VTX_XY_FMT()) {
+         x *= invW;
+         y *= invW;
+      }
+
+      if (!ctx.pa_cl_vte_cntl.VTX_Z_FMT()) {
+         z *= invW;
+      }
+
+      result.x = x * ctx.viewportScale[0] + ctx.viewportOffset[0];
+      result.y = y * ctx.viewportScale[1] + ctx.viewportOffset[1];
+      result.z = z * ctx.viewportScale[2] + ctx.viewportOffset[2];
+   }
+
+   result.invW = ctx.pa_cl_vte_cntl.VTX_W0_FMT() ? v.position[3] : invW;
+   result.weights = v.weights;
+   return result;
+}
+
+static void
+emitTriangle(DrawContext &ctx,
+             PrimitiveBatch &batch,
+             const Primitive &primitive,
+             WindowVertex v0,
+             WindowVertex v1,
+             WindowVertex v2,
+             bool applyCulling)
+{
+   auto area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+
+   if (!(area != 0.0f) || !std::isfinite(area)) {
+      return;
+   }
+
+   // Window y points down, so a negative area is counter clockwise
+   auto frontFacing = true;
+
+   if (applyCulling) {
+      auto counterClockwise = (area < 0.0f);
+      auto mode = ctx.pa_su_sc_mode_cntl;
+      frontFacing = (mode.FACE() == latte::PA_FACE::CCW) ? counterClockwise : !counterClockwise;
+
+      if ((frontFacing && mode.CULL_FRONT()) || (!frontFacing && mode.CULL_BACK())) {
+         return;
+      }
+   }
+
+   if (area < 0.0f) {
+      std::swap(v1, v2);
+      area = -area;
+   }
+
+   auto minX = std::min({ v0.x, v1.x, v2.x });
+   auto minY = std::min({ v0.y, v1.y, v2.y });
+   auto maxX = std::max({ v0.x, v1.x, v2.x });
+   auto maxY = std::max({ v0.y, v1.y, v2.y });
+
+   auto triangle = Triangle { };
+   triangle.minX = static_cast<int32_t>(std::max(std::floor(minX), static_cast<float>(ctx.scissorMinX)));
+   triangle.minY = static_cast<int32_t>(std::max(std::floor(minY), static_cast<float>(ctx.scissorMinY)));
+   triangle.maxX = static_cast<int32_t>(std::min(std::ceil(maxX), static_cast<float>(ctx.scissorMaxX))) - 1;
+   triangle.maxY = static_cast<int32_t>(std::min(std::ceil(maxY), static_cast<float>(ctx.scissorMaxY))) - 1;
+
+   if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+      return;
+   }
+
+   const WindowVertex *vertices[] = { &v0, &v1, &v2 };
+
+   for (auto i = 0u; i < 3; ++i) {
+      triangle.x[i] = vertices[i]->x;
+      triangle.y[i] = vertices[i]->y;
+      triangle.z[i] = vertices[i]->z;
+      triangle.invW[i] = vertices[i]->invW;
+   }
+
+   triangle.area = area;
+   triangle.frontFacing = frontFacing;
+   triangle.paramOffset = static_cast<uint32_t>(batch.params.size());
+
+   // Resolve the pixel shader inputs for each vertex
+   for (auto i = 0u; i < 3; ++i) {
+      auto &weights = vertices[i]->weights;
+
+      for (auto j = 0u; j < ctx.numInputs; ++j) {
+         auto &input = ctx.inputs[j];
+
+         if (input.param < 0) {
+            batch.params.push_back(input.defaultValue);
+         } else if (input.flat) {
+            batch.params.push_back(ctx.vertexParams[primitive.provoking * ctx.numParams + input.param]);
+         } else {
+            auto value = Vec4 { };
+
+            for (auto c = 0u; c < 4; ++c) {
+               auto sum = 0.0f;
+
+               for (auto k = 0u; k < 3; ++k) {
+                  if (weights[k] != 0.0f) {
+                     sum += weights[k] * asFloat(ctx.vertexParams[primitive.vertices[k] * ctx.numParams + input.param][c]);
+                  }
+               }
+
+               value[c] = asUint(sum);
+            }
+
+            batch.params.push_back(value);
+         }
+      }
+   }
+
+   batch.triangles.push_back(triangle);
+}
+
+static void
+setupTriangle(DrawContext &ctx,
+              PrimitiveBatch &batch,
+              const Primitive &primitive,
+              const std::vector<std::array<float, 4>> &planes)
+{
+   ClipVertex buffers[2][16];
+   auto count = 3u;
+   auto inside = true;
+
+   for (auto i = 0u; i < 3; ++i) {
+      auto &v = buffers[0][i];
+      v.position = ctx.positions[primitive.vertices[i]];
+      v.weights = { 0.0f, 0.0f, 0.0f };
+      v.weights[i] = 1.0f;
+   }
+
+   // Most triangles need no clipping at all
+   for (auto &plane : planes) {
+      for (auto i = 0u; i < 3; ++i) {
+         auto &p = buffers[0][i].position;
+
+         if (plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3] * p[3] < 0.0f) {
+            inside = false;
+         }
+      }
+   }
+
+   auto current = 0u;
+
+   if (!inside) {
+      for (auto &plane : planes) {
+         count = clipPolygon(buffers[current], count, buffers[current ^ 1], plane);
+         current ^= 1;
+
+         if (count < 3) {
+            return;
+         }
+      }
+   }
+
+   auto v0 = toWindow(ctx, buffers[current][0]);
+
+   for (auto i = 1u; i + 1 < count; ++i) {
+      emitTriangle(ctx, batch, primitive, v0,
+                   toWindow(ctx, buffers[current][i]),
+                   toWindow(ctx, buffers[current][i + 1]),
+                   true);
+   }
+}
+
+static void
+setupLine(DrawContext &ctx,
+          PrimitiveBatch &batch,
+          const Primitive &primitive,
+          const std::vector<std::array<float, 4>> &planes)
+{
+   ClipVertex v[2];
+
+   for (auto i = 0u; i < 2; ++i) {
+      v[i].position = ctx.positions[primitive.vertices[i]];
+      v[i].weights = { 0.0f, 0.0f, 0.0f };
+      v[i].weights[i] = 1.0f;
+   }
+
+   // Clip the end points against each plane
+   auto t0 = 0.0f;
+   auto t1 = 1.0f;
+
+   for (auto &plane : planes) {
+      auto d0 = plane[0] * v[0].position[0] + plane[1] * v[0].position[1] + plane[2] * v[0].position[2] + plane[3] * v[0].position[3];
+      auto d1 = plane[0] * v[1].position[0] + plane[1] * v[1].position[1] + plane[2] * v[1].position[2] + plane[3] * v[1].position[3];
+
+      if (d0 < 0.0f && d1 < 0.0f) {
+         return;
+      } else if (d0 < 0.0f) {
+         t0 = std::max(t0, d0 / (d0 - d1));
+      } else if (d1 < 0.0f) {
+         t1 = std::min(t1, d0 / (d0 - d1));
+      }
+   }
+
+   if (t0 >= t1) {
+      return;
+   }
+
+   ClipVertex clipped[2];
+
+   for (auto i = 0u; i < 2; ++i) {
+      auto t = i ? t1 : t0;
+
+      for (auto c = 0u; c < 4; ++c) {
+         clipped[i].position[c] = v[0].position[c] + t * (v[1].position[c] - v[0].position[c]);
+      }
+
+      clipped[i].weights = { 1.0f - t, t, 0.0f };
+   }
+
+   auto a = toWindow(ctx, clipped[0]);
+   auto b = toWindow(ctx, clipped[1]);
+
+   // Expand to a one pixel wide quad
+   auto dx = b.x - a.x;
+   auto dy = b.y - a.y;
+   auto length = std::sqrt(dx * dx + dy * dy);
+
+   if (length == 0.0f) {
+      return;
+   }
+
+   auto nx = -dy / length * 0.5f;
+   auto ny = dx / length * 0.5f;
+
+   auto a0 = a, a1 = a, b0 = b, b1 = b;
+   a0.x += nx; a0.y += ny;
+   a1.x -= nx; a1.y -= ny;
+   b0.x += nx; b0.y += ny;
+   b1.x -= nx; b1.y -= ny;
+
+   emitTriangle(ctx, batch, primitive, a0, a1, b0, false);
+   emitTriangle(ctx, batch, primitive, a1, b1, b0, false);
+}
+
+static void
+setupPoint(DrawContext &ctx,
+           PrimitiveBatch &batch,
+           const Primitive &primitive,
+           const std::vector<std::array<float, 4>> &planes)
+{
+   auto v = ClipVertex { };
+   v.position = ctx.positions[primitive.vertices[0]];
+   v.weights = { 1.0f, 0.0f, 0.0f };
+
+   for (auto &plane : planes) {
+      auto &p = v.position;
+
+      if (plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3] * p[3] < 0.0f) {
+         return;
+      }
+   }
+
+   auto centre = toWindow(ctx, v);
+   auto tl = centre, tr = centre, bl = centre, br = centre;
+   tl.x -= ctx.pointHalfWidth; tl.y -= ctx.pointHalfHeight;
+   tr.x += ctx.pointHalfWidth; tr.y -= ctx.pointHalfHeight;
+   bl.x -= ctx.pointHalfWidth; bl.y += ctx.pointHalfHeight;
+   br.x += ctx.pointHalfWidth; br.y += ctx.pointHalfHeight;
+
+   emitTriangle(ctx, batch, primitive, tl, bl, tr, false);
+   emitTriangle(ctx, batch, primitive, tr, bl, br, false);
+}
+
+void
+Rasteriser::setupPrimitives(DrawContext &ctx)
+{
+   auto numPrimitives = static_cast<uint32_t>(ctx.primitives.size());
+   auto numBatches = (numPrimitives + PrimitiveBatchSize - 1) / PrimitiveBatchSize;
+   std::vector<std::array<float, 4>> planes;
+   getClipPlanes(ctx, planes);
+
+   ctx.batches.resize(numBatches);
+
+   mPool.run(numBatches, [&](uint32_t index, uint32_t worker) {
+      auto &batch = ctx.batches[index];
+      auto end = std::min(numPrimitives, (index + 1) * PrimitiveBatchSize);
+
+      for (auto i = index * PrimitiveBatchSize; i < end; ++i) {
+         auto &primitive = ctx.primitives[i];
+
+         switch (primitive.kind) {
+         case PrimitiveKind::Point:
+            setupPoint(ctx, batch, primitive, planes);
+            break;
+         case PrimitiveKind::Line:
+            setupLine(ctx, batch, primitive, planes);
+            break;
+         case PrimitiveKind::Triangle:
+            setupTriangle(ctx, batch, primitive, planes);
+            break;
+         }
+      }
+   });
+}
+
+void
+Rasteriser::binPrimitives(DrawContext &ctx)
+{
+   ctx.bins.resize(ctx.tilesX * ctx.tilesY);
+
+   // Binning in submission order keeps every tile in API order
+   for (auto &batch : ctx.batches) {
+      for (auto &triangle : batch.triangles) {
+         triangle.params = batch.params.data() + triangle.paramOffset;
+
+         auto tileMinX = static_cast<uint32_t>(triangle.minX) / TileSize;
+         auto tileMinY = static_cast<uint32_t>(triangle.minY) / TileSize;
+         auto tileMaxX = std::min(static_cast<uint32_t>(triangle.maxX) / TileSize, ctx.tilesX - 1);
+         auto tileMaxY = std::min(static_cast<uint32_t>(triangle.maxY) / TileSize, ctx.tilesY - 1);
+
+         for (auto ty = tileMinY; ty <= tileMaxY; ++ty) {
+            for (auto tx = tileMinX; tx <= tileMaxX; ++tx) {
+               ctx.bins[ty * ctx.tilesX + tx].push_back(&triangle);
+            }
+         }
+      }
+   }
+}
+
+static uint8_t
+applyStencilOp(latte::DB_STENCIL_FUNC op,
+               uint8_t value,
+               uint8_t ref)
+{
+   switch (op) {
+   case latte::DB_STENCIL_FUNC::KEEP:
+      return value;
+   case latte::DB_STENCIL_FUNC::ZERO:
+      return 0;
+   case latte::DB_STENCIL_FUNC::REPLACE:
+      return ref;
+   case latte::DB_STENCIL_FUNC::INCR_CLAMP:
+      return value == 0xFF ? value : static_cast<uint8_t>(value + 1);
+   case latte::DB_STENCIL_FUNC::DECR_CLAMP:
+      return value == 0 ? value : static_cast<uint8_t>(value - 1);
+   case latte::DB_STENCIL_FUNC::INVERT:
+      return static_cast<uint8_t>(~value);
+   case latte::DB_STENCIL_FUNC::INCR_WRAP:
+      return static_cast<uint8_t>(value + 1);
+   case latte::DB_STENCIL_FUNC::DECR_WRAP:
+      return static_cast<uint8_t>(value - 1);
+   default:
+      return value;
+   }
+}
+
+//! Run the depth and stencil tests for one pixel and update the depth
+//  buffer, returns whether the pixel survived.
+static bool
+testDepthStencil(DrawContext &ctx,
+                 uint32_t x,
+                 uint32_t y,
+                 float depth,
+                 bool frontFacing)
+{
+   auto surface = ctx.depthSurface;
+
+   if (!surface) {
+      return true;
+   }
+
+   auto &face = frontFacing ? ctx.stencilFront : ctx.stencilBack;
+   auto stencil = uint8_t { 0 };
+
+   if (ctx.stencilEnable) {
+      stencil = readStencil(*surface, x, y);
+
+      auto ref = static_cast<float>(face.ref & face.mask);
+      auto value = static_cast<float>(stencil & face.mask);
+
+      if (!compareDepth(face.func, ref, value)) {
+         auto result = applyStencilOp(face.fail, stencil, face.ref);
+         writeStencil(*surface, x, y, static_cast<uint8_t>((stencil & ~face.writeMask) | (result & face.writeMask)));
+         return false;
+      }
+   }
+
+   auto depthPass = true;
+
+   if (ctx.depthEnable) {
+      depth = quantiseDepth(*surface, depth);
+      depthPass = compareDepth(ctx.depthFunc, depth, readDepth(*surface, x, y));
+   }
+
+   if (ctx.stencilEnable) {
+      auto result = applyStencilOp(depthPass ? face.zpass : face.zfail, stencil, face.ref);
+      writeStencil(*surface, x, y, static_cast<uint8_t>((stencil & ~face.writeMask) | (result & face.writeMask)));
+   }
+
+   if (!depthPass) {
+      return false;
+   }
+
+   if (ctx.depthWrite) {
+      writeDepth(*surface, x, y, depth);
+   }
+
+   return true;
+}
+
+static float
+getBlendFactor(latte::CB_BLEND_FUNC func,
+               uint32_t channel,
+               const float *src,
+               const float *src1,
+               const float *dst,
+               const float *constant)
+{
+   switch (func) {
+   case latte::CB_BLEND_FUNC::ZERO:
+      return 0.0f;
+   case latte::CB_BLEND_FUNC::ONE:
+      return 1.0f;
+   case latte::CB_BLEND_FUNC::SRC_COLOR:
+      return src[channel];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_SRC_COLOR:
+      return 1.0f - src[channel];
+   case latte::CB_BLEND_FUNC::SRC_ALPHA:
+   case latte::CB_BLEND_FUNC::BOTH_SRC_ALPHA:
+      return src[3];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_SRC_ALPHA:
+   case latte::CB_BLEND_FUNC::BOTH_INV_SRC_ALPHA:
+      return 1.0f - src[3];
+   case latte::CB_BLEND_FUNC::DST_ALPHA:
+      return dst[3];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_DST_ALPHA:
+      return 1.0f - dst[3];
+   case latte::CB_BLEND_FUNC::DST_COLOR:
+      return dst[channel];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_DST_COLOR:
+      return 1.0f - dst[channel];
+   case latte::CB_BLEND_FUNC::SRC_ALPHA_SATURATE:
+      return channel == 3 ? 1.0f : std::min(src[3], 1.0f - dst[3]);
+   case latte::CB_BLEND_FUNC::CONSTANT_COLOR:
+      return constant[channel];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_CONSTANT_COLOR:
+      return 1.0f - constant[channel];
+   case latte::CB_BLEND_FUNC::SRC1_COLOR:
+      return src1[channel];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_SRC1_COLOR:
+      return 1.0f - src1[channel];
+   case latte::CB_BLEND_FUNC::SRC1_ALPHA:
+      return src1[3];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_SRC1_ALPHA:
+      return 1.0f - src1[3];
+   case latte::CB_BLEND_FUNC::CONSTANT_ALPHA:
+      return constant[3];
+   case latte::CB_BLEND_FUNC::ONE_MINUS_CONSTANT_ALPHA:
+      return 1.0f - constant[3];
+   default:
+      return 0.0f;
+   }
+}
+
+static float
+combineBlend(latte::CB_COMB_FUNC func,
+             float src,
+             float srcFactor,
+             float dst,
+             float dstFactor)
+{
+   switch (func) {
+   case latte::CB_COMB_FUNC::DST_PLUS_SRC:
+      return src * srcFactor + dst * dstFactor;
+   case latte::CB_COMB_FUNC::SRC_MINUS_DST:
+      return src * srcFactor - dst * dstFactor;
+   case latte::CB_COMB_FUNC::MIN_DST_SRC:
+      return std::min(src, dst);
+   case latte::CB_COMB_FUNC::MAX_DST_SRC:
+      return std::max(src, dst);
+   case latte::CB_COMB_FUNC::DST_MINUS_SRC:
+      return dst * dstFactor - src * srcFactor;
+   default:
+      return src;
+   }
+}
+
+static void
+writeColor(DrawContext &ctx,
+           uint32_t target,
+           uint32_t x,
+           uint32_t y,
+           const ShaderState &state)
+{
+   auto &surface = *ctx.command.colorTargets[target];
+   auto mask = (ctx.colorMask >> (target * 4)) & 0xF;
+   auto element = getSurfaceElement(surface, x, y);
+   auto isInteger = (surface.format.numFormat == latte::SQ_NUM_FORMAT::INT);
+   auto blend = !isInteger && (ctx.blendEnable & (1 << target));
+   auto value = state.pixels[target];
+
+   if (!blend && mask == 0xF) {
+      packElement(element, surface.format, value);
+      return;
+   }
+
+   auto dst = unpackElement(element, surface.format);
+
+   if (blend) {
+      auto control = ctx.blendControl[target];
+      auto srcMin = (surface.format.formatComp == latte::SQ_FORMAT_COMP::SIGNED) ? -1.0f : 0.0f;
+      auto clampSource = (surface.format.numFormat == latte::SQ_NUM_FORMAT::NORM);
+      auto &src1Value = ctx.dualSource ? state.pixels[1] : state.pixels[target];
+      float src[4], src1[4], dstf[4];
+
+      for (auto c = 0u; c < 4; ++c) {
+         src[c] = asFloat(value[c]);
+         src1[c] = asFloat(src1Value[c]);
+         dstf[c] = asFloat(dst[c]);
+
+         if (clampSource) {
+            src[c] = std::min(std::max(src[c], srcMin), 1.0f);
+            src1[c] = std::min(std::max(src1[c], srcMin), 1.0f);
+         }
+      }
+
+      auto alphaSrcBlend = control.SEPARATE_ALPHA_BLEND() ? control.ALPHA_SRCBLEND() : control.COLOR_SRCBLEND();
+      auto alphaDstBlend = control.SEPARATE_ALPHA_BLEND() ? control.ALPHA_DESTBLEND() : control.COLOR_DESTBLEND();
+      auto alphaComb = control.SEPARATE_ALPHA_BLEND() ? control.ALPHA_COMB_FCN() : control.COLOR_COMB_FCN();
+
+      for (auto c = 0u; c < 4; ++c) {
+         auto srcBlend = (c == 3) ? alphaSrcBlend : control.COLOR_SRCBLEND();
+         auto dstBlend = (c == 3) ? alphaDstBlend : control.COLOR_DESTBLEND();
+         auto comb = (c == 3) ? alphaComb : control.COLOR_COMB_FCN();
+         auto srcFactor = getBlendFactor(srcBlend, c, src, src1, dstf, ctx.blendConstant.data());
+         auto dstFactor = getBlendFactor(dstBlend, c, src, src1, dstf, ctx.blendConstant.data());
+         value[c] = asUint(combineBlend(comb, src[c], srcFactor, dstf[c], dstFactor));
+      }
+   }
+
+   for (auto c = 0u; c < 4; ++c) {
+      if (!(mask & (1 << c))) {
+         value[c] = dst[c];
+      }
+   }
+
+   packElement(element, surface.format, value);
+}
+
+void
+Rasteriser::rasteriseTile(DrawContext &ctx,
+                          uint32_t tile,
+                          uint32_t worker)
+{
+   auto &state = *mShaderStates[worker];
+   auto &bin = ctx.bins[tile];
+   auto tileX0 = static_cast<int32_t>((tile % ctx.tilesX) * TileSize);
+   auto tileY0 = static_cast<int32_t>((tile / ctx.tilesX) * TileSize);
+   auto tileX1 = tileX0 + static_cast<int32_t>(TileSize) - 1;
+   auto tileY1 = tileY0 + static_cast<int32_t>(TileSize) - 1;
+   auto samplesPassed = uint64_t { 0 };
+   auto error = std::string { };
+
+   for (auto triangle : bin) {
+      if (ctx.failed) {
+         break;
+      }
+
+      auto &tri = *triangle;
+      auto minX = std::max(tri.minX, tileX0);
+      auto minY = std::max(tri.minY, tileY0);
+      auto maxX = std::min(tri.maxX, tileX1);
+      auto maxY = std::min(tri.maxY, tileY1);
+
+      // Edge i is opposite vertex i, E(p) = A * p.x + B * p.y + C
+      float edgeA[3], edgeB[3], edgeC[3];
+      bool topLeft[3];
+
+      for (auto i = 0u; i < 3; ++i) {
+         auto a = (i + 1) % 3;
+         auto b = (i + 2) % 3;
+         auto dx = tri.x[b] - tri.x[a];
+         auto dy = tri.y[b] - tri.y[a];
+         edgeA[i] = -dy;
+         edgeB[i] = dx;
+         edgeC[i] = dy * tri.x[a] - dx * tri.y[a];
+         topLeft[i] = (dy < 0.0f) || (dy == 0.0f && dx > 0.0f);
+      }
+
+      auto invArea = 1.0f / tri.area;
+
+      for (auto y = minY; y <= maxY; ++y) {
+         auto py = static_cast<float>(y) + 0.5f;
+
+         for (auto x = minX; x <= maxX; ++x) {
+            auto px = static_cast<float>(x) + 0.5f;
+            float w[3];
+            auto inside = true;
+
+            for (auto i = 0u; i < 3; ++i) {
+               w[i] = edgeA[i] * px + edgeB[i] * py + edgeC[i];
+
+               if (w[i] < 0.0f || (w[i] == 0.0f && !topLeft[i])) {
+                  inside = false;
+                  break;
+               }
+            }
+
+            if (!inside) {
+               continue;
+            }
+
+            // Screen space barycentrics for depth and linear inputs
+            float b[3] = { w[0] * invArea, w[1] * invArea, w[2] * invArea };
+            auto z = b[0] * tri.z[0] + b[1] * tri.z[1] + b[2] * tri.z[2];
+            z = std::min(std::max(z, ctx.zMin), ctx.zMax);
+
+            auto ux = static_cast<uint32_t>(x);
+            auto uy = static_cast<uint32_t>(y);
+
+            if (ctx.earlyDepth && !testDepthStencil(ctx, ux, uy, z, tri.frontFacing)) {
+               continue;
+            }
+
+            if (!ctx.shadePixels) {
+               ++samplesPassed;
+               continue;
+            }
+
+            // Perspective correct barycentrics
+            auto invW = b[0] * tri.invW[0] + b[1] * tri.invW[1] + b[2] * tri.invW[2];
+            float pb[3];
+
+            for (auto i = 0u; i < 3; ++i) {
+               pb[i] = (invW != 0.0f) ? b[i] * tri.invW[i] / invW : b[i];
+            }
+
+            for (auto i = 0u; i < ctx.numInputs; ++i) {
+               auto &input = ctx.inputs[i];
+               auto &gpr = state.gpr[i];
+
+               if (input.param < 0 || input.flat) {
+                  gpr = tri.params[i];
+                  continue;
+               }
+
+               auto weights = input.linear ? b : pb;
+               auto &p0 = tri.params[i];
+               auto &p1 = tri.params[ctx.numInputs + i];
+               auto &p2 = tri.params[2 * ctx.numInputs + i];
+
+               for (auto c = 0u; c < 4; ++c) {
+                  gpr[c] = asUint(weights[0] * asFloat(p0[c]) + weights[1] * asFloat(p1[c]) + weights[2] * asFloat(p2[c]));
+               }
+            }
+
+            if (ctx.positionEnable) {
+               state.gpr[ctx.positionAddr] = { asUint(px), asUint(py), asUint(z), asUint(invW) };
+            }
+
+            if (ctx.frontFaceEnable) {
+               auto value = ctx.frontFaceAllBits
+                  ? (tri.frontFacing ? 0xFFFFFFFFu : 0u)
+                  : asUint(tri.frontFacing ? 1.0f : -1.0f);
+               state.gpr[ctx.frontFaceAddr][ctx.frontFaceChan] = value;
+            }
+
+            if (!runShader(*ctx.command.pixelShader, state, error)) {
+               reportError(error);
+               ctx.failed = true;
+               break;
+            }
+
+            if (state.killed) {
+               continue;
+            }
+
+            if (ctx.alphaTest) {
+               auto alpha = asFloat(state.pixels[0][3]);
+
+               if (!(state.pixelExportMask & 1) || !compareDepth(ctx.alphaFunc, alpha, ctx.alphaRef)) {
+                  continue;
+               }
+            }
+
+            if (!ctx.earlyDepth) {
+               auto depth = (ctx.exportsDepth && state.depthExported) ? state.depth : z;
+
+               if (!testDepthStencil(ctx, ux, uy, depth, tri.frontFacing)) {
+                  continue;
+               }
+            }
+
+            ++samplesPassed;
+
+            for (auto i = 0u; i < latte::MaxRenderTargets; ++i) {
+               if ((ctx.colorMask & (0xF << (i * 4))) && (state.pixelExportMask & (1 << i))) {
+                  writeColor(ctx, i, ux, uy, state);
+               }
+            }
+         }
+
+         if (ctx.failed) {
+            break;
+         }
+      }
+   }
+
+   ctx.samplesPassed += samplesPassed;
+}
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,87 @@
+#pragma once
+#include "sw_shader.h"
+#include "sw_surface.h"
+#include "gpu/latte_constants.h"
+
+#include <array>
+#include <common/workerpool.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+//! Everything a draw needs which is not read straight from the registers.
+struct DrawCommand
+{
+   const uint32_t *registers = nullptr;
+   const ShaderResources *vertexShader = nullptr;
+
+   //! Null when the draw only feeds stream out
+   const ShaderResources *pixelShader = nullptr;
+
+   //! Indices already swapped to host order, null for auto generated indices
+   const uint32_t *indices = nullptr;
+   uint32_t count = 0;
+
+   std::array<Surface *, latte::MaxRenderTargets> colorTargets;
+   Surface *depthTarget = nullptr;
+};
+
+struct DrawContext;
+
+//! Renders draws by running the shaders through the interpreter. Vertices
+//  are shaded in parallel, primitives are clipped and binned into screen
+//  tiles and every tile is then rasterised by a single worker, so no two
+//  threads ever touch the same pixel.
+class Rasteriser
+{
+public:
+   //! numThreads of 0 uses one thread per hardware thread
+   explicit Rasteriser(uint32_t numThreads);
+   ~Rasteriser();
+
+   //! Returns the number of samples which passed the depth and stencil
+   //  tests, for occlusion queries.
+   uint64_t
+   draw(const DrawCommand &command);
+
+private:
+   void
+   shadeVertices(DrawContext &ctx);
+
+   void
+   setupPrimitives(DrawContext &ctx);
+
+   void
+   binPrimitives(DrawContext &ctx);
+
+   void
+   rasteriseTile(DrawContext &ctx,
+                 uint32_t tile,
+                 uint32_t worker);
+
+   void
+   reportError(const std::string &error);
+
+private:
+   WorkerPool mPool;
+
+   //! One shader state per worker, they are far too large for the stack
+   std::vector<std::unique_ptr<ShaderState>> mShaderStates;
+
+   //! Shader errors are logged once each rather than once per invocation
+   std::mutex mErrorMutex;
+   std::set<std::string> mReportedErrors;
+};
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,1671 @@
+#include "sw_shader.h"
+#include "gpu/latte_registers.h"
+#include "gpu/microcode/latte_decoders.h"
+#include "gpu/microcode/latte_instructions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <common/bit_cast.h>
+#include <cstring>
+#include <libcpu/mem.h>
+#include <spdlog/fmt/fmt.h>
+
+using namespace latte;
+
+namespace gpu
+{
+
+namespace sw
+{
+
+static const uint32_t MaxLoopIterations = 4096;
+
+struct LoopState
+{
+   size_t startPC;
+   size_t endPC;
+   uint32_t iterations;
+};
+
+struct Context
+{
+   Context(const ShaderResources &resources_,
+           ShaderState &state_,
+           std::string &error_) :
+      resources(resources_),
+      state(state_),
+      error(error_)
+   {
+   }
+
+   const ShaderResources &resources;
+   ShaderState &state;
+   std::string &error;
+
+   std::array<LoopState, MaxLoopDepth> loops;
+   uint32_t loopDepth = 0;
+};
+
+//! A result computed by one unit of an ALU group, written back once the
+//  whole group has executed.
+struct PendingWrite
+{
+   SQ_CHAN unit;
+   uint32_t gpr;
+   SQ_CHAN chan;
+   uint32_t value;
+   bool writeGpr;
+};
+
+static inline float
+asFloat(uint32_t value)
+{
+   return bit_cast<float>(value);
+}
+
+static inline uint32_t
+asUint(float value)
+{
+   return bit_cast<uint32_t>(value);
+}
+
+static inline int32_t
+asInt(uint32_t value)
+{
+   return static_cast<int32_t>(value);
+}
+
+static bool
+fail(Context &ctx,
+     const std::string &error)
+{
+   ctx.error = error;
+   return false;
+}
+
+static bool
+pushStack(Context &ctx)
+{
+   auto &state = ctx.state;
+
+   if (state.stackSize >= MaxStackDepth) {
+      return fail(ctx, "Control flow stack overflow");
+   }
+
+   state.stack[state.stackSize++] = state.activeMask;
+   return true;
+}
+
+static bool
+popStack(Context &ctx,
+         uint32_t count)
+{
+   auto &state = ctx.state;
+
+   for (auto i = 0u; i < count; ++i) {
+      if (state.stackSize == 0) {
+         return fail(ctx, "Control flow stack underflow");
+      }
+
+      state.activeMask = state.stack[--state.stackSize];
+   }
+
+   return true;
+}
+
+static bool
+elseStack(Context &ctx)
+{
+   auto &state = ctx.state;
+
+   if (state.stackSize == 0) {
+      return fail(ctx, "ELSE with an empty control flow stack");
+   }
+
+   if (state.stack[state.stackSize - 1] == Active) {
+      state.activeMask = (state.activeMask == Active) ? InactiveBranch : Active;
+   }
+
+   return true;
+}
+
+static bool
+checkCondition(Context &ctx,
+               SQ_CF_COND cond,
+               bool &result)
+{
+   switch (cond) {
+   case SQ_CF_COND::ACTIVE:
+      result = (ctx.state.activeMask == Active);
+      return true;
+   case SQ_CF_COND::ALWAYS_FALSE:
+      result = false;
+      return true;
+   default:
+      return fail(ctx, fmt::format("Unsupported SQ_CF_COND {}", cond));
+   }
+}
+
+static int32_t
+getIndexOffset(const ShaderState &state,
+               SQ_INDEX_MODE mode)
+{
+   switch (mode) {
+   case SQ_INDEX_MODE::AR_X:
+      return state.ar[0];
+   case SQ_INDEX_MODE::AR_Y:
+      return state.ar[1];
+   case SQ_INDEX_MODE::AR_Z:
+      return state.ar[2];
+   case SQ_INDEX_MODE::AR_W:
+      return state.ar[3];
+   case SQ_INDEX_MODE::LOOP:
+      return state.al;
+   default:
+      return 0;
+   }
+}
+
+static uint32_t
+getGprIndex(const ShaderState &state,
+            uint32_t gpr,
+            SQ_REL rel,
+            SQ_INDEX_MODE mode)
+{
+   auto index = static_cast<int32_t>(gpr);
+
+   if (rel) {
+      index += getIndexOffset(state, mode);
+   }
+
+   return static_cast<uint32_t>(index) & 127;
+}
+
+static uint32_t
+getImmediate(SQ_ALU_SRC sel,
+             bool intIn)
+{
+   // Like the GLSL translator, immediates are converted to the input type
+   // of the instruction rather than being passed through as raw bits.
+   switch (sel) {
+   case SQ_ALU_SRC::IMM_0:
+      return 0;
+   case SQ_ALU_SRC::IMM_1:
+   case SQ_ALU_SRC::IMM_1_INT:
+      return intIn ? 1 : asUint(1.0f);
+   case SQ_ALU_SRC::IMM_M_1_INT:
+      return intIn ? static_cast<uint32_t>(-1) : asUint(-1.0f);
+   case SQ_ALU_SRC::IMM_0_5:
+      return intIn ? 0 : asUint(0.5f);
+   default:
+      return 0;
+   }
+}
+
+static bool
+readSource(Context &ctx,
+           const ControlFlowInst &cf,
+           const AluInst &inst,
+           const AluGroup &group,
+           SQ_ALU_SRC sel,
+           SQ_REL rel,
+           SQ_CHAN chan,
+           bool abs,
+           bool neg,
+           SQ_ALU_FLAGS flags,
+           uint32_t &out)
+{
+   auto &state = ctx.state;
+   auto &resources = ctx.resources;
+   auto intIn = !!(flags & (SQ_ALU_FLAG_INT_IN | SQ_ALU_FLAG_UINT_IN));
+   auto offset = rel ? getIndexOffset(state, inst.word0.INDEX_MODE()) : 0;
+
+   if (sel >= SQ_ALU_SRC::REGISTER_FIRST && sel <= SQ_ALU_SRC::REGISTER_LAST) {
+      auto index = static_cast<uint32_t>(sel - SQ_ALU_SRC::REGISTER_FIRST + offset) & 127;
+      out = state.gpr[index][chan];
+   } else if ((sel >= SQ_ALU_SRC::KCACHE_BANK0_FIRST && sel <= SQ_ALU_SRC::KCACHE_BANK0_LAST)
+              || (sel >= SQ_ALU_SRC::KCACHE_BANK1_FIRST && sel <= SQ_ALU_SRC::KCACHE_BANK1_LAST)) {
+      auto addr = 0u;
+      auto bank = 0u;
+      auto mode = SQ_CF_KCACHE_MODE::NOP;
+      auto id = 0u;
+
+      if (sel < SQ_ALU_SRC::KCACHE_BANK1_FIRST) {
+         addr = cf.alu.word1.KCACHE_ADDR0();
+         bank = cf.alu.word0.KCACHE_BANK0();
+         mode = cf.alu.word0.KCACHE_MODE0();
+         id = sel - SQ_ALU_SRC::KCACHE_BANK0_FIRST;
+      } else {
+         addr = cf.alu.word1.KCACHE_ADDR1();
+         bank = cf.alu.word0.KCACHE_BANK1();
+         mode = cf.alu.word1.KCACHE_MODE1();
+         id = sel - SQ_ALU_SRC::KCACHE_BANK1_FIRST;
+      }
+
+      if (mode == SQ_CF_KCACHE_MODE::NOP || mode == SQ_CF_KCACHE_MODE::LOCK_LOOP_INDEX) {
+         return fail(ctx, fmt::format("Unsupported kcache lock mode {}", mode));
+      }
+
+      auto block = resources.uniformBlocks[bank];
+      auto index = (static_cast<int32_t>(addr * 16 + id) + offset) * 4 + static_cast<int32_t>(chan);
+
+      if (block && index >= 0 && static_cast<uint32_t>(index) < resources.uniformBlockSizes[bank]) {
+         out = block[index];
+      } else {
+         out = 0;
+      }
+   } else if (sel >= SQ_ALU_SRC::CONST_FILE_FIRST && sel <= SQ_ALU_SRC::CONST_FILE_LAST) {
+      auto index = static_cast<uint32_t>(sel - SQ_ALU_SRC::CONST_FILE_FIRST + offset) & 255;
+
+      if (resources.uniformRegisters) {
+         out = resources.uniformRegisters[index * 4 + chan];
+      } else {
+         out = 0;
+      }
+   } else {
+      switch (sel) {
+      case SQ_ALU_SRC::PV:
+         out = state.pv[chan];
+         break;
+      case SQ_ALU_SRC::PS:
+         out = state.ps;
+         break;
+      case SQ_ALU_SRC::LITERAL:
+         if (chan >= group.literals.size()) {
+            return fail(ctx, "ALU literal out of range");
+         }
+
+         out = group.literals[chan];
+         break;
+      case SQ_ALU_SRC::IMM_0:
+      case SQ_ALU_SRC::IMM_1:
+      case SQ_ALU_SRC::IMM_1_INT:
+      case SQ_ALU_SRC::IMM_M_1_INT:
+      case SQ_ALU_SRC::IMM_0_5:
+         out = getImmediate(sel, intIn);
+         break;
+      default:
+         return fail(ctx, fmt::format("Unsupported ALU source sel {}", sel));
+      }
+   }
+
+   if (intIn) {
+      auto value = asInt(out);
+
+      if (abs) {
+         value = std::abs(value);
+      }
+
+      if (neg) {
+         value = -value;
+      }
+
+      out = static_cast<uint32_t>(value);
+   } else {
+      if (abs) {
+         out &= 0x7FFFFFFFu;
+      }
+
+      if (neg) {
+         out ^= 0x80000000u;
+      }
+   }
+
+   return true;
+}
+
+static bool
+readSources(Context &ctx,
+            const ControlFlowInst &cf,
+            const AluInst &inst,
+            const AluGroup &group,
+            SQ_ALU_FLAGS flags,
+            uint32_t numSrcs,
+            uint32_t src[3])
+{
+   auto isOp2 = inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2;
+
+   if (numSrcs > 0
+    && !readSource(ctx, cf, inst, group,
+                   inst.word0.SRC0_SEL(), inst.word0.SRC0_REL(), inst.word0.SRC0_CHAN(),
+                   isOp2 && inst.op2.SRC0_ABS(), inst.word0.SRC0_NEG(),
+                   flags, src[0])) {
+      return false;
+   }
+
+   if (numSrcs > 1
+    && !readSource(ctx, cf, inst, group,
+                   inst.word0.SRC1_SEL(), inst.word0.SRC1_REL(), inst.word0.SRC1_CHAN(),
+                   isOp2 && inst.op2.SRC1_ABS(), inst.word0.SRC1_NEG(),
+                   flags, src[1])) {
+      return false;
+   }
+
+   if (numSrcs > 2
+    && !readSource(ctx, cf, inst, group,
+                   inst.op3.SRC2_SEL(), inst.op3.SRC2_REL(), inst.op3.SRC2_CHAN(),
+                   false, inst.op3.SRC2_NEG(),
+                   flags, src[2])) {
+      return false;
+   }
+
+   return true;
+}
+
+static uint32_t
+applyOutputModifiers(const AluInst &inst,
+                     SQ_ALU_FLAGS flags,
+                     uint32_t value)
+{
+   if (flags & (SQ_ALU_FLAG_INT_OUT | SQ_ALU_FLAG_UINT_OUT)) {
+      return value;
+   }
+
+   auto result = asFloat(value);
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2 && !(flags & SQ_ALU_FLAG_PRED_SET)) {
+      switch (inst.op2.OMOD()) {
+      case SQ_ALU_OMOD::M2:
+         result *= 2.0f;
+         break;
+      case SQ_ALU_OMOD::M4:
+         result *= 4.0f;
+         break;
+      case SQ_ALU_OMOD::D2:
+         result /= 2.0f;
+         break;
+      default:
+         break;
+      }
+   }
+
+   if (inst.word1.CLAMP()) {
+      result = std::min(std::max(result, 0.0f), 1.0f);
+   }
+
+   return asUint(result);
+}
+
+static bool
+executeCompare(SQ_OP2_INST op,
+               const uint32_t src[3],
+               bool &result)
+{
+   auto f0 = asFloat(src[0]), f1 = asFloat(src[1]);
+   auto i0 = asInt(src[0]), i1 = asInt(src[1]);
+   auto u0 = src[0], u1 = src[1];
+
+   switch (op) {
+   case SQ_OP2_INST_SETE:
+   case SQ_OP2_INST_SETE_DX10:
+   case SQ_OP2_INST_PRED_SETE:
+   case SQ_OP2_INST_PRED_SETE_PUSH:
+   case SQ_OP2_INST_KILLE:
+      result = (f0 == f1);
+      return true;
+   case SQ_OP2_INST_SETGT:
+   case SQ_OP2_INST_SETGT_DX10:
+   case SQ_OP2_INST_PRED_SETGT:
+   case SQ_OP2_INST_PRED_SETGT_PUSH:
+   case SQ_OP2_INST_KILLGT:
+      result = (f0 > f1);
+      return true;
+   case SQ_OP2_INST_SETGE:
+   case SQ_OP2_INST_SETGE_DX10:
+   case SQ_OP2_INST_PRED_SETGE:
+   case SQ_OP2_INST_PRED_SETGE_PUSH:
+   case SQ_OP2_INST_KILLGE:
+      result = (f0 >= f1);
+      return true;
+   case SQ_OP2_INST_SETNE:
+   case SQ_OP2_INST_SETNE_DX10:
+   case SQ_OP2_INST_PRED_SETNE:
+   case SQ_OP2_INST_PRED_SETNE_PUSH:
+   case SQ_OP2_INST_KILLNE:
+      result = (f0 != f1);
+      return true;
+   case SQ_OP2_INST_SETE_INT:
+   case SQ_OP2_INST_PRED_SETE_INT:
+   case SQ_OP2_INST_PRED_SETE_PUSH_INT:
+   case SQ_OP2_INST_KILLE_INT:
+      result = (i0 == i1);
+      return true;
+   case SQ_OP2_INST_SETGT_INT:
+   case SQ_OP2_INST_PRED_SETGT_INT:
+   case SQ_OP2_INST_PRED_SETGT_PUSH_INT:
+   case SQ_OP2_INST_KILLGT_INT:
+      result = (i0 > i1);
+      return true;
+   case SQ_OP2_INST_SETGE_INT:
+   case SQ_OP2_INST_PRED_SETGE_INT:
+   case SQ_OP2_INST_PRED_SETGE_PUSH_INT:
+   case SQ_OP2_INST_KILLGE_INT:
+      result = (i0 >= i1);
+      return true;
+   case SQ_OP2_INST_SETNE_INT:
+   case SQ_OP2_INST_PRED_SETNE_INT:
+   case SQ_OP2_INST_PRED_SETNE_PUSH_INT:
+   case SQ_OP2_INST_KILLNE_INT:
+      result = (i0 != i1);
+      return true;
+   case SQ_OP2_INST_PRED_SETLT_PUSH_INT:
+      result = (i0 < i1);
+      return true;
+   case SQ_OP2_INST_PRED_SETLE_PUSH_INT:
+      result = (i0 <= i1);
+      return true;
+   case SQ_OP2_INST_SETGT_UINT:
+   case SQ_OP2_INST_PRED_SETGT_UINT:
+   case SQ_OP2_INST_KILLGT_UINT:
+      result = (u0 > u1);
+      return true;
+   case SQ_OP2_INST_SETGE_UINT:
+   case SQ_OP2_INST_PRED_SETGE_UINT:
+   case SQ_OP2_INST_KILLGE_UINT:
+      result = (u0 >= u1);
+      return true;
+   default:
+      return false;
+   }
+}
+
+static bool
+isKillInstruction(SQ_OP2_INST op)
+{
+   switch (op) {
+   case SQ_OP2_INST_KILLE:
+   case SQ_OP2_INST_KILLGT:
+   case SQ_OP2_INST_KILLGE:
+   case SQ_OP2_INST_KILLNE:
+   case SQ_OP2_INST_KILLE_INT:
+   case SQ_OP2_INST_KILLGT_INT:
+   case SQ_OP2_INST_KILLGE_INT:
+   case SQ_OP2_INST_KILLNE_INT:
+   case SQ_OP2_INST_KILLGT_UINT:
+   case SQ_OP2_INST_KILLGE_UINT:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static bool
+isPushPredicate(SQ_OP2_INST op)
+{
+   switch (op) {
+   case SQ_OP2_INST_PRED_SETE_PUSH:
+   case SQ_OP2_INST_PRED_SETGT_PUSH:
+   case SQ_OP2_INST_PRED_SETGE_PUSH:
+   case SQ_OP2_INST_PRED_SETNE_PUSH:
+   case SQ_OP2_INST_PRED_SETE_PUSH_INT:
+   case SQ_OP2_INST_PRED_SETGT_PUSH_INT:
+   case SQ_OP2_INST_PRED_SETGE_PUSH_INT:
+   case SQ_OP2_INST_PRED_SETNE_PUSH_INT:
+   case SQ_OP2_INST_PRED_SETLT_PUSH_INT:
+   case SQ_OP2_INST_PRED_SETLE_PUSH_INT:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static bool
+executeOP2(Context &ctx,
+           const AluInst &inst,
+           const uint32_t src[3],
+           uint32_t &result,
+           std::array<bool, 4> &arWrite,
+           std::array<int32_t, 4> &arValue)
+{
+   auto &state = ctx.state;
+   auto op = inst.op2.ALU_INST();
+   auto f0 = asFloat(src[0]), f1 = asFloat(src[1]);
+   auto i0 = asInt(src[0]), i1 = asInt(src[1]);
+   auto u0 = src[0], u1 = src[1];
+   auto compare = false;
+
+   if (executeCompare(op, src, compare)) {
+      auto flags = getInstructionFlags(op);
+
+      if (isKillInstruction(op)) {
+         if (compare) {
+            state.killed = true;
+         }
+
+         result = asUint(compare ? 1.0f : 0.0f);
+         return true;
+      }
+
+      if (flags & SQ_ALU_FLAG_PRED_SET) {
+         if (isPushPredicate(op) && !pushStack(ctx)) {
+            return false;
+         }
+
+         if (inst.op2.UPDATE_PRED()) {
+            state.predicate = compare;
+         }
+
+         if (inst.op2.UPDATE_EXECUTE_MASK()) {
+            state.activeMask = compare ? Active : InactiveBranch;
+         }
+
+         // Mirror the GLSL translator which always writes a float result
+         result = asUint(compare ? 1.0f : 0.0f);
+         return true;
+      }
+
+      if (flags & SQ_ALU_FLAG_INT_OUT) {
+         result = compare ? 0xFFFFFFFFu : 0u;
+      } else if (flags & (SQ_ALU_FLAG_INT_IN | SQ_ALU_FLAG_UINT_IN)) {
+         result = compare ? 0xFFFFFFFFu : 0u;
+      } else {
+         result = asUint(compare ? 1.0f : 0.0f);
+      }
+
+      return true;
+   }
+
+   switch (op) {
+   case SQ_OP2_INST_ADD:
+      result = asUint(f0 + f1);
+      break;
+   case SQ_OP2_INST_MUL:
+   case SQ_OP2_INST_MUL_IEEE:
+      result = asUint(f0 * f1);
+      break;
+   case SQ_OP2_INST_MAX:
+   case SQ_OP2_INST_MAX_DX10:
+      result = asUint(std::max(f0, f1));
+      break;
+   case SQ_OP2_INST_MIN:
+   case SQ_OP2_INST_MIN_DX10:
+      result = asUint(std::min(f0, f1));
+      break;
+   case SQ_OP2_INST_FRACT:
+      result = asUint(f0 - std::floor(f0));
+      break;
+   case SQ_OP2_INST_TRUNC:
+      result = asUint(std::trunc(f0));
+      break;
+   case SQ_OP2_INST_CEIL:
+      result = asUint(std::ceil(f0));
+      break;
+   case SQ_OP2_INST_RNDNE:
+      result = asUint(std::nearbyint(f0));
+      break;
+   case SQ_OP2_INST_FLOOR:
+      result = asUint(std::floor(f0));
+      break;
+   case SQ_OP2_INST_MOV:
+      result = src[0];
+      break;
+   case SQ_OP2_INST_NOP:
+      return true;
+   case SQ_OP2_INST_MOVA:
+   case SQ_OP2_INST_MOVA_FLOOR:
+   {
+      auto value = (op == SQ_OP2_INST_MOVA) ? std::nearbyint(f0) : std::floor(f0);
+      value = std::min(std::max(value, -256.0f), 255.0f);
+      arWrite[inst.word1.DST_CHAN()] = true;
+      arValue[inst.word1.DST_CHAN()] = static_cast<int32_t>(value);
+      result = asUint(value);
+      break;
+   }
+   case SQ_OP2_INST_MOVA_INT:
+   {
+      auto value = std::min(std::max(i0, -256), 256);
+      arWrite[inst.word1.DST_CHAN()] = true;
+      arValue[inst.word1.DST_CHAN()] = value;
+      result = static_cast<uint32_t>(value);
+      break;
+   }
+   case SQ_OP2_INST_AND_INT:
+      result = u0 & u1;
+      break;
+   case SQ_OP2_INST_OR_INT:
+      result = u0 | u1;
+      break;
+   case SQ_OP2_INST_XOR_INT:
+      result = u0 ^ u1;
+      break;
+   case SQ_OP2_INST_NOT_INT:
+      result = ~u0;
+      break;
+   case SQ_OP2_INST_ADD_INT:
+      result = u0 + u1;
+      break;
+   case SQ_OP2_INST_SUB_INT:
+      result = u0 - u1;
+      break;
+   case SQ_OP2_INST_MAX_INT:
+      result = static_cast<uint32_t>(std::max(i0, i1));
+      break;
+   case SQ_OP2_INST_MIN_INT:
+      result = static_cast<uint32_t>(std::min(i0, i1));
+      break;
+   case SQ_OP2_INST_MAX_UINT:
+      result = std::max(u0, u1);
+      break;
+   case SQ_OP2_INST_MIN_UINT:
+      result = std::min(u0, u1);
+      break;
+   case SQ_OP2_INST_EXP_IEEE:
+      result = asUint(std::exp2(f0));
+      break;
+   case SQ_OP2_INST_LOG_CLAMPED:
+   case SQ_OP2_INST_LOG_IEEE:
+      result = asUint(std::log2(f0));
+      break;
+   case SQ_OP2_INST_RECIP_CLAMPED:
+   case SQ_OP2_INST_RECIP_FF:
+   case SQ_OP2_INST_RECIP_IEEE:
+      result = asUint(1.0f / f0);
+      break;
+   case SQ_OP2_INST_RECIPSQRT_CLAMPED:
+   case SQ_OP2_INST_RECIPSQRT_FF:
+   case SQ_OP2_INST_RECIPSQRT_IEEE:
+      result = asUint(1.0f / std::sqrt(f0));
+      break;
+   case SQ_OP2_INST_SQRT_IEEE:
+      result = asUint(std::sqrt(f0));
+      break;
+   case SQ_OP2_INST_FLT_TO_INT:
+      result = static_cast<uint32_t>(static_cast<int32_t>(f0));
+      break;
+   case SQ_OP2_INST_FLT_TO_UINT:
+      result = f0 <= 0.0f ? 0u : static_cast<uint32_t>(f0);
+      break;
+   case SQ_OP2_INST_INT_TO_FLT:
+      result = asUint(static_cast<float>(i0));
+      break;
+   case SQ_OP2_INST_UINT_TO_FLT:
+      result = asUint(static_cast<float>(u0));
+      break;
+   case SQ_OP2_INST_SIN:
+      result = asUint(std::sin(f0 * 6.28318530718f));
+      break;
+   case SQ_OP2_INST_COS:
+      result = asUint(std::cos(f0 * 6.28318530718f));
+      break;
+   case SQ_OP2_INST_ASHR_INT:
+      result = static_cast<uint32_t>(i0 >> (u1 & 31));
+      break;
+   case SQ_OP2_INST_LSHR_INT:
+      result = u0 >> (u1 & 31);
+      break;
+   case SQ_OP2_INST_LSHL_INT:
+      result = u0 << (u1 & 31);
+      break;
+   case SQ_OP2_INST_MULLO_INT:
+   case SQ_OP2_INST_MULLO_UINT:
+      result = u0 * u1;
+      break;
+   case SQ_OP2_INST_MULHI_INT:
+      result = static_cast<uint32_t>((static_cast<int64_t>(i0) * i1) >> 32);
+      break;
+   case SQ_OP2_INST_MULHI_UINT:
+      result = static_cast<uint32_t>((static_cast<uint64_t>(u0) * u1) >> 32);
+      break;
+   case SQ_OP2_INST_RECIP_INT:
+      result = i0 ? static_cast<uint32_t>(1 / i0) : 0u;
+      break;
+   case SQ_OP2_INST_RECIP_UINT:
+      result = u0 ? static_cast<uint32_t>(0xFFFFFFFFull / u0) : 0xFFFFFFFFu;
+      break;
+   default:
+      return fail(ctx, fmt::format("Unsupported OP2 instruction {}", getInstructionName(op)));
+   }
+
+   return true;
+}
+
+static bool
+executeOP3(Context &ctx,
+           const AluInst &inst,
+           const uint32_t src[3],
+           uint32_t &result)
+{
+   auto op = inst.op3.ALU_INST();
+   auto f0 = asFloat(src[0]), f1 = asFloat(src[1]), f2 = asFloat(src[2]);
+   auto i0 = asInt(src[0]);
+
+   switch (op) {
+   case SQ_OP3_INST_MULADD:
+   case SQ_OP3_INST_MULADD_IEEE:
+   case SQ_OP3_INST_FMA:
+      result = asUint(f0 * f1 + f2);
+      break;
+   case SQ_OP3_INST_MULADD_M2:
+   case SQ_OP3_INST_MULADD_IEEE_M2:
+      result = asUint((f0 * f1 + f2) * 2.0f);
+      break;
+   case SQ_OP3_INST_MULADD_M4:
+   case SQ_OP3_INST_MULADD_IEEE_M4:
+      result = asUint((f0 * f1 + f2) * 4.0f);
+      break;
+   case SQ_OP3_INST_MULADD_D2:
+   case SQ_OP3_INST_MULADD_IEEE_D2:
+      result = asUint((f0 * f1 + f2) / 2.0f);
+      break;
+   case SQ_OP3_INST_CNDE:
+      result = (f0 == 0.0f) ? src[1] : src[2];
+      break;
+   case SQ_OP3_INST_CNDGT:
+      result = (f0 > 0.0f) ? src[1] : src[2];
+      break;
+   case SQ_OP3_INST_CNDGE:
+      result = (f0 >= 0.0f) ? src[1] : src[2];
+      break;
+   case SQ_OP3_INST_CNDE_INT:
+      result = (i0 == 0) ? src[1] : src[2];
+      break;
+   case SQ_OP3_INST_CNDGT_INT:
+      result = (i0 > 0) ? src[1] : src[2];
+      break;
+   case SQ_OP3_INST_CNDGE_INT:
+      result = (i0 >= 0) ? src[1] : src[2];
+      break;
+   case SQ_OP3_INST_BFE_UINT:
+   {
+      auto width = src[2] & 31;
+      auto value = src[0] >> (src[1] & 31);
+      result = width ? (value & ((1u << width) - 1)) : 0u;
+      break;
+   }
+   case SQ_OP3_INST_BFE_INT:
+   {
+      auto width = src[2] & 31;
+      auto value = src[0] >> (src[1] & 31);
+
+      if (width) {
+         auto shift = 32 - width;
+         result = static_cast<uint32_t>(static_cast<int32_t>(value << shift) >> shift);
+      } else {
+         result = 0;
+      }
+      break;
+   }
+   case SQ_OP3_INST_BFI_INT:
+      result = (src[0] & src[1]) | (~src[0] & src[2]);
+      break;
+   default:
+      return fail(ctx, fmt::format("Unsupported OP3 instruction {}", getInstructionName(op)));
+   }
+
+   return true;
+}
+
+//! Reduction instructions use all four vector units to compute one value,
+//  which is then written to each unit that has its write mask set.
+static bool
+executeReduction(Context &ctx,
+                 const ControlFlowInst &cf,
+                 const AluGroup &group,
+                 std::array<uint32_t, 4> &results)
+{
+   uint32_t src[4][3];
+   auto op = SQ_OP2_INST_NOP;
+   auto numUnits = 0u;
+
+   for (auto &inst : group.instructions) {
+      if (inst.word1.ENCODING() != SQ_ALU_ENCODING::OP2
+       || !(getInstructionFlags(inst.op2.ALU_INST()) & SQ_ALU_FLAG_REDUCTION)) {
+         continue;
+      }
+
+      auto chan = inst.word1.DST_CHAN();
+      op = inst.op2.ALU_INST();
+
+      if (!readSources(ctx, cf, inst, group, getInstructionFlags(op), 2, src[chan])) {
+         return false;
+      }
+
+      numUnits++;
+   }
+
+   if (numUnits != 4) {
+      return fail(ctx, "Reduction instruction must use all four vector units");
+   }
+
+   switch (op) {
+   case SQ_OP2_INST_DOT4:
+   case SQ_OP2_INST_DOT4_IEEE:
+   {
+      auto value = 0.0f;
+
+      for (auto i = 0u; i < 4; ++i) {
+         value += asFloat(src[i][0]) * asFloat(src[i][1]);
+      }
+
+      results.fill(asUint(value));
+      break;
+   }
+   case SQ_OP2_INST_MAX4:
+   {
+      auto value = asFloat(src[0][0]);
+
+      for (auto i = 1u; i < 4; ++i) {
+         value = std::max(value, asFloat(src[i][0]));
+      }
+
+      results.fill(asUint(value));
+      break;
+   }
+   case SQ_OP2_INST_CUBE:
+   {
+      // CUBE R[out], R[in].zzxy, R[in].yxzz
+      auto x = asFloat(src[2][0]);
+      auto y = asFloat(src[3][0]);
+      auto z = asFloat(src[0][0]);
+      auto sc = 0.0f, tc = 0.0f, ma = 0.0f, face = 0.0f;
+
+      if (std::fabs(x) >= std::fabs(y) && std::fabs(x) >= std::fabs(z)) {
+         sc = (x >= 0.0f) ? -z : z;
+         tc = -y;
+         ma = x;
+         face = (x >= 0.0f) ? 0.0f : 1.0f;
+      } else if (std::fabs(y) >= std::fabs(x) && std::fabs(y) >= std::fabs(z)) {
+         sc = x;
+         tc = (y >= 0.0f) ? z : -z;
+         ma = y;
+         face = (y >= 0.0f) ? 2.0f : 3.0f;
+      } else {
+         sc = (z >= 0.0f) ? x : -x;
+         tc = -y;
+         ma = z;
+         face = (z >= 0.0f) ? 4.0f : 5.0f;
+      }
+
+      results[0] = asUint(tc);
+      results[1] = asUint(sc);
+      results[2] = asUint(2.0f * ma);
+      results[3] = asUint(face);
+      break;
+   }
+   default:
+      return fail(ctx, fmt::format("Unsupported reduction instruction {}", getInstructionName(op)));
+   }
+
+   return true;
+}
+
+static bool
+runAluClause(Context &ctx,
+             const ControlFlowInst &cf,
+             gsl::span<const uint8_t> program)
+{
+   auto &state = ctx.state;
+   auto addr = cf.alu.word0.ADDR();
+   auto count = cf.alu.word1.COUNT() + 1;
+
+   if ((addr + count) * 8 > program.size()) {
+      return fail(ctx, "ALU clause out of program bounds");
+   }
+
+   auto clause = reinterpret_cast<const AluInst *>(program.data() + 8 * addr);
+
+   for (size_t slot = 0u; slot < count; ) {
+      auto units = AluGroupUnits { };
+      auto group = AluGroup { clause + slot };
+      auto writes = std::array<PendingWrite, 5> { };
+      auto numWrites = 0u;
+      auto arWrite = std::array<bool, 4> { false, false, false, false };
+      auto arValue = std::array<int32_t, 4> { 0, 0, 0, 0 };
+      auto reduction = std::array<uint32_t, 4> { };
+      auto didReduction = false;
+      auto pv = state.pv;
+      auto ps = state.ps;
+
+      for (auto &inst : group.instructions) {
+         auto unit = units.addInstructionUnit(inst);
+         auto isOp2 = inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2;
+         auto flags = isOp2 ? getInstructionFlags(inst.op2.ALU_INST()) : getInstructionFlags(inst.op3.ALU_INST());
+         auto result = 0u;
+
+         switch (inst.word0.PRED_SEL()) {
+         case SQ_PRED_SEL::ZERO:
+            if (state.predicate) {
+               continue;
+            }
+            break;
+         case SQ_PRED_SEL::ONE:
+            if (!state.predicate) {
+               continue;
+            }
+            break;
+         default:
+            break;
+         }
+
+         if (flags & SQ_ALU_FLAG_REDUCTION) {
+            if (!didReduction && !executeReduction(ctx, cf, group, reduction)) {
+               return false;
+            }
+
+            didReduction = true;
+            result = reduction[unit];
+         } else {
+            uint32_t src[3] = { 0, 0, 0 };
+            auto numSrcs = isOp2 ? getInstructionNumSrcs(inst.op2.ALU_INST()) : getInstructionNumSrcs(inst.op3.ALU_INST());
+
+            if (!readSources(ctx, cf, inst, group, flags, numSrcs, src)) {
+               return false;
+            }
+
+            if (isOp2) {
+               if (!executeOP2(ctx, inst, src, result, arWrite, arValue)) {
+                  return false;
+               }
+
+               if (inst.op2.ALU_INST() == SQ_OP2_INST_NOP) {
+                  continue;
+               }
+            } else if (!executeOP3(ctx, inst, src, result)) {
+               return false;
+            }
+         }
+
+         auto &write = writes[numWrites++];
+         write.unit = unit;
+         write.gpr = getGprIndex(state, inst.word1.DST_GPR(), inst.word1.DST_REL(), inst.word0.INDEX_MODE());
+         write.chan = inst.word1.DST_CHAN();
+         write.value = applyOutputModifiers(inst, flags, result);
+         write.writeGpr = !isOp2 || inst.op2.WRITE_MASK();
+      }
+
+      // Results only become visible once the whole group has executed
+      for (auto i = 0u; i < numWrites; ++i) {
+         auto &write = writes[i];
+
+         if (write.writeGpr) {
+            state.gpr[write.gpr][write.chan] = write.value;
+         }
+
+         if (write.unit == SQ_CHAN::T) {
+            ps = write.value;
+         } else {
+            pv[write.unit] = write.value;
+         }
+      }
+
+      for (auto i = 0u; i < 4; ++i) {
+         if (arWrite[i]) {
+            state.ar[i] = arValue[i];
+         }
+      }
+
+      state.pv = pv;
+      state.ps = ps;
+      slot = group.getNextSlot(slot);
+   }
+
+   return true;
+}
+
+static Vec4
+readTexCoords(const Vec4 &src,
+              SQ_SEL selX,
+              SQ_SEL selY,
+              SQ_SEL selZ,
+              SQ_SEL selW)
+{
+   auto select = [&](SQ_SEL sel) -> uint32_t {
+      switch (sel) {
+      case SQ_SEL::SEL_X:
+      case SQ_SEL::SEL_Y:
+      case SQ_SEL::SEL_Z:
+      case SQ_SEL::SEL_W:
+         return src[sel];
+      case SQ_SEL::SEL_1:
+         return asUint(1.0f);
+      default:
+         return 0;
+      }
+   };
+
+   return { select(selX), select(selY), select(selZ), select(selW) };
+}
+
+static void
+writeSelected(Vec4 &dst,
+              const Vec4 &value,
+              SQ_SEL selX,
+              SQ_SEL selY,
+              SQ_SEL selZ,
+              SQ_SEL selW,
+              bool isInteger)
+{
+   SQ_SEL sels[4] = { selX, selY, selZ, selW };
+
+   for (auto i = 0u; i < 4; ++i) {
+      switch (sels[i]) {
+      case SQ_SEL::SEL_X:
+      case SQ_SEL::SEL_Y:
+      case SQ_SEL::SEL_Z:
+      case SQ_SEL::SEL_W:
+         dst[i] = value[sels[i]];
+         break;
+      case SQ_SEL::SEL_0:
+         dst[i] = 0;
+         break;
+      case SQ_SEL::SEL_1:
+         dst[i] = isInteger ? 1 : asUint(1.0f);
+         break;
+      default:
+         break;
+      }
+   }
+}
+
+static bool
+runTexInstruction(Context &ctx,
+                  const TextureFetchInst &inst)
+{
+   auto &state = ctx.state;
+   auto op = inst.word0.TEX_INST();
+   auto resourceId = inst.word0.RESOURCE_ID();
+   auto samplerId = inst.word2.SAMPLER_ID();
+
+   if (op == SQ_TEX_INST_SET_CUBEMAP_INDEX) {
+      return true;
+   }
+
+   if (resourceId >= MaxTextures || samplerId >= MaxSamplers) {
+      return fail(ctx, fmt::format("Texture resource {} or sampler {} out of range", resourceId, samplerId));
+   }
+
+   auto texture = ctx.resources.textures[resourceId];
+   auto &sampler = ctx.resources.samplers[samplerId];
+   auto srcGpr = getGprIndex(state, inst.word0.SRC_GPR(), inst.word0.SRC_REL(), SQ_INDEX_MODE::LOOP);
+   auto dstGpr = getGprIndex(state, inst.word1.DST_GPR(), inst.word1.DST_REL(), SQ_INDEX_MODE::LOOP);
+   auto coords = readTexCoords(state.gpr[srcGpr],
+                               inst.word2.SRC_SEL_X(), inst.word2.SRC_SEL_Y(),
+                               inst.word2.SRC_SEL_Z(), inst.word2.SRC_SEL_W());
+   auto value = Vec4 { 0, 0, 0, 0 };
+
+   if (!texture) {
+      // Missing textures read as zero rather than failing the whole draw
+      writeSelected(state.gpr[dstGpr], value,
+                    inst.word1.DST_SEL_X(), inst.word1.DST_SEL_Y(),
+                    inst.word1.DST_SEL_Z(), inst.word1.DST_SEL_W(), false);
+      return true;
+   }
+
+   switch (op) {
+   case SQ_TEX_INST_SAMPLE:
+   case SQ_TEX_INST_SAMPLE_L:
+   case SQ_TEX_INST_SAMPLE_LB:
+   case SQ_TEX_INST_SAMPLE_LZ:
+   case SQ_TEX_INST_SAMPLE_G:
+   case SQ_TEX_INST_SAMPLE_G_L:
+   case SQ_TEX_INST_SAMPLE_G_LB:
+   case SQ_TEX_INST_SAMPLE_G_LZ:
+   case SQ_TEX_INST_SAMPLE_C:
+   case SQ_TEX_INST_SAMPLE_C_L:
+   case SQ_TEX_INST_SAMPLE_C_LB:
+   case SQ_TEX_INST_SAMPLE_C_LZ:
+   {
+      float coord[4] = {
+         asFloat(coords[0]), asFloat(coords[1]), asFloat(coords[2]), asFloat(coords[3])
+      };
+      float size[3] = {
+         static_cast<float>(texture->width),
+         static_cast<float>(texture->height),
+         static_cast<float>(texture->depth),
+      };
+
+      if (inst.word1.COORD_TYPE_X() == SQ_TEX_COORD_TYPE::UNNORMALIZED) {
+         coord[0] /= size[0];
+      }
+
+      if (inst.word1.COORD_TYPE_Y() == SQ_TEX_COORD_TYPE::UNNORMALIZED) {
+         coord[1] /= size[1];
+      }
+
+      if (inst.word2.OFFSET_X() || inst.word2.OFFSET_Y()) {
+         // Offsets are signed 5 bit values in half texel units
+         auto offsetX = static_cast<int32_t>(inst.word2.OFFSET_X() << 27) >> 27;
+         auto offsetY = static_cast<int32_t>(inst.word2.OFFSET_Y() << 27) >> 27;
+         coord[0] += (offsetX / 2.0f) / size[0];
+         coord[1] += (offsetY / 2.0f) / size[1];
+      }
+
+      auto s = coord[0], t = coord[1], r = coord[2];
+
+      switch (texture->dim) {
+      case SQ_TEX_DIM::DIM_1D:
+         t = 0.0f;
+         r = 0.0f;
+         break;
+      case SQ_TEX_DIM::DIM_1D_ARRAY:
+         r = t;
+         t = 0.0f;
+         break;
+      case SQ_TEX_DIM::DIM_2D:
+         r = 0.0f;
+         break;
+      case SQ_TEX_DIM::DIM_CUBEMAP:
+         // CUBE produces face coordinates in the range [1, 2]
+         s -= 1.0f;
+         t -= 1.0f;
+         break;
+      default:
+         break;
+      }
+
+      value = sampleTexture(*texture, sampler, s, t, r);
+
+      if (op >= SQ_TEX_INST_SAMPLE_C && op <= SQ_TEX_INST_SAMPLE_C_LZ) {
+         // The reference value is in .w, the result is 1 if the test passes
+         auto passed = compareDepth(sampler.compareFunc, coord[3], asFloat(value[0]));
+         value.fill(asUint(passed ? 1.0f : 0.0f));
+      }
+      break;
+   }
+   case SQ_TEX_INST_LD:
+      value = fetchTexel(*texture, asInt(coords[0]), asInt(coords[1]), asInt(coords[2]));
+      break;
+   case SQ_TEX_INST_GET_TEXTURE_INFO:
+      value[0] = texture->width;
+      value[1] = texture->height;
+      value[2] = texture->depth;
+      value[3] = 1;
+      break;
+   default:
+      return fail(ctx, fmt::format("Unsupported TEX instruction {}", getInstructionName(op)));
+   }
+
+   writeSelected(state.gpr[dstGpr], value,
+                 inst.word1.DST_SEL_X(), inst.word1.DST_SEL_Y(),
+                 inst.word1.DST_SEL_Z(), inst.word1.DST_SEL_W(),
+                 texture->isInteger || op == SQ_TEX_INST_GET_TEXTURE_INFO);
+   return true;
+}
+
+static bool
+runVtxInstruction(Context &ctx,
+                  const VertexFetchInst &inst)
+{
+   auto &state = ctx.state;
+   auto registers = ctx.resources.registers;
+   auto op = inst.word0.VTX_INST();
+
+   if (op != SQ_VTX_INST_FETCH && op != SQ_VTX_INST_SEMANTIC) {
+      return fail(ctx, fmt::format("Unsupported VTX instruction {}", getInstructionName(op)));
+   }
+
+   auto getRegister = [&](uint32_t reg) {
+      return registers[reg / 4];
+   };
+
+   auto resourceOffset = (SQ_RES_OFFSET::VS_TEX_RESOURCE_0 + inst.word0.BUFFER_ID()) * 7;
+   auto word0 = SQ_VTX_CONSTANT_WORD0_N::get(getRegister(Register::SQ_VTX_CONSTANT_WORD0_0 + 4 * resourceOffset));
+   auto word1 = SQ_VTX_CONSTANT_WORD1_N::get(getRegister(Register::SQ_VTX_CONSTANT_WORD1_0 + 4 * resourceOffset));
+   auto word2 = SQ_VTX_CONSTANT_WORD2_N::get(getRegister(Register::SQ_VTX_CONSTANT_WORD2_0 + 4 * resourceOffset));
+
+   auto srcGpr = getGprIndex(state, inst.word0.SRC_GPR(), inst.word0.SRC_REL(), SQ_INDEX_MODE::LOOP);
+   auto srcSel = inst.word0.SRC_SEL_X();
+   auto index = state.gpr[srcGpr][srcSel];
+
+   switch (inst.word0.FETCH_TYPE()) {
+   case SQ_VTX_FETCH_TYPE::VERTEX_DATA:
+      index += getRegister(Register::SQ_VTX_BASE_VTX_LOC);
+      break;
+   case SQ_VTX_FETCH_TYPE::INSTANCE_DATA:
+      index += getRegister(Register::SQ_VTX_START_INST_LOC);
+      break;
+   default:
+      break;
+   }
+
+   auto format = DataFormat { };
+   auto endian = SQ_ENDIAN::NONE;
+
+   if (inst.word1.USE_CONST_FIELDS()) {
+      format.format = word2.DATA_FORMAT();
+      format.numFormat = word2.NUM_FORMAT_ALL();
+      format.formatComp = word2.FORMAT_COMP_ALL();
+      endian = word2.ENDIAN_SWAP();
+   } else {
+      format.format = inst.word1.DATA_FORMAT();
+      format.numFormat = inst.word1.NUM_FORMAT_ALL();
+      format.formatComp = inst.word1.FORMAT_COMP_ALL();
+      endian = inst.word2.ENDIAN_SWAP();
+   }
+
+   auto elementBytes = getElementBytes(format.format);
+
+   if (!elementBytes) {
+      return fail(ctx, fmt::format("Unsupported vertex fetch format {}", format.format));
+   }
+
+   auto value = Vec4 { 0, 0, 0, asUint(1.0f) };
+   auto offset = static_cast<uint64_t>(index) * word2.STRIDE() + inst.word2.OFFSET();
+   auto size = static_cast<uint64_t>(word1.SIZE()) + 1;
+
+   if (word0.BASE_ADDRESS() && offset + elementBytes <= size) {
+      uint8_t element[16];
+      std::memcpy(element, mem::translate(word0.BASE_ADDRESS() + static_cast<uint32_t>(offset)), elementBytes);
+      swapElement(element, format.format, endian);
+      value = unpackElement(element, format);
+   }
+
+   auto writeGpr = [&](uint32_t gpr) {
+      writeSelected(state.gpr[gpr & 127], value,
+                    inst.word1.DST_SEL_X(), inst.word1.DST_SEL_Y(),
+                    inst.word1.DST_SEL_Z(), inst.word1.DST_SEL_W(),
+                    format.numFormat == SQ_NUM_FORMAT::INT);
+   };
+
+   if (op == SQ_VTX_INST_FETCH) {
+      writeGpr(getGprIndex(state, inst.gpr.DST_GPR(), inst.gpr.DST_REL(), SQ_INDEX_MODE::LOOP));
+   } else {
+      auto semanticId = inst.sem.SEMANTIC_ID();
+
+      for (auto i = 0u; i < 32; ++i) {
+         auto semantic = SQ_VTX_SEMANTIC_N::get(getRegister(Register::SQ_VTX_SEMANTIC_0 + i * 4));
+
+         if (semantic.SEMANTIC_ID() == semanticId && semanticId != 0xff) {
+            writeGpr(i + 1);
+         }
+      }
+   }
+
+   return true;
+}
+
+static bool
+runFetchClause(Context &ctx,
+               const ControlFlowInst &cf,
+               gsl::span<const uint8_t> program)
+{
+   auto addr = cf.word0.ADDR;
+   auto count = (cf.word1.COUNT() + 1) | (cf.word1.COUNT_3() << 3);
+   auto isTex = cf.word1.CF_INST() == SQ_CF_INST_TEX;
+
+   if (8ull * addr + 16ull * count > program.size()) {
+      return fail(ctx, "Fetch clause out of program bounds");
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      auto ptr = program.data() + 8 * addr + 16 * i;
+
+      if (isTex) {
+         if (!runTexInstruction(ctx, *reinterpret_cast<const TextureFetchInst *>(ptr))) {
+            return false;
+         }
+      } else {
+         if (!runVtxInstruction(ctx, *reinterpret_cast<const VertexFetchInst *>(ptr))) {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+static bool
+runExport(Context &ctx,
+          const ControlFlowInst &cf)
+{
+   auto &state = ctx.state;
+   auto type = cf.exp.word0.TYPE();
+   auto arrayBase = cf.exp.word0.ARRAY_BASE();
+   SQ_SEL sels[4] = {
+      cf.exp.swiz.SRC_SEL_X(), cf.exp.swiz.SRC_SEL_Y(),
+      cf.exp.swiz.SRC_SEL_Z(), cf.exp.swiz.SRC_SEL_W(),
+   };
+
+   for (auto i = 0u; i <= cf.exp.word1.BURST_COUNT(); ++i) {
+      auto index = arrayBase + i;
+      auto gpr = getGprIndex(state, cf.exp.word0.RW_GPR() + i, cf.exp.word0.RW_REL(), SQ_INDEX_MODE::LOOP);
+      auto &src = state.gpr[gpr];
+      Vec4 *dst = nullptr;
+
+      switch (type) {
+      case SQ_EXPORT_TYPE::POS:
+         if (index >= 60 && index < 60 + MaxPositions) {
+            dst = &state.position[index - 60];
+         }
+         break;
+      case SQ_EXPORT_TYPE::PARAM:
+         if (index < MaxParams) {
+            dst = &state.params[index];
+         }
+         break;
+      case SQ_EXPORT_TYPE::PIXEL:
+         if (index == 61) {
+            state.depth = asFloat(sels[0] < SQ_SEL::SEL_0 ? src[sels[0]] : 0);
+            state.depthExported = true;
+         } else if (index < MaxRenderTargets) {
+            dst = &state.pixels[index];
+            state.pixelExportMask |= 1 << index;
+         }
+         break;
+      default:
+         return fail(ctx, fmt::format("Unsupported export type {}", type));
+      }
+
+      if (!dst) {
+         continue;
+      }
+
+      for (auto c = 0u; c < 4; ++c) {
+         switch (sels[c]) {
+         case SQ_SEL::SEL_X:
+         case SQ_SEL::SEL_Y:
+         case SQ_SEL::SEL_Z:
+         case SQ_SEL::SEL_W:
+            (*dst)[c] = src[sels[c]];
+            break;
+         case SQ_SEL::SEL_0:
+            (*dst)[c] = 0;
+            break;
+         case SQ_SEL::SEL_1:
+            (*dst)[c] = asUint(1.0f);
+            break;
+         default:
+            break;
+         }
+      }
+   }
+
+   return true;
+}
+
+static bool
+runProgram(Context &ctx,
+           gsl::span<const uint8_t> program);
+
+static bool
+runNormal(Context &ctx,
+          gsl::span<const uint8_t> program,
+          const ControlFlowInst &cf,
+          size_t &pc,
+          bool &done)
+{
+   auto &state = ctx.state;
+   auto active = false;
+
+   switch (cf.word1.CF_INST()) {
+   case SQ_CF_INST_NOP:
+   case SQ_CF_INST_JUMP:
+   case SQ_CF_INST_END_PROGRAM:
+   case SQ_CF_INST_WAIT_ACK:
+   case SQ_CF_INST_TEX_ACK:
+   case SQ_CF_INST_VTX_ACK:
+   case SQ_CF_INST_VTX_TC_ACK:
+      break;
+   case SQ_CF_INST_TEX:
+   case SQ_CF_INST_VTX:
+   case SQ_CF_INST_VTX_TC:
+      if (!checkCondition(ctx, cf.word1.COND(), active)) {
+         return false;
+      }
+
+      if (active && !runFetchClause(ctx, cf, program)) {
+         return false;
+      }
+      break;
+   case SQ_CF_INST_CALL_FS:
+      if (!runProgram(ctx, ctx.resources.fetchProgram)) {
+         return false;
+      }
+      break;
+   case SQ_CF_INST_RETURN:
+      done = true;
+      break;
+   case SQ_CF_INST_KILL:
+      if (!checkCondition(ctx, cf.word1.COND(), active)) {
+         return false;
+      }
+
+      if (active) {
+         state.killed = true;
+      }
+      break;
+   case SQ_CF_INST_PUSH:
+      if (!pushStack(ctx)) {
+         return false;
+      }
+      break;
+   case SQ_CF_INST_ELSE:
+      if (!elseStack(ctx)) {
+         return false;
+      }
+      break;
+   case SQ_CF_INST_POP:
+      if (!popStack(ctx, cf.word1.POP_COUNT())) {
+         return false;
+      }
+      break;
+   case SQ_CF_INST_LOOP_START_DX10:
+   {
+      if (!checkCondition(ctx, cf.word1.COND(), active)) {
+         return false;
+      }
+
+      if (!active) {
+         // Skip over the whole loop including its LOOP_END
+         pc = cf.word0.ADDR;
+         return true;
+      }
+
+      if (ctx.loopDepth >= MaxLoopDepth) {
+         return fail(ctx, "Loop nesting too deep");
+      }
+
+      if (!pushStack(ctx)) {
+         return false;
+      }
+
+      auto &loop = ctx.loops[ctx.loopDepth++];
+      loop.startPC = pc + 1;
+      loop.endPC = cf.word0.ADDR - 1;
+      loop.iterations = 0;
+      break;
+   }
+   case SQ_CF_INST_LOOP_END:
+   {
+      if (ctx.loopDepth == 0) {
+         return fail(ctx, "LOOP_END without a matching loop start");
+      }
+
+      auto &loop = ctx.loops[ctx.loopDepth - 1];
+      auto again = false;
+
+      if (state.activeMask != InactiveBreak) {
+         if (state.activeMask == InactiveContinue) {
+            state.activeMask = Active;
+         }
+
+         if (!checkCondition(ctx, cf.word1.COND(), again)) {
+            return false;
+         }
+      }
+
+      if (again && ++loop.iterations < MaxLoopIterations) {
+         pc = loop.startPC;
+         return true;
+      }
+
+      ctx.loopDepth--;
+
+      if (!popStack(ctx, 1)) {
+         return false;
+      }
+      break;
+   }
+   case SQ_CF_INST_LOOP_BREAK:
+      if (!checkCondition(ctx, cf.word1.COND(), active)) {
+         return false;
+      }
+
+      if (active) {
+         state.activeMask = InactiveBreak;
+      }
+      break;
+   case SQ_CF_INST_LOOP_CONTINUE:
+      if (!checkCondition(ctx, cf.word1.COND(), active)) {
+         return false;
+      }
+
+      if (active) {
+         state.activeMask = InactiveContinue;
+      }
+      break;
+   default:
+      return fail(ctx, fmt::format("Unsupported CF instruction {}", getInstructionName(cf.word1.CF_INST())));
+   }
+
+   pc++;
+   return true;
+}
+
+static bool
+runControlFlowAlu(Context &ctx,
+                  gsl::span<const uint8_t> program,
+                  const ControlFlowInst &cf)
+{
+   auto &state = ctx.state;
+   auto id = cf.alu.word1.CF_INST();
+
+   if (cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_ALU_EXTENDED) {
+      return fail(ctx, "Unsupported extended ALU clause");
+   }
+
+   if (id == SQ_CF_INST_ALU_PUSH_BEFORE && !pushStack(ctx)) {
+      return false;
+   }
+
+   if (state.activeMask == Active && !runAluClause(ctx, cf, program)) {
+      return false;
+   }
+
+   switch (id) {
+   case SQ_CF_INST_ALU_POP_AFTER:
+      return popStack(ctx, 1);
+   case SQ_CF_INST_ALU_POP2_AFTER:
+      return popStack(ctx, 2);
+   case SQ_CF_INST_ALU_ELSE_AFTER:
+      return elseStack(ctx);
+   case SQ_CF_INST_ALU_BREAK:
+      if (!state.predicate) {
+         state.activeMask = InactiveBreak;
+      }
+      return true;
+   case SQ_CF_INST_ALU_CONTINUE:
+      if (!state.predicate) {
+         state.activeMask = InactiveContinue;
+      }
+      return true;
+   default:
+      return true;
+   }
+}
+
+static bool
+runProgram(Context &ctx,
+           gsl::span<const uint8_t> program)
+{
+   auto pc = size_t { 0 };
+   auto done = false;
+   auto steps = 0u;
+
+   while (!done) {
+      if ((pc + 1) * sizeof(ControlFlowInst) > program.size()) {
+         return fail(ctx, "Control flow ran past the end of the program");
+      }
+
+      if (++steps > MaxLoopIterations * 64) {
+         return fail(ctx, "Shader did not terminate");
+      }
+
+      auto &cf = *reinterpret_cast<const ControlFlowInst *>(program.data() + pc * sizeof(ControlFlowInst));
+
+      switch (cf.word1.CF_INST_TYPE()) {
+      case SQ_CF_INST_TYPE_NORMAL:
+         if (!runNormal(ctx, program, cf, pc, done)) {
+            return false;
+         }
+
+         done = done || cf.word1.END_OF_PROGRAM();
+         break;
+      case SQ_CF_INST_TYPE_EXPORT:
+         if (cf.exp.word1.CF_INST() == SQ_CF_INST_EXP || cf.exp.word1.CF_INST() == SQ_CF_INST_EXP_DONE) {
+            if (!runExport(ctx, cf)) {
+               return false;
+            }
+         }
+
+         done = cf.exp.word1.END_OF_PROGRAM();
+         pc++;
+         break;
+      case SQ_CF_INST_TYPE_ALU:
+      case SQ_CF_INST_TYPE_ALU_EXTENDED:
+         if (!runControlFlowAlu(ctx, program, cf)) {
+            return false;
+         }
+
+         pc++;
+         break;
+      default:
+         return fail(ctx, "Invalid control flow instruction type");
+      }
+   }
+
+   return true;
+}
+
+bool
+runShader(const ShaderResources &resources,
+          ShaderState &state,
+          std::string &error)
+{
+   auto ctx = Context { resources, state, error };
+   state.pv = { 0, 0, 0, 0 };
+   state.ps = 0;
+   state.ar = { 0, 0, 0, 0 };
+   state.al = 0;
+   state.predicate = false;
+   state.activeMask = Active;
+   state.stackSize = 0;
+   state.pixelExportMask = 0;
+   state.depthExported = false;
+   state.killed = false;
+   return runProgram(ctx, resources.program);
+}
+
+uint32_t
+getTextureUsageMask(gsl::span<const uint8_t> program)
+{
+   auto mask = 0u;
+
+   for (auto i = 0u; (i + 1) * sizeof(ControlFlowInst) <= program.size(); ++i) {
+      auto &cf = *reinterpret_cast<const ControlFlowInst *>(program.data() + i * sizeof(ControlFlowInst));
+
+      if (cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_NORMAL && cf.word1.CF_INST() == SQ_CF_INST_TEX) {
+         auto addr = cf.word0.ADDR;
+         auto count = (cf.word1.COUNT() + 1) | (cf.word1.COUNT_3() << 3);
+
+         for (auto j = 0u; j < count && 8ull * addr + 16ull * (j + 1) <= program.size(); ++j) {
+            auto &tex = *reinterpret_cast<const TextureFetchInst *>(program.data() + 8 * addr + 16 * j);
+
+            if (tex.word0.RESOURCE_ID() < MaxTextures) {
+               mask |= 1u << tex.word0.RESOURCE_ID();
+            }
+         }
+      }
+
+      if ((cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_NORMAL || cf.word1.CF_INST_TYPE() == SQ_CF_INST_TYPE_EXPORT)
+       && cf.word1.END_OF_PROGRAM()) {
+         break;
+      }
+   }
+
+   return mask;
+}
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,100 @@
+#pragma once
+#include "sw_format.h"
+#include "sw_texture.h"
+#include "gpu/latte_constants.h"
+
+#include <array>
+#include <cstdint>
+#include <gsl.h>
+#include <string>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+enum class ShaderType
+{
+   Vertex,
+   Pixel,
+};
+
+//! Everything besides its own registers a shader invocation can read. This
+//  is set up once per draw and shared read only between the worker threads.
+struct ShaderResources
+{
+   ShaderType type = ShaderType::Vertex;
+   gsl::span<const uint8_t> program;
+   gsl::span<const uint8_t> fetchProgram;
+
+   //! Register file snapshot used for vertex fetch resources and semantics
+   const uint32_t *registers = nullptr;
+
+   //! Uniform registers when SQ_CONFIG.DX9_CONSTS is set, otherwise null
+   const uint32_t *uniformRegisters = nullptr;
+
+   //! Uniform blocks, sizes are in 32 bit words
+   std::array<const uint32_t *, latte::MaxUniformBlocks> uniformBlocks;
+   std::array<uint32_t, latte::MaxUniformBlocks> uniformBlockSizes;
+
+   std::array<const Texture *, latte::MaxTextures> textures;
+   std::array<Sampler, latte::MaxSamplers> samplers;
+};
+
+enum ActiveMask : uint8_t
+{
+   Active,
+   InactiveBranch,
+   InactiveBreak,
+   InactiveContinue,
+};
+
+static const uint32_t MaxStackDepth = 32;
+static const uint32_t MaxLoopDepth = 8;
+static const uint32_t MaxParams = 32;
+static const uint32_t MaxPositions = 4;
+
+//! The state of a single shader invocation.
+struct ShaderState
+{
+   std::array<Vec4, 128> gpr;
+   Vec4 pv;
+   uint32_t ps;
+   std::array<int32_t, 4> ar;
+   int32_t al;
+   bool predicate;
+
+   ActiveMask activeMask;
+   std::array<ActiveMask, MaxStackDepth> stack;
+   uint32_t stackSize;
+
+   //! Inputs for a vertex shader
+   uint32_t vertexId;
+   uint32_t instanceId;
+
+   //! Exports
+   std::array<Vec4, MaxPositions> position;
+   std::array<Vec4, MaxParams> params;
+   std::array<Vec4, latte::MaxRenderTargets> pixels;
+   uint32_t pixelExportMask;
+   float depth;
+   bool depthExported;
+   bool killed;
+};
+
+//! Run a shader program, returns false if it uses an instruction we
+//  cannot interpret in which case error describes it.
+bool
+runShader(const ShaderResources &resources,
+          ShaderState &state,
+          std::string &error);
+
+//! Returns a mask of the texture resources read by the TEX clauses of a
+//  program, so only those need to be decoded before a draw.
+uint32_t
+getTextureUsageMask(gsl::span<const uint8_t> program);
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,281 @@
+#include "sw_surface.h"
+#include "gpu/gpu_tiling.h"
+#include "gpu/gpu_utilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <common/bit_cast.h>
+#include <cstring>
+#include <libcpu/mem.h>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+static void
+initSurfaceLayout(Surface &surface,
+                  uint32_t base256b,
+                  uint32_t pitchTileMax,
+                  uint32_t sliceTileMax,
+                  latte::BUFFER_ARRAY_MODE arrayMode,
+                  uint32_t bpp)
+{
+   // Same address and swizzle decoding as the OpenGL surface cache
+   auto baseAddress = (base256b << 8) & 0xFFFFF800;
+   auto pitch = (pitchTileMax + 1) * latte::MicroTileWidth;
+   auto height = ((sliceTileMax + 1) * (latte::MicroTileWidth * latte::MicroTileHeight)) / pitch;
+
+   surface.swizzle = baseAddress & 0xFFF;
+   surface.baseAddress = baseAddress;
+   surface.pitch = pitch;
+   surface.height = height;
+   surface.tileMode = getArrayModeTileMode(arrayMode);
+   surface.elementBytes = bpp / 8;
+   surface.memorySize = pitch * height * surface.elementBytes;
+}
+
+bool
+initColorSurface(Surface &surface,
+                 latte::CB_COLORN_BASE cb_color_base,
+                 latte::CB_COLORN_SIZE cb_color_size,
+                 latte::CB_COLORN_INFO cb_color_info)
+{
+   auto format = DataFormat { };
+   format.format = static_cast<latte::SQ_DATA_FORMAT>(cb_color_info.FORMAT());
+
+   switch (cb_color_info.NUMBER_TYPE()) {
+   case latte::CB_NUMBER_TYPE::UNORM:
+      break;
+   case latte::CB_NUMBER_TYPE::SNORM:
+      format.formatComp = latte::SQ_FORMAT_COMP::SIGNED;
+      break;
+   case latte::CB_NUMBER_TYPE::UINT:
+      format.numFormat = latte::SQ_NUM_FORMAT::INT;
+      break;
+   case latte::CB_NUMBER_TYPE::SINT:
+      format.numFormat = latte::SQ_NUM_FORMAT::INT;
+      format.formatComp = latte::SQ_FORMAT_COMP::SIGNED;
+      break;
+   case latte::CB_NUMBER_TYPE::FLOAT:
+      format.numFormat = latte::SQ_NUM_FORMAT::SCALED;
+      break;
+   case latte::CB_NUMBER_TYPE::SRGB:
+      format.degamma = true;
+      break;
+   default:
+      return false;
+   }
+
+   auto bytes = getElementBytes(format.format);
+
+   if (!bytes || bytes * 8 != getDataFormatBitsPerElement(format.format)) {
+      return false;
+   }
+
+   initSurfaceLayout(surface,
+                     cb_color_base.BASE_256B(),
+                     cb_color_size.PITCH_TILE_MAX(),
+                     cb_color_size.SLICE_TILE_MAX(),
+                     cb_color_info.ARRAY_MODE(),
+                     bytes * 8);
+
+   surface.isDepth = false;
+   surface.format = format;
+   return true;
+}
+
+bool
+initDepthSurface(Surface &surface,
+                 latte::DB_DEPTH_BASE db_depth_base,
+                 latte::DB_DEPTH_SIZE db_depth_size,
+                 latte::DB_DEPTH_INFO db_depth_info)
+{
+   auto bpp = 0u;
+
+   switch (db_depth_info.FORMAT()) {
+   case latte::DB_FORMAT::DEPTH_16:
+      bpp = 16;
+      break;
+   case latte::DB_FORMAT::DEPTH_8_24:
+   case latte::DB_FORMAT::DEPTH_32_FLOAT:
+      bpp = 32;
+      break;
+   case latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT:
+      bpp = 64;
+      break;
+   default:
+      return false;
+   }
+
+   initSurfaceLayout(surface,
+                     db_depth_base.BASE_256B(),
+                     db_depth_size.PITCH_TILE_MAX(),
+                     db_depth_size.SLICE_TILE_MAX(),
+                     db_depth_info.ARRAY_MODE(),
+                     bpp);
+
+   surface.isDepth = true;
+   surface.depthFormat = db_depth_info.FORMAT();
+   return true;
+}
+
+void
+loadSurface(Surface &surface)
+{
+   surface.data.resize(surface.memorySize);
+   convertFromTiled(surface.data.data(),
+                    surface.pitch,
+                    mem::translate<uint8_t>(surface.baseAddress),
+                    surface.tileMode,
+                    surface.swizzle,
+                    surface.pitch,
+                    surface.pitch,
+                    surface.height,
+                    1,
+                    0,
+                    surface.isDepth,
+                    surface.elementBytes * 8);
+   surface.valid = true;
+   surface.dirty = false;
+}
+
+void
+storeSurface(Surface &surface)
+{
+   convertToTiled(mem::translate<uint8_t>(surface.baseAddress),
+                  surface.data.data(),
+                  surface.pitch,
+                  surface.tileMode,
+                  surface.swizzle,
+                  surface.pitch,
+                  surface.pitch,
+                  surface.height,
+                  1,
+                  0,
+                  surface.isDepth,
+                  surface.elementBytes * 8);
+   surface.dirty = false;
+}
+
+float
+quantiseDepth(const Surface &surface,
+              float depth)
+{
+   auto clamped = std::min(std::max(depth, 0.0f), 1.0f);
+
+   switch (surface.depthFormat) {
+   case latte::DB_FORMAT::DEPTH_16:
+      return std::floor(clamped * 65535.0f + 0.5f) / 65535.0f;
+   case latte::DB_FORMAT::DEPTH_8_24:
+      return std::floor(clamped * 16777215.0f + 0.5f) / 16777215.0f;
+   default:
+      return clamped;
+   }
+}
+
+float
+readDepth(const Surface &surface,
+          uint32_t x,
+          uint32_t y)
+{
+   auto src = getSurfaceElement(surface, x, y);
+   auto value = uint32_t { 0 };
+
+   switch (surface.depthFormat) {
+   case latte::DB_FORMAT::DEPTH_16:
+      value = static_cast<uint32_t>(src[0] | (src[1] << 8));
+      return static_cast<float>(value) / 65535.0f;
+   case latte::DB_FORMAT::DEPTH_8_24:
+      std::memcpy(&value, src, 4);
+      return static_cast<float>(value & 0xFFFFFF) / 16777215.0f;
+   case latte::DB_FORMAT::DEPTH_32_FLOAT:
+   case latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT:
+      std::memcpy(&value, src, 4);
+      return bit_cast<float>(value);
+   default:
+      return 0.0f;
+   }
+}
+
+void
+writeDepth(Surface &surface,
+           uint32_t x,
+           uint32_t y,
+           float depth)
+{
+   auto dst = getSurfaceElement(surface, x, y);
+   auto value = uint32_t { 0 };
+   auto clamped = std::min(std::max(depth, 0.0f), 1.0f);
+
+   switch (surface.depthFormat) {
+   case latte::DB_FORMAT::DEPTH_16:
+      value = static_cast<uint32_t>(clamped * 65535.0f + 0.5f);
+      dst[0] = static_cast<uint8_t>(value);
+      dst[1] = static_cast<uint8_t>(value >> 8);
+      break;
+   case latte::DB_FORMAT::DEPTH_8_24:
+      std::memcpy(&value, dst, 4);
+      value &= 0xFF000000;
+      value |= static_cast<uint32_t>(clamped * 16777215.0f + 0.5f) & 0xFFFFFF;
+      std::memcpy(dst, &value, 4);
+      break;
+   case latte::DB_FORMAT::DEPTH_32_FLOAT:
+   case latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT:
+      value = bit_cast<uint32_t>(clamped);
+      std::memcpy(dst, &value, 4);
+      break;
+   default:
+      break;
+   }
+}
+
+uint8_t
+readStencil(const Surface &surface,
+            uint32_t x,
+            uint32_t y)
+{
+   auto src = getSurfaceElement(surface, x, y);
+
+   switch (surface.depthFormat) {
+   case latte::DB_FORMAT::DEPTH_8_24:
+      return src[3];
+   case latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT:
+      return src[4];
+   default:
+      return 0;
+   }
+}
+
+void
+writeStencil(Surface &surface,
+             uint32_t x,
+             uint32_t y,
+             uint8_t stencil)
+{
+   auto dst = getSurfaceElement(surface, x, y);
+
+   switch (surface.depthFormat) {
+   case latte::DB_FORMAT::DEPTH_8_24:
+      dst[3] = stencil;
+      break;
+   case latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT:
+      dst[4] = stencil;
+      break;
+   default:
+      break;
+   }
+}
+
+bool
+hasStencil(latte::DB_FORMAT format)
+{
+   return format == latte::DB_FORMAT::DEPTH_8_24
+       || format == latte::DB_FORMAT::DEPTH_8_24_FLOAT
+       || format == latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT;
+}
+
+} // namespace sw
+
+} // namespace gpu
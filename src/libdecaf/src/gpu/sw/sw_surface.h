@@ -0,0 +1,117 @@
+#pragma once
+#include "sw_format.h"
+#include "gpu/latte_registers.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+//! A colour or depth buffer kept untiled in host memory while it is being
+//  rendered to, it is only tiled back into guest memory at sync points.
+struct Surface
+{
+   uint32_t baseAddress = 0;
+   uint32_t swizzle = 0;
+   uint32_t pitch = 0;
+   uint32_t height = 0;
+   latte::SQ_TILE_MODE tileMode = latte::SQ_TILE_MODE::LINEAR_ALIGNED;
+
+   //! Colour buffers pack elements with format, depth buffers use depthFormat
+   bool isDepth = false;
+   DataFormat format;
+   latte::DB_FORMAT depthFormat = latte::DB_FORMAT::DEPTH_INVALID;
+
+   //! Bytes per element and size of the surface in guest memory
+   uint32_t elementBytes = 0;
+   uint32_t memorySize = 0;
+
+   //! Untiled elements, pitch * height * elementBytes bytes
+   std::vector<uint8_t> data;
+
+   //! data holds the current guest memory contents
+   bool valid = false;
+
+   //! data has been rendered to since it was last stored to guest memory
+   bool dirty = false;
+};
+
+//! Set up a colour surface from the CB_COLORn registers, returns false if
+//  the format cannot be rendered to in software.
+bool
+initColorSurface(Surface &surface,
+                 latte::CB_COLORN_BASE cb_color_base,
+                 latte::CB_COLORN_SIZE cb_color_size,
+                 latte::CB_COLORN_INFO cb_color_info);
+
+//! Set up a depth surface from the DB_DEPTH registers, returns false if
+//  the format cannot be rendered to in software.
+bool
+initDepthSurface(Surface &surface,
+                 latte::DB_DEPTH_BASE db_depth_base,
+                 latte::DB_DEPTH_SIZE db_depth_size,
+                 latte::DB_DEPTH_INFO db_depth_info);
+
+//! Untile the guest memory of a surface into its host copy.
+void
+loadSurface(Surface &surface);
+
+//! Tile the host copy of a surface back into guest memory.
+void
+storeSurface(Surface &surface);
+
+inline uint8_t *
+getSurfaceElement(Surface &surface,
+                  uint32_t x,
+                  uint32_t y)
+{
+   return surface.data.data() + (y * surface.pitch + x) * surface.elementBytes;
+}
+
+inline const uint8_t *
+getSurfaceElement(const Surface &surface,
+                  uint32_t x,
+                  uint32_t y)
+{
+   return surface.data.data() + (y * surface.pitch + x) * surface.elementBytes;
+}
+
+//! Round a depth value to the precision of the surface format, so depth
+//  tests compare against exactly what writeDepth would have stored.
+float
+quantiseDepth(const Surface &surface,
+              float depth);
+
+float
+readDepth(const Surface &surface,
+          uint32_t x,
+          uint32_t y);
+
+void
+writeDepth(Surface &surface,
+           uint32_t x,
+           uint32_t y,
+           float depth);
+
+//! Depth formats without a stencil channel read as 0 and ignore writes.
+uint8_t
+readStencil(const Surface &surface,
+            uint32_t x,
+            uint32_t y);
+
+void
+writeStencil(Surface &surface,
+             uint32_t x,
+             uint32_t y,
+             uint8_t stencil);
+
+bool
+hasStencil(latte::DB_FORMAT format);
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,460 @@
+#include "sw_texture.h"
+#include "gpu/gpu_tiling.h"
+#include "gpu/gpu_utilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <common/bit_cast.h>
+#include <common/murmur3.h>
+#include <libcpu/mem.h>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+static inline uint32_t
+floatBits(float value)
+{
+   return bit_cast<uint32_t>(value);
+}
+
+static void
+decodeColorBlock(const uint8_t *src,
+                 bool allowAlpha,
+                 float colors[16][4])
+{
+   auto color0 = static_cast<uint32_t>(src[0] | (src[1] << 8));
+   auto color1 = static_cast<uint32_t>(src[2] | (src[3] << 8));
+   auto indices = static_cast<uint32_t>(src[4] | (src[5] << 8) | (src[6] << 16) | (src[7] << 24));
+   float palette[4][4];
+
+   auto unpack565 = [](uint32_t color, float *out) {
+      out[0] = static_cast<float>((color >> 11) & 0x1F) / 31.0f;
+      out[1] = static_cast<float>((color >> 5) & 0x3F) / 63.0f;
+      out[2] = static_cast<float>(color & 0x1F) / 31.0f;
+      out[3] = 1.0f;
+   };
+
+   unpack565(color0, palette[0]);
+   unpack565(color1, palette[1]);
+
+   for (auto c = 0u; c < 4; ++c) {
+      if (color0 > color1 || !allowAlpha) {
+         palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+         palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+      } else {
+         palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+         palette[3][c] = 0.0f;
+      }
+   }
+
+   for (auto i = 0u; i < 16; ++i) {
+      auto index = (indices >> (i * 2)) & 3;
+      std::copy(palette[index], palette[index] + 4, colors[i]);
+   }
+}
+
+static void
+decodeAlphaBlock(const uint8_t *src,
+                 float alpha[16])
+{
+   float palette[8];
+   palette[0] = static_cast<float>(src[0]) / 255.0f;
+   palette[1] = static_cast<float>(src[1]) / 255.0f;
+
+   if (src[0] > src[1]) {
+      for (auto i = 1u; i < 7; ++i) {
+         palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7.0f;
+      }
+   } else {
+      for (auto i = 1u; i < 5; ++i) {
+         palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5.0f;
+      }
+
+      palette[6] = 0.0f;
+      palette[7] = 1.0f;
+   }
+
+   auto indices = uint64_t { 0 };
+
+   for (auto i = 0u; i < 6; ++i) {
+      indices |= static_cast<uint64_t>(src[2 + i]) << (i * 8);
+   }
+
+   for (auto i = 0u; i < 16; ++i) {
+      alpha[i] = palette[(indices >> (i * 3)) & 7];
+   }
+}
+
+static void
+decodeCompressedBlock(latte::SQ_DATA_FORMAT format,
+                      const uint8_t *src,
+                      float texels[16][4])
+{
+   float alpha[16];
+
+   switch (format) {
+   case latte::SQ_DATA_FORMAT::FMT_BC1:
+      decodeColorBlock(src, true, texels);
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_BC2:
+      decodeColorBlock(src + 8, false, texels);
+
+      for (auto i = 0u; i < 16; ++i) {
+         texels[i][3] = static_cast<float>((src[i / 2] >> ((i & 1) * 4)) & 0xF) / 15.0f;
+      }
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_BC3:
+      decodeColorBlock(src + 8, false, texels);
+      decodeAlphaBlock(src, alpha);
+
+      for (auto i = 0u; i < 16; ++i) {
+         texels[i][3] = alpha[i];
+      }
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_BC4:
+      decodeAlphaBlock(src, alpha);
+
+      for (auto i = 0u; i < 16; ++i) {
+         texels[i][0] = alpha[i];
+         texels[i][1] = 0.0f;
+         texels[i][2] = 0.0f;
+         texels[i][3] = 1.0f;
+      }
+      break;
+   case latte::SQ_DATA_FORMAT::FMT_BC5:
+      decodeAlphaBlock(src, alpha);
+
+      for (auto i = 0u; i < 16; ++i) {
+         texels[i][0] = alpha[i];
+         texels[i][2] = 0.0f;
+         texels[i][3] = 1.0f;
+      }
+
+      decodeAlphaBlock(src + 8, alpha);
+
+      for (auto i = 0u; i < 16; ++i) {
+         texels[i][1] = alpha[i];
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+static inline uint32_t
+applySelect(const Vec4 &value,
+            latte::SQ_SEL sel,
+            bool isInteger)
+{
+   switch (sel) {
+   case latte::SQ_SEL::SEL_X:
+   case latte::SQ_SEL::SEL_Y:
+   case latte::SQ_SEL::SEL_Z:
+   case latte::SQ_SEL::SEL_W:
+      return value[sel];
+   case latte::SQ_SEL::SEL_1:
+      return isInteger ? 1 : floatBits(1.0f);
+   case latte::SQ_SEL::SEL_0:
+   case latte::SQ_SEL::SEL_MASK:
+   default:
+      return 0;
+   }
+}
+
+bool
+decodeTexture(Texture &texture,
+              latte::SQ_TEX_RESOURCE_WORD0_N word0,
+              latte::SQ_TEX_RESOURCE_WORD1_N word1,
+              latte::SQ_TEX_RESOURCE_WORD2_N word2,
+              latte::SQ_TEX_RESOURCE_WORD4_N word4)
+{
+   auto dim = word0.DIM();
+   auto tileMode = word0.TILE_MODE();
+   auto pitch = (word0.PITCH() + 1) * 8;
+   auto width = word0.TEX_WIDTH() + 1;
+   auto height = word1.TEX_HEIGHT() + 1;
+   auto depth = word1.TEX_DEPTH() + 1;
+   auto baseAddress = word2.BASE_ADDRESS() << 8;
+   auto swizzle = word2.SWIZZLE() << 8;
+   auto isDepth = !!word0.TILE_TYPE();
+
+   auto format = DataFormat { };
+   format.format = word1.DATA_FORMAT();
+   format.numFormat = word4.NUM_FORMAT_ALL();
+   format.formatComp = word4.FORMAT_COMP_X();
+   format.degamma = word4.FORCE_DEGAMMA();
+
+   auto compressed = getDataFormatIsCompressed(format.format);
+
+   if (!compressed && !getElementBytes(format.format)) {
+      return false;
+   }
+
+   switch (dim) {
+   case latte::SQ_TEX_DIM::DIM_1D:
+   case latte::SQ_TEX_DIM::DIM_1D_ARRAY:
+   case latte::SQ_TEX_DIM::DIM_2D:
+   case latte::SQ_TEX_DIM::DIM_2D_ARRAY:
+   case latte::SQ_TEX_DIM::DIM_3D:
+      break;
+   case latte::SQ_TEX_DIM::DIM_CUBEMAP:
+      depth *= 6;
+      break;
+   default:
+      return false;
+   }
+
+   if (tileMode >= latte::SQ_TILE_MODE::TILED_2D_THIN1) {
+      baseAddress &= ~(0x800 - 1);
+   } else {
+      baseAddress &= ~(0x100 - 1);
+   }
+
+   auto srcWidth = width;
+   auto srcHeight = height;
+   auto srcPitch = pitch;
+
+   if (compressed) {
+      srcWidth = (srcWidth + 3) / 4;
+      srcHeight = (srcHeight + 3) / 4;
+      srcPitch = srcPitch / 4;
+   }
+
+   auto bpp = getDataFormatBitsPerElement(format.format);
+   auto srcImageSize = srcPitch * srcHeight * depth * bpp / 8;
+   auto image = mem::translate<uint8_t>(baseAddress);
+
+   // Skip decoding if the guest memory has not changed since last time
+   uint64_t newHash[2] = { 0, 0 };
+   MurmurHash3_x64_128(image, srcImageSize, 0, newHash);
+
+   if (texture.texels.size()
+    && texture.baseAddress == baseAddress
+    && texture.memorySize == srcImageSize
+    && texture.memoryHash[0] == newHash[0]
+    && texture.memoryHash[1] == newHash[1]) {
+      return true;
+   }
+
+   auto untiled = std::vector<uint8_t>(srcWidth * srcHeight * depth * bpp / 8);
+   convertFromTiled(untiled.data(), srcWidth, image, tileMode, swizzle, srcPitch,
+                    srcWidth, srcHeight, depth, 0, isDepth, bpp);
+
+   texture.dim = dim;
+   texture.width = width;
+   texture.height = height;
+   texture.depth = depth;
+   texture.isInteger = (format.numFormat == latte::SQ_NUM_FORMAT::INT);
+   texture.baseAddress = baseAddress;
+   texture.memorySize = srcImageSize;
+   texture.memoryHash[0] = newHash[0];
+   texture.memoryHash[1] = newHash[1];
+   texture.texels.resize(width * height * depth);
+
+   auto selX = word4.DST_SEL_X();
+   auto selY = word4.DST_SEL_Y();
+   auto selZ = word4.DST_SEL_Z();
+   auto selW = word4.DST_SEL_W();
+
+   auto store = [&](uint32_t x, uint32_t y, uint32_t z, const Vec4 &value) {
+      auto &texel = texture.texels[x + width * (y + height * z)];
+      texel[0] = applySelect(value, selX, texture.isInteger);
+      texel[1] = applySelect(value, selY, texture.isInteger);
+      texel[2] = applySelect(value, selZ, texture.isInteger);
+      texel[3] = applySelect(value, selW, texture.isInteger);
+   };
+
+   if (compressed) {
+      float block[16][4];
+
+      for (auto z = 0u; z < depth; ++z) {
+         for (auto by = 0u; by < srcHeight; ++by) {
+            for (auto bx = 0u; bx < srcWidth; ++bx) {
+               auto src = untiled.data() + ((z * srcHeight + by) * srcWidth + bx) * (bpp / 8);
+               decodeCompressedBlock(format.format, src, block);
+
+               for (auto i = 0u; i < 16; ++i) {
+                  auto x = bx * 4 + (i % 4);
+                  auto y = by * 4 + (i / 4);
+
+                  if (x >= width || y >= height) {
+                     continue;
+                  }
+
+                  auto value = Vec4 { floatBits(block[i][0]), floatBits(block[i][1]), floatBits(block[i][2]), floatBits(block[i][3]) };
+
+                  if (format.degamma) {
+                     for (auto c = 0u; c < 3; ++c) {
+                        auto v = block[i][c];
+                        v = (v <= 0.04045f) ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+                        value[c] = floatBits(v);
+                     }
+                  }
+
+                  store(x, y, z, value);
+               }
+            }
+         }
+      }
+   } else {
+      auto elementBytes = bpp / 8;
+
+      for (auto z = 0u; z < depth; ++z) {
+         for (auto y = 0u; y < height; ++y) {
+            auto src = untiled.data() + ((z * height + y) * width) * elementBytes;
+
+            for (auto x = 0u; x < width; ++x) {
+               store(x, y, z, unpackElement(src + x * elementBytes, format));
+            }
+         }
+      }
+   }
+
+   return true;
+}
+
+Sampler
+decodeSampler(latte::SQ_TEX_SAMPLER_WORD0_N word0)
+{
+   auto sampler = Sampler { };
+   sampler.clampX = word0.CLAMP_X();
+   sampler.clampY = word0.CLAMP_Y();
+   sampler.clampZ = word0.CLAMP_Z();
+
+   // We have no derivatives to choose between minification and
+   //  magnification, so only filter when both agree.
+   if (word0.XY_MAG_FILTER() == latte::SQ_TEX_XY_FILTER::POINT
+    || word0.XY_MIN_FILTER() == latte::SQ_TEX_XY_FILTER::POINT) {
+      sampler.filter = latte::SQ_TEX_XY_FILTER::POINT;
+   } else {
+      sampler.filter = latte::SQ_TEX_XY_FILTER::BILINEAR;
+   }
+
+   sampler.compareFunc = word0.DEPTH_COMPARE_FUNCTION();
+   return sampler;
+}
+
+static inline int32_t
+applyClamp(latte::SQ_TEX_CLAMP clamp,
+           int32_t coord,
+           int32_t size)
+{
+   switch (clamp) {
+   case latte::SQ_TEX_CLAMP::WRAP:
+      coord %= size;
+      return coord < 0 ? coord + size : coord;
+   case latte::SQ_TEX_CLAMP::MIRROR:
+   {
+      auto period = size * 2;
+      coord %= period;
+      coord = coord < 0 ? coord + period : coord;
+      return coord >= size ? period - 1 - coord : coord;
+   }
+   case latte::SQ_TEX_CLAMP::MIRROR_ONCE_LAST_TEXEL:
+   case latte::SQ_TEX_CLAMP::MIRROR_ONCE_HALF_BORDER:
+      coord = coord < 0 ? -1 - coord : coord;
+      return std::min(coord, size - 1);
+   default:
+      return std::min(std::max(coord, 0), size - 1);
+   }
+}
+
+Vec4
+fetchTexel(const Texture &texture,
+           int32_t x,
+           int32_t y,
+           int32_t z)
+{
+   if (x < 0 || y < 0 || z < 0
+    || x >= static_cast<int32_t>(texture.width)
+    || y >= static_cast<int32_t>(texture.height)
+    || z >= static_cast<int32_t>(texture.depth)) {
+      return Vec4 { 0, 0, 0, 0 };
+   }
+
+   return texture.texels[x + texture.width * (y + texture.height * z)];
+}
+
+Vec4
+sampleTexture(const Texture &texture,
+              const Sampler &sampler,
+              float s,
+              float t,
+              float r)
+{
+   auto width = static_cast<int32_t>(texture.width);
+   auto height = static_cast<int32_t>(texture.height);
+   auto depth = static_cast<int32_t>(texture.depth);
+   auto slice = 0;
+
+   if (texture.dim == latte::SQ_TEX_DIM::DIM_3D) {
+      slice = applyClamp(sampler.clampZ, static_cast<int32_t>(std::floor(r * depth)), depth);
+   } else if (depth > 1) {
+      slice = std::min(std::max(static_cast<int32_t>(std::floor(r + 0.5f)), 0), depth - 1);
+   }
+
+   auto x = s * width - 0.5f;
+   auto y = t * height - 0.5f;
+
+   if (texture.isInteger || sampler.filter == latte::SQ_TEX_XY_FILTER::POINT) {
+      auto ix = applyClamp(sampler.clampX, static_cast<int32_t>(std::floor(x + 0.5f)), width);
+      auto iy = applyClamp(sampler.clampY, static_cast<int32_t>(std::floor(y + 0.5f)), height);
+      return fetchTexel(texture, ix, iy, slice);
+   }
+
+   auto x0 = static_cast<int32_t>(std::floor(x));
+   auto y0 = static_cast<int32_t>(std::floor(y));
+   auto fx = x - static_cast<float>(x0);
+   auto fy = y - static_cast<float>(y0);
+   auto ix0 = applyClamp(sampler.clampX, x0, width);
+   auto ix1 = applyClamp(sampler.clampX, x0 + 1, width);
+   auto iy0 = applyClamp(sampler.clampY, y0, height);
+   auto iy1 = applyClamp(sampler.clampY, y0 + 1, height);
+
+   auto t00 = fetchTexel(texture, ix0, iy0, slice);
+   auto t10 = fetchTexel(texture, ix1, iy0, slice);
+   auto t01 = fetchTexel(texture, ix0, iy1, slice);
+   auto t11 = fetchTexel(texture, ix1, iy1, slice);
+   auto result = Vec4 { };
+
+   for (auto c = 0u; c < 4; ++c) {
+      auto top = bit_cast<float>(t00[c]) * (1.0f - fx) + bit_cast<float>(t10[c]) * fx;
+      auto bottom = bit_cast<float>(t01[c]) * (1.0f - fx) + bit_cast<float>(t11[c]) * fx;
+      result[c] = floatBits(top * (1.0f - fy) + bottom * fy);
+   }
+
+   return result;
+}
+
+bool
+compareDepth(latte::REF_FUNC func,
+             float reference,
+             float value)
+{
+   switch (func) {
+   case latte::REF_FUNC::NEVER:
+      return false;
+   case latte::REF_FUNC::LESS:
+      return reference < value;
+   case latte::REF_FUNC::EQUAL:
+      return reference == value;
+   case latte::REF_FUNC::LESS_EQUAL:
+      return reference <= value;
+   case latte::REF_FUNC::GREATER:
+      return reference > value;
+   case latte::REF_FUNC::NOT_EQUAL:
+      return reference != value;
+   case latte::REF_FUNC::GREATER_EQUAL:
+      return reference >= value;
+   case latte::REF_FUNC::ALWAYS:
+   default:
+      return true;
+   }
+}
+
+} // namespace sw
+
+} // namespace gpu
@@ -0,0 +1,81 @@
+#pragma once
+#include "sw_format.h"
+#include "gpu/latte_registers.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace gpu
+{
+
+namespace sw
+{
+
+//! Level 0 of a texture decoded to four raw channels per texel, with the
+//  resource DST_SEL swizzle already applied.
+struct Texture
+{
+   latte::SQ_TEX_DIM dim = latte::SQ_TEX_DIM::DIM_2D;
+   uint32_t width = 0;
+   uint32_t height = 0;
+
+   //! Number of slices, 6 for a cube map
+   uint32_t depth = 0;
+
+   //! Integer textures are never filtered
+   bool isInteger = false;
+
+   //! Guest memory this texture was decoded from
+   uint32_t baseAddress = 0;
+   uint32_t memorySize = 0;
+   uint64_t memoryHash[2] = { 0, 0 };
+
+   std::vector<Vec4> texels;
+};
+
+struct Sampler
+{
+   latte::SQ_TEX_CLAMP clampX = latte::SQ_TEX_CLAMP::WRAP;
+   latte::SQ_TEX_CLAMP clampY = latte::SQ_TEX_CLAMP::WRAP;
+   latte::SQ_TEX_CLAMP clampZ = latte::SQ_TEX_CLAMP::WRAP;
+   latte::SQ_TEX_XY_FILTER filter = latte::SQ_TEX_XY_FILTER::POINT;
+   latte::REF_FUNC compareFunc = latte::REF_FUNC::NEVER;
+};
+
+//! Untile and decode a texture from guest memory, returns false if the
+//  format or dimension is not supported by the software renderer.
+bool
+decodeTexture(Texture &texture,
+              latte::SQ_TEX_RESOURCE_WORD0_N word0,
+              latte::SQ_TEX_RESOURCE_WORD1_N word1,
+              latte::SQ_TEX_RESOURCE_WORD2_N word2,
+              latte::SQ_TEX_RESOURCE_WORD4_N word4);
+
+Sampler
+decodeSampler(latte::SQ_TEX_SAMPLER_WORD0_N word0);
+
+//! Sample with normalised s/t coordinates, r selects the slice of array,
+//  3D and cube textures.
+Vec4
+sampleTexture(const Texture &texture,
+              const Sampler &sampler,
+              float s,
+              float t,
+              float r);
+
+//! Read a single texel with unnormalised integer coordinates, out of
+//  range coordinates return zero.
+Vec4
+fetchTexel(const Texture &texture,
+           int32_t x,
+           int32_t y,
+           int32_t z);
+
+bool
+compareDepth(latte::REF_FUNC func,
+             float reference,
+             float value);
+
+} // namespace sw
+
+} // namespace gpu
@@ -1,5 +1,6 @@
 #include "kernel.h"
 #include "kernel_hle.h"
+#include "kernel_hletrace.h"
 #include "kernel_internal.h"
 #include "kernel_ios.h"
 #include "kernel_ipc.h"
@@ -21,7 +22,10 @@
 #include "modules/coreinit/coreinit_systeminfo.h"
 #include "modules/coreinit/coreinit_thread.h"
 #include "modules/coreinit/coreinit_interrupts.h"
+#include "modules/dmae/dmae_core.h"
 #include "modules/gx2/gx2_event.h"
+#include "modules/nsysnet/nsysnet_reactor.h"
+#include "modules/nsysnet/nsysnet_socket_lib.h"
 #include "libcpu/mem.h"
 #include "ppcutils/wfunc_call.h"
 #include <common/decaf_assert.h>
@@ -127,6 +131,9 @@ void
 shutdown()
 {
    ipcShutdown();
+   dmae::internal::stopDmaeThread();
+   nsysnet::internal::closeAllSockets();
+   nsysnet::internal::stopReactor();
 }
 
 TeenyHeap *
@@ -175,6 +182,12 @@ cpuFaultFiberEntryPoint(void *addr)
    //  and so that the debugger shows the right stop point.
    cpu::this_core::state()->nia -= 4;
 
+   // Keep the HLE calls which led up to the fault
+   if (decaf::config::log::kernel_trace && decaf::config::log::kernel_trace_dump) {
+      platform::createDirectory("dump");
+      dumpHleTrace("dump/kernel_trace.txt");
+   }
+
    // Alert the debugger if it cares.
    if (decaf::config::debugger::enabled) {
       coreinit::internal::pauseCoreTime(true);
@@ -293,6 +306,14 @@ cpuInterruptHandler(uint32_t interrupt_flags)
       kernel::ipcDriverKernelHandleInterrupt();
    }
 
+   if (interrupt_flags & cpu::NETWORK_INTERRUPT) {
+      nsysnet::internal::handleNetworkInterrupt();
+   }
+
+   if (interrupt_flags & cpu::DMAE_INTERRUPT) {
+      dmae::internal::handleDmaeInterrupt();
+   }
+
    coreinit::internal::enableScheduler();
    coreinit::OSRestoreInterrupts(originalInterruptState);
 
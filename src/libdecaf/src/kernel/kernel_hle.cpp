@@ -67,7 +67,11 @@ kcstub(cpu::Core *state, void *data)
 void
 registerHleFunc(HleFunction *func)
 {
-   func->syscallID = cpu::registerKernelCall({ kcstub, func });
+   if (func->valid && func->kcHandler) {
+      func->syscallID = cpu::registerKernelCall({ func->kcHandler, func, func->direct });
+   } else {
+      func->syscallID = cpu::registerKernelCall({ kcstub, func });
+   }
 }
 
 uint32_t
@@ -2,9 +2,11 @@
 #include <common/type_list.h>
 #include "decaf_config.h"
 #include "kernel_hlesymbol.h"
+#include "kernel_hletrace.h"
 #include "libcpu/state.h"
 #include "ppcutils/ppcinvoke.h"
 #include <cstdint>
+#include <type_traits>
 
 namespace kernel
 {
@@ -19,10 +21,19 @@ struct HleFunction : HleSymbol
    virtual ~HleFunction() override = default;
    virtual void call(cpu::Core *state) = 0;
 
+   //! Format a traced call, result is nullptr if the call has not returned
+   virtual std::string formatTrace(ppctypes::TracedCall *call, cpu::Core *result) = 0;
+
    bool valid = false;
    bool traceEnabled = true;
    uint32_t syscallID = 0;
    uint32_t vaddr = 0;
+
+   //! Kernel call handler specialised for the implementation type
+   cpu::KernelCallFunction kcHandler = nullptr;
+
+   //! Host function the JIT may call without going through kcHandler
+   cpu::KernelCallDirect direct;
 };
 
 namespace functions
@@ -30,47 +41,177 @@ namespace functions
 
 void kcTraceHandler(const std::string& str);
 
+// How a type is passed to or returned from a direct kernel call, see
+//  cpu::KernelCallDirect. Smaller than 32 bit integers are not supported as
+//  host calling conventions disagree on who extends them.
+template<typename Type, typename = void>
+struct DirectCallValue
+{
+   static constexpr bool supported = false;
+   static constexpr auto value = cpu::KernelCallValue::None;
+};
+
+template<>
+struct DirectCallValue<void>
+{
+   static constexpr bool supported = true;
+   static constexpr auto value = cpu::KernelCallValue::None;
+};
+
+template<>
+struct DirectCallValue<bool>
+{
+   static constexpr bool supported = true;
+   static constexpr auto value = cpu::KernelCallValue::Bool;
+};
+
+template<typename Type>
+struct DirectCallValue<Type *>
+{
+   static constexpr bool supported = true;
+   static constexpr auto value = cpu::KernelCallValue::Pointer;
+};
+
+template<typename Type>
+struct DirectCallValue<Type, typename std::enable_if<(std::is_integral<Type>::value || std::is_enum<Type>::value) && sizeof(Type) == 4>::type>
+{
+   static constexpr bool supported = true;
+   static constexpr auto value = cpu::KernelCallValue::Word;
+};
+
+template<typename Type>
+struct DirectCallValue<Type, typename std::enable_if<std::is_integral<Type>::value && sizeof(Type) == 8>::type>
+{
+   static constexpr bool supported = true;
+   static constexpr auto value = cpu::KernelCallValue::DoubleWord;
+};
+
+template<typename Type>
+struct DirectCallArg
+{
+   static constexpr bool supported = DirectCallValue<Type>::supported
+                                  && DirectCallValue<Type>::value != cpu::KernelCallValue::None
+                                  && DirectCallValue<Type>::value != cpu::KernelCallValue::DoubleWord;
+};
+
+template<typename... Args>
+struct DirectCallArgs;
+
+template<>
+struct DirectCallArgs<>
+{
+   static constexpr bool supported = true;
+};
+
+template<typename Head, typename... Tail>
+struct DirectCallArgs<Head, Tail...>
+{
+   static constexpr bool supported = DirectCallArg<Head>::supported && DirectCallArgs<Tail...>::supported;
+};
+
+// Kernel call entry point for a valid HLE function, specialised on the
+//  implementation type so the call goes straight to its call() instead of
+//  through kcstub and the virtual dispatch.
+template<typename FunctionType>
+inline void
+kcHandler(cpu::Core *state, void *data)
+{
+   auto func = static_cast<FunctionType *>(data);
+
+   // Allocate callee backchain and lr space and write the backchain pointer
+   auto backchainSp = state->gpr[1];
+   state->gpr[1] -= 2 * 4;
+   mem::write(state->gpr[1], backchainSp);
+
+   func->FunctionType::call(state);
+
+   // Grab the most recent core state as it may have changed.
+   state = cpu::this_core::state();
+   state->gpr[1] += 2 * 4;
+}
+
 template<typename ReturnType, typename... Args>
 struct HleFunctionImpl : HleFunction
 {
+   HleFunctionImpl()
+   {
+      kcHandler = &functions::kcHandler<HleFunctionImpl>;
+   }
+
    ReturnType (*wrapped_function)(Args...);
 
    virtual void call(cpu::Core *thread) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         if (decaf::config::log::kernel_trace_res) {
-            ppctypes::invoke(kcTraceHandler, kcTraceHandler, thread, wrapped_function, name);
+         auto trace = beginHleTrace(thread, this);
+
+         if (decaf::config::log::kernel_trace_log) {
+            if (decaf::config::log::kernel_trace_res) {
+               ppctypes::invoke(kcTraceHandler, kcTraceHandler, thread, wrapped_function, name);
+            } else {
+               ppctypes::invoke(kcTraceHandler, nullptr, thread, wrapped_function, name);
+            }
          } else {
-            ppctypes::invoke(kcTraceHandler, nullptr, thread, wrapped_function, name);
+            ppctypes::invoke(nullptr, nullptr, thread, wrapped_function, name);
          }
+
+         endHleTrace(trace, cpu::this_core::state());
       } else {
          ppctypes::invoke(nullptr, nullptr, thread, wrapped_function, name);
       }
    }
+
+   virtual std::string formatTrace(ppctypes::TracedCall *call, cpu::Core *result) override
+   {
+      return ppctypes::formatCall(call, result, wrapped_function, name);
+   }
 };
 
 template<typename ReturnType, typename ObjectType, typename... Args>
 struct HleMemberFunctionImpl : HleFunction
 {
+   HleMemberFunctionImpl()
+   {
+      kcHandler = &functions::kcHandler<HleMemberFunctionImpl>;
+   }
+
    ReturnType (ObjectType::*wrapped_function)(Args...);
 
    virtual void call(cpu::Core *thread) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         if (decaf::config::log::kernel_trace_res) {
-            ppctypes::invokeMemberFn(kcTraceHandler, kcTraceHandler, thread, wrapped_function, name);
+         auto trace = beginHleTrace(thread, this);
+
+         if (decaf::config::log::kernel_trace_log) {
+            if (decaf::config::log::kernel_trace_res) {
+               ppctypes::invokeMemberFn(kcTraceHandler, kcTraceHandler, thread, wrapped_function, name);
+            } else {
+               ppctypes::invokeMemberFn(kcTraceHandler, nullptr, thread, wrapped_function, name);
+            }
          } else {
-            ppctypes::invokeMemberFn(kcTraceHandler, nullptr, thread, wrapped_function, name);
+            ppctypes::invokeMemberFn(nullptr, nullptr, thread, wrapped_function, name);
          }
+
+         endHleTrace(trace, cpu::this_core::state());
       } else {
          ppctypes::invokeMemberFn(nullptr, nullptr, thread, wrapped_function, name);
       }
    }
+
+   virtual std::string formatTrace(ppctypes::TracedCall *call, cpu::Core *result) override
+   {
+      return ppctypes::formatMemberFnCall(call, result, wrapped_function, name);
+   }
 };
 
 template<typename ObjectType, typename... Args>
 struct HleConstructorFunctionImpl : HleFunction
 {
+   HleConstructorFunctionImpl()
+   {
+      kcHandler = &functions::kcHandler<HleConstructorFunctionImpl>;
+   }
+
    static void trampFunction(ObjectType *object, Args... args)
    {
       new (object) ObjectType(args...);
@@ -79,20 +220,38 @@ struct HleConstructorFunctionImpl : HleFunction
    virtual void call(cpu::Core *thread) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         if (decaf::config::log::kernel_trace_res) {
-            ppctypes::invoke(kcTraceHandler, kcTraceHandler, thread, &trampFunction, name);
+         auto trace = beginHleTrace(thread, this);
+
+         if (decaf::config::log::kernel_trace_log) {
+            if (decaf::config::log::kernel_trace_res) {
+               ppctypes::invoke(kcTraceHandler, kcTraceHandler, thread, &trampFunction, name);
+            } else {
+               ppctypes::invoke(kcTraceHandler, nullptr, thread, &trampFunction, name);
+            }
          } else {
-            ppctypes::invoke(kcTraceHandler, nullptr, thread, &trampFunction, name);
+            ppctypes::invoke(nullptr, nullptr, thread, &trampFunction, name);
          }
+
+         endHleTrace(trace, cpu::this_core::state());
       } else {
          ppctypes::invoke(nullptr, nullptr, thread, &trampFunction, name);
       }
    }
+
+   virtual std::string formatTrace(ppctypes::TracedCall *call, cpu::Core *result) override
+   {
+      return ppctypes::formatCall(call, result, &trampFunction, name);
+   }
 };
 
 template<typename ObjectType>
 struct HleDestructorFunctionImpl : HleFunction
 {
+   HleDestructorFunctionImpl()
+   {
+      kcHandler = &functions::kcHandler<HleDestructorFunctionImpl>;
+   }
+
    static void trampFunction(ObjectType *object)
    {
       object->~ObjectType();
@@ -101,15 +260,28 @@ struct HleDestructorFunctionImpl : HleFunction
    virtual void call(cpu::Core *thread) override
    {
       if (decaf::config::log::kernel_trace && traceEnabled) {
-         if (decaf::config::log::kernel_trace_res) {
-            ppctypes::invoke(kcTraceHandler, kcTraceHandler, thread, &trampFunction, name);
+         auto trace = beginHleTrace(thread, this);
+
+         if (decaf::config::log::kernel_trace_log) {
+            if (decaf::config::log::kernel_trace_res) {
+               ppctypes::invoke(kcTraceHandler, kcTraceHandler, thread, &trampFunction, name);
+            } else {
+               ppctypes::invoke(kcTraceHandler, nullptr, thread, &trampFunction, name);
+            }
          } else {
-            ppctypes::invoke(kcTraceHandler, nullptr, thread, &trampFunction, name);
+            ppctypes::invoke(nullptr, nullptr, thread, &trampFunction, name);
          }
+
+         endHleTrace(trace, cpu::this_core::state());
       } else {
          ppctypes::invoke(nullptr, nullptr, thread, &trampFunction, name);
       }
    }
+
+   virtual std::string formatTrace(ppctypes::TracedCall *call, cpu::Core *result) override
+   {
+      return ppctypes::formatCall(call, result, &trampFunction, name);
+   }
 };
 
 } // namespace functions
@@ -126,6 +298,37 @@ makeFunction(ReturnType (*fptr)(Args...), void *hostPtr = nullptr)
    return func;
 }
 
+// Regular Function which the JIT may call directly, canReschedule must be
+//  true if the function can switch threads, block or call back into guest code
+template<typename ReturnType, typename... Args>
+inline HleFunction *
+makeDirectFunction(ReturnType (*fptr)(Args...), bool canReschedule)
+{
+   static_assert(sizeof...(Args) <= cpu::KernelCallDirect::MaxArgs,
+                 "Too many arguments for a direct kernel call");
+   static_assert(functions::DirectCallArgs<Args...>::supported,
+                 "Unsupported argument type for a direct kernel call");
+   static_assert(functions::DirectCallValue<ReturnType>::supported,
+                 "Unsupported return type for a direct kernel call");
+
+   // Trailing None keeps the array non-empty for functions without arguments
+   const cpu::KernelCallValue args[] = { functions::DirectCallValue<Args>::value..., cpu::KernelCallValue::None };
+   auto func = makeFunction(fptr);
+   func->direct.func = reinterpret_cast<void *>(fptr);
+   func->direct.numArgs = static_cast<uint32_t>(sizeof...(Args));
+
+   for (auto i = 0u; i < sizeof...(Args); ++i) {
+      func->direct.args[i] = args[i];
+   }
+
+   func->direct.result = functions::DirectCallValue<ReturnType>::value;
+   func->direct.canReschedule = canReschedule;
+
+   // Tracing needs the call to go through HleFunction::call
+   func->direct.disabled = &decaf::config::log::kernel_trace;
+   return func;
+}
+
 // Member Function
 template<typename ReturnType, typename Class, typename... Args>
 inline HleFunction *
@@ -11,6 +11,16 @@
 #define RegisterKernelFunction(fn) \
    RegisterKernelFunctionName(#fn, fn)
 
+// Like RegisterKernelFunction but the JIT calls fn directly, only for leaf
+//  functions which never reschedule the calling thread
+#define RegisterKernelFunctionLeaf(fn) \
+   RegisterKernelFunctionDirectName(#fn, fn, false)
+
+// Like RegisterKernelFunction but the JIT calls fn directly, reloading the
+//  core state afterwards as fn may block or reschedule
+#define RegisterKernelFunctionDirect(fn) \
+   RegisterKernelFunctionDirectName(#fn, fn, true)
+
 #define RegisterKernelData(data) \
    RegisterKernelDataName(#data, data)
 
@@ -79,6 +89,12 @@ protected:
       registerExportedSymbol(name, kernel::makeFunction(fn));
    }
 
+   template<typename ReturnType, typename... Args>
+   static void RegisterKernelFunctionDirectName(const char *name, ReturnType(*fn)(Args...), bool canReschedule)
+   {
+      registerExportedSymbol(name, kernel::makeDirectFunction(fn, canReschedule));
+   }
+
    template<typename ReturnType, typename Class, typename... Args>
    static void RegisterKernelFunctionName(const char *name, ReturnType(Class::*fn)(Args...))
    {
@@ -0,0 +1,166 @@
+#include "kernel_hlefunction.h"
+#include "kernel_hletrace.h"
+#include "kernel_loader.h"
+#include "libcpu/cpu.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <common/log.h>
+#include <fstream>
+#include <spdlog/fmt/fmt.h>
+
+namespace kernel
+{
+
+static const auto HleTraceRingSize = 4096u;
+
+// Each ring is only ever written to by its own core so no locking is
+//  needed, readers copy the records behind the head and accept that a
+//  record which is overwritten while being copied may be torn.
+struct HleTraceRing
+{
+   std::array<HleTraceRecord, HleTraceRingSize> records;
+   std::atomic<uint64_t> head { 0 };
+};
+
+static std::array<HleTraceRing, 3>
+sHleTraceRings;
+
+HleTraceHandle
+beginHleTrace(cpu::Core *state,
+              HleFunction *function)
+{
+   auto &ring = sHleTraceRings[state->id];
+   auto sequence = ring.head.load(std::memory_order_relaxed);
+   auto &record = ring.records[sequence % HleTraceRingSize];
+
+   record.function = function;
+   record.sequence = sequence;
+   record.time = state->tb();
+   record.core = state->id;
+   record.lr = state->lr;
+   record.sp = state->gpr[1];
+   record.complete = false;
+
+   for (auto i = 0u; i < 8; ++i) {
+      record.gpr[i] = state->gpr[3 + i];
+      record.fpr[i] = state->fpr[1 + i].paired0;
+   }
+
+   // The stack may well be reused by the time the trace is formatted
+   auto stack = mem::translate<be_val<uint32_t>>(ppctypes::getStackArgsAddress(state));
+
+   for (auto i = 0u; i < ppctypes::MaxTracedStackArgs; ++i) {
+      record.stack[i] = stack[i];
+   }
+
+   // Claim the record before the call as the function may itself call back
+   //  into guest code which makes further HLE calls on this core.
+   ring.head.store(sequence + 1, std::memory_order_release);
+   return HleTraceHandle { &record, sequence, state->id };
+}
+
+void
+endHleTrace(HleTraceHandle handle,
+            cpu::Core *state)
+{
+   // The thread may have been rescheduled onto another core during the
+   //  call, which must not write to the ring of the core it started on.
+   //  The call is left incomplete in the trace.
+   if (state->id != handle.core) {
+      return;
+   }
+
+   // Or the record may have been reused by another call on this core
+   auto &record = *handle.record;
+
+   if (record.sequence != handle.sequence) {
+      return;
+   }
+
+   record.resultGpr[0] = state->gpr[3];
+   record.resultGpr[1] = state->gpr[4];
+   record.resultFpr = state->fpr[1].value;
+   record.complete = true;
+}
+
+std::vector<HleTraceRecord>
+getHleTrace()
+{
+   std::vector<HleTraceRecord> trace;
+
+   for (auto &ring : sHleTraceRings) {
+      auto head = ring.head.load(std::memory_order_acquire);
+      auto count = std::min<uint64_t>(head, HleTraceRingSize);
+
+      for (auto sequence = head - count; sequence < head; ++sequence) {
+         auto &record = ring.records[sequence % HleTraceRingSize];
+
+         if (record.sequence == sequence) {
+            trace.push_back(record);
+         }
+      }
+   }
+
+   std::stable_sort(trace.begin(), trace.end(),
+                    [](const HleTraceRecord &lhs, const HleTraceRecord &rhs) {
+                       return lhs.time < rhs.time;
+                    });
+
+   return trace;
+}
+
+std::string
+formatHleTraceRecord(const HleTraceRecord &record)
+{
+   ppctypes::TracedCall args;
+   args.lr = record.lr;
+   args.gpr[1] = record.sp;
+
+   for (auto i = 0u; i < 8; ++i) {
+      args.gpr[3 + i] = record.gpr[i];
+      args.fpr[1 + i].paired0 = record.fpr[i];
+   }
+
+   for (auto i = 0u; i < ppctypes::MaxTracedStackArgs; ++i) {
+      args.stack[i] = record.stack[i];
+   }
+
+   cpu::Core result;
+   result.gpr[3] = record.resultGpr[0];
+   result.gpr[4] = record.resultGpr[1];
+   result.fpr[1].value = record.resultFpr;
+
+   auto call = record.function->formatTrace(&args, record.complete ? &result : nullptr);
+   return fmt::format("[{}] {:016X} {}", record.core, record.time, call);
+}
+
+bool
+dumpHleTrace(const std::string &path)
+{
+   std::ofstream file { path, std::ofstream::out };
+
+   if (!file.is_open()) {
+      gLog->error("Failed to open {} to dump kernel trace", path);
+      return false;
+   }
+
+   auto trace = getHleTrace();
+   auto callers = std::vector<ppcaddr_t> { };
+   callers.reserve(trace.size());
+
+   for (auto &record : trace) {
+      callers.push_back(record.lr);
+   }
+
+   auto callerNames = loader::symbolizeAddresses(callers);
+
+   for (auto i = 0u; i < trace.size(); ++i) {
+      file << formatHleTraceRecord(trace[i]) << " from " << callerNames[i] << '\n';
+   }
+
+   gLog->info("Dumped kernel trace to {}", path);
+   return true;
+}
+
+} // namespace kernel
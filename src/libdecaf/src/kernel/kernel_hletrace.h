@@ -0,0 +1,75 @@
+#pragma once
+#include "ppcutils/ppcinvokeargs.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cpu
+{
+struct Core;
+}
+
+namespace kernel
+{
+
+struct HleFunction;
+
+//! A single HLE function call in a core's trace ring, the registers are
+//  stored raw and only formatted when the trace is read.
+struct HleTraceRecord
+{
+   //! Function which was called
+   HleFunction *function;
+
+   //! Position of this record in its core's ring
+   uint64_t sequence;
+
+   //! Guest timebase at the time of the call
+   uint64_t time;
+
+   uint32_t core;
+   uint32_t lr;
+   uint32_t sp;
+
+   //! Argument registers r3 - r10
+   uint32_t gpr[8];
+
+   //! Argument registers f1 - f8
+   double fpr[8];
+
+   //! Stack arguments, copied at the time of the call
+   uint32_t stack[ppctypes::MaxTracedStackArgs];
+
+   //! Result registers r3, r4 and f1, only valid once complete is set
+   uint32_t resultGpr[2];
+   double resultFpr;
+   bool complete;
+};
+
+struct HleTraceHandle
+{
+   HleTraceRecord *record;
+   uint64_t sequence;
+
+   //! Core whose ring holds record, only that core may write to it
+   uint32_t core;
+};
+
+HleTraceHandle
+beginHleTrace(cpu::Core *state,
+              HleFunction *function);
+
+void
+endHleTrace(HleTraceHandle handle,
+            cpu::Core *state);
+
+std::vector<HleTraceRecord>
+getHleTrace();
+
+std::string
+formatHleTraceRecord(const HleTraceRecord &record);
+
+bool
+dumpHleTrace(const std::string &path);
+
+} // namespace kernel
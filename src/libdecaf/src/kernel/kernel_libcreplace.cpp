@@ -0,0 +1,447 @@
+#include "decaf_config.h"
+#include "kernel_libcreplace.h"
+#include "kernel_loader.h"
+#include "modules/coreinit/coreinit_memheap.h"
+#include "ppcutils/wfunc_call.h"
+
+#include <algorithm>
+#include <common/bitutils.h>
+#include <common/log.h>
+#include <common/murmur3.h>
+#include <cstring>
+#include <libcpu/cpu.h>
+#include <libcpu/mem.h>
+#include <libcpu/espresso/espresso_instructionset.h>
+#include <mutex>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <vector>
+
+namespace kernel
+{
+
+//! Routines larger than this are not what we are looking for
+static const uint32_t
+MaxRoutineSize = 0x1000;
+
+//! Enough space to patch in kc + blr
+static const uint32_t
+MinRoutineSize = 8;
+
+static std::mutex
+sReplacedRoutinesMutex;
+
+static std::vector<ReplacedRoutine *>
+sReplacedRoutines;
+
+//! Guest pointers are deliberately not passed through mem::translate so a
+//  bad pointer faults inside guest memory, the same as the original would.
+template<typename Type>
+static Type *
+guestPointer(uint32_t address)
+{
+   return reinterpret_cast<Type *>(mem::base() + address);
+}
+
+static int
+compareSign(int value)
+{
+   return (value > 0) - (value < 0);
+}
+
+//! Call the copy of the original routine on the current core
+static uint32_t
+callOriginal(ReplacedRoutine *routine,
+             uint32_t r3,
+             uint32_t r4,
+             uint32_t r5)
+{
+   auto core = cpu::this_core::state();
+
+   // Allocate callee backchain and lr space, like kcstub does for HLE calls
+   auto backchainSp = core->gpr[1];
+   core->gpr[1] -= 2 * 4;
+   mem::write(core->gpr[1], backchainSp);
+
+   auto original = wfunc_ptr<uint32_t, uint32_t, uint32_t, uint32_t> { routine->original };
+   auto result = original(r3, r4, r5);
+
+   core = cpu::this_core::state();
+   core->gpr[1] += 2 * 4;
+   return result;
+}
+
+static void
+reportMismatch(ReplacedRoutine *routine,
+               cpu::Core *state,
+               const std::string &detail)
+{
+   gLog->error("Replaced {}::{} called from 0x{:08X} differs from the original, {}",
+               routine->module, routine->name, state->lr, detail);
+}
+
+// void *memcpy(void *dst, const void *src, size_t size)
+static void
+memcpyHandler(cpu::Core *state,
+              void *userData)
+{
+   auto routine = static_cast<ReplacedRoutine *>(userData);
+   auto dst = state->gpr[3];
+   auto src = state->gpr[4];
+   auto size = state->gpr[5];
+
+   if (!size) {
+      return;
+   }
+
+   if (!routine->original) {
+      std::memmove(guestPointer<uint8_t>(dst), guestPointer<uint8_t>(src), size);
+      return;
+   }
+
+   // Overlapping copies are undefined for memcpy, the original may not copy
+   //  them the way our memmove would, so there is nothing to compare with.
+   if (dst < src + size && src < dst + size) {
+      state->gpr[3] = callOriginal(routine, dst, src, size);
+      return;
+   }
+
+   auto expected = std::vector<uint8_t>(guestPointer<uint8_t>(src), guestPointer<uint8_t>(src) + size);
+   auto result = callOriginal(routine, dst, src, size);
+   state = cpu::this_core::state();
+
+   if (std::memcmp(expected.data(), guestPointer<uint8_t>(dst), size) != 0) {
+      reportMismatch(routine, state, fmt::format("wrote different data to 0x{:08X} size 0x{:X}", dst, size));
+   }
+
+   state->gpr[3] = result;
+}
+
+// void *memset(void *dst, int value, size_t size)
+static void
+memsetHandler(cpu::Core *state,
+              void *userData)
+{
+   auto routine = static_cast<ReplacedRoutine *>(userData);
+   auto dst = state->gpr[3];
+   auto value = static_cast<uint8_t>(state->gpr[4]);
+   auto size = state->gpr[5];
+
+   if (!size) {
+      return;
+   }
+
+   if (!routine->original) {
+      std::memset(guestPointer<uint8_t>(dst), value, size);
+      return;
+   }
+
+   auto expected = std::vector<uint8_t>(size, value);
+   auto result = callOriginal(routine, dst, state->gpr[4], size);
+   state = cpu::this_core::state();
+
+   if (std::memcmp(expected.data(), guestPointer<uint8_t>(dst), size) != 0) {
+      reportMismatch(routine, state, fmt::format("wrote different data to 0x{:08X} size 0x{:X}", dst, size));
+   }
+
+   state->gpr[3] = result;
+}
+
+// size_t strlen(const char *str)
+static void
+strlenHandler(cpu::Core *state,
+              void *userData)
+{
+   auto routine = static_cast<ReplacedRoutine *>(userData);
+   auto str = state->gpr[3];
+   auto result = static_cast<uint32_t>(std::strlen(guestPointer<const char>(str)));
+
+   if (routine->original) {
+      auto guestResult = callOriginal(routine, str, 0, 0);
+      state = cpu::this_core::state();
+
+      if (guestResult != result) {
+         reportMismatch(routine, state, fmt::format("strlen(0x{:08X}) returned {} but host returned {}", str, guestResult, result));
+      }
+
+      result = guestResult;
+   }
+
+   state->gpr[3] = result;
+}
+
+// int memcmp(const void *lhs, const void *rhs, size_t size)
+static void
+memcmpHandler(cpu::Core *state,
+              void *userData)
+{
+   auto routine = static_cast<ReplacedRoutine *>(userData);
+   auto lhs = state->gpr[3];
+   auto rhs = state->gpr[4];
+   auto size = state->gpr[5];
+   auto result = 0;
+
+   if (size) {
+      result = compareSign(std::memcmp(guestPointer<uint8_t>(lhs), guestPointer<uint8_t>(rhs), size));
+   }
+
+   if (routine->original) {
+      auto guestResult = static_cast<int>(callOriginal(routine, lhs, rhs, size));
+      state = cpu::this_core::state();
+
+      // Only the sign of the result is defined
+      if (compareSign(guestResult) != result) {
+         reportMismatch(routine, state, fmt::format("memcmp(0x{:08X}, 0x{:08X}, 0x{:X}) returned {} but host returned {}", lhs, rhs, size, guestResult, result));
+      }
+
+      result = guestResult;
+   }
+
+   state->gpr[3] = static_cast<uint32_t>(result);
+}
+
+// int strcmp(const char *lhs, const char *rhs)
+static void
+strcmpHandler(cpu::Core *state,
+              void *userData)
+{
+   auto routine = static_cast<ReplacedRoutine *>(userData);
+   auto lhs = state->gpr[3];
+   auto rhs = state->gpr[4];
+   auto result = compareSign(std::strcmp(guestPointer<const char>(lhs), guestPointer<const char>(rhs)));
+
+   if (routine->original) {
+      auto guestResult = static_cast<int>(callOriginal(routine, lhs, rhs, 0));
+      state = cpu::this_core::state();
+
+      // Only the sign of the result is defined
+      if (compareSign(guestResult) != result) {
+         reportMismatch(routine, state, fmt::format("strcmp(0x{:08X}, 0x{:08X}) returned {} but host returned {}", lhs, rhs, guestResult, result));
+      }
+
+      result = guestResult;
+   }
+
+   state->gpr[3] = static_cast<uint32_t>(result);
+}
+
+struct LibcRoutine
+{
+   const char *name;
+   cpu::KernelCallFunction handler;
+};
+
+static const LibcRoutine
+sLibcRoutines[] =
+{
+   { "memcpy", memcpyHandler },
+   { "memset", memsetHandler },
+   { "strlen", strlenHandler },
+   { "memcmp", memcmpHandler },
+   { "strcmp", strcmpHandler },
+};
+
+/**
+ * Check that the code at start is a self contained leaf routine: it must not
+ * call anything, jump through ctr or leave other than by returning, so that
+ * replacing it as a whole cannot change the behaviour of anything else.
+ *
+ * Returns the size of the routine, or 0 with reason set if it does not look
+ * like one we can replace.
+ */
+static uint32_t
+checkLeafRoutine(uint32_t start,
+                 uint32_t end,
+                 const char *&reason)
+{
+   // Furthest branch target seen so far, control can only stop flowing
+   //  forward once we are past all of them.
+   auto furthestTarget = start;
+
+   for (auto addr = start; addr < end; addr += 4) {
+      auto instr = mem::read<espresso::Instruction>(addr);
+      auto data = espresso::decodeInstruction(instr);
+
+      if (!data) {
+         reason = "invalid instruction";
+         return 0;
+      }
+
+      auto target = uint32_t { 0 };
+      auto unconditional = false;
+
+      switch (data->id) {
+      case espresso::InstructionID::b:
+         target = sign_extend<26>(instr.li << 2);
+         unconditional = true;
+         break;
+      case espresso::InstructionID::bc:
+         target = sign_extend<16>(instr.bd << 2);
+         unconditional = (instr.bo & 0x14) == 0x14;
+         break;
+      case espresso::InstructionID::bclr:
+         if (instr.lk) {
+            reason = "calls through lr";
+            return 0;
+         }
+
+         if ((instr.bo & 0x14) == 0x14 && addr >= furthestTarget) {
+            return addr + 4 - start;
+         }
+
+         continue;
+      case espresso::InstructionID::bcctr:
+         reason = "branches through ctr";
+         return 0;
+      case espresso::InstructionID::sc:
+      case espresso::InstructionID::kc:
+         reason = "makes a system call";
+         return 0;
+      default:
+         continue;
+      }
+
+      if (instr.lk) {
+         reason = "calls another function";
+         return 0;
+      }
+
+      if (!instr.aa) {
+         target += addr;
+      }
+
+      if (target < start || target >= end) {
+         reason = "branches outside of itself";
+         return 0;
+      }
+
+      furthestTarget = std::max(furthestTarget, target);
+
+      if (unconditional && addr >= furthestTarget) {
+         reason = "does not return";
+         return 0;
+      }
+   }
+
+   reason = "does not return";
+   return 0;
+}
+
+//! End of the function at address: the next symbol or the end of its section
+static uint32_t
+findRoutineEnd(loader::LoadedModule *module,
+               loader::LoadedSection *section,
+               uint32_t address)
+{
+   auto end = section->end;
+
+   for (auto &itr : module->symbols) {
+      auto &symbol = itr.second;
+
+      if (symbol.address > address && symbol.address < end) {
+         end = symbol.address;
+      }
+   }
+
+   return end;
+}
+
+static void
+patchRoutine(ReplacedRoutine *routine,
+             cpu::KernelCallFunction handler)
+{
+   auto id = cpu::registerKernelCall({ handler, routine });
+
+   auto kc = espresso::encodeInstruction(espresso::InstructionID::kc);
+   kc.kcn = id;
+   mem::write(routine->address + 0, kc.value);
+
+   auto bclr = espresso::encodeInstruction(espresso::InstructionID::bclr);
+   bclr.bo = 20;
+   bclr.bi = 0;
+   mem::write(routine->address + 4, bclr.value);
+}
+
+void
+replaceLibcRoutines(loader::LoadedModule *module)
+{
+   auto verify = decaf::config::jit::verify_libc_routines;
+   auto replaced = 0u;
+
+   for (auto &libcRoutine : sLibcRoutines) {
+      auto itr = module->symbols.find(libcRoutine.name);
+
+      if (itr == module->symbols.end() || itr->second.type != loader::SymbolType::Function) {
+         continue;
+      }
+
+      // Imports are not in the module's sections, so this also skips
+      //  calls through to coreinit's own exports.
+      auto address = itr->second.address;
+      auto section = module->findAddressSection(address);
+
+      if (!section || section->type != loader::LoadedSectionType::Code) {
+         continue;
+      }
+
+      auto end = std::min(findRoutineEnd(module, section, address), address + MaxRoutineSize);
+      auto reason = "";
+      auto size = checkLeafRoutine(address, end, reason);
+
+      if (size && size < MinRoutineSize) {
+         reason = "too small to patch";
+         size = 0;
+      }
+
+      if (!size) {
+         gLog->debug("Not replacing {}::{} at 0x{:08X}, it {}", module->name, libcRoutine.name, address, reason);
+         continue;
+      }
+
+      auto routine = new ReplacedRoutine { };
+      routine->module = module->name;
+      routine->name = libcRoutine.name;
+      routine->address = address;
+      routine->size = size;
+
+      uint64_t hash[2];
+      MurmurHash3_x64_128(mem::translate(address), size, 0, hash);
+      routine->fingerprint = hash[0];
+
+      if (verify) {
+         // Keep a copy of the original to run alongside the host version,
+         //  it only uses relative branches within itself so can be moved.
+         auto copy = coreinit::internal::sysAlloc(size, 4);
+         std::memcpy(copy, mem::translate(address), size);
+         routine->original = mem::untranslate(copy);
+      }
+
+      patchRoutine(routine, libcRoutine.handler);
+
+      gLog->info("Replaced {}::{} at 0x{:08X} with host implementation, size 0x{:X}, fingerprint {:016X}",
+                 routine->module, routine->name, routine->address, routine->size, routine->fingerprint);
+
+      std::unique_lock<std::mutex> lock { sReplacedRoutinesMutex };
+      sReplacedRoutines.push_back(routine);
+      ++replaced;
+   }
+
+   if (replaced) {
+      gLog->info("Replaced {} libc routines in {}{}", replaced, module->name, verify ? " in verify mode" : "");
+   }
+}
+
+std::vector<ReplacedRoutine>
+getReplacedRoutines()
+{
+   std::unique_lock<std::mutex> lock { sReplacedRoutinesMutex };
+   auto result = std::vector<ReplacedRoutine> { };
+
+   for (auto routine : sReplacedRoutines) {
+      result.push_back(*routine);
+   }
+
+   return result;
+}
+
+} // namespace kernel
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kernel
+{
+
+namespace loader
+{
+struct LoadedModule;
+}
+
+//! A libc routine statically linked into a guest module whose entry point
+//  has been patched to call a host implementation.
+struct ReplacedRoutine
+{
+   std::string module;
+   std::string name;
+   uint32_t address;
+   uint32_t size;
+
+   //! Hash of the original instructions, for recognising a given
+   //  implementation across titles
+   uint64_t fingerprint;
+
+   //! Copy of the original instructions which is run and compared against
+   //  the host implementation in verify mode, 0 otherwise
+   uint32_t original;
+};
+
+void
+replaceLibcRoutines(loader::LoadedModule *module);
+
+std::vector<ReplacedRoutine>
+getReplacedRoutines();
+
+} // namespace kernel
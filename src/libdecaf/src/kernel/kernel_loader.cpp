@@ -2,10 +2,14 @@
 #include "decaf_config.h"
 #include "elf.h"
 #include "filesystem/filesystem.h"
+#include "kernel.h"
+#include "libdecaf/decaf.h"
 #include "kernel_filesystem.h"
 #include "kernel_hle.h"
 #include "kernel_hlemodule.h"
 #include "kernel_hlefunction.h"
+#include "kernel_libcreplace.h"
+#include "kernel_loadercache.h"
 #include "kernel_memory.h"
 #include "modules/coreinit/coreinit_internal_idlock.h"
 #include "modules/coreinit/coreinit_memory.h"
@@ -13,15 +17,19 @@
 #include "modules/coreinit/coreinit_dynload.h"
 #include "modules/coreinit/coreinit_scheduler.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <common/align.h>
 #include <common/decaf_assert.h>
 #include <common/frameallocator.h>
 #include <common/teenyheap.h>
 #include <common/strutils.h>
+#include <common/workerpool.h>
 #include <gsl.h>
 #include <libcpu/mem.h>
 #include <map>
+#include <mutex>
 #include <unordered_map>
 #include <zlib.h>
 
@@ -36,6 +44,9 @@ namespace loader
 using TrampolineMap = std::map<ppcaddr_t, ppcaddr_t>;
 using SectionList = std::vector<elf::Section>;
 using AddressRange = std::pair<ppcaddr_t, ppcaddr_t>;
+using LoaderClock = std::chrono::steady_clock;
+
+static const auto LoaderWorkers = 4u;
 
 static coreinit::internal::IdLock
 sLoaderLock;
@@ -46,6 +57,36 @@ sLoadedModules;
 static std::map<ppcaddr_t, std::string, std::greater<ppcaddr_t>>
 sGlobalSymbolLookup;
 
+struct SectionIndexEntry
+{
+   ppcaddr_t start;
+   ppcaddr_t end;
+   LoadedModule *module;
+   LoadedSection *section;
+
+   //! Range of this section's symbols in sSymbolIndex
+   uint32_t firstSymbol;
+   uint32_t numSymbols;
+};
+
+struct SymbolIndexEntry
+{
+   ppcaddr_t address;
+   const std::string *name;
+};
+
+//! Sections of every loaded module sorted by start address, each followed
+//  by its symbols sorted by address in sSymbolIndex. Rebuilt whenever
+//  the set of loaded modules changes.
+static std::mutex
+sAddressIndexMutex;
+
+static std::vector<SectionIndexEntry>
+sSectionIndex;
+
+static std::vector<SymbolIndexEntry>
+sSymbolIndex;
+
 static ppcaddr_t
 sSyscallAddress = 0;
 
@@ -90,55 +131,104 @@ loaderFree(void *mem)
 static LoadedModule *
 loadRPLNoLock(const std::string& name);
 
-// Read and decompress section data
+// Returns the milliseconds since start and resets start to now
+static double
+elapsedMs(LoaderClock::time_point &start)
+{
+   auto now = LoaderClock::now();
+   auto elapsed = std::chrono::duration<double, std::milli> { now - start };
+   start = now;
+   return elapsed.count();
+}
+
+// Workers used to inflate sections and apply relocations, only one module
+//  is ever being loaded at a time as the loader lock is held.
+static WorkerPool &
+getLoaderPool()
+{
+   static WorkerPool pool { LoaderWorkers, "Loader" };
+   return pool;
+}
+
+// Returns the size of a section's data once decompressed
+static uint32_t
+getSectionDataSize(const gsl::span<uint8_t> &file,
+                   const elf::SectionHeader &header)
+{
+   if (header.type != elf::SHT_NOBITS && (header.flags & elf::SHF_DEFLATED)) {
+      auto deflatedHeader = reinterpret_cast<elf::DeflatedHeader *>(file.data() + header.offset);
+      return deflatedHeader->inflatedSize;
+   }
+
+   return header.size;
+}
+
+// Read and decompress section data into dst, which must be at least
+//  getSectionDataSize bytes long
 static bool
 readSectionData(const gsl::span<uint8_t> &file,
                 const elf::SectionHeader &header,
-                std::vector<uint8_t> &data)
+                uint8_t *dst,
+                uint32_t size)
 {
-   if (header.type == elf::SHT_NOBITS || header.size == 0) {
-      data.clear();
+   if (header.type == elf::SHT_NOBITS) {
+      std::memset(dst, 0, size);
       return true;
    }
 
-   if (header.flags & elf::SHF_DEFLATED) {
-      auto stream = z_stream {};
-      auto ret = Z_OK;
+   if (!(header.flags & elf::SHF_DEFLATED)) {
+      std::memcpy(dst, file.data() + header.offset, size);
+      return true;
+   }
 
-      // Read the deflated header
-      auto deflatedHeader = reinterpret_cast<elf::DeflatedHeader *>(file.data() + header.offset);
-      auto deflatedData = file.data() + header.offset + sizeof(elf::DeflatedHeader);
-      data.resize(deflatedHeader->inflatedSize);
+   auto stream = z_stream {};
+   auto ret = Z_OK;
+   auto deflatedData = file.data() + header.offset + sizeof(elf::DeflatedHeader);
 
-      // Inflate
-      memset(&stream, 0, sizeof(stream));
-      stream.zalloc = Z_NULL;
-      stream.zfree = Z_NULL;
-      stream.opaque = Z_NULL;
+   // Inflate
+   memset(&stream, 0, sizeof(stream));
+   stream.zalloc = Z_NULL;
+   stream.zfree = Z_NULL;
+   stream.opaque = Z_NULL;
 
-      ret = inflateInit(&stream);
+   ret = inflateInit(&stream);
 
-      if (ret != Z_OK) {
-         gLog->error("Couldn't decompress .rpx section because inflateInit returned {}", ret);
-         data.clear();
-      } else {
-         stream.avail_in = header.size;
-         stream.next_in = const_cast<Bytef *>(deflatedData);
-         stream.avail_out = static_cast<uInt>(data.size());
-         stream.next_out = reinterpret_cast<Bytef *>(data.data());
+   if (ret != Z_OK) {
+      gLog->error("Couldn't decompress .rpx section because inflateInit returned {}", ret);
+      return false;
+   }
 
-         ret = inflate(&stream, Z_FINISH);
+   stream.avail_in = header.size;
+   stream.next_in = const_cast<Bytef *>(deflatedData);
+   stream.avail_out = static_cast<uInt>(size);
+   stream.next_out = reinterpret_cast<Bytef *>(dst);
 
-         if (ret != Z_OK && ret != Z_STREAM_END) {
-            gLog->error("Couldn't decompress .rpx section because inflate returned {}", ret);
-            data.clear();
-         }
+   ret = inflate(&stream, Z_FINISH);
+   inflateEnd(&stream);
 
-         inflateEnd(&stream);
-      }
-   } else {
-      data.resize(header.size);
-      std::memcpy(data.data(), file.data() + header.offset, header.size);
+   if (ret != Z_OK && ret != Z_STREAM_END) {
+      gLog->error("Couldn't decompress .rpx section because inflate returned {}", ret);
+      return false;
+   }
+
+   return true;
+}
+
+// Read and decompress section data
+static bool
+readSectionData(const gsl::span<uint8_t> &file,
+                const elf::SectionHeader &header,
+                std::vector<uint8_t> &data)
+{
+   if (header.type == elf::SHT_NOBITS || header.size == 0) {
+      data.clear();
+      return true;
+   }
+
+   data.resize(getSectionDataSize(file, header));
+
+   if (!readSectionData(file, header, data.data(), static_cast<uint32_t>(data.size()))) {
+      data.clear();
    }
 
    return data.size() > 0;
@@ -494,7 +584,7 @@ loadHleModule(const std::string &moduleName,
    if (dataSize > 0) {
       auto dataRegion = static_cast<uint8_t *>(coreinit::internal::sysAlloc(dataSize));
       auto start = mem::untranslate(dataRegion);
-      auto end = start + codeSize;
+      auto end = start + dataSize;
       loadedMod->sections.emplace_back(LoadedSection { ".data", LoadedSectionType::Data, start, end });
 
       for (auto &data : dataSymbols) {
@@ -531,163 +621,204 @@ loadHleModule(const std::string &moduleName,
    return loadedMod;
 }
 
-static bool
-processRelocations(LoadedModule *loadedMod,
-                   const SectionList &sections,
-                   const gsl::span<uint8_t> &file,
-                   const char *shStrTab,
-                   FrameAllocator &codeSeg,
-                   AddressRange &trampSeg)
+// A relocation which could not be applied from a worker thread because it
+//  needs a trampoline or has to look up another module.
+struct DeferredRelocation
 {
-   auto trampolines = TrampolineMap{};
-   auto buffer = std::vector<uint8_t> {};
-   trampSeg.first = mem::untranslate(codeSeg.top());
+   ppcaddr_t reloAddr;
+   ppcaddr_t symAddr;
+   uint32_t type;
+   const elf::Section *symbolSection;
+   const char *symbolName;
+};
+
+// Apply the relocations from one SHT_RELA section, this is safe to run for
+//  several sections in parallel as each only writes to its own target section.
+static void
+processSectionRelocations(const LoadedModule *loadedMod,
+                          const SectionList &sections,
+                          const elf::Section &section,
+                          const std::vector<uint8_t> &data,
+                          std::vector<DeferredRelocation> &deferred)
+{
+   auto &symSec = sections[section.header.link];
+   auto &targetSec = sections[section.header.info];
+   auto &symStrTab = sections[symSec.header.link];
 
-   for (auto &section : sections) {
-      if (section.header.type != elf::SHT_RELA) {
-         continue;
-      }
+   auto targetBaseAddr = targetSec.header.addr;
+   auto targetVirtAddr = targetSec.virtAddress;
 
-      readSectionData(file, section.header, buffer);
+   auto symbols = gsl::make_span(reinterpret_cast<elf::Symbol *>(symSec.memory), symSec.virtSize / sizeof(elf::Symbol));
+   auto relocations = gsl::make_span(reinterpret_cast<const elf::Rela *>(data.data()), data.size() / sizeof(elf::Rela));
 
-      auto &symSec = sections[section.header.link];
-      auto &targetSec = sections[section.header.info];
-      auto &symStrTab = sections[symSec.header.link];
+   for (auto &rela : relocations) {
+      auto index = rela.info >> 8;
+      auto type = rela.info & 0xff;
+      auto reloAddr = rela.offset - targetBaseAddr + targetVirtAddr;
 
-      auto targetBaseAddr = targetSec.header.addr;
-      auto targetVirtAddr = targetSec.virtAddress;
+      auto &symbol = symbols[index];
+      auto symbolName = reinterpret_cast<const char*>(symStrTab.memory) + symbol.name;
+      const elf::Section *symbolSection = nullptr;
 
-      auto symbols = gsl::make_span(reinterpret_cast<elf::Symbol *>(symSec.memory), symSec.virtSize / sizeof(elf::Symbol));
-      auto relocations = gsl::make_span(reinterpret_cast<elf::Rela *>(buffer.data()), buffer.size() / sizeof(elf::Rela));
+      if (symbol.shndx == elf::SHN_UNDEF) {
+         continue;
+      } else if (symbol.shndx < elf::SHN_LORESERVE) {
+         symbolSection = &sections[symbol.shndx];
+      } else {
+         // ABS is the only supported special section index
+         decaf_check(symbol.shndx == elf::SHN_ABS);
+      }
 
-      for (auto &rela : relocations) {
-         auto index = rela.info >> 8;
-         auto type = rela.info & 0xff;
-         auto reloAddr = rela.offset - targetBaseAddr + targetVirtAddr;
+      // Get symbol address
+      auto symAddr = symbol.value + rela.addend;
 
-         auto &symbol = symbols[index];
-         auto symbolName = reinterpret_cast<const char*>(symStrTab.memory) + symbol.name;
-         const elf::Section *symbolSection = nullptr;
+      // Calculate relocated symbol address except for TLS which are NOT rpl imports
+      if (symbolSection) {
+         if (symbolSection->header.type == elf::SHT_RPL_IMPORTS ||
+            (type != elf::R_PPC_DTPREL32 && type != elf::R_PPC_DTPMOD32)) {
+            symAddr = calculateRelocatedAddress(symbol.value, sections);
 
-         if (symbol.shndx == elf::SHN_UNDEF) {
-            continue;
-         } else if (symbol.shndx < elf::SHN_LORESERVE) {
-            symbolSection = &sections[symbol.shndx];
-         } else {
-            // ABS is the only supported special section index
-            decaf_check(symbol.shndx == elf::SHN_ABS);
-         }
+            if (symbolSection->header.type == elf::SHT_RPL_IMPORTS) {
+               decaf_check(symAddr);
+               symAddr = mem::read<uint32_t>(symAddr);
+            }
 
-         // Get symbol address
-         auto symAddr = symbol.value + rela.addend;
+            if (type != elf::R_PPC_DTPREL32 && type != elf::R_PPC_DTPMOD32) {
+               decaf_check(symAddr);
+            }
 
-         // Calculate relocated symbol address except for TLS which are NOT rpl imports
-         if (symbolSection) {
-            if (symbolSection->header.type == elf::SHT_RPL_IMPORTS ||
-               (type != elf::R_PPC_DTPREL32 && type != elf::R_PPC_DTPMOD32)) {
-               symAddr = calculateRelocatedAddress(symbol.value, sections);
+            symAddr += rela.addend;
+         }
+      }
 
-               if (symbolSection->header.type == elf::SHT_RPL_IMPORTS) {
-                  decaf_check(symAddr);
-                  symAddr = mem::read<uint32_t>(symAddr);
-               }
+      auto ptr8 = mem::translate(reloAddr);
+      auto ptr16 = reinterpret_cast<uint16_t*>(ptr8);
+      auto ptr32 = reinterpret_cast<uint32_t*>(ptr8);
+
+      switch (type) {
+      case elf::R_PPC_ADDR32:
+         *ptr32 = byte_swap(symAddr);
+         break;
+      case elf::R_PPC_ADDR16_LO:
+         *ptr16 = byte_swap<uint16_t>(symAddr & 0xffff);
+         break;
+      case elf::R_PPC_ADDR16_HI:
+         *ptr16 = byte_swap<uint16_t>(symAddr >> 16);
+         break;
+      case elf::R_PPC_ADDR16_HA:
+         *ptr16 = byte_swap<uint16_t>((symAddr + 0x8000) >> 16);
+         break;
+      case elf::R_PPC_REL24:
+      {
+         auto ins = espresso::Instruction{ byte_swap(*ptr32) };
+         auto data = espresso::decodeInstruction(ins);
+
+         // Our REL24 trampolines only work for a branch instruction...
+         decaf_check(data->id == espresso::InstructionID::b);
+
+         auto delta = static_cast<ptrdiff_t>(symAddr) - static_cast<ptrdiff_t>(reloAddr);
+
+         if (delta < -0x01FFFFFC || delta > 0x01FFFFFC) {
+            // Trampolines are allocated from the shared code segment
+            deferred.emplace_back(DeferredRelocation { reloAddr, symAddr, type, symbolSection, symbolName });
+            break;
+         }
 
-               if (type != elf::R_PPC_DTPREL32 && type != elf::R_PPC_DTPMOD32) {
-                  decaf_check(symAddr);
-               }
+         *ptr32 = byte_swap((byte_swap(*ptr32) & ~0x03FFFFFC) | (gsl::narrow_cast<uint32_t>(delta & 0x03FFFFFC)));
+         break;
+      }
+      case elf::R_PPC_EMB_SDA21:
+      {
+         auto ins = espresso::Instruction{ byte_swap(*ptr32) };
+         ptrdiff_t offset = 0;
+
+         if (ins.rA == 0) {
+            offset = 0;
+         } else if (ins.rA == 2) {
+            // sda2Base
+            offset = static_cast<ptrdiff_t>(symAddr) - static_cast<ptrdiff_t>(loadedMod->sda2Base);
+         } else if (ins.rA == 13) {
+            // sdaBase
+            offset = static_cast<ptrdiff_t>(symAddr) - static_cast<ptrdiff_t>(loadedMod->sdaBase);
+         } else {
+            decaf_check(0);
+         }
 
-               symAddr += rela.addend;
-            }
+         if (offset < std::numeric_limits<int16_t>::min() || offset > std::numeric_limits<int16_t>::max()) {
+            gLog->error("Expected SDA relocation {:x} to be within signed 16 bit offset of base {}", symAddr, ins.rA);
+            break;
          }
 
-         auto ptr8 = mem::translate(reloAddr);
-         auto ptr16 = reinterpret_cast<uint16_t*>(ptr8);
-         auto ptr32 = reinterpret_cast<uint32_t*>(ptr8);
+         ins.simm = offset;
+         *ptr32 = byte_swap(ins.value);
+         break;
+      }
+      case elf::R_PPC_DTPREL32:
+      {
+         *ptr32 = byte_swap(symAddr);
+         break;
+      }
+      case elf::R_PPC_DTPMOD32:
+      {
+         decaf_check(symbolSection);
 
-         switch (type) {
-         case elf::R_PPC_ADDR32:
-            *ptr32 = byte_swap(symAddr);
-            break;
-         case elf::R_PPC_ADDR16_LO:
-            *ptr16 = byte_swap<uint16_t>(symAddr & 0xffff);
-            break;
-         case elf::R_PPC_ADDR16_HI:
-            *ptr16 = byte_swap<uint16_t>(symAddr >> 16);
+         // If this is an import, we must find the correct module index
+         if (symbolSection->header.type == elf::SHT_RPL_IMPORTS) {
+            deferred.emplace_back(DeferredRelocation { reloAddr, symAddr, type, symbolSection, symbolName });
             break;
-         case elf::R_PPC_ADDR16_HA:
-            *ptr16 = byte_swap<uint16_t>((symAddr + 0x8000) >> 16);
-            break;
-         case elf::R_PPC_REL24:
-         {
-            auto ins = espresso::Instruction{ byte_swap(*ptr32) };
-            auto data = espresso::decodeInstruction(ins);
-
-            // Our REL24 trampolines only work for a branch instruction...
-            decaf_check(data->id == espresso::InstructionID::b);
+         }
 
-            auto delta = static_cast<ptrdiff_t>(symAddr) - static_cast<ptrdiff_t>(reloAddr);
+         *ptr32 = byte_swap(loadedMod->tlsModuleIndex);
+         break;
+      }
+      default:
+         gLog->error("Unknown relocation type {}", type);
+      }
+   }
+}
 
-            if (delta < -0x01FFFFFC || delta > 0x01FFFFFC) {
-               auto trampAddr = getTrampAddress(loadedMod, codeSeg, trampolines, mem::translate(symAddr), symbolName);
-               decaf_check(trampAddr);
+static bool
+processRelocations(LoadedModule *loadedMod,
+                   const SectionList &sections,
+                   const std::vector<std::vector<uint8_t>> &sectionData,
+                   FrameAllocator &codeSeg,
+                   AddressRange &trampSeg)
+{
+   auto trampolines = TrampolineMap{};
+   auto relaSections = std::vector<uint32_t> {};
+   trampSeg.first = mem::untranslate(codeSeg.top());
 
-               // Ensure valid trampoline delta
-               delta = static_cast<ptrdiff_t>(trampAddr) - static_cast<ptrdiff_t>(reloAddr);
-               decaf_check(delta >= -0x01FFFFFC && delta <= 0x01FFFFFC);
+   for (auto i = 0u; i < sections.size(); ++i) {
+      if (sections[i].header.type == elf::SHT_RELA) {
+         relaSections.push_back(i);
+      }
+   }
 
-               symAddr = trampAddr;
-            }
+   auto deferred = std::vector<std::vector<DeferredRelocation>> { relaSections.size() };
 
-            *ptr32 = byte_swap((byte_swap(*ptr32) & ~0x03FFFFFC) | (gsl::narrow_cast<uint32_t>(delta & 0x03FFFFFC)));
-            break;
-         }
-         case elf::R_PPC_EMB_SDA21:
-         {
-            auto ins = espresso::Instruction{ byte_swap(*ptr32) };
-            ptrdiff_t offset = 0;
-
-            if (ins.rA == 0) {
-               offset = 0;
-            } else if (ins.rA == 2) {
-               // sda2Base
-               offset = static_cast<ptrdiff_t>(symAddr) - static_cast<ptrdiff_t>(loadedMod->sda2Base);
-            } else if (ins.rA == 13) {
-               // sdaBase
-               offset = static_cast<ptrdiff_t>(symAddr) - static_cast<ptrdiff_t>(loadedMod->sdaBase);
-            } else {
-               decaf_check(0);
-            }
+   getLoaderPool().run(static_cast<uint32_t>(relaSections.size()), [&](uint32_t index, uint32_t worker) {
+      auto sectionIndex = relaSections[index];
+      processSectionRelocations(loadedMod, sections, sections[sectionIndex], sectionData[sectionIndex], deferred[index]);
+   });
 
-            if (offset < std::numeric_limits<int16_t>::min() || offset > std::numeric_limits<int16_t>::max()) {
-               gLog->error("Expected SDA relocation {:x} to be within signed 16 bit offset of base {}", symAddr, ins.rA);
-               break;
-            }
+   // Apply the relocations which had to be deferred in section order so the
+   //  trampolines are laid out the same way on every load.
+   for (auto &sectionDeferred : deferred) {
+      for (auto &relocation : sectionDeferred) {
+         auto ptr32 = reinterpret_cast<uint32_t *>(mem::translate(relocation.reloAddr));
 
-            ins.simm = offset;
-            *ptr32 = byte_swap(ins.value);
-            break;
-         }
-         case elf::R_PPC_DTPREL32:
-         {
-            *ptr32 = byte_swap(symAddr);
-            break;
-         }
-         case elf::R_PPC_DTPMOD32:
-         {
-            decaf_check(symbolSection);
-            auto moduleIndex = loadedMod->tlsModuleIndex;
+         if (relocation.type == elf::R_PPC_REL24) {
+            auto trampAddr = getTrampAddress(loadedMod, codeSeg, trampolines, mem::translate(relocation.symAddr), relocation.symbolName);
+            decaf_check(trampAddr);
 
-            // If this is an import, we must find the correct module index
-            if (symbolSection->header.type == elf::SHT_RPL_IMPORTS) {
-               auto module = loadRPLNoLock(symbolSection->name);
-               moduleIndex = module->tlsModuleIndex;
-            }
+            // Ensure valid trampoline delta
+            auto delta = static_cast<ptrdiff_t>(trampAddr) - static_cast<ptrdiff_t>(relocation.reloAddr);
+            decaf_check(delta >= -0x01FFFFFC && delta <= 0x01FFFFFC);
 
-            *ptr32 = byte_swap(moduleIndex);
-            break;
-         }
-         default:
-            gLog->error("Unknown relocation type {}", type);
+            *ptr32 = byte_swap((byte_swap(*ptr32) & ~0x03FFFFFC) | (gsl::narrow_cast<uint32_t>(delta & 0x03FFFFFC)));
+         } else if (relocation.type == elf::R_PPC_DTPMOD32) {
+            auto module = loadRPLNoLock(relocation.symbolSection->name);
+            *ptr32 = byte_swap(module->tlsModuleIndex);
          }
       }
    }
@@ -698,19 +829,25 @@ processRelocations(LoadedModule *loadedMod,
 
 bool
 processImports(LoadedModule *loadedMod,
-               SectionList &sections)
+               SectionList &sections,
+               double &dependencyTime)
 {
-   std::map<std::string, ppcaddr_t> symbolTable;
+   // The module each import section links against, indexed by section
+   auto linkedModules = std::vector<LoadedModule *> { sections.size(), nullptr };
 
    // Process import sections
-   for (auto &section : sections) {
+   for (auto i = 0u; i < sections.size(); ++i) {
+      auto &section = sections[i];
+
       if (section.header.type != elf::SHT_RPL_IMPORTS) {
          continue;
       }
 
       // Load library
       auto libraryName = reinterpret_cast<const char *>(section.memory + 8);
+      auto loadStart = LoaderClock::now();
       auto linkedModule = loadRPLNoLock(libraryName);
+      dependencyTime += elapsedMs(loadStart);
 
       // Zero the whole section after we have used the name
       section.name = libraryName;
@@ -722,10 +859,7 @@ processImports(LoadedModule *loadedMod,
          continue;
       }
 
-      // Add all these symbols to the symbol table
-      for (auto &linkedExport : linkedModule->exports) {
-         symbolTable.insert(linkedExport);
-      }
+      linkedModules[i] = linkedModule;
    }
 
    // Process import symbols
@@ -736,9 +870,9 @@ processImports(LoadedModule *loadedMod,
 
       auto stringTable = reinterpret_cast<const char*>(sections[section.header.link].memory);
       auto symbols = gsl::make_span(reinterpret_cast<elf::Symbol *>(section.memory), section.virtSize / sizeof(elf::Symbol));
+      auto name = std::string { };
 
       for (auto &symbol : symbols) {
-         auto name = stringTable + symbol.name;
          auto binding = symbol.info >> 4;
          auto type = symbol.info & 0xf;
 
@@ -748,6 +882,8 @@ processImports(LoadedModule *loadedMod,
             continue;
          }
 
+         name.assign(stringTable + symbol.name);
+
          if (symbol.shndx >= elf::SHN_LORESERVE) {
             gLog->warn("Symbol {} in invalid section 0x{:X}", name, symbol.shndx);
             continue;
@@ -759,11 +895,40 @@ processImports(LoadedModule *loadedMod,
             continue;
          }
 
-         // Find the symbol address
-         auto symbolTableItr = symbolTable.find(name);
+         // Find the symbol address in the exports of the library it is imported from
+         auto linkedModule = linkedModules[symbol.shndx];
          auto symbolAddress = 0u;
+         auto found = false;
+
+         if (linkedModule) {
+            auto exportItr = linkedModule->exports.find(name);
+
+            if (exportItr != linkedModule->exports.end()) {
+               symbolAddress = exportItr->second;
+               found = true;
+            }
+         }
+
+         // Fall back to the other imported libraries, as a merged symbol
+         //  table of all of them used to be searched
+         for (auto otherModule : linkedModules) {
+            if (found) {
+               break;
+            }
+
+            if (!otherModule || otherModule == linkedModule) {
+               continue;
+            }
 
-         if (symbolTableItr == symbolTable.end()) {
+            auto exportItr = otherModule->exports.find(name);
+
+            if (exportItr != otherModule->exports.end()) {
+               symbolAddress = exportItr->second;
+               found = true;
+            }
+         }
+
+         if (!found) {
             if (type == elf::STT_FUNC) {
                symbolAddress = generateUnimplementedFunctionThunk(importSection.name, name);
             } else if (type == elf::STT_OBJECT) {
@@ -773,7 +938,6 @@ processImports(LoadedModule *loadedMod,
             }
          } else {
             decaf_check(type == elf::STT_FUNC || type == elf::STT_OBJECT || type == elf::STT_TLS);
-            symbolAddress = symbolTableItr->second;
          }
 
          decaf_check(type == elf::STT_TLS || symbolAddress);
@@ -889,13 +1053,110 @@ processExports(LoadedModule *loadedMod,
 }
 
 
+// Read and inflate sections into guest memory, and relocation sections into
+//  sectionData, across the loader workers
+static bool
+readSectionList(const gsl::span<uint8_t> &file,
+                const SectionList &sections,
+                const std::vector<uint32_t> &memorySections,
+                const std::vector<uint32_t> &relaSections,
+                std::vector<std::vector<uint8_t>> &sectionData)
+{
+   std::atomic<bool> readFailed { false };
+   auto numReads = static_cast<uint32_t>(memorySections.size() + relaSections.size());
+
+   getLoaderPool().run(numReads, [&](uint32_t index, uint32_t worker) {
+      if (index < memorySections.size()) {
+         auto &section = sections[memorySections[index]];
+
+         if (!readSectionData(file, section.header, section.memory, section.virtSize)) {
+            readFailed = true;
+         }
+      } else {
+         auto sectionIndex = relaSections[index - memorySections.size()];
+
+         if (!readSectionData(file, sections[sectionIndex].header, sectionData[sectionIndex])) {
+            readFailed = true;
+         }
+      }
+   });
+
+   if (readFailed) {
+      gLog->error("Failed to read section data");
+      return false;
+   }
+
+   return true;
+}
+
+static void
+saveCachedSections(const SectionList &sections,
+                   const std::vector<uint32_t> &indices,
+                   std::vector<CachedSection> &cached)
+{
+   cached.clear();
+
+   for (auto index : indices) {
+      auto &section = sections[index];
+      cached.emplace_back(CachedSection { index, { section.memory, section.memory + section.virtSize } });
+   }
+}
+
+// Copy cached sections back into guest memory, fails without writing
+//  anything if they do not match the sections which were allocated.
+static bool
+restoreCachedSections(SectionList &sections,
+                      const std::vector<uint32_t> &indices,
+                      const std::vector<CachedSection> &cached)
+{
+   if (cached.size() != indices.size()) {
+      return false;
+   }
+
+   for (auto i = 0u; i < indices.size(); ++i) {
+      if (cached[i].index != indices[i]
+       || cached[i].data.size() != sections[indices[i]].virtSize) {
+         return false;
+      }
+   }
+
+   for (auto &section : cached) {
+      std::memcpy(sections[section.index].memory, section.data.data(), section.data.size());
+   }
+
+   return true;
+}
+
+// Hash of everything processRelocations reads which does not come from the
+//  file or the segment addresses
+static ModuleCacheKey
+getImportCacheKey(const LoadedModule *loadedMod,
+                  const SectionList &sections)
+{
+   auto key = ModuleCacheKeyBuilder { };
+   key.add(loadedMod->tlsModuleIndex);
+
+   for (auto &section : sections) {
+      if (section.header.type != elf::SHT_RPL_IMPORTS) {
+         continue;
+      }
+
+      auto linkedModule = findModule(section.name);
+      key.add(gsl::make_span(section.memory, section.virtSize));
+      key.add(linkedModule ? linkedModule->tlsModuleIndex : 0xFFFFFFFFu);
+   }
+
+   return key.finish();
+}
+
 LoadedModule *
 loadRPL(const std::string &moduleName,
         const std::string &name,
         const gsl::span<uint8_t> &data)
 {
-   std::vector<uint8_t> buffer;
    auto loadedMod = new LoadedModule();
+   auto &times = loadedMod->loadTimes;
+   auto stageStart = LoaderClock::now();
    loadedMod->name = name;
    sLoadedModules.emplace(moduleName, loadedMod);
 
@@ -973,40 +1234,96 @@ loadRPL(const std::string &moduleName,
    auto dataAllocator = FrameAllocator { dataSegment, info.dataSize };
    auto loadAllocator = FrameAllocator { loadSegment, info.loadSize };
 
-   // Allocate sections from our memory segments
-   for (auto &section : sections) {
-      if (section.header.flags & elf::SHF_ALLOC) {
-         void *allocData = nullptr;
+   // Allocate sections from our memory segments, this is done up front so
+   //  the layout does not depend on the order the sections are read in.
+   auto loaderSections = std::vector<uint32_t> {};
+   auto imageSections = std::vector<uint32_t> {};
+   auto relaSections = std::vector<uint32_t> {};
+   auto sectionData = std::vector<std::vector<uint8_t>> { sections.size() };
 
-         // Read the section data
-         if (section.header.type == elf::SHT_NOBITS) {
-            buffer.clear();
-            buffer.resize(section.header.size, 0);
-         } else {
-            if (!readSectionData(data, section.header, buffer)) {
-               gLog->error("Failed to read section data");
-               return nullptr;
-            }
-         }
+   for (auto i = 0u; i < sections.size(); ++i) {
+      auto &section = sections[i];
 
-         // Allocate from correct memory segment
-         if (section.header.type == elf::SHT_PROGBITS || section.header.type == elf::SHT_NOBITS) {
-            if (section.header.flags & elf::SHF_EXECINSTR) {
-               allocData = codeAllocator.allocate(buffer.size(), section.header.addralign);
-            } else {
-               allocData = dataAllocator.allocate(buffer.size(), section.header.addralign);
-            }
+      if (section.header.type == elf::SHT_RELA) {
+         // Relocations are read into host memory for processRelocations
+         relaSections.push_back(i);
+      }
+
+      if (!(section.header.flags & elf::SHF_ALLOC)) {
+         continue;
+      }
+
+      void *allocData = nullptr;
+      auto size = getSectionDataSize(data, section.header);
+
+      if (size == 0 && section.header.type != elf::SHT_NOBITS) {
+         gLog->error("Failed to read section data");
+         return nullptr;
+      }
+
+      // Allocate from correct memory segment
+      if (section.header.type == elf::SHT_PROGBITS || section.header.type == elf::SHT_NOBITS) {
+         if (section.header.flags & elf::SHF_EXECINSTR) {
+            allocData = codeAllocator.allocate(size, section.header.addralign);
          } else {
-            allocData = loadAllocator.allocate(buffer.size(), section.header.addralign);
+            allocData = dataAllocator.allocate(size, section.header.addralign);
          }
 
-         memcpy(allocData, buffer.data(), buffer.size());
-         section.memory = reinterpret_cast<uint8_t*>(allocData);
-         section.virtAddress = mem::untranslate(allocData);
-         section.virtSize = static_cast<uint32_t>(buffer.size());
+         imageSections.push_back(i);
+      } else {
+         allocData = loadAllocator.allocate(size, section.header.addralign);
+         loaderSections.push_back(i);
+      }
+
+      section.memory = reinterpret_cast<uint8_t*>(allocData);
+      section.virtAddress = mem::untranslate(allocData);
+      section.virtSize = size;
+   }
+
+   // Look for an image of this module from a previous load at the same
+   //  addresses, the code and data sections are only restored from it once
+   //  we know the imports still resolve to the same addresses.
+   auto cachePath = std::string { };
+   auto cached = CachedModuleImage { };
+   auto cacheHit = false;
+
+   if (decaf::config::system::module_cache) {
+      auto titleId = kernel::getGameInfo().app.title_id;
+      cachePath = decaf::makeConfigPath(fmt::format("module_cache/{:016X}/{}.bin", titleId, moduleName));
+
+      cached.key = ModuleCacheKeyBuilder { }
+         .add(gsl::make_span(data.data(), data.size()))
+         .add(mem::untranslate(codeSegment))
+         .add(mem::untranslate(dataSegment))
+         .add(mem::untranslate(loadSegment))
+         .finish();
+
+      auto image = CachedModuleImage { };
+
+      if (readModuleImage(cachePath, cached.key, image)
+       && restoreCachedSections(sections, loaderSections, image.loaderSections)) {
+         cached = std::move(image);
+         cacheHit = true;
+      }
+   }
+
+   if (!cacheHit) {
+      // Read and inflate the section data across the loader workers
+      auto memorySections = loaderSections;
+      memorySections.insert(memorySections.end(), imageSections.begin(), imageSections.end());
+
+      if (!readSectionList(data, sections, memorySections, relaSections, sectionData)) {
+         return nullptr;
+      }
+
+      if (decaf::config::system::module_cache) {
+         // Imports are resolved in place so save the loader sections now
+         saveCachedSections(sections, loaderSections, cached.loaderSections);
       }
    }
 
+   times.inflate = elapsedMs(stageStart);
+
    // Read strtab
    auto shStrTab = reinterpret_cast<const char*>(sections[header->shstrndx].memory);
 
@@ -1081,31 +1398,109 @@ loadRPL(const std::string &moduleName,
    loadedMod->tlsAlignShift = info.tlsAlignShift;
 
    // Process exports
+   stageStart = LoaderClock::now();
+
    if (!processExports(loadedMod, sections)) {
       gLog->error("Error loading exports");
       return nullptr;
    }
 
+   times.exports = elapsedMs(stageStart);
+
    // Process imports
-   if (!processImports(loadedMod, sections)) {
+   auto dependencyTime = 0.0;
+
+   if (!processImports(loadedMod, sections, dependencyTime)) {
       gLog->error("Error loading imports");
       return nullptr;
    }
 
+   times.imports = elapsedMs(stageStart) - dependencyTime;
+
    // Process symbols
-   if (!processSymbols(loadedMod, sections)) {
-      gLog->error("Error loading symbols");
-      return nullptr;
+   if (cacheHit) {
+      loadedMod->symbols.insert(cached.symbols.begin(), cached.symbols.end());
+   } else {
+      if (!processSymbols(loadedMod, sections)) {
+         gLog->error("Error loading symbols");
+         return nullptr;
+      }
+
+      if (decaf::config::system::module_cache) {
+         cached.symbols.assign(loadedMod->symbols.begin(), loadedMod->symbols.end());
+      }
    }
 
+   times.symbols = elapsedMs(stageStart);
+
    // Process relocations
    auto trampSeg = AddressRange { };
+   auto importKey = ModuleCacheKey { };
+   auto relocated = false;
 
-   if (!processRelocations(loadedMod, sections, data, shStrTab, codeAllocator, trampSeg)) {
-      gLog->error("Error loading relocations");
-      return nullptr;
+   if (cacheHit) {
+      importKey = getImportCacheKey(loadedMod, sections);
+
+      if (importKey == cached.importKey
+       && cached.trampolineAddress == mem::untranslate(codeAllocator.top())
+       && restoreCachedSections(sections, imageSections, cached.imageSections)) {
+         auto trampolines = codeAllocator.allocate(cached.trampolines.size(), 1);
+
+         if (!cached.trampolines.empty()) {
+            std::memcpy(trampolines, cached.trampolines.data(), cached.trampolines.size());
+         }
+
+         trampSeg.first = cached.trampolineAddress;
+         trampSeg.second = mem::untranslate(codeAllocator.top());
+         loadedMod->symbols.insert(cached.trampolineSymbols.begin(), cached.trampolineSymbols.end());
+         relocated = true;
+         gLog->debug("Restored module {} from cache {}", moduleName, cachePath);
+      } else {
+         // The imports have changed, so the code and data have to be
+         //  read from the file and relocated again.
+         gLog->info("Module cache {} does not match the current imports", cachePath);
+         auto rereadStart = LoaderClock::now();
+
+         if (!readSectionList(data, sections, imageSections, relaSections, sectionData)) {
+            return nullptr;
+         }
+
+         times.inflate += elapsedMs(rereadStart);
+         stageStart = rereadStart;
+      }
+   }
+
+   if (!relocated) {
+      if (!processRelocations(loadedMod, sections, sectionData, codeAllocator, trampSeg)) {
+         gLog->error("Error loading relocations");
+         return nullptr;
+      }
+
+      if (decaf::config::system::module_cache) {
+         if (!cacheHit) {
+            importKey = getImportCacheKey(loadedMod, sections);
+         }
+
+         cached.importKey = importKey;
+         saveCachedSections(sections, imageSections, cached.imageSections);
+
+         auto trampolines = reinterpret_cast<uint8_t *>(mem::translate(trampSeg.first));
+         cached.trampolineAddress = trampSeg.first;
+         cached.trampolines.assign(trampolines, trampolines + (trampSeg.second - trampSeg.first));
+         cached.trampolineSymbols.clear();
+
+         for (auto &symbol : loadedMod->symbols) {
+            if (symbol.second.address >= trampSeg.first && symbol.second.address < trampSeg.second) {
+               cached.trampolineSymbols.emplace_back(symbol);
+            }
+         }
+
+         writeModuleImage(cachePath, cached);
+      }
    }
 
+   times.relocations = elapsedMs(stageStart);
+
    // Process dot syscall
    for (auto &section : sections) {
       auto sectionName = shStrTab + section.header.name;
@@ -1184,6 +1579,115 @@ normalizeModuleName(const std::string &name,
    }
 }
 
+static void
+rebuildAddressIndex()
+{
+   auto sections = std::vector<SectionIndexEntry> { };
+   auto symbols = std::vector<SymbolIndexEntry> { };
+   auto moduleSymbols = std::vector<SymbolIndexEntry> { };
+
+   for (auto &itr : sLoadedModules) {
+      auto module = itr.second;
+      moduleSymbols.clear();
+
+      for (auto &symbol : module->symbols) {
+         if (symbol.second.type == SymbolType::Function || symbol.second.type == SymbolType::Data) {
+            moduleSymbols.emplace_back(SymbolIndexEntry { symbol.second.address, &symbol.first });
+         }
+      }
+
+      std::stable_sort(moduleSymbols.begin(), moduleSymbols.end(),
+                       [](const SymbolIndexEntry &lhs, const SymbolIndexEntry &rhs) {
+                          return lhs.address < rhs.address;
+                       });
+
+      for (auto &section : module->sections) {
+         if (section.end <= section.start) {
+            continue;
+         }
+
+         auto first = std::lower_bound(moduleSymbols.begin(), moduleSymbols.end(), section.start,
+                                       [](const SymbolIndexEntry &entry, ppcaddr_t address) {
+                                          return entry.address < address;
+                                       });
+         auto last = std::lower_bound(first, moduleSymbols.end(), section.end,
+                                      [](const SymbolIndexEntry &entry, ppcaddr_t address) {
+                                         return entry.address < address;
+                                      });
+
+         sections.emplace_back(SectionIndexEntry {
+            section.start,
+            section.end,
+            module,
+            &section,
+            static_cast<uint32_t>(symbols.size()),
+            static_cast<uint32_t>(last - first)
+         });
+
+         symbols.insert(symbols.end(), first, last);
+      }
+   }
+
+   std::sort(sections.begin(), sections.end(),
+             [](const SectionIndexEntry &lhs, const SectionIndexEntry &rhs) {
+                return lhs.start < rhs.start;
+             });
+
+   std::unique_lock<std::mutex> lock { sAddressIndexMutex };
+   sSectionIndex.swap(sections);
+   sSymbolIndex.swap(symbols);
+}
+
+// Returns the first section in the index after first which starts after
+//  address, sAddressIndexMutex must be held.
+static std::vector<SectionIndexEntry>::const_iterator
+findSectionIndexUpperBound(std::vector<SectionIndexEntry>::const_iterator first,
+                           ppcaddr_t address)
+{
+   return std::upper_bound(first, sSectionIndex.cend(), address,
+                           [](ppcaddr_t address, const SectionIndexEntry &entry) {
+                              return address < entry.start;
+                           });
+}
+
+// Fill in info for address given the section returned by
+//  findSectionIndexUpperBound, sAddressIndexMutex must be held.
+static void
+lookupAddressInSection(ppcaddr_t address,
+                       std::vector<SectionIndexEntry>::const_iterator section,
+                       AddressInfo &info)
+{
+   info = AddressInfo { };
+   info.address = address;
+
+   if (section == sSectionIndex.cbegin()) {
+      return;
+   }
+
+   --section;
+
+   if (address >= section->end) {
+      return;
+   }
+
+   info.module = section->module;
+   info.section = section->section;
+
+   // Find the last symbol at or before address
+   auto first = sSymbolIndex.cbegin() + section->firstSymbol;
+   auto last = first + section->numSymbols;
+   auto symbol = std::upper_bound(first, last, address,
+                                  [](ppcaddr_t address, const SymbolIndexEntry &entry) {
+                                     return address < entry.address;
+                                  });
+
+   if (symbol != first) {
+      --symbol;
+      info.symbol = symbol->name;
+      info.symbolAddress = symbol->address;
+   }
+}
+
 LoadedModule *
 loadRPLNoLock(const std::string &name)
 {
@@ -1215,21 +1719,39 @@ loadRPLNoLock(const std::string &name)
       auto result = fs->openFile("/vol/code/" + fileName, fs::File::Read);
 
       if (result) {
+         auto readStart = LoaderClock::now();
          auto fh = result.value();
          auto buffer = std::vector<uint8_t>(fh->size());
          fh->read(buffer.data(), buffer.size(), 1);
          fh->close();
 
+         auto readTime = elapsedMs(readStart);
          module = loadRPL(moduleName, fileName, buffer);
+
+         if (module) {
+            auto &times = module->loadTimes;
+            times.read = readTime;
+            times.total = times.read + times.inflate + times.exports + times.imports + times.symbols + times.relocations;
+
+            gLog->info("Module {} load times: read {:.2f}ms, inflate {:.2f}ms, exports {:.2f}ms, imports {:.2f}ms, symbols {:.2f}ms, relocations {:.2f}ms, total {:.2f}ms",
+                       fileName, times.read, times.inflate, times.exports, times.imports, times.symbols, times.relocations, times.total);
+
+            // Patched after loading so the module cache keeps the original code
+            if (decaf::config::jit::replace_libc_routines) {
+               replaceLibcRoutines(module);
+            }
+         }
       }
    }
 
    if (!module) {
       gLog->error("Failed to load module {}", fileName);
       sLoadedModules.erase(moduleName);
+      rebuildAddressIndex();
       return nullptr;
    } else {
       gLog->info("Loaded module {}", fileName);
+      rebuildAddressIndex();
       return module;
    }
 }
@@ -1276,14 +1798,7 @@ findModule(const std::string& name)
 LoadedSection *
 findSectionForAddress(ppcaddr_t address)
 {
-   for (auto &mod : sLoadedModules) {
-      for (auto &sec : mod.second->sections) {
-         if (address >= sec.start && address < sec.end) {
-            return &sec;
-         }
-      }
-   }
-   return nullptr;
+   return lookupAddress(address).section;
 }
 
 std::string *
@@ -1301,21 +1816,77 @@ findSymbolNameForAddress(ppcaddr_t address)
 std::string
 findNearestSymbolNameForAddress(ppcaddr_t address)
 {
-   auto symIter = sGlobalSymbolLookup.lower_bound(address);
+   return formatAddressInfo(lookupAddress(address));
+}
 
-   if (symIter == sGlobalSymbolLookup.end()) {
+AddressInfo
+lookupAddress(ppcaddr_t address)
+{
+   std::unique_lock<std::mutex> lock { sAddressIndexMutex };
+   auto info = AddressInfo { };
+   lookupAddressInSection(address, findSectionIndexUpperBound(sSectionIndex.cbegin(), address), info);
+   return info;
+}
+
+void
+lookupAddresses(gsl::span<const ppcaddr_t> addresses,
+                std::vector<AddressInfo> &results)
+{
+   auto order = std::vector<uint32_t>(addresses.size());
+   results.resize(addresses.size());
+
+   for (auto i = 0u; i < order.size(); ++i) {
+      order[i] = i;
+   }
+
+   // Visit the addresses in ascending order so each search can start from
+   //  the section the previous address was found in.
+   std::sort(order.begin(), order.end(),
+             [&](uint32_t lhs, uint32_t rhs) {
+                return addresses[lhs] < addresses[rhs];
+             });
+
+   std::unique_lock<std::mutex> lock { sAddressIndexMutex };
+   auto section = sSectionIndex.cbegin();
+
+   for (auto index : order) {
+      auto address = addresses[index];
+      section = findSectionIndexUpperBound(section, address);
+      lookupAddressInSection(address, section, results[index]);
+   }
+}
+
+std::string
+formatAddressInfo(const AddressInfo &info)
+{
+   if (!info.symbol) {
       return "?";
    }
 
-   auto delta = address - symIter->first;
+   auto delta = info.address - info.symbolAddress;
 
    if (delta == 0) {
-      return symIter->second;
+      return fmt::format("{}:{}", info.module->name, *info.symbol);
    } else {
-      return fmt::format("{} + 0x{:x}", symIter->second, delta);
+      return fmt::format("{}:{} + 0x{:x}", info.module->name, *info.symbol, delta);
    }
 }
 
+std::vector<std::string>
+symbolizeAddresses(gsl::span<const ppcaddr_t> addresses)
+{
+   auto infos = std::vector<AddressInfo> { };
+   auto names = std::vector<std::string> { };
+   lookupAddresses(addresses, infos);
+   names.reserve(infos.size());
+
+   for (auto &info : infos) {
+      names.emplace_back(formatAddressInfo(info));
+   }
+
+   return names;
+}
+
 std::map<std::string, LoadedModule *>
 getLoadedModules()
 {
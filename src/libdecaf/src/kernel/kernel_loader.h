@@ -2,10 +2,13 @@
 #include "ppcutils/wfunc_ptr.h"
 
 #include <common/decaf_assert.h>
+#include <gsl.h>
 #include <libcpu/mem.h>
 #include <limits>
+#include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 namespace kernel
 {
@@ -62,6 +65,19 @@ struct Symbol
    SymbolType type;
 };
 
+//! Host time in milliseconds spent in each stage of loading an RPL, the
+//  time spent loading its dependencies is not included.
+struct ModuleLoadTimes
+{
+   double read = 0.0;
+   double inflate = 0.0;
+   double exports = 0.0;
+   double imports = 0.0;
+   double symbols = 0.0;
+   double relocations = 0.0;
+   double total = 0.0;
+};
+
 struct LoadedModule
 {
    ppcaddr_t
@@ -125,11 +141,27 @@ struct LoadedModule
    uint32_t tlsAlignShift = 0;
    uint32_t tlsSize = 0;
    bool entryCalled = false;
+   ModuleLoadTimes loadTimes;
    std::vector<LoadedSection> sections;
-   std::map<std::string, ppcaddr_t> exports;
+   std::unordered_map<std::string, ppcaddr_t> exports;
    std::map<std::string, Symbol> symbols;
 };
 
+//! Where a guest address lies in the loaded modules
+struct AddressInfo
+{
+   ppcaddr_t address = 0;
+
+   //! Module and section containing the address, nullptr if none does
+   LoadedModule *module = nullptr;
+   LoadedSection *section = nullptr;
+
+   //! Nearest function or data symbol at or before the address in the
+   //  same section, nullptr if there is none
+   const std::string *symbol = nullptr;
+   ppcaddr_t symbolAddress = 0;
+};
+
 void
 lockLoader();
 
@@ -154,6 +186,22 @@ findSymbolNameForAddress(ppcaddr_t address);
 std::string
 findNearestSymbolNameForAddress(ppcaddr_t address);
 
+AddressInfo
+lookupAddress(ppcaddr_t address);
+
+//! Look up many addresses at once, faster than calling lookupAddress for
+//  each when there are a lot of them, e.g. when symbolizing profiles.
+void
+lookupAddresses(gsl::span<const ppcaddr_t> addresses,
+                std::vector<AddressInfo> &results);
+
+//! Formats as module:symbol + 0xoffset, or ? if there is no symbol
+std::string
+formatAddressInfo(const AddressInfo &info);
+
+std::vector<std::string>
+symbolizeAddresses(gsl::span<const ppcaddr_t> addresses);
+
 std::map<std::string, LoadedModule*>
 getLoadedModules();
 
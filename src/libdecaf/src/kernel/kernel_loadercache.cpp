@@ -0,0 +1,230 @@
+#include "kernel_loadercache.h"
+
+#include <common/log.h>
+#include <common/murmur3.h>
+#include <common/platform_dir.h>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace kernel
+{
+
+namespace loader
+{
+
+static const std::array<char, 4> ModuleCacheMagic =
+{
+   'D', 'M', 'O', 'D'
+};
+
+struct ModuleCacheHeader
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+   ModuleCacheKey key;
+};
+
+ModuleCacheKeyBuilder &
+ModuleCacheKeyBuilder::add(gsl::span<const uint8_t> data)
+{
+   // Hash large blocks up front rather than keeping a copy of them around
+   auto hash = ModuleCacheKey { };
+   MurmurHash3_x64_128(data.data(), static_cast<int>(data.size()), 0, hash.data());
+
+   auto bytes = reinterpret_cast<const uint8_t *>(hash.data());
+   mData.insert(mData.end(), bytes, bytes + sizeof(hash));
+   return *this;
+}
+
+ModuleCacheKeyBuilder &
+ModuleCacheKeyBuilder::add(uint32_t value)
+{
+   auto bytes = reinterpret_cast<const uint8_t *>(&value);
+   mData.insert(mData.end(), bytes, bytes + sizeof(value));
+   return *this;
+}
+
+ModuleCacheKey
+ModuleCacheKeyBuilder::finish() const
+{
+   auto key = ModuleCacheKey { };
+   MurmurHash3_x64_128(mData.data(), static_cast<int>(mData.size()), 0, key.data());
+   return key;
+}
+
+template<typename Type>
+static void
+writeValue(std::ofstream &out,
+           const Type &value)
+{
+   static_assert(std::is_trivially_copyable<Type>::value, "Only trivial types can be written directly");
+   out.write(reinterpret_cast<const char *>(&value), sizeof(Type));
+}
+
+static void
+writeBytes(std::ofstream &out,
+           const void *data,
+           uint32_t size)
+{
+   writeValue(out, size);
+   out.write(reinterpret_cast<const char *>(data), size);
+}
+
+static void
+writeSections(std::ofstream &out,
+              const std::vector<CachedSection> &sections)
+{
+   writeValue(out, static_cast<uint32_t>(sections.size()));
+
+   for (auto &section : sections) {
+      writeValue(out, section.index);
+      writeBytes(out, section.data.data(), static_cast<uint32_t>(section.data.size()));
+   }
+}
+
+static void
+writeSymbols(std::ofstream &out,
+             const std::vector<std::pair<std::string, Symbol>> &symbols)
+{
+   writeValue(out, static_cast<uint32_t>(symbols.size()));
+
+   for (auto &symbol : symbols) {
+      writeBytes(out, symbol.first.data(), static_cast<uint32_t>(symbol.first.size()));
+      writeValue(out, symbol.second);
+   }
+}
+
+template<typename Type>
+static bool
+readValue(std::ifstream &in,
+          Type &value)
+{
+   static_assert(std::is_trivially_copyable<Type>::value, "Only trivial types can be read directly");
+   return !!in.read(reinterpret_cast<char *>(&value), sizeof(Type));
+}
+
+template<typename Container>
+static bool
+readBytes(std::ifstream &in,
+          Container &data)
+{
+   auto size = uint32_t { 0 };
+
+   if (!readValue(in, size)) {
+      return false;
+   }
+
+   data.resize(size);
+
+   if (size == 0) {
+      return true;
+   }
+
+   return !!in.read(reinterpret_cast<char *>(&data[0]), size);
+}
+
+static bool
+readSections(std::ifstream &in,
+             std::vector<CachedSection> &sections)
+{
+   auto count = uint32_t { 0 };
+
+   if (!readValue(in, count)) {
+      return false;
+   }
+
+   sections.resize(count);
+
+   for (auto &section : sections) {
+      if (!readValue(in, section.index) || !readBytes(in, section.data)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static bool
+readSymbols(std::ifstream &in,
+            std::vector<std::pair<std::string, Symbol>> &symbols)
+{
+   auto count = uint32_t { 0 };
+
+   if (!readValue(in, count)) {
+      return false;
+   }
+
+   symbols.resize(count);
+
+   for (auto &symbol : symbols) {
+      if (!readBytes(in, symbol.first) || !readValue(in, symbol.second)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+bool
+readModuleImage(const std::string &path,
+                const ModuleCacheKey &key,
+                CachedModuleImage &image)
+{
+   if (!platform::fileExists(path)) {
+      return false;
+   }
+
+   auto in = std::ifstream { path, std::ifstream::in | std::ifstream::binary };
+   auto header = ModuleCacheHeader { };
+
+   if (!readValue(in, header)
+    || header.magic != ModuleCacheMagic
+    || header.version != ModuleCacheVersion
+    || header.key != key) {
+      gLog->info("Discarding out of date module cache {}", path);
+      return false;
+   }
+
+   image.key = header.key;
+
+   if (!readValue(in, image.importKey)
+    || !readSections(in, image.loaderSections)
+    || !readSections(in, image.imageSections)
+    || !readSymbols(in, image.symbols)
+    || !readValue(in, image.trampolineAddress)
+    || !readBytes(in, image.trampolines)
+    || !readSymbols(in, image.trampolineSymbols)) {
+      gLog->warn("Ignoring corrupt module cache {}", path);
+      return false;
+   }
+
+   return true;
+}
+
+bool
+writeModuleImage(const std::string &path,
+                 const CachedModuleImage &image)
+{
+   platform::createParentDirectories(path);
+   auto out = std::ofstream { path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc };
+
+   if (!out.is_open()) {
+      gLog->error("Could not open module cache {}", path);
+      return false;
+   }
+
+   writeValue(out, ModuleCacheHeader { ModuleCacheMagic, ModuleCacheVersion, image.key });
+   writeValue(out, image.importKey);
+   writeSections(out, image.loaderSections);
+   writeSections(out, image.imageSections);
+   writeSymbols(out, image.symbols);
+   writeValue(out, image.trampolineAddress);
+   writeBytes(out, image.trampolines.data(), static_cast<uint32_t>(image.trampolines.size()));
+   writeSymbols(out, image.trampolineSymbols);
+   return !!out;
+}
+
+} // namespace loader
+
+} // namespace kernel
@@ -0,0 +1,90 @@
+#pragma once
+#include "kernel_loader.h"
+
+#include <array>
+#include <cstdint>
+#include <gsl.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kernel
+{
+
+namespace loader
+{
+
+//! Bump whenever the loader changes what it writes into a module's memory
+static const uint32_t ModuleCacheVersion = 1;
+
+using ModuleCacheKey = std::array<uint64_t, 2>;
+
+//! Builds a ModuleCacheKey from the file contents and load addresses.
+class ModuleCacheKeyBuilder
+{
+public:
+   ModuleCacheKeyBuilder &
+   add(gsl::span<const uint8_t> data);
+
+   ModuleCacheKeyBuilder &
+   add(uint32_t value);
+
+   ModuleCacheKey
+   finish() const;
+
+private:
+   std::vector<uint8_t> mData;
+};
+
+struct CachedSection
+{
+   //! Index of the section in the elf section header table
+   uint32_t index;
+   std::vector<uint8_t> data;
+};
+
+/**
+ * The memory image of an RPL after it has been loaded, so the next load of
+ * the same file at the same addresses can skip inflating and relocating it.
+ *
+ * The image is only usable if the imports resolve to the same addresses as
+ * when it was saved, which is checked against importKey once the imports
+ * have been processed.
+ */
+struct CachedModuleImage
+{
+   //! Hash of the file and the segment addresses it was loaded at
+   ModuleCacheKey key = { };
+
+   //! Hash of the resolved import tables and TLS module indices
+   ModuleCacheKey importKey = { };
+
+   //! Loader segment sections as read from the file, before imports are
+   //  resolved into them
+   std::vector<CachedSection> loaderSections;
+
+   //! Code and data sections after relocation
+   std::vector<CachedSection> imageSections;
+
+   //! Symbols from the symbol tables, not including trampolines
+   std::vector<std::pair<std::string, Symbol>> symbols;
+
+   //! Trampolines allocated at the end of the code segment for branches
+   //  which were out of range of their target
+   ppcaddr_t trampolineAddress = 0;
+   std::vector<uint8_t> trampolines;
+   std::vector<std::pair<std::string, Symbol>> trampolineSymbols;
+};
+
+bool
+readModuleImage(const std::string &path,
+                const ModuleCacheKey &key,
+                CachedModuleImage &image);
+
+bool
+writeModuleImage(const std::string &path,
+                 const CachedModuleImage &image);
+
+} // namespace loader
+
+} // namespace kernel
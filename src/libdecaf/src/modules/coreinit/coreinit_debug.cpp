@@ -156,40 +156,11 @@ OSGetSymbolName(uint32_t address,
                 char *buffer,
                 uint32_t bufsize)
 {
-   const char *foundModule = nullptr;
-   const char *foundSymbol = nullptr;
-   uint32_t foundAddress;
-
-   kernel::loader::lockLoader();
-   const auto &modules = kernel::loader::getLoadedModules();
-
-   for (auto &i : modules) {
-      auto mod = i.second;
-      auto sec = mod->findAddressSection(address);
-
-      if (sec) {
-         const char *closestSym = nullptr;
-         auto closestAddr = sec->start;
-         for (auto &sym : mod->symbols) {
-            if (sym.second.address >= closestAddr && sym.second.address <= address) {
-               closestSym = sym.first.c_str();
-               closestAddr = sym.second.address;
-            }
-         }
-         if (closestSym) {
-            foundModule = mod->name.c_str();
-            foundSymbol = closestSym;
-            foundAddress = closestAddr;
-         }
-         break;
-      }
-   }
-
-   kernel::loader::unlockLoader();
+   auto info = kernel::loader::lookupAddress(address);
 
-   if (foundSymbol) {
-      snprintf(buffer, bufsize, "%s|%s", foundModule, foundSymbol);
-      return foundAddress;
+   if (info.symbol) {
+      snprintf(buffer, bufsize, "%s|%s", info.module->name.c_str(), info.symbol->c_str());
+      return info.symbolAddress;
    } else {
       snprintf(buffer, bufsize, "<unknown>");
       return address;
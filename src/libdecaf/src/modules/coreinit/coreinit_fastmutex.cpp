@@ -355,9 +355,9 @@ void
 Module::registerFastMutexFunctions()
 {
    RegisterKernelFunction(OSFastMutex_Init);
-   RegisterKernelFunction(OSFastMutex_Lock);
-   RegisterKernelFunction(OSFastMutex_TryLock);
-   RegisterKernelFunction(OSFastMutex_Unlock);
+   RegisterKernelFunctionDirect(OSFastMutex_Lock);
+   RegisterKernelFunctionDirect(OSFastMutex_TryLock);
+   RegisterKernelFunctionDirect(OSFastMutex_Unlock);
    RegisterKernelFunction(OSFastCond_Init);
    RegisterKernelFunction(OSFastCond_Wait);
    RegisterKernelFunction(OSFastCond_Signal);
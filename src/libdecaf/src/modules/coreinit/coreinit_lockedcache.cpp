@@ -4,7 +4,7 @@
 #include "coreinit_thread.h"
 #include "gpu/gpu_flush.h"
 #include "libcpu/mem.h"
-#include <common/teenyheap.h>
+#include <common/tlsfheap.h>
 #include <array>
 
 namespace coreinit
@@ -16,7 +16,7 @@ sLockedCacheAlign = 512;
 static const auto
 sLockedCacheSize = 16u * 1024;
 
-static std::array<TeenyHeap *, CoreCount>
+static std::array<TlsfHeap *, CoreCount>
 sLockedCache;
 
 static std::array<bool, CoreCount>
@@ -204,7 +204,7 @@ Module::initialiseLockedCache()
    sDMAEnabled.fill(false);
 
    for (auto i = 0u; i < CoreCount; ++i) {
-      sLockedCache[i] = new TeenyHeap(base + (sLockedCacheSize * i), sLockedCacheSize);
+      sLockedCache[i] = new TlsfHeap(base + (sLockedCacheSize * i), sLockedCacheSize);
    }
 }
 
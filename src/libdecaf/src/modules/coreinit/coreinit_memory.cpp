@@ -4,7 +4,7 @@
 #include "kernel/kernel_memory.h"
 
 #include <common/platform_memory.h>
-#include <common/teenyheap.h>
+#include <common/tlsfheap.h>
 #include <libcpu/mem.h>
 
 namespace coreinit
@@ -47,7 +47,7 @@ struct VallocAllocation
 static uint8_t *
 sPhysDataStore = nullptr;
 
-static TeenyHeap *
+static TlsfHeap *
 sVallocVirtualMemHeap = nullptr;
 
 static std::vector<VallocAllocation>
@@ -330,7 +330,7 @@ initialiseVallocMemory()
    memset(sPhysDataStore, 0, VALLOC_PHYS_MEM_SIZE);
 
    sVallocVirtualMemHeap =
-      new TeenyHeap(mem::translate(VALLOC_VIRT_MEM_START), VALLOC_VIRT_MEM_SIZE);
+      new TlsfHeap(mem::translate(VALLOC_VIRT_MEM_START), VALLOC_VIRT_MEM_SIZE);
 
    platform::commitMemory(
       mem::base() + VALLOC_VIRT_MEM_START,
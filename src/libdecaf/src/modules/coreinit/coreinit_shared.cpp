@@ -5,7 +5,7 @@
 #include <common/be_ptr.h>
 #include <common/be_val.h>
 #include <common/structsize.h>
-#include <common/teenyheap.h>
+#include <common/tlsfheap.h>
 #include <fstream>
 #include <gsl.h>
 #include <libcpu/mem.h>
@@ -24,7 +24,7 @@ static std::array<FontData, 4>
 sFonts;
 
 // TODO: Delete me on game unload
-static TeenyHeap *
+static TlsfHeap *
 sSharedHeap = nullptr;
 
 BOOL
@@ -75,7 +75,7 @@ readFont(FontData &dst, const char *src)
 void
 Module::initialiseShared()
 {
-   sSharedHeap = new TeenyHeap(mem::translate(mem::SharedDataBase), mem::SharedDataSize);
+   sSharedHeap = new TlsfHeap(mem::translate(mem::SharedDataBase), mem::SharedDataSize);
    readFont(sFonts[0], "resources/fonts/SourceSansPro-Regular.ttf");
    sFonts[1] = sFonts[0];
    sFonts[2] = sFonts[0];
@@ -1030,7 +1030,7 @@ Module::registerThreadFunctions()
    RegisterKernelFunction(OSDetachThread);
    RegisterKernelFunction(OSExitThread);
    RegisterKernelFunction(OSGetActiveThreadLink);
-   RegisterKernelFunction(OSGetCurrentThread);
+   RegisterKernelFunctionLeaf(OSGetCurrentThread);
    RegisterKernelFunction(OSGetDefaultThread);
    RegisterKernelFunction(OSGetStackPointer);
    RegisterKernelFunction(OSGetThreadAffinity);
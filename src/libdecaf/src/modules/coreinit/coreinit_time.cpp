@@ -144,10 +144,10 @@ Module::initialiseClock()
 void
 Module::registerTimeFunctions()
 {
-   RegisterKernelFunction(OSGetTime);
-   RegisterKernelFunction(OSGetTick);
-   RegisterKernelFunction(OSGetSystemTime);
-   RegisterKernelFunction(OSGetSystemTick);
+   RegisterKernelFunctionLeaf(OSGetTime);
+   RegisterKernelFunctionLeaf(OSGetTick);
+   RegisterKernelFunctionLeaf(OSGetSystemTime);
+   RegisterKernelFunctionLeaf(OSGetSystemTick);
    RegisterKernelFunction(OSTicksToCalendarTime);
    RegisterKernelFunction(OSCalendarTimeToTicks);
 }
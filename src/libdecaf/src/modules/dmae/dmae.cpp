@@ -6,6 +6,7 @@ namespace dmae
 void
 Module::initialise()
 {
+   initialiseCore();
 }
 
 void
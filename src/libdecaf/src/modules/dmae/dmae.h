@@ -14,6 +14,8 @@ public:
 
 private:
    static void registerCoreFunctions();
+
+   void initialiseCore();
 };
 
 } // namespace sysapp
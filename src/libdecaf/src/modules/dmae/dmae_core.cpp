@@ -1,79 +1,270 @@
 #include "dmae.h"
+#include "dmae_core.h"
+#include "gpu/gpu_flush.h"
+#include "modules/coreinit/coreinit_alarm.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+#include "modules/coreinit/coreinit_thread.h"
 #include "modules/coreinit/coreinit_time.h"
+#include "ppcutils/stackobject.h"
 
-#include <common/cbool.h>
-#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <common/byte_swap_array.h>
+#include <common/log.h>
+#include <common/platform_thread.h>
+#include <condition_variable>
+#include <libcpu/cpu.h>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <thread>
 
 namespace dmae
 {
 
-enum class DMAEEndianSwapMode : uint32_t
+struct DmaeCommand
 {
-   None = 0,
-   Swap8In16 = 1,
-   Swap8In32 = 2
+   enum Type
+   {
+      Copy,
+      Fill,
+   };
+
+   Type type;
+   void *dst;
+   const void *src;
+   uint32_t value;
+   uint32_t numDwords;
+   DMAEEndianSwapMode endian;
+   coreinit::OSTime timestamp;
+};
+
+struct DmaeWaitData
+{
+   coreinit::OSThread *thread;
+   BOOL timeout;
 };
 
-static uint32_t
-sDmaeTimeout = 5;
+//! Timeout for DMAEWaitDone in seconds
+static std::atomic<uint32_t>
+sDmaeTimeout { 5 };
+
+//! Guest threads waiting in DMAEWaitDone
+static coreinit::OSThreadQueue *
+sDmaeWaitQueue = nullptr;
+
+static coreinit::AlarmCallback
+sDmaeTimeoutAlarmHandler = nullptr;
+
+//! Written only by the DMAE thread, read by waiters under the scheduler lock
+static std::atomic<coreinit::OSTime>
+sRetiredTimeStamp { 0 };
+
+//! Cores which have a guest thread in DMAEWaitDone, these are sent the
+//  DMAE interrupt when a command retires.
+static std::atomic<uint32_t>
+sWaitingCores { 0 };
+
+static std::thread
+sDmaeThread;
+
+//! Protects everything below
+static std::mutex
+sDmaeMutex;
+
+static bool
+sDmaeThreadRunning = false;
+
+static std::condition_variable
+sDmaeSubmitCond;
+
+static std::queue<DmaeCommand>
+sDmaeQueue;
+
+static coreinit::OSTime
+sLastSubmittedTimeStamp = 0;
+
+static void
+executeCommand(const DmaeCommand &command)
+{
+   if (command.type == DmaeCommand::Copy) {
+      if (command.endian == DMAEEndianSwapMode::None) {
+         std::memmove(command.dst, command.src, command.numDwords * 4);
+      } else if (command.endian == DMAEEndianSwapMode::Swap8In16) {
+         byte_swap_array(reinterpret_cast<const uint16_t *>(command.src),
+                         reinterpret_cast<uint16_t *>(command.dst),
+                         command.numDwords * 2);
+      } else if (command.endian == DMAEEndianSwapMode::Swap8In32) {
+         byte_swap_array(reinterpret_cast<const uint32_t *>(command.src),
+                         reinterpret_cast<uint32_t *>(command.dst),
+                         command.numDwords);
+      }
+   } else if (command.type == DmaeCommand::Fill) {
+      // Note that rather than using be_val here, we simply byte-swap
+      //  the incoming word before we enter the loop to write it out.
+      auto dstDwords = reinterpret_cast<uint32_t *>(command.dst);
+      std::fill_n(dstDwords, command.numDwords, byte_swap(command.value));
+   }
+
+   // The destination may be backing a GPU resource
+   gpu::notifyCpuFlush(command.dst, command.numDwords * 4);
+}
+
+static void
+dmaeThreadEntry()
+{
+   std::unique_lock<std::mutex> lock { sDmaeMutex };
+
+   while (true) {
+      sDmaeSubmitCond.wait(lock, []() { return !sDmaeThreadRunning || !sDmaeQueue.empty(); });
+
+      if (sDmaeQueue.empty()) {
+         // Only exit once everything submitted has been retired
+         break;
+      }
+
+      auto command = sDmaeQueue.front();
+      sDmaeQueue.pop();
+
+      lock.unlock();
+      executeCommand(command);
+      sRetiredTimeStamp = command.timestamp;
+
+      // Our retired timestamp must be stored before we read the waiting
+      //  cores, a waiter marks its core before checking the timestamp.
+      auto cores = sWaitingCores.exchange(0);
+
+      for (auto core = 0u; core < 3; ++core) {
+         if (cores & (1 << core)) {
+            cpu::interrupt(core, cpu::DMAE_INTERRUPT);
+         }
+      }
+
+      lock.lock();
+   }
+}
 
 static coreinit::OSTime
-sLastTimeStamp = 0;
+submitCommand(DmaeCommand command)
+{
+   std::unique_lock<std::mutex> lock { sDmaeMutex };
+
+   if (!sDmaeThreadRunning) {
+      sDmaeThreadRunning = true;
+      sDmaeThread = std::thread { dmaeThreadEntry };
+      platform::setThreadName(&sDmaeThread, "DMAE");
+   }
+
+   // Timestamps must be unique and increasing as waiting on one waits for
+   //  everything submitted before it.
+   command.timestamp = std::max(coreinit::OSGetTime(), sLastSubmittedTimeStamp + 1);
+   sLastSubmittedTimeStamp = command.timestamp;
+   sDmaeQueue.push(command);
+   sDmaeSubmitCond.notify_all();
+   return command.timestamp;
+}
 
 coreinit::OSTime
 DMAEGetRetiredTimeStamp()
 {
-   return sLastTimeStamp;
+   return sRetiredTimeStamp.load();
 }
 
 coreinit::OSTime
 DMAEGetLastSubmittedTimeStamp()
 {
-   return sLastTimeStamp;
+   std::unique_lock<std::mutex> lock { sDmaeMutex };
+   return sLastSubmittedTimeStamp;
 }
 
+static void
+DmaeTimeoutAlarmHandler(coreinit::OSAlarm *alarm,
+                        coreinit::OSContext *context)
+{
+   auto data = reinterpret_cast<DmaeWaitData *>(coreinit::OSGetAlarmUserData(alarm));
+   data->timeout = TRUE;
+
+   // System Alarm, we already have the scheduler lock
+   coreinit::internal::wakeupOneThreadNoLock(data->thread);
+}
+
+/**
+ * Wait for the DMA engine to retire timestamp.
+ *
+ * Sleeps the calling guest thread rather than the host core, it is woken by
+ * the DMAE interrupt as commands retire or by an alarm after the timeout.
+ *
+ * Returns FALSE if the wait timed out.
+ */
 BOOL
 DMAEWaitDone(coreinit::OSTime timestamp)
 {
-   return TRUE;
-}
+   ppcutils::StackObject<DmaeWaitData> data;
+   ppcutils::StackObject<coreinit::OSAlarm> alarm;
 
-coreinit::OSTime
-DMAECopyMem(void *dst, void *src, uint32_t numDwords, DMAEEndianSwapMode endian)
-{
-   if (endian == DMAEEndianSwapMode::None) {
-      memcpy(dst, src, numDwords * 4);
-   } else if (endian == DMAEEndianSwapMode::Swap8In16) {
-      auto dstWords = reinterpret_cast<uint16_t*>(dst);
-      auto srcWords = reinterpret_cast<uint16_t*>(src);
-      for (uint32_t i = 0; i < numDwords * 2; ++i) {
-         *dstWords++ = byte_swap(*srcWords++);
-      }
-   } else if (endian == DMAEEndianSwapMode::Swap8In32) {
-      auto dstDwords = reinterpret_cast<uint32_t*>(dst);
-      auto srcDwords = reinterpret_cast<uint32_t*>(src);
-      for (uint32_t i = 0; i < numDwords; ++i) {
-         *dstDwords++ = byte_swap(*srcDwords++);
+   if (sRetiredTimeStamp.load() >= timestamp) {
+      return TRUE;
+   }
+
+   coreinit::internal::lockScheduler();
+   data->thread = coreinit::OSGetCurrentThread();
+   data->timeout = FALSE;
+
+   auto timeoutTicks = coreinit::internal::msToTicks(static_cast<coreinit::OSTime>(sDmaeTimeout.load()) * 1000);
+   coreinit::OSCreateAlarm(alarm);
+   coreinit::internal::setAlarmInternal(alarm, timeoutTicks, sDmaeTimeoutAlarmHandler, data);
+
+   while (true) {
+      sWaitingCores |= 1 << cpu::this_core::id();
+
+      if (sRetiredTimeStamp.load() >= timestamp || data->timeout) {
+         break;
       }
+
+      coreinit::internal::sleepThreadNoLock(sDmaeWaitQueue);
+      coreinit::internal::rescheduleSelfNoLock();
    }
 
-   sLastTimeStamp = coreinit::OSGetTime();
-   return sLastTimeStamp;
+   if (!data->timeout) {
+      coreinit::internal::cancelAlarm(alarm);
+   }
+
+   coreinit::internal::unlockScheduler();
+
+   if (sRetiredTimeStamp.load() < timestamp) {
+      gLog->warn("DMAEWaitDone timed out waiting for timestamp {}, last retired {}", timestamp, sRetiredTimeStamp.load());
+      return FALSE;
+   }
+
+   return TRUE;
 }
 
 coreinit::OSTime
-DMAEFillMem(void *dst, uint32_t value, uint32_t numDwords)
-{
-   // Note that rather than using be_val here, we simply byte-swap
-   //  the incoming word before we enter the loop to write it out.
-   auto dstValue = byte_swap(value);
-   auto dstDwords = reinterpret_cast<uint32_t*>(dst);
-   for (uint32_t i = 0; i < numDwords; ++i) {
-      dstDwords[i] = dstValue;
-   }
+DMAECopyMem(void *dst,
+            void *src,
+            uint32_t numDwords,
+            DMAEEndianSwapMode endian)
+{
+   auto command = DmaeCommand { };
+   command.type = DmaeCommand::Copy;
+   command.dst = dst;
+   command.src = src;
+   command.numDwords = numDwords;
+   command.endian = endian;
+   return submitCommand(command);
+}
 
-   sLastTimeStamp = coreinit::OSGetTime();
-   return sLastTimeStamp;
+coreinit::OSTime
+DMAEFillMem(void *dst,
+            uint32_t value,
+            uint32_t numDwords)
+{
+   auto command = DmaeCommand { };
+   command.type = DmaeCommand::Fill;
+   command.dst = dst;
+   command.value = value;
+   command.numDwords = numDwords;
+   return submitCommand(command);
 }
 
 void
@@ -88,6 +279,41 @@ DMAEGetTimeout()
    return sDmaeTimeout;
 }
 
+namespace internal
+{
+
+/**
+ * Called from the DMAE interrupt handler to wake any guest threads waiting
+ * for a command to retire.
+ */
+void
+handleDmaeInterrupt()
+{
+   coreinit::OSWakeupThread(sDmaeWaitQueue);
+}
+
+void
+stopDmaeThread()
+{
+   std::unique_lock<std::mutex> lock { sDmaeMutex };
+
+   if (sDmaeThreadRunning) {
+      sDmaeThreadRunning = false;
+      sDmaeSubmitCond.notify_all();
+      lock.unlock();
+
+      sDmaeThread.join();
+   }
+}
+
+} // namespace internal
+
+void
+Module::initialiseCore()
+{
+   coreinit::OSInitThreadQueue(sDmaeWaitQueue);
+}
+
 void
 Module::registerCoreFunctions()
 {
@@ -98,6 +324,9 @@ Module::registerCoreFunctions()
    RegisterKernelFunction(DMAEFillMem);
    RegisterKernelFunction(DMAESetTimeout);
    RegisterKernelFunction(DMAEGetTimeout);
+
+   RegisterInternalFunction(DmaeTimeoutAlarmHandler, sDmaeTimeoutAlarmHandler);
+   RegisterInternalData(sDmaeWaitQueue);
 }
 
 } // namespace sysapp
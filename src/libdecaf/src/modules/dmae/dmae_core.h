@@ -0,0 +1,54 @@
+#pragma once
+#include "modules/coreinit/coreinit_time.h"
+
+#include <common/cbool.h>
+#include <cstdint>
+
+namespace dmae
+{
+
+enum class DMAEEndianSwapMode : uint32_t
+{
+   None = 0,
+   Swap8In16 = 1,
+   Swap8In32 = 2
+};
+
+coreinit::OSTime
+DMAEGetRetiredTimeStamp();
+
+coreinit::OSTime
+DMAEGetLastSubmittedTimeStamp();
+
+BOOL
+DMAEWaitDone(coreinit::OSTime timestamp);
+
+coreinit::OSTime
+DMAECopyMem(void *dst,
+            void *src,
+            uint32_t numDwords,
+            DMAEEndianSwapMode endian);
+
+coreinit::OSTime
+DMAEFillMem(void *dst,
+            uint32_t value,
+            uint32_t numDwords);
+
+void
+DMAESetTimeout(uint32_t timeout);
+
+uint32_t
+DMAEGetTimeout();
+
+namespace internal
+{
+
+void
+handleDmaeInterrupt();
+
+void
+stopDmaeThread();
+
+} // namespace internal
+
+} // namespace dmae
@@ -146,7 +146,9 @@ copySurface(GX2Surface *surfaceSrc,
             uint32_t dstLevel,
             uint32_t dstSlice,
             uint8_t *dstImage,
-            uint8_t *dstMipmap)
+            uint8_t *dstMipmap,
+            uint32_t firstRow,
+            uint32_t numRows)
 {
    ADDR_COMPUTE_SURFACE_INFO_OUTPUT srcInfoOutput;
    ADDR_COMPUTE_SURFACE_INFO_OUTPUT dstInfoOutput;
@@ -202,8 +204,8 @@ copySurface(GX2Surface *surfaceSrc,
    srcAddrInput.pipeSwizzle = srcSwizzleOutput.pipeSwizzle;
 
    // Setup dst
-   getSurfaceInfo(surfaceDst, srcLevel, &dstInfoOutput);
-   dstAddrInput.slice = srcSlice;
+   getSurfaceInfo(surfaceDst, dstLevel, &dstInfoOutput);
+   dstAddrInput.slice = dstSlice;
    dstAddrInput.sample = 0;
    dstAddrInput.bpp = bpp;
    dstAddrInput.pitch = dstInfoOutput.pitch;
@@ -279,7 +281,8 @@ copySurface(GX2Surface *surfaceSrc,
 
    return gpu::copySurfacePixels(
       dstBasePtr, dstWidth, dstHeight, dstAddrInput,
-      srcBasePtr, srcWidth, srcHeight, srcAddrInput);
+      srcBasePtr, srcWidth, srcHeight, srcAddrInput,
+      firstRow, numRows);
 }
 
 uint32_t
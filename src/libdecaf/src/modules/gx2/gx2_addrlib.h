@@ -26,7 +26,9 @@ copySurface(GX2Surface *surfaceSrc,
             uint32_t dstLevel,
             uint32_t dstSlice,
             uint8_t *dstImage = nullptr,
-            uint8_t *dstMipmap = nullptr);
+            uint8_t *dstMipmap = nullptr,
+            uint32_t firstRow = 0,
+            uint32_t numRows = UINT32_MAX);
 
 uint32_t
 getSurfaceSliceSwizzle(GX2TileMode tileMode,
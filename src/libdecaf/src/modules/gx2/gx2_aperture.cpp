@@ -1,10 +1,18 @@
 #include "gx2_addrlib.h"
 #include "gx2_aperture.h"
+#include "gx2_format.h"
 #include "gx2_surface.h"
+#include "libcpu/cpu.h"
 #include "libcpu/mem.h"
+#include <algorithm>
+#include <array>
+#include <common/align.h>
 #include <common/decaf_assert.h>
-#include <common/teenyheap.h>
+#include <common/log.h>
+#include <common/platform_memory.h>
+#include <common/tlsfheap.h>
 #include <mutex>
+#include <vector>
 
 namespace gx2
 {
@@ -12,14 +20,33 @@ namespace gx2
 class ApertureManager
 {
    static const auto MaxApertures = 32u;
+   static const auto PageSize = 0x1000u;
+
+   enum class PageState : uint8_t
+   {
+      //! Some of the rows in the page have not been untiled yet
+      Protected,
+
+      //! Untiled and mapped read only
+      Clean,
+
+      //! Written by the CPU, must be retiled when the aperture is freed
+      Dirty,
+   };
 
    struct ActiveAperture
    {
       GX2Surface *surface;
+      GX2Surface linearSurface;
       uint32_t level;
       uint32_t slice;
       uint8_t *address;
       uint32_t size;
+      uint32_t linearSize;
+      uint32_t rowBytes;
+      uint32_t bandRows;
+      std::vector<bool> bandUntiled;
+      std::vector<PageState> pages;
    };
 
 public:
@@ -57,26 +84,59 @@ public:
          initialise();
       }
 
-      // Allocate data
-      ADDR_COMPUTE_SURFACE_INFO_OUTPUT output;
-      gx2::internal::getSurfaceInfo(surface, level, &output);
-
+      // The aperture holds a single linear slice of the requested level, the
+      //  mip offsets are cleared so every level starts at the aperture base.
       auto &aperture = mActiveApertures[id];
-      aperture.address = reinterpret_cast<uint8_t *>(mHeap->alloc(output.sliceSize));
-      aperture.size = output.sliceSize;
+      aperture.linearSurface = GX2Surface { *surface };
+      aperture.linearSurface.depth = 1;
+      aperture.linearSurface.mipmaps = nullptr;
+      aperture.linearSurface.image = nullptr;
+      aperture.linearSurface.tileMode = GX2TileMode::LinearSpecial;
+      aperture.linearSurface.swizzle &= 0xFFFF00FF;
+      GX2CalcSurfaceSizeAndAlignment(&aperture.linearSurface);
+
+      for (auto i = 0u; i < aperture.linearSurface.mipLevelOffset.size(); ++i) {
+         aperture.linearSurface.mipLevelOffset[i] = 0u;
+      }
+
+      ADDR_COMPUTE_SURFACE_INFO_OUTPUT tiledInfo;
+      ADDR_COMPUTE_SURFACE_INFO_OUTPUT linearInfo;
+      gx2::internal::getSurfaceInfo(surface, level, &tiledInfo);
+      gx2::internal::getSurfaceInfo(&aperture.linearSurface, level, &linearInfo);
+
+      auto bpp = GX2GetSurfaceFormatBitsPerElement(surface->format);
+      aperture.rowBytes = std::max(1u, linearInfo.pitch * bpp / 8);
+      aperture.linearSize = linearInfo.height * aperture.rowBytes;
+
+      // Rows are untiled in bands of whole tile rows which span at least a
+      //  page, so a single fault converts as little as possible.
+      auto tileRows = std::max(1u, tiledInfo.heightAlign);
+      auto pageRows = (PageSize + aperture.rowBytes - 1) / aperture.rowBytes;
+      aperture.bandRows = align_up(std::max(tileRows, pageRows), tileRows);
+
+      auto bandBytes = aperture.bandRows * aperture.rowBytes;
+      auto numBands = (aperture.linearSize + bandBytes - 1) / bandBytes;
+      auto size = std::max<uint32_t>(aperture.linearSize, tiledInfo.sliceSize);
+      size = align_up(size, PageSize);
+
+      aperture.address = reinterpret_cast<uint8_t *>(mHeap->alloc(size, PageSize));
+      if (!aperture.address) {
+         gLog->warn("Failed to allocate 0x{:X} bytes for tiling aperture", size);
+         return 0;
+      }
+
+      aperture.size = size;
       aperture.surface = surface;
       aperture.level = level;
       aperture.slice = slice;
+      aperture.bandUntiled.assign(numBands, false);
+      aperture.pages.assign(size / PageSize, PageState::Protected);
 
-      // Untile existing to memory
-      auto apertureSurface = GX2Surface { *surface };
-      apertureSurface.mipmaps = nullptr;
-      apertureSurface.image = nullptr;
-      apertureSurface.tileMode = GX2TileMode::LinearSpecial;
-      apertureSurface.swizzle &= 0xFFFF00FF;
-      GX2CalcSurfaceSizeAndAlignment(&apertureSurface);
+      // Nothing is untiled until the CPU first touches a page
+      protect(aperture.address, size, platform::ProtectFlags::NoAccess);
 
-      gx2::internal::copySurface(surface, level, slice, &apertureSurface, level, slice, aperture.address, aperture.address);
+      mStats.allocations++;
+      mStats.bytesMapped += aperture.linearSize;
       return id + 1;
    }
 
@@ -97,21 +157,46 @@ public:
       decaf_check(id >= 1 && id <= mActiveApertures.size());
       auto &aperture = mActiveApertures[id - 1];
 
-      // Retile to original memory
-      auto apertureSurface = GX2Surface { *aperture.surface };
-      apertureSurface.mipmaps = aperture.address;
-      apertureSurface.image = aperture.address;
-      apertureSurface.tileMode = GX2TileMode::LinearSpecial;
-      apertureSurface.swizzle &= 0xFFFF00FF;
-      GX2CalcSurfaceSizeAndAlignment(&apertureSurface);
+      if (!aperture.address) {
+         return;
+      }
+
+      // Retile only the bands which contain a page written by the CPU, the
+      //  rest of the tiled surface is still up to date.
+      protect(aperture.address, aperture.size, platform::ProtectFlags::ReadWrite);
+      aperture.linearSurface.image = aperture.address;
+      aperture.linearSurface.mipmaps = aperture.address;
+
+      auto bandBytes = aperture.bandRows * aperture.rowBytes;
+
+      for (auto band = 0u; band < aperture.bandUntiled.size(); ++band) {
+         auto start = band * bandBytes;
+         auto end = std::min(start + bandBytes, aperture.linearSize);
+         auto dirty = false;
+
+         for (auto page = start / PageSize; page <= (end - 1) / PageSize; ++page) {
+            if (aperture.pages[page] == PageState::Dirty) {
+               dirty = true;
+               break;
+            }
+         }
+
+         if (!dirty) {
+            continue;
+         }
 
-      auto level = aperture.level;
-      auto slice = aperture.slice;
-      gx2::internal::copySurface(&apertureSurface, level, slice, aperture.surface, level, slice, aperture.surface->image, aperture.surface->mipmaps);
+         gx2::internal::copySurface(&aperture.linearSurface, aperture.level, 0,
+                                    aperture.surface, aperture.level, aperture.slice,
+                                    aperture.surface->image, aperture.surface->mipmaps,
+                                    band * aperture.bandRows, aperture.bandRows);
+         mStats.bytesConverted += end - start;
+      }
 
       mHeap->free(aperture.address);
       aperture.address = nullptr;
       aperture.size = 0;
+      aperture.bandUntiled.clear();
+      aperture.pages.clear();
    }
 
    bool
@@ -121,7 +206,88 @@ public:
                   uint32_t *physBase)
    {
       std::unique_lock<std::mutex> lock(mMutex);
+      auto aperture = findAperture(address);
+
+      if (!aperture) {
+         return false;
+      }
+
+      if (apertureBase) {
+         *apertureBase = mem::untranslate(aperture->address);
+      }
+
+      if (apertureSize) {
+         *apertureSize = aperture->size;
+      }
+
+      if (physBase) {
+         *physBase = aperture->surface->image.getAddress();
+      }
+
+      return true;
+   }
+
+   bool
+   handleAccessFault(uint32_t address)
+   {
+      if (address < mem::AperturesBase || address >= mem::AperturesEnd) {
+         return false;
+      }
+
+      std::unique_lock<std::mutex> lock(mMutex);
+      auto aperture = findAperture(address);
+
+      if (!aperture) {
+         return false;
+      }
+
+      auto page = (address - mem::untranslate(aperture->address)) / PageSize;
+      auto pageAddress = aperture->address + page * PageSize;
+
+      switch (aperture->pages[page]) {
+      case PageState::Protected:
+         untilePage(*aperture, page);
+         mStats.bytesTouched += PageSize;
+         break;
+      case PageState::Clean:
+         // Clean pages are readable so this is a write, or a read which
+         //  raced with another thread untiling the page, which is
+         //  harmless to treat as a write.
+         aperture->pages[page] = PageState::Dirty;
+         protect(pageAddress, PageSize, platform::ProtectFlags::ReadWrite);
+         break;
+      case PageState::Dirty:
+         // Another thread resolved this fault while we waited for the lock
+         break;
+      }
+
+      return true;
+   }
+
+   internal::ApertureStats
+   getStats()
+   {
+      std::unique_lock<std::mutex> lock(mMutex);
+      return mStats;
+   }
+
+private:
+   void initialise()
+   {
+      if (!mem::commit(mem::AperturesBase, mem::AperturesSize)) {
+         decaf_abort("Failed to commit aperture memory region");
+      }
+
+      mHeap = new TlsfHeap { mem::translate(mem::AperturesBase), mem::AperturesSize };
+      cpu::setAccessFaultHandler(&accessFaultHandler);
+   }
+
+   static bool
+   accessFaultHandler(uint32_t address);
 
+   ActiveAperture *
+   findAperture(uint32_t address)
+   {
       for (auto &aperture : mActiveApertures) {
          if (!aperture.address) {
             continue;
@@ -131,44 +297,117 @@ public:
          auto end = start + aperture.size;
 
          if (address >= start && address < end) {
-            if (apertureBase) {
-               *apertureBase = start;
-            }
+            return &aperture;
+         }
+      }
 
-            if (apertureSize) {
-               *apertureSize = aperture.size;
-            }
+      return nullptr;
+   }
 
-            if (physBase) {
-               *physBase = aperture.surface->image.getAddress();
-            }
+   void
+   protect(uint8_t *address,
+           uint32_t size,
+           platform::ProtectFlags flags)
+   {
+      platform::protectMemory(reinterpret_cast<size_t>(address), size, flags);
+   }
+
+   bool
+   isPageUntiled(ActiveAperture &aperture,
+                 uint32_t page)
+   {
+      auto bandBytes = aperture.bandRows * aperture.rowBytes;
+      auto start = page * PageSize;
+      auto end = std::min(start + PageSize, aperture.linearSize);
 
-            return true;
+      if (start >= end) {
+         // Padding past the end of the linear surface
+         return true;
+      }
+
+      for (auto band = start / bandBytes; band <= (end - 1) / bandBytes; ++band) {
+         if (!aperture.bandUntiled[band]) {
+            return false;
          }
       }
 
-      return false;
+      return true;
    }
 
-private:
-   void initialise()
+   // Untiles every band overlapping the page, the bands can span pages
+   //  which are still protected because of neighbouring bands so those are
+   //  only made accessible once everything in them has been untiled.  Games
+   //  use an aperture from a single thread, so nothing else touches the
+   //  pages while they are briefly writable.
+   void
+   untilePage(ActiveAperture &aperture,
+              uint32_t page)
    {
-      if (!mem::commit(mem::AperturesBase, mem::AperturesSize)) {
-         decaf_abort("Failed to commit aperture memory region");
+      auto bandBytes = aperture.bandRows * aperture.rowBytes;
+      auto start = page * PageSize;
+      auto end = std::min(start + PageSize, aperture.linearSize);
+      auto firstPage = page;
+      auto lastPage = page;
+
+      if (start < end) {
+         for (auto band = start / bandBytes; band <= (end - 1) / bandBytes; ++band) {
+            if (aperture.bandUntiled[band]) {
+               continue;
+            }
+
+            auto bandStart = band * bandBytes;
+            auto bandEnd = std::min(bandStart + bandBytes, aperture.linearSize);
+            auto bandFirstPage = bandStart / PageSize;
+            auto bandLastPage = (bandEnd - 1) / PageSize;
+            protect(aperture.address + bandFirstPage * PageSize,
+                    (bandLastPage - bandFirstPage + 1) * PageSize,
+                    platform::ProtectFlags::ReadWrite);
+
+            gx2::internal::copySurface(aperture.surface, aperture.level, aperture.slice,
+                                       &aperture.linearSurface, aperture.level, 0,
+                                       aperture.address, aperture.address,
+                                       band * aperture.bandRows, aperture.bandRows);
+
+            aperture.bandUntiled[band] = true;
+            mStats.bytesConverted += bandEnd - bandStart;
+            firstPage = std::min(firstPage, bandFirstPage);
+            lastPage = std::max(lastPage, bandLastPage);
+         }
       }
 
-      mHeap = new TeenyHeap { mem::translate(mem::AperturesBase), mem::AperturesSize };
+      for (auto i = firstPage; i <= lastPage; ++i) {
+         auto pageAddress = aperture.address + i * PageSize;
+
+         if (aperture.pages[i] == PageState::Dirty) {
+            continue;
+         }
+
+         if (isPageUntiled(aperture, i)) {
+            aperture.pages[i] = PageState::Clean;
+            protect(pageAddress, PageSize, platform::ProtectFlags::ReadOnly);
+         } else {
+            aperture.pages[i] = PageState::Protected;
+            protect(pageAddress, PageSize, platform::ProtectFlags::NoAccess);
+         }
+      }
    }
 
 private:
    std::mutex mMutex;
-   TeenyHeap *mHeap = nullptr;
+   TlsfHeap *mHeap = nullptr;
    std::array<ActiveAperture, MaxApertures> mActiveApertures;
+   internal::ApertureStats mStats;
 };
 
 static ApertureManager
 sApertureManager;
 
+bool
+ApertureManager::accessFaultHandler(uint32_t address)
+{
+   return sApertureManager.handleAccessFault(address);
+}
+
 void
 GX2AllocateTilingApertureEx(GX2Surface *surface,
                             uint32_t level,
@@ -214,6 +453,12 @@ lookupAperture(uint32_t address,
                                           physBase);
 }
 
+ApertureStats
+getApertureStats()
+{
+   return sApertureManager.getStats();
+}
+
 } // namespace internal
 
 } // namespace gx2
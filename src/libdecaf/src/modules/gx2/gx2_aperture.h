@@ -26,12 +26,30 @@ GX2FreeTilingAperture(GX2ApertureHandle handle);
 namespace internal
 {
 
+struct ApertureStats
+{
+   //! Number of apertures allocated
+   uint64_t allocations = 0;
+
+   //! Bytes of linear surface mapped by all apertures
+   uint64_t bytesMapped = 0;
+
+   //! Bytes of aperture pages the CPU actually accessed
+   uint64_t bytesTouched = 0;
+
+   //! Bytes untiled into or retiled out of apertures
+   uint64_t bytesConverted = 0;
+};
+
 bool
 lookupAperture(uint32_t address,
                uint32_t *apertureBase_ret,  // may be null
                uint32_t *apertureSize_ret,  // may be null
                uint32_t *physBase_ret);     // may be null
 
+ApertureStats
+getApertureStats();
+
 } // namespace internal
 
 } // namespace gx2
@@ -0,0 +1,104 @@
+#ifndef NSYSNET_ENUM_H
+#define NSYSNET_ENUM_H
+
+#include <common/enum_start.h>
+
+ENUM_NAMESPACE_BEG(nsysnet)
+
+ENUM_BEG(SocketError, int32_t)
+   ENUM_VALUE(OK,                0)
+   ENUM_VALUE(NoBufs,            1)
+   ENUM_VALUE(TimedOut,          2)
+   ENUM_VALUE(IsConn,            3)
+   ENUM_VALUE(OpNotSupp,         4)
+   ENUM_VALUE(ConnAborted,       5)
+   ENUM_VALUE(WouldBlock,        6)
+   ENUM_VALUE(ConnRefused,       7)
+   ENUM_VALUE(ConnReset,         8)
+   ENUM_VALUE(NotConn,           9)
+   ENUM_VALUE(Already,           10)
+   ENUM_VALUE(Inval,             11)
+   ENUM_VALUE(MsgSize,           12)
+   ENUM_VALUE(Pipe,              13)
+   ENUM_VALUE(DestAddrReq,       14)
+   ENUM_VALUE(Shutdown,          15)
+   ENUM_VALUE(NoProtoOpt,        16)
+   ENUM_VALUE(NoMem,             18)
+   ENUM_VALUE(AddrNotAvail,      19)
+   ENUM_VALUE(AddrInUse,         20)
+   ENUM_VALUE(AfNoSupport,       21)
+   ENUM_VALUE(InProgress,        22)
+   ENUM_VALUE(NotSock,           24)
+   ENUM_VALUE(Fault,             29)
+   ENUM_VALUE(NetUnreach,        30)
+   ENUM_VALUE(ProtoNoSupport,    31)
+   ENUM_VALUE(ProtoType,         32)
+   ENUM_VALUE(Unknown,           45)
+   ENUM_VALUE(BadFd,             49)
+   ENUM_VALUE(MFile,             51)
+ENUM_END(SocketError)
+
+ENUM_BEG(SocketFamily, int32_t)
+   ENUM_VALUE(Unspecified,       0)
+   ENUM_VALUE(Inet,              2)
+   ENUM_VALUE(Inet6,             23)
+ENUM_END(SocketFamily)
+
+ENUM_BEG(SocketType, int32_t)
+   ENUM_VALUE(Stream,            1)
+   ENUM_VALUE(Datagram,          2)
+ENUM_END(SocketType)
+
+ENUM_BEG(SocketProtocol, int32_t)
+   ENUM_VALUE(IP,                0)
+   ENUM_VALUE(TCP,               6)
+   ENUM_VALUE(UDP,               17)
+ENUM_END(SocketProtocol)
+
+ENUM_BEG(SocketLevel, int32_t)
+   ENUM_VALUE(Socket,            -1)
+   ENUM_VALUE(TCP,               6)
+ENUM_END(SocketLevel)
+
+ENUM_BEG(SocketOption, int32_t)
+   ENUM_VALUE(ReuseAddr,         0x0004)
+   ENUM_VALUE(KeepAlive,         0x0008)
+   ENUM_VALUE(Broadcast,         0x0020)
+   ENUM_VALUE(Linger,            0x0080)
+   ENUM_VALUE(OobInline,         0x0100)
+   ENUM_VALUE(SendBuffer,        0x1001)
+   ENUM_VALUE(RecvBuffer,        0x1002)
+   ENUM_VALUE(Type,              0x1008)
+   ENUM_VALUE(Error,             0x1009)
+   ENUM_VALUE(NonBlockingIO,     0x1014)
+   ENUM_VALUE(BlockingIO,        0x1015)
+   ENUM_VALUE(NonBlock,          0x1016)
+   ENUM_VALUE(TcpNoDelay,        0x2004)
+ENUM_END(SocketOption)
+
+ENUM_BEG(SocketMsgFlags, int32_t)
+   ENUM_VALUE(OutOfBand,         0x0001)
+   ENUM_VALUE(Peek,              0x0002)
+   ENUM_VALUE(DontWait,          0x0020)
+ENUM_END(SocketMsgFlags)
+
+ENUM_BEG(SocketShutdown, int32_t)
+   ENUM_VALUE(Read,              0)
+   ENUM_VALUE(Write,             1)
+   ENUM_VALUE(ReadWrite,         2)
+ENUM_END(SocketShutdown)
+
+ENUM_BEG(SocketPollEvents, int16_t)
+   ENUM_VALUE(In,                0x01)
+   ENUM_VALUE(Pri,               0x02)
+   ENUM_VALUE(Out,               0x04)
+   ENUM_VALUE(Err,               0x08)
+   ENUM_VALUE(Hup,               0x10)
+   ENUM_VALUE(Nval,              0x20)
+ENUM_END(SocketPollEvents)
+
+ENUM_NAMESPACE_END(nsysnet)
+
+#include <common/enum_end.h>
+
+#endif // ifdef NSYSNET_ENUM_H
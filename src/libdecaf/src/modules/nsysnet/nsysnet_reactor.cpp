@@ -0,0 +1,459 @@
+#include "nsysnet_reactor.h"
+#include "modules/coreinit/coreinit_memheap.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+#include "modules/coreinit/coreinit_thread.h"
+
+#include <common/platform.h>
+
+#ifdef PLATFORM_LINUX
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <common/log.h>
+#include <common/platform_thread.h>
+#include <cstring>
+#include <libcpu/cpu.h>
+#include <mutex>
+#include <set>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace nsysnet
+{
+
+namespace internal
+{
+
+//! Protects sFreeQueues, it is separate from sReactorMutex so a socket can
+//  be destroyed wherever its last reference is dropped.
+static std::mutex
+sFreeQueueMutex;
+
+//! Thread queues released by closed sockets, freed sockets can be destroyed
+//  on the reactor thread where we can not free guest memory.
+static std::vector<coreinit::OSThreadQueue *>
+sFreeQueues;
+
+//! epoll_event.data for the eventfd used to wake the reactor
+static const uint64_t
+ReactorWakeId = 0;
+
+static std::thread
+sReactorThread;
+
+static int
+sEpollFd = -1;
+
+static int
+sWakeFd = -1;
+
+//! Protects everything below
+static std::mutex
+sReactorMutex;
+
+static bool
+sReactorRunning = false;
+
+static uint64_t
+sNextSocketId = ReactorWakeId + 1;
+
+static std::unordered_map<uint64_t, std::weak_ptr<ReactorSocket>>
+sSockets;
+
+//! Sockets with activity whose waiters the network interrupt should wake
+static std::vector<std::shared_ptr<ReactorSocket>>
+sPendingWakes;
+
+static bool
+sPollWakePending = false;
+
+//! Deadlines of guest threads in poll or select
+static std::multiset<ReactorClock::time_point>
+sPollDeadlines;
+
+static coreinit::OSThreadQueue *
+sPollQueue = nullptr;
+
+static std::atomic<uint32_t>
+sPollSequence { 0 };
+
+//! Number of guest threads sleeping in the reactor on each core, these
+//  cores are sent the network interrupt while there is something to wake.
+//  A count only drops once its waiter has been woken, so activity on one
+//  socket can not hide the waiters of another.
+static std::array<std::atomic<uint32_t>, 3>
+sCoreWaiters { };
+
+ReactorSocket::~ReactorSocket()
+{
+   if (fd != -1) {
+      ::close(fd);
+   }
+
+   if (queue) {
+      std::unique_lock<std::mutex> lock { sFreeQueueMutex };
+      sFreeQueues.push_back(queue);
+   }
+}
+
+static void
+wakeReactor()
+{
+   auto value = uint64_t { 1 };
+
+   if (::write(sWakeFd, &value, sizeof(value)) < 0) {
+      gLog->error("Failed to wake socket reactor, error {}", errno);
+   }
+}
+
+/**
+ * Send the network interrupt to every core with a waiting thread.
+ *
+ * Must be called with sReactorMutex held, which it releases.
+ */
+static void
+sendNetworkInterrupt(std::unique_lock<std::mutex> &lock)
+{
+   lock.unlock();
+
+   for (auto core = 0u; core < sCoreWaiters.size(); ++core) {
+      if (sCoreWaiters[core].load() != 0) {
+         cpu::interrupt(core, cpu::NETWORK_INTERRUPT);
+      }
+   }
+}
+
+/**
+ * Sleep the current guest thread on queue until sequence differs from
+ * expected.
+ *
+ * Our core's waiter count is raised before we check the sequence, so the
+ * reactor either sees us waiting or we see its new sequence.  We may be
+ * resumed on another core, so the count is moved on every wake.
+ */
+static void
+waitForSequence(coreinit::OSThreadQueue *queue,
+                const std::atomic<uint32_t> &sequence,
+                uint32_t expected)
+{
+   coreinit::internal::lockScheduler();
+
+   while (true) {
+      auto core = cpu::this_core::id();
+      sCoreWaiters[core]++;
+
+      if (sequence.load() != expected) {
+         sCoreWaiters[core]--;
+         break;
+      }
+
+      coreinit::internal::sleepThreadNoLock(queue);
+      coreinit::internal::rescheduleSelfNoLock();
+      sCoreWaiters[core]--;
+   }
+
+   coreinit::internal::unlockScheduler();
+}
+
+static void
+queueSocketWake(const std::shared_ptr<ReactorSocket> &socket)
+{
+   socket->sequence++;
+
+   if (!socket->wakePending) {
+      socket->wakePending = true;
+      sPendingWakes.push_back(socket);
+   }
+}
+
+static void
+reactorThreadEntry()
+{
+   auto events = std::array<epoll_event, 64> { };
+
+   while (true) {
+      auto timeout = -1;
+
+      {
+         std::unique_lock<std::mutex> lock { sReactorMutex };
+
+         if (!sReactorRunning) {
+            break;
+         }
+
+         if (!sPollDeadlines.empty()) {
+            auto remaining = *sPollDeadlines.begin() - ReactorClock::now();
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count() + 1;
+            timeout = static_cast<int>(std::max<int64_t>(ms, 0));
+         }
+      }
+
+      auto count = epoll_wait(sEpollFd, events.data(), static_cast<int>(events.size()), timeout);
+
+      if (count < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+
+         gLog->error("Socket reactor epoll_wait failed with error {}", errno);
+         break;
+      }
+
+      std::unique_lock<std::mutex> lock { sReactorMutex };
+      auto wakePoll = false;
+
+      for (auto i = 0; i < count; ++i) {
+         auto id = events[i].data.u64;
+
+         if (id == ReactorWakeId) {
+            auto value = uint64_t { 0 };
+            ::read(sWakeFd, &value, sizeof(value));
+            continue;
+         }
+
+         auto itr = sSockets.find(id);
+
+         if (itr == sSockets.end()) {
+            continue;
+         }
+
+         if (auto socket = itr->second.lock()) {
+            queueSocketWake(socket);
+            wakePoll = true;
+         }
+      }
+
+      // Expired deadlines are removed here so they only fire once, the
+      //  waiter removes its own deadline if it is woken for another reason.
+      auto now = ReactorClock::now();
+
+      while (!sPollDeadlines.empty() && *sPollDeadlines.begin() <= now) {
+         sPollDeadlines.erase(sPollDeadlines.begin());
+         wakePoll = true;
+      }
+
+      if (wakePoll) {
+         sPollSequence++;
+         sPollWakePending = true;
+      }
+
+      if (!sPendingWakes.empty() || sPollWakePending) {
+         sendNetworkInterrupt(lock);
+      }
+   }
+}
+
+static bool
+startReactorNoLock()
+{
+   if (sReactorRunning) {
+      return true;
+   }
+
+   sEpollFd = epoll_create1(EPOLL_CLOEXEC);
+   sWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+   if (sEpollFd == -1 || sWakeFd == -1) {
+      gLog->error("Failed to create socket reactor, error {}", errno);
+      return false;
+   }
+
+   auto event = epoll_event { };
+   event.events = EPOLLIN;
+   event.data.u64 = ReactorWakeId;
+   epoll_ctl(sEpollFd, EPOLL_CTL_ADD, sWakeFd, &event);
+
+   sPollQueue = coreinit::internal::sysAlloc<coreinit::OSThreadQueue>();
+   coreinit::OSInitThreadQueue(sPollQueue);
+
+   sReactorRunning = true;
+   sReactorThread = std::thread { reactorThreadEntry };
+   platform::setThreadName(&sReactorThread, "Socket Reactor");
+   return true;
+}
+
+std::shared_ptr<ReactorSocket>
+createReactorSocket(int fd)
+{
+   std::unique_lock<std::mutex> lock { sReactorMutex };
+
+   if (!startReactorNoLock()) {
+      return nullptr;
+   }
+
+   auto socket = std::make_shared<ReactorSocket>();
+   socket->fd = fd;
+   socket->id = sNextSocketId++;
+
+   {
+      std::unique_lock<std::mutex> queueLock { sFreeQueueMutex };
+
+      if (!sFreeQueues.empty()) {
+         socket->queue = sFreeQueues.back();
+         sFreeQueues.pop_back();
+      }
+   }
+
+   if (!socket->queue) {
+      socket->queue = coreinit::internal::sysAlloc<coreinit::OSThreadQueue>();
+   }
+
+   coreinit::OSInitThreadQueue(socket->queue);
+
+   // Edge triggered, waiters always retry their call before sleeping so
+   //  they can not miss a change in readiness.
+   auto event = epoll_event { };
+   event.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP | EPOLLET;
+   event.data.u64 = socket->id;
+
+   if (epoll_ctl(sEpollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      gLog->error("Failed to add socket to reactor, error {}", errno);
+
+      // Leave closing the fd to the caller, the destructor returns the queue
+      socket->fd = -1;
+      return nullptr;
+   }
+
+   sSockets.emplace(socket->id, socket);
+   return socket;
+}
+
+void
+closeReactorSocket(const std::shared_ptr<ReactorSocket> &socket)
+{
+   std::unique_lock<std::mutex> lock { sReactorMutex };
+   socket->closed = true;
+   epoll_ctl(sEpollFd, EPOLL_CTL_DEL, socket->fd, nullptr);
+   sSockets.erase(socket->id);
+
+   // Release anyone still waiting on the socket
+   queueSocketWake(socket);
+   sPollSequence++;
+   sPollWakePending = true;
+   sendNetworkInterrupt(lock);
+}
+
+void
+waitForSocket(const std::shared_ptr<ReactorSocket> &socket,
+              uint32_t sequence)
+{
+   waitForSequence(socket->queue, socket->sequence, sequence);
+}
+
+uint32_t
+getPollSequence()
+{
+   return sPollSequence.load();
+}
+
+void
+waitForPoll(uint32_t sequence,
+            const ReactorClock::time_point *deadline)
+{
+   if (deadline) {
+      std::unique_lock<std::mutex> lock { sReactorMutex };
+      auto earliest = sPollDeadlines.empty() || *deadline < *sPollDeadlines.begin();
+      sPollDeadlines.insert(*deadline);
+
+      if (earliest) {
+         wakeReactor();
+      }
+   }
+
+   waitForSequence(sPollQueue, sPollSequence, sequence);
+
+   if (deadline) {
+      // The reactor erases deadlines once they have passed
+      std::unique_lock<std::mutex> lock { sReactorMutex };
+      auto range = sPollDeadlines.equal_range(*deadline);
+
+      if (range.first != range.second) {
+         sPollDeadlines.erase(range.first);
+      }
+   }
+}
+
+/**
+ * Called from the network interrupt handler to wake any guest threads
+ * waiting for activity the reactor has seen.
+ */
+void
+handleNetworkInterrupt()
+{
+   std::unique_lock<std::mutex> lock { sReactorMutex };
+   auto pending = std::move(sPendingWakes);
+   auto wakePoll = sPollWakePending;
+   sPendingWakes.clear();
+   sPollWakePending = false;
+
+   for (auto &socket : pending) {
+      socket->wakePending = false;
+   }
+
+   lock.unlock();
+
+   for (auto &socket : pending) {
+      coreinit::OSWakeupThread(socket->queue);
+   }
+
+   if (wakePoll) {
+      coreinit::OSWakeupThread(sPollQueue);
+   }
+}
+
+void
+stopReactor()
+{
+   std::unique_lock<std::mutex> lock { sReactorMutex };
+
+   if (!sReactorRunning) {
+      return;
+   }
+
+   sReactorRunning = false;
+   wakeReactor();
+   lock.unlock();
+
+   sReactorThread.join();
+
+   lock.lock();
+   auto pending = std::move(sPendingWakes);
+   sPendingWakes.clear();
+   ::close(sWakeFd);
+   ::close(sEpollFd);
+   sWakeFd = -1;
+   sEpollFd = -1;
+   lock.unlock();
+}
+
+} // namespace internal
+
+} // namespace nsysnet
+
+#else
+
+namespace nsysnet
+{
+
+namespace internal
+{
+
+void
+handleNetworkInterrupt()
+{
+}
+
+void
+stopReactor()
+{
+}
+
+} // namespace internal
+
+} // namespace nsysnet
+
+#endif // ifdef PLATFORM_LINUX
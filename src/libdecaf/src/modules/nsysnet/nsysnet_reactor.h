@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace coreinit
+{
+struct OSThreadQueue;
+}
+
+namespace nsysnet
+{
+
+namespace internal
+{
+
+using ReactorClock = std::chrono::steady_clock;
+
+/**
+ * Host side state for a guest socket which is watched by the reactor.
+ *
+ * Host sockets are always non-blocking, a guest thread which would block
+ * records sequence, retries its call and if that would still block sleeps
+ * on queue until the reactor has seen activity on the socket.
+ */
+struct ReactorSocket
+{
+   ~ReactorSocket();
+
+   //! Host file descriptor
+   int fd = -1;
+
+   //! Id used to find the socket from an epoll event
+   uint64_t id = 0;
+
+   //! Incremented each time the reactor sees activity on the socket
+   std::atomic<uint32_t> sequence { 0 };
+
+   //! Set once the guest has closed the socket, to release any waiters
+   std::atomic<bool> closed { false };
+
+   //! Guest threads waiting for activity on this socket
+   coreinit::OSThreadQueue *queue = nullptr;
+
+   //! Whether the socket is in the list waiting for the network interrupt,
+   //  protected by the reactor mutex
+   bool wakePending = false;
+};
+
+std::shared_ptr<ReactorSocket>
+createReactorSocket(int fd);
+
+void
+closeReactorSocket(const std::shared_ptr<ReactorSocket> &socket);
+
+//! Sleep the current guest thread until the reactor has seen activity on
+//  socket since sequence was read.
+void
+waitForSocket(const std::shared_ptr<ReactorSocket> &socket,
+              uint32_t sequence);
+
+//! Incremented on activity on any socket and when a poll deadline passes
+uint32_t
+getPollSequence();
+
+//! Sleep the current guest thread until the poll sequence changes, which
+//  happens at the latest when deadline passes if one is given.
+void
+waitForPoll(uint32_t sequence,
+            const ReactorClock::time_point *deadline);
+
+void
+handleNetworkInterrupt();
+
+void
+stopReactor();
+
+} // namespace internal
+
+} // namespace nsysnet
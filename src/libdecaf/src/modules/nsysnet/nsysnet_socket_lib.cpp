@@ -1,5 +1,29 @@
 #include "nsysnet.h"
+#include "nsysnet_reactor.h"
 #include "nsysnet_socket_lib.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+#include "modules/coreinit/coreinit_thread.h"
+
+#include <common/platform.h>
+
+#ifdef PLATFORM_LINUX
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <common/log.h>
+#include <cstring>
+#include <libcpu/mem.h>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#endif
 
 namespace nsysnet
 {
@@ -7,24 +31,1086 @@ namespace nsysnet
 int
 socket_lib_init()
 {
-   decaf_warn_stub();
-
    return 0;
 }
 
 int
 socket_lib_finish()
 {
-   decaf_warn_stub();
+   return 0;
+}
+
+#ifdef PLATFORM_LINUX
+
+//! Sockets at or above SocketFdSetSize can only be waited on with poll
+static const int32_t
+MaxSockets = 128;
+
+struct Socket
+{
+   std::shared_ptr<internal::ReactorSocket> reactor;
+   SocketType type;
+
+   //! Whether the guest has made the socket non-blocking, the host socket
+   //  is always non-blocking and blocking is done through the reactor.
+   bool nonBlocking = false;
+};
+
+//! Protects everything below
+static std::mutex
+sSocketMutex;
+
+static std::array<std::shared_ptr<Socket>, MaxSockets>
+sSockets;
+
+//! Last error for socketlasterr, by guest thread address
+static std::unordered_map<uint32_t, SocketError>
+sLastErrors;
+
+//! Size of sLastErrors past which errors of exited threads are dropped
+static const size_t
+MaxLastErrors = 64;
+
+static void
+setLastError(SocketError error)
+{
+   auto thread = mem::untranslate(coreinit::internal::getCurrentThread());
+   std::unique_lock<std::mutex> lock { sSocketMutex };
+
+   // Only failures are kept, no entry reads back as OK
+   if (error == SocketError::OK) {
+      sLastErrors.erase(thread);
+      return;
+   }
+
+   sLastErrors[thread] = error;
+
+   if (sLastErrors.size() > MaxLastErrors) {
+      coreinit::internal::lockScheduler();
+
+      for (auto itr = sLastErrors.begin(); itr != sLastErrors.end(); ) {
+         if (!coreinit::internal::isThreadActiveNoLock(mem::translate<coreinit::OSThread>(itr->first))) {
+            itr = sLastErrors.erase(itr);
+         } else {
+            ++itr;
+         }
+      }
+
+      coreinit::internal::unlockScheduler();
+   }
+}
+
+static SocketError
+translateError(int error)
+{
+   switch (error) {
+   case 0:
+      return SocketError::OK;
+   case ENOBUFS:
+      return SocketError::NoBufs;
+   case ETIMEDOUT:
+      return SocketError::TimedOut;
+   case EISCONN:
+      return SocketError::IsConn;
+   case EOPNOTSUPP:
+      return SocketError::OpNotSupp;
+   case ECONNABORTED:
+      return SocketError::ConnAborted;
+   case EAGAIN:
+      return SocketError::WouldBlock;
+   case ECONNREFUSED:
+      return SocketError::ConnRefused;
+   case ECONNRESET:
+      return SocketError::ConnReset;
+   case ENOTCONN:
+      return SocketError::NotConn;
+   case EALREADY:
+      return SocketError::Already;
+   case EINVAL:
+      return SocketError::Inval;
+   case EMSGSIZE:
+      return SocketError::MsgSize;
+   case EPIPE:
+      return SocketError::Pipe;
+   case EDESTADDRREQ:
+      return SocketError::DestAddrReq;
+   case ESHUTDOWN:
+      return SocketError::Shutdown;
+   case ENOPROTOOPT:
+      return SocketError::NoProtoOpt;
+   case ENOMEM:
+      return SocketError::NoMem;
+   case EADDRNOTAVAIL:
+      return SocketError::AddrNotAvail;
+   case EADDRINUSE:
+      return SocketError::AddrInUse;
+   case EAFNOSUPPORT:
+      return SocketError::AfNoSupport;
+   case EINPROGRESS:
+      return SocketError::InProgress;
+   case ENOTSOCK:
+      return SocketError::NotSock;
+   case EFAULT:
+      return SocketError::Fault;
+   case ENETUNREACH:
+   case EHOSTUNREACH:
+      return SocketError::NetUnreach;
+   case EPROTONOSUPPORT:
+      return SocketError::ProtoNoSupport;
+   case EPROTOTYPE:
+      return SocketError::ProtoType;
+   case EBADF:
+      return SocketError::BadFd;
+   case EMFILE:
+   case ENFILE:
+      return SocketError::MFile;
+   default:
+      return SocketError::Unknown;
+   }
+}
+
+static int32_t
+socketError(SocketError error)
+{
+   setLastError(error);
+   return -1;
+}
+
+static int32_t
+hostError(int error)
+{
+   return socketError(translateError(error));
+}
+
+static std::shared_ptr<Socket>
+getSocket(int32_t sockfd)
+{
+   if (sockfd < 0 || sockfd >= MaxSockets) {
+      return nullptr;
+   }
+
+   std::unique_lock<std::mutex> lock { sSocketMutex };
+   return sSockets[sockfd];
+}
+
+//! Add a host socket to the reactor and the guest socket table, closes fd
+//  on failure.
+static int32_t
+addSocket(int fd,
+          SocketType type)
+{
+   auto reactor = internal::createReactorSocket(fd);
+
+   if (!reactor) {
+      ::close(fd);
+      return socketError(SocketError::NoMem);
+   }
+
+   std::unique_lock<std::mutex> lock { sSocketMutex };
+
+   for (auto i = 0; i < MaxSockets; ++i) {
+      if (!sSockets[i]) {
+         auto socket = std::make_shared<Socket>();
+         socket->reactor = reactor;
+         socket->type = type;
+         sSockets[i] = socket;
+         return i;
+      }
+   }
+
+   lock.unlock();
+   internal::closeReactorSocket(reactor);
+   return socketError(SocketError::MFile);
+}
+
+static bool
+readAddress(const SocketAddr *addr,
+            int32_t addrlen,
+            sockaddr_in &out)
+{
+   if (!addr || addrlen < static_cast<int32_t>(sizeof(SocketAddrIn))) {
+      return false;
+   }
+
+   auto in = reinterpret_cast<const SocketAddrIn *>(addr);
+
+   if (in->family != SocketFamily::Inet) {
+      return false;
+   }
+
+   // Port and address are already in network byte order in guest memory
+   std::memset(&out, 0, sizeof(out));
+   out.sin_family = AF_INET;
+   std::memcpy(&out.sin_port, &in->port, sizeof(out.sin_port));
+   std::memcpy(&out.sin_addr, &in->addr, sizeof(out.sin_addr));
+   return true;
+}
+
+static void
+writeAddress(const sockaddr_in &in,
+             SocketAddr *addr,
+             be_val<int32_t> *addrlen)
+{
+   if (!addr || !addrlen || *addrlen < static_cast<int32_t>(sizeof(SocketAddrIn))) {
+      return;
+   }
+
+   auto out = reinterpret_cast<SocketAddrIn *>(addr);
+   std::memset(out, 0, sizeof(SocketAddrIn));
+   out->family = static_cast<uint16_t>(SocketFamily::Inet);
+   std::memcpy(&out->port, &in.sin_port, sizeof(in.sin_port));
+   std::memcpy(&out->addr, &in.sin_addr, sizeof(in.sin_addr));
+   *addrlen = static_cast<int32_t>(sizeof(SocketAddrIn));
+}
+
+static int
+translateMsgFlags(int32_t flags)
+{
+   // Never raise SIGPIPE in the emulator for a guest writing to a closed
+   //  connection, it gets EPIPE like it would on the console.
+   auto hostFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+
+   if (flags & SocketMsgFlags::OutOfBand) {
+      hostFlags |= MSG_OOB;
+   }
+
+   if (flags & SocketMsgFlags::Peek) {
+      hostFlags |= MSG_PEEK;
+   }
+
+   return hostFlags;
+}
+
+/**
+ * Retry call until it does not return EAGAIN, sleeping the guest thread
+ * until the reactor sees activity on the socket in between attempts.
+ */
+template<typename Function>
+static int32_t
+blockingCall(const std::shared_ptr<Socket> &socket,
+             bool dontWait,
+             Function call)
+{
+   auto reactor = socket->reactor;
+
+   while (true) {
+      auto sequence = reactor->sequence.load();
+
+      if (reactor->closed) {
+         return socketError(SocketError::BadFd);
+      }
+
+      auto result = call(reactor->fd);
+
+      if (result >= 0) {
+         return static_cast<int32_t>(result);
+      }
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+         return hostError(errno);
+      }
+
+      if (socket->nonBlocking || dontWait) {
+         return socketError(SocketError::WouldBlock);
+      }
+
+      internal::waitForSocket(reactor, sequence);
+   }
+}
+
+struct PollEntry
+{
+   std::shared_ptr<Socket> socket;
+   short events;
+   short revents;
+};
+
+/**
+ * Wait until one of the sockets is ready or deadline has passed, with no
+ * deadline waits forever. Returns the number of ready sockets.
+ */
+static int32_t
+pollSockets(std::vector<PollEntry> &entries,
+            const internal::ReactorClock::time_point *deadline)
+{
+   auto pollFds = std::vector<pollfd>(entries.size());
+
+   while (true) {
+      auto sequence = internal::getPollSequence();
+      auto ready = 0;
+
+      for (auto i = 0u; i < entries.size(); ++i) {
+         pollFds[i].fd = entries[i].socket ? entries[i].socket->reactor->fd : -1;
+         pollFds[i].events = entries[i].events;
+         pollFds[i].revents = 0;
+      }
+
+      if (::poll(pollFds.data(), pollFds.size(), 0) < 0) {
+         return hostError(errno);
+      }
+
+      for (auto i = 0u; i < entries.size(); ++i) {
+         auto &entry = entries[i];
+         entry.revents = pollFds[i].revents;
+
+         if (!entry.socket || entry.socket->reactor->closed) {
+            entry.revents = POLLNVAL;
+         }
+
+         if (entry.revents) {
+            ++ready;
+         }
+      }
+
+      if (ready || (deadline && internal::ReactorClock::now() >= *deadline)) {
+         return ready;
+      }
+
+      internal::waitForPoll(sequence, deadline);
+   }
+}
+
+int32_t
+socket(int32_t family,
+       int32_t type,
+       int32_t protocol)
+{
+   auto hostType = 0;
+   auto hostProtocol = 0;
+
+   if (family != SocketFamily::Inet) {
+      return socketError(SocketError::AfNoSupport);
+   }
+
+   switch (type) {
+   case SocketType::Stream:
+      hostType = SOCK_STREAM;
+      break;
+   case SocketType::Datagram:
+      hostType = SOCK_DGRAM;
+      break;
+   default:
+      return socketError(SocketError::ProtoType);
+   }
+
+   switch (protocol) {
+   case SocketProtocol::IP:
+      hostProtocol = 0;
+      break;
+   case SocketProtocol::TCP:
+      hostProtocol = IPPROTO_TCP;
+      break;
+   case SocketProtocol::UDP:
+      hostProtocol = IPPROTO_UDP;
+      break;
+   default:
+      return socketError(SocketError::ProtoNoSupport);
+   }
+
+   auto fd = ::socket(AF_INET, hostType | SOCK_NONBLOCK | SOCK_CLOEXEC, hostProtocol);
 
+   if (fd < 0) {
+      return hostError(errno);
+   }
+
+   return addSocket(fd, static_cast<SocketType>(type));
+}
+
+int32_t
+socketclose(int32_t sockfd)
+{
+   auto socket = std::shared_ptr<Socket> { };
+
+   if (sockfd >= 0 && sockfd < MaxSockets) {
+      std::unique_lock<std::mutex> lock { sSocketMutex };
+      socket = std::move(sSockets[sockfd]);
+      sSockets[sockfd] = nullptr;
+   }
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   // The host socket is closed once the last waiter has let go of it
+   internal::closeReactorSocket(socket->reactor);
    return 0;
 }
 
+int32_t
+bind(int32_t sockfd,
+     SocketAddr *addr,
+     int32_t addrlen)
+{
+   auto socket = getSocket(sockfd);
+   auto hostAddr = sockaddr_in { };
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   if (!readAddress(addr, addrlen, hostAddr)) {
+      return socketError(SocketError::Inval);
+   }
+
+   if (::bind(socket->reactor->fd, reinterpret_cast<sockaddr *>(&hostAddr), sizeof(hostAddr)) != 0) {
+      return hostError(errno);
+   }
+
+   return 0;
+}
+
+int32_t
+connect(int32_t sockfd,
+        SocketAddr *addr,
+        int32_t addrlen)
+{
+   auto socket = getSocket(sockfd);
+   auto hostAddr = sockaddr_in { };
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   if (!readAddress(addr, addrlen, hostAddr)) {
+      return socketError(SocketError::Inval);
+   }
+
+   auto reactor = socket->reactor;
+
+   if (::connect(reactor->fd, reinterpret_cast<sockaddr *>(&hostAddr), sizeof(hostAddr)) == 0) {
+      return 0;
+   }
+
+   if (errno != EINPROGRESS) {
+      return hostError(errno);
+   }
+
+   if (socket->nonBlocking) {
+      return socketError(SocketError::InProgress);
+   }
+
+   // The connection has completed or failed once the socket is writable
+   while (true) {
+      auto sequence = reactor->sequence.load();
+      auto pollFd = pollfd { reactor->fd, POLLOUT, 0 };
+
+      if (reactor->closed) {
+         return socketError(SocketError::BadFd);
+      }
+
+      if (::poll(&pollFd, 1, 0) > 0) {
+         break;
+      }
+
+      internal::waitForSocket(reactor, sequence);
+   }
+
+   auto error = 0;
+   auto length = static_cast<socklen_t>(sizeof(error));
+   ::getsockopt(reactor->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+   if (error) {
+      return hostError(error);
+   }
+
+   return 0;
+}
+
+int32_t
+listen(int32_t sockfd,
+       int32_t backlog)
+{
+   auto socket = getSocket(sockfd);
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   if (::listen(socket->reactor->fd, backlog) != 0) {
+      return hostError(errno);
+   }
+
+   return 0;
+}
+
+int32_t
+accept(int32_t sockfd,
+       SocketAddr *addr,
+       be_val<int32_t> *addrlen)
+{
+   auto socket = getSocket(sockfd);
+   auto hostAddr = sockaddr_in { };
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   auto fd = blockingCall(socket, false, [&](int hostFd) {
+      auto length = static_cast<socklen_t>(sizeof(hostAddr));
+      return ::accept4(hostFd, reinterpret_cast<sockaddr *>(&hostAddr), &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+   });
+
+   if (fd < 0) {
+      return fd;
+   }
+
+   writeAddress(hostAddr, addr, addrlen);
+   return addSocket(fd, socket->type);
+}
+
+int32_t
+send(int32_t sockfd,
+     const void *buffer,
+     int32_t length,
+     int32_t flags)
+{
+   return sendto(sockfd, buffer, length, flags, nullptr, 0);
+}
+
+int32_t
+sendto(int32_t sockfd,
+       const void *buffer,
+       int32_t length,
+       int32_t flags,
+       SocketAddr *dst,
+       int32_t addrlen)
+{
+   auto socket = getSocket(sockfd);
+   auto hostAddr = sockaddr_in { };
+   auto hostAddrPtr = static_cast<sockaddr *>(nullptr);
+   auto hostAddrLen = socklen_t { 0 };
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   if (length < 0) {
+      return socketError(SocketError::Inval);
+   }
+
+   if (dst) {
+      if (!readAddress(dst, addrlen, hostAddr)) {
+         return socketError(SocketError::Inval);
+      }
+
+      hostAddrPtr = reinterpret_cast<sockaddr *>(&hostAddr);
+      hostAddrLen = sizeof(hostAddr);
+   }
+
+   auto hostFlags = translateMsgFlags(flags);
+
+   return blockingCall(socket, !!(flags & SocketMsgFlags::DontWait), [&](int hostFd) {
+      return ::sendto(hostFd, buffer, length, hostFlags, hostAddrPtr, hostAddrLen);
+   });
+}
+
+int32_t
+recv(int32_t sockfd,
+     void *buffer,
+     int32_t length,
+     int32_t flags)
+{
+   return recvfrom(sockfd, buffer, length, flags, nullptr, nullptr);
+}
+
+int32_t
+recvfrom(int32_t sockfd,
+         void *buffer,
+         int32_t length,
+         int32_t flags,
+         SocketAddr *src,
+         be_val<int32_t> *addrlen)
+{
+   auto socket = getSocket(sockfd);
+   auto hostAddr = sockaddr_in { };
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   if (length < 0) {
+      return socketError(SocketError::Inval);
+   }
+
+   auto hostFlags = translateMsgFlags(flags);
+
+   auto result = blockingCall(socket, !!(flags & SocketMsgFlags::DontWait), [&](int hostFd) {
+      auto hostAddrLen = static_cast<socklen_t>(sizeof(hostAddr));
+      return ::recvfrom(hostFd, buffer, length, hostFlags, reinterpret_cast<sockaddr *>(&hostAddr), &hostAddrLen);
+   });
+
+   if (result >= 0 && src) {
+      writeAddress(hostAddr, src, addrlen);
+   }
+
+   return result;
+}
+
+int32_t
+shutdown(int32_t sockfd,
+         int32_t how)
+{
+   auto socket = getSocket(sockfd);
+   auto hostHow = 0;
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   switch (how) {
+   case SocketShutdown::Read:
+      hostHow = SHUT_RD;
+      break;
+   case SocketShutdown::Write:
+      hostHow = SHUT_WR;
+      break;
+   case SocketShutdown::ReadWrite:
+      hostHow = SHUT_RDWR;
+      break;
+   default:
+      return socketError(SocketError::Inval);
+   }
+
+   if (::shutdown(socket->reactor->fd, hostHow) != 0) {
+      return hostError(errno);
+   }
+
+   return 0;
+}
+
+static bool
+translateSocketOption(int32_t level,
+                      int32_t optname,
+                      int &hostLevel,
+                      int &hostOptname)
+{
+   if (level == SocketLevel::TCP) {
+      hostLevel = IPPROTO_TCP;
+
+      if (optname == SocketOption::TcpNoDelay) {
+         hostOptname = TCP_NODELAY;
+         return true;
+      }
+
+      return false;
+   }
+
+   if (level != SocketLevel::Socket) {
+      return false;
+   }
+
+   hostLevel = SOL_SOCKET;
+
+   switch (optname) {
+   case SocketOption::ReuseAddr:
+      hostOptname = SO_REUSEADDR;
+      return true;
+   case SocketOption::KeepAlive:
+      hostOptname = SO_KEEPALIVE;
+      return true;
+   case SocketOption::Broadcast:
+      hostOptname = SO_BROADCAST;
+      return true;
+   case SocketOption::OobInline:
+      hostOptname = SO_OOBINLINE;
+      return true;
+   case SocketOption::SendBuffer:
+      hostOptname = SO_SNDBUF;
+      return true;
+   case SocketOption::RecvBuffer:
+      hostOptname = SO_RCVBUF;
+      return true;
+   default:
+      return false;
+   }
+}
+
+int32_t
+setsockopt(int32_t sockfd,
+           int32_t level,
+           int32_t optname,
+           void *optval,
+           int32_t optlen)
+{
+   auto socket = getSocket(sockfd);
+   auto value = reinterpret_cast<be_val<int32_t> *>(optval);
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   if (level == SocketLevel::Socket) {
+      // Blocking is handled by us rather than the host socket
+      switch (optname) {
+      case SocketOption::NonBlockingIO:
+         socket->nonBlocking = true;
+         return 0;
+      case SocketOption::BlockingIO:
+         socket->nonBlocking = false;
+         return 0;
+      case SocketOption::NonBlock:
+         if (!value || optlen < 4) {
+            return socketError(SocketError::Inval);
+         }
+
+         socket->nonBlocking = (*value != 0);
+         return 0;
+      case SocketOption::Linger:
+      {
+         auto guestLinger = reinterpret_cast<be_val<int32_t> *>(optval);
+         auto hostLinger = linger { };
+
+         if (!optval || optlen < 8) {
+            return socketError(SocketError::Inval);
+         }
+
+         hostLinger.l_onoff = guestLinger[0];
+         hostLinger.l_linger = guestLinger[1];
+
+         if (::setsockopt(socket->reactor->fd, SOL_SOCKET, SO_LINGER, &hostLinger, sizeof(hostLinger)) != 0) {
+            return hostError(errno);
+         }
+
+         return 0;
+      }
+      }
+   }
+
+   auto hostLevel = 0;
+   auto hostOptname = 0;
+
+   if (!translateSocketOption(level, optname, hostLevel, hostOptname)) {
+      gLog->warn("Unsupported setsockopt level {} option 0x{:X}", level, optname);
+      return socketError(SocketError::NoProtoOpt);
+   }
+
+   if (!value || optlen < 4) {
+      return socketError(SocketError::Inval);
+   }
+
+   auto hostValue = static_cast<int>(*value);
+
+   if (::setsockopt(socket->reactor->fd, hostLevel, hostOptname, &hostValue, sizeof(hostValue)) != 0) {
+      return hostError(errno);
+   }
+
+   return 0;
+}
+
+int32_t
+getsockopt(int32_t sockfd,
+           int32_t level,
+           int32_t optname,
+           void *optval,
+           be_val<int32_t> *optlen)
+{
+   auto socket = getSocket(sockfd);
+   auto value = reinterpret_cast<be_val<int32_t> *>(optval);
+
+   if (!socket) {
+      return socketError(SocketError::BadFd);
+   }
+
+   if (!value || !optlen || *optlen < 4) {
+      return socketError(SocketError::Inval);
+   }
+
+   *optlen = 4;
+
+   if (level == SocketLevel::Socket) {
+      switch (optname) {
+      case SocketOption::NonBlock:
+         *value = socket->nonBlocking ? 1 : 0;
+         return 0;
+      case SocketOption::Type:
+         *value = socket->type;
+         return 0;
+      case SocketOption::Error:
+      {
+         auto error = 0;
+         auto length = static_cast<socklen_t>(sizeof(error));
+
+         if (::getsockopt(socket->reactor->fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0) {
+            return hostError(errno);
+         }
+
+         *value = translateError(error);
+         return 0;
+      }
+      }
+   }
+
+   auto hostLevel = 0;
+   auto hostOptname = 0;
+
+   if (!translateSocketOption(level, optname, hostLevel, hostOptname)) {
+      gLog->warn("Unsupported getsockopt level {} option 0x{:X}", level, optname);
+      return socketError(SocketError::NoProtoOpt);
+   }
+
+   auto hostValue = 0;
+   auto length = static_cast<socklen_t>(sizeof(hostValue));
+
+   if (::getsockopt(socket->reactor->fd, hostLevel, hostOptname, &hostValue, &length) != 0) {
+      return hostError(errno);
+   }
+
+   *value = hostValue;
+   return 0;
+}
+
+int32_t
+select(int32_t nfds,
+       be_val<SocketFdSet> *readfds,
+       be_val<SocketFdSet> *writefds,
+       be_val<SocketFdSet> *exceptfds,
+       SocketTimeval *timeout)
+{
+   auto readSet = readfds ? static_cast<SocketFdSet>(*readfds) : 0u;
+   auto writeSet = writefds ? static_cast<SocketFdSet>(*writefds) : 0u;
+   auto exceptSet = exceptfds ? static_cast<SocketFdSet>(*exceptfds) : 0u;
+   auto entries = std::vector<PollEntry> { };
+   auto fds = std::vector<int32_t> { };
+
+   if (nfds < 0) {
+      return socketError(SocketError::Inval);
+   }
+
+   for (auto fd = 0; fd < std::min(nfds, SocketFdSetSize); ++fd) {
+      auto mask = 1u << fd;
+      auto entry = PollEntry { };
+
+      if (readSet & mask) {
+         entry.events |= POLLIN;
+      }
+
+      if (writeSet & mask) {
+         entry.events |= POLLOUT;
+      }
+
+      if (exceptSet & mask) {
+         entry.events |= POLLPRI;
+      }
+
+      if (!entry.events) {
+         continue;
+      }
+
+      entry.socket = getSocket(fd);
+
+      if (!entry.socket) {
+         return socketError(SocketError::BadFd);
+      }
+
+      entries.push_back(entry);
+      fds.push_back(fd);
+   }
+
+   auto deadline = internal::ReactorClock::time_point { };
+
+   if (timeout) {
+      deadline = internal::ReactorClock::now()
+               + std::chrono::seconds { timeout->tv_sec }
+               + std::chrono::microseconds { timeout->tv_usec };
+   }
+
+   auto result = pollSockets(entries, timeout ? &deadline : nullptr);
+
+   if (result < 0) {
+      return result;
+   }
+
+   readSet = 0;
+   writeSet = 0;
+   exceptSet = 0;
+   result = 0;
+
+   for (auto i = 0u; i < entries.size(); ++i) {
+      auto &entry = entries[i];
+      auto mask = 1u << fds[i];
+
+      if ((entry.events & POLLIN) && (entry.revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))) {
+         readSet |= mask;
+         ++result;
+      }
+
+      if ((entry.events & POLLOUT) && (entry.revents & (POLLOUT | POLLERR | POLLNVAL))) {
+         writeSet |= mask;
+         ++result;
+      }
+
+      if ((entry.events & POLLPRI) && (entry.revents & POLLPRI)) {
+         exceptSet |= mask;
+         ++result;
+      }
+   }
+
+   if (readfds) {
+      *readfds = readSet;
+   }
+
+   if (writefds) {
+      *writefds = writeSet;
+   }
+
+   if (exceptfds) {
+      *exceptfds = exceptSet;
+   }
+
+   return result;
+}
+
+int32_t
+poll(SocketPollFd *fds,
+     uint32_t nfds,
+     int32_t timeout)
+{
+   auto entries = std::vector<PollEntry>(nfds);
+
+   if (nfds && !fds) {
+      return socketError(SocketError::Inval);
+   }
+
+   for (auto i = 0u; i < nfds; ++i) {
+      auto &entry = entries[i];
+      auto events = fds[i].events;
+      entry.socket = getSocket(fds[i].fd);
+
+      if (events & SocketPollEvents::In) {
+         entry.events |= POLLIN;
+      }
+
+      if (events & SocketPollEvents::Pri) {
+         entry.events |= POLLPRI;
+      }
+
+      if (events & SocketPollEvents::Out) {
+         entry.events |= POLLOUT;
+      }
+   }
+
+   auto deadline = internal::ReactorClock::now() + std::chrono::milliseconds { std::max(timeout, 0) };
+   auto result = pollSockets(entries, timeout < 0 ? nullptr : &deadline);
+
+   if (result < 0) {
+      return result;
+   }
+
+   for (auto i = 0u; i < nfds; ++i) {
+      auto revents = entries[i].revents;
+      auto guestRevents = int16_t { 0 };
+
+      if (revents & POLLIN) {
+         guestRevents |= SocketPollEvents::In;
+      }
+
+      if (revents & POLLPRI) {
+         guestRevents |= SocketPollEvents::Pri;
+      }
+
+      if (revents & POLLOUT) {
+         guestRevents |= SocketPollEvents::Out;
+      }
+
+      if (revents & POLLERR) {
+         guestRevents |= SocketPollEvents::Err;
+      }
+
+      if (revents & POLLHUP) {
+         guestRevents |= SocketPollEvents::Hup;
+      }
+
+      if (revents & POLLNVAL) {
+         guestRevents |= SocketPollEvents::Nval;
+      }
+
+      fds[i].revents = guestRevents;
+   }
+
+   return result;
+}
+
+int32_t
+socketlasterr()
+{
+   auto thread = mem::untranslate(coreinit::internal::getCurrentThread());
+   std::unique_lock<std::mutex> lock { sSocketMutex };
+   auto itr = sLastErrors.find(thread);
+
+   if (itr == sLastErrors.end()) {
+      return SocketError::OK;
+   }
+
+   return itr->second;
+}
+
+namespace internal
+{
+
+void
+closeAllSockets()
+{
+   auto sockets = std::vector<std::shared_ptr<Socket>> { };
+
+   {
+      std::unique_lock<std::mutex> lock { sSocketMutex };
+
+      for (auto &socket : sSockets) {
+         if (socket) {
+            sockets.emplace_back(std::move(socket));
+            socket = nullptr;
+         }
+      }
+
+      sLastErrors.clear();
+   }
+
+   // Closed outside of sSocketMutex as this takes the reactor mutex
+   for (auto &socket : sockets) {
+      closeReactorSocket(socket->reactor);
+   }
+}
+
+} // namespace internal
+
+#else
+
+namespace internal
+{
+
+void
+closeAllSockets()
+{
+}
+
+} // namespace internal
+
+#endif // ifdef PLATFORM_LINUX
+
 void
 Module::registerSocketLibFunctions()
 {
    RegisterKernelFunction(socket_lib_init);
    RegisterKernelFunction(socket_lib_finish);
+
+#ifdef PLATFORM_LINUX
+   RegisterKernelFunction(socket);
+   RegisterKernelFunction(socketclose);
+   RegisterKernelFunction(bind);
+   RegisterKernelFunction(connect);
+   RegisterKernelFunction(listen);
+   RegisterKernelFunction(accept);
+   RegisterKernelFunction(send);
+   RegisterKernelFunction(sendto);
+   RegisterKernelFunction(recv);
+   RegisterKernelFunction(recvfrom);
+   RegisterKernelFunction(shutdown);
+   RegisterKernelFunction(setsockopt);
+   RegisterKernelFunction(getsockopt);
+   RegisterKernelFunction(select);
+   RegisterKernelFunction(poll);
+   RegisterKernelFunction(socketlasterr);
+#endif
 }
 
 } // namespace nsysnet
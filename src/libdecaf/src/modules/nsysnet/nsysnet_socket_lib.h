@@ -1,12 +1,164 @@
 #pragma once
+#include "nsysnet_enum.h"
+
+#include <common/be_val.h>
+#include <common/structsize.h>
+#include <cstdint>
 
 namespace nsysnet
 {
 
+//! The guest fd_set is a plain bit mask, so only sockets below 32 can be
+//  used with select.
+using SocketFdSet = uint32_t;
+
+static const int32_t
+SocketFdSetSize = 32;
+
+struct SocketAddr
+{
+   be_val<uint16_t> family;
+   uint8_t data[14];
+};
+CHECK_OFFSET(SocketAddr, 0x00, family);
+CHECK_OFFSET(SocketAddr, 0x02, data);
+CHECK_SIZE(SocketAddr, 0x10);
+
+struct SocketAddrIn
+{
+   be_val<uint16_t> family;
+
+   //! Port and address are in network byte order, which is guest byte order
+   be_val<uint16_t> port;
+   be_val<uint32_t> addr;
+   uint8_t zero[8];
+};
+CHECK_OFFSET(SocketAddrIn, 0x00, family);
+CHECK_OFFSET(SocketAddrIn, 0x02, port);
+CHECK_OFFSET(SocketAddrIn, 0x04, addr);
+CHECK_OFFSET(SocketAddrIn, 0x08, zero);
+CHECK_SIZE(SocketAddrIn, 0x10);
+
+struct SocketTimeval
+{
+   be_val<int32_t> tv_sec;
+   be_val<int32_t> tv_usec;
+};
+CHECK_OFFSET(SocketTimeval, 0x00, tv_sec);
+CHECK_OFFSET(SocketTimeval, 0x04, tv_usec);
+CHECK_SIZE(SocketTimeval, 0x08);
+
+struct SocketPollFd
+{
+   be_val<int32_t> fd;
+   be_val<int16_t> events;
+   be_val<int16_t> revents;
+};
+CHECK_OFFSET(SocketPollFd, 0x00, fd);
+CHECK_OFFSET(SocketPollFd, 0x04, events);
+CHECK_OFFSET(SocketPollFd, 0x06, revents);
+CHECK_SIZE(SocketPollFd, 0x08);
+
 int
 socket_lib_init();
 
 int
 socket_lib_finish();
 
+int32_t
+socket(int32_t family,
+       int32_t type,
+       int32_t protocol);
+
+int32_t
+socketclose(int32_t sockfd);
+
+int32_t
+bind(int32_t sockfd,
+     SocketAddr *addr,
+     int32_t addrlen);
+
+int32_t
+connect(int32_t sockfd,
+        SocketAddr *addr,
+        int32_t addrlen);
+
+int32_t
+listen(int32_t sockfd,
+       int32_t backlog);
+
+int32_t
+accept(int32_t sockfd,
+       SocketAddr *addr,
+       be_val<int32_t> *addrlen);
+
+int32_t
+send(int32_t sockfd,
+     const void *buffer,
+     int32_t length,
+     int32_t flags);
+
+int32_t
+sendto(int32_t sockfd,
+       const void *buffer,
+       int32_t length,
+       int32_t flags,
+       SocketAddr *dst,
+       int32_t addrlen);
+
+int32_t
+recv(int32_t sockfd,
+     void *buffer,
+     int32_t length,
+     int32_t flags);
+
+int32_t
+recvfrom(int32_t sockfd,
+         void *buffer,
+         int32_t length,
+         int32_t flags,
+         SocketAddr *src,
+         be_val<int32_t> *addrlen);
+
+int32_t
+shutdown(int32_t sockfd,
+         int32_t how);
+
+int32_t
+setsockopt(int32_t sockfd,
+           int32_t level,
+           int32_t optname,
+           void *optval,
+           int32_t optlen);
+
+int32_t
+getsockopt(int32_t sockfd,
+           int32_t level,
+           int32_t optname,
+           void *optval,
+           be_val<int32_t> *optlen);
+
+int32_t
+select(int32_t nfds,
+       be_val<SocketFdSet> *readfds,
+       be_val<SocketFdSet> *writefds,
+       be_val<SocketFdSet> *exceptfds,
+       SocketTimeval *timeout);
+
+int32_t
+poll(SocketPollFd *fds,
+     uint32_t nfds,
+     int32_t timeout);
+
+int32_t
+socketlasterr();
+
+namespace internal
+{
+
+void
+closeAllSockets();
+
+} // namespace internal
+
 } // namespace nsysnet
@@ -217,4 +217,81 @@ invokeMemberFn(LogFunc logFn, LogFunc logResFn, cpu::Core *state, ReturnType (Ob
    invokeMemberFn2(logFn, logResFn, argstate, func, type_list<Args...> {});
 }
 
+// Log the remaining arguments of a traced call without calling anything
+inline void
+logArguments(LogState &log, TracedCall *call, size_t &r, size_t &f, type_list<>)
+{
+}
+
+inline void
+logArguments(LogState &log, TracedCall *call, size_t &r, size_t &f, type_list<VarArgs>)
+{
+   logArgumentVargs(log);
+}
+
+template<typename Head, typename... Tail>
+inline void
+logArguments(LogState &log, TracedCall *call, size_t &r, size_t &f, type_list<Head, Tail...>)
+{
+   auto value = getArgument<Head>(call, r, f);
+   logArgument(log, value);
+   logArguments(log, call, r, f, type_list<Tail...> {});
+}
+
+template<typename ReturnType>
+inline std::string
+logResult(cpu::Core *state, type_list<ReturnType>)
+{
+   auto result = getResult<ReturnType>(state);
+   return logCallResult(result);
+}
+
+inline std::string
+logResult(cpu::Core *state, type_list<void>)
+{
+   return logCallResult();
+}
+
+// Format a call to a static function from the registers it was called with
+//  and, if it has returned, the registers it returned with
+template<typename ReturnType, typename... Args>
+inline std::string
+formatCall(TracedCall *call, cpu::Core *result, ReturnType (*func)(Args...), const std::string &name)
+{
+   LogState log;
+   size_t r = 3;
+   size_t f = 1;
+
+   logCall(log, call->lr, name);
+   logArguments(log, call, r, f, type_list<Args...> {});
+   auto out = logCallEnd(log);
+
+   if (result) {
+      out += logResult(result, type_list<ReturnType> {});
+   }
+
+   return out;
+}
+
+// Format a call to a member function, see formatCall
+template<typename ObjectType, typename ReturnType, typename... Args>
+inline std::string
+formatMemberFnCall(TracedCall *call, cpu::Core *result, ReturnType (ObjectType::*func)(Args...), const std::string &name)
+{
+   // Start arguments from r4, as r3=this
+   LogState log;
+   size_t r = 4;
+   size_t f = 1;
+
+   logCall(log, call->lr, name);
+   logArguments(log, call, r, f, type_list<Args...> {});
+   auto out = logCallEnd(log);
+
+   if (result) {
+      out += logResult(result, type_list<ReturnType> {});
+   }
+
+   return out;
+}
+
 } // namespace ppctypes
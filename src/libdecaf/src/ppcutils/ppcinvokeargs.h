@@ -11,15 +11,34 @@ namespace ppctypes
 template <PpcType PpcTypeId, typename Type>
 struct arg_converter_t;
 
+//! Stack argument words copied by TracedCall, enough for any HLE function
+static const size_t
+MaxTracedStackArgs = 8;
+
+//! The argument registers of a call along with a copy of its stack
+//  arguments, taken when the call is made so it can still be formatted
+//  once guest memory has changed.
+struct TracedCall : cpu::CoreRegs
+{
+   uint32_t stack[MaxTracedStackArgs];
+};
+
+//! Address of the first stack argument of a call from within its kcstub
+inline uint32_t
+getStackArgsAddress(cpu::Core *state)
+{
+   // Need to skip the backchain from the caller (8 bytes), plus the backchain we
+   //  precreate as part of our kcstub (8 bytes).  Args come after those.
+   return state->gpr[1] + 8 + 8;
+}
+
 inline uint32_t
 getNextGPR(cpu::Core *state, size_t &r)
 {
    uint32_t value;
 
    if (r > 10) {
-      // Need to skip the backchain from the caller (8 bytes), plus the backchain we
-      //  precreate as part of our kcstub (8 bytes).  Args come after those.
-      auto addr = state->gpr[1] + 8 + 8 + 4 * static_cast<uint32_t>(r - 11);
+      auto addr = getStackArgsAddress(state) + 4 * static_cast<uint32_t>(r - 11);
       value = *mem::translate<be_val<uint32_t>>(addr);
    } else {
       value = state->gpr[r];
@@ -29,11 +48,28 @@ getNextGPR(cpu::Core *state, size_t &r)
    return value;
 }
 
+inline uint32_t
+getNextGPR(TracedCall *state, size_t &r)
+{
+   uint32_t value = 0;
+
+   if (r > 10) {
+      if (r - 11 < MaxTracedStackArgs) {
+         value = state->stack[r - 11];
+      }
+   } else {
+      value = state->gpr[r];
+   }
+
+   ++r;
+   return value;
+}
+
 inline void
 setNextGPR(cpu::Core *state, size_t &r, uint32_t value)
 {
    if (r > 10) {
-      auto addr = state->gpr[1] + 8 + 8 + 4 * static_cast<uint32_t>(r - 11);
+      auto addr = getStackArgsAddress(state) + 4 * static_cast<uint32_t>(r - 11);
       *mem::translate<be_val<uint32_t>>(addr) = value;
    } else {
       state->gpr[r] = value;
@@ -45,7 +81,8 @@ setNextGPR(cpu::Core *state, size_t &r, uint32_t value)
 template<typename Type>
 struct arg_converter_t<PpcType::WORD, Type>
 {
-   static inline Type get(cpu::Core *state, size_t &r, size_t &f)
+   template<typename StateType>
+   static inline Type get(StateType *state, size_t &r, size_t &f)
    {
       return ppctype_converter_t<Type>::from_ppc(getNextGPR(state, r));
    }
@@ -61,7 +98,8 @@ struct arg_converter_t<PpcType::WORD, Type>
 template<typename Type>
 struct arg_converter_t<PpcType::DWORD, Type>
 {
-   static inline Type get(cpu::Core *state, size_t &r, size_t &f)
+   template<typename StateType>
+   static inline Type get(StateType *state, size_t &r, size_t &f)
    {
       auto x = getNextGPR(state, r);
       auto y = getNextGPR(state, r);
@@ -80,7 +118,8 @@ struct arg_converter_t<PpcType::DWORD, Type>
 template<typename Type>
 struct arg_converter_t<PpcType::FLOAT, Type>
 {
-   static inline Type get(cpu::Core *state, size_t &r, size_t &f)
+   template<typename StateType>
+   static inline Type get(StateType *state, size_t &r, size_t &f)
    {
       auto& x = state->fpr[f++].paired0;
       return ppctype_converter_t<Type>::from_ppc(x);
@@ -96,7 +135,8 @@ struct arg_converter_t<PpcType::FLOAT, Type>
 template<typename Type>
 struct arg_converter_t<PpcType::DOUBLE, Type>
 {
-   static inline Type get(cpu::Core *state, size_t &r, size_t &f)
+   template<typename StateType>
+   static inline Type get(StateType *state, size_t &r, size_t &f)
    {
       auto& x = state->fpr[f++].paired0;
       return ppctype_converter_t<Type>::from_ppc(x);
@@ -126,16 +166,17 @@ setArgument(cpu::Core *state, size_t &r, size_t &f, Type v)
    return arg_converter_t<ppctype_converter_t<Type>::ppc_type, Type>::set(state, r, f, v);
 }
 
-// Grab an argument from registers for function
-template<typename Type>
+// Grab an argument from registers for function, state is either the
+//  cpu::Core making the call or a TracedCall copied from one
+template<typename Type, typename StateType>
 inline Type
-getArgument(cpu::Core *state, size_t &r, size_t &f)
+getArgument(StateType *state, size_t &r, size_t &f)
 {
    if (ppctype_converter_t<Type>::ppc_type == PpcType::DWORD) {
       r = alignRegister64(r);
    }
 
-   return arg_converter_t<ppctype_converter_t<Type>::ppc_type, Type>::get(state, r, f);
+   return arg_converter_t<ppctype_converter_t<Type>::ppc_type, Type>::template get<StateType>(state, r, f);
 }
 
 } // namespace ppctypes
@@ -0,0 +1,337 @@
+#include <hle_test.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <nsysnet/socket.h>
+#include <string.h>
+
+// Loopback echo test, a select based non-blocking server echoes for a set
+// of blocking client threads and a poll driven non-blocking client.
+
+#ifndef SO_NONBLOCK
+#define SO_NONBLOCK 0x1016
+#endif
+
+#ifndef POLLIN
+#define POLLIN  0x01
+#define POLLOUT 0x04
+
+struct pollfd
+{
+   int fd;
+   short events;
+   short revents;
+};
+
+int
+poll(struct pollfd *fds, unsigned int nfds, int timeout);
+#endif
+
+#define SOCKET_EWOULDBLOCK 6
+#define SOCKET_EINPROGRESS 22
+
+#define EchoPort 47800
+#define MessageSize 64
+#define Rounds 16
+
+// Guest sockets share one table and select only handles fds below 32, so
+// keep listener + 2 * connections under that.
+#define BlockingClients 6
+#define PollClients 6
+#define TotalClients (BlockingClients + PollClients)
+
+#define StackSize 0x4000
+
+static OSThread sServerThread;
+static uint8_t sServerStack[StackSize] __attribute__((aligned(8)));
+static OSThread sBlockingThreads[BlockingClients];
+static uint8_t sBlockingStacks[BlockingClients][StackSize] __attribute__((aligned(8)));
+static OSThread sPollThread;
+static uint8_t sPollStack[StackSize] __attribute__((aligned(8)));
+
+static int sListener = -1;
+
+static void
+setNonBlocking(int fd)
+{
+   int value = 1;
+   test_assert(setsockopt(fd, SOL_SOCKET, SO_NONBLOCK, &value, sizeof(value)) == 0);
+}
+
+static void
+initLoopbackAddress(struct sockaddr_in *addr)
+{
+   memset(addr, 0, sizeof(*addr));
+   addr->sin_family = AF_INET;
+   addr->sin_port = htons(EchoPort);
+   addr->sin_addr.s_addr = htonl(0x7F000001);
+}
+
+static void
+fillMessage(char *buffer, int client, int round)
+{
+   for (int i = 0; i < MessageSize; ++i) {
+      buffer[i] = (char)(client * 31 + round * 7 + i);
+   }
+}
+
+static void
+sendAll(int fd, const char *buffer, int length)
+{
+   while (length > 0) {
+      int sent = send(fd, buffer, length, 0);
+
+      if (sent < 0 && socketlasterr() == SOCKET_EWOULDBLOCK) {
+         OSSleepTicks(OSMilliseconds(1));
+         continue;
+      }
+
+      test_assert(sent > 0);
+      buffer += sent;
+      length -= sent;
+   }
+}
+
+int
+serverEntry(int argc, const char **argv)
+{
+   int conns[TotalClients];
+   int numConns = 0;
+   int numClosed = 0;
+   char buffer[256];
+
+   for (int i = 0; i < TotalClients; ++i) {
+      conns[i] = -1;
+   }
+
+   while (numClosed < TotalClients) {
+      fd_set readSet;
+      struct timeval timeout;
+      int maxFd = sListener;
+
+      FD_ZERO(&readSet);
+      FD_SET(sListener, &readSet);
+
+      for (int i = 0; i < numConns; ++i) {
+         if (conns[i] >= 0) {
+            FD_SET(conns[i], &readSet);
+
+            if (conns[i] > maxFd) {
+               maxFd = conns[i];
+            }
+         }
+      }
+
+      timeout.tv_sec = 5;
+      timeout.tv_usec = 0;
+
+      int ready = select(maxFd + 1, &readSet, NULL, NULL, &timeout);
+      test_assert(ready > 0);
+
+      if (FD_ISSET(sListener, &readSet)) {
+         while (1) {
+            int fd = accept(sListener, NULL, NULL);
+
+            if (fd < 0) {
+               test_assert(socketlasterr() == SOCKET_EWOULDBLOCK);
+               break;
+            }
+
+            test_assert(numConns < TotalClients);
+            test_assert(fd < 32);
+            setNonBlocking(fd);
+            conns[numConns++] = fd;
+         }
+      }
+
+      for (int i = 0; i < numConns; ++i) {
+         if (conns[i] < 0 || !FD_ISSET(conns[i], &readSet)) {
+            continue;
+         }
+
+         int received = recv(conns[i], buffer, sizeof(buffer), 0);
+
+         if (received == 0) {
+            socketclose(conns[i]);
+            conns[i] = -1;
+            numClosed++;
+         } else if (received > 0) {
+            sendAll(conns[i], buffer, received);
+         } else {
+            test_assert(socketlasterr() == SOCKET_EWOULDBLOCK);
+         }
+      }
+   }
+
+   test_report("Server echoed for %d connections", numClosed);
+   return 0;
+}
+
+int
+blockingClientEntry(int argc, const char **argv)
+{
+   struct sockaddr_in addr;
+   char message[MessageSize];
+   char reply[MessageSize];
+   int client = argc;
+
+   int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+   test_assert(fd >= 0);
+
+   initLoopbackAddress(&addr);
+   test_assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+   for (int round = 0; round < Rounds; ++round) {
+      fillMessage(message, client, round);
+      test_assert(send(fd, message, MessageSize, 0) == MessageSize);
+
+      // A blocking recv may return part of the echo
+      int received = 0;
+
+      while (received < MessageSize) {
+         int result = recv(fd, reply + received, MessageSize - received, 0);
+         test_assert(result > 0);
+         received += result;
+      }
+
+      test_assert(memcmp(message, reply, MessageSize) == 0);
+   }
+
+   socketclose(fd);
+   return 0;
+}
+
+int
+pollClientEntry(int argc, const char **argv)
+{
+   struct sockaddr_in addr;
+   struct pollfd fds[PollClients];
+   int rounds[PollClients];
+   int received[PollClients];
+   char replies[PollClients][MessageSize];
+   char message[MessageSize];
+   int remaining = PollClients;
+
+   initLoopbackAddress(&addr);
+
+   for (int i = 0; i < PollClients; ++i) {
+      int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      test_assert(fd >= 0);
+      setNonBlocking(fd);
+
+      // Nothing to receive yet, must not block
+      test_assert(recv(fd, message, MessageSize, 0) < 0);
+
+      if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+         test_assert(socketlasterr() == SOCKET_EINPROGRESS);
+      }
+
+      fds[i].fd = fd;
+      fds[i].events = POLLOUT;
+      fds[i].revents = 0;
+      rounds[i] = 0;
+      received[i] = 0;
+   }
+
+   while (remaining > 0) {
+      int ready = poll(fds, PollClients, 5000);
+      test_assert(ready > 0);
+
+      for (int i = 0; i < PollClients; ++i) {
+         int client = BlockingClients + i;
+
+         if (fds[i].fd < 0 || !fds[i].revents) {
+            continue;
+         }
+
+         if (fds[i].revents & POLLOUT) {
+            // Connected or finished the previous round, send the next one
+            fillMessage(message, client, rounds[i]);
+            sendAll(fds[i].fd, message, MessageSize);
+            received[i] = 0;
+            fds[i].events = POLLIN;
+            continue;
+         }
+
+         int result = recv(fds[i].fd, replies[i] + received[i], MessageSize - received[i], 0);
+
+         if (result < 0) {
+            test_assert(socketlasterr() == SOCKET_EWOULDBLOCK);
+            continue;
+         }
+
+         test_assert(result > 0);
+         received[i] += result;
+
+         if (received[i] < MessageSize) {
+            continue;
+         }
+
+         fillMessage(message, client, rounds[i]);
+         test_assert(memcmp(message, replies[i], MessageSize) == 0);
+
+         if (++rounds[i] == Rounds) {
+            socketclose(fds[i].fd);
+            fds[i].fd = -1;
+            fds[i].events = 0;
+            remaining--;
+         } else {
+            fds[i].events = POLLOUT;
+         }
+      }
+   }
+
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   struct sockaddr_in addr;
+   int value = 1;
+   int result;
+
+   test_assert(socket_lib_init() == 0);
+
+   // Listen before starting any clients so their connects can not fail
+   sListener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+   test_assert(sListener >= 0);
+   test_assert(setsockopt(sListener, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value)) == 0);
+
+   initLoopbackAddress(&addr);
+   test_assert(bind(sListener, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+   test_assert(listen(sListener, TotalClients) == 0);
+   setNonBlocking(sListener);
+
+   OSCreateThread(&sServerThread, serverEntry, 0, NULL,
+                  sServerStack + StackSize, StackSize, 16,
+                  OS_THREAD_ATTRIB_AFFINITY_CPU0);
+   OSResumeThread(&sServerThread);
+
+   for (int i = 0; i < BlockingClients; ++i) {
+      OSCreateThread(&sBlockingThreads[i], blockingClientEntry, i, NULL,
+                     sBlockingStacks[i] + StackSize, StackSize, 16,
+                     (i & 1) ? OS_THREAD_ATTRIB_AFFINITY_CPU2 : OS_THREAD_ATTRIB_AFFINITY_CPU1);
+      OSResumeThread(&sBlockingThreads[i]);
+   }
+
+   OSCreateThread(&sPollThread, pollClientEntry, 0, NULL,
+                  sPollStack + StackSize, StackSize, 16,
+                  OS_THREAD_ATTRIB_AFFINITY_CPU2);
+   OSResumeThread(&sPollThread);
+
+   for (int i = 0; i < BlockingClients; ++i) {
+      OSJoinThread(&sBlockingThreads[i], &result);
+      test_assert(result == 0);
+   }
+
+   OSJoinThread(&sPollThread, &result);
+   test_assert(result == 0);
+
+   OSJoinThread(&sServerThread, &result);
+   test_assert(result == 0);
+
+   socketclose(sListener);
+   socket_lib_finish();
+   test_report("Echoed %d rounds on %d connections", Rounds, TotalClients);
+   return 0;
+}
@@ -1,15 +1,24 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
 #include <excmd.h>
 #include <fstream>
 #include <gsl.h>
 #include <iostream>
 #include <spdlog/spdlog.h>
+#include <thread>
+#include <common/murmur3.h>
+#include <common/platform_dir.h>
 #include <common/teenyheap.h>
 #include "libcpu/mem.h"
 #include "gpu/gfd.h"
 #include "gpu/microcode/latte_disassembler.h"
 #include "gpu/pm4_buffer.h"
+#include "gpu/glsl2/glsl2_cache.h"
 #include "gpu/glsl2/glsl2_translate.h"
+#include "gpu/opengl/opengl_shadertranslate.h"
 #include "modules/gx2/gx2_addrlib.h"
 #include "modules/gx2/gx2_dds.h"
 #include "modules/gx2/gx2_texture.h"
@@ -1074,6 +1083,627 @@ convertTexture(const std::string &path)
    return true;
 }
 
+struct TranslateJob
+{
+   std::string filename;
+   uint32_t index;
+   glsl2::Shader input;
+   std::vector<uint8_t> program;
+
+   // Output
+   glsl2::Shader shader;
+   bool translated = false;
+   double milliseconds = 0.0;
+};
+
+static latte::SQ_TEX_DIM
+getSamplerDim(gx2::GX2SamplerVarType type)
+{
+   switch (type) {
+   case gx2::GX2SamplerVarType::Sampler1D:
+      return latte::SQ_TEX_DIM::DIM_1D;
+   case gx2::GX2SamplerVarType::Sampler3D:
+      return latte::SQ_TEX_DIM::DIM_3D;
+   case gx2::GX2SamplerVarType::SamplerCube:
+      return latte::SQ_TEX_DIM::DIM_CUBEMAP;
+   case gx2::GX2SamplerVarType::Sampler2D:
+   default:
+      return latte::SQ_TEX_DIM::DIM_2D;
+   }
+}
+
+//! Set the translation inputs the driver would derive from register state
+//  from what the shader header declares instead.
+template<typename HeaderType>
+static void
+initialiseShader(glsl2::Shader &shader,
+                 glsl2::Shader::Type type,
+                 const HeaderType *header)
+{
+   shader.type = type;
+   shader.samplerDim.fill(latte::SQ_TEX_DIM::DIM_2D);
+   shader.uniformRegistersEnabled = (header->mode.value() == gx2::GX2ShaderMode::UniformRegister);
+   shader.uniformBlocksEnabled = !shader.uniformRegistersEnabled;
+   shader.embedDisassembly = false;
+
+   for (auto i = 0u; i < header->samplerVarCount; ++i) {
+      auto &var = header->samplerVars[i];
+      auto location = static_cast<uint32_t>(var.location);
+
+      if (location < shader.samplerDim.size()) {
+         shader.samplerDim[location] = getSamplerDim(var.type.value());
+      }
+   }
+}
+
+static bool
+loadShaders(const std::string &filename,
+            std::vector<TranslateJob> &jobs)
+{
+   gfd::Reader reader;
+   std::ifstream file(filename, std::ifstream::binary | std::ifstream::in);
+   std::map<uint32_t, glsl2::Shader> vertexShaders, pixelShaders, geometryShaders;
+
+   if (!file.is_open()) {
+      std::cout << "Could not open " << filename << std::endl;
+      return false;
+   }
+
+   file.seekg(0, std::ifstream::end);
+   auto fileSize = static_cast<size_t>(file.tellg());
+   file.seekg(0, std::ifstream::beg);
+
+   auto fileData = heapAllocate(fileSize);
+   file.read(reinterpret_cast<char*>(fileData.data), fileData.size);
+
+   if (!reader.parse(fileData.data, fileData.size)) {
+      std::cout << "Could not parse " << filename << std::endl;
+      return false;
+   }
+
+   // Shader headers come before their programs
+   for (auto &block : reader.blocks) {
+      auto index = static_cast<uint32_t>(block.header->index);
+      auto size = static_cast<uint32_t>(block.header->dataSize);
+      auto job = TranslateJob { };
+      job.filename = filename;
+      job.index = index;
+      job.program.assign(block.data, block.data + size);
+
+      switch (block.header->type) {
+      case gfd::BlockType::VertexShaderHeader:
+         initialiseShader(vertexShaders[index], glsl2::Shader::VertexShader, reinterpret_cast<gx2::GX2VertexShader *>(block.data));
+         break;
+      case gfd::BlockType::PixelShaderHeader:
+         initialiseShader(pixelShaders[index], glsl2::Shader::PixelShader, reinterpret_cast<gx2::GX2PixelShader *>(block.data));
+         break;
+      case gfd::BlockType::GeometryShaderHeader:
+         initialiseShader(geometryShaders[index], glsl2::Shader::GeometryShader, reinterpret_cast<gx2::GX2GeometryShader *>(block.data));
+         break;
+      case gfd::BlockType::VertexShaderProgram:
+         job.input = vertexShaders[index];
+         jobs.push_back(std::move(job));
+         break;
+      case gfd::BlockType::PixelShaderProgram:
+         job.input = pixelShaders[index];
+         jobs.push_back(std::move(job));
+         break;
+      case gfd::BlockType::GeometryShaderProgram:
+         job.input = geometryShaders[index];
+         jobs.push_back(std::move(job));
+         break;
+      }
+   }
+
+   return true;
+}
+
+static const char *
+getShaderTypeName(glsl2::Shader::Type type)
+{
+   switch (type) {
+   case glsl2::Shader::VertexShader:
+      return "vertex";
+   case glsl2::Shader::PixelShader:
+      return "pixel";
+   case glsl2::Shader::GeometryShader:
+      return "geometry";
+   default:
+      return "invalid";
+   }
+}
+
+static void
+runTranslateJob(TranslateJob &job)
+{
+   auto start = std::chrono::high_resolution_clock::now();
+   job.shader = job.input;
+   job.translated = glsl2::translate(job.shader, gsl::make_span(job.program));
+   job.milliseconds = std::chrono::duration<double, std::milli> { std::chrono::high_resolution_clock::now() - start }.count();
+}
+
+static double
+benchTranslate(std::vector<TranslateJob> &jobs,
+               uint32_t iterations,
+               bool embedDisassembly,
+               size_t &codeSize)
+{
+   auto total = 0.0;
+   codeSize = 0;
+
+   for (auto i = 0u; i < iterations; ++i) {
+      for (auto &job : jobs) {
+         job.input.embedDisassembly = embedDisassembly;
+         runTranslateJob(job);
+         total += job.milliseconds;
+         codeSize += job.shader.fileHeader.size() + job.shader.codeHeader.size() + job.shader.codeBody.size();
+      }
+   }
+
+   return total;
+}
+
+//! Time the GLSL translator over every shader in a .gsh file, or in every
+//  .gsh file listed one per line in a text file.
+static bool
+benchShaders(const std::string &path,
+             uint32_t iterations)
+{
+   std::vector<TranslateJob> jobs;
+
+   if (getExtension(path) == ".txt") {
+      std::ifstream list(path);
+      std::string line;
+
+      if (!list.is_open()) {
+         std::cout << "Could not open " << path << std::endl;
+         return false;
+      }
+
+      while (std::getline(list, line)) {
+         if (!line.empty() && !loadShaders(line, jobs)) {
+            return false;
+         }
+      }
+   } else if (!loadShaders(path, jobs)) {
+      return false;
+   }
+
+   if (jobs.empty() || !iterations) {
+      std::cout << "No shaders to translate" << std::endl;
+      return false;
+   }
+
+   auto count = jobs.size() * iterations;
+   auto codeSize = size_t { 0 };
+   auto withDisassembly = benchTranslate(jobs, iterations, true, codeSize);
+   std::cout << fmt::format("with disassembly:    {} shaders in {:.2f} ms, {:.3f} ms per shader, {} bytes per shader",
+                            count, withDisassembly, withDisassembly / count, codeSize / count) << std::endl;
+
+   auto withoutDisassembly = benchTranslate(jobs, iterations, false, codeSize);
+   std::cout << fmt::format("without disassembly: {} shaders in {:.2f} ms, {:.3f} ms per shader, {} bytes per shader",
+                            count, withoutDisassembly, withoutDisassembly / count, codeSize / count) << std::endl;
+   return true;
+}
+
+static void
+findShaderFiles(const std::string &path,
+                std::vector<std::string> &files)
+{
+   std::vector<std::string> entries;
+
+   if (!platform::listDirectory(path, entries)) {
+      return;
+   }
+
+   for (auto &entry : entries) {
+      auto entryPath = path + "/" + entry;
+
+      if (platform::isDirectory(entryPath)) {
+         findShaderFiles(entryPath, files);
+      } else if (getExtension(entry) == ".gsh") {
+         files.push_back(entryPath);
+      }
+   }
+}
+
+//! Translate every shader in a title's content directory across all cores,
+//  and store the results in the title's shader cache so the emulator does
+//  not have to translate them on first use.
+static bool
+pretranslateShaders(const std::string &contentPath,
+                    uint64_t titleId,
+                    std::string cachePath)
+{
+   std::vector<std::string> files;
+   std::vector<TranslateJob> jobs;
+   findShaderFiles(contentPath, files);
+
+   for (auto &file : files) {
+      // loadShaders prints the reason it failed
+      if (!loadShaders(file, jobs)) {
+         std::cout << "FAILED to load " << file << std::endl;
+         return false;
+      }
+   }
+
+   if (jobs.empty()) {
+      std::cout << "No shaders found in " << contentPath << std::endl;
+      return false;
+   }
+
+   auto start = std::chrono::high_resolution_clock::now();
+   std::atomic<size_t> nextJob { 0 };
+   auto threads = std::vector<std::thread> { };
+   auto numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+   for (auto i = 0u; i < numThreads; ++i) {
+      threads.emplace_back([&]() {
+         for (auto job = nextJob++; job < jobs.size(); job = nextJob++) {
+            runTranslateJob(jobs[job]);
+         }
+      });
+   }
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   auto elapsed = std::chrono::duration<double, std::milli> { std::chrono::high_resolution_clock::now() - start }.count();
+
+   if (cachePath.empty()) {
+      cachePath = fmt::format("{}/decaf/shader_cache/{:016X}.bin", platform::getConfigDirectory(), titleId);
+   }
+
+   glsl2::ShaderCache cache;
+   platform::createParentDirectories(cachePath);
+
+   if (!cache.open(cachePath)) {
+      std::cout << "Could not open shader cache " << cachePath << std::endl;
+      return false;
+   }
+
+   auto failed = 0u;
+
+   for (auto &job : jobs) {
+      auto type = getShaderTypeName(job.shader.type);
+
+      if (!job.translated) {
+         std::cout << fmt::format("FAILED {} {} shader {}", job.filename, type, job.index) << std::endl;
+         failed++;
+         continue;
+      }
+
+      std::cout << fmt::format("{:8.3f} ms {} {} shader {}", job.milliseconds, job.filename, type, job.index) << std::endl;
+      cache.insertTranslation(glsl2::getTranslationKey(job.shader, gsl::make_span(job.program)), job.shader);
+   }
+
+   std::cout << fmt::format("Translated {} of {} shaders from {} files in {:.2f} ms using {} threads, written to {}",
+                            jobs.size() - failed, jobs.size(), files.size(), elapsed, numThreads, cachePath) << std::endl;
+   return failed == 0;
+}
+
+static void
+setRegister(gpu::opengl::ShaderRegisters &registers,
+            latte::Register id,
+            uint32_t value)
+{
+   registers[id / 4] = value;
+}
+
+//! Set the registers GX2SetShaderMode and GX2Set*Shader would for a shader,
+//  and sampler dimensions from what the shader header declares.
+template<typename HeaderType>
+static void
+setShaderRegisters(gpu::opengl::ShaderRegisters &registers,
+                   const HeaderType *header,
+                   latte::SQ_RES_OFFSET samplerResources)
+{
+   auto sq_config = latte::SQ_CONFIG::get(0);
+
+   if (header->mode.value() == gx2::GX2ShaderMode::UniformRegister) {
+      sq_config = sq_config
+         .DX9_CONSTS(1);
+   }
+
+   setRegister(registers, latte::Register::SQ_CONFIG, sq_config.value);
+
+   for (auto i = 0u; i < header->samplerVarCount; ++i) {
+      auto &var = header->samplerVars[i];
+      auto location = static_cast<uint32_t>(var.location);
+
+      if (location < latte::MaxSamplers) {
+         auto resourceOffset = (samplerResources + location) * 7;
+         auto sq_tex_resource_word0 = latte::SQ_TEX_RESOURCE_WORD0_N::get(0)
+            .DIM(getSamplerDim(var.type.value()));
+         setRegister(registers, static_cast<latte::Register>(latte::Register::SQ_TEX_RESOURCE_WORD0_0 + 4 * resourceOffset), sq_tex_resource_word0.value);
+      }
+   }
+}
+
+static void
+setVertexShaderRegisters(gpu::opengl::ShaderRegisters &registers,
+                         const gx2::GX2VertexShader *header)
+{
+   setShaderRegisters(registers, header, latte::SQ_RES_OFFSET::VS_TEX_RESOURCE_0);
+   setRegister(registers, latte::Register::SPI_VS_OUT_CONFIG, header->regs.spi_vs_out_config.value().value);
+
+   auto num_spi_vs_out_id = header->regs.num_spi_vs_out_id.value();
+   auto spi_vs_out_id = header->regs.spi_vs_out_id.value();
+   auto num_sq_vtx_semantic = header->regs.num_sq_vtx_semantic.value();
+   auto sq_vtx_semantics = header->regs.sq_vtx_semantic.value();
+
+   for (auto i = 0u; i < std::min<size_t>(num_spi_vs_out_id, spi_vs_out_id.size()); ++i) {
+      setRegister(registers, static_cast<latte::Register>(latte::Register::SPI_VS_OUT_ID_0 + 4 * i), spi_vs_out_id[i].value);
+   }
+
+   for (auto i = 0u; i < 32; ++i) {
+      auto sq_vtx_semantic = latte::SQ_VTX_SEMANTIC_N::get(0xff);
+
+      if (i < num_sq_vtx_semantic) {
+         sq_vtx_semantic = sq_vtx_semantics[i];
+      }
+
+      setRegister(registers, static_cast<latte::Register>(latte::Register::SQ_VTX_SEMANTIC_0 + 4 * i), sq_vtx_semantic.value);
+   }
+}
+
+static void
+setPixelShaderRegisters(gpu::opengl::ShaderRegisters &registers,
+                        const gx2::GX2PixelShader *header)
+{
+   setShaderRegisters(registers, header, latte::SQ_RES_OFFSET::PS_TEX_RESOURCE_0);
+   setRegister(registers, latte::Register::SPI_PS_IN_CONTROL_0, header->regs.spi_ps_in_control_0.value().value);
+   setRegister(registers, latte::Register::SPI_PS_IN_CONTROL_1, header->regs.spi_ps_in_control_1.value().value);
+   setRegister(registers, latte::Register::CB_SHADER_MASK, header->regs.cb_shader_mask.value().value);
+   setRegister(registers, latte::Register::DB_SHADER_CONTROL, header->regs.db_shader_control.value().value);
+
+   auto num_spi_ps_input_cntl = header->regs.num_spi_ps_input_cntl.value();
+   auto spi_ps_input_cntls = header->regs.spi_ps_input_cntls.value();
+
+   for (auto i = 0u; i < std::min<size_t>(num_spi_ps_input_cntl, spi_ps_input_cntls.size()); ++i) {
+      setRegister(registers, static_cast<latte::Register>(latte::Register::SPI_PS_INPUT_CNTL_0 + 4 * i), spi_ps_input_cntls[i].value);
+   }
+}
+
+//! A fetch shader loading a vec4 for every semantic the vertex shader uses,
+//  .gsh files do not contain fetch shaders as GX2 builds them at runtime.
+static std::vector<gpu::opengl::FetchShaderAttrib>
+getDefaultAttribs(const gpu::opengl::ShaderRegisters &registers)
+{
+   std::vector<gpu::opengl::FetchShaderAttrib> attribs;
+
+   for (auto i = 0u; i < 32; ++i) {
+      auto sq_vtx_semantic = latte::SQ_VTX_SEMANTIC_N::get(registers[(latte::Register::SQ_VTX_SEMANTIC_0 + 4 * i) / 4]);
+      auto id = sq_vtx_semantic.SEMANTIC_ID();
+
+      if (id == 0xff) {
+         continue;
+      }
+
+      auto attrib = gpu::opengl::FetchShaderAttrib { };
+      attrib.buffer = static_cast<uint32_t>(attribs.size());
+      attrib.location = id;
+      attrib.bytesPerElement = 16;
+      attrib.srcSelX = latte::SQ_SEL::SEL_X;
+      attrib.type = latte::SQ_VTX_FETCH_TYPE::VERTEX_DATA;
+      attrib.format = latte::SQ_DATA_FORMAT::FMT_32_32_32_32_FLOAT;
+      attrib.dstSel[0] = latte::SQ_SEL::SEL_X;
+      attrib.dstSel[1] = latte::SQ_SEL::SEL_Y;
+      attrib.dstSel[2] = latte::SQ_SEL::SEL_Z;
+      attrib.dstSel[3] = latte::SQ_SEL::SEL_W;
+      attrib.numFormat = latte::SQ_NUM_FORMAT::SCALED;
+      attrib.endianSwap = latte::SQ_ENDIAN::SWAP_8IN32;
+      attrib.formatComp = latte::SQ_FORMAT_COMP::UNSIGNED;
+      attribs.push_back(attrib);
+   }
+
+   return attribs;
+}
+
+static std::array<uint64_t, 2>
+hashProgram(const gfd::Reader::Block &block)
+{
+   auto hash = std::array<uint64_t, 2> { };
+   MurmurHash3_x64_128(block.data, static_cast<int>(block.header->dataSize), 0, hash.data());
+   return hash;
+}
+
+static gsl::span<const uint8_t>
+getHashBytes(const std::array<uint64_t, 2> &hash)
+{
+   return gsl::make_span(reinterpret_cast<const uint8_t *>(hash.data()), sizeof(hash));
+}
+
+static bool
+compareCachedShader(const glsl2::CachedShader &expected,
+                    const glsl2::CachedShader &actual,
+                    std::string &field)
+{
+   if (expected.type != actual.type) {
+      field = "type";
+   } else if (expected.code != actual.code) {
+      field = "code";
+   } else if (expected.disassembly != actual.disassembly) {
+      field = "disassembly";
+   } else if (expected.samplerUsage != actual.samplerUsage) {
+      field = "samplerUsage";
+   } else if (expected.usedUniformBlocks != actual.usedUniformBlocks) {
+      field = "usedUniformBlocks";
+   } else if (expected.isScreenSpace != actual.isScreenSpace) {
+      field = "isScreenSpace";
+   } else if (expected.outputMap != actual.outputMap) {
+      field = "outputMap";
+   } else if (expected.usedFeedbackBuffers != actual.usedFeedbackBuffers) {
+      field = "usedFeedbackBuffers";
+   } else if (expected.binaryFormat != actual.binaryFormat) {
+      field = "binaryFormat";
+   } else if (expected.binary != actual.binary) {
+      field = "binary";
+   } else {
+      return true;
+   }
+
+   return false;
+}
+
+//! Translate the shaders in a .gsh file the way the OpenGL driver would,
+//  from a register snapshot and without a GL context, write them to a new
+//  shader cache and check every record reads back unchanged.
+static bool
+verifyShaderCache(const std::string &filename,
+                  const std::string &cachePath)
+{
+   gfd::Reader reader;
+   std::ifstream file(filename, std::ifstream::binary | std::ifstream::in);
+   std::map<uint32_t, gx2::GX2VertexShader *> vertexHeaders;
+   std::map<uint32_t, gx2::GX2PixelShader *> pixelHeaders;
+   std::map<uint32_t, const gfd::Reader::Block *> vertexPrograms, pixelPrograms;
+
+   if (!file.is_open()) {
+      std::cout << "Could not open " << filename << std::endl;
+      return false;
+   }
+
+   file.seekg(0, std::ifstream::end);
+   auto fileSize = static_cast<size_t>(file.tellg());
+   file.seekg(0, std::ifstream::beg);
+
+   auto fileData = heapAllocate(fileSize);
+   file.read(reinterpret_cast<char*>(fileData.data), fileData.size);
+
+   if (!reader.parse(fileData.data, fileData.size)) {
+      std::cout << "Could not parse " << filename << std::endl;
+      return false;
+   }
+
+   for (auto &block : reader.blocks) {
+      auto index = static_cast<uint32_t>(block.header->index);
+
+      switch (block.header->type) {
+      case gfd::BlockType::VertexShaderHeader:
+         vertexHeaders[index] = reinterpret_cast<gx2::GX2VertexShader *>(block.data);
+         break;
+      case gfd::BlockType::PixelShaderHeader:
+         pixelHeaders[index] = reinterpret_cast<gx2::GX2PixelShader *>(block.data);
+         break;
+      case gfd::BlockType::VertexShaderProgram:
+         vertexPrograms[index] = &block;
+         break;
+      case gfd::BlockType::PixelShaderProgram:
+         pixelPrograms[index] = &block;
+         break;
+      }
+   }
+
+   // Pair each vertex shader with the pixel shader of the same index, as a
+   //  pixel shader's translation depends on the vertex shader's outputs.
+   std::map<glsl2::ShaderCacheKey, glsl2::CachedShader> expected;
+   glsl2::ShaderCache translations;
+   auto failed = 0u;
+
+   for (auto &itr : vertexPrograms) {
+      auto index = itr.first;
+      auto header = vertexHeaders[index];
+
+      if (!header) {
+         continue;
+      }
+
+      auto registers = std::unique_ptr<gpu::opengl::ShaderRegisters> { new gpu::opengl::ShaderRegisters { } };
+      auto &program = *itr.second;
+      auto binary = gsl::make_span(program.data, program.header->dataSize);
+      setVertexShaderRegisters(*registers, header);
+
+      auto attribs = getDefaultAttribs(*registers);
+      auto fetchHash = std::array<uint64_t, 2> { };
+      auto vertexKey = gpu::opengl::getVertexShaderCacheKey(*registers, getHashBytes(fetchHash), getHashBytes(hashProgram(program)), false);
+      auto vertex = glsl2::CachedShader { };
+      vertex.type = glsl2::Shader::VertexShader;
+
+      if (!gpu::opengl::compileVertexShader(vertex, translations, attribs, { }, *registers, binary, false)) {
+         std::cout << fmt::format("FAILED {} vertex shader {}", filename, index) << std::endl;
+         failed++;
+         continue;
+      }
+
+      expected[vertexKey] = vertex;
+
+      auto pixelItr = pixelPrograms.find(index);
+
+      if (pixelItr == pixelPrograms.end() || !pixelHeaders[index]) {
+         continue;
+      }
+
+      auto &pixelProgram = *pixelItr->second;
+      auto pixelBinary = gsl::make_span(pixelProgram.data, pixelProgram.header->dataSize);
+      setPixelShaderRegisters(*registers, pixelHeaders[index]);
+
+      auto pixelKey = gpu::opengl::getPixelShaderCacheKey(*registers, vertexKey, getHashBytes(hashProgram(pixelProgram)));
+      auto pixel = glsl2::CachedShader { };
+      pixel.type = glsl2::Shader::PixelShader;
+
+      if (!gpu::opengl::compilePixelShader(pixel, translations, vertex.outputMap, *registers, pixelBinary)) {
+         std::cout << fmt::format("FAILED {} pixel shader {}", filename, index) << std::endl;
+         failed++;
+         continue;
+      }
+
+      expected[pixelKey] = pixel;
+   }
+
+   if (expected.empty()) {
+      std::cout << "No shaders translated from " << filename << std::endl;
+      return false;
+   }
+
+   // Write every shader to a fresh cache, then read it back
+   platform::createParentDirectories(cachePath);
+   std::remove(cachePath.c_str());
+
+   {
+      glsl2::ShaderCache cache;
+
+      if (!cache.open(cachePath)) {
+         std::cout << "Could not open shader cache " << cachePath << std::endl;
+         return false;
+      }
+
+      for (auto &itr : expected) {
+         cache.insert(itr.first, itr.second);
+      }
+   }
+
+   glsl2::ShaderCache cache;
+
+   if (!cache.open(cachePath)) {
+      std::cout << "Could not reopen shader cache " << cachePath << std::endl;
+      return false;
+   }
+
+   if (cache.getShaders().size() != expected.size()) {
+      std::cout << fmt::format("Shader cache has {} records, expected {}", cache.getShaders().size(), expected.size()) << std::endl;
+      failed++;
+   }
+
+   for (auto &itr : expected) {
+      auto shader = cache.find(itr.first);
+      auto field = std::string { };
+
+      if (!shader) {
+         std::cout << fmt::format("MISSING {} shader {:016X}{:016X}", getShaderTypeName(itr.second.type), itr.first[0], itr.first[1]) << std::endl;
+         failed++;
+      } else if (!compareCachedShader(itr.second, *shader, field)) {
+         std::cout << fmt::format("MISMATCH {} shader {:016X}{:016X} {}", getShaderTypeName(itr.second.type), itr.first[0], itr.first[1], field) << std::endl;
+         failed++;
+      }
+   }
+
+   std::cout << fmt::format("Verified {} of {} shaders from {} through {}",
+                            expected.size() - std::min<size_t>(failed, expected.size()), expected.size(), filename, cachePath) << std::endl;
+   return failed == 0;
+}
+
 int main(int argc, char **argv)
 {
    int result = -1;
@@ -1081,6 +1711,7 @@ int main(int argc, char **argv)
    excmd::option_state options;
 
    mem::initialise();
+   gLog = std::make_shared<spdlog::logger>("gfd-tool", spdlog::sinks::stdout_sink_mt::instance());
    gHeap = new TeenyHeap(mem::translate(mem::SystemBase), mem::SystemSize);
 
    // Setup command line options
@@ -1093,6 +1724,27 @@ int main(int argc, char **argv)
    parser.add_command("info")
       .add_argument("file in", excmd::value<std::string> { });
 
+   parser.add_command("pretranslate")
+      .add_option("title-id",
+                  excmd::description { "Title id of the shader cache to write, in hex." },
+                  excmd::value<std::string> { })
+      .add_option("output",
+                  excmd::description { "Shader cache file to write, defaults to the emulator's cache for the title." },
+                  excmd::value<std::string> { })
+      .add_argument("content dir", excmd::value<std::string> { });
+
+   parser.add_command("verify-cache")
+      .add_option("output",
+                  excmd::description { "Shader cache file to write and read back." },
+                  excmd::default_value<std::string> { "verify_cache.bin" })
+      .add_argument("file in", excmd::value<std::string> { });
+
+   parser.add_command("bench-translate")
+      .add_option("iterations",
+                  excmd::description { "Number of times to translate each shader." },
+                  excmd::default_value<uint32_t> { 10 })
+      .add_argument("shaders", excmd::value<std::string> { });
+
    // TODO: Fix texture convert
    //parser.add_command("convert")
    //   .add_argument("src", excmd::value<std::string> { });
@@ -1119,6 +1771,31 @@ int main(int argc, char **argv)
    if (options.has("info")) {
       auto in = options.get<std::string>("file in");
       result = printInfo(in) ? 0 : -1;
+   } else if (options.has("pretranslate")) {
+      auto in = options.get<std::string>("content dir");
+      auto titleId = uint64_t { 0 };
+      auto output = std::string { };
+
+      if (options.has("title-id")) {
+         titleId = std::stoull(options.get<std::string>("title-id"), nullptr, 16);
+      }
+
+      if (options.has("output")) {
+         output = options.get<std::string>("output");
+      } else if (!titleId) {
+         std::cout << "One of --title-id or --output is required" << std::endl;
+         std::exit(-1);
+      }
+
+      result = pretranslateShaders(in, titleId, output) ? 0 : -1;
+   } else if (options.has("verify-cache")) {
+      auto in = options.get<std::string>("file in");
+      auto output = options.get<std::string>("output");
+      result = verifyShaderCache(in, output) ? 0 : -1;
+   } else if (options.has("bench-translate")) {
+      auto in = options.get<std::string>("shaders");
+      auto iterations = options.get<uint32_t>("iterations");
+      result = benchShaders(in, iterations) ? 0 : -1;
    } else if (options.has("convert")) {
       auto src = options.get<std::string>("src");
       result = convertTexture(src) ? 0 : -1;
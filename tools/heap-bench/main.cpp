@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <chrono>
+#include <common/teenyheap.h>
+#include <common/tlsfheap.h>
+#include <excmd.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+struct ChurnOptions
+{
+   uint64_t heapSize;
+   uint32_t operations;
+   uint32_t maxLive;
+   uint32_t seed;
+};
+
+struct ChurnOperation
+{
+   //! Size to allocate, or 0 to free the live allocation at index
+   uint32_t size;
+   uint32_t alignment;
+   uint32_t index;
+};
+
+struct ChurnResult
+{
+   double seconds = 0.0;
+   uint32_t allocs = 0;
+   uint32_t frees = 0;
+   uint32_t failures = 0;
+   size_t totalFree = 0;
+   size_t largestFree = 0;
+   size_t largestFreeWhenEmpty = 0;
+};
+
+/**
+ * Generate the same random mix of allocations and frees for every heap:
+ * mostly small blocks, some page aligned buffers like GX2 and valloc use,
+ * freed in random order so the heap has to cope with holes everywhere.
+ */
+static std::vector<ChurnOperation>
+generateChurn(const ChurnOptions &options)
+{
+   auto rng = std::mt19937 { options.seed };
+   auto operations = std::vector<ChurnOperation> { };
+   auto live = uint32_t { 0 };
+   operations.reserve(options.operations);
+
+   for (auto i = 0u; i < options.operations; ++i) {
+      auto op = ChurnOperation { };
+
+      if (live > 0 && (live >= options.maxLive || rng() % 2)) {
+         op.size = 0;
+         op.index = rng() % live;
+         --live;
+      } else {
+         auto kind = rng() % 16;
+
+         if (kind < 12) {
+            op.size = 16 + rng() % 512;
+            op.alignment = 4 << (rng() % 3);
+         } else if (kind < 15) {
+            op.size = 4096 + rng() % (64 * 1024);
+            op.alignment = 256;
+         } else {
+            op.size = 64 * 1024 + rng() % (1024 * 1024);
+            op.alignment = 4096;
+         }
+
+         ++live;
+      }
+
+      operations.push_back(op);
+   }
+
+   return operations;
+}
+
+template<typename HeapType>
+static ChurnResult
+runChurn(const ChurnOptions &options,
+         const std::vector<ChurnOperation> &operations)
+{
+   auto buffer = std::vector<uint8_t>(static_cast<size_t>(options.heapSize));
+   auto heap = std::make_unique<HeapType>(buffer.data(), buffer.size());
+   auto live = std::vector<void *> { };
+   auto result = ChurnResult { };
+   live.reserve(options.maxLive);
+
+   auto start = std::chrono::steady_clock::now();
+
+   for (auto &op : operations) {
+      if (op.size) {
+         auto ptr = heap->alloc(op.size, op.alignment);
+
+         if (ptr) {
+            live.push_back(ptr);
+            ++result.allocs;
+         } else {
+            ++result.failures;
+         }
+      } else if (!live.empty()) {
+         // Swap remove so the free order stays random without O(n) erase
+         auto index = op.index % live.size();
+         heap->free(live[index]);
+         live[index] = live.back();
+         live.pop_back();
+         ++result.frees;
+      }
+   }
+
+   result.seconds = std::chrono::duration<double> { std::chrono::steady_clock::now() - start }.count();
+   result.totalFree = heap->getTotalFreeSize();
+   result.largestFree = heap->getLargestFreeSize();
+
+   for (auto ptr : live) {
+      heap->free(ptr);
+   }
+
+   result.largestFreeWhenEmpty = heap->getLargestFreeSize();
+   return result;
+}
+
+static void
+printResult(const std::string &name,
+            const ChurnOptions &options,
+            const ChurnResult &result)
+{
+   auto opsPerSecond = (result.allocs + result.frees + result.failures) / result.seconds;
+   auto fragmentation = 0.0;
+
+   if (result.totalFree) {
+      fragmentation = 100.0 * (1.0 - static_cast<double>(result.largestFree) / result.totalFree);
+   }
+
+   std::cout << std::left << std::setw(10) << name
+             << std::fixed << std::setprecision(3)
+             << " time " << result.seconds << "s"
+             << std::setprecision(0)
+             << ", " << opsPerSecond << " ops/s"
+             << ", " << result.allocs << " allocs"
+             << ", " << result.frees << " frees"
+             << ", " << result.failures << " failed"
+             << std::setprecision(1)
+             << ", fragmentation " << fragmentation << "%"
+             << ", largest free after releasing everything " << result.largestFreeWhenEmpty
+             << " of " << options.heapSize
+             << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state parsed;
+
+   gLog = std::make_shared<spdlog::logger>("heap-bench", spdlog::sinks::stdout_sink_mt::instance());
+
+   parser.global_options()
+      .add_option("h,help",
+                  excmd::description { "Show the help." })
+      .add_option("heap-size",
+                  excmd::description { "Size of the heap in MiB." },
+                  excmd::default_value<uint32_t> { 64 })
+      .add_option("operations",
+                  excmd::description { "Number of allocations and frees to perform." },
+                  excmd::default_value<uint32_t> { 1000000 })
+      .add_option("max-live",
+                  excmd::description { "Maximum number of allocations live at once." },
+                  excmd::default_value<uint32_t> { 4096 })
+      .add_option("seed",
+                  excmd::description { "Seed for generating the allocation pattern." },
+                  excmd::default_value<uint32_t> { 1 });
+
+   try {
+      parsed = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   if (parsed.has("help")) {
+      std::cout << parser.format_help("heap-bench") << std::endl;
+      std::exit(0);
+   }
+
+   auto options = ChurnOptions { };
+   options.heapSize = uint64_t { parsed.get<uint32_t>("heap-size") } * 1024 * 1024;
+   options.operations = parsed.get<uint32_t>("operations");
+   options.maxLive = std::max(parsed.get<uint32_t>("max-live"), 1u);
+   options.seed = parsed.get<uint32_t>("seed");
+
+   auto operations = generateChurn(options);
+   printResult("TeenyHeap", options, runChurn<TeenyHeap>(options, operations));
+   printResult("TlsfHeap", options, runChurn<TlsfHeap>(options, operations));
+   return 0;
+}
@@ -0,0 +1,265 @@
+#include "capture_reader.h"
+#include <algorithm>
+#include <common/align.h>
+#include <common/murmur3.h>
+#include <common/platform_memory.h>
+#include <cstring>
+#include <map>
+#include <zlib.h>
+
+using decaf::pm4::CaptureDataRef;
+using decaf::pm4::CaptureFileHeader;
+using decaf::pm4::CaptureFrameIndex;
+using decaf::pm4::CaptureIndexFooter;
+using decaf::pm4::CaptureMemoryLoad;
+using decaf::pm4::CapturePacket;
+
+// Everything after the magic is a zlib stream of capture packets
+static const std::array<char, 4> CaptureCompressedMagic =
+{
+   'D', 'P', 'M', 'Z'
+};
+
+// In compressed captures packet type 5 refers back to the contents of an
+// earlier MemoryLoad by their MurmurHash3_x64_128.
+static const uint32_t CompressedMemoryLoadRefType = 5;
+
+struct CompressedMemoryLoadRef
+{
+   CaptureMemoryLoad::MemoryType type;
+   uint32_t address;
+   uint32_t size;
+   uint32_t unused;
+   uint64_t hash[2];
+};
+
+static bool
+inflateStream(const uint8_t *data,
+              size_t size,
+              std::vector<uint8_t> &out)
+{
+   z_stream stream;
+   std::memset(&stream, 0, sizeof(z_stream));
+
+   if (inflateInit(&stream) != Z_OK) {
+      return false;
+   }
+
+   stream.next_in = const_cast<Bytef *>(data);
+   stream.avail_in = static_cast<uInt>(size);
+   out.resize(std::max<size_t>(size * 4, 1024 * 1024));
+
+   auto result = Z_OK;
+
+   while (result == Z_OK) {
+      if (stream.total_out == out.size()) {
+         out.resize(out.size() * 2);
+      }
+
+      stream.next_out = out.data() + stream.total_out;
+      stream.avail_out = static_cast<uInt>(out.size() - stream.total_out);
+      result = inflate(&stream, Z_NO_FLUSH);
+   }
+
+   out.resize(stream.total_out);
+   inflateEnd(&stream);
+
+   // A capture which was not closed cleanly has no stream end, keep the
+   //  packets we could read.
+   return result == Z_STREAM_END || result == Z_BUF_ERROR;
+}
+
+CaptureReader::~CaptureReader()
+{
+   close();
+}
+
+bool
+CaptureReader::open(const std::string &path)
+{
+   close();
+   mData = reinterpret_cast<const uint8_t *>(platform::mapFileReadOnly(path, &mSize));
+
+   if (!mData || mSize < sizeof(CaptureFileHeader)) {
+      return false;
+   }
+
+   auto header = reinterpret_cast<const CaptureFileHeader *>(mData);
+
+   if (header->magic == decaf::pm4::CaptureMagic) {
+      mPacketsBegin = header->magic.size();
+      mPacketsEnd = mSize;
+      mPacketAlign = 1;
+      return true;
+   }
+
+   if (header->magic == CaptureCompressedMagic) {
+      return inflateCompressed(mData + header->magic.size(), mSize - header->magic.size());
+   }
+
+   if (header->magic != decaf::pm4::CaptureIndexedMagic || header->version != decaf::pm4::CaptureVersion) {
+      return false;
+   }
+
+   mPacketsBegin = sizeof(CaptureFileHeader);
+   mPacketsEnd = mSize;
+   mPacketAlign = decaf::pm4::CapturePacketAlign;
+
+   // An unfinished capture has no index, but can still be read linearly
+   if (mSize < mPacketsBegin + sizeof(CaptureIndexFooter)) {
+      return true;
+   }
+
+   auto footer = reinterpret_cast<const CaptureIndexFooter *>(mData + mSize - sizeof(CaptureIndexFooter));
+
+   if (footer->magic != decaf::pm4::CaptureIndexMagic || footer->numFrames == 0) {
+      return true;
+   }
+
+   if (footer->indexOffset + footer->numFrames * sizeof(CaptureFrameIndex) > mSize) {
+      return false;
+   }
+
+   mFrames = reinterpret_cast<const CaptureFrameIndex *>(mData + footer->indexOffset);
+   mNumFrames = footer->numFrames;
+
+   auto &last = mFrames[mNumFrames - 1];
+   mPacketsEnd = last.offset + last.size;
+   return true;
+}
+
+//! Inflate a compressed capture and rewrite its MemoryLoadRef packets as the
+//  MemoryLoad they refer to, so it can be read like an original capture.
+bool
+CaptureReader::inflateCompressed(const uint8_t *data,
+                                 size_t size)
+{
+   auto packets = std::vector<uint8_t> { };
+   auto converted = std::vector<uint8_t> { };
+   auto loads = std::map<std::pair<uint64_t, uint64_t>, std::pair<size_t, size_t>> { };
+
+   if (!inflateStream(data, size, packets)) {
+      return false;
+   }
+
+   auto offset = size_t { 0 };
+
+   while (offset + sizeof(CapturePacket) <= packets.size()) {
+      auto packet = CapturePacket { };
+      std::memcpy(&packet, packets.data() + offset, sizeof(CapturePacket));
+
+      auto payload = offset + sizeof(CapturePacket);
+
+      if (payload + packet.size > packets.size()) {
+         break;
+      }
+
+      if (packet.type == CompressedMemoryLoadRefType) {
+         auto ref = CompressedMemoryLoadRef { };
+
+         if (packet.size != sizeof(CompressedMemoryLoadRef)) {
+            return false;
+         }
+
+         std::memcpy(&ref, packets.data() + payload, sizeof(CompressedMemoryLoadRef));
+         auto itr = loads.find({ ref.hash[0], ref.hash[1] });
+
+         if (itr == loads.end() || itr->second.second != ref.size) {
+            return false;
+         }
+
+         auto load = CaptureMemoryLoad { ref.type, ref.address };
+         auto header = CapturePacket { CapturePacket::MemoryLoad, static_cast<uint32_t>(sizeof(CaptureMemoryLoad) + ref.size) };
+         auto bytes = reinterpret_cast<const uint8_t *>(&header);
+         converted.insert(converted.end(), bytes, bytes + sizeof(CapturePacket));
+         bytes = reinterpret_cast<const uint8_t *>(&load);
+         converted.insert(converted.end(), bytes, bytes + sizeof(CaptureMemoryLoad));
+         converted.insert(converted.end(), packets.begin() + itr->second.first, packets.begin() + itr->second.first + ref.size);
+      } else {
+         if (packet.type == CapturePacket::MemoryLoad && packet.size >= sizeof(CaptureMemoryLoad)) {
+            auto contents = payload + sizeof(CaptureMemoryLoad);
+            auto contentsSize = packet.size - sizeof(CaptureMemoryLoad);
+            uint64_t hash[2];
+            MurmurHash3_x64_128(packets.data() + contents, static_cast<int>(contentsSize), 0, hash);
+            loads[{ hash[0], hash[1] }] = { contents, contentsSize };
+         }
+
+         converted.insert(converted.end(), packets.begin() + offset, packets.begin() + payload + packet.size);
+      }
+
+      offset = payload + packet.size;
+   }
+
+   if (converted.empty()) {
+      return false;
+   }
+
+   platform::unmapFile(mData, mSize);
+   mInflated = std::move(converted);
+   mData = mInflated.data();
+   mSize = mInflated.size();
+   mPacketsBegin = 0;
+   mPacketsEnd = mSize;
+   mPacketAlign = 1;
+   return true;
+}
+
+void
+CaptureReader::close()
+{
+   if (mData && mInflated.empty()) {
+      platform::unmapFile(mData, mSize);
+   }
+
+   mInflated.clear();
+   mData = nullptr;
+   mSize = 0;
+   mFrames = nullptr;
+   mNumFrames = 0;
+}
+
+const uint64_t *
+CaptureReader::keyframe(size_t index) const
+{
+   return reinterpret_cast<const uint64_t *>(mData + mFrames[index].keyframeOffset);
+}
+
+bool
+CaptureReader::readPacket(uint64_t &offset,
+                          Packet &packet) const
+{
+   if (offset + sizeof(CapturePacket) > mPacketsEnd) {
+      return false;
+   }
+
+   auto header = reinterpret_cast<const CapturePacket *>(mData + offset);
+   offset += sizeof(CapturePacket);
+
+   if (offset + header->size > mPacketsEnd) {
+      return false;
+   }
+
+   packet.type = header->type;
+   packet.size = header->size;
+   packet.data = mData + offset;
+   offset += align_up(header->size, mPacketAlign);
+   return true;
+}
+
+bool
+CaptureReader::readData(const CaptureDataRef &ref,
+                        void *dst) const
+{
+   if (ref.offset + ref.compressedSize > mSize) {
+      return false;
+   }
+
+   if (ref.compressedSize == ref.size) {
+      std::memcpy(dst, mData + ref.offset, ref.size);
+      return true;
+   }
+
+   auto size = static_cast<uLongf>(ref.size);
+   auto result = uncompress(reinterpret_cast<Bytef *>(dst), &size, mData + ref.offset, ref.compressedSize);
+   return result == Z_OK && size == ref.size;
+}
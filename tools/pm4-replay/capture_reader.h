@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <libdecaf/decaf_pm4replay.h>
+#include <string>
+#include <vector>
+
+/**
+ * Provides access to a memory mapped pm4 capture file.
+ *
+ * Supports both the original capture stream and the indexed capture format,
+ * for indexed captures frames can be accessed in any order through the frame
+ * index and its keyframes. The zlib compressed 'DPMZ' stream is inflated
+ * into memory on open and read as an original capture.
+ */
+class CaptureReader
+{
+public:
+   struct Packet
+   {
+      decaf::pm4::CapturePacket::Type type;
+      uint32_t size;
+      const uint8_t *data;
+   };
+
+   ~CaptureReader();
+
+   bool
+   open(const std::string &path);
+
+   void
+   close();
+
+   // True if the capture has a frame index
+   bool
+   isIndexed() const
+   {
+      return mFrames != nullptr;
+   }
+
+   // True if packet data is aligned so it can be used in place
+   bool
+   isAligned() const
+   {
+      return mPacketAlign == decaf::pm4::CapturePacketAlign;
+   }
+
+   size_t
+   numFrames() const
+   {
+      return mNumFrames;
+   }
+
+   const decaf::pm4::CaptureFrameIndex &
+   frame(size_t index) const
+   {
+      return mFrames[index];
+   }
+
+   const uint64_t *
+   keyframe(size_t index) const;
+
+   uint64_t
+   packetsBegin() const
+   {
+      return mPacketsBegin;
+   }
+
+   uint64_t
+   packetsEnd() const
+   {
+      return mPacketsEnd;
+   }
+
+   // Read the packet at offset and advance offset to the next packet
+   bool
+   readPacket(uint64_t &offset,
+              Packet &packet) const;
+
+   // Copy, and if needed decompress, a MemoryData payload to dst
+   bool
+   readData(const decaf::pm4::CaptureDataRef &ref,
+            void *dst) const;
+
+private:
+   bool
+   inflateCompressed(const uint8_t *data,
+                     size_t size);
+
+private:
+   const uint8_t *mData = nullptr;
+   size_t mSize = 0;
+   uint64_t mPacketsBegin = 0;
+   uint64_t mPacketsEnd = 0;
+   uint32_t mPacketAlign = 1;
+   const decaf::pm4::CaptureFrameIndex *mFrames = nullptr;
+   size_t mNumFrames = 0;
+
+   //! Inflated packets of a compressed capture, mData points here instead of
+   //  at the file mapping when this is not empty.
+   std::vector<uint8_t> mInflated;
+};
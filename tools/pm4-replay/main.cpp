@@ -31,6 +31,14 @@ getCommandLineParser()
                     value<std::string> {});
 
    parser.add_command("replay")
+      .add_option("frame-begin",
+                  description { "First frame to replay, requires an indexed capture when not 0." },
+                  default_value<uint32_t> { 0 })
+      .add_option("frame-end",
+                  description { "Last frame to replay." },
+                  value<uint32_t> {})
+      .add_option("loop",
+                  description { "Restart from the first frame when the last frame is reached." })
       .add_argument("trace file", value<std::string> {});
 
    return parser;
@@ -63,6 +71,13 @@ start(excmd::parser &parser,
    }
 
    auto traceFile = options.get<std::string>("trace file");
+   auto range = ReplayRange { };
+   range.begin = options.get<uint32_t>("frame-begin");
+   range.loop = options.has("loop");
+
+   if (options.has("frame-end")) {
+      range.end = options.get<uint32_t>("frame-end");
+   }
 
    std::vector<spdlog::sink_ptr> sinks;
    sinks.push_back(spdlog::sinks::stdout_sink_st::instance());
@@ -90,7 +105,7 @@ start(excmd::parser &parser,
             if (!window.createWindow()) {
                result = -1;
             } else {
-               result = window.run(traceFile);
+               result = window.run(traceFile, range);
             }
          }
       });
@@ -1,7 +1,8 @@
 #include "sdl_window.h"
+#include "capture_reader.h"
 #include "clilog.h"
+#include <algorithm>
 #include <array>
-#include <fstream>
 #include <common/teenyheap.h>
 #include <libdecaf/decaf.h>
 #include <libdecaf/decaf_nullinputdriver.h>
@@ -27,116 +28,205 @@ public:
       mRegisterStorage = reinterpret_cast<uint32_t *>(gSystemHeap->alloc(0x10000 * 4, 0x100));
    }
 
-   bool open(const std::string &path)
+   ~PM4Parser()
    {
-      mFile.open(path, std::ifstream::binary);
+      freeBuffers();
+   }
 
-      if (!mFile.is_open()) {
+   bool open(const std::string &path)
+   {
+      if (!mCapture.open(path)) {
          return false;
       }
 
-      std::array<char, 4> magic;
-      mFile.read(magic.data(), 4);
+      mCursor = mCapture.packetsBegin();
+      return true;
+   }
+
+   bool setFrameRange(const ReplayRange &range)
+   {
+      mRange = range;
+
+      if (mCapture.isIndexed()) {
+         gCliLog->info("Capture contains {} frames", mCapture.numFrames());
+
+         if (mRange.begin >= mCapture.numFrames()) {
+            gCliLog->error("Capture does not contain frame {}", mRange.begin);
+            return false;
+         }
 
-      if (magic != decaf::pm4::CaptureMagic) {
+         mRange.end = std::min(mRange.end, mCapture.numFrames() - 1);
+      } else if (mRange.begin != 0) {
+         gCliLog->error("Capture has no frame index, it can only be replayed from the first frame");
          return false;
       }
 
-      return true;
+      return seekFrame(mRange.begin);
    }
 
    bool eof()
    {
-      return mFile.eof();
+      return !mRange.loop && (mFrame > mRange.end || mCursor >= mCapture.packetsEnd());
    }
 
    bool readFrame()
    {
-      std::vector<char> buffer;
+      if (mFrame > mRange.end || mCursor >= mCapture.packetsEnd()) {
+         if (!mRange.loop || !seekFrame(mRange.begin)) {
+            return false;
+         }
+      }
+
+      auto frameEnd = mCapture.packetsEnd();
       auto foundSwap = false;
 
+      if (mCapture.isIndexed()) {
+         auto &frame = mCapture.frame(mFrame);
+         frameEnd = frame.offset + frame.size;
+      }
+
       // Free command buffers used from last frame
-      for (auto buf : mBuffers) {
-         delete[] buf;
+      freeBuffers();
+
+      // Without an index a frame ends at the first swap
+      while (mCursor < frameEnd && (mCapture.isIndexed() || !foundSwap)) {
+         CaptureReader::Packet packet;
+
+         if (!mCapture.readPacket(mCursor, packet)) {
+            return false;
+         }
+
+         foundSwap |= handlePacket(packet);
       }
 
-      mBuffers.clear();
+      mFrame++;
+      return foundSwap;
+   }
 
-      while (!foundSwap) {
-         decaf::pm4::CapturePacket packet;
-         mFile.read(reinterpret_cast<char *>(&packet), sizeof(decaf::pm4::CapturePacket));
+private:
+   // Move to the start of a frame, restoring its register and memory state
+   bool seekFrame(size_t index)
+   {
+      if (!mCapture.isIndexed()) {
+         decaf_check(index == 0);
+         mCursor = mCapture.packetsBegin();
+         mFrame = 0;
+         return true;
+      }
+
+      auto &frame = mCapture.frame(index);
 
-         if (!mFile) {
+      if (frame.registers.size) {
+         if (frame.registers.size != 0x10000 * 4 || !mCapture.readData(frame.registers, mRegisterStorage)) {
+            gCliLog->error("Invalid register keyframe for frame {}", index);
             return false;
          }
 
-         switch (packet.type) {
-         case decaf::pm4::CapturePacket::CommandBuffer:
-         {
-            auto commandBuffer = new uint8_t[packet.size];
-            mFile.read(reinterpret_cast<char *>(commandBuffer), packet.size);
+         loadRegisterStorage(frame.registers.size);
+      }
 
-            if (!mFile) {
-               return false;
-            }
+      auto keyframe = mCapture.keyframe(index);
 
-            foundSwap |= handleCommandBuffer(commandBuffer, packet.size);
-            mBuffers.push_back(commandBuffer);
-            break;
+      for (auto i = 0u; i < frame.keyframeCount; ++i) {
+         auto offset = keyframe[i];
+         CaptureReader::Packet packet;
+
+         if (!mCapture.readPacket(offset, packet)) {
+            gCliLog->error("Invalid keyframe packet for frame {}", index);
+            return false;
          }
-         case decaf::pm4::CapturePacket::RegisterSnapshot:
-         {
-            decaf_check((packet.size % 4) == 0);
-            auto numRegisters = packet.size / 4;
-            mFile.read(reinterpret_cast<char *>(mRegisterStorage), packet.size);
 
-            // Swap it into big endian, so we can write LOAD_ commands
-            for (auto i = 0u; i < numRegisters; ++i) {
-               mRegisterStorage[i] = byte_swap(mRegisterStorage[i]);
-            }
+         handlePacket(packet);
+      }
 
-            handleRegisterSnapshot(reinterpret_cast<be_val<uint32_t> *>(mRegisterStorage), numRegisters);
-            gx2::internal::flushCommandBuffer(0x100);
-            break;
+      mCursor = frame.offset;
+      mFrame = index;
+      return true;
+   }
+
+   // Returns true if the packet contained a swap
+   bool handlePacket(const CaptureReader::Packet &packet)
+   {
+      switch (packet.type) {
+      case decaf::pm4::CapturePacket::CommandBuffer:
+      {
+         auto commandBuffer = const_cast<uint8_t *>(packet.data);
+
+         // Aligned command buffers can be used straight from the capture file
+         if (!mCapture.isAligned()) {
+            commandBuffer = new uint8_t[packet.size];
+            std::memcpy(commandBuffer, packet.data, packet.size);
+            mBuffers.push_back(commandBuffer);
          }
-         case decaf::pm4::CapturePacket::SetBuffer:
-         {
-            decaf::pm4::CaptureSetBuffer setBuffer;
-            mFile.read(reinterpret_cast<char *>(&setBuffer), sizeof(decaf::pm4::CaptureSetBuffer));
 
-            handleSetBuffer(setBuffer);
-            gx2::internal::flushCommandBuffer(0x100);
-            break;
+         return handleCommandBuffer(commandBuffer, packet.size);
+      }
+      case decaf::pm4::CapturePacket::RegisterSnapshot:
+      {
+         decaf_check((packet.size % 4) == 0);
+         std::memcpy(mRegisterStorage, packet.data, packet.size);
+         loadRegisterStorage(packet.size);
+         break;
+      }
+      case decaf::pm4::CapturePacket::SetBuffer:
+      {
+         decaf::pm4::CaptureSetBuffer setBuffer;
+         std::memcpy(&setBuffer, packet.data, sizeof(decaf::pm4::CaptureSetBuffer));
+         handleSetBuffer(setBuffer);
+         gx2::internal::flushCommandBuffer(0x100);
+         break;
+      }
+      case decaf::pm4::CapturePacket::MemoryLoad:
+      {
+         decaf::pm4::CaptureMemoryLoad load;
+         std::memcpy(&load, packet.data, sizeof(decaf::pm4::CaptureMemoryLoad));
+
+         auto ptr = mem::translate(load.address);
+         std::memcpy(ptr, packet.data + sizeof(decaf::pm4::CaptureMemoryLoad), packet.size - sizeof(decaf::pm4::CaptureMemoryLoad));
+         break;
+      }
+      case decaf::pm4::CapturePacket::MemoryLoadRef:
+      {
+         decaf::pm4::CaptureMemoryLoadRef ref;
+         std::memcpy(&ref, packet.data, sizeof(decaf::pm4::CaptureMemoryLoadRef));
+
+         if (!mCapture.readData(ref.data, mem::translate(ref.address))) {
+            gCliLog->error("Failed to read memory load for address 0x{:08X}", ref.address);
          }
-         case decaf::pm4::CapturePacket::MemoryLoad:
-         {
-            decaf::pm4::CaptureMemoryLoad load;
-            mFile.read(reinterpret_cast<char *>(&load), sizeof(decaf::pm4::CaptureMemoryLoad));
 
-            if (!mFile) {
-               return false;
-            }
+         break;
+      }
+      default:
+         break;
+      }
+
+      return false;
+   }
 
-            buffer.resize(packet.size - sizeof(decaf::pm4::CaptureMemoryLoad));
-            mFile.read(buffer.data(), buffer.size());
+   void loadRegisterStorage(uint32_t size)
+   {
+      auto numRegisters = size / 4;
 
-            if (!mFile) {
-               return false;
-            }
+      // Swap it into big endian, so we can write LOAD_ commands
+      for (auto i = 0u; i < numRegisters; ++i) {
+         mRegisterStorage[i] = byte_swap(mRegisterStorage[i]);
+      }
 
-            handleMemoryLoad(load, buffer);
-            break;
-         }
-         default:
-            mFile.seekg(packet.size, std::ifstream::cur);
-         }
+      handleRegisterSnapshot(reinterpret_cast<be_val<uint32_t> *>(mRegisterStorage), numRegisters);
+      gx2::internal::flushCommandBuffer(0x100);
+   }
+
+   void freeBuffers()
+   {
+      for (auto buf : mBuffers) {
+         delete[] buf;
       }
 
-      return foundSwap;
+      mBuffers.clear();
    }
 
-private:
    bool handleCommandBuffer(void *buffer, uint32_t size)
+
    {
       decaf::pm4::injectCommandBuffer(buffer, size);
       return scanCommandBuffer(buffer, size / 4);
@@ -241,12 +331,6 @@ private:
       });
    }
 
-   void handleMemoryLoad(decaf::pm4::CaptureMemoryLoad &load, std::vector<char> &data)
-   {
-      auto ptr = mem::translate(load.address);
-      std::memcpy(ptr, data.data(), data.size());
-   }
-
    bool
    scanType0(pm4::type0::Header header,
              const gsl::span<be_val<uint32_t>> &data)
@@ -272,7 +356,6 @@ private:
    bool
    scanCommandBuffer(void *words, uint32_t numWords)
    {
-      std::vector<uint32_t> swapped;
       auto buffer = reinterpret_cast<be_val<uint32_t> *>(words);
       auto foundSwap = false;
 
@@ -318,7 +401,10 @@ private:
 
 private:
    decaf::GraphicsDriver *mGraphicsDriver = nullptr;
-   std::ifstream mFile;
+   CaptureReader mCapture;
+   ReplayRange mRange;
+   uint64_t mCursor = 0;
+   size_t mFrame = 0;
    std::vector<uint8_t *> mBuffers;
    uint32_t *mRegisterStorage = nullptr;
 };
@@ -403,7 +489,8 @@ SDLWindow::createWindow()
 }
 
 bool
-SDLWindow::run(const std::string &tracePath)
+SDLWindow::run(const std::string &tracePath,
+               const ReplayRange &range)
 {
    auto shouldQuit = false;
 
@@ -435,6 +522,11 @@ SDLWindow::run(const std::string &tracePath)
    PM4Parser parser { mGraphicsDriver };
 
    if (!parser.open(tracePath)) {
+      gCliLog->error("Failed to open trace {}", tracePath);
+      return false;
+   }
+
+   if (!parser.setFrameRange(range)) {
       return false;
    }
 
@@ -2,9 +2,22 @@
 #include <glbinding/gl/gl.h>
 #include <libdecaf/decaf.h>
 #include <libdecaf/decaf_opengl.h>
+#include <limits>
 #include <SDL.h>
 #include <string>
 
+struct ReplayRange
+{
+   //! First frame to replay
+   size_t begin = 0;
+
+   //! Last frame to replay, inclusive
+   size_t end = std::numeric_limits<size_t>::max();
+
+   //! Restart from the first frame after the last frame
+   bool loop = false;
+};
+
 class SDLWindow
 {
    static const auto WindowWidth = 1420;
@@ -14,7 +27,8 @@ public:
    ~SDLWindow();
 
    bool createWindow();
-   bool run(const std::string &tracePath);
+   bool run(const std::string &tracePath,
+            const ReplayRange &range);
 
 protected:
    void initialiseContext();